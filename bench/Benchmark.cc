@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Benchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <stdint.h>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+struct RegisteredBenchmark {
+  const char *name_;
+  atscppapi::bench::BenchmarkFunction function_;
+  size_t bytes_per_iteration_;
+};
+
+bool compareNames(const RegisteredBenchmark &lhs, const RegisteredBenchmark &rhs) {
+  return strcmp(lhs.name_, rhs.name_) < 0;
+}
+
+// a function static so registrations from the static constructors of other files find it constructed
+vector<RegisteredBenchmark> &getBenchmarks() {
+  static vector<RegisteredBenchmark> benchmarks;
+  return benchmarks;
+}
+
+volatile size_t kept_value = 0;
+const char *failure = NULL;
+
+const int DEFAULT_MIN_TIME_MS = 200;
+const int DEFAULT_REPETITIONS = 3;
+const size_t MAX_ITERATIONS = static_cast<size_t>(1) << 40;
+
+int64_t nowNanoseconds() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+int64_t timeIterations(const RegisteredBenchmark &benchmark, size_t iterations) {
+  int64_t start = nowNanoseconds();
+  benchmark.function_(iterations);
+  return nowNanoseconds() - start;
+}
+
+bool matches(const char *name, const vector<string> &filters) {
+  if (filters.empty()) {
+    return true;
+  }
+  for (vector<string>::const_iterator iter = filters.begin(), end = filters.end(); iter != end; ++iter) {
+    if (strstr(name, iter->c_str())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void printUsage(const char *program) {
+  fprintf(stderr,
+          "Usage: %s [options] [filter...]\n"
+          "Runs the benchmarks whose names contain one of the filters, all of them without a filter.\n"
+          "  --list            print the names of the benchmarks and exit\n"
+          "  --min-time=MS     run each measurement for at least MS milliseconds (default %d)\n"
+          "  --repetitions=N   measure each benchmark N times, the best and median are reported (default %d)\n",
+          program, DEFAULT_MIN_TIME_MS, DEFAULT_REPETITIONS);
+}
+
+} /* anonymous namespace */
+
+void atscppapi::bench::registerBenchmark(const char *name, BenchmarkFunction function, size_t bytes_per_iteration) {
+  RegisteredBenchmark benchmark = { name, function, bytes_per_iteration };
+  getBenchmarks().push_back(benchmark);
+}
+
+void atscppapi::bench::keep(size_t value) {
+  kept_value += value;
+}
+
+void atscppapi::bench::fail(const char *message) {
+  if (!failure) {
+    failure = message;
+  }
+}
+
+int atscppapi::bench::runBenchmarks(int argc, char *argv[]) {
+  int min_time_ms = DEFAULT_MIN_TIME_MS;
+  int repetitions = DEFAULT_REPETITIONS;
+  bool list_only = false;
+  vector<string> filters;
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    if (strcmp(arg, "--list") == 0) {
+      list_only = true;
+    } else if (strncmp(arg, "--min-time=", 11) == 0) {
+      min_time_ms = atoi(arg + 11);
+    } else if (strncmp(arg, "--repetitions=", 14) == 0) {
+      repetitions = atoi(arg + 14);
+    } else if (arg[0] == '-') {
+      printUsage(argv[0]);
+      return (strcmp(arg, "--help") == 0) ? 0 : 2;
+    } else {
+      filters.push_back(arg);
+    }
+  }
+  if ((min_time_ms <= 0) || (repetitions <= 0)) {
+    printUsage(argv[0]);
+    return 2;
+  }
+
+  vector<RegisteredBenchmark> &benchmarks = getBenchmarks();
+  std::sort(benchmarks.begin(), benchmarks.end(), compareNames);
+  if (list_only) {
+    for (size_t i = 0; i < benchmarks.size(); ++i) {
+      if (matches(benchmarks[i].name_, filters)) {
+        printf("%s\n", benchmarks[i].name_);
+      }
+    }
+    return 0;
+  }
+
+  printf("%-40s %14s %14s %12s %14s\n", "benchmark", "best ns/op", "median ns/op", "MB/s", "iterations");
+  const int64_t min_time = static_cast<int64_t>(min_time_ms) * 1000000LL;
+  int failed = 0;
+  for (size_t i = 0; i < benchmarks.size(); ++i) {
+    const RegisteredBenchmark &benchmark = benchmarks[i];
+    if (!matches(benchmark.name_, filters)) {
+      continue;
+    }
+    failure = NULL;
+    timeIterations(benchmark, 1); // warms up and lets the benchmark build its inputs
+
+    // grow the iteration count until a run takes long enough to time reliably
+    size_t iterations = 1;
+    int64_t elapsed = timeIterations(benchmark, iterations);
+    while ((elapsed < min_time) && (iterations < MAX_ITERATIONS) && !failure) {
+      double scale = elapsed ? (1.2 * static_cast<double>(min_time) / static_cast<double>(elapsed)) : 100.0;
+      scale = std::min(std::max(scale, 2.0), 100.0);
+      iterations = static_cast<size_t>(static_cast<double>(iterations) * scale);
+      elapsed = timeIterations(benchmark, iterations);
+    }
+
+    vector<double> results;
+    results.push_back(static_cast<double>(elapsed) / static_cast<double>(iterations));
+    for (int repetition = 1; (repetition < repetitions) && !failure; ++repetition) {
+      results.push_back(static_cast<double>(timeIterations(benchmark, iterations)) / static_cast<double>(iterations));
+    }
+    if (failure) {
+      printf("%-40s FAILED: %s\n", benchmark.name_, failure);
+      ++failed;
+      continue;
+    }
+
+    std::sort(results.begin(), results.end());
+    double best = results.front();
+    double median = results[results.size() / 2];
+    if (benchmark.bytes_per_iteration_) {
+      double megabytes_per_second = (static_cast<double>(benchmark.bytes_per_iteration_) / (1024.0 * 1024.0)) /
+                                    (best / 1000000000.0);
+      printf("%-40s %14.1f %14.1f %12.1f %14lu\n", benchmark.name_, best, median, megabytes_per_second,
+             static_cast<unsigned long>(iterations));
+    } else {
+      printf("%-40s %14.1f %14.1f %12s %14lu\n", benchmark.name_, best, median, "-",
+             static_cast<unsigned long>(iterations));
+    }
+    fflush(stdout);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Benchmark.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief A minimal harness for the microbenchmarks of the library.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BENCH_BENCHMARK_H_
+#define ATSCPPAPI_BENCH_BENCHMARK_H_
+
+#include <cstddef>
+#include <string>
+
+namespace atscppapi {
+namespace bench {
+
+/**
+ * The function measured by a benchmark, it runs the operation iterations times. Anything it sets up
+ * once (inputs, a mock transaction) should be kept in function statics: every benchmark is run once
+ * untimed before it is measured.
+ */
+typedef void (*BenchmarkFunction)(size_t iterations);
+
+/**
+ * Registers a benchmark, use BENCHMARK() rather than calling this directly.
+ *
+ * @param name the name it's reported and filtered by, "group.operation".
+ * @param function the function measured.
+ * @param bytes_per_iteration the bytes an iteration processes, a throughput is reported when non zero.
+ */
+void registerBenchmark(const char *name, BenchmarkFunction function, size_t bytes_per_iteration = 0);
+
+/**
+ * Makes sure the compiler can't drop the computation of value.
+ */
+void keep(size_t value);
+
+/**
+ * Reports that the benchmark being run produced a wrong result, the run exits with an error.
+ */
+void fail(const char *message);
+
+/**
+ * Runs the registered benchmarks selected by the command line, run with --help for the options.
+ *
+ * @return the exit status of the run.
+ */
+int runBenchmarks(int argc, char *argv[]);
+
+/** @private */
+struct BenchmarkRegistration {
+  BenchmarkRegistration(const char *name, BenchmarkFunction function, size_t bytes_per_iteration = 0) {
+    registerBenchmark(name, function, bytes_per_iteration);
+  }
+};
+
+} /* bench */
+} /* atscppapi */
+
+/**
+ * Registers function under name from any translation unit linked into the benchmark program, e.g.
+ * BENCHMARK(url.get_host, benchUrlGetHost);
+ */
+#define BENCHMARK(NAME, FUNCTION) \
+  static atscppapi::bench::BenchmarkRegistration FUNCTION##_registration(#NAME, FUNCTION)
+
+/**
+ * @see BENCHMARK(), the throughput of function is reported from the bytes an iteration processes.
+ */
+#define BENCHMARK_BYTES(NAME, FUNCTION, BYTES) \
+  static atscppapi::bench::BenchmarkRegistration FUNCTION##_registration(#NAME, FUNCTION, BYTES)
+
+#endif /* ATSCPPAPI_BENCH_BENCHMARK_H_ */
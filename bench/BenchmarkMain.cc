@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BenchmarkMain.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * The entry point of atscppapi_bench, the benchmarks register themselves from their own files.
+ */
+
+#include "Benchmark.h"
+#include "utils_internal.h"
+
+int main(int argc, char *argv[]) {
+  atscppapi::utils::internal::initTransactionManagement();
+  return atscppapi::bench::runBenchmarks(argc, argv);
+}
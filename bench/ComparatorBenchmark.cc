@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ComparatorBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * The case insensitive comparisons every header lookup goes through, on names of typical lengths.
+ */
+
+#include "Benchmark.h"
+#include <atscppapi/CaseInsensitiveStringComparator.h>
+#include <map>
+#include <string>
+
+using namespace atscppapi;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const char *const HEADER_NAMES[] = {
+  "Accept", "Accept-Encoding", "Accept-Language", "Cache-Control", "Connection", "Content-Length",
+  "Content-Type", "Cookie", "Host", "If-Modified-Since", "If-None-Match", "Referer", "User-Agent",
+  "X-Forwarded-For", "X-Forwarded-Proto", "X-Request-Id"
+};
+const size_t HEADER_NAME_COUNT = sizeof(HEADER_NAMES) / sizeof(HEADER_NAMES[0]);
+
+void benchmarkCompareShort(size_t iterations) {
+  const CaseInsensitiveStringComparator comparator;
+  const string lhs("content-type");
+  const string rhs("Content-Type");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(comparator.compare(lhs, rhs) + 1);
+  }
+}
+
+void benchmarkCompareLong(size_t iterations) {
+  const CaseInsensitiveStringComparator comparator;
+  const string lhs("x-application-specific-request-correlation-identifier-header");
+  const string rhs("X-Application-Specific-Request-Correlation-Identifier-Header");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(comparator.compare(lhs, rhs) + 1);
+  }
+}
+
+void benchmarkEquals(size_t iterations) {
+  const CaseInsensitiveStringComparator comparator;
+  const string lhs("x-forwarded-for");
+  const string rhs("X-Forwarded-For");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(comparator.equals(lhs, rhs));
+  }
+}
+
+void benchmarkEqualsLengthMismatch(size_t iterations) {
+  const CaseInsensitiveStringComparator comparator;
+  const string lhs("x-forwarded-for");
+  const string rhs("X-Forwarded-Proto");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(comparator.equals(lhs, rhs));
+  }
+}
+
+void benchmarkMapLookup(size_t iterations) {
+  static std::map<string, size_t, CaseInsensitiveStringComparator> names;
+  static string lookups[HEADER_NAME_COUNT];
+  if (names.empty()) {
+    for (size_t i = 0; i < HEADER_NAME_COUNT; ++i) {
+      names[HEADER_NAMES[i]] = i;
+      lookups[i] = HEADER_NAMES[i];
+      for (size_t j = 0; j < lookups[i].size(); ++j) {
+        lookups[i][j] = tolower(lookups[i][j]);
+      }
+    }
+  }
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(names.find(lookups[i % HEADER_NAME_COUNT])->second);
+  }
+}
+
+void benchmarkHash(size_t iterations) {
+  const CaseInsensitiveStringHash hash;
+  static string names[HEADER_NAME_COUNT];
+  if (names[0].empty()) {
+    for (size_t i = 0; i < HEADER_NAME_COUNT; ++i) {
+      names[i] = HEADER_NAMES[i];
+    }
+  }
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(hash(names[i % HEADER_NAME_COUNT]));
+  }
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(comparator.compare.short, benchmarkCompareShort);
+BENCHMARK(comparator.compare.long, benchmarkCompareLong);
+BENCHMARK(comparator.equals, benchmarkEquals);
+BENCHMARK(comparator.equals.length_mismatch, benchmarkEqualsLengthMismatch);
+BENCHMARK(comparator.map_lookup, benchmarkMapLookup);
+BENCHMARK(comparator.hash, benchmarkHash);
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CompressedVariantCacheBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * CompressedVariantCache serving a hot page, and the responses it must leave alone: those to HEAD
+ * requests, partial content and not modified responses are neither compressed nor stored.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include <atscppapi/CompressedVariantCache.h>
+#include <string>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const size_t MAX_CACHE_BYTES = 1024 * 1024;
+
+const char GET_REQUEST[] = "GET /page HTTP/1.1\r\nHost: www.example.com\r\nAccept-Encoding: gzip\r\n\r\n";
+const char HEAD_REQUEST[] = "HEAD /page HTTP/1.1\r\nHost: www.example.com\r\nAccept-Encoding: gzip\r\n\r\n";
+const char RANGE_REQUEST[] = "GET /page HTTP/1.1\r\nHost: www.example.com\r\nAccept-Encoding: gzip\r\n"
+                             "Range: bytes=0-99\r\n\r\n";
+const char CONDITIONAL_REQUEST[] = "GET /page HTTP/1.1\r\nHost: www.example.com\r\nAccept-Encoding: gzip\r\n"
+                                   "If-None-Match: \"v1\"\r\n\r\n";
+
+const char OK_RESPONSE[] = "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nETag: \"v1\"\r\n\r\n";
+const char PARTIAL_RESPONSE[] = "HTTP/1.1 206 Partial Content\r\nContent-Type: text/html\r\nETag: \"v1\"\r\n"
+                                "Content-Range: bytes 0-99/4096\r\n\r\n";
+const char NOT_MODIFIED_RESPONSE[] = "HTTP/1.1 304 Not Modified\r\nETag: \"v1\"\r\n\r\n";
+
+const string &getPage() {
+  static string page;
+  while (page.size() < 4096) {
+    page.append("<li class=\"result\"><a href=\"/products/item\">Product</a></li>\n");
+  }
+  return page;
+}
+
+/**
+ * Sets up the cache for a transaction of raw_request answered with raw_response and runs body through what it added.
+ *
+ * @return the codec the cache negotiated.
+ */
+ContentEncoding::Codec runTransaction(CompressedVariantCache &cache, const char *raw_request, const char *raw_response,
+                                      const string &body, string &output) {
+  TSHttpTxn txn = mock::createTransaction(raw_request);
+  mock::setTransactionResponse(txn, raw_response);
+  ContentEncoding::Codec codec = cache.setupTransaction(utils::internal::getTransaction(txn));
+  output.clear();
+  if (mock::runTransformations(txn, TS_HTTP_RESPONSE_TRANSFORM_HOOK, body.data(), body.size(), 0, &output) < 0) {
+    output = body; // there's no transformation, the body is served as is
+  }
+  mock::destroyTransaction(txn);
+  return codec;
+}
+
+void benchmarkHit(size_t iterations) {
+  static CompressedVariantCache cache(MAX_CACHE_BYTES, MAX_CACHE_BYTES);
+  string output;
+  for (size_t i = 0; i < iterations; ++i) {
+    if ((runTransaction(cache, GET_REQUEST, OK_RESPONSE, getPage(), output) != ContentEncoding::GZIP) ||
+        output.empty() || (output.size() >= getPage().size()) || (cache.getEntryCount() != 1)) {
+      bench::fail("the page wasn't served compressed from the cache");
+    }
+    keep(output.size());
+  }
+}
+
+/** An uncacheable response, it must not be cached nor spoil the cached variant of the GET that follows it. */
+void checkUncached(const char *raw_request, const char *raw_response, const string &body, size_t iterations) {
+  string output;
+  for (size_t i = 0; i < iterations; ++i) {
+    CompressedVariantCache cache(MAX_CACHE_BYTES, MAX_CACHE_BYTES);
+    if ((runTransaction(cache, raw_request, raw_response, body, output) != ContentEncoding::IDENTITY) ||
+        (output != body) || cache.getEntryCount()) {
+      bench::fail("the response was compressed or cached");
+    }
+    if ((runTransaction(cache, GET_REQUEST, OK_RESPONSE, getPage(), output) != ContentEncoding::GZIP) ||
+        output.empty() || (output.size() >= getPage().size())) {
+      bench::fail("the GET after it wasn't served the compressed page");
+    }
+    keep(output.size());
+  }
+}
+
+void benchmarkHead(size_t iterations) {
+  checkUncached(HEAD_REQUEST, OK_RESPONSE, string(), iterations);
+}
+
+void benchmarkPartialContent(size_t iterations) {
+  checkUncached(RANGE_REQUEST, PARTIAL_RESPONSE, getPage().substr(0, 100), iterations);
+}
+
+void benchmarkNotModified(size_t iterations) {
+  checkUncached(CONDITIONAL_REQUEST, NOT_MODIFIED_RESPONSE, string(), iterations);
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(compressed_cache.hit, benchmarkHit);
+BENCHMARK(compressed_cache.head, benchmarkHead);
+BENCHMARK(compressed_cache.partial_content, benchmarkPartialContent);
+BENCHMARK(compressed_cache.not_modified, benchmarkNotModified);
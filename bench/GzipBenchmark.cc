@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file GzipBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * The gzip transformations on a response body handed over in network sized chunks. Each iteration is
+ * a whole transaction: the plugin is created, the body run through it and the transaction closed.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include <atscppapi/GzipDeflateTransformation.h>
+#include <atscppapi/GzipInflateTransformation.h>
+#include <cstdio>
+#include <string>
+#include <zlib.h>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const size_t SMALL_BODY_SIZE = 64 * 1024;
+const size_t LARGE_BODY_SIZE = 1024 * 1024;
+const size_t CHUNK_SIZE = 16 * 1024;
+
+const char RESPONSE[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/html; charset=utf-8\r\n"
+  "Cache-Control: max-age=300\r\n"
+  "\r\n";
+
+/** Markup compressing about as well as a real page, repetitive but not a single repeated string. */
+string makeBody(size_t size) {
+  string body;
+  body.reserve(size + 256);
+  body.append("<!DOCTYPE html><html><head><title>Results</title></head><body><ul>\n");
+  char item[256];
+  for (unsigned int i = 0; body.size() < size; ++i) {
+    snprintf(item, sizeof(item), "<li class=\"result r%u\"><a href=\"/products/%u?ref=%08x\">Product %u</a>"
+             "<span class=\"price\">%u.%02u</span></li>\n", i % 7, i, i * 2654435761u, i, (i * 37) % 500, i % 100);
+    body.append(item);
+  }
+  body.resize(size);
+  return body;
+}
+
+string gzip(const string &data) {
+  z_stream stream = z_stream();
+  deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31 /* a gzip header */, 8, Z_DEFAULT_STRATEGY);
+  string compressed(deflateBound(&stream, data.size()) + 32, '\0');
+  stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+  stream.avail_in = data.size();
+  stream.next_out = reinterpret_cast<Bytef *>(&compressed[0]);
+  stream.avail_out = compressed.size();
+  deflate(&stream, Z_FINISH);
+  compressed.resize(stream.total_out);
+  deflateEnd(&stream);
+  return compressed;
+}
+
+TSHttpTxn getResponseTransaction() {
+  static TSHttpTxn txn = NULL;
+  if (!txn) {
+    txn = mock::createTransaction("GET /products HTTP/1.1\r\nHost: www.example.com\r\nAccept-Encoding: gzip\r\n\r\n");
+    mock::setTransactionResponse(txn, RESPONSE);
+  }
+  return txn;
+}
+
+void deflateBody(const string &body, size_t iterations) {
+  TSHttpTxn txn = getResponseTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    transaction.addPlugin(new GzipDeflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+    int64_t compressed = mock::runTransformations(txn, TS_HTTP_RESPONSE_TRANSFORM_HOOK, body.data(), body.size(),
+                                                  CHUNK_SIZE);
+    if ((compressed <= 0) || (static_cast<size_t>(compressed) >= body.size())) {
+      bench::fail("the body wasn't compressed");
+    }
+    keep(static_cast<size_t>(compressed));
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkDeflateSmall(size_t iterations) {
+  static const string body = makeBody(SMALL_BODY_SIZE);
+  deflateBody(body, iterations);
+}
+
+void benchmarkDeflateLarge(size_t iterations) {
+  static const string body = makeBody(LARGE_BODY_SIZE);
+  deflateBody(body, iterations);
+}
+
+void benchmarkInflateLarge(size_t iterations) {
+  static const string compressed = gzip(makeBody(LARGE_BODY_SIZE));
+  TSHttpTxn txn = getResponseTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    transaction.addPlugin(new GzipInflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+    int64_t inflated = mock::runTransformations(txn, TS_HTTP_RESPONSE_TRANSFORM_HOOK, compressed.data(),
+                                                compressed.size(), CHUNK_SIZE);
+    if (inflated != static_cast<int64_t>(LARGE_BODY_SIZE)) {
+      bench::fail("the body didn't inflate to its original size");
+    }
+    keep(static_cast<size_t>(inflated));
+    mock::closeTransaction(txn);
+  }
+}
+
+/** Both transformations chained, checks that the body survives the round trip. */
+void benchmarkRoundTrip(size_t iterations) {
+  static const string body = makeBody(SMALL_BODY_SIZE);
+  TSHttpTxn txn = getResponseTransaction();
+  string output;
+  for (size_t i = 0; i < iterations; ++i) {
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    transaction.addPlugin(new GzipDeflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+    transaction.addPlugin(new GzipInflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+    output.clear();
+    mock::runTransformations(txn, TS_HTTP_RESPONSE_TRANSFORM_HOOK, body.data(), body.size(), CHUNK_SIZE, &output);
+    if (output != body) {
+      bench::fail("the body changed in the round trip");
+    }
+    keep(output.size());
+    mock::closeTransaction(txn);
+  }
+}
+
+} /* anonymous namespace */
+
+BENCHMARK_BYTES(gzip.deflate.64k, benchmarkDeflateSmall, SMALL_BODY_SIZE);
+BENCHMARK_BYTES(gzip.deflate.1m, benchmarkDeflateLarge, LARGE_BODY_SIZE);
+BENCHMARK_BYTES(gzip.inflate.1m, benchmarkInflateLarge, LARGE_BODY_SIZE);
+BENCHMARK_BYTES(gzip.round_trip.64k, benchmarkRoundTrip, SMALL_BODY_SIZE);
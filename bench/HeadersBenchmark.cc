@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HeadersBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * Headers of a typical browser request. The headers of a Transaction are only read from its marshal
+ * buffer when first used: headers.init measures that, the lookups run on headers read in already.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include <string>
+
+using namespace atscppapi;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const char BROWSER_REQUEST[] =
+  "GET /search?q=traffic+server&lang=en&page=2 HTTP/1.1\r\n"
+  "Host: www.example.com\r\n"
+  "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/31.0.1650.63\r\n"
+  "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+  "Accept-Encoding: gzip,deflate,sdch\r\n"
+  "Accept-Language: en-US,en;q=0.8\r\n"
+  "Cache-Control: max-age=0\r\n"
+  "Connection: keep-alive\r\n"
+  "Referer: http://www.example.com/\r\n"
+  "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark; locale=en_US; cart=3; "
+  "tracking=c9f0f895fb98ab9159f51fd0297e236d\r\n"
+  "X-Forwarded-For: 10.0.0.1, 10.0.0.2\r\n"
+  "\r\n";
+
+TSHttpTxn getBrowserTransaction() {
+  static TSHttpTxn txn = mock::createTransaction(BROWSER_REQUEST);
+  return txn;
+}
+
+void benchmarkTransactionCreateClose(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    keep(reinterpret_cast<size_t>(&transaction));
+    mock::closeTransaction(txn);
+  }
+}
+
+const char TOO_MANY_REQUESTS_PAGE[] = "<html><head><title>429 Too Many Requests</title></head>"
+                                     "<body><h1>Too Many Requests</h1></body></html>";
+
+void benchmarkSetErrorBody(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Transaction &transaction = utils::internal::getTransaction(txn);
+  for (size_t i = 0; i < iterations; ++i) {
+    transaction.setErrorBody(TOO_MANY_REQUESTS_PAGE);
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkSetResponseBody(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Transaction &transaction = utils::internal::getTransaction(txn);
+  for (size_t i = 0; i < iterations; ++i) {
+    transaction.setResponseBody(TOO_MANY_REQUESTS_PAGE, sizeof(TOO_MANY_REQUESTS_PAGE) - 1);
+  }
+  mock::closeTransaction(txn);
+}
+
+struct SessionState : SessionPlugin {
+  size_t computed_;
+  SessionState(Session &session, size_t computed) : SessionPlugin(session), computed_(computed) { }
+};
+
+/** Keep-alive transactions finding the state of their session, it's created by the first one only. */
+void benchmarkSessionPlugin(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Session &session = utils::internal::getTransaction(txn).getSession();
+    SessionState *state = session.findPlugin<SessionState>();
+    if (!state) {
+      state = new SessionState(session, i);
+      session.addPlugin(state);
+    }
+    keep(state->computed_);
+    mock::closeTransaction(txn);
+  }
+  if (utils::internal::getTransaction(txn).getSession().getTransactionCount() != iterations + 1) {
+    bench::fail("the transactions didn't share their session");
+  }
+  mock::closeTransaction(txn);
+  mock::closeSession(txn);
+}
+
+void benchmarkHeadersInit(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+    size_t count = 0;
+    for (Headers::const_iterator iter = headers.begin(), end = headers.end(); iter != end; ++iter) {
+      ++count;
+    }
+    if (count != 10) {
+      bench::fail("expected 10 headers");
+    }
+    keep(count);
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkGetValueViewWellKnown(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(headers.getValueView(HEADER_ACCEPT_ENCODING).size());
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkGetValueViewByName(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+  const string name("x-forwarded-for");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(headers.getValueView(name, 1).size());
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkGetValueViewMissing(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+  const string name("X-Not-There");
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(headers.getValueView(name).isNull());
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkRequestCookies(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+    const Headers::RequestCookieMap &cookies = headers.getRequestCookies();
+    if (cookies.size() != 5) {
+      bench::fail("expected 5 cookies");
+    }
+    keep(cookies.size());
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkFindRequestCookie(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+    StringView cart = headers.findRequestCookie("cart");
+    if (cart.size() != 1) {
+      bench::fail("cookie cart not found");
+    }
+    keep(cart.size());
+    mock::closeTransaction(txn);
+  }
+}
+
+// consent plugin style: a handful of edits to the cookies of every request
+void benchmarkEditCookies(size_t iterations) {
+  static TSHttpTxn txn = mock::createTransaction(BROWSER_REQUEST); // the edits stay, so they must be repeatable
+  for (size_t i = 0; i < iterations; ++i) {
+    Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+    headers.deleteCookie("tracking");
+    headers.setCookie("theme", "light");
+    headers.setCookie("locale", "de_DE");
+    headers.addCookie("consent", "analytics:0");
+    headers.setCookie("consent_version", "3");
+    headers.setCookie("cart", "4");
+    headers.deleteCookie("not_there");
+    headers.setCookie("consent", "analytics:1");
+    StringView cookie = headers.getValueView(HEADER_COOKIE);
+    if (cookie != "cart=4; consent=analytics:1; consent_version=3; locale=de_DE; "
+                  "session=8f14e45fceea167a5a36dedd4bea2543; theme=light") {
+      bench::fail("unexpected Cookie header after the edits");
+    }
+    keep(cookie.size());
+    mock::closeTransaction(txn);
+  }
+}
+
+const char TWO_COOKIE_FIELDS_REQUEST[] = "GET / HTTP/1.1\r\n"
+                                         "Host: www.example.com\r\n"
+                                         "Cookie: session=8f14e45fceea167a5a36dedd4bea2543; theme=dark\r\n"
+                                         "Cookie: cart=3\r\n"
+                                         "\r\n";
+
+bool hasCookieOnce(Headers &headers, const char *name) {
+  const Headers::RequestCookieMap &cookies = headers.getRequestCookies();
+  Headers::RequestCookieMap::const_iterator iter = cookies.find(name);
+  return (iter != cookies.end()) && (iter->second.size() == 1);
+}
+
+/** Appends go into the first of several Cookie fields, the parsed cookies must still match the header. */
+void benchmarkAppendCookiesTwoFields(size_t iterations) {
+  for (size_t i = 0; i < iterations; ++i) {
+    TSHttpTxn txn = mock::createTransaction(TWO_COOKIE_FIELDS_REQUEST);
+    Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+    if (headers.getRequestCookies().size() != 3) {
+      bench::fail("expected 3 cookies in two fields");
+    }
+    headers.append(HEADER_COOKIE, "locale=en_US");
+    Headers::Batch batch;
+    headers.apply(batch.append(HEADER_COOKIE, "consent=analytics:1"));
+    if ((headers.getRequestCookies().size() != 5) || !hasCookieOnce(headers, "session") ||
+        !hasCookieOnce(headers, "theme") || !hasCookieOnce(headers, "cart") || !hasCookieOnce(headers, "locale") ||
+        !hasCookieOnce(headers, "consent")) {
+      bench::fail("appended cookies were lost or duplicated");
+    }
+    keep(headers.getRequestCookies().size());
+    mock::destroyTransaction(txn);
+  }
+}
+
+void benchmarkSerialize(size_t iterations) {
+  TSHttpTxn txn = getBrowserTransaction();
+  Headers &headers = utils::internal::getTransaction(txn).getClientRequest().getHeaders();
+  string serialized;
+  for (size_t i = 0; i < iterations; ++i) {
+    serialized.clear();
+    headers.serialize(serialized);
+    keep(serialized.size());
+  }
+  mock::closeTransaction(txn);
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(transaction.create_close, benchmarkTransactionCreateClose);
+BENCHMARK(transaction.set_error_body, benchmarkSetErrorBody);
+BENCHMARK(transaction.set_response_body, benchmarkSetResponseBody);
+BENCHMARK(transaction.session_plugin, benchmarkSessionPlugin);
+BENCHMARK(headers.init, benchmarkHeadersInit);
+BENCHMARK(headers.get_value_view.well_known, benchmarkGetValueViewWellKnown);
+BENCHMARK(headers.get_value_view.by_name, benchmarkGetValueViewByName);
+BENCHMARK(headers.get_value_view.missing, benchmarkGetValueViewMissing);
+BENCHMARK(headers.request_cookies, benchmarkRequestCookies);
+BENCHMARK(headers.find_request_cookie, benchmarkFindRequestCookie);
+BENCHMARK(headers.edit_cookies, benchmarkEditCookies);
+BENCHMARK(headers.append_cookies.two_fields, benchmarkAppendCookiesTwoFields);
+BENCHMARK(headers.serialize, benchmarkSerialize);
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file LruCacheBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * ShardedLruCache lookups and inserts, by one thread and by several contending threads. The contended runs
+ * compare a single shard, which is a cache behind one lock, with the default sharding.
+ */
+
+#include "Benchmark.h"
+#include <atscppapi/ShardedLruCache.h>
+#include <cstdio>
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+using namespace atscppapi;
+using atscppapi::bench::keep;
+using std::string;
+using std::vector;
+
+namespace {
+
+const size_t KEY_COUNT = 16 * 1024;
+const size_t ENTRY_BYTES = 256;
+const size_t THREAD_COUNT = 4;
+
+typedef ShardedLruCache<string, size_t> Cache;
+
+const vector<string> &getKeys() {
+  static vector<string> keys;
+  if (keys.empty()) {
+    char key[64];
+    for (size_t i = 0; i < KEY_COUNT; ++i) {
+      snprintf(key, sizeof(key), "token-%08zx-%zu", i * 2654435761u, i);
+      keys.push_back(key);
+    }
+  }
+  return keys;
+}
+
+/** A cache holding every key, with 1 or the default number of shards. */
+Cache &getFilledCache(size_t shard_count) {
+  static Cache *caches[2] = { NULL, NULL };
+  Cache *&cache = caches[(shard_count == 1) ? 0 : 1];
+  if (!cache) {
+    cache = new Cache(KEY_COUNT * ENTRY_BYTES * 2, shard_count);
+    const vector<string> &keys = getKeys();
+    for (size_t i = 0; i < keys.size(); ++i) {
+      cache->put(keys[i], i, ENTRY_BYTES);
+    }
+  }
+  return *cache;
+}
+
+size_t lookUp(Cache &cache, size_t first, size_t iterations) {
+  const vector<string> &keys = getKeys();
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    size_t index = (first + i * 7) % KEY_COUNT;
+    size_t value;
+    if (cache.get(StringView(keys[index]), value) && (value == index)) {
+      ++found;
+    }
+  }
+  return found;
+}
+
+void benchmarkGetHit(size_t iterations) {
+  size_t found = lookUp(getFilledCache(ShardedLruCacheBase::DEFAULT_SHARD_COUNT), 0, iterations);
+  if (found != iterations) {
+    bench::fail("a cached key was missed or had the wrong value");
+  }
+  keep(found);
+}
+
+void benchmarkGetMiss(size_t iterations) {
+  Cache &cache = getFilledCache(ShardedLruCacheBase::DEFAULT_SHARD_COUNT);
+  size_t value;
+  size_t found = 0;
+  for (size_t i = 0; i < iterations; ++i) {
+    found += cache.get(StringView("token-not-cached"), value);
+  }
+  if (found) {
+    bench::fail("a key that was never added was found");
+  }
+  keep(found);
+}
+
+/** Every put evicts, the cache holds an eighth of the keys. */
+void benchmarkPutEvict(size_t iterations) {
+  static Cache cache(KEY_COUNT / 8 * ENTRY_BYTES);
+  const vector<string> &keys = getKeys();
+  for (size_t i = 0; i < iterations; ++i) {
+    cache.put(keys[i % KEY_COUNT], i, ENTRY_BYTES);
+  }
+  if (cache.getSize() > KEY_COUNT / 8 * ENTRY_BYTES) {
+    bench::fail("the cache grew over its capacity");
+  }
+  keep(cache.getEntryCount());
+}
+
+struct LookUpThread {
+  pthread_t thread_;
+  Cache *cache_;
+  size_t first_;
+  size_t iterations_;
+  size_t found_;
+};
+
+void *runLookUps(void *data) {
+  LookUpThread *thread = static_cast<LookUpThread *>(data);
+  thread->found_ = lookUp(*thread->cache_, thread->first_, thread->iterations_);
+  return NULL;
+}
+
+/** The iterations are split between the threads, so the time per operation is that of the whole machine. */
+void getHitContended(size_t shard_count, size_t iterations) {
+  LookUpThread threads[THREAD_COUNT];
+  for (size_t i = 0; i < THREAD_COUNT; ++i) {
+    threads[i].cache_ = &getFilledCache(shard_count);
+    threads[i].first_ = i * (KEY_COUNT / THREAD_COUNT);
+    threads[i].iterations_ = iterations / THREAD_COUNT + 1;
+    pthread_create(&threads[i].thread_, NULL, runLookUps, &threads[i]);
+  }
+  for (size_t i = 0; i < THREAD_COUNT; ++i) {
+    pthread_join(threads[i].thread_, NULL);
+    if (threads[i].found_ != threads[i].iterations_) {
+      bench::fail("a cached key was missed or had the wrong value");
+    }
+    keep(threads[i].found_);
+  }
+}
+
+void benchmarkGetHitContendedOneShard(size_t iterations) {
+  getHitContended(1, iterations);
+}
+
+void benchmarkGetHitContended(size_t iterations) {
+  getHitContended(ShardedLruCacheBase::DEFAULT_SHARD_COUNT, iterations);
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(lru.get_hit, benchmarkGetHit);
+BENCHMARK(lru.get_miss, benchmarkGetMiss);
+BENCHMARK(lru.put_evict, benchmarkPutEvict);
+BENCHMARK(lru.get_hit.4_threads.1_shard, benchmarkGetHitContendedOneShard);
+BENCHMARK(lru.get_hit.4_threads, benchmarkGetHitContended);
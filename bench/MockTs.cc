@@ -0,0 +1,2068 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file MockTs.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * An in-memory implementation of the parts of the Traffic Server API that the library calls, see MockTs.h.
+ * The handles of the API point to the structures defined here, casting them is all the type checking
+ * there is: like the real API, passing a handle of the wrong kind is undefined.
+ */
+
+#include "MockTs.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <pthread.h>
+#include <strings.h>
+#include <arpa/inet.h>
+
+using std::string;
+using std::vector;
+
+/*
+ * The interned strings of Traffic Server, the library compares some of them by address.
+ */
+
+#define MOCK_MIME_FIELD(NAME, VALUE) \
+  const char *TS_MIME_FIELD_##NAME = VALUE; \
+  int TS_MIME_LEN_##NAME = sizeof(VALUE) - 1
+
+MOCK_MIME_FIELD(ACCEPT, "Accept");
+MOCK_MIME_FIELD(ACCEPT_ENCODING, "Accept-Encoding");
+MOCK_MIME_FIELD(AUTHORIZATION, "Authorization");
+MOCK_MIME_FIELD(CACHE_CONTROL, "Cache-Control");
+MOCK_MIME_FIELD(CONNECTION, "Connection");
+MOCK_MIME_FIELD(CONTENT_ENCODING, "Content-Encoding");
+MOCK_MIME_FIELD(CONTENT_LENGTH, "Content-Length");
+MOCK_MIME_FIELD(CONTENT_TYPE, "Content-Type");
+MOCK_MIME_FIELD(COOKIE, "Cookie");
+MOCK_MIME_FIELD(DATE, "Date");
+MOCK_MIME_FIELD(ETAG, "ETag");
+MOCK_MIME_FIELD(EXPIRES, "Expires");
+MOCK_MIME_FIELD(HOST, "Host");
+MOCK_MIME_FIELD(IF_MODIFIED_SINCE, "If-Modified-Since");
+MOCK_MIME_FIELD(IF_NONE_MATCH, "If-None-Match");
+MOCK_MIME_FIELD(LAST_MODIFIED, "Last-Modified");
+MOCK_MIME_FIELD(LOCATION, "Location");
+MOCK_MIME_FIELD(RANGE, "Range");
+MOCK_MIME_FIELD(REFERER, "Referer");
+MOCK_MIME_FIELD(SET_COOKIE, "Set-Cookie");
+MOCK_MIME_FIELD(TRANSFER_ENCODING, "Transfer-Encoding");
+MOCK_MIME_FIELD(USER_AGENT, "User-Agent");
+MOCK_MIME_FIELD(VARY, "Vary");
+MOCK_MIME_FIELD(VIA, "Via");
+MOCK_MIME_FIELD(X_FORWARDED_FOR, "X-Forwarded-For");
+
+#undef MOCK_MIME_FIELD
+
+const char *TS_HTTP_METHOD_CONNECT = "CONNECT";
+const char *TS_HTTP_METHOD_DELETE = "DELETE";
+const char *TS_HTTP_METHOD_GET = "GET";
+const char *TS_HTTP_METHOD_HEAD = "HEAD";
+const char *TS_HTTP_METHOD_ICP_QUERY = "ICP_QUERY";
+const char *TS_HTTP_METHOD_OPTIONS = "OPTIONS";
+const char *TS_HTTP_METHOD_POST = "POST";
+const char *TS_HTTP_METHOD_PURGE = "PURGE";
+const char *TS_HTTP_METHOD_PUT = "PUT";
+const char *TS_HTTP_METHOD_TRACE = "TRACE";
+
+namespace {
+
+const char * const *WELL_KNOWN_FIELDS[] = {
+  &TS_MIME_FIELD_ACCEPT, &TS_MIME_FIELD_ACCEPT_ENCODING, &TS_MIME_FIELD_AUTHORIZATION, &TS_MIME_FIELD_CACHE_CONTROL,
+  &TS_MIME_FIELD_CONNECTION, &TS_MIME_FIELD_CONTENT_ENCODING, &TS_MIME_FIELD_CONTENT_LENGTH,
+  &TS_MIME_FIELD_CONTENT_TYPE, &TS_MIME_FIELD_COOKIE, &TS_MIME_FIELD_DATE, &TS_MIME_FIELD_ETAG,
+  &TS_MIME_FIELD_EXPIRES, &TS_MIME_FIELD_HOST, &TS_MIME_FIELD_IF_MODIFIED_SINCE, &TS_MIME_FIELD_IF_NONE_MATCH,
+  &TS_MIME_FIELD_LAST_MODIFIED, &TS_MIME_FIELD_LOCATION, &TS_MIME_FIELD_RANGE, &TS_MIME_FIELD_REFERER,
+  &TS_MIME_FIELD_SET_COOKIE, &TS_MIME_FIELD_TRANSFER_ENCODING, &TS_MIME_FIELD_USER_AGENT, &TS_MIME_FIELD_VARY,
+  &TS_MIME_FIELD_VIA, &TS_MIME_FIELD_X_FORWARDED_FOR
+};
+
+const char * const *WELL_KNOWN_METHODS[] = {
+  &TS_HTTP_METHOD_CONNECT, &TS_HTTP_METHOD_DELETE, &TS_HTTP_METHOD_GET, &TS_HTTP_METHOD_HEAD,
+  &TS_HTTP_METHOD_ICP_QUERY, &TS_HTTP_METHOD_OPTIONS, &TS_HTTP_METHOD_POST, &TS_HTTP_METHOD_PURGE,
+  &TS_HTTP_METHOD_PUT, &TS_HTTP_METHOD_TRACE
+};
+
+/** @return The interned string equal to name ignoring case, NULL if there isn't one. */
+const char *intern(const char * const *const table[], size_t table_size, const char *name, size_t length,
+                   bool ignore_case) {
+  for (size_t i = 0; i < table_size; ++i) {
+    const char *interned = *table[i];
+    if ((strlen(interned) == length) &&
+        ((ignore_case ? strncasecmp(interned, name, length) : strncmp(interned, name, length)) == 0)) {
+      return interned;
+    }
+  }
+  return NULL;
+}
+
+const size_t TXN_ARG_COUNT = 16;
+const int64_t DEFAULT_BLOCK_SIZE = 32 * 1024; // the default block size Traffic Server uses for plugin IOBuffers
+
+bool debug_enabled = (getenv("ATSCPPAPI_BENCH_DEBUG") != NULL);
+
+/*
+ * Continuations and events
+ */
+
+struct MockMutex {
+  pthread_mutex_t mutex_;
+  MockMutex() {
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&mutex_, &attr);
+    pthread_mutexattr_destroy(&attr);
+  }
+  ~MockMutex() {
+    pthread_mutex_destroy(&mutex_);
+  }
+};
+
+struct MockVio;
+
+/** A continuation, also used for VConns: the transformations and the sink behind the last of them. */
+struct MockCont {
+  TSEventFunc func_;
+  TSMutex mutex_;
+  void *data_;
+  bool transform_;
+  TSHttpTxn txn_;
+  MockVio *write_vio_; // the write into this VConn
+  MockCont *output_; // where a transformation writes to
+  bool closed_;
+  // the sink only
+  string *sink_output_;
+  int64_t sink_bytes_;
+  bool sink_complete_;
+
+  MockCont(TSEventFunc func, TSMutex mutex)
+    : func_(func), mutex_(mutex), data_(NULL), transform_(false), txn_(NULL), write_vio_(NULL), output_(NULL),
+      closed_(false), sink_output_(NULL), sink_bytes_(0), sink_complete_(false) { }
+};
+
+struct MockVio {
+  MockCont *cont_; // called back about the progress of the write
+  MockCont *vconn_; // written to
+  TSIOBufferReader reader_;
+  int64_t nbytes_;
+  int64_t ndone_;
+};
+
+struct MockAction {
+  MockCont *cont_;
+  bool periodic_;
+};
+
+struct Event {
+  MockCont *cont_;
+  TSEvent event_;
+  void *edata_;
+  MockAction *action_; // NULL unless the event was scheduled through the API
+};
+
+std::deque<Event> pending_events;
+std::set<MockCont *> live_conts;
+
+void queueEvent(MockCont *cont, TSEvent event, void *edata, MockAction *action = NULL) {
+  if (!action) {
+    // a VConn that is reenabled twice before it runs only needs to run once
+    for (std::deque<Event>::const_iterator iter = pending_events.begin(), end = pending_events.end(); iter != end;
+         ++iter) {
+      if ((iter->cont_ == cont) && (iter->event_ == event) && (iter->edata_ == edata) && !iter->action_) {
+        return;
+      }
+    }
+  }
+  Event queued = { cont, event, edata, action };
+  pending_events.push_back(queued);
+}
+
+MockCont *cont(TSCont contp) {
+  return reinterpret_cast<MockCont *>(contp);
+}
+
+MockVio *vio(TSVIO viop) {
+  return reinterpret_cast<MockVio *>(viop);
+}
+
+/*
+ * IOBuffers
+ *
+ * The data lives in reference counted chunks, a block is a range of a chunk. TSIOBufferCopy() appends blocks
+ * sharing the chunks of the source instead of copying the bytes, as Traffic Server does.
+ */
+
+struct MockChunk {
+  char *data_;
+  int64_t size_;
+  int64_t used_;
+  int refs_;
+};
+
+struct MockBlock {
+  MockChunk *chunk_;
+  int64_t start_;
+  int64_t end_;
+  int64_t position_; // of start_ in the stream of bytes written to the buffer
+  MockBlock *next_;
+};
+
+struct MockIOBuffer;
+
+struct MockReader {
+  MockIOBuffer *buffer_;
+  int64_t position_;
+};
+
+struct MockIOBuffer {
+  MockBlock *head_;
+  MockBlock *tail_;
+  int64_t write_position_;
+  vector<MockReader *> readers_;
+};
+
+MockIOBuffer *iobuffer(TSIOBuffer bufp) {
+  return reinterpret_cast<MockIOBuffer *>(bufp);
+}
+
+MockReader *reader(TSIOBufferReader readerp) {
+  return reinterpret_cast<MockReader *>(readerp);
+}
+
+void releaseChunk(MockChunk *chunk) {
+  if (--chunk->refs_ == 0) {
+    free(chunk->data_);
+    delete chunk;
+  }
+}
+
+void appendBlock(MockIOBuffer *buffer, MockChunk *chunk, int64_t start, int64_t end) {
+  MockBlock *block = new MockBlock();
+  block->chunk_ = chunk;
+  block->start_ = start;
+  block->end_ = end;
+  block->position_ = buffer->write_position_;
+  block->next_ = NULL;
+  ++chunk->refs_;
+  if (buffer->tail_) {
+    buffer->tail_->next_ = block;
+  } else {
+    buffer->head_ = block;
+  }
+  buffer->tail_ = block;
+  buffer->write_position_ += end - start;
+}
+
+/** Drops the blocks all the readers are done with. */
+void trimBuffer(MockIOBuffer *buffer) {
+  if (buffer->readers_.empty()) {
+    return;
+  }
+  int64_t position = buffer->write_position_;
+  for (size_t i = 0; i < buffer->readers_.size(); ++i) {
+    position = std::min(position, buffer->readers_[i]->position_);
+  }
+  while (buffer->head_ && (buffer->head_->position_ + (buffer->head_->end_ - buffer->head_->start_) <= position)) {
+    MockBlock *block = buffer->head_;
+    buffer->head_ = block->next_;
+    if (!buffer->head_) {
+      buffer->tail_ = NULL;
+    }
+    releaseChunk(block->chunk_);
+    delete block;
+  }
+}
+
+/** @return The first block holding data of reader, NULL if it has read everything. */
+MockBlock *firstBlock(MockReader *reader) {
+  for (MockBlock *block = reader->buffer_->head_; block; block = block->next_) {
+    if (block->position_ + (block->end_ - block->start_) > reader->position_) {
+      return block;
+    }
+  }
+  return NULL;
+}
+
+const char *blockData(MockBlock *block, MockReader *reader, int64_t *avail) {
+  int64_t skip = std::max(static_cast<int64_t>(0), reader->position_ - block->position_);
+  int64_t length = block->end_ - block->start_;
+  *avail = (skip < length) ? (length - skip) : 0;
+  return block->chunk_->data_ + block->start_ + std::min(skip, length);
+}
+
+/*
+ * Marshal buffers
+ */
+
+struct MockObject {
+  virtual ~MockObject() { }
+};
+
+struct MockHdr;
+
+struct MockField : MockObject {
+  string name_;
+  const char *interned_name_; // set for the well known names
+  string value_;
+  MockHdr *hdr_; // NULL while the field isn't in a header
+  size_t index_;
+
+  MockField() : interned_name_(NULL), hdr_(NULL), index_(0) { }
+
+  void setName(const char *name, size_t length) {
+    name_.assign(name, length);
+    interned_name_ = intern(WELL_KNOWN_FIELDS, sizeof(WELL_KNOWN_FIELDS) / sizeof(WELL_KNOWN_FIELDS[0]), name,
+                            length, true);
+  }
+};
+
+struct MockUrl : MockObject {
+  string scheme_;
+  string user_;
+  string password_;
+  string host_;
+  int port_; // 0 unless the url has a port
+  string path_; // without the leading slash
+  string query_;
+  string fragment_;
+
+  MockUrl() : port_(0) { }
+
+  void clear() {
+    scheme_.clear();
+    user_.clear();
+    password_.clear();
+    host_.clear();
+    port_ = 0;
+    path_.clear();
+    query_.clear();
+    fragment_.clear();
+  }
+};
+
+struct MockHdr : MockObject {
+  TSHttpType type_;
+  string method_;
+  const char *interned_method_;
+  int version_;
+  TSHttpStatus status_;
+  string reason_;
+  MockUrl *url_;
+  vector<MockField *> fields_;
+
+  MockHdr() : type_(TS_HTTP_TYPE_UNKNOWN), interned_method_(NULL), version_(TS_HTTP_VERSION(1, 1)),
+              status_(static_cast<TSHttpStatus>(0)), url_(NULL) { }
+
+  void setMethod(const char *method, size_t length) {
+    method_.assign(method, length);
+    interned_method_ = intern(WELL_KNOWN_METHODS, sizeof(WELL_KNOWN_METHODS) / sizeof(WELL_KNOWN_METHODS[0]),
+                              method, length, false);
+  }
+
+  void attach(MockField *field) {
+    field->hdr_ = this;
+    field->index_ = fields_.size();
+    fields_.push_back(field);
+  }
+
+  void detach(MockField *field) {
+    if (field->hdr_ != this) {
+      return;
+    }
+    fields_.erase(fields_.begin() + field->index_);
+    for (size_t i = field->index_; i < fields_.size(); ++i) {
+      fields_[i]->index_ = i;
+    }
+    field->hdr_ = NULL;
+  }
+};
+
+/** Owns everything created in it, the objects live until the buffer is destroyed. */
+struct MockMBuffer {
+  vector<MockObject *> objects_;
+
+  template <typename T> T *create() {
+    T *object = new T();
+    objects_.push_back(object);
+    return object;
+  }
+
+  ~MockMBuffer() {
+    for (size_t i = 0; i < objects_.size(); ++i) {
+      delete objects_[i];
+    }
+  }
+};
+
+MockMBuffer *mbuffer(TSMBuffer bufp) {
+  return reinterpret_cast<MockMBuffer *>(bufp);
+}
+
+MockHdr *hdr(TSMLoc loc) {
+  return static_cast<MockHdr *>(reinterpret_cast<MockObject *>(loc));
+}
+
+MockField *field(TSMLoc loc) {
+  return static_cast<MockField *>(reinterpret_cast<MockObject *>(loc));
+}
+
+MockUrl *url(TSMLoc loc) {
+  return static_cast<MockUrl *>(reinterpret_cast<MockObject *>(loc));
+}
+
+TSMLoc loc(MockObject *object) {
+  return reinterpret_cast<TSMLoc>(object);
+}
+
+/** Splits a field value at the commas outside of quotes, as Traffic Server does for its values. */
+void splitValues(const string &value, vector<std::pair<size_t, size_t> > &values) {
+  values.clear();
+  size_t start = 0;
+  bool quoted = false;
+  for (size_t i = 0; i <= value.size(); ++i) {
+    if ((i < value.size()) && value[i] == '"') {
+      quoted = !quoted;
+    }
+    if ((i == value.size()) || ((value[i] == ',') && !quoted)) {
+      size_t begin = start, end = i;
+      while ((begin < end) && ((value[begin] == ' ') || (value[begin] == '\t'))) {
+        ++begin;
+      }
+      while ((end > begin) && ((value[end - 1] == ' ') || (value[end - 1] == '\t'))) {
+        --end;
+      }
+      if ((begin < end) || (i < value.size()) || !values.empty()) {
+        values.push_back(std::make_pair(begin, end - begin));
+      }
+      start = i + 1;
+    }
+  }
+  if ((values.size() == 1) && (values[0].second == 0)) {
+    values.clear(); // an empty value has no values
+  }
+}
+
+void appendVersion(string &out, int version) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "HTTP/%d.%d", TS_HTTP_MAJOR(version), TS_HTTP_MINOR(version));
+  out.append(buf);
+}
+
+void printUrl(const MockUrl &url, string &out) {
+  if (!url.host_.empty()) {
+    if (!url.scheme_.empty()) {
+      out.append(url.scheme_).append("://");
+    } else {
+      out.append("//");
+    }
+    if (!url.user_.empty()) {
+      out.append(url.user_);
+      if (!url.password_.empty()) {
+        out.append(":").append(url.password_);
+      }
+      out.append("@");
+    }
+    out.append(url.host_);
+    if (url.port_) {
+      char port[16];
+      snprintf(port, sizeof(port), ":%d", url.port_);
+      out.append(port);
+    }
+  }
+  out.append("/").append(url.path_);
+  if (!url.query_.empty()) {
+    out.append("?").append(url.query_);
+  }
+  if (!url.fragment_.empty()) {
+    out.append("#").append(url.fragment_);
+  }
+}
+
+void printHdr(const MockHdr &hdr, string &out) {
+  if (hdr.type_ == TS_HTTP_TYPE_REQUEST) {
+    out.append(hdr.method_).append(" ");
+    if (hdr.url_) {
+      printUrl(*hdr.url_, out);
+    }
+    out.append(" ");
+    appendVersion(out, hdr.version_);
+  } else {
+    appendVersion(out, hdr.version_);
+    char status[16];
+    snprintf(status, sizeof(status), " %d ", static_cast<int>(hdr.status_));
+    out.append(status).append(hdr.reason_);
+  }
+  out.append("\r\n");
+  for (size_t i = 0; i < hdr.fields_.size(); ++i) {
+    out.append(hdr.fields_[i]->name_).append(": ").append(hdr.fields_[i]->value_).append("\r\n");
+  }
+  out.append("\r\n");
+}
+
+bool parseUrl(const char *start, const char *end, MockUrl &url) {
+  url.clear();
+  const char *p = start;
+  const char *scheme_end = std::search(p, end, "://", "://" + 3);
+  bool has_scheme = (scheme_end != end) && (std::find(p, end, '/') == scheme_end + 1); // no slash before ://
+  if (has_scheme || ((p < end - 1) && (p[0] == '/') && (p[1] == '/'))) {
+    if (has_scheme) {
+      url.scheme_.assign(p, scheme_end);
+      p = scheme_end + 3;
+    } else {
+      p += 2;
+    }
+    const char *authority_end = p;
+    while ((authority_end < end) && (*authority_end != '/') && (*authority_end != '?') && (*authority_end != '#')) {
+      ++authority_end;
+    }
+    const char *at = std::find(p, authority_end, '@');
+    if (at != authority_end) {
+      const char *colon = std::find(p, at, ':');
+      url.user_.assign(p, colon);
+      if (colon != at) {
+        url.password_.assign(colon + 1, at);
+      }
+      p = at + 1;
+    }
+    const char *host_end = authority_end;
+    const char *port_start = NULL;
+    if ((p < authority_end) && (*p == '[')) {
+      const char *bracket = std::find(p, authority_end, ']');
+      if (bracket == authority_end) {
+        return false;
+      }
+      host_end = bracket + 1;
+      if ((host_end < authority_end) && (*host_end == ':')) {
+        port_start = host_end + 1;
+      }
+    } else {
+      const char *colon = std::find(p, authority_end, ':');
+      if (colon != authority_end) {
+        host_end = colon;
+        port_start = colon + 1;
+      }
+    }
+    url.host_.assign(p, host_end);
+    if (port_start) {
+      url.port_ = atoi(string(port_start, authority_end).c_str());
+    }
+    p = authority_end;
+  } else if ((p < end) && (*p != '/')) {
+    return (p < end) && (*p == '*') && (p + 1 == end); // OPTIONS *
+  }
+  if ((p < end) && (*p == '/')) {
+    ++p;
+  }
+  const char *path_end = p;
+  while ((path_end < end) && (*path_end != '?') && (*path_end != '#')) {
+    ++path_end;
+  }
+  url.path_.assign(p, path_end);
+  p = path_end;
+  if ((p < end) && (*p == '?')) {
+    const char *query_end = std::find(p + 1, end, '#');
+    url.query_.assign(p + 1, query_end);
+    p = query_end;
+  }
+  if ((p < end) && (*p == '#')) {
+    url.fragment_.assign(p + 1, end);
+  }
+  return true;
+}
+
+/** Parses a complete head, the lines may end with CRLF or LF. */
+bool parseHead(MockMBuffer *buffer, MockHdr *hdr, const char *start, const char *end, bool request) {
+  hdr->fields_.clear();
+  const char *line = start;
+  bool first = true;
+  while (line < end) {
+    const char *line_end = std::find(line, end, '\n');
+    const char *content_end = ((line_end > line) && (line_end[-1] == '\r')) ? line_end - 1 : line_end;
+    if (content_end == line) {
+      break; // the empty line ending the head
+    }
+    if (first) {
+      first = false;
+      const char *space = std::find(line, content_end, ' ');
+      if (space == content_end) {
+        return false;
+      }
+      if (request) {
+        const char *target_end = std::find(space + 1, content_end, ' ');
+        if ((target_end == content_end) || (content_end - target_end < 9) || strncmp(target_end + 1, "HTTP/", 5)) {
+          return false;
+        }
+        hdr->type_ = TS_HTTP_TYPE_REQUEST;
+        hdr->setMethod(line, space - line);
+        if (!hdr->url_) {
+          hdr->url_ = buffer->create<MockUrl>();
+        }
+        if (!parseUrl(space + 1, target_end, *hdr->url_)) {
+          return false;
+        }
+        hdr->version_ = TS_HTTP_VERSION(atoi(target_end + 6), atoi(target_end + 8));
+      } else {
+        if ((space - line < 8) || strncmp(line, "HTTP/", 5)) {
+          return false;
+        }
+        hdr->type_ = TS_HTTP_TYPE_RESPONSE;
+        hdr->version_ = TS_HTTP_VERSION(atoi(line + 5), atoi(line + 7));
+        hdr->status_ = static_cast<TSHttpStatus>(atoi(space + 1));
+        const char *reason = std::find(space + 1, content_end, ' ');
+        hdr->reason_.assign((reason < content_end) ? reason + 1 : content_end, content_end);
+      }
+    } else if ((*line == ' ') || (*line == '\t')) {
+      if (hdr->fields_.empty()) {
+        return false;
+      }
+      hdr->fields_.back()->value_.append(" ").append(line + 1, content_end); // an obsolete folded line
+    } else {
+      const char *colon = std::find(line, content_end, ':');
+      if ((colon == content_end) || (colon == line)) {
+        return false;
+      }
+      const char *value = colon + 1;
+      while ((value < content_end) && ((*value == ' ') || (*value == '\t'))) {
+        ++value;
+      }
+      const char *value_end = content_end;
+      while ((value_end > value) && ((value_end[-1] == ' ') || (value_end[-1] == '\t'))) {
+        --value_end;
+      }
+      MockField *field = buffer->create<MockField>();
+      field->setName(line, colon - line);
+      field->value_.assign(value, value_end);
+      hdr->attach(field);
+    }
+    line = line_end + 1;
+  }
+  return !first;
+}
+
+/** @return The end of the head in data, NULL if it isn't complete. */
+const char *findHeadEnd(const char *data, const char *end) {
+  for (const char *p = data; p < end; ++p) {
+    if (*p == '\n') {
+      if ((p + 1 < end) && (p[1] == '\n')) {
+        return p + 2;
+      }
+      if ((p + 2 < end) && (p[1] == '\r') && (p[2] == '\n')) {
+        return p + 3;
+      }
+    }
+  }
+  return NULL;
+}
+
+struct MockParser {
+  string pending_;
+};
+
+/*
+ * Transactions
+ */
+
+struct Hook {
+  TSHttpHookID id_;
+  MockCont *cont_;
+};
+
+/** The client session of a MockTxn, it stays open across closeTransaction() like a keep-alive connection. */
+struct MockSsn {
+  void *args_[TXN_ARG_COUNT];
+  vector<Hook> hooks_;
+
+  MockSsn() {
+    memset(args_, 0, sizeof(args_));
+  }
+};
+
+struct MockTxn {
+  TSMBuffer client_request_buf_;
+  TSMLoc client_request_hdr_;
+  TSMBuffer pristine_buf_;
+  TSMLoc pristine_url_;
+  TSMBuffer response_buf_;
+  TSMLoc server_response_hdr_;
+  TSMLoc client_response_hdr_;
+  void *args_[TXN_ARG_COUNT];
+  vector<Hook> hooks_;
+  int cache_lookup_status_;
+  sockaddr_in client_addr_;
+  sockaddr_in incoming_addr_;
+  sockaddr_in server_addr_;
+  TSHttpStatus ret_status_;
+  char *error_body_;
+  char *error_body_type_;
+  string cache_url_;
+  MockSsn session_;
+
+  MockTxn() : client_request_buf_(NULL), client_request_hdr_(NULL), pristine_buf_(NULL), pristine_url_(NULL),
+              response_buf_(NULL), server_response_hdr_(NULL), client_response_hdr_(NULL), cache_lookup_status_(-1),
+              ret_status_(static_cast<TSHttpStatus>(0)), error_body_(NULL), error_body_type_(NULL) {
+    memset(args_, 0, sizeof(args_));
+    setAddress(client_addr_, "127.0.0.1", 50000);
+    setAddress(incoming_addr_, "127.0.0.1", 8080);
+    setAddress(server_addr_, "127.0.0.1", 80);
+  }
+
+  static void setAddress(sockaddr_in &addr, const char *ip, int port) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+  }
+
+  void resetResult() {
+    TSfree(error_body_);
+    TSfree(error_body_type_);
+    error_body_ = NULL;
+    error_body_type_ = NULL;
+    ret_status_ = static_cast<TSHttpStatus>(0);
+    cache_url_.clear();
+  }
+};
+
+MockTxn *txn(TSHttpTxn txnp) {
+  return reinterpret_cast<MockTxn *>(txnp);
+}
+
+int reserved_txn_args = 0;
+
+struct TransformationRun {
+  bool error_;
+  bool input_complete_;
+};
+
+/** The upstream of the first transformation, it only needs to notice failures. */
+int handleUpstreamEvents(TSCont contp, TSEvent event, void * /* edata ATS_UNUSED */) {
+  TransformationRun *run = static_cast<TransformationRun *>(TSContDataGet(contp));
+  if (event == TS_EVENT_ERROR) {
+    run->error_ = true;
+  } else if (event == TS_EVENT_VCONN_WRITE_COMPLETE) {
+    run->input_complete_ = true;
+  }
+  return 0;
+}
+
+/** Reads whatever the last transformation wrote, as the client connection would. */
+int handleSinkEvents(TSCont contp, TSEvent /* event ATS_UNUSED */, void * /* edata ATS_UNUSED */) {
+  MockCont *sink = cont(contp);
+  MockVio *write_vio = sink->write_vio_;
+  if (!write_vio || sink->sink_complete_) {
+    return 0;
+  }
+  MockReader *input = reader(write_vio->reader_);
+  int64_t avail = TSIOBufferReaderAvail(write_vio->reader_);
+  int64_t todo = write_vio->nbytes_ - write_vio->ndone_;
+  int64_t length = std::min(avail, todo);
+  if (length > 0) {
+    if (sink->sink_output_) {
+      int64_t remaining = length;
+      for (MockBlock *block = firstBlock(input); block && remaining; block = block->next_) {
+        int64_t block_avail;
+        const char *data = blockData(block, input, &block_avail);
+        int64_t block_length = std::min(block_avail, remaining);
+        sink->sink_output_->append(data, block_length);
+        remaining -= block_length;
+      }
+    }
+    TSIOBufferReaderConsume(write_vio->reader_, length);
+    write_vio->ndone_ += length;
+    sink->sink_bytes_ += length;
+  }
+  if (write_vio->ndone_ >= write_vio->nbytes_) {
+    sink->sink_complete_ = true;
+    queueEvent(write_vio->cont_, TS_EVENT_VCONN_WRITE_COMPLETE, write_vio);
+  } else if (length > 0) {
+    queueEvent(write_vio->cont_, TS_EVENT_VCONN_WRITE_READY, write_vio);
+  }
+  return 0;
+}
+
+struct MockStat {
+  string name_;
+  int64_t value_;
+};
+
+vector<MockStat> stats;
+
+} /* anonymous namespace */
+
+/*
+ * Memory and logging
+ */
+
+#ifdef TSmalloc
+// Traffic Server passes the allocation site to its allocator through these macros.
+void *_TSmalloc(size_t size, const char * /* path ATS_UNUSED */) {
+  return malloc(size);
+}
+
+void *_TSrealloc(void *ptr, size_t size, const char * /* path ATS_UNUSED */) {
+  return realloc(ptr, size);
+}
+
+char *_TSstrdup(const char *str, int64_t length, const char * /* path ATS_UNUSED */) {
+  size_t size = (length < 0) ? strlen(str) : static_cast<size_t>(length);
+  char *copy = static_cast<char *>(malloc(size + 1));
+  memcpy(copy, str, size);
+  copy[size] = '\0';
+  return copy;
+}
+
+void _TSfree(void *ptr) {
+  free(ptr);
+}
+#else
+void *TSmalloc(size_t size) {
+  return malloc(size);
+}
+
+void *TSrealloc(void *ptr, size_t size) {
+  return realloc(ptr, size);
+}
+
+char *TSstrndup(const char *str, size_t length) {
+  char *copy = static_cast<char *>(malloc(length + 1));
+  memcpy(copy, str, length);
+  copy[length] = '\0';
+  return copy;
+}
+
+char *TSstrdup(const char *str) {
+  return TSstrndup(str, strlen(str));
+}
+
+void TSfree(void *ptr) {
+  free(ptr);
+}
+#endif
+
+void TSDebug(const char *tag, const char *format_str, ...) {
+  if (!debug_enabled) {
+    return;
+  }
+  va_list args;
+  va_start(args, format_str);
+  fprintf(stderr, "[%s] ", tag);
+  vfprintf(stderr, format_str, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+void TSError(const char *format_str, ...) {
+  va_list args;
+  va_start(args, format_str);
+  fprintf(stderr, "ERROR: ");
+  vfprintf(stderr, format_str, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+int TSIsDebugTagSet(const char * /* tag ATS_UNUSED */) {
+  return debug_enabled;
+}
+
+int64_t TShrtime() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+}
+
+/*
+ * Continuations, mutexes and actions
+ */
+
+TSCont TSContCreate(TSEventFunc funcp, TSMutex mutexp) {
+  MockCont *contp = new MockCont(funcp, mutexp);
+  live_conts.insert(contp);
+  return reinterpret_cast<TSCont>(contp);
+}
+
+void TSContDestroy(TSCont contp) {
+  MockCont *destroyed = cont(contp);
+  for (std::deque<Event>::iterator iter = pending_events.begin(); iter != pending_events.end();) {
+    if (iter->cont_ == destroyed) {
+      delete iter->action_;
+      iter = pending_events.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  live_conts.erase(destroyed);
+  if (destroyed->transform_) {
+    delete reinterpret_cast<MockMutex *>(destroyed->mutex_); // created along with the transformation
+  }
+  delete destroyed->write_vio_;
+  delete destroyed;
+}
+
+void TSContDataSet(TSCont contp, void *data) {
+  cont(contp)->data_ = data;
+}
+
+void *TSContDataGet(TSCont contp) {
+  return cont(contp)->data_;
+}
+
+TSMutex TSContMutexGet(TSCont contp) {
+  return cont(contp)->mutex_;
+}
+
+int TSContCall(TSCont contp, TSEvent event, void *edata) {
+  return cont(contp)->func_(contp, event, edata);
+}
+
+TSAction TSContSchedule(TSCont contp, int64_t timeout, TSThreadPool /* tp ATS_UNUSED */) {
+  MockAction *action = new MockAction();
+  action->cont_ = cont(contp);
+  action->periodic_ = false;
+  queueEvent(action->cont_, timeout ? TS_EVENT_TIMEOUT : TS_EVENT_IMMEDIATE, NULL, action);
+  return reinterpret_cast<TSAction>(action);
+}
+
+TSAction TSContScheduleEvery(TSCont contp, int64_t /* every ATS_UNUSED */, TSThreadPool /* tp ATS_UNUSED */) {
+  MockAction *action = new MockAction(); // never fires, see MockTs.h
+  action->cont_ = cont(contp);
+  action->periodic_ = true;
+  return reinterpret_cast<TSAction>(action);
+}
+
+#ifdef ATSCPPAPI_HAVE_SCHEDULE_ON_THREAD
+TSEventThread TSEventThreadSelf() {
+  return NULL;
+}
+
+TSAction TSContScheduleOnThread(TSCont contp, int64_t timeout, TSEventThread /* ethread ATS_UNUSED */) {
+  return TSContSchedule(contp, timeout, TS_THREAD_POOL_DEFAULT);
+}
+
+TSAction TSContScheduleEveryOnThread(TSCont contp, int64_t every, TSEventThread /* ethread ATS_UNUSED */) {
+  return TSContScheduleEvery(contp, every, TS_THREAD_POOL_DEFAULT);
+}
+#endif
+
+void TSActionCancel(TSAction actionp) {
+  MockAction *action = reinterpret_cast<MockAction *>(actionp);
+  for (std::deque<Event>::iterator iter = pending_events.begin(), end = pending_events.end(); iter != end; ++iter) {
+    if (iter->action_ == action) {
+      pending_events.erase(iter);
+      break;
+    }
+  }
+  delete action;
+}
+
+TSMutex TSMutexCreate() {
+  return reinterpret_cast<TSMutex>(new MockMutex());
+}
+
+void TSMutexLock(TSMutex mutexp) {
+  pthread_mutex_lock(&reinterpret_cast<MockMutex *>(mutexp)->mutex_);
+}
+
+void TSMutexUnlock(TSMutex mutexp) {
+  pthread_mutex_unlock(&reinterpret_cast<MockMutex *>(mutexp)->mutex_);
+}
+
+/*
+ * Marshal buffers and HTTP headers
+ */
+
+TSMBuffer TSMBufferCreate() {
+  return reinterpret_cast<TSMBuffer>(new MockMBuffer());
+}
+
+TSReturnCode TSMBufferDestroy(TSMBuffer bufp) {
+  delete mbuffer(bufp);
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSHandleMLocRelease(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* parent ATS_UNUSED */,
+                                 TSMLoc /* mloc ATS_UNUSED */) {
+  return TS_SUCCESS; // the objects belong to their buffer
+}
+
+TSMLoc TSHttpHdrCreate(TSMBuffer bufp) {
+  return loc(mbuffer(bufp)->create<MockHdr>());
+}
+
+TSReturnCode TSHttpHdrTypeSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, TSHttpType type) {
+  hdr(offset)->type_ = type;
+  return TS_SUCCESS;
+}
+
+int TSHttpHdrLengthGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset) {
+  string printed;
+  printHdr(*hdr(offset), printed);
+  return static_cast<int>(printed.size());
+}
+
+void TSHttpHdrPrint(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, TSIOBuffer iobufp) {
+  string printed;
+  printHdr(*hdr(offset), printed);
+  TSIOBufferWrite(iobufp, printed.data(), static_cast<int64_t>(printed.size()));
+}
+
+int TSHttpHdrVersionGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset) {
+  return hdr(offset)->version_;
+}
+
+TSReturnCode TSHttpHdrVersionSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int ver) {
+  hdr(offset)->version_ = ver;
+  return TS_SUCCESS;
+}
+
+const char *TSHttpHdrMethodGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  MockHdr *header = hdr(offset);
+  *length = static_cast<int>(header->method_.size());
+  return header->interned_method_ ? header->interned_method_ : header->method_.data();
+}
+
+TSReturnCode TSHttpHdrUrlGet(TSMBuffer bufp, TSMLoc offset, TSMLoc *locp) {
+  MockHdr *header = hdr(offset);
+  if (header->type_ != TS_HTTP_TYPE_REQUEST) {
+    return TS_ERROR;
+  }
+  if (!header->url_) {
+    header->url_ = mbuffer(bufp)->create<MockUrl>();
+  }
+  *locp = loc(header->url_);
+  return TS_SUCCESS;
+}
+
+TSHttpStatus TSHttpHdrStatusGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset) {
+  return hdr(offset)->status_;
+}
+
+TSReturnCode TSHttpHdrStatusSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, TSHttpStatus status) {
+  hdr(offset)->status_ = status;
+  return TS_SUCCESS;
+}
+
+const char *TSHttpHdrReasonGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  MockHdr *header = hdr(offset);
+  *length = static_cast<int>(header->reason_.size());
+  return header->reason_.data();
+}
+
+TSReturnCode TSHttpHdrReasonSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char *value, int length) {
+  hdr(offset)->reason_.assign(value, (length < 0) ? strlen(value) : static_cast<size_t>(length));
+  return TS_SUCCESS;
+}
+
+const char *TSHttpHdrReasonLookup(TSHttpStatus status) {
+  switch (static_cast<int>(status)) {
+  case 200: return "OK";
+  case 201: return "Created";
+  case 204: return "No Content";
+  case 206: return "Partial Content";
+  case 301: return "Moved Permanently";
+  case 302: return "Found";
+  case 304: return "Not Modified";
+  case 307: return "Temporary Redirect";
+  case 400: return "Bad Request";
+  case 401: return "Unauthorized";
+  case 403: return "Forbidden";
+  case 404: return "Not Found";
+  case 413: return "Request Entity Too Large";
+  case 500: return "Internal Server Error";
+  case 502: return "Bad Gateway";
+  case 503: return "Service Unavailable";
+  case 504: return "Gateway Timeout";
+  default: return NULL;
+  }
+}
+
+TSHttpParser TSHttpParserCreate() {
+  return reinterpret_cast<TSHttpParser>(new MockParser());
+}
+
+void TSHttpParserDestroy(TSHttpParser parser) {
+  delete reinterpret_cast<MockParser *>(parser);
+}
+
+TSParseResult TSHttpHdrParseResp(TSHttpParser parser, TSMBuffer bufp, TSMLoc offset, const char **start,
+                                 const char *end) {
+  MockParser *mock_parser = reinterpret_cast<MockParser *>(parser);
+  size_t previous = mock_parser->pending_.size();
+  mock_parser->pending_.append(*start, end);
+  const char *data = mock_parser->pending_.data();
+  const char *head_end = findHeadEnd(data, data + mock_parser->pending_.size());
+  if (!head_end) {
+    *start = end;
+    return TS_PARSE_CONT;
+  }
+  *start += (head_end - data) - previous;
+  bool parsed = parseHead(mbuffer(bufp), hdr(offset), data, head_end, false);
+  mock_parser->pending_.clear();
+  return parsed ? TS_PARSE_DONE : TS_PARSE_ERROR;
+}
+
+/*
+ * MIME fields
+ */
+
+TSReturnCode TSMimeHdrCopy(TSMBuffer dest_bufp, TSMLoc dest_offset, TSMBuffer /* src_bufp ATS_UNUSED */,
+                           TSMLoc src_offset) {
+  MockHdr *dest = hdr(dest_offset);
+  MockHdr *src = hdr(src_offset);
+  while (!dest->fields_.empty()) {
+    dest->detach(dest->fields_.back());
+  }
+  for (size_t i = 0; i < src->fields_.size(); ++i) {
+    MockField *copy = mbuffer(dest_bufp)->create<MockField>();
+    copy->name_ = src->fields_[i]->name_;
+    copy->interned_name_ = src->fields_[i]->interned_name_;
+    copy->value_ = src->fields_[i]->value_;
+    dest->attach(copy);
+  }
+  return TS_SUCCESS;
+}
+
+int TSMimeHdrFieldsCount(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc) {
+  return static_cast<int>(hdr(hdr_loc)->fields_.size());
+}
+
+TSMLoc TSMimeHdrFieldGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, int idx) {
+  MockHdr *header = hdr(hdr_loc);
+  return ((idx >= 0) && (static_cast<size_t>(idx) < header->fields_.size())) ? loc(header->fields_[idx]) : NULL;
+}
+
+TSMLoc TSMimeHdrFieldNext(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, TSMLoc field_loc) {
+  MockHdr *header = hdr(hdr_loc);
+  size_t next = field(field_loc)->index_ + 1;
+  return (field(field_loc)->hdr_ == header && next < header->fields_.size()) ? loc(header->fields_[next]) : NULL;
+}
+
+TSMLoc TSMimeHdrFieldNextDup(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, TSMLoc field_loc) {
+  MockHdr *header = hdr(hdr_loc);
+  MockField *current = field(field_loc);
+  if (current->hdr_ != header) {
+    return NULL;
+  }
+  for (size_t i = current->index_ + 1; i < header->fields_.size(); ++i) {
+    const string &name = header->fields_[i]->name_;
+    if ((name.size() == current->name_.size()) && (strncasecmp(name.data(), current->name_.data(), name.size()) == 0)) {
+      return loc(header->fields_[i]);
+    }
+  }
+  return NULL;
+}
+
+TSMLoc TSMimeHdrFieldFind(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, const char *name, int length) {
+  MockHdr *header = hdr(hdr_loc);
+  size_t name_length = (length < 0) ? strlen(name) : static_cast<size_t>(length);
+  for (size_t i = 0; i < header->fields_.size(); ++i) {
+    const string &field_name = header->fields_[i]->name_;
+    if ((field_name.size() == name_length) && (strncasecmp(field_name.data(), name, name_length) == 0)) {
+      return loc(header->fields_[i]);
+    }
+  }
+  return NULL;
+}
+
+TSReturnCode TSMimeHdrFieldCreate(TSMBuffer bufp, TSMLoc /* hdr ATS_UNUSED */, TSMLoc *locp) {
+  *locp = loc(mbuffer(bufp)->create<MockField>());
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSMimeHdrFieldAppend(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, TSMLoc field_loc) {
+  MockField *appended = field(field_loc);
+  if (appended->hdr_) {
+    return TS_ERROR;
+  }
+  hdr(hdr_loc)->attach(appended);
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSMimeHdrFieldDestroy(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc hdr_loc, TSMLoc field_loc) {
+  hdr(hdr_loc)->detach(field(field_loc));
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSMimeHdrFieldCopy(TSMBuffer /* dest_bufp ATS_UNUSED */, TSMLoc /* dest_hdr ATS_UNUSED */,
+                                TSMLoc dest_field, TSMBuffer /* src_bufp ATS_UNUSED */,
+                                TSMLoc /* src_hdr ATS_UNUSED */, TSMLoc src_field) {
+  MockField *dest = field(dest_field);
+  MockField *src = field(src_field);
+  dest->name_ = src->name_;
+  dest->interned_name_ = src->interned_name_;
+  dest->value_ = src->value_;
+  return TS_SUCCESS;
+}
+
+const char *TSMimeHdrFieldNameGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* hdr ATS_UNUSED */, TSMLoc field_loc,
+                                  int *length) {
+  MockField *named = field(field_loc);
+  *length = static_cast<int>(named->name_.size());
+  return named->interned_name_ ? named->interned_name_ : named->name_.data();
+}
+
+TSReturnCode TSMimeHdrFieldNameSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* hdr ATS_UNUSED */, TSMLoc field_loc,
+                                   const char *name, int length) {
+  field(field_loc)->setName(name, (length < 0) ? strlen(name) : static_cast<size_t>(length));
+  return TS_SUCCESS;
+}
+
+int TSMimeHdrFieldValuesCount(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* hdr ATS_UNUSED */, TSMLoc field_loc) {
+  vector<std::pair<size_t, size_t> > values;
+  splitValues(field(field_loc)->value_, values);
+  return static_cast<int>(values.size());
+}
+
+const char *TSMimeHdrFieldValueStringGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* hdr ATS_UNUSED */,
+                                         TSMLoc field_loc, int idx, int *value_len_ptr) {
+  const string &value = field(field_loc)->value_;
+  if (idx < 0) {
+    *value_len_ptr = static_cast<int>(value.size());
+    return value.data();
+  }
+  vector<std::pair<size_t, size_t> > values;
+  splitValues(value, values);
+  if (static_cast<size_t>(idx) >= values.size()) {
+    *value_len_ptr = 0;
+    return NULL;
+  }
+  *value_len_ptr = static_cast<int>(values[idx].second);
+  return value.data() + values[idx].first;
+}
+
+TSReturnCode TSMimeHdrFieldValueStringInsert(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc /* hdr ATS_UNUSED */,
+                                             TSMLoc field_loc, int idx, const char *value, int length) {
+  string &field_value = field(field_loc)->value_;
+  string inserted(value, (length < 0) ? strlen(value) : static_cast<size_t>(length));
+  vector<std::pair<size_t, size_t> > values;
+  splitValues(field_value, values);
+  if ((idx < 0) || (static_cast<size_t>(idx) >= values.size())) {
+    if (!values.empty()) {
+      field_value.append(", ");
+    }
+    field_value.append(inserted);
+    return TS_SUCCESS;
+  }
+  string rebuilt;
+  for (size_t i = 0; i < values.size(); ++i) {
+    if (i == static_cast<size_t>(idx)) {
+      rebuilt.append(inserted).append(", ");
+    }
+    rebuilt.append(field_value, values[i].first, values[i].second);
+    if (i + 1 < values.size()) {
+      rebuilt.append(", ");
+    }
+  }
+  field_value.swap(rebuilt);
+  return TS_SUCCESS;
+}
+
+/*
+ * URLs
+ */
+
+TSReturnCode TSUrlCreate(TSMBuffer bufp, TSMLoc *locp) {
+  *locp = loc(mbuffer(bufp)->create<MockUrl>());
+  return TS_SUCCESS;
+}
+
+TSParseResult TSUrlParse(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char **start, const char *end) {
+  bool parsed = parseUrl(*start, end, *url(offset));
+  *start = end;
+  return parsed ? TS_PARSE_DONE : TS_PARSE_ERROR;
+}
+
+char *TSUrlStringGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  string printed;
+  printUrl(*url(offset), printed);
+  if (length) {
+    *length = static_cast<int>(printed.size());
+  }
+  char *str = static_cast<char *>(TSmalloc(printed.size() + 1));
+  memcpy(str, printed.c_str(), printed.size() + 1);
+  return str;
+}
+
+int TSUrlLengthGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset) {
+  string printed;
+  printUrl(*url(offset), printed);
+  return static_cast<int>(printed.size());
+}
+
+void TSUrlPrint(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, TSIOBuffer iobufp) {
+  string printed;
+  printUrl(*url(offset), printed);
+  TSIOBufferWrite(iobufp, printed.data(), static_cast<int64_t>(printed.size()));
+}
+
+namespace {
+
+const char *getUrlPart(const string &part, int *length) {
+  *length = static_cast<int>(part.size());
+  return part.data();
+}
+
+TSReturnCode setUrlPart(string &part, const char *value, int length) {
+  if (value) {
+    part.assign(value, (length < 0) ? strlen(value) : static_cast<size_t>(length));
+  } else {
+    part.clear();
+  }
+  return TS_SUCCESS;
+}
+
+}
+
+const char *TSUrlSchemeGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  return getUrlPart(url(offset)->scheme_, length);
+}
+
+TSReturnCode TSUrlSchemeSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char *value, int length) {
+  return setUrlPart(url(offset)->scheme_, value, length);
+}
+
+const char *TSUrlHostGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  return getUrlPart(url(offset)->host_, length);
+}
+
+TSReturnCode TSUrlHostSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char *value, int length) {
+  return setUrlPart(url(offset)->host_, value, length);
+}
+
+const char *TSUrlPathGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  return getUrlPart(url(offset)->path_, length);
+}
+
+TSReturnCode TSUrlPathSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char *value, int length) {
+  return setUrlPart(url(offset)->path_, value, length);
+}
+
+const char *TSUrlHttpQueryGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int *length) {
+  return getUrlPart(url(offset)->query_, length);
+}
+
+TSReturnCode TSUrlHttpQuerySet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, const char *value, int length) {
+  return setUrlPart(url(offset)->query_, value, length);
+}
+
+int TSUrlPortGet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset) {
+  MockUrl *port_url = url(offset);
+  if (port_url->port_) {
+    return port_url->port_;
+  }
+  return (strcasecmp(port_url->scheme_.c_str(), "https") == 0) ? 443 : 80;
+}
+
+TSReturnCode TSUrlPortSet(TSMBuffer /* bufp ATS_UNUSED */, TSMLoc offset, int port) {
+  url(offset)->port_ = port;
+  return TS_SUCCESS;
+}
+
+/*
+ * IOBuffers
+ */
+
+TSIOBuffer TSIOBufferCreate() {
+  MockIOBuffer *buffer = new MockIOBuffer();
+  buffer->head_ = NULL;
+  buffer->tail_ = NULL;
+  buffer->write_position_ = 0;
+  return reinterpret_cast<TSIOBuffer>(buffer);
+}
+
+void TSIOBufferDestroy(TSIOBuffer bufp) {
+  MockIOBuffer *buffer = iobuffer(bufp);
+  while (buffer->head_) {
+    MockBlock *block = buffer->head_;
+    buffer->head_ = block->next_;
+    releaseChunk(block->chunk_);
+    delete block;
+  }
+  for (size_t i = 0; i < buffer->readers_.size(); ++i) {
+    delete buffer->readers_[i];
+  }
+  delete buffer;
+}
+
+TSIOBufferReader TSIOBufferReaderAlloc(TSIOBuffer bufp) {
+  MockIOBuffer *buffer = iobuffer(bufp);
+  MockReader *new_reader = new MockReader();
+  new_reader->buffer_ = buffer;
+  new_reader->position_ = buffer->head_ ? buffer->head_->position_ : buffer->write_position_;
+  buffer->readers_.push_back(new_reader);
+  return reinterpret_cast<TSIOBufferReader>(new_reader);
+}
+
+void TSIOBufferReaderFree(TSIOBufferReader readerp) {
+  MockReader *freed = reader(readerp);
+  vector<MockReader *> &readers = freed->buffer_->readers_;
+  readers.erase(std::find(readers.begin(), readers.end(), freed));
+  trimBuffer(freed->buffer_);
+  delete freed;
+}
+
+int64_t TSIOBufferReaderAvail(TSIOBufferReader readerp) {
+  MockReader *avail_reader = reader(readerp);
+  return avail_reader->buffer_->write_position_ - avail_reader->position_;
+}
+
+void TSIOBufferReaderConsume(TSIOBufferReader readerp, int64_t nbytes) {
+  MockReader *consumer = reader(readerp);
+  consumer->position_ += std::max(static_cast<int64_t>(0), std::min(nbytes, TSIOBufferReaderAvail(readerp)));
+  trimBuffer(consumer->buffer_);
+}
+
+TSIOBufferBlock TSIOBufferReaderStart(TSIOBufferReader readerp) {
+  return reinterpret_cast<TSIOBufferBlock>(firstBlock(reader(readerp)));
+}
+
+TSIOBufferBlock TSIOBufferBlockNext(TSIOBufferBlock blockp) {
+  return reinterpret_cast<TSIOBufferBlock>(reinterpret_cast<MockBlock *>(blockp)->next_);
+}
+
+const char *TSIOBufferBlockReadStart(TSIOBufferBlock blockp, TSIOBufferReader readerp, int64_t *avail) {
+  int64_t block_avail;
+  const char *data = blockData(reinterpret_cast<MockBlock *>(blockp), reader(readerp), &block_avail);
+  if (avail) {
+    *avail = block_avail;
+  }
+  return data;
+}
+
+int64_t TSIOBufferWrite(TSIOBuffer bufp, const void *buf, int64_t length) {
+  MockIOBuffer *buffer = iobuffer(bufp);
+  const char *data = static_cast<const char *>(buf);
+  int64_t written = 0;
+  while (written < length) {
+    MockBlock *tail = buffer->tail_;
+    MockChunk *chunk = tail ? tail->chunk_ : NULL;
+    if (chunk && (chunk->refs_ == 1) && (tail->end_ == chunk->used_) && (chunk->used_ < chunk->size_)) {
+      int64_t to_write = std::min(chunk->size_ - chunk->used_, length - written);
+      memcpy(chunk->data_ + chunk->used_, data + written, to_write);
+      chunk->used_ += to_write;
+      tail->end_ += to_write;
+      buffer->write_position_ += to_write;
+      written += to_write;
+    } else {
+      chunk = new MockChunk();
+      chunk->data_ = static_cast<char *>(malloc(DEFAULT_BLOCK_SIZE));
+      chunk->size_ = DEFAULT_BLOCK_SIZE;
+      chunk->used_ = 0;
+      chunk->refs_ = 0;
+      appendBlock(buffer, chunk, 0, 0);
+    }
+  }
+  return written;
+}
+
+int64_t TSIOBufferCopy(TSIOBuffer bufp, TSIOBufferReader readerp, int64_t length, int64_t offset) {
+  MockReader *source = reader(readerp);
+  int64_t start = source->position_ + offset;
+  int64_t end = std::min(start + length, source->buffer_->write_position_);
+  int64_t copied = 0;
+  for (MockBlock *block = source->buffer_->head_; block && (start < end); block = block->next_) {
+    int64_t block_start = block->position_;
+    int64_t block_end = block_start + (block->end_ - block->start_);
+    if (block_end <= start) {
+      continue;
+    }
+    int64_t copy_end = std::min(block_end, end);
+    appendBlock(iobuffer(bufp), block->chunk_, block->start_ + (start - block_start),
+                block->start_ + (copy_end - block_start));
+    copied += copy_end - start;
+    start = copy_end;
+  }
+  return copied;
+}
+
+/*
+ * VConns and VIOs
+ */
+
+TSVConn TSTransformCreate(TSEventFunc event_funcp, TSHttpTxn txnp) {
+  TSVConn vconn = TSContCreate(event_funcp, TSMutexCreate());
+  cont(vconn)->transform_ = true;
+  cont(vconn)->txn_ = txnp;
+  return vconn;
+}
+
+TSVConn TSTransformOutputVConnGet(TSVConn connp) {
+  return reinterpret_cast<TSVConn>(cont(connp)->output_);
+}
+
+TSVIO TSVConnWrite(TSVConn connp, TSCont contp, TSIOBufferReader readerp, int64_t nbytes) {
+  MockCont *target = cont(connp);
+  if (!target) {
+    return NULL;
+  }
+  if (!target->write_vio_) {
+    target->write_vio_ = new MockVio();
+  }
+  MockVio *write_vio = target->write_vio_;
+  write_vio->cont_ = cont(contp);
+  write_vio->vconn_ = target;
+  write_vio->reader_ = readerp;
+  write_vio->nbytes_ = nbytes;
+  write_vio->ndone_ = 0;
+  queueEvent(target, TS_EVENT_IMMEDIATE, NULL);
+  return reinterpret_cast<TSVIO>(write_vio);
+}
+
+TSVIO TSVConnRead(TSVConn /* connp ATS_UNUSED */, TSCont /* contp ATS_UNUSED */, TSIOBuffer /* bufp ATS_UNUSED */,
+                  int64_t /* nbytes ATS_UNUSED */) {
+  return NULL; // nothing reads from a network connection here
+}
+
+TSVIO TSVConnWriteVIOGet(TSVConn connp) {
+  return reinterpret_cast<TSVIO>(cont(connp)->write_vio_);
+}
+
+int TSVConnClosedGet(TSVConn connp) {
+  return cont(connp)->closed_ ? 1 : 0;
+}
+
+void TSVConnShutdown(TSVConn /* connp ATS_UNUSED */, int /* read ATS_UNUSED */, int /* write ATS_UNUSED */) {
+}
+
+void TSVConnClose(TSVConn connp) {
+  cont(connp)->closed_ = true;
+  queueEvent(cont(connp), TS_EVENT_IMMEDIATE, NULL);
+}
+
+void TSVIOReenable(TSVIO viop) {
+  queueEvent(vio(viop)->vconn_, TS_EVENT_IMMEDIATE, NULL);
+}
+
+TSCont TSVIOContGet(TSVIO viop) {
+  return reinterpret_cast<TSCont>(vio(viop)->cont_);
+}
+
+TSIOBufferReader TSVIOReaderGet(TSVIO viop) {
+  return vio(viop)->reader_;
+}
+
+void TSVIONBytesSet(TSVIO viop, int64_t nbytes) {
+  vio(viop)->nbytes_ = nbytes;
+}
+
+int64_t TSVIONDoneGet(TSVIO viop) {
+  return vio(viop)->ndone_;
+}
+
+void TSVIONDoneSet(TSVIO viop, int64_t ndone) {
+  vio(viop)->ndone_ = ndone;
+}
+
+int64_t TSVIONTodoGet(TSVIO viop) {
+  return vio(viop)->nbytes_ - vio(viop)->ndone_;
+}
+
+/*
+ * Transactions
+ */
+
+TSReturnCode TSHttpTxnClientReqGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *offset) {
+  MockTxn *mock_txn = txn(txnp);
+  *bufp = mock_txn->client_request_buf_;
+  *offset = mock_txn->client_request_hdr_;
+  return *bufp ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode TSHttpTxnServerReqGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */,
+                                   TSMLoc * /* offset ATS_UNUSED */) {
+  return TS_ERROR; // no request is sent to an origin
+}
+
+TSReturnCode TSHttpTxnServerRespGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *offset) {
+  MockTxn *mock_txn = txn(txnp);
+  *bufp = mock_txn->response_buf_;
+  *offset = mock_txn->server_response_hdr_;
+  return *bufp ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode TSHttpTxnClientRespGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *offset) {
+  MockTxn *mock_txn = txn(txnp);
+  *bufp = mock_txn->response_buf_;
+  *offset = mock_txn->client_response_hdr_;
+  return *bufp ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode TSHttpTxnCachedRespGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */,
+                                    TSMLoc * /* offset ATS_UNUSED */) {
+  return TS_ERROR;
+}
+
+TSReturnCode TSHttpTxnTransformRespGet(TSHttpTxn /* txnp ATS_UNUSED */, TSMBuffer * /* bufp ATS_UNUSED */,
+                                       TSMLoc * /* offset ATS_UNUSED */) {
+  return TS_ERROR;
+}
+
+void TSHttpTxnTransformedRespCache(TSHttpTxn /* txnp ATS_UNUSED */, int /* on ATS_UNUSED */) {
+}
+
+void TSHttpTxnUntransformedRespCache(TSHttpTxn /* txnp ATS_UNUSED */, int /* on ATS_UNUSED */) {
+}
+
+TSReturnCode TSHttpTxnPristineUrlGet(TSHttpTxn txnp, TSMBuffer *bufp, TSMLoc *url_loc) {
+  MockTxn *mock_txn = txn(txnp);
+  *bufp = mock_txn->pristine_buf_;
+  *url_loc = mock_txn->pristine_url_;
+  return *bufp ? TS_SUCCESS : TS_ERROR;
+}
+
+TSReturnCode TSHttpTxnCacheLookupStatusGet(TSHttpTxn txnp, int *lookup_status) {
+  *lookup_status = txn(txnp)->cache_lookup_status_;
+  return (*lookup_status < 0) ? TS_ERROR : TS_SUCCESS;
+}
+
+TSReturnCode TSHttpTxnCacheLookupStatusSet(TSHttpTxn txnp, int cachelookup) {
+  txn(txnp)->cache_lookup_status_ = cachelookup;
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSCacheUrlSet(TSHttpTxn txnp, const char *url, int length) {
+  txn(txnp)->cache_url_.assign(url, (length < 0) ? strlen(url) : static_cast<size_t>(length));
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSHttpArgIndexReserve(const char * /* name ATS_UNUSED */, const char * /* description ATS_UNUSED */,
+                                   int *arg_idx) {
+  if (reserved_txn_args >= static_cast<int>(TXN_ARG_COUNT) - 1) { // the library keeps the last one to itself
+    return TS_ERROR;
+  }
+  *arg_idx = reserved_txn_args++;
+  return TS_SUCCESS;
+}
+
+TSHttpSsn TSHttpTxnSsnGet(TSHttpTxn txnp) {
+  return reinterpret_cast<TSHttpSsn>(&txn(txnp)->session_);
+}
+
+void TSHttpSsnArgSet(TSHttpSsn ssnp, int arg_idx, void *arg) {
+  if ((arg_idx >= 0) && (static_cast<size_t>(arg_idx) < TXN_ARG_COUNT)) {
+    reinterpret_cast<MockSsn *>(ssnp)->args_[arg_idx] = arg;
+  }
+}
+
+void *TSHttpSsnArgGet(TSHttpSsn ssnp, int arg_idx) {
+  if ((arg_idx >= 0) && (static_cast<size_t>(arg_idx) < TXN_ARG_COUNT)) {
+    return reinterpret_cast<MockSsn *>(ssnp)->args_[arg_idx];
+  }
+  return NULL;
+}
+
+void TSHttpSsnHookAdd(TSHttpSsn ssnp, TSHttpHookID id, TSCont contp) {
+  Hook hook = { id, cont(contp) };
+  reinterpret_cast<MockSsn *>(ssnp)->hooks_.push_back(hook);
+}
+
+TSReturnCode TSHttpSsnReenable(TSHttpSsn /* ssnp ATS_UNUSED */, TSEvent /* event ATS_UNUSED */) {
+  return TS_SUCCESS;
+}
+
+void TSHttpTxnArgSet(TSHttpTxn txnp, int arg_idx, void *arg) {
+  if ((arg_idx >= 0) && (static_cast<size_t>(arg_idx) < TXN_ARG_COUNT)) {
+    txn(txnp)->args_[arg_idx] = arg;
+  }
+}
+
+void *TSHttpTxnArgGet(TSHttpTxn txnp, int arg_idx) {
+  if ((arg_idx >= 0) && (static_cast<size_t>(arg_idx) < TXN_ARG_COUNT)) {
+    return txn(txnp)->args_[arg_idx];
+  }
+  return NULL;
+}
+
+void TSHttpHookAdd(TSHttpHookID /* id ATS_UNUSED */, TSCont /* contp ATS_UNUSED */) {
+  // global hooks never fire, the benchmarks call the library directly
+}
+
+void TSHttpTxnHookAdd(TSHttpTxn txnp, TSHttpHookID id, TSCont contp) {
+  Hook hook = { id, cont(contp) };
+  txn(txnp)->hooks_.push_back(hook);
+}
+
+TSReturnCode TSHttpTxnReenable(TSHttpTxn /* txnp ATS_UNUSED */, TSEvent /* event ATS_UNUSED */) {
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSHttpIsInternalRequest(TSHttpTxn /* txnp ATS_UNUSED */) {
+  return TS_ERROR;
+}
+
+const sockaddr *TSHttpTxnClientAddrGet(TSHttpTxn txnp) {
+  return reinterpret_cast<const sockaddr *>(&txn(txnp)->client_addr_);
+}
+
+const sockaddr *TSHttpTxnIncomingAddrGet(TSHttpTxn txnp) {
+  return reinterpret_cast<const sockaddr *>(&txn(txnp)->incoming_addr_);
+}
+
+const sockaddr *TSHttpTxnServerAddrGet(TSHttpTxn txnp) {
+  return reinterpret_cast<const sockaddr *>(&txn(txnp)->server_addr_);
+}
+
+const sockaddr *TSHttpTxnNextHopAddrGet(TSHttpTxn txnp) {
+  return reinterpret_cast<const sockaddr *>(&txn(txnp)->server_addr_);
+}
+
+TSReturnCode TSHttpTxnServerAddrSet(TSHttpTxn txnp, const sockaddr *addr) {
+  if (addr->sa_family != AF_INET) {
+    return TS_ERROR;
+  }
+  memcpy(&txn(txnp)->server_addr_, addr, sizeof(sockaddr_in));
+  return TS_SUCCESS;
+}
+
+void TSHttpTxnClientIncomingPortSet(TSHttpTxn txnp, int port) {
+  txn(txnp)->incoming_addr_.sin_port = htons(port);
+}
+
+void TSHttpTxnDNSTimeoutSet(TSHttpTxn /* txnp ATS_UNUSED */, int /* timeout ATS_UNUSED */) {
+}
+
+void TSHttpTxnConnectTimeoutSet(TSHttpTxn /* txnp ATS_UNUSED */, int /* timeout ATS_UNUSED */) {
+}
+
+void TSHttpTxnNoActivityTimeoutSet(TSHttpTxn /* txnp ATS_UNUSED */, int /* timeout ATS_UNUSED */) {
+}
+
+void TSHttpTxnActiveTimeoutSet(TSHttpTxn /* txnp ATS_UNUSED */, int /* timeout ATS_UNUSED */) {
+}
+
+void TSHttpTxnErrorBodySet(TSHttpTxn txnp, char *buf, size_t /* buflength ATS_UNUSED */, char *mimetype) {
+  MockTxn *mock_txn = txn(txnp);
+  TSfree(mock_txn->error_body_); // the transaction owns the body and its type
+  TSfree(mock_txn->error_body_type_);
+  mock_txn->error_body_ = buf;
+  mock_txn->error_body_type_ = mimetype;
+}
+
+void TSHttpTxnSetHttpRetStatus(TSHttpTxn txnp, TSHttpStatus http_retstatus) {
+  txn(txnp)->ret_status_ = http_retstatus;
+}
+
+void TSHttpTxnIntercept(TSCont /* contp ATS_UNUSED */, TSHttpTxn /* txnp ATS_UNUSED */) {
+}
+
+void TSHttpTxnServerIntercept(TSCont /* contp ATS_UNUSED */, TSHttpTxn /* txnp ATS_UNUSED */) {
+}
+
+/*
+ * Everything else is only there to link
+ */
+
+int TSStatCreate(const char *the_name, TSRecordDataType /* the_type ATS_UNUSED */,
+                 TSStatPersistence /* persist ATS_UNUSED */, TSStatSync /* sync ATS_UNUSED */) {
+  MockStat stat = { the_name, 0 };
+  stats.push_back(stat);
+  return static_cast<int>(stats.size() - 1);
+}
+
+TSReturnCode TSStatFindName(const char *name, int *idp) {
+  for (size_t i = 0; i < stats.size(); ++i) {
+    if (stats[i].name_ == name) {
+      *idp = static_cast<int>(i);
+      return TS_SUCCESS;
+    }
+  }
+  return TS_ERROR;
+}
+
+void TSStatIntIncrement(int the_stat, int64_t amount) {
+  stats[the_stat].value_ += amount;
+}
+
+void TSStatIntDecrement(int the_stat, int64_t amount) {
+  stats[the_stat].value_ -= amount;
+}
+
+int64_t TSStatIntGet(int the_stat) {
+  return stats[the_stat].value_;
+}
+
+void TSStatIntSet(int the_stat, int64_t value) {
+  stats[the_stat].value_ = value;
+}
+
+TSReturnCode TSTextLogObjectCreate(const char * /* filename ATS_UNUSED */, int /* mode ATS_UNUSED */,
+                                   TSTextLogObject *new_log_obj) {
+  *new_log_obj = reinterpret_cast<TSTextLogObject>(new char); // nothing is written anywhere
+  return TS_SUCCESS;
+}
+
+TSReturnCode TSTextLogObjectWrite(TSTextLogObject /* the_object ATS_UNUSED */, const char * /* format ATS_UNUSED */,
+                                  ...) {
+  return TS_SUCCESS;
+}
+
+void TSTextLogObjectFlush(TSTextLogObject /* the_object ATS_UNUSED */) {
+}
+
+TSReturnCode TSTextLogObjectDestroy(TSTextLogObject the_object) {
+  delete reinterpret_cast<char *>(the_object);
+  return TS_SUCCESS;
+}
+
+void TSTextLogObjectRollingEnabledSet(TSTextLogObject /* the_object ATS_UNUSED */, int /* rolling_enabled ATS_UNUSED */) {
+}
+
+void TSTextLogObjectRollingIntervalSecSet(TSTextLogObject /* the_object ATS_UNUSED */,
+                                          int /* rolling_interval_sec ATS_UNUSED */) {
+}
+
+void TSMgmtUpdateRegister(TSCont /* contp ATS_UNUSED */, const char * /* plugin_name ATS_UNUSED */) {
+}
+
+void TSFetchUrl(const char * /* request ATS_UNUSED */, int /* request_len ATS_UNUSED */,
+                const sockaddr * /* addr ATS_UNUSED */, TSCont /* contp ATS_UNUSED */,
+                TSFetchWakeUpOptions /* callback_options ATS_UNUSED */, TSFetchEvent /* event ATS_UNUSED */) {
+}
+
+const char *TSFetchRespGet(TSHttpTxn /* txnp ATS_UNUSED */, int *length) {
+  *length = 0;
+  return NULL;
+}
+
+TSFetchSM TSFetchCreate(TSCont /* contp ATS_UNUSED */, const char * /* method ATS_UNUSED */,
+                        const char * /* url ATS_UNUSED */, const char * /* version ATS_UNUSED */,
+                        const sockaddr * /* client_addr ATS_UNUSED */, int /* flags ATS_UNUSED */) {
+  return NULL; // fetches are never started
+}
+
+void TSFetchHeaderAdd(TSFetchSM /* fetch_sm ATS_UNUSED */, const char * /* name ATS_UNUSED */,
+                      int /* name_len ATS_UNUSED */, const char * /* value ATS_UNUSED */, int /* value_len ATS_UNUSED */) {
+}
+
+void TSFetchWriteData(TSFetchSM /* fetch_sm ATS_UNUSED */, const void * /* data ATS_UNUSED */,
+                      size_t /* len ATS_UNUSED */) {
+}
+
+ssize_t TSFetchReadData(TSFetchSM /* fetch_sm ATS_UNUSED */, void * /* buf ATS_UNUSED */, size_t /* len ATS_UNUSED */) {
+  return 0;
+}
+
+void TSFetchLaunch(TSFetchSM /* fetch_sm ATS_UNUSED */) {
+}
+
+void TSFetchDestroy(TSFetchSM /* fetch_sm ATS_UNUSED */) {
+}
+
+void TSFetchUserDataSet(TSFetchSM /* fetch_sm ATS_UNUSED */, void * /* data ATS_UNUSED */) {
+}
+
+TSMBuffer TSFetchRespHdrMBufGet(TSFetchSM /* fetch_sm ATS_UNUSED */) {
+  return NULL;
+}
+
+TSMLoc TSFetchRespHdrMLocGet(TSFetchSM /* fetch_sm ATS_UNUSED */) {
+  return NULL;
+}
+
+/*
+ * Driving the mock
+ */
+
+bool atscppapi::mock::parseHeader(const string &raw, TSMBuffer &hdr_buf, TSMLoc &hdr_loc) {
+  MockMBuffer *buffer = new MockMBuffer();
+  MockHdr *header = buffer->create<MockHdr>();
+  const char *start = raw.data();
+  const char *end = start + raw.size();
+  const char *head_end = findHeadEnd(start, end);
+  bool request = (raw.compare(0, 5, "HTTP/") != 0);
+  if (!parseHead(buffer, header, start, head_end ? head_end : end, request)) {
+    delete buffer;
+    return false;
+  }
+  hdr_buf = reinterpret_cast<TSMBuffer>(buffer);
+  hdr_loc = loc(header);
+  return true;
+}
+
+void atscppapi::mock::destroyHeader(TSMBuffer hdr_buf) {
+  delete mbuffer(hdr_buf);
+}
+
+TSHttpTxn atscppapi::mock::createTransaction(const string &raw_request) {
+  TSMBuffer hdr_buf;
+  TSMLoc hdr_loc;
+  if (!parseHeader(raw_request, hdr_buf, hdr_loc)) {
+    return NULL;
+  }
+  if (hdr(hdr_loc)->type_ != TS_HTTP_TYPE_REQUEST) {
+    destroyHeader(hdr_buf);
+    return NULL;
+  }
+  MockTxn *mock_txn = new MockTxn();
+  mock_txn->client_request_buf_ = hdr_buf;
+  mock_txn->client_request_hdr_ = hdr_loc;
+  MockMBuffer *pristine = new MockMBuffer();
+  MockUrl *pristine_url = pristine->create<MockUrl>();
+  *pristine_url = *hdr(hdr_loc)->url_;
+  mock_txn->pristine_buf_ = reinterpret_cast<TSMBuffer>(pristine);
+  mock_txn->pristine_url_ = loc(pristine_url);
+  return reinterpret_cast<TSHttpTxn>(mock_txn);
+}
+
+bool atscppapi::mock::setTransactionResponse(TSHttpTxn txnp, const string &raw_response) {
+  TSMBuffer hdr_buf;
+  TSMLoc hdr_loc;
+  if (!parseHeader(raw_response, hdr_buf, hdr_loc)) {
+    return false;
+  }
+  MockHdr *server_response = hdr(hdr_loc);
+  if (server_response->type_ != TS_HTTP_TYPE_RESPONSE) {
+    destroyHeader(hdr_buf);
+    return false;
+  }
+  MockHdr *client_response = mbuffer(hdr_buf)->create<MockHdr>();
+  client_response->type_ = server_response->type_;
+  client_response->version_ = server_response->version_;
+  client_response->status_ = server_response->status_;
+  client_response->reason_ = server_response->reason_;
+  TSMimeHdrCopy(hdr_buf, loc(client_response), hdr_buf, hdr_loc);
+
+  MockTxn *mock_txn = txn(txnp);
+  if (mock_txn->response_buf_) {
+    destroyHeader(mock_txn->response_buf_);
+  }
+  mock_txn->response_buf_ = hdr_buf;
+  mock_txn->server_response_hdr_ = hdr_loc;
+  mock_txn->client_response_hdr_ = loc(client_response);
+  return true;
+}
+
+int64_t atscppapi::mock::runTransformations(TSHttpTxn txnp, TSHttpHookID hook, const char *data, size_t length,
+                                            size_t chunk_size, string *output) {
+  MockTxn *mock_txn = txn(txnp);
+  vector<MockCont *> transformations;
+  for (size_t i = 0; i < mock_txn->hooks_.size(); ++i) {
+    const Hook &added = mock_txn->hooks_[i];
+    if ((added.id_ == hook) && added.cont_->transform_ && live_conts.count(added.cont_)) {
+      transformations.push_back(added.cont_);
+    }
+  }
+  if (transformations.empty()) {
+    return -1;
+  }
+
+  // each transformation writes to the next one, the last one to the sink
+  TSCont sink = TSContCreate(handleSinkEvents, NULL);
+  cont(sink)->sink_output_ = output;
+  for (size_t i = 0; i < transformations.size(); ++i) {
+    transformations[i]->output_ = (i + 1 < transformations.size()) ? transformations[i + 1] : cont(sink);
+  }
+
+  TransformationRun run = { false, false };
+  TSCont upstream = TSContCreate(handleUpstreamEvents, NULL);
+  TSContDataSet(upstream, &run);
+  TSIOBuffer input_buffer = TSIOBufferCreate();
+  TSIOBufferReader input_reader = TSIOBufferReaderAlloc(input_buffer);
+  TSVIO input_vio = TSVConnWrite(reinterpret_cast<TSVConn>(transformations.front()), upstream, input_reader,
+                                 static_cast<int64_t>(length));
+  runEvents();
+
+  size_t written = 0;
+  if (!chunk_size) {
+    chunk_size = length;
+  }
+  while ((written < length) && !run.error_) {
+    size_t to_write = std::min(chunk_size, length - written);
+    TSIOBufferWrite(input_buffer, data + written, static_cast<int64_t>(to_write));
+    written += to_write;
+    TSVIOReenable(input_vio);
+    runEvents();
+  }
+  bool completed = cont(sink)->sink_complete_ && !run.error_;
+
+  // Traffic Server closes the transformations once the client got the body
+  for (size_t i = 0; i < transformations.size(); ++i) {
+    transformations[i]->closed_ = true;
+    queueEvent(transformations[i], TS_EVENT_IMMEDIATE, NULL);
+  }
+  runEvents();
+
+  int64_t sink_bytes = cont(sink)->sink_bytes_;
+  TSContDestroy(upstream);
+  TSContDestroy(sink);
+  TSIOBufferReaderFree(input_reader);
+  TSIOBufferDestroy(input_buffer);
+  return completed ? sink_bytes : -1;
+}
+
+void atscppapi::mock::closeTransaction(TSHttpTxn txnp) {
+  MockTxn *mock_txn = txn(txnp);
+  vector<Hook> hooks(mock_txn->hooks_); // closing may add or remove hooks
+  for (size_t i = 0; i < hooks.size(); ++i) {
+    if ((hooks[i].id_ == TS_HTTP_TXN_CLOSE_HOOK) && live_conts.count(hooks[i].cont_)) {
+      hooks[i].cont_->func_(reinterpret_cast<TSCont>(hooks[i].cont_), TS_EVENT_HTTP_TXN_CLOSE, txnp);
+    }
+  }
+  runEvents();
+  mock_txn->hooks_.clear();
+  memset(mock_txn->args_, 0, sizeof(mock_txn->args_));
+  mock_txn->cache_lookup_status_ = -1;
+  mock_txn->resetResult();
+}
+
+void atscppapi::mock::closeSession(TSHttpTxn txnp) {
+  MockSsn &session = txn(txnp)->session_;
+  vector<Hook> hooks(session.hooks_);
+  for (size_t i = 0; i < hooks.size(); ++i) {
+    if ((hooks[i].id_ == TS_HTTP_SSN_CLOSE_HOOK) && live_conts.count(hooks[i].cont_)) {
+      hooks[i].cont_->func_(reinterpret_cast<TSCont>(hooks[i].cont_), TS_EVENT_HTTP_SSN_CLOSE,
+                            reinterpret_cast<TSHttpSsn>(&session));
+    }
+  }
+  runEvents();
+  session.hooks_.clear();
+  memset(session.args_, 0, sizeof(session.args_));
+}
+
+void atscppapi::mock::destroyTransaction(TSHttpTxn txnp) {
+  MockTxn *mock_txn = txn(txnp);
+  closeTransaction(txnp);
+  closeSession(txnp);
+  destroyHeader(mock_txn->client_request_buf_);
+  destroyHeader(mock_txn->pristine_buf_);
+  if (mock_txn->response_buf_) {
+    destroyHeader(mock_txn->response_buf_);
+  }
+  delete mock_txn;
+}
+
+size_t atscppapi::mock::runEvents() {
+  size_t events_run = 0;
+  while (!pending_events.empty()) {
+    Event next = pending_events.front();
+    pending_events.pop_front();
+    if (next.action_ && !next.action_->periodic_) {
+      delete next.action_; // a one-shot action can't be cancelled once it's running
+    }
+    if (live_conts.count(next.cont_)) {
+      next.cont_->func_(reinterpret_cast<TSCont>(next.cont_), next.event_, next.edata_);
+      ++events_run;
+    }
+  }
+  return events_run;
+}
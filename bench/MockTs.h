@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file MockTs.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Controls the in-memory implementation of the Traffic Server API the benchmarks run against.
+ *
+ * MockTs.cc implements the functions of ts/ts.h that the library calls, so the library can be measured
+ * outside of traffic_server. Marshal buffers, MIME headers, URLs, IOBuffers, continuations and
+ * transformation VConns behave as they do in Traffic Server as far as the library can tell. They are not
+ * meant to be as fast as Traffic Server's: compare benchmark results with each other, not with production.
+ *
+ * Continuations don't run on event threads, events that Traffic Server would schedule are queued and run by
+ * runEvents() on the calling thread. Timeouts are ignored and periodic events never fire. The rest of the API
+ * (fetches, stats, text logs, ...) is implemented just enough to link.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BENCH_MOCKTS_H_
+#define ATSCPPAPI_BENCH_MOCKTS_H_
+
+#include <cstddef>
+#include <string>
+#include <ts/ts.h>
+
+namespace atscppapi {
+namespace mock {
+
+/**
+ * Parses an HTTP request or response head, e.g. "GET /index.html HTTP/1.1\r\nHost: example.com\r\n\r\n",
+ * into a new marshal buffer. The terminating empty line may be left out.
+ *
+ * @return false if raw isn't a valid head, then no buffer is created.
+ */
+bool parseHeader(const std::string &raw, TSMBuffer &hdr_buf, TSMLoc &hdr_loc);
+
+/**
+ * Releases a marshal buffer created by parseHeader() and everything in it.
+ */
+void destroyHeader(TSMBuffer hdr_buf);
+
+/**
+ * Creates a transaction whose client request is parsed from raw_request by parseHeader(). The
+ * transaction can be closed and used again any number of times, see closeTransaction().
+ *
+ * @return NULL if raw_request isn't a valid request.
+ */
+TSHttpTxn createTransaction(const std::string &raw_request);
+
+/**
+ * Sets the server response and the client response of txn, both parsed from raw_response. The client
+ * response starts out as a copy of the server response as it does in Traffic Server.
+ *
+ * @return false if raw_response isn't a valid response.
+ */
+bool setTransactionResponse(TSHttpTxn txn, const std::string &raw_response);
+
+/**
+ * Feeds data through the transformations added to the hook of txn, in chunks of chunk_size bytes as if they
+ * were read from the network, and runs the events until the last transformation completed.
+ *
+ * @param txn the transaction.
+ * @param hook TS_HTTP_REQUEST_TRANSFORM_HOOK or TS_HTTP_RESPONSE_TRANSFORM_HOOK.
+ * @param data the body fed to the first transformation.
+ * @param length the length of data.
+ * @param chunk_size the most bytes handed over at a time, 0 for all at once.
+ * @param output if not NULL the output of the last transformation is appended to it.
+ * @return the number of bytes the last transformation wrote, -1 if there is no transformation or one failed.
+ */
+int64_t runTransformations(TSHttpTxn txn, TSHttpHookID hook, const char *data, size_t length, size_t chunk_size,
+                           std::string *output = NULL);
+
+/**
+ * Closes txn as Traffic Server would at the end of a transaction: the continuations of the
+ * TS_HTTP_TXN_CLOSE_HOOK are called, which destroys the library's Transaction and its plugins. The
+ * hooks, arguments and transformations of txn are then reset so the next use starts a new
+ * Transaction with the same client request.
+ */
+void closeTransaction(TSHttpTxn txn);
+
+/**
+ * Closes the client session of txn, which stays open across closeTransaction() as a keep-alive connection
+ * would: the continuations of the TS_HTTP_SSN_CLOSE_HOOK are called, which destroys the library's Session.
+ */
+void closeSession(TSHttpTxn txn);
+
+/**
+ * Destroys a transaction created by createTransaction(), it's closed first if it's in use.
+ */
+void destroyTransaction(TSHttpTxn txn);
+
+/**
+ * Runs the queued events, including those queued by the events run, until none are left.
+ *
+ * @return the number of events run.
+ */
+size_t runEvents();
+
+} /* mock */
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_BENCH_MOCKTS_H_ */
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file PrefetchBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * Prefetcher hints from the Link headers of a response, as given for every response of a plugin that
+ * prefetches. The fetches of the mock never complete, so after the first run every hint is a duplicate.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include "atscppapi/Prefetcher.h"
+#include <string>
+
+using namespace atscppapi;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const char SEGMENT_REQUEST[] =
+  "GET /live/stream/seg1.ts HTTP/1.1\r\n"
+  "Host: video.example.com\r\n"
+  "User-Agent: ExamplePlayer/2.1\r\n"
+  "Accept-Encoding: identity\r\n"
+  "Cookie: session=8f14e45fceea167a5a36dedd4bea2543\r\n"
+  "\r\n";
+
+// seg2.ts is linked twice and style.css isn't a prefetch, so three prefetches are started
+const char SEGMENT_RESPONSE[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: video/mp2t\r\n"
+  "Content-Length: 0\r\n"
+  "Link: </live/stream/seg2.ts>; rel=prefetch, <seg3.ts>; rel=\"prefetch next\", "
+  "<http://video.example.com/live/stream/seg2.ts>; rel=preload\r\n"
+  "Link: <//cdn.example.com/player.js>; rel=preload; as=script, </style.css>; rel=stylesheet\r\n"
+  "\r\n";
+
+void benchmarkLinkHintsDuplicate(size_t iterations) {
+  static Prefetcher *prefetcher = NULL;
+  static TSHttpTxn txn = mock::createTransaction(SEGMENT_REQUEST);
+  if (!prefetcher) {
+    prefetcher = new Prefetcher();
+    mock::setTransactionResponse(txn, SEGMENT_RESPONSE);
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    if ((prefetcher->addLinkHints(transaction, transaction.getServerResponse().getHeaders()) != 3) ||
+        (prefetcher->getInFlightCount() != 3)) {
+      bench::fail("expected three prefetches");
+    }
+  }
+  Transaction &transaction = utils::internal::getTransaction(txn);
+  Headers &headers = transaction.getServerResponse().getHeaders();
+  for (size_t i = 0; i < iterations; ++i) {
+    if (prefetcher->addLinkHints(transaction, headers) != 0) {
+      bench::fail("duplicate hints were prefetched");
+    }
+  }
+  keep(prefetcher->getInFlightCount());
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(prefetch.link_hints.duplicate, benchmarkLinkHintsDuplicate);
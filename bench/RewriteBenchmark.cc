@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RewriteBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * TextRewriteTransformation on a page with links to rewrite, checked against a plain search of the whole body
+ * so matches across chunk boundaries are covered by the small chunk runs.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include <atscppapi/TextRewriteTransformation.h>
+#include <cstdio>
+#include <string>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const size_t SMALL_BODY_SIZE = 64 * 1024;
+const size_t LARGE_BODY_SIZE = 1024 * 1024;
+const size_t CHUNK_SIZE = 16 * 1024;
+const size_t SMALL_CHUNK_SIZE = 61; // not a divisor of anything in the body
+
+const char RESPONSE[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/html; charset=utf-8\r\n"
+  "Cache-Control: max-age=300\r\n"
+  "\r\n";
+
+struct Replacement {
+  const char *pattern_;
+  const char *replacement_;
+};
+
+// http://www.example.com/ is a prefix of the longer pattern, so a longest match choice is made on every link
+const Replacement REPLACEMENTS[] = {
+  { "http://www.example.com/", "https://www.example.com/" },
+  { "http://www.example.com/static/", "https://cdn.example.com/static/" },
+  { "http://images.example.com/", "https://cdn.example.com/images/" },
+};
+const size_t REPLACEMENT_COUNT = sizeof(REPLACEMENTS) / sizeof(REPLACEMENTS[0]);
+
+string makeBody(size_t size) {
+  string body;
+  body.reserve(size + 512);
+  body.append("<!DOCTYPE html><html><head><title>Results</title></head><body><ul>\n");
+  char item[512];
+  for (unsigned int i = 0; body.size() < size; ++i) {
+    snprintf(item, sizeof(item), "<li class=\"result r%u\"><a href=\"http://www.example.com/products/%u\">"
+             "<img src=\"%s%u.jpg\"></a><span class=\"price\">%u.%02u</span></li>\n", i % 7, i,
+             (i % 3) ? "http://www.example.com/static/" : "http://images.example.com/", i, (i * 37) % 500, i % 100);
+    body.append(item);
+  }
+  body.resize(size);
+  return body;
+}
+
+const TextRewriteRules &getRules() {
+  static TextRewriteRules *rules = NULL;
+  if (!rules) {
+    rules = new TextRewriteRules();
+    for (size_t i = 0; i < REPLACEMENT_COUNT; ++i) {
+      rules->addReplacement(REPLACEMENTS[i].pattern_, REPLACEMENTS[i].replacement_);
+    }
+  }
+  return *rules;
+}
+
+/** The expected output: at each byte the longest replacement ending there is applied. */
+string rewriteWhole(const string &body) {
+  string output;
+  output.reserve(body.size() + body.size() / 8);
+  size_t produced = 0;
+  for (size_t end = 1; end <= body.size(); ++end) {
+    const Replacement *longest = NULL;
+    size_t longest_length = 0;
+    for (size_t i = 0; i < REPLACEMENT_COUNT; ++i) {
+      size_t length = string(REPLACEMENTS[i].pattern_).length();
+      if ((length > longest_length) && (length <= end - produced) &&
+          (body.compare(end - length, length, REPLACEMENTS[i].pattern_) == 0)) {
+        longest = &REPLACEMENTS[i];
+        longest_length = length;
+      }
+    }
+    if (longest) {
+      output.append(body, produced, end - longest_length - produced);
+      output.append(longest->replacement_);
+      produced = end;
+    }
+  }
+  output.append(body, produced, string::npos);
+  return output;
+}
+
+TSHttpTxn getResponseTransaction() {
+  static TSHttpTxn txn = NULL;
+  if (!txn) {
+    txn = mock::createTransaction("GET /products HTTP/1.1\r\nHost: www.example.com\r\n\r\n");
+    mock::setTransactionResponse(txn, RESPONSE);
+  }
+  return txn;
+}
+
+void rewriteBody(const string &body, const string &expected, size_t chunk_size, size_t iterations) {
+  TSHttpTxn txn = getResponseTransaction();
+  string output;
+  for (size_t i = 0; i < iterations; ++i) {
+    Transaction &transaction = utils::internal::getTransaction(txn);
+    transaction.addPlugin(new TextRewriteTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION,
+                                                        getRules()));
+    output.clear();
+    mock::runTransformations(txn, TS_HTTP_RESPONSE_TRANSFORM_HOOK, body.data(), body.size(), chunk_size, &output);
+    if (output != expected) {
+      bench::fail("the rewritten body differs from rewriting it whole");
+    }
+    keep(output.size());
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkRewriteLarge(size_t iterations) {
+  static const string body = makeBody(LARGE_BODY_SIZE);
+  static const string expected = rewriteWhole(body);
+  rewriteBody(body, expected, CHUNK_SIZE, iterations);
+}
+
+void benchmarkRewriteSmallChunks(size_t iterations) {
+  static const string body = makeBody(SMALL_BODY_SIZE);
+  static const string expected = rewriteWhole(body);
+  rewriteBody(body, expected, SMALL_CHUNK_SIZE, iterations);
+}
+
+/** A body without a single candidate byte, the skip ahead search alone. */
+void benchmarkScanOnly(size_t iterations) {
+  static const string body(LARGE_BODY_SIZE, 'x');
+  rewriteBody(body, body, CHUNK_SIZE, iterations);
+}
+
+} /* anonymous namespace */
+
+BENCHMARK_BYTES(rewrite.links.1m, benchmarkRewriteLarge, LARGE_BODY_SIZE);
+BENCHMARK_BYTES(rewrite.links.small_chunks.64k, benchmarkRewriteSmallChunks, SMALL_BODY_SIZE);
+BENCHMARK_BYTES(rewrite.scan_only.1m, benchmarkScanOnly, LARGE_BODY_SIZE);
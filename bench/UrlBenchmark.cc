@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file UrlBenchmark.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * The Url of a client request. A Url reads its parts from the marshal buffer when they're first asked
+ * for, url.first_use measures that on a new Transaction per iteration.
+ */
+
+#include "Benchmark.h"
+#include "MockTs.h"
+#include "utils_internal.h"
+#include <string>
+
+using namespace atscppapi;
+using atscppapi::bench::keep;
+using std::string;
+
+namespace {
+
+const char SEARCH_REQUEST[] =
+  "GET http://www.example.com:8080/products/search/results?q=traffic+server&category=proxies&sort=price"
+  "&order=asc&page=3&per_page=50&utm_source=newsletter&utm_medium=email HTTP/1.1\r\n"
+  "Host: www.example.com:8080\r\n"
+  "\r\n";
+
+TSHttpTxn getSearchTransaction() {
+  static TSHttpTxn txn = mock::createTransaction(SEARCH_REQUEST);
+  return txn;
+}
+
+void benchmarkFirstUse(size_t iterations) {
+  TSHttpTxn txn = getSearchTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Url &url = utils::internal::getTransaction(txn).getClientRequest().getUrl();
+    keep(url.getHost().size() + url.getPath().size());
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkGetters(size_t iterations) {
+  TSHttpTxn txn = getSearchTransaction();
+  Url &url = utils::internal::getTransaction(txn).getClientRequest().getUrl();
+  for (size_t i = 0; i < iterations; ++i) {
+    keep(url.getScheme().size() + url.getHost().size() + url.getPort() + url.getPath().size() +
+         url.getQuery().size());
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkGetUrlString(size_t iterations) {
+  TSHttpTxn txn = getSearchTransaction();
+  for (size_t i = 0; i < iterations; ++i) {
+    Url &url = utils::internal::getTransaction(txn).getClientRequest().getUrl();
+    keep(url.getUrlString().size());
+    mock::closeTransaction(txn);
+  }
+}
+
+void benchmarkQueryParams(size_t iterations) {
+  TSHttpTxn txn = getSearchTransaction();
+  Url &url = utils::internal::getTransaction(txn).getClientRequest().getUrl();
+  for (size_t i = 0; i < iterations; ++i) {
+    QueryParamIterator iter = url.getQueryParams();
+    QueryParamView param;
+    size_t count = 0;
+    while (iter.next(param)) {
+      count += param.value_.size() ? 1 : 0;
+    }
+    if (count != 8) {
+      bench::fail("expected 8 query parameters");
+    }
+    keep(count);
+  }
+  mock::closeTransaction(txn);
+}
+
+void benchmarkFindQueryParam(size_t iterations) {
+  TSHttpTxn txn = getSearchTransaction();
+  Url &url = utils::internal::getTransaction(txn).getClientRequest().getUrl();
+  const StringView name("utm_medium");
+  for (size_t i = 0; i < iterations; ++i) {
+    StringView medium = url.findQueryParam(name);
+    if (medium.size() != 5) {
+      bench::fail("query parameter utm_medium not found");
+    }
+    keep(medium.size());
+  }
+  mock::closeTransaction(txn);
+}
+
+} /* anonymous namespace */
+
+BENCHMARK(url.first_use, benchmarkFirstUse);
+BENCHMARK(url.getters, benchmarkGetters);
+BENCHMARK(url.get_url_string, benchmarkGetUrlString);
+BENCHMARK(url.query_params, benchmarkQueryParams);
+BENCHMARK(url.find_query_param, benchmarkFindQueryParam);
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario c_header_rewrite: HeaderRewrite.cc written against the C API. The hooks are
+ * added per transaction as the TransactionPlugin's are.
+ */
+
+#include <ts/ts.h>
+
+static TSCont rewrite_cont;
+
+static void setHeader(TSMBuffer bufp, TSMLoc hdr_loc, const char *name, const char *value) {
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, name, -1);
+  if (field_loc == TS_NULL_MLOC) {
+    if (TSMimeHdrFieldCreateNamed(bufp, hdr_loc, name, -1, &field_loc) != TS_SUCCESS) {
+      return;
+    }
+    TSMimeHdrFieldValueStringSet(bufp, hdr_loc, field_loc, -1, value, -1);
+    TSMimeHdrFieldAppend(bufp, hdr_loc, field_loc);
+  } else {
+    TSMimeHdrFieldValuesClear(bufp, hdr_loc, field_loc);
+    TSMimeHdrFieldValueStringSet(bufp, hdr_loc, field_loc, -1, value, -1);
+  }
+  TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+}
+
+static void eraseHeader(TSMBuffer bufp, TSMLoc hdr_loc, const char *name) {
+  TSMLoc field_loc = TSMimeHdrFieldFind(bufp, hdr_loc, name, -1);
+  while (field_loc != TS_NULL_MLOC) {
+    TSMLoc next_loc = TSMimeHdrFieldNextDup(bufp, hdr_loc, field_loc);
+    TSMimeHdrFieldDestroy(bufp, hdr_loc, field_loc);
+    TSHandleMLocRelease(bufp, hdr_loc, field_loc);
+    field_loc = next_loc;
+  }
+}
+
+static int handleEvents(TSCont contp, TSEvent event, void *edata) {
+  TSHttpTxn txnp = (TSHttpTxn) edata;
+  TSMBuffer bufp;
+  TSMLoc hdr_loc;
+  switch (event) {
+  case TS_EVENT_HTTP_READ_REQUEST_HDR:
+    TSHttpTxnHookAdd(txnp, TS_HTTP_SEND_REQUEST_HDR_HOOK, rewrite_cont);
+    TSHttpTxnHookAdd(txnp, TS_HTTP_SEND_RESPONSE_HDR_HOOK, rewrite_cont);
+    break;
+  case TS_EVENT_HTTP_SEND_REQUEST_HDR:
+    if (TSHttpTxnServerReqGet(txnp, &bufp, &hdr_loc) == TS_SUCCESS) {
+      setHeader(bufp, hdr_loc, "X-Bench-Request", "1");
+      eraseHeader(bufp, hdr_loc, "X-Debug");
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+    }
+    break;
+  case TS_EVENT_HTTP_SEND_RESPONSE_HDR:
+    if (TSHttpTxnClientRespGet(txnp, &bufp, &hdr_loc) == TS_SUCCESS) {
+      setHeader(bufp, hdr_loc, "X-Bench-Response", "1");
+      eraseHeader(bufp, hdr_loc, "X-Origin-Id");
+      TSHandleMLocRelease(bufp, TS_NULL_MLOC, hdr_loc);
+    }
+    break;
+  default:
+    break;
+  }
+  TSHttpTxnReenable(txnp, TS_EVENT_HTTP_CONTINUE);
+  return 0;
+}
+
+void TSPluginInit(int argc, const char *argv[]) {
+  rewrite_cont = TSContCreate(handleEvents, NULL);
+  TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, rewrite_cont);
+}
@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario c_null_hook: NullGlobalHook.cc written against the C API, the baseline
+ * the library's overhead is measured against.
+ */
+
+#include <ts/ts.h>
+
+static int handleReadRequestHeaders(TSCont contp, TSEvent event, void *edata) {
+  TSHttpTxnReenable((TSHttpTxn) edata, TS_EVENT_HTTP_CONTINUE);
+  return 0;
+}
+
+void TSPluginInit(int argc, const char *argv[]) {
+  TSHttpHookAdd(TS_HTTP_READ_REQUEST_HDR_HOOK, TSContCreate(handleReadRequestHeaders, NULL));
+}
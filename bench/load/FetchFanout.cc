@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario fetch_fanout: before a request goes to the origin, a number of AsyncHttpFetches
+ * are issued in parallel and the transaction resumes once all of them completed, as a plugin gathering
+ * data from backends would.
+ *
+ * plugin.config: FetchFanout.so [fetch url] [fetches per request]
+ */
+
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransactionPlugin.h>
+#include <atscppapi/Async.h>
+#include <atscppapi/AsyncHttpFetch.h>
+#include <atscppapi/Logger.h>
+#include <atscppapi/PluginInit.h>
+#include <cstdlib>
+#include <string>
+
+using namespace atscppapi;
+using std::string;
+
+#define TAG "bench_fetch_fanout"
+
+namespace {
+string fetch_url = "http://127.0.0.1:8081/fanout";
+int fetches_per_request = 4;
+}
+
+class FetchFanoutPlugin : public TransactionPlugin, public AsyncReceiver<AsyncHttpFetch> {
+public:
+  FetchFanoutPlugin(Transaction &transaction)
+    : TransactionPlugin(transaction), transaction_(transaction), fetches_pending_(fetches_per_request) {
+    for (int i = 0; i < fetches_per_request; ++i) {
+      Async::execute<AsyncHttpFetch>(this, new AsyncHttpFetch(fetch_url), getMutex());
+    }
+  }
+
+  void handleAsyncComplete(AsyncHttpFetch &async_http_fetch) {
+    if (async_http_fetch.getResult() != AsyncHttpFetch::RESULT_SUCCESS) {
+      TS_ERROR(TAG, "Fetch of %s failed with result %d", fetch_url.c_str(),
+               static_cast<int>(async_http_fetch.getResult()));
+    }
+    if (--fetches_pending_ == 0) {
+      transaction_.resume();
+    }
+  }
+
+private:
+  Transaction &transaction_;
+  int fetches_pending_;
+};
+
+class FetchFanoutGlobalPlugin : public GlobalPlugin {
+public:
+  FetchFanoutGlobalPlugin() {
+    registerHook(HOOK_READ_REQUEST_HEADERS_POST_REMAP);
+  }
+
+  virtual void handleReadRequestHeadersPostRemap(Transaction &transaction) {
+    // the fetches are transactions too, they must not fan out again
+    if (transaction.isInternalRequest() || (fetches_per_request <= 0)) {
+      transaction.resume();
+      return;
+    }
+    transaction.addPlugin(new FetchFanoutPlugin(transaction)); // it resumes the transaction
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  if (argc > 1) {
+    fetch_url = argv[1];
+  }
+  if (argc > 2) {
+    fetches_per_request = atoi(argv[2]);
+  }
+  TS_DEBUG(TAG, "%d fetches of %s per request", fetches_per_request, fetch_url.c_str());
+  GlobalPlugin *instance = new FetchFanoutGlobalPlugin();
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario gzip: responses the origin sent uncompressed are deflated for clients that
+ * accept gzip. The headers are fixed up on the server response, the client response is copied from it.
+ */
+
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/GzipDeflateTransformation.h>
+#include <atscppapi/PluginInit.h>
+#include <string>
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+
+class GzipTransformGlobalPlugin : public GlobalPlugin {
+public:
+  GzipTransformGlobalPlugin() {
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+  }
+
+  virtual void handleReadResponseHeaders(Transaction &transaction) {
+    Headers &response_headers = transaction.getServerResponse().getHeaders();
+    StringView accept_encoding = transaction.getClientRequest().getHeaders().getValueView(HEADER_ACCEPT_ENCODING);
+    if (accept_encoding.str().find("gzip") != std::string::npos &&
+        response_headers.getValueView(HEADER_CONTENT_ENCODING).empty()) {
+      transaction.addPlugin(new GzipDeflateTransformation(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION));
+      response_headers.set(HEADER_CONTENT_ENCODING, "gzip");
+      response_headers.erase(HEADER_CONTENT_LENGTH);
+      response_headers.append("Vary", "Accept-Encoding");
+    }
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  GlobalPlugin *instance = new GzipTransformGlobalPlugin();
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario header_rewrite: a TransactionPlugin per request that sets and removes a header
+ * on the way to the origin and on the way back. CHeaderRewrite.c makes the same edits on the C API.
+ */
+
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransactionPlugin.h>
+#include <atscppapi/PluginInit.h>
+
+using namespace atscppapi;
+
+class HeaderRewritePlugin : public TransactionPlugin {
+public:
+  HeaderRewritePlugin(Transaction &transaction) : TransactionPlugin(transaction) {
+    registerHook(HOOK_SEND_REQUEST_HEADERS);
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  }
+
+  virtual void handleSendRequestHeaders(Transaction &transaction) {
+    Headers &headers = transaction.getServerRequest().getHeaders();
+    headers.set("X-Bench-Request", "1");
+    headers.erase("X-Debug");
+    transaction.resume();
+  }
+
+  virtual void handleSendResponseHeaders(Transaction &transaction) {
+    Headers &headers = transaction.getClientResponse().getHeaders();
+    headers.set("X-Bench-Response", "1");
+    headers.erase("X-Origin-Id");
+    transaction.resume();
+  }
+};
+
+class HeaderRewriteGlobalPlugin : public GlobalPlugin {
+public:
+  HeaderRewriteGlobalPlugin() {
+    registerHook(HOOK_READ_REQUEST_HEADERS_PRE_REMAP);
+  }
+
+  virtual void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+    transaction.addPlugin(new HeaderRewritePlugin(transaction));
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  GlobalPlugin *instance = new HeaderRewriteGlobalPlugin();
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/*
+ * Load test scenario null_transform: every response body passes through a TransformationPlugin
+ * unchanged, the cost of the transformation plumbing alone.
+ */
+
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/TransformationPlugin.h>
+#include <atscppapi/PluginInit.h>
+
+using namespace atscppapi;
+
+class NullTransformationPlugin : public TransformationPlugin {
+public:
+  NullTransformationPlugin(Transaction &transaction) : TransformationPlugin(transaction, RESPONSE_TRANSFORMATION) { }
+
+  void consume(InputBuffer &input) {
+    produce(input);
+  }
+
+  void handleInputComplete() {
+    setOutputComplete();
+  }
+};
+
+class NullTransformGlobalPlugin : public GlobalPlugin {
+public:
+  NullTransformGlobalPlugin() {
+    registerHook(HOOK_READ_RESPONSE_HEADERS);
+  }
+
+  virtual void handleReadResponseHeaders(Transaction &transaction) {
+    transaction.addPlugin(new NullTransformationPlugin(transaction));
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  GlobalPlugin *instance = new NullTransformGlobalPlugin();
+}
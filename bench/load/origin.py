@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2013 LinkedIn Corp. All rights reserved. 
+# Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+# except in compliance with the License. You may obtain a copy of the license at
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software distributed under the
+# License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+# either express or implied.
+#
+
+"""The fixed origin of the load tests: canned uncacheable responses over keep-alive connections.
+
+  /small   1KB of text
+  /page    64KB of HTML, compressible like a real page
+  /fanout  a few bytes, for the fetches of the fetch_fanout scenario
+
+Usage: origin.py [port]   (default 8081)
+"""
+
+import asyncio
+import sys
+
+
+def make_page(size):
+    items = []
+    length = 0
+    i = 0
+    while length < size:
+        item = ('<li class="result r%d"><a href="/products/%d?ref=%08x">Product %d</a>'
+                '<span class="price">%d.%02d</span></li>\n' % (i % 7, i, (i * 2654435761) & 0xffffffff, i,
+                                                                (i * 37) % 500, i % 100))
+        items.append(item)
+        length += len(item)
+        i += 1
+    return ''.join(items).encode()[:size]
+
+
+def make_response(body, content_type):
+    head = ('HTTP/1.1 200 OK\r\n'
+            'Content-Type: %s\r\n'
+            'Content-Length: %d\r\n'
+            'Cache-Control: no-store\r\n'
+            'X-Origin-Id: bench-origin\r\n'
+            '\r\n' % (content_type, len(body)))
+    return head.encode() + body
+
+
+RESPONSES = {
+    b'/small': make_response(b'x' * 1023 + b'\n', 'text/plain'),
+    b'/page': make_response(make_page(64 * 1024), 'text/html'),
+    b'/fanout': make_response(b'ok\n', 'text/plain'),
+}
+NOT_FOUND = b'HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nCache-Control: no-store\r\n\r\n'
+
+
+async def serve(reader, writer):
+    try:
+        while True:
+            head = await reader.readuntil(b'\r\n\r\n')
+            request_line = head.split(b'\r\n', 1)[0].split(b' ')
+            path = request_line[1].split(b'?', 1)[0] if len(request_line) > 1 else b''
+            if path.startswith(b'http://'):
+                path = b'/' + path.split(b'/', 3)[-1]
+            for line in head.split(b'\r\n')[1:]:
+                if line.lower().startswith(b'content-length:'):
+                    await reader.readexactly(int(line.split(b':', 1)[1]))
+            writer.write(RESPONSES.get(path, NOT_FOUND))
+            await writer.drain()
+    except (asyncio.IncompleteReadError, ConnectionError):
+        pass
+    finally:
+        writer.close()
+
+
+async def main(port):
+    server = await asyncio.start_server(serve, '127.0.0.1', port, backlog=1024)
+    async with server:
+        await server.serve_forever()
+
+
+if __name__ == '__main__':
+    asyncio.run(main(int(sys.argv[1]) if len(sys.argv) > 1 else 8081))
@@ -0,0 +1,154 @@
+#!/bin/bash
+#
+# Copyright (c) 2013 LinkedIn Corp. All rights reserved. 
+# Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+# except in compliance with the License. You may obtain a copy of the license at
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software distributed under the
+# License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+# either express or implied.
+#
+# Runs the load test scenarios: for each one traffic_server is started with the scenario's plugin, proxying
+# to origin.py, and wrk drives it. Reported per scenario: requests per second, p50 and p99 latency and the
+# CPU time traffic_server spent per request. The results are also appended to a CSV file under a label,
+# so that runs of different releases on the same machine can be compared.
+#
+# Usage: run_load.sh [scenario...]              all scenarios without arguments
+#        make bench-load LOAD_ARGS="null_hook c_null_hook"
+#
+# Environment:
+#   TS_PREFIX          the Traffic Server installation, required
+#   TS_CONFIG_DIR      its configuration, $TS_PREFIX/etc/trafficserver by default. plugin.config and
+#                      remap.config are replaced for each scenario and restored when the run ends.
+#   PLUGIN_DIR         where the scenario plugins are built, .libs next to this script by default
+#   ATSCPPAPI_LIB_DIR  where libatscppapi.so is when it's not installed
+#   PROXY_PORT         8080
+#   ORIGIN_PORT        8081
+#   DURATION           seconds measured per scenario, 30
+#   WARMUP             seconds of load before measuring, 5
+#   CONNECTIONS        wrk connections, 64
+#   THREADS            wrk threads, 4
+#   LABEL              the label of the results, git describe by default
+#   RESULTS            the CSV file appended to, load-results.csv
+#
+# Keep the machine otherwise idle and its settings (CPU governor, traffic_server threads) the same
+# between runs that are compared, only numbers from the same machine are comparable.
+
+set -e -u
+
+SCRIPT_DIR=$(cd "$(dirname "$0")" && pwd)
+: "${TS_PREFIX:?set TS_PREFIX to the Traffic Server installation}"
+TS_CONFIG_DIR=${TS_CONFIG_DIR:-$TS_PREFIX/etc/trafficserver}
+PLUGIN_DIR=${PLUGIN_DIR:-$SCRIPT_DIR/.libs}
+PROXY_PORT=${PROXY_PORT:-8080}
+ORIGIN_PORT=${ORIGIN_PORT:-8081}
+DURATION=${DURATION:-30}
+WARMUP=${WARMUP:-5}
+CONNECTIONS=${CONNECTIONS:-64}
+THREADS=${THREADS:-4}
+LABEL=${LABEL:-$(git -C "$SCRIPT_DIR" describe --always --dirty 2>/dev/null || echo unknown)}
+RESULTS=${RESULTS:-load-results.csv}
+if [ -n "${ATSCPPAPI_LIB_DIR:-}" ]; then
+  export LD_LIBRARY_PATH="$ATSCPPAPI_LIB_DIR${LD_LIBRARY_PATH:+:$LD_LIBRARY_PATH}"
+fi
+
+# name|path requested|plugin.config line, the baselines run without a plugin
+SCENARIOS="
+baseline|/small|
+c_null_hook|/small|CNullGlobalHook.so
+null_hook|/small|NullGlobalHook.so
+c_header_rewrite|/small|CHeaderRewrite.so
+header_rewrite|/small|HeaderRewrite.so
+fetch_fanout|/small|FetchFanout.so http://127.0.0.1:$ORIGIN_PORT/fanout 4
+baseline_page|/page|
+null_transform|/page|NullTransform.so
+gzip|/page|GzipTransform.so
+"
+
+for tool in wrk python3 curl; do
+  command -v $tool > /dev/null || { echo "$tool is required" >&2; exit 1; }
+done
+
+WORK_DIR=$(mktemp -d)
+origin_pid=
+ts_pid=
+cp "$TS_CONFIG_DIR/plugin.config" "$TS_CONFIG_DIR/remap.config" "$WORK_DIR/"
+
+cleanup() {
+  [ -n "$ts_pid" ] && kill $ts_pid 2> /dev/null && wait $ts_pid 2> /dev/null
+  [ -n "$origin_pid" ] && kill $origin_pid 2> /dev/null
+  cp "$WORK_DIR/plugin.config" "$WORK_DIR/remap.config" "$TS_CONFIG_DIR/"
+  rm -rf "$WORK_DIR"
+}
+trap cleanup EXIT
+
+# waits until url answers, $2 tries a tenth of a second apart
+waitFor() {
+  for ((i = 0; i < $2; ++i)); do
+    curl -s -o /dev/null "$1" && return 0
+    sleep 0.1
+  done
+  echo "$1 didn't answer" >&2
+  return 1
+}
+
+# user plus system CPU time of a process in clock ticks, the fields after the command name
+cpuTicks() {
+  sed 's/.*) //' /proc/$1/stat | awk '{ print $12 + $13 }'
+}
+
+# wrk's latencies (850.00us, 1.23ms, 1.02s) in milliseconds
+toMilliseconds() {
+  awk '{ v = $1 + 0; if ($1 ~ /us$/) v /= 1000; else if ($1 ~ /[0-9]s$/) v *= 1000; else if ($1 ~ /m$/) v *= 60000;
+         printf "%.3f", v }'
+}
+
+runScenario() {
+  local name=$1 path=$2 plugin=$3
+  if [ -n "$plugin" ]; then
+    echo "$PLUGIN_DIR/$plugin" > "$TS_CONFIG_DIR/plugin.config"
+  else
+    : > "$TS_CONFIG_DIR/plugin.config"
+  fi
+  "$TS_PREFIX/bin/traffic_server" -p $PROXY_PORT > "$WORK_DIR/traffic_server.$name.log" 2>&1 &
+  ts_pid=$!
+  local url=http://127.0.0.1:$PROXY_PORT$path
+  waitFor "$url" 300
+
+  wrk -t $THREADS -c $CONNECTIONS -d ${WARMUP}s -H "Accept-Encoding: gzip" "$url" > /dev/null
+  local ticks_before=$(cpuTicks $ts_pid)
+  local output=$(wrk --latency -t $THREADS -c $CONNECTIONS -d ${DURATION}s -H "Accept-Encoding: gzip" "$url")
+  local ticks_after=$(cpuTicks $ts_pid)
+  kill $ts_pid
+  wait $ts_pid 2> /dev/null || true
+  ts_pid=
+
+  local requests=$(awk '/requests in/ { print $1 }' <<< "$output")
+  local rps=$(awk '/^Requests\/sec:/ { print $2 }' <<< "$output")
+  local p50=$(awk '$1 == "50%" { print $2 }' <<< "$output" | toMilliseconds)
+  local p99=$(awk '$1 == "99%" { print $2 }' <<< "$output" | toMilliseconds)
+  local errors=$(awk '/Non-2xx or 3xx responses:/ { n += $NF } /Socket errors:/ { n += 1 } END { print n + 0 }' \
+                 <<< "$output")
+  local cpu_us=$(awk -v ticks=$((ticks_after - ticks_before)) -v hz=$(getconf CLK_TCK) -v requests=$requests \
+                 'BEGIN { printf "%.2f", requests ? ticks / hz * 1000000 / requests : 0 }')
+
+  printf "%-18s %12s %10s %10s %14s %8s\n" $name $rps $p50 $p99 $cpu_us $errors
+  [ -s "$RESULTS" ] || echo "label,scenario,requests_per_second,p50_ms,p99_ms,cpu_us_per_request,errors" > "$RESULTS"
+  echo "$LABEL,$name,$rps,$p50,$p99,$cpu_us,$errors" >> "$RESULTS"
+}
+
+echo "map http://127.0.0.1:$PROXY_PORT/ http://127.0.0.1:$ORIGIN_PORT/" > "$TS_CONFIG_DIR/remap.config"
+python3 "$SCRIPT_DIR/origin.py" $ORIGIN_PORT &
+origin_pid=$!
+waitFor http://127.0.0.1:$ORIGIN_PORT/small 50
+
+printf "%-18s %12s %10s %10s %14s %8s\n" scenario "requests/s" "p50 ms" "p99 ms" "cpu us/request" errors
+while IFS='|' read -r name path plugin; do
+  [ -z "$name" ] && continue
+  if [ $# -gt 0 ] && ! [[ " $* " == *" $name "* ]]; then
+    continue
+  fi
+  runScenario "$name" "$path" "$plugin"
+done <<< "$SCENARIOS"
+echo "results appended to $RESULTS as $LABEL"
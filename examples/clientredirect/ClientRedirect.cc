@@ -11,8 +11,8 @@
  */
 
 #include <iostream>
+#include <atscppapi/CustomResponse.h>
 #include <atscppapi/GlobalPlugin.h>
-#include <atscppapi/TransactionPlugin.h>
 #include <atscppapi/PluginInit.h>
 
 using namespace atscppapi;
@@ -23,46 +23,30 @@ using std::list;
 using std::string;
 
 
-class ClientRedirectTransactionPlugin : public atscppapi::TransactionPlugin {
-public:
-  ClientRedirectTransactionPlugin(Transaction &transaction, const string &location)
-     : TransactionPlugin(transaction), location_(location) {
-
-    //
-    // We will set this transaction to jump to error state and then we will setup
-    // the redirect on SEND_RESPONSE_HEADERS
-    //
-    TransactionPlugin::registerHook(HOOK_SEND_RESPONSE_HEADERS);
-    transaction.error();
-  }
-
-  void handleSendResponseHeaders(Transaction &transaction) {
-    transaction.getClientResponse().setStatusCode(HTTP_STATUS_MOVED_TEMPORARILY);
-    transaction.getClientResponse().setReasonPhrase("Moved Temporarily");
-    transaction.getClientResponse().getHeaders().set("Location", location_);
-    transaction.resume();
-  }
-
-  virtual ~ClientRedirectTransactionPlugin() { }
-private:
-  string location_;
-};
-
-
 class ClientRedirectGlobalPlugin : public GlobalPlugin {
 public:
-  ClientRedirectGlobalPlugin() {
+  ClientRedirectGlobalPlugin() : redirect_(CustomResponse::createRedirect("http://www.linkedin.com/")) {
+    redirect_->setReasonPhrase("Moved Temporarily");
     registerHook(HOOK_SEND_REQUEST_HEADERS);
   }
 
   void handleSendRequestHeaders(Transaction &transaction) {
     if(transaction.getClientRequest().getUrl().getQuery().find("redirect=1") != string::npos) {
-      transaction.addPlugin(new ClientRedirectTransactionPlugin(transaction, "http://www.linkedin.com/"));
+      //
+      // The transaction jumps to the error state with a 302 response, its
+      // Location header is set on SEND_RESPONSE_HEADERS.
+      //
+      redirect_->send(transaction);
       return;
     }
     transaction.resume();
   }
 
+  virtual ~ClientRedirectGlobalPlugin() {
+    delete redirect_;
+  }
+private:
+  CustomResponse *redirect_;
 };
 
 void TSPluginInit(int argc, const char *argv[]) {
@@ -12,8 +12,8 @@
 
 #include <iostream>
 #include <string>
+#include <atscppapi/CustomResponse.h>
 #include <atscppapi/GlobalPlugin.h>
-#include <atscppapi/TransactionPlugin.h>
 #include <atscppapi/PluginInit.h>
 
 using namespace atscppapi;
@@ -24,51 +24,33 @@ using std::string;
 
 /*
  *
- * This example demonstrates how you can exploit .error() to send
- * any response from any state by forcing the state machine to
- * jump to the error state. You will then send your custom
- * response in sendResponseHeaders() rather than the error page.
+ * This example demonstrates how you can send any response from any
+ * state without an origin request or a server intercept. The response
+ * is built once; CustomResponse::send() takes the transaction to the
+ * error state with it, the status and headers are put onto the
+ * response Traffic Server builds for the error.
  *
  */
 
-class CustomResponseTransactionPlugin : public atscppapi::TransactionPlugin {
-public:
-  CustomResponseTransactionPlugin(Transaction &transaction, HttpStatus status, const string &reason, const string &body)
-     : TransactionPlugin(transaction), status_(status), reason_(reason), body_(body) {
-    TransactionPlugin::registerHook(HOOK_SEND_RESPONSE_HEADERS);
-    transaction.error(body_); // Set the error body now, and change the status and reason later.
-  }
-
-  void handleSendResponseHeaders(Transaction &transaction) {
-    transaction.getClientResponse().setStatusCode(status_);
-    transaction.getClientResponse().setReasonPhrase(reason_);
-    transaction.resume();
-  }
-
-  virtual ~CustomResponseTransactionPlugin() { }
-private:
-  HttpStatus status_;
-  string reason_;
-  string body_;
-};
-
-
 class ClientRedirectGlobalPlugin : public GlobalPlugin {
 public:
-  ClientRedirectGlobalPlugin() {
+  ClientRedirectGlobalPlugin()
+    : custom_response_(HTTP_STATUS_OK, "Hello! This is a custom response without making "
+                                       "an origin request and no server intercept.", "text/plain") {
+    custom_response_.setReasonPhrase("Ok");
     registerHook(HOOK_SEND_REQUEST_HEADERS);
   }
 
   void handleSendRequestHeaders(Transaction &transaction) {
     if(transaction.getClientRequest().getUrl().getQuery().find("custom=1") != string::npos) {
-      transaction.addPlugin(new CustomResponseTransactionPlugin(transaction, HTTP_STATUS_OK, "Ok",
-                                                                "Hello! This is a custom response without making "
-                                                                "an origin request and no server intercept."));
-      return; // dont forget to return since the CustomResponse call will call .error().
+      custom_response_.send(transaction);
+      return; // dont forget to return since send() calls .error().
     }
     transaction.resume();
   }
 
+private:
+  CustomResponse custom_response_;
 };
 
 void TSPluginInit(int argc, const char *argv[]) {
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+#include <string>
+#include <atscppapi/GlobalPlugin.h>
+#include <atscppapi/InterceptPlugin.h>
+#include <atscppapi/PluginInit.h>
+
+using namespace atscppapi;
+using std::string;
+
+/*
+ * This example answers requests for /health itself with an InterceptPlugin and echoes
+ * the body of a POST to /echo, every other request goes to the origin as usual.
+ */
+
+class HealthCheckIntercept : public InterceptPlugin {
+public:
+  HealthCheckIntercept(Transaction &transaction) : InterceptPlugin(transaction, TRANSACTION_INTERCEPT) { }
+
+  void handleInputComplete() {
+    getResponse().getHeaders().set("Content-Type", "text/plain");
+    produce("OK\n", 3);
+    setOutputComplete();
+  }
+};
+
+class EchoIntercept : public InterceptPlugin {
+public:
+  EchoIntercept(Transaction &transaction) : InterceptPlugin(transaction, TRANSACTION_INTERCEPT) { }
+
+  void consume(const StringView &data) {
+    produce(data.data(), data.length());
+  }
+
+  void handleInputComplete() {
+    getResponse().getHeaders().set("Content-Type", "application/octet-stream");
+    setOutputComplete();
+  }
+};
+
+class InterceptInstaller : public GlobalPlugin {
+public:
+  InterceptInstaller() {
+    GlobalPlugin::registerHook(Plugin::HOOK_READ_REQUEST_HEADERS_PRE_REMAP);
+  }
+
+  void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+    const string &path = transaction.getClientRequest().getUrl().getPath();
+    if (path == "health") {
+      transaction.addPlugin(new HealthCheckIntercept(transaction));
+    } else if (path == "echo") {
+      transaction.addPlugin(new EchoIntercept(transaction));
+    }
+    transaction.resume();
+  }
+};
+
+void TSPluginInit(int argc, const char *argv[]) {
+  new InterceptInstaller();
+}
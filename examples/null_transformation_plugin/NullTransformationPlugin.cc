@@ -10,6 +10,7 @@
  *
  */
 
+#include <cstdlib>
 #include <iostream>
 #include <atscppapi/GlobalPlugin.h>
 #include <atscppapi/TransactionPlugin.h>
@@ -30,6 +31,11 @@ public:
   NullTransformationPlugin(Transaction &transaction)
     : TransformationPlugin(transaction, RESPONSE_TRANSFORMATION) {
     registerHook(HOOK_SEND_RESPONSE_HEADERS);
+    // The body goes through unchanged, so the client can get the origin's Content-Length instead of chunks.
+    string content_length = transaction.getServerResponse().getHeaders().getJoinedValues("Content-Length");
+    if (!content_length.empty()) {
+      setOutputLength(strtoul(content_length.c_str(), NULL, 10));
+    }
   }
 
   void handleSendResponseHeaders(Transaction &transaction) {
@@ -37,8 +43,9 @@ public:
     transaction.resume();
   }
 
-  void consume(const string &data) {
-    produce(data);
+  void consume(InputBuffer &input) {
+    // Pass the upstream blocks straight through, nothing is copied.
+    produce(input);
   }
 
   void handleInputComplete() {
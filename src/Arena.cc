@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Arena.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/Arena.h"
+#include "ArenaAllocated.h"
+#include <cstring>
+#include <ts/ts.h>
+#include "logging_internal.h"
+
+using atscppapi::Arena;
+using atscppapi::ArenaAllocated;
+
+namespace {
+
+__thread Arena *current_arena = NULL;
+
+inline size_t alignSize(size_t size) {
+  return (size + Arena::ALIGNMENT - 1) & ~(Arena::ALIGNMENT - 1);
+}
+
+/** Blocks start with their Block header, padded so the memory after it stays aligned. */
+const size_t BLOCK_HEADER_SIZE = Arena::ALIGNMENT;
+
+}
+
+Arena::Arena() : pos_(initial_block_), end_(initial_block_ + BLOCK_SIZE), blocks_(NULL), cleanups_(NULL),
+                 bytes_allocated_(0), allocation_count_(0), bytes_reserved_(0) {
+}
+
+void *Arena::allocate(size_t size) {
+  size = alignSize(size ? size : 1);
+  ++allocation_count_;
+  if (size > static_cast<size_t>(end_ - pos_)) {
+    // large allocations get a block of their own so the rest of the current block isn't wasted
+    bool dedicated = (size > (BLOCK_SIZE / 4));
+    size_t block_size = BLOCK_HEADER_SIZE + (dedicated ? size : BLOCK_SIZE);
+    Block *block = static_cast<Block *>(TSmalloc(block_size));
+    block->next_ = blocks_;
+    blocks_ = block;
+    bytes_reserved_ += block_size;
+    char *memory = reinterpret_cast<char *>(block) + BLOCK_HEADER_SIZE;
+    bytes_allocated_ += size;
+    if (dedicated) {
+      return memory;
+    }
+    pos_ = memory;
+    end_ = memory + BLOCK_SIZE;
+  }
+  void *memory = pos_;
+  pos_ += size;
+  bytes_allocated_ += size;
+  return memory;
+}
+
+char *Arena::copy(const char *data, size_t length) {
+  char *memory = static_cast<char *>(allocate(length + 1));
+  if (length) {
+    memcpy(memory, data, length);
+  }
+  memory[length] = '\0';
+  return memory;
+}
+
+void Arena::addCleanup(CleanupFunction function, void *data) {
+  Cleanup *cleanup = static_cast<Cleanup *>(allocate(sizeof(Cleanup)));
+  cleanup->function_ = function;
+  cleanup->data_ = data;
+  cleanup->next_ = cleanups_;
+  cleanups_ = cleanup;
+}
+
+void Arena::reset() {
+  Cleanup *cleanup = cleanups_;
+  cleanups_ = NULL; // cleanups may not add cleanups of their own
+  for (; cleanup; cleanup = cleanup->next_) {
+    cleanup->function_(cleanup->data_);
+  }
+  while (blocks_) {
+    Block *next = blocks_->next_;
+    TSfree(blocks_);
+    blocks_ = next;
+  }
+  LOG_DEBUG("Reset arena %p after %zu allocations of %zu bytes in total, %zu bytes from the heap", this,
+            allocation_count_, bytes_allocated_, bytes_reserved_);
+  pos_ = initial_block_;
+  end_ = initial_block_ + BLOCK_SIZE;
+  bytes_allocated_ = 0;
+  allocation_count_ = 0;
+  bytes_reserved_ = 0;
+}
+
+Arena::~Arena() {
+  reset();
+}
+
+Arena::Scope::Scope(Arena *arena) : previous_(current_arena) {
+  current_arena = arena;
+}
+
+Arena::Scope::~Scope() {
+  current_arena = previous_;
+}
+
+Arena *Arena::getCurrent() {
+  return current_arena;
+}
+
+namespace {
+
+/** Precedes each ArenaAllocated object; the Arena it came from, NULL for the heap. */
+const size_t ALLOCATION_HEADER_SIZE = Arena::ALIGNMENT;
+
+}
+
+void *ArenaAllocated::operator new(size_t size) {
+  Arena *arena = Arena::getCurrent();
+  void *memory = arena ? arena->allocate(ALLOCATION_HEADER_SIZE + size) : TSmalloc(ALLOCATION_HEADER_SIZE + size);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  *static_cast<Arena **>(memory) = arena;
+  return static_cast<char *>(memory) + ALLOCATION_HEADER_SIZE;
+}
+
+void ArenaAllocated::operator delete(void *ptr) {
+  if (!ptr) {
+    return;
+  }
+  void *memory = static_cast<char *>(ptr) - ALLOCATION_HEADER_SIZE;
+  if (!*static_cast<Arena **>(memory)) {
+    TSfree(memory);
+  } // else the memory goes away with the arena
+}
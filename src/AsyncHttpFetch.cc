@@ -19,8 +19,14 @@
 #include "atscppapi/AsyncHttpFetch.h"
 #include <ts/ts.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <cstdio>
+#include <cstring>
+#include <vector>
 #include "logging_internal.h"
 #include "utils_internal.h"
+#include "TraceFetchSpan.h"
+#include "HookFilterRequest.h"
 
 using namespace atscppapi;
 using std::string;
@@ -37,12 +43,66 @@ struct atscppapi::AsyncHttpFetchState : noncopyable {
   TSMBuffer hdr_buf_;
   TSMLoc hdr_loc_;
   shared_ptr<AsyncDispatchControllerBase> dispatch_controller_;
+  AsyncHttpFetch::StreamingFlag streaming_flag_;
+  TSFetchSM fetch_sm_; // streaming mode only, it owns the response headers then
+  TSCont fetch_cont_;
+  std::vector<char> body_chunk_;
+  volatile bool body_paused_;
+  bool body_done_; // the whole body has arrived, some may still be unread when paused
+  sockaddr_storage client_address_;
+  int timeout_ms_;
+  TSAction timeout_action_;
+  TSAction resume_action_; // the pending event of resumeBody(), under the mutex of fetch_cont_
+  bool timed_out_; // the receiver got RESULT_TIMEOUT, the fetch itself may still be running
+  const void *request_body_;
+  size_t request_body_size_;
+  TSIOBufferReader request_body_reader_;
+  shared_ptr<TraceFetchSpan> trace_span_; // only for traced fetches
 
-  AsyncHttpFetchState(const string &url_str, HttpMethod http_method)
-    : request_(url_str, http_method, HTTP_VERSION_1_0), result_(AsyncHttpFetch::RESULT_FAILURE), body_(NULL),
-      body_size_(0), hdr_buf_(NULL), hdr_loc_(NULL) { }
+  AsyncHttpFetchState(const string &url_str, HttpMethod http_method, const AsyncHttpFetch::Options &options)
+    : request_(url_str, http_method, (options.streaming_flag_ == AsyncHttpFetch::STREAMING_ENABLED) ?
+               HTTP_VERSION_1_1 : options.http_version_), result_(AsyncHttpFetch::RESULT_FAILURE), body_(NULL),
+      body_size_(0), hdr_buf_(NULL), hdr_loc_(NULL), streaming_flag_(options.streaming_flag_), fetch_sm_(NULL),
+      fetch_cont_(NULL), body_paused_(false), body_done_(false), timeout_ms_(options.timeout_ms_),
+      timeout_action_(NULL), resume_action_(NULL), timed_out_(false), request_body_(NULL), request_body_size_(0),
+      request_body_reader_(NULL) {
+    setClientAddress(options.client_address_);
+    if (options.passthrough_) {
+      request_.getHeaders().set(PASSTHROUGH_HEADER, "1");
+      HookFilterRequest::passthrough_fetches_made_ = true;
+    }
+  }
+
+  void setClientAddress(const sockaddr *address);
+
+  /** @return The size of the request body, and adds the Content-Length header for it if there is none. */
+  size_t prepareRequestBody();
+
+  /** Hands every block of the request body to write, then consumes the reader if there is one. */
+  template <typename Writer> void writeRequestBody(Writer &write);
+
+  void endTraceSpan() {
+    if (trace_span_ && !trace_span_->end_time_) {
+      trace_span_->end_time_ = TShrtime();
+    }
+  }
+
+  void cancelTimeout() {
+    if (timeout_action_) {
+      TSActionCancel(timeout_action_);
+      timeout_action_ = NULL;
+    }
+  }
+
+  void cancelResume() {
+    if (resume_action_) {
+      TSActionCancel(resume_action_);
+      resume_action_ = NULL;
+    }
+  }
   
   ~AsyncHttpFetchState() {
+    endTraceSpan();
     if (hdr_loc_) {
       TSMLoc null_parent_loc = NULL;
       TSHandleMLocRelease(hdr_buf_, null_parent_loc, hdr_loc_);
@@ -50,19 +110,114 @@ struct atscppapi::AsyncHttpFetchState : noncopyable {
     if (hdr_buf_) {
       TSMBufferDestroy(hdr_buf_);
     }
+    if (fetch_sm_) {
+      TSFetchDestroy(fetch_sm_);
+    }
   }
 };
 
 namespace {
 
-const unsigned int LOCAL_IP_ADDRESS = 0x0100007f;
 const int LOCAL_PORT = 8080;
 
+const size_t BODY_CHUNK_SIZE = 32 * 1024;
+
+}
+
+void AsyncHttpFetchState::setClientAddress(const sockaddr *address) {
+  memset(&client_address_, 0, sizeof(client_address_));
+  if (address) {
+    size_t length = (address->sa_family == AF_INET6) ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+    memcpy(&client_address_, address, length);
+  } else {
+    sockaddr_in *addr = reinterpret_cast<sockaddr_in *>(&client_address_);
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->sin_port = htons(LOCAL_PORT);
+  }
+}
+
+size_t AsyncHttpFetchState::prepareRequestBody() {
+  size_t size = request_body_size_;
+  if (request_body_reader_) {
+    int64_t avail = TSIOBufferReaderAvail(request_body_reader_);
+    size = (avail > 0) ? static_cast<size_t>(avail) : 0;
+  }
+  if ((request_body_ || request_body_reader_) && !request_.getHeaders().count(HEADER_CONTENT_LENGTH)) {
+    char length_str[32];
+    snprintf(length_str, sizeof(length_str), "%zu", size);
+    request_.getHeaders().set(HEADER_CONTENT_LENGTH, length_str);
+  }
+  return size;
+}
+
+template <typename Writer> void AsyncHttpFetchState::writeRequestBody(Writer &write) {
+  if (request_body_) {
+    write(static_cast<const char *>(request_body_), request_body_size_);
+  }
+  if (request_body_reader_) {
+    int64_t consumed = 0;
+    for (TSIOBufferBlock block = TSIOBufferReaderStart(request_body_reader_); block; block = TSIOBufferBlockNext(block)) {
+      int64_t data_length;
+      const char *data = TSIOBufferBlockReadStart(block, request_body_reader_, &data_length);
+      write(data, static_cast<size_t>(data_length));
+      consumed += data_length;
+    }
+    TSIOBufferReaderConsume(request_body_reader_, consumed);
+  }
+}
+
+namespace {
+
+/** TSFetchUrl takes the request in one buffer, the body goes right after the head. */
+struct AppendToString {
+  string &output_;
+  AppendToString(string &output) : output_(output) { }
+  void operator()(const char *data, size_t length) { output_.append(data, length); }
+};
+
+/** A streaming fetch takes the body block by block, without copies of ours. */
+struct WriteToFetch {
+  TSFetchSM fetch_sm_;
+  WriteToFetch(TSFetchSM fetch_sm) : fetch_sm_(fetch_sm) { }
+  void operator()(const char *data, size_t length) { TSFetchWriteData(fetch_sm_, data, length); }
+};
+
+/**
+ * Completes the fetch for the receiver if it's still running once its timeout expired, see Options::timeout_ms_.
+ *
+ * @return true if the event was the timeout.
+ */
+bool handleFetchTimeout(AsyncHttpFetchState *state, TSEvent event) {
+  if ((event != TS_EVENT_TIMEOUT) || !state->timeout_action_) {
+    return false;
+  }
+  LOG_DEBUG("Fetch of [%s] timed out after %d ms", state->request_.getUrl().getUrlString().c_str(), state->timeout_ms_);
+  state->timeout_action_ = NULL;
+  state->timed_out_ = true;
+  state->endTraceSpan();
+  state->result_ = AsyncHttpFetch::RESULT_TIMEOUT;
+  if (!state->dispatch_controller_->dispatch()) {
+    LOG_DEBUG("Unable to dispatch timeout from AsyncFetch because promise has died.");
+  }
+  return true;
+}
+
 static int handleFetchEvents(TSCont cont, TSEvent event, void *edata) {
   LOG_DEBUG("Fetch result returned event = %d, edata = %p", event, edata);
   AsyncHttpFetch *fetch_provider = static_cast<AsyncHttpFetch *>(TSContDataGet(cont));
   AsyncHttpFetchState *state = utils::internal::getAsyncHttpFetchState(*fetch_provider);
-  
+  if (handleFetchTimeout(state, event)) {
+    return 0; // TSFetchUrl can't be canceled, its result is dropped when it arrives
+  }
+  state->cancelTimeout();
+  if (state->timed_out_) {
+    LOG_DEBUG("Dropping result %d of fetch that timed out", event);
+    delete fetch_provider;
+    TSContDestroy(cont);
+    return 0;
+  }
+
   if (event == static_cast<int>(AsyncHttpFetch::RESULT_SUCCESS)) {
     TSHttpTxn txn = static_cast<TSHttpTxn>(edata);
     int data_len;
@@ -96,15 +251,126 @@ static int handleFetchEvents(TSCont cont, TSEvent event, void *edata) {
   return 0;
 }
 
+/**
+ * Ends a streaming fetch, after which the provider is gone.
+ */
+void finishStreamingFetch(AsyncHttpFetch *fetch_provider, AsyncHttpFetchState *state) {
+  state->cancelTimeout();
+  state->cancelResume(); // its event must not reach the destroyed continuation
+  TSContDestroy(state->fetch_cont_);
+  delete fetch_provider; // the state destroys the fetch
+}
+
+/**
+ * @return false if the receiver is gone, the fetch is pointless then.
+ */
+bool dispatchStreamingResult(AsyncHttpFetchState *state, AsyncHttpFetch::Result result) {
+  state->result_ = result;
+  if (!state->dispatch_controller_->dispatch()) {
+    LOG_DEBUG("Unable to dispatch result %d from streaming AsyncFetch because promise has died.", result);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Hands what the fetch has of the body to the receiver, one chunk per invocation, until it's paused.
+ *
+ * @return false if the receiver is gone.
+ */
+bool readStreamingBody(AsyncHttpFetchState *state) {
+  state->body_chunk_.resize(BODY_CHUNK_SIZE);
+  while (!state->body_paused_) {
+    ssize_t length = TSFetchReadData(state->fetch_sm_, &state->body_chunk_[0], state->body_chunk_.size());
+    if (length <= 0) {
+      break;
+    }
+    state->body_ = &state->body_chunk_[0];
+    state->body_size_ = length;
+    bool receiver_alive = dispatchStreamingResult(state, AsyncHttpFetch::RESULT_PARTIAL_BODY);
+    state->body_ = NULL;
+    state->body_size_ = 0;
+    if (!receiver_alive) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int handleStreamingFetchEvents(TSCont cont, TSEvent event, void *edata) {
+  AsyncHttpFetch *fetch_provider = static_cast<AsyncHttpFetch *>(TSContDataGet(cont));
+  AsyncHttpFetchState *state = utils::internal::getAsyncHttpFetchState(*fetch_provider);
+  LOG_DEBUG("Streaming fetch %p got event %d", fetch_provider, event);
+  if (handleFetchTimeout(state, event)) {
+    finishStreamingFetch(fetch_provider, state); // destroying the fetch cancels it
+    return 0;
+  }
+  bool keep_going = true;
+  switch (event) {
+  case TS_FETCH_EVENT_EXT_HEAD_READY:
+    break;
+  case TS_FETCH_EVENT_EXT_HEAD_DONE:
+    utils::internal::initResponse(state->response_, TSFetchRespHdrMBufGet(state->fetch_sm_),
+                                  TSFetchRespHdrMLocGet(state->fetch_sm_));
+    keep_going = dispatchStreamingResult(state, AsyncHttpFetch::RESULT_HEADER_COMPLETE);
+    break;
+  case TS_EVENT_IMMEDIATE: // resumeBody()
+    state->resume_action_ = NULL;
+    keep_going = readStreamingBody(state);
+    break;
+  case TS_FETCH_EVENT_EXT_BODY_READY:
+    keep_going = readStreamingBody(state);
+    break;
+  case TS_FETCH_EVENT_EXT_BODY_DONE:
+    state->body_done_ = true;
+    keep_going = readStreamingBody(state);
+    break;
+  case TS_EVENT_TIMEOUT:
+    dispatchStreamingResult(state, AsyncHttpFetch::RESULT_TIMEOUT);
+    keep_going = false;
+    break;
+  default:
+    LOG_ERROR("Streaming fetch of [%s] failed with event %d", state->request_.getUrl().getUrlString().c_str(), event);
+    dispatchStreamingResult(state, AsyncHttpFetch::RESULT_FAILURE);
+    keep_going = false;
+    break;
+  }
+  if (keep_going && state->body_done_ && !state->body_paused_) { // all of the body was read
+    dispatchStreamingResult(state, AsyncHttpFetch::RESULT_BODY_COMPLETE);
+    keep_going = false;
+  }
+  if (!keep_going) {
+    finishStreamingFetch(fetch_provider, state);
+  }
+  return 0;
+}
+
 }
 
 AsyncHttpFetch::AsyncHttpFetch(const std::string &url_str, HttpMethod http_method) {
   LOG_DEBUG("Created new AsyncHttpFetch object %p", this);
-  state_ = new AsyncHttpFetchState(url_str, http_method);
+  state_ = new AsyncHttpFetchState(url_str, http_method, Options());
+}
+
+AsyncHttpFetch::AsyncHttpFetch(const std::string &url_str, StreamingFlag streaming_flag, HttpMethod http_method) {
+  LOG_DEBUG("Created new AsyncHttpFetch object %p, streaming %d", this, streaming_flag);
+  Options options;
+  options.streaming_flag_ = streaming_flag;
+  state_ = new AsyncHttpFetchState(url_str, http_method, options);
+}
+
+AsyncHttpFetch::AsyncHttpFetch(const std::string &url_str, const Options &options, HttpMethod http_method) {
+  LOG_DEBUG("Created new AsyncHttpFetch object %p, streaming %d, timeout %d ms", this, options.streaming_flag_,
+            options.timeout_ms_);
+  state_ = new AsyncHttpFetchState(url_str, http_method, options);
 }
 
 void AsyncHttpFetch::run(shared_ptr<AsyncDispatchControllerBase> sender) {
   state_->dispatch_controller_ = sender;
+  if (state_->streaming_flag_ == STREAMING_ENABLED) {
+    runStreaming();
+    return;
+  }
 
   TSCont fetchCont = TSContCreate(handleFetchEvents, TSMutexCreate());
   TSContDataSet(fetchCont, static_cast<void *>(this)); // Providers have to clean themselves up when they are done.
@@ -114,36 +380,35 @@ void AsyncHttpFetch::run(shared_ptr<AsyncDispatchControllerBase> sender) {
   event_ids.failure_event_id = RESULT_FAILURE;
   event_ids.timeout_event_id = RESULT_TIMEOUT;
 
-  struct sockaddr_in addr;
-  addr.sin_family = AF_INET;
-  addr.sin_addr.s_addr = LOCAL_IP_ADDRESS;
-  addr.sin_port = LOCAL_PORT;
-
-  string request_str(HTTP_METHOD_STRINGS[state_->request_.getMethod()]);
-  request_str += ' ';
-  request_str += state_->request_.getUrl().getUrlString();
-  request_str += ' ';
-  request_str += HTTP_VERSION_STRINGS[state_->request_.getVersion()];
-  request_str += "\r\n";
-
-  for (Headers::const_iterator iter = state_->request_.getHeaders().begin(),
-         end = state_->request_.getHeaders().end(); iter != end; ++iter) {
-    request_str += iter->first;
-    request_str += ": ";
-    request_str += Headers::getJoinedValues(iter->second);
-    request_str += "\r\n";
+  if (state_->timeout_ms_ > 0) {
+    state_->timeout_action_ = TSContSchedule(fetchCont, state_->timeout_ms_, TS_THREAD_POOL_DEFAULT);
   }
-  request_str += "\r\n";
 
+  size_t body_size = state_->prepareRequestBody();
+  string request_str;
+  request_str.reserve(state_->request_.getSerializedHeadSize() + body_size);
+  state_->request_.serializeHead(request_str);
   LOG_DEBUG("Issing TSFetchUrl with request\n[%s]", request_str.c_str());
-  TSFetchUrl(request_str.c_str(), request_str.size(), reinterpret_cast<struct sockaddr const *>(&addr), fetchCont,
-             AFTER_BODY, event_ids);
+  AppendToString append(request_str);
+  state_->writeRequestBody(append);
+
+  TSFetchUrl(request_str.c_str(), request_str.size(), reinterpret_cast<struct sockaddr const *>(&state_->client_address_),
+             fetchCont, AFTER_BODY, event_ids);
 }
 
 Headers &AsyncHttpFetch::getRequestHeaders() {
   return state_->request_.getHeaders();
 }
 
+void AsyncHttpFetch::setRequestBody(const void *body, size_t body_size) {
+  state_->request_body_ = body;
+  state_->request_body_size_ = body_size;
+}
+
+void AsyncHttpFetch::setRequestBodyReader(void *reader) {
+  state_->request_body_reader_ = static_cast<TSIOBufferReader>(reader);
+}
+
 AsyncHttpFetch::Result AsyncHttpFetch::getResult() const {
   return state_->result_;
 }
@@ -161,6 +426,62 @@ void AsyncHttpFetch::getResponseBody(const void *&body, size_t &body_size) const
   body_size = state_->body_size_;
 }
 
+void AsyncHttpFetch::setTraceSpan(const shared_ptr<TraceFetchSpan> &span) {
+  state_->trace_span_ = span;
+}
+
+void AsyncHttpFetch::releaseResponseHeaders(void *&hdr_buf, void *&hdr_loc) {
+  hdr_buf = state_->hdr_buf_;
+  hdr_loc = state_->hdr_loc_;
+  state_->hdr_buf_ = NULL;
+  state_->hdr_loc_ = NULL;
+}
+
+void AsyncHttpFetch::runStreaming() {
+  state_->fetch_cont_ = TSContCreate(handleStreamingFetchEvents, TSMutexCreate());
+  TSContDataSet(state_->fetch_cont_, static_cast<void *>(this));
+
+  const string &url = state_->request_.getUrl().getUrlString();
+  LOG_DEBUG("Issuing streaming TSFetchCreate for [%s]", url.c_str());
+  state_->fetch_sm_ = TSFetchCreate(state_->fetch_cont_, getHttpMethodName(state_->request_.getMethod()).data(),
+                                    url.c_str(), getHttpVersionName(state_->request_.getVersion()).data(),
+                                    reinterpret_cast<struct sockaddr const *>(&state_->client_address_),
+                                    TS_FETCH_FLAGS_STREAM | TS_FETCH_FLAGS_DECHUNK);
+  TSFetchUserDataSet(state_->fetch_sm_, static_cast<void *>(this));
+  state_->prepareRequestBody();
+  const Headers &headers = state_->request_.getHeaders();
+  for (Headers::const_iterator iter = headers.begin(), end = headers.end(); iter != end; ++iter) {
+    for (std::list<string>::const_iterator value_iter = iter->second.begin(); value_iter != iter->second.end();
+         ++value_iter) {
+      TSFetchHeaderAdd(state_->fetch_sm_, iter->first.data(), iter->first.length(), value_iter->data(),
+                       value_iter->length());
+    }
+  }
+  if (state_->timeout_ms_ > 0) {
+    state_->timeout_action_ = TSContSchedule(state_->fetch_cont_, state_->timeout_ms_, TS_THREAD_POOL_DEFAULT);
+  }
+  TSFetchLaunch(state_->fetch_sm_);
+  WriteToFetch write(state_->fetch_sm_);
+  state_->writeRequestBody(write);
+}
+
+void AsyncHttpFetch::pauseBody() {
+  state_->body_paused_ = true;
+}
+
+void AsyncHttpFetch::resumeBody() {
+  if (state_->body_paused_) {
+    // the reading happens on the fetch's continuation, which holds its mutex
+    TSMutex mutex = TSContMutexGet(state_->fetch_cont_);
+    TSMutexLock(mutex);
+    state_->body_paused_ = false;
+    if (!state_->resume_action_) {
+      state_->resume_action_ = TSContSchedule(state_->fetch_cont_, 0, TS_THREAD_POOL_DEFAULT);
+    }
+    TSMutexUnlock(mutex);
+  }
+}
+
 AsyncHttpFetch::~AsyncHttpFetch() {
   delete state_;
 }
@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncHttpFetchCoalescer.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/AsyncHttpFetchCoalescer.h"
+#include <ts/ts.h>
+#include <map>
+#include <vector>
+#include "atscppapi/Mutex.h"
+#include "logging_internal.h"
+#include "utils_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::map;
+using std::vector;
+
+namespace {
+
+const size_t CACHE_SWEEP_THRESHOLD = 1024; // expired entries are only dropped on lookup below this many entries
+
+const int64_t NANOSECONDS_PER_MILLISECOND = 1000000;
+
+}
+
+/**
+ * @private
+ * @brief The result of one request, shared by every fetch it served.
+ */
+struct atscppapi::CoalescedFetchResult : noncopyable {
+  AsyncHttpFetch::Result result_;
+  TSMBuffer hdr_buf_;
+  TSMLoc hdr_loc_;
+  string body_; // the fetch's body points into its transaction data, which is gone after its dispatch
+
+  CoalescedFetchResult(AsyncHttpFetch &fetch) : result_(fetch.getResult()), hdr_buf_(NULL), hdr_loc_(NULL) {
+    if (result_ == AsyncHttpFetch::RESULT_SUCCESS) {
+      utils::internal::releaseAsyncHttpFetchResponseHeaders(fetch, hdr_buf_, hdr_loc_);
+      const void *body;
+      size_t body_size;
+      fetch.getResponseBody(body, body_size);
+      body_.assign(static_cast<const char *>(body), body_size);
+    }
+  }
+
+  ~CoalescedFetchResult() {
+    if (hdr_loc_) {
+      TSMLoc null_parent_loc = NULL;
+      TSHandleMLocRelease(hdr_buf_, null_parent_loc, hdr_loc_);
+    }
+    if (hdr_buf_) {
+      TSMBufferDestroy(hdr_buf_);
+    }
+  }
+};
+
+/**
+ * @private
+ */
+struct atscppapi::AsyncHttpFetchCoalescerState : noncopyable {
+  typedef vector<CoalescedHttpFetch *> WaiterList; // the fetch making the request comes first
+  struct CacheEntry {
+    shared_ptr<CoalescedFetchResult> result_;
+    int64_t expiry_time_;
+  };
+  typedef map<string, CacheEntry> Cache;
+
+  int cache_ttl_ms_;
+  AsyncHttpFetch::Options fetch_options_;
+  vector<string> key_headers_;
+  map<string, WaiterList> in_flight_;
+  Cache cache_;
+  Mutex mutex_;
+
+  AsyncHttpFetchCoalescerState(int cache_ttl_ms, const AsyncHttpFetch::Options &fetch_options)
+    : cache_ttl_ms_(cache_ttl_ms), fetch_options_(fetch_options) {
+    fetch_options_.streaming_flag_ = AsyncHttpFetch::STREAMING_DISABLED;
+  }
+
+  /**
+   * @return The cached result for key, NULL if there's none or it expired.
+   */
+  shared_ptr<CoalescedFetchResult> findCached(const string &key, int64_t now) {
+    Cache::iterator iter = cache_.find(key);
+    if (iter == cache_.end()) {
+      return shared_ptr<CoalescedFetchResult>();
+    }
+    if (iter->second.expiry_time_ <= now) {
+      cache_.erase(iter);
+      return shared_ptr<CoalescedFetchResult>();
+    }
+    return iter->second.result_;
+  }
+
+  void addCached(const string &key, shared_ptr<CoalescedFetchResult> result) {
+    int64_t now = TShrtime();
+    if (cache_.size() >= CACHE_SWEEP_THRESHOLD) {
+      for (Cache::iterator iter = cache_.begin(); iter != cache_.end();) {
+        if (iter->second.expiry_time_ <= now) {
+          cache_.erase(iter++);
+        } else {
+          ++iter;
+        }
+      }
+    }
+    CacheEntry &entry = cache_[key];
+    entry.result_ = result;
+    entry.expiry_time_ = now + cache_ttl_ms_ * NANOSECONDS_PER_MILLISECOND;
+  }
+
+  /**
+   * Hands the result of the request for key to everyone waiting for it.
+   */
+  void completeFlight(const string &key, shared_ptr<CoalescedFetchResult> result) {
+    WaiterList waiters;
+    mutex_.lock();
+    map<string, WaiterList>::iterator iter = in_flight_.find(key);
+    waiters.swap(iter->second);
+    in_flight_.erase(iter);
+    if ((result->result_ == AsyncHttpFetch::RESULT_SUCCESS) && (cache_ttl_ms_ > 0)) {
+      addCached(key, result);
+    }
+    mutex_.unlock();
+    LOG_DEBUG("Request for key [%s] completed with result %d for %zu fetches", key.c_str(), result->result_,
+              waiters.size());
+    for (size_t i = 0; i < waiters.size(); ++i) {
+      waiters[i]->complete(result, (i != 0));
+    }
+  }
+};
+
+/**
+ * @private
+ */
+struct atscppapi::CoalescedHttpFetchState : noncopyable {
+  CoalescedHttpFetch *fetch_;
+  AsyncHttpFetchCoalescerState &coalescer_;
+  Request request_;
+  Response response_;
+  shared_ptr<CoalescedFetchResult> result_;
+  bool shared_;
+  shared_ptr<AsyncDispatchControllerBase> dispatch_controller_;
+
+  CoalescedHttpFetchState(CoalescedHttpFetch *fetch, AsyncHttpFetchCoalescerState &coalescer, const string &url_str,
+                          HttpMethod http_method)
+    : fetch_(fetch), coalescer_(coalescer), request_(url_str, http_method, coalescer.fetch_options_.http_version_),
+      shared_(false) { }
+
+  string createKey() {
+    string key = getHttpMethodName(request_.getMethod()).str();
+    key += ' ';
+    key += request_.getUrl().getUrlString();
+    for (vector<string>::const_iterator iter = coalescer_.key_headers_.begin(), end = coalescer_.key_headers_.end();
+         iter != end; ++iter) {
+      key += '\n';
+      key += *iter;
+      key += ": ";
+      key += request_.getHeaders().getJoinedValues(*iter);
+    }
+    return key;
+  }
+
+  /** Completes a fetch served from the cache, after Async::execute() returned like for every other fetch. */
+  static int handleCacheHit(TSCont cont, TSEvent, void *) {
+    CoalescedHttpFetchState *state = static_cast<CoalescedHttpFetchState *>(TSContDataGet(cont));
+    TSContDestroy(cont);
+    state->fetch_->complete(state->result_, true);
+    return 0;
+  }
+};
+
+namespace {
+
+/**
+ * Takes the dispatch of the fetch that makes the request on behalf of everyone waiting for key.
+ */
+class CoalescedFetchController : public AsyncDispatchControllerBase {
+public:
+  CoalescedFetchController(AsyncHttpFetchCoalescerState &coalescer, const string &key, AsyncHttpFetch *fetch)
+    : coalescer_(coalescer), key_(key), fetch_(fetch) { }
+
+  bool dispatch() {
+    coalescer_.completeFlight(key_, shared_ptr<CoalescedFetchResult>(new CoalescedFetchResult(*fetch_)));
+    return true; // the fetch deletes itself right after
+  }
+
+private:
+  AsyncHttpFetchCoalescerState &coalescer_;
+  string key_;
+  AsyncHttpFetch *fetch_;
+};
+
+}
+
+AsyncHttpFetchCoalescer::AsyncHttpFetchCoalescer(int cache_ttl_ms, const AsyncHttpFetch::Options &fetch_options) {
+  state_ = new AsyncHttpFetchCoalescerState(cache_ttl_ms, fetch_options);
+}
+
+void AsyncHttpFetchCoalescer::addKeyHeader(const string &name) {
+  state_->key_headers_.push_back(name);
+}
+
+void AsyncHttpFetchCoalescer::clearCache() {
+  ScopedMutexLock lock(state_->mutex_);
+  state_->cache_.clear();
+}
+
+AsyncHttpFetchCoalescer::~AsyncHttpFetchCoalescer() {
+  delete state_;
+}
+
+CoalescedHttpFetch::CoalescedHttpFetch(AsyncHttpFetchCoalescer &coalescer, const string &url_str,
+                                       HttpMethod http_method) {
+  state_ = new CoalescedHttpFetchState(this, *coalescer.state_, url_str, http_method);
+}
+
+Headers &CoalescedHttpFetch::getRequestHeaders() {
+  return state_->request_.getHeaders();
+}
+
+AsyncHttpFetch::Result CoalescedHttpFetch::getResult() const {
+  return state_->result_.get() ? state_->result_->result_ : AsyncHttpFetch::RESULT_FAILURE;
+}
+
+const Url &CoalescedHttpFetch::getRequestUrl() const {
+  return state_->request_.getUrl();
+}
+
+const Response &CoalescedHttpFetch::getResponse() const {
+  return state_->response_;
+}
+
+void CoalescedHttpFetch::getResponseBody(const void *&body, size_t &body_size) const {
+  if (getResult() == AsyncHttpFetch::RESULT_SUCCESS) {
+    body = state_->result_->body_.data();
+    body_size = state_->result_->body_.size();
+  } else {
+    body = NULL;
+    body_size = 0;
+  }
+}
+
+bool CoalescedHttpFetch::isShared() const {
+  return state_->shared_;
+}
+
+void CoalescedHttpFetch::run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller) {
+  state_->dispatch_controller_ = dispatch_controller;
+  AsyncHttpFetchCoalescerState &coalescer = state_->coalescer_;
+  string key = state_->createKey();
+  bool make_request = false;
+  coalescer.mutex_.lock();
+  if (coalescer.cache_ttl_ms_ > 0) {
+    state_->result_ = coalescer.findCached(key, TShrtime());
+  }
+  if (!state_->result_.get()) {
+    AsyncHttpFetchCoalescerState::WaiterList &waiters = coalescer.in_flight_[key];
+    make_request = waiters.empty();
+    waiters.push_back(this);
+  }
+  coalescer.mutex_.unlock();
+
+  if (state_->result_.get()) {
+    LOG_DEBUG("Serving fetch %p for key [%s] from the cache", this, key.c_str());
+    TSMutex null_mutex = NULL;
+    TSCont cont = TSContCreate(CoalescedHttpFetchState::handleCacheHit, null_mutex);
+    TSContDataSet(cont, static_cast<void *>(state_));
+    TSContSchedule(cont, 0, TS_THREAD_POOL_DEFAULT);
+  } else if (make_request) {
+    LOG_DEBUG("Fetch %p makes the request for key [%s]", this, key.c_str());
+    AsyncHttpFetch *fetch = new AsyncHttpFetch(state_->request_.getUrl().getUrlString(), coalescer.fetch_options_,
+                                               state_->request_.getMethod());
+    fetch->getRequestHeaders().copyFrom(state_->request_.getHeaders());
+    fetch->run(shared_ptr<AsyncDispatchControllerBase>(new CoalescedFetchController(coalescer, key, fetch)));
+  } else {
+    LOG_DEBUG("Fetch %p joins the request in flight for key [%s]", this, key.c_str());
+  }
+}
+
+void CoalescedHttpFetch::complete(shared_ptr<CoalescedFetchResult> result, bool shared) {
+  state_->result_ = result;
+  state_->shared_ = shared;
+  if (result->result_ == AsyncHttpFetch::RESULT_SUCCESS) {
+    utils::internal::initResponse(state_->response_, result->hdr_buf_, result->hdr_loc_);
+  }
+  if (!state_->dispatch_controller_->dispatch()) {
+    LOG_DEBUG("Unable to dispatch result from CoalescedHttpFetch because promise has died.");
+  }
+  delete this; // we must always be sure to clean up the provider when we're done with it.
+}
+
+CoalescedHttpFetch::~CoalescedHttpFetch() {
+  delete state_;
+}
@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncHttpFetchGroup.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/AsyncHttpFetchGroup.h"
+#include <ts/ts.h>
+#include <vector>
+#include "logging_internal.h"
+#include "utils_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * What the group keeps of a member, the member itself self-destructs once it has dispatched.
+ */
+struct GroupMember : noncopyable {
+  AsyncHttpFetch *fetch_; // NULL once run
+  string url_;
+  AsyncHttpFetch::Result result_;
+  bool done_;
+  Response response_;
+  TSMBuffer hdr_buf_;
+  TSMLoc hdr_loc_;
+  string body_; // the member's body points into the fetch's data, which is gone after its dispatch
+  GroupMember(AsyncHttpFetch *fetch) : fetch_(fetch), result_(AsyncHttpFetch::RESULT_FAILURE), done_(false),
+                                       hdr_buf_(NULL), hdr_loc_(NULL) { }
+  ~GroupMember() {
+    delete fetch_;
+    if (hdr_loc_) {
+      TSMLoc null_parent_loc = NULL;
+      TSHandleMLocRelease(hdr_buf_, null_parent_loc, hdr_loc_);
+    }
+    if (hdr_buf_) {
+      TSMBufferDestroy(hdr_buf_);
+    }
+  }
+};
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::AsyncHttpFetchGroupState : noncopyable {
+  AsyncHttpFetchGroup *group_;
+  AsyncHttpFetchGroup::CompletionMode mode_;
+  size_t quorum_;
+  int deadline_ms_;
+  vector<GroupMember *> members_;
+  size_t done_count_;
+  size_t success_count_;
+  AsyncHttpFetch::Result result_;
+  bool dispatched_;
+  TSCont cont_; // its mutex protects all of the above once running
+  TSAction deadline_action_;
+  shared_ptr<AsyncDispatchControllerBase> dispatch_controller_;
+
+  AsyncHttpFetchGroupState(AsyncHttpFetchGroup *group, AsyncHttpFetchGroup::CompletionMode mode, size_t quorum,
+                           int deadline_ms)
+    : group_(group), mode_(mode), quorum_(quorum), deadline_ms_(deadline_ms), done_count_(0), success_count_(0),
+      result_(AsyncHttpFetch::RESULT_FAILURE), dispatched_(false), cont_(NULL), deadline_action_(NULL) { }
+
+  void handleMemberComplete(size_t index, AsyncHttpFetch &fetch);
+  void handleDeadline();
+  void checkCompletion();
+  void dispatch(AsyncHttpFetch::Result result);
+  /** @return true once the group has dispatched and no member is outstanding, nothing refers to it anymore then. */
+  bool isFinished() const { return dispatched_ && (done_count_ == members_.size()); }
+
+  ~AsyncHttpFetchGroupState() {
+    for (vector<GroupMember *>::iterator iter = members_.begin(), end = members_.end(); iter != end; ++iter) {
+      delete *iter;
+    }
+    if (cont_) {
+      TSContDestroy(cont_);
+    }
+  }
+};
+
+namespace atscppapi {
+
+/**
+ * @private
+ * @brief Takes the single dispatch of a member, instead of the dispatch controller Async::execute() would create.
+ */
+class AsyncHttpFetchGroupMemberController : public AsyncDispatchControllerBase {
+public:
+  AsyncHttpFetchGroupMemberController(AsyncHttpFetchGroupState *state, size_t index, AsyncHttpFetch *fetch)
+    : state_(state), index_(index), fetch_(fetch) { }
+
+  bool dispatch() {
+    state_->handleMemberComplete(index_, *fetch_); // the fetch deletes itself right after
+    return true;
+  }
+
+private:
+  AsyncHttpFetchGroupState *state_;
+  size_t index_;
+  AsyncHttpFetch *fetch_;
+};
+
+}
+
+void AsyncHttpFetchGroupState::handleMemberComplete(size_t index, AsyncHttpFetch &fetch) {
+  TSMutex mutex = TSContMutexGet(cont_);
+  TSMutexLock(mutex);
+  GroupMember &member = *members_[index];
+  member.done_ = true;
+  ++done_count_;
+  if (dispatched_) {
+    LOG_DEBUG("Dropping result %d of member %zu, group %p has completed", fetch.getResult(), index, group_);
+  } else {
+    member.result_ = fetch.getResult();
+    if (member.result_ == AsyncHttpFetch::RESULT_SUCCESS) {
+      ++success_count_;
+      utils::internal::releaseAsyncHttpFetchResponseHeaders(fetch, member.hdr_buf_, member.hdr_loc_);
+      utils::internal::initResponse(member.response_, member.hdr_buf_, member.hdr_loc_);
+      const void *body;
+      size_t body_size;
+      fetch.getResponseBody(body, body_size);
+      member.body_.assign(static_cast<const char *>(body), body_size);
+    }
+    LOG_DEBUG("Member %zu of group %p completed with result %d", index, group_, member.result_);
+    checkCompletion();
+  }
+  bool finished = isFinished();
+  TSMutexUnlock(mutex);
+  if (finished) {
+    delete group_;
+  }
+}
+
+void AsyncHttpFetchGroupState::handleDeadline() {
+  deadline_action_ = NULL;
+  if (!dispatched_) {
+    LOG_DEBUG("Group %p hit its deadline of %d ms with %zu of %zu members done", group_, deadline_ms_, done_count_,
+              members_.size());
+    for (vector<GroupMember *>::iterator iter = members_.begin(), end = members_.end(); iter != end; ++iter) {
+      if (!(*iter)->done_) {
+        (*iter)->result_ = AsyncHttpFetch::RESULT_TIMEOUT;
+      }
+    }
+    if ((mode_ == AsyncHttpFetchGroup::COMPLETION_DEADLINE) && success_count_) {
+      dispatch(AsyncHttpFetch::RESULT_SUCCESS);
+    } else {
+      dispatch(AsyncHttpFetch::RESULT_TIMEOUT);
+    }
+  }
+}
+
+void AsyncHttpFetchGroupState::checkCompletion() {
+  bool all_done = (done_count_ == members_.size());
+  switch (mode_) {
+  case AsyncHttpFetchGroup::COMPLETION_ALL:
+    if (all_done) {
+      dispatch((success_count_ == members_.size()) ? AsyncHttpFetch::RESULT_SUCCESS : AsyncHttpFetch::RESULT_FAILURE);
+    }
+    break;
+  case AsyncHttpFetchGroup::COMPLETION_ANY:
+    if (success_count_) {
+      dispatch(AsyncHttpFetch::RESULT_SUCCESS);
+    } else if (all_done) {
+      dispatch(AsyncHttpFetch::RESULT_FAILURE);
+    }
+    break;
+  case AsyncHttpFetchGroup::COMPLETION_QUORUM:
+    if (success_count_ >= quorum_) {
+      dispatch(AsyncHttpFetch::RESULT_SUCCESS);
+    } else if (success_count_ + (members_.size() - done_count_) < quorum_) { // can't be reached anymore
+      dispatch(AsyncHttpFetch::RESULT_FAILURE);
+    }
+    break;
+  case AsyncHttpFetchGroup::COMPLETION_DEADLINE:
+    if (all_done) {
+      dispatch(success_count_ ? AsyncHttpFetch::RESULT_SUCCESS : AsyncHttpFetch::RESULT_FAILURE);
+    }
+    break;
+  }
+}
+
+void AsyncHttpFetchGroupState::dispatch(AsyncHttpFetch::Result result) {
+  dispatched_ = true;
+  result_ = result;
+  if (deadline_action_) {
+    TSActionCancel(deadline_action_); // we hold the continuation's mutex
+    deadline_action_ = NULL;
+  }
+  LOG_DEBUG("Group %p completed with result %d, %zu of %zu members succeeded", group_, result, success_count_,
+            members_.size());
+  if (!dispatch_controller_->dispatch()) {
+    LOG_DEBUG("Unable to dispatch result from AsyncHttpFetchGroup because promise has died.");
+  }
+}
+
+namespace {
+
+int handleGroupDeadline(TSCont cont, TSEvent event, void *edata) {
+  AsyncHttpFetchGroupState *state = static_cast<AsyncHttpFetchGroupState *>(TSContDataGet(cont));
+  state->handleDeadline();
+  if (state->isFinished()) {
+    delete state->group_;
+  }
+  return 0;
+}
+
+}
+
+AsyncHttpFetchGroup::AsyncHttpFetchGroup(CompletionMode mode, size_t quorum, int deadline_ms) {
+  LOG_DEBUG("Created new AsyncHttpFetchGroup object %p, mode %d, quorum %zu, deadline %d ms", this, mode, quorum,
+            deadline_ms);
+  state_ = new AsyncHttpFetchGroupState(this, mode, quorum, deadline_ms);
+}
+
+size_t AsyncHttpFetchGroup::addFetch(AsyncHttpFetch *fetch) {
+  state_->members_.push_back(new GroupMember(fetch));
+  state_->members_.back()->url_ = fetch->getRequestUrl().getUrlString();
+  return state_->members_.size() - 1;
+}
+
+size_t AsyncHttpFetchGroup::getMemberCount() const {
+  return state_->members_.size();
+}
+
+AsyncHttpFetch::Result AsyncHttpFetchGroup::getResult() const {
+  return state_->result_;
+}
+
+size_t AsyncHttpFetchGroup::getSuccessCount() const {
+  return state_->success_count_;
+}
+
+AsyncHttpFetch::Result AsyncHttpFetchGroup::getMemberResult(size_t member) const {
+  return state_->members_[member]->result_;
+}
+
+const string &AsyncHttpFetchGroup::getMemberRequestUrl(size_t member) const {
+  return state_->members_[member]->url_;
+}
+
+const Response &AsyncHttpFetchGroup::getMemberResponse(size_t member) const {
+  return state_->members_[member]->response_;
+}
+
+void AsyncHttpFetchGroup::getMemberResponseBody(size_t member, const void *&body, size_t &body_size) const {
+  const GroupMember &group_member = *state_->members_[member];
+  if (group_member.result_ == AsyncHttpFetch::RESULT_SUCCESS) {
+    body = group_member.body_.data();
+    body_size = group_member.body_.size();
+  } else {
+    body = NULL;
+    body_size = 0;
+  }
+}
+
+void AsyncHttpFetchGroup::run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller) {
+  state_->dispatch_controller_ = dispatch_controller;
+  state_->cont_ = TSContCreate(handleGroupDeadline, TSMutexCreate());
+  TSContDataSet(state_->cont_, static_cast<void *>(state_));
+  TSMutex mutex = TSContMutexGet(state_->cont_);
+  TSMutexLock(mutex); // members may complete on other threads while the rest are started
+  if (state_->members_.empty()) {
+    state_->dispatch(AsyncHttpFetch::RESULT_SUCCESS);
+    TSMutexUnlock(mutex);
+    delete this;
+    return;
+  }
+  if (state_->deadline_ms_ > 0) {
+    state_->deadline_action_ = TSContSchedule(state_->cont_, state_->deadline_ms_, TS_THREAD_POOL_DEFAULT);
+  }
+  for (size_t i = 0; i < state_->members_.size(); ++i) {
+    AsyncHttpFetch *fetch = state_->members_[i]->fetch_;
+    state_->members_[i]->fetch_ = NULL; // it's on its own from now on
+    fetch->run(shared_ptr<AsyncDispatchControllerBase>(new AsyncHttpFetchGroupMemberController(state_, i, fetch)));
+  }
+  TSMutexUnlock(mutex);
+}
+
+AsyncHttpFetchGroup::~AsyncHttpFetchGroup() {
+  delete state_;
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncTask.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/AsyncTask.h"
+#include <ts/ts.h>
+#include "logging_internal.h"
+#include "utils_internal.h"
+
+using namespace atscppapi;
+
+/**
+ * @private
+ */
+struct atscppapi::AsyncTaskState : noncopyable {
+  AsyncThreadPool thread_pool_;
+  TSCont cont_;
+  shared_ptr<AsyncDispatchControllerBase> dispatch_controller_;
+  AsyncTaskState(AsyncThreadPool thread_pool) : thread_pool_(thread_pool), cont_(NULL) { }
+  ~AsyncTaskState() {
+    if (cont_) {
+      TSContDestroy(cont_);
+    }
+  }
+};
+
+namespace {
+
+int handleTaskEvent(TSCont cont, TSEvent event, void *edata) {
+  AsyncTask *task = static_cast<AsyncTask *>(TSContDataGet(cont));
+  AsyncTaskState *state = utils::internal::getAsyncTaskState(*task);
+  if (state->dispatch_controller_->isReceiverAlive()) {
+    task->execute();
+    if (!state->dispatch_controller_->dispatch()) {
+      LOG_DEBUG("Unable to dispatch result from AsyncTask because promise has died.");
+    }
+  } else {
+    LOG_DEBUG("Skipping AsyncTask %p, its receiver is gone", task);
+  }
+  delete task; // we must always be sure to clean up the provider when we're done with it.
+  return 0;
+}
+
+}
+
+AsyncTask::AsyncTask(AsyncThreadPool thread_pool) {
+  state_ = new AsyncTaskState(thread_pool);
+}
+
+void AsyncTask::run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller) {
+  state_->dispatch_controller_ = dispatch_controller;
+  TSMutex null_mutex = NULL;
+  state_->cont_ = TSContCreate(handleTaskEvent, null_mutex);
+  TSContDataSet(state_->cont_, static_cast<void *>(this));
+  LOG_DEBUG("Queueing AsyncTask %p on thread pool %d", this, state_->thread_pool_);
+#ifdef ATSCPPAPI_HAVE_SCHEDULE_ON_THREAD
+  TSEventThread thread = TSEventThreadSelf();
+  if ((state_->thread_pool_ == ASYNC_THREAD_POOL_CURRENT_THREAD) && thread) {
+    TSContScheduleOnThread(state_->cont_, 0, thread);
+    return;
+  }
+#endif
+  TSContSchedule(state_->cont_, 0, (state_->thread_pool_ == ASYNC_THREAD_POOL_TASK) ? TS_THREAD_POOL_TASK :
+                 TS_THREAD_POOL_DEFAULT);
+}
+
+AsyncTask::~AsyncTask() {
+  delete state_;
+}
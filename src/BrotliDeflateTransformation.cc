@@ -0,0 +1,150 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliDeflateTransformation.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include <string>
+#include <vector>
+#include <brotli/encode.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/BrotliDeflateTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const int DEFAULT_QUALITY = 5;
+const int ONE_KB = 1024;
+const size_t INPUT_LOW_WATERMARK = 8 * ONE_KB;
+const size_t INPUT_HIGH_WATERMARK = 64 * ONE_KB;
+const size_t DEFAULT_OUTPUT_BUFFER_SIZE = 16 * ONE_KB;
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::BrotliDeflateTransformationState: noncopyable {
+  BrotliEncoderState *encoder_;
+  TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  BrotliDeflateTransformation::Options options_;
+  vector<uint8_t> buffer_; // reused for every call to BrotliEncoderCompressStream().
+
+  BrotliDeflateTransformationState(TransformationPlugin::Type type, const BrotliDeflateTransformation::Options &options) :
+        encoder_(NULL), transformation_type_(type), bytes_produced_(0), options_(options),
+        buffer_(options.output_buffer_size_ ? options.output_buffer_size_ : DEFAULT_OUTPUT_BUFFER_SIZE) {
+    encoder_ = BrotliEncoderCreateInstance(NULL, NULL, NULL);
+    if (!encoder_) {
+      LOG_ERROR("BrotliEncoderCreateInstance failed.");
+    } else if (!BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_QUALITY, options_.quality_) ||
+               !BrotliEncoderSetParameter(encoder_, BROTLI_PARAM_LGWIN, options_.window_bits_)) {
+      LOG_ERROR("Unable to set brotli quality=%d window_bits=%d.", options_.quality_, options_.window_bits_);
+    }
+  };
+
+  ~BrotliDeflateTransformationState() {
+    if (encoder_) {
+      BrotliEncoderDestroyInstance(encoder_);
+    }
+  };
+};
+
+BrotliDeflateTransformation::Options::Options()
+  : quality_(DEFAULT_QUALITY), window_bits_(BROTLI_DEFAULT_WINDOW), flush_every_chunk_(true),
+    output_buffer_size_(DEFAULT_OUTPUT_BUFFER_SIZE) {
+}
+
+BrotliDeflateTransformation::BrotliDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliDeflateTransformationState(type, Options());
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+BrotliDeflateTransformation::BrotliDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                         const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliDeflateTransformationState(type, options);
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+BrotliDeflateTransformation::BrotliDeflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new BrotliDeflateTransformationState(getType(), Options());
+}
+
+BrotliDeflateTransformation::BrotliDeflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                         const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new BrotliDeflateTransformationState(getType(), options);
+}
+
+BrotliDeflateTransformation::~BrotliDeflateTransformation() {
+  delete state_;
+}
+
+void BrotliDeflateTransformation::consume(const string &data) {
+  compressData(data.data(), data.length(), state_->options_.flush_every_chunk_ ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS);
+}
+
+void BrotliDeflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    compressData(data, length, BROTLI_OPERATION_PROCESS);
+  }
+  if (state_->options_.flush_every_chunk_) {
+    compressData(NULL, 0, BROTLI_OPERATION_FLUSH);
+  }
+}
+
+void BrotliDeflateTransformation::compressData(const char *data, size_t length, int operation) {
+  if (!state_->encoder_) {
+    LOG_ERROR("Unable to brotli compress output because the encoder was not created.");
+    return;
+  }
+
+  int iteration = 0;
+  size_t avail_in = length;
+  const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data);
+  BrotliEncoderOperation op = static_cast<BrotliEncoderOperation>(operation);
+
+  // Keep going until the encoder has taken all of our input and has no output left to give us.
+  do {
+    size_t avail_out = state_->buffer_.size();
+    uint8_t *next_out = &state_->buffer_[0];
+
+    if (!BrotliEncoderCompressStream(state_->encoder_, op, &avail_in, &next_in, &avail_out, &next_out, NULL)) {
+      LOG_ERROR("Iteration %d: Brotli failed to compress %d bytes with operation %d", iteration, length, operation);
+      return;
+    }
+
+    size_t bytes_to_write = state_->buffer_.size() - avail_out;
+    LOG_DEBUG("Iteration %d: Brotli operation %d has %d bytes of output", ++iteration, operation, bytes_to_write);
+    if (bytes_to_write) {
+      state_->bytes_produced_ += bytes_to_write;
+      produce(reinterpret_cast<char *>(&state_->buffer_[0]), bytes_to_write);
+    }
+  } while (avail_in || BrotliEncoderHasMoreOutput(state_->encoder_) ||
+           (op == BROTLI_OPERATION_FINISH && !BrotliEncoderIsFinished(state_->encoder_)));
+}
+
+void BrotliDeflateTransformation::handleInputComplete() {
+  LOG_DEBUG("Brotli compression finalizing.");
+  compressData(NULL, 0, BROTLI_OPERATION_FINISH);
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Brotli bytes produced sanity check failed, compressed bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
+  }
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliInflateTransformation.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include <string>
+#include <vector>
+#include <brotli/decode.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/BrotliInflateTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const int ONE_KB = 1024;
+const size_t DEFAULT_OUTPUT_WINDOW_SIZE = 16 * ONE_KB;
+const int64_t MIN_BYTES_FOR_RATIO_CHECK = 64 * ONE_KB; // the first few bytes of a stream can legitimately inflate a lot.
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::BrotliInflateTransformationState: noncopyable {
+  BrotliDecoderState *decoder_;
+  TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  int64_t bytes_consumed_;
+  BrotliInflateTransformation::Options options_;
+  vector<uint8_t> window_; // decompressed output is drained through this buffer.
+  bool limit_exceeded_;
+  bool output_complete_;
+
+  BrotliInflateTransformationState(TransformationPlugin::Type type, const BrotliInflateTransformation::Options &options) :
+        decoder_(NULL), transformation_type_(type), bytes_produced_(0), bytes_consumed_(0), options_(options),
+        window_(options.output_window_size_ ? options.output_window_size_ : DEFAULT_OUTPUT_WINDOW_SIZE),
+        limit_exceeded_(false), output_complete_(false) {
+    decoder_ = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+    if (!decoder_) {
+      LOG_ERROR("BrotliDecoderCreateInstance failed.");
+    }
+  };
+
+  ~BrotliInflateTransformationState() {
+    if (decoder_) {
+      BrotliDecoderDestroyInstance(decoder_);
+    }
+  };
+};
+
+BrotliInflateTransformation::Options::Options()
+  : output_window_size_(DEFAULT_OUTPUT_WINDOW_SIZE), max_output_bytes_(0), max_ratio_(0) {
+}
+
+BrotliInflateTransformation::BrotliInflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliInflateTransformationState(type, Options());
+}
+
+BrotliInflateTransformation::BrotliInflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                         const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new BrotliInflateTransformationState(type, options);
+}
+
+BrotliInflateTransformation::BrotliInflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new BrotliInflateTransformationState(getType(), Options());
+}
+
+BrotliInflateTransformation::BrotliInflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                         const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new BrotliInflateTransformationState(getType(), options);
+}
+
+BrotliInflateTransformation::~BrotliInflateTransformation() {
+  delete state_;
+}
+
+bool BrotliInflateTransformation::isLimitExceeded() const {
+  return state_->limit_exceeded_;
+}
+
+void BrotliInflateTransformation::consume(const string &data) {
+  decompressData(data.data(), data.length());
+}
+
+void BrotliInflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    decompressData(data, length);
+  }
+}
+
+bool BrotliInflateTransformation::checkLimits() {
+  const BrotliInflateTransformation::Options &options = state_->options_;
+  if (options.max_output_bytes_ && (state_->bytes_produced_ > options.max_output_bytes_)) {
+    LOG_ERROR("Brotli inflate aborting, inflated bytes = %d exceeds the limit of %d bytes", state_->bytes_produced_,
+        options.max_output_bytes_);
+    state_->limit_exceeded_ = true;
+  } else if (options.max_ratio_ && (state_->bytes_produced_ >= MIN_BYTES_FOR_RATIO_CHECK) &&
+             (state_->bytes_produced_ > static_cast<int64_t>(options.max_ratio_) * state_->bytes_consumed_)) {
+    LOG_ERROR("Brotli inflate aborting, inflated bytes = %d from %d compressed bytes exceeds the ratio limit of %d",
+        state_->bytes_produced_, state_->bytes_consumed_, options.max_ratio_);
+    state_->limit_exceeded_ = true;
+  }
+
+  if (state_->limit_exceeded_ && !state_->output_complete_) {
+    // a cut off body must not look complete to the client or the cache, so the transformation fails
+    state_->output_complete_ = true;
+    abort();
+  }
+  return !state_->limit_exceeded_;
+}
+
+void BrotliInflateTransformation::decompressData(const char *data, size_t length) {
+  if (length == 0 || state_->limit_exceeded_) {
+    return;
+  }
+
+  if (!state_->decoder_) {
+    LOG_ERROR("Unable to brotli decompress output because the decoder was not created.");
+    return;
+  }
+
+  int iteration = 0;
+  size_t avail_in = length;
+  const uint8_t *next_in = reinterpret_cast<const uint8_t *>(data);
+  const BrotliInflateTransformation::Options &options = state_->options_;
+  BrotliDecoderResult result;
+
+  do {
+    LOG_DEBUG("Iteration %d: Brotli has %d bytes to inflate", ++iteration, avail_in);
+
+    // Never decompress more than the output limit allows.
+    size_t window_size = state_->window_.size();
+    if (options.max_output_bytes_ && (options.max_output_bytes_ - state_->bytes_produced_ < static_cast<int64_t>(window_size))) {
+      window_size = static_cast<size_t>(options.max_output_bytes_ - state_->bytes_produced_ + 1);
+    }
+    size_t avail_out = window_size;
+    uint8_t *next_out = &state_->window_[0];
+    size_t start_avail_in = avail_in;
+
+    result = BrotliDecoderDecompressStream(state_->decoder_, &avail_in, &next_in, &avail_out, &next_out, NULL);
+    if (result == BROTLI_DECODER_RESULT_ERROR) {
+      LOG_ERROR("Iteration %d: Brotli inflate failed with error '%s'", iteration,
+          BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_->decoder_)));
+      return;
+    }
+    state_->bytes_consumed_ += (start_avail_in - avail_in);
+
+    size_t bytes_inflated = window_size - avail_out;
+    state_->bytes_produced_ += bytes_inflated;
+    if (!checkLimits()) {
+      return;
+    }
+
+    LOG_DEBUG("Iteration %d: Brotli inflated a total of %d bytes, producingOutput...", iteration, bytes_inflated);
+    if (bytes_inflated) {
+      produce(reinterpret_cast<char *>(&state_->window_[0]), bytes_inflated);
+    }
+  } while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT);
+
+  if (result == BROTLI_DECODER_RESULT_SUCCESS && avail_in) {
+    LOG_ERROR("Brotli inflate finished with %d bytes of trailing input", avail_in);
+  }
+}
+
+void BrotliInflateTransformation::handleInputComplete() {
+  if (state_->output_complete_) {
+    return;
+  }
+  state_->output_complete_ = true;
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Brotli bytes produced sanity check failed, inflated bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
+  }
+}
@@ -0,0 +1,351 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CacheKeyBuilder.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/CacheKeyBuilder.h"
+#include <algorithm>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <ts/ts.h>
+#include "atscppapi/Url.h"
+#include "atscppapi/Headers.h"
+#include "atscppapi/Transaction.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+// xxHash64, fed a stripe of 32 bytes at a time
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+inline uint64_t rotl64(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+inline uint64_t read64(const unsigned char *p) {
+  return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) | (static_cast<uint64_t>(p[2]) << 16) |
+    (static_cast<uint64_t>(p[3]) << 24) | (static_cast<uint64_t>(p[4]) << 32) | (static_cast<uint64_t>(p[5]) << 40) |
+    (static_cast<uint64_t>(p[6]) << 48) | (static_cast<uint64_t>(p[7]) << 56);
+}
+
+inline uint64_t read32(const unsigned char *p) {
+  return static_cast<uint64_t>(p[0]) | (static_cast<uint64_t>(p[1]) << 8) | (static_cast<uint64_t>(p[2]) << 16) |
+    (static_cast<uint64_t>(p[3]) << 24);
+}
+
+inline uint64_t hashRound(uint64_t acc, uint64_t input) {
+  acc += input * PRIME64_2;
+  acc = rotl64(acc, 31);
+  return acc * PRIME64_1;
+}
+
+inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+  acc ^= hashRound(0, value);
+  return acc * PRIME64_1 + PRIME64_4;
+}
+
+inline void consumeStripe(uint64_t acc[4], const unsigned char *stripe) {
+  acc[0] = hashRound(acc[0], read64(stripe));
+  acc[1] = hashRound(acc[1], read64(stripe + 8));
+  acc[2] = hashRound(acc[2], read64(stripe + 16));
+  acc[3] = hashRound(acc[3], read64(stripe + 24));
+}
+
+/** Orders query parameters by their bytes, which orders them by name first. */
+bool paramLess(const StringView &a, const StringView &b) {
+  size_t common = std::min(a.length(), b.length());
+  int result = common ? memcmp(a.data(), b.data(), common) : 0;
+  return (result < 0) || (result == 0 && a.length() < b.length());
+}
+
+void insertionSort(StringView *params, size_t count) {
+  for (size_t i = 1; i < count; ++i) {
+    StringView param = params[i];
+    size_t j = i;
+    for (; j > 0 && paramLess(param, params[j - 1]); --j) {
+      params[j] = params[j - 1];
+    }
+    params[j] = param;
+  }
+}
+
+}
+
+CacheKeyBuilder::CacheKeyBuilder(int outputs, uint64_t seed) : outputs_(outputs), seed_(seed) {
+  clear();
+}
+
+void CacheKeyBuilder::clear() {
+  acc_[0] = seed_ + PRIME64_1 + PRIME64_2;
+  acc_[1] = seed_ + PRIME64_2;
+  acc_[2] = seed_;
+  acc_[3] = seed_ - PRIME64_1;
+  total_length_ = 0;
+  stripe_length_ = 0;
+  empty_ = true;
+  inline_key_length_ = 0;
+  long_key_.clear();
+  using_long_key_ = false;
+}
+
+void CacheKeyBuilder::updateHash(const char *data, size_t length) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  total_length_ += length;
+  if (stripe_length_ + length < sizeof(stripe_)) {
+    memcpy(stripe_ + stripe_length_, p, length);
+    stripe_length_ += length;
+    return;
+  }
+  if (stripe_length_) {
+    size_t fill = sizeof(stripe_) - stripe_length_;
+    memcpy(stripe_ + stripe_length_, p, fill);
+    consumeStripe(acc_, stripe_);
+    p += fill;
+    length -= fill;
+    stripe_length_ = 0;
+  }
+  for (; length >= sizeof(stripe_); p += sizeof(stripe_), length -= sizeof(stripe_)) {
+    consumeStripe(acc_, p);
+  }
+  memcpy(stripe_, p, length);
+  stripe_length_ = length;
+}
+
+void CacheKeyBuilder::append(const char *data, size_t length) {
+  if (!length) {
+    return;
+  }
+  if (outputs_ & OUTPUT_HASH) {
+    updateHash(data, length);
+  }
+  if (outputs_ & OUTPUT_KEY) {
+    if (!using_long_key_ && (inline_key_length_ + length <= sizeof(inline_key_))) {
+      memcpy(inline_key_ + inline_key_length_, data, length);
+      inline_key_length_ += length;
+      return;
+    }
+    if (!using_long_key_) {
+      long_key_.reserve(2 * (inline_key_length_ + length));
+      long_key_.assign(inline_key_, inline_key_length_);
+      using_long_key_ = true;
+    }
+    long_key_.append(data, length);
+  }
+}
+
+void CacheKeyBuilder::beginComponent(char separator) {
+  if (!empty_) {
+    append(&separator, 1);
+  }
+  empty_ = false;
+}
+
+CacheKeyBuilder &CacheKeyBuilder::add(const StringView &component) {
+  beginComponent('/');
+  append(component.data(), component.length());
+  return *this;
+}
+
+CacheKeyBuilder &CacheKeyBuilder::add(int64_t number) {
+  char buffer[24];
+  int length = snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(number));
+  return add(StringView(buffer, static_cast<size_t>(length)));
+}
+
+CacheKeyBuilder &CacheKeyBuilder::addUrl(const Url &url, int components) {
+  UrlView view;
+  url.getView(view);
+  if (components & URL_SCHEME) {
+    add(view.scheme_);
+  }
+  if (components & URL_HOST) {
+    add(view.host_);
+  }
+  if (components & URL_PORT) {
+    add(static_cast<int64_t>(view.port_));
+  }
+  if (components & URL_PATH) {
+    add(view.path_);
+  }
+  if ((components & URL_QUERY) && !view.query_.empty()) {
+    beginComponent('?');
+    append(view.query_.data(), view.query_.length());
+  }
+  return *this;
+}
+
+void CacheKeyBuilder::appendQueryParam(const StringView &param, bool &first) {
+  beginComponent(first ? '?' : '&');
+  first = false;
+  append(param.data(), param.length());
+}
+
+CacheKeyBuilder &CacheKeyBuilder::addQuery(const StringView &query, QueryOrder order, QueryParamFilter filter,
+                                           void *filter_data) {
+  StringView inline_params[MAX_INLINE_QUERY_PARAMS];
+  vector<StringView> more_params;
+  size_t param_count = 0;
+  bool first = true;
+
+  for (size_t start = 0; start < query.length();) {
+    size_t end = query.find('&', start);
+    if (end == StringView::npos) {
+      end = query.length();
+    }
+    StringView param = query.substr(start, end - start);
+    start = end + 1;
+    if (param.empty()) {
+      continue;
+    }
+    if (filter) {
+      size_t equals = param.find('=');
+      if (!filter(equals == StringView::npos ? param : param.substr(0, equals), filter_data)) {
+        continue;
+      }
+    }
+    if (order == QUERY_AS_IS) {
+      appendQueryParam(param, first);
+    } else if (param_count < MAX_INLINE_QUERY_PARAMS) {
+      inline_params[param_count++] = param;
+    } else {
+      if (more_params.empty()) {
+        more_params.assign(inline_params, inline_params + param_count);
+      }
+      more_params.push_back(param);
+      ++param_count;
+    }
+  }
+
+  if (param_count > MAX_INLINE_QUERY_PARAMS) {
+    std::sort(more_params.begin(), more_params.end(), paramLess);
+    for (size_t i = 0; i < more_params.size(); ++i) {
+      appendQueryParam(more_params[i], first);
+    }
+  } else if (param_count) {
+    insertionSort(inline_params, param_count);
+    for (size_t i = 0; i < param_count; ++i) {
+      appendQueryParam(inline_params[i], first);
+    }
+  }
+  return *this;
+}
+
+CacheKeyBuilder &CacheKeyBuilder::addHeader(const Headers &headers, const string &name) {
+  beginComponent('/');
+  StringView value;
+  for (int i = 0; !(value = headers.getValueView(name, i)).isNull(); ++i) {
+    if (i) {
+      append(",", 1);
+    }
+    append(value.data(), value.length());
+  }
+  return *this;
+}
+
+CacheKeyBuilder &CacheKeyBuilder::addHeader(const Headers &headers, WellKnownHeader header) {
+  beginComponent('/');
+  StringView value;
+  for (int i = 0; !(value = headers.getValueView(header, i)).isNull(); ++i) {
+    if (i) {
+      append(",", 1);
+    }
+    append(value.data(), value.length());
+  }
+  return *this;
+}
+
+StringView CacheKeyBuilder::getKey() const {
+  if (using_long_key_) {
+    return StringView(long_key_);
+  }
+  return StringView(inline_key_, inline_key_length_);
+}
+
+uint64_t CacheKeyBuilder::getHash() const {
+  if (!(outputs_ & OUTPUT_HASH)) {
+    return 0;
+  }
+  uint64_t hash;
+  if (total_length_ >= sizeof(stripe_)) {
+    hash = rotl64(acc_[0], 1) + rotl64(acc_[1], 7) + rotl64(acc_[2], 12) + rotl64(acc_[3], 18);
+    for (int i = 0; i < 4; ++i) {
+      hash = mergeRound(hash, acc_[i]);
+    }
+  } else {
+    hash = seed_ + PRIME64_5;
+  }
+  hash += total_length_;
+
+  const unsigned char *p = stripe_;
+  const unsigned char *end = stripe_ + stripe_length_;
+  for (; p + 8 <= end; p += 8) {
+    hash ^= hashRound(0, read64(p));
+    hash = rotl64(hash, 27) * PRIME64_1 + PRIME64_4;
+  }
+  if (p + 4 <= end) {
+    hash ^= read32(p) * PRIME64_1;
+    hash = rotl64(hash, 23) * PRIME64_2 + PRIME64_3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash ^= (*p) * PRIME64_5;
+    hash = rotl64(hash, 11) * PRIME64_1;
+  }
+
+  hash ^= hash >> 33;
+  hash *= PRIME64_2;
+  hash ^= hash >> 29;
+  hash *= PRIME64_3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+void CacheKeyBuilder::getHashString(char buffer[17]) const {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  uint64_t hash = getHash();
+  for (int i = 15; i >= 0; --i, hash >>= 4) {
+    buffer[i] = HEX_DIGITS[hash & 0xF];
+  }
+  buffer[16] = '\0';
+}
+
+bool CacheKeyBuilder::apply(Transaction &transaction) const {
+  TSHttpTxn txn = static_cast<TSHttpTxn>(transaction.getAtsHandle());
+  TSReturnCode result;
+  if (outputs_ & OUTPUT_KEY) {
+    StringView key = getKey();
+    result = TSCacheUrlSet(txn, key.data(), static_cast<int>(key.length()));
+  } else {
+    char hash[17];
+    getHashString(hash);
+    result = TSCacheUrlSet(txn, hash, 16);
+  }
+  if (result != TS_SUCCESS) {
+    LOG_ERROR("Unable to set the cache key of transaction %p", txn);
+    return false;
+  }
+  LOG_DEBUG("Set the cache key of transaction %p", txn);
+  return true;
+}
@@ -18,42 +18,89 @@
 
 #include "atscppapi/CaseInsensitiveStringComparator.h"
 
-namespace {
-  static char NORMALIZED_CHARACTERS[256];
-  static volatile bool normalizer_initialized(false);
-}
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
 using atscppapi::CaseInsensitiveStringComparator;
+using atscppapi::CaseInsensitiveStringHash;
 using std::string;
 
+namespace {
+
+const size_t BLOCK_SIZE = 16;
+
+inline unsigned char normalize(unsigned char c) {
+  return (static_cast<unsigned char>(c - 'A') < 26) ? (c | 0x20) : c;
+}
+
+/**
+ * @return Number of leading bytes that are equal ignoring case; only whole blocks of BLOCK_SIZE are
+ *         examined, the caller takes care of the rest.
+ */
+inline size_t getMatchingBlockPrefix(const char *lhs, const char *rhs, size_t length) {
+  size_t i = 0;
+#if defined(__SSE2__)
+  const __m128i before_upper = _mm_set1_epi8('A' - 1);
+  const __m128i after_upper = _mm_set1_epi8('Z' + 1);
+  const __m128i case_bit = _mm_set1_epi8(0x20);
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE) {
+    __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs + i));
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs + i));
+    // bytes >= 0x80 are negative in these signed comparisons, so they are never considered upper case
+    l = _mm_or_si128(l, _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi8(l, before_upper),
+                                                    _mm_cmplt_epi8(l, after_upper)), case_bit));
+    r = _mm_or_si128(r, _mm_and_si128(_mm_and_si128(_mm_cmpgt_epi8(r, before_upper),
+                                                    _mm_cmplt_epi8(r, after_upper)), case_bit));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(l, r));
+    if (mask != 0xFFFF) {
+      return i + __builtin_ctz(~mask);
+    }
+  }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+  const uint8x16_t upper_a = vdupq_n_u8('A');
+  const uint8x16_t letter_count = vdupq_n_u8(26);
+  const uint8x16_t case_bit = vdupq_n_u8(0x20);
+  for (; i + BLOCK_SIZE <= length; i += BLOCK_SIZE) {
+    uint8x16_t l = vld1q_u8(reinterpret_cast<const uint8_t *>(lhs + i));
+    uint8x16_t r = vld1q_u8(reinterpret_cast<const uint8_t *>(rhs + i));
+    l = vorrq_u8(l, vandq_u8(vcltq_u8(vsubq_u8(l, upper_a), letter_count), case_bit));
+    r = vorrq_u8(r, vandq_u8(vcltq_u8(vsubq_u8(r, upper_a), letter_count), case_bit));
+    if (vminvq_u8(vceqq_u8(l, r)) != 0xFF) {
+      break; // the scalar loop finds the exact position
+    }
+  }
+#else
+  (void) lhs;
+  (void) rhs;
+  (void) length;
+#endif
+  return i;
+}
+
+}
+
 bool CaseInsensitiveStringComparator::operator()(const string &lhs, const string &rhs) const {
   return (compare(lhs, rhs) < 0);
 }
 
 int CaseInsensitiveStringComparator::compare(const string &lhs, const string &rhs) const {
-  if (!normalizer_initialized) {
-    // this initialization is safe to execute in concurrent threads - hence no locking
-    for (int i = 0; i < 256; ++i) {
-      NORMALIZED_CHARACTERS[i] = static_cast<unsigned char>(i);
-    }
-    for (unsigned char i = 'A'; i < 'Z'; ++i) {
-      NORMALIZED_CHARACTERS[i] = 'a' + (i - 'A');
+  return compare(lhs.data(), lhs.size(), rhs.data(), rhs.size());
+}
+
+int CaseInsensitiveStringComparator::compare(const char *lhs, size_t lhs_size, const char *rhs,
+                                             size_t rhs_size) const {
+  size_t num_chars_to_compare = (lhs_size < rhs_size) ? lhs_size : rhs_size;
+  for (size_t i = getMatchingBlockPrefix(lhs, rhs, num_chars_to_compare); i < num_chars_to_compare; ++i) {
+    unsigned char normalized_lhs_char = normalize(static_cast<unsigned char>(lhs[i]));
+    unsigned char normalized_rhs_char = normalize(static_cast<unsigned char>(rhs[i]));
+    if (normalized_lhs_char < normalized_rhs_char) {
+      return -1;
     }
-    normalizer_initialized = true;
-  }
-  size_t lhs_size = lhs.size();
-  size_t rhs_size = rhs.size();
-  if ((lhs_size > 0) && (rhs_size > 0)) { 
-    size_t num_chars_to_compare = (lhs_size < rhs_size) ? lhs_size : rhs_size;
-    for (size_t i = 0; i < num_chars_to_compare; ++i) {
-      unsigned char normalized_lhs_char = NORMALIZED_CHARACTERS[static_cast<const unsigned char>(lhs[i])]; 
-      unsigned char normalized_rhs_char = NORMALIZED_CHARACTERS[static_cast<const unsigned char>(rhs[i])]; 
-      if (normalized_lhs_char < normalized_rhs_char) {
-        return -1;
-      }
-      if (normalized_lhs_char > normalized_rhs_char) {
-        return 1;
-      }
+    if (normalized_lhs_char > normalized_rhs_char) {
+      return 1;
     }
   }
   if (lhs_size < rhs_size) {
@@ -64,3 +111,26 @@ int CaseInsensitiveStringComparator::compare(const string &lhs, const string &rh
   }
   return 0; // both strings are equal
 }
+
+bool CaseInsensitiveStringComparator::equals(const string &lhs, const string &rhs) const {
+  return equals(lhs.data(), lhs.size(), rhs.data(), rhs.size());
+}
+
+bool CaseInsensitiveStringComparator::equals(const char *lhs, size_t lhs_size, const char *rhs,
+                                             size_t rhs_size) const {
+  return (lhs_size == rhs_size) && (compare(lhs, lhs_size, rhs, rhs_size) == 0);
+}
+
+size_t CaseInsensitiveStringHash::operator()(const string &str) const {
+  return (*this)(str.data(), str.size());
+}
+
+size_t CaseInsensitiveStringHash::operator()(const char *str, size_t length) const {
+  // FNV-1a over the normalized characters
+  size_t hash = static_cast<size_t>(2166136261UL);
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= normalize(static_cast<unsigned char>(str[i]));
+    hash *= static_cast<size_t>(16777619UL);
+  }
+  return hash;
+}
@@ -21,6 +21,7 @@
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "logging_internal.h"
 
 using namespace atscppapi;
@@ -28,7 +29,7 @@ using namespace atscppapi;
 /**
  * @private
  */
-struct atscppapi::ClientRequestState: noncopyable {
+struct atscppapi::ClientRequestState: noncopyable, ArenaAllocated {
   TSHttpTxn txn_;
   TSMBuffer pristine_hdr_buf_;
   TSMLoc pristine_url_loc_;
@@ -0,0 +1,292 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CompressedVariantCache.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/CompressedVariantCache.h"
+#include <list>
+#include <map>
+#include <string>
+#include "atscppapi/Mutex.h"
+#include "atscppapi/Headers.h"
+#include "atscppapi/ClientRequest.h"
+#include "atscppapi/Response.h"
+#include "atscppapi/CaseInsensitiveStringComparator.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::list;
+using std::map;
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::CompressedVariantCacheState: noncopyable {
+  typedef list<string> LruList;
+  typedef std::pair<shared_ptr<const string>, LruList::iterator> Entry;
+  typedef map<string, Entry> EntryMap;
+
+  size_t max_bytes_;
+  size_t max_entry_bytes_;
+  size_t size_;
+  EntryMap entries_;
+  LruList lru_; // most recently used at the front.
+  Mutex mutex_;
+
+  CompressedVariantCacheState(size_t max_bytes, size_t max_entry_bytes)
+    : max_bytes_(max_bytes), max_entry_bytes_(max_entry_bytes), size_(0) { }
+};
+
+namespace {
+
+/**
+ * @return true if the response has a content coding other than identity, compressing it again would corrupt it.
+ */
+bool isEncoded(Response &response) {
+  string encodings = response.getHeaders().getJoinedValues("Content-Encoding");
+  CaseInsensitiveStringComparator comparator;
+  string::size_type pos = 0;
+  while (pos < encodings.length()) {
+    string::size_type next = encodings.find(',', pos);
+    string::size_type end = (next == string::npos) ? encodings.length() : next;
+    string::size_type start = encodings.find_first_not_of(" \t", pos);
+    if ((start != string::npos) && (start < end)) {
+      string::size_type last = encodings.find_last_not_of(" \t", end - 1);
+      if (!comparator.equals(encodings.data() + start, last - start + 1, "identity", sizeof("identity") - 1)) {
+        return true;
+      }
+    }
+    pos = end + 1;
+  }
+  return false;
+}
+
+/**
+ * @return true if the response is a whole object fetched with GET, the only kind whose body may be compressed,
+ *         stored and served for the URL.
+ */
+bool isFullGetResponse(Transaction &transaction) {
+  ClientRequest &request = transaction.getClientRequest();
+  if ((request.getMethod() != HTTP_METHOD_GET) || !request.getHeaders().getJoinedValues("Range").empty()) {
+    return false;
+  }
+  return transaction.getServerResponse().getStatusCode() == HTTP_STATUS_OK;
+}
+
+/**
+ * Keeps the client response headers in line with the negotiated codec.
+ */
+class EncodingHeadersPlugin : public TransactionPlugin {
+public:
+  EncodingHeadersPlugin(Transaction &transaction) : TransactionPlugin(transaction) {
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  }
+
+  void handleSendResponseHeaders(Transaction &transaction) {
+    ContentEncoding::setResponseHeaders(transaction.getClientResponse(), ContentEncoding::negotiate(transaction));
+    transaction.resume();
+  }
+};
+
+class StoreTransformation : public TransformationPlugin {
+public:
+  StoreTransformation(Transaction &transaction, CompressedVariantCache &cache, const string &key, size_t max_bytes, Type type)
+    : TransformationPlugin(transaction, type), cache_(cache), key_(key), max_bytes_(max_bytes), too_large_(false) {
+  }
+
+  void consume(InputBuffer &input) {
+    if (!too_large_) {
+      if (body_.length() + input.length() > max_bytes_) {
+        LOG_DEBUG("Not caching key='%s', the body is larger than %d bytes", key_.c_str(), static_cast<int>(max_bytes_));
+        too_large_ = true;
+        string().swap(body_);
+      } else {
+        input.appendTo(body_);
+      }
+    }
+    produce(input);
+  }
+
+  void handleInputComplete() {
+    if (!too_large_) {
+      string *body = new string();
+      body->swap(body_);
+      cache_.put(key_, shared_ptr<const string>(body));
+    }
+    setOutputComplete();
+  }
+
+private:
+  CompressedVariantCache &cache_;
+  string key_;
+  size_t max_bytes_;
+  bool too_large_;
+  string body_;
+};
+
+class ServeTransformation : public TransformationPlugin {
+public:
+  ServeTransformation(Transaction &transaction, shared_ptr<const string> body, Type type)
+    : TransformationPlugin(transaction, type), body_(body), produced_(false) {
+  }
+
+  void consume(InputBuffer &) {
+    // The upstream body is replaced by the cached one, we start sending it as soon as data starts flowing.
+    produceBody();
+  }
+
+  void handleInputComplete() {
+    produceBody();
+    setOutputComplete();
+  }
+
+private:
+  void produceBody() {
+    if (!produced_) {
+      produced_ = true;
+      produce(body_->data(), body_->length());
+    }
+  }
+
+  shared_ptr<const string> body_;
+  bool produced_;
+};
+
+} /* anonymous namespace */
+
+CompressedVariantCache::CompressedVariantCache(size_t max_bytes, size_t max_entry_bytes) {
+  state_ = new CompressedVariantCacheState(max_bytes, (max_entry_bytes < max_bytes) ? max_entry_bytes : max_bytes);
+}
+
+CompressedVariantCache::~CompressedVariantCache() {
+  delete state_;
+}
+
+string CompressedVariantCache::createKey(const string &url, ContentEncoding::Codec codec, const string &etag) {
+  string key(ContentEncoding::getName(codec));
+  key.append(1, ' ').append(etag).append(1, ' ').append(url);
+  return key;
+}
+
+shared_ptr<const string> CompressedVariantCache::get(const string &key) {
+  ScopedMutexLock lock(state_->mutex_);
+  CompressedVariantCacheState::EntryMap::iterator iter = state_->entries_.find(key);
+  if (iter == state_->entries_.end()) {
+    LOG_DEBUG("CompressedVariantCache=%p miss for key='%s'", this, key.c_str());
+    return shared_ptr<const string>();
+  }
+
+  state_->lru_.splice(state_->lru_.begin(), state_->lru_, iter->second.second);
+  LOG_DEBUG("CompressedVariantCache=%p hit for key='%s'", this, key.c_str());
+  return iter->second.first;
+}
+
+void CompressedVariantCache::put(const string &key, shared_ptr<const string> body) {
+  if (!body.get() || body->length() > state_->max_entry_bytes_) {
+    return;
+  }
+
+  ScopedMutexLock lock(state_->mutex_);
+  CompressedVariantCacheState::EntryMap::iterator iter = state_->entries_.find(key);
+  if (iter != state_->entries_.end()) {
+    state_->size_ -= iter->second.first->length();
+    state_->lru_.erase(iter->second.second);
+    state_->entries_.erase(iter);
+  }
+
+  while (!state_->lru_.empty() && (state_->size_ + body->length() > state_->max_bytes_)) {
+    CompressedVariantCacheState::EntryMap::iterator victim = state_->entries_.find(state_->lru_.back());
+    LOG_DEBUG("CompressedVariantCache=%p evicting key='%s'", this, victim->first.c_str());
+    state_->size_ -= victim->second.first->length();
+    state_->entries_.erase(victim);
+    state_->lru_.pop_back();
+  }
+
+  state_->lru_.push_front(key);
+  state_->entries_[key] = CompressedVariantCacheState::Entry(body, state_->lru_.begin());
+  state_->size_ += body->length();
+  LOG_DEBUG("CompressedVariantCache=%p stored key='%s' length=%d, cache size=%d", this, key.c_str(),
+            static_cast<int>(body->length()), static_cast<int>(state_->size_));
+}
+
+void CompressedVariantCache::clear() {
+  ScopedMutexLock lock(state_->mutex_);
+  state_->entries_.clear();
+  state_->lru_.clear();
+  state_->size_ = 0;
+}
+
+size_t CompressedVariantCache::getSize() const {
+  ScopedMutexLock lock(state_->mutex_);
+  return state_->size_;
+}
+
+size_t CompressedVariantCache::getEntryCount() const {
+  ScopedMutexLock lock(state_->mutex_);
+  return state_->entries_.size();
+}
+
+ContentEncoding::Codec CompressedVariantCache::setupTransaction(Transaction &transaction) {
+  ContentEncoding::Codec codec = ContentEncoding::negotiate(transaction);
+  if (codec == ContentEncoding::IDENTITY) {
+    return codec;
+  }
+  if (!isFullGetResponse(transaction)) {
+    LOG_DEBUG("Transaction %p isn't a full GET response, it's served as is", &transaction);
+    return ContentEncoding::IDENTITY;
+  }
+  if (isEncoded(transaction.getServerResponse())) {
+    LOG_DEBUG("The origin response of transaction %p is encoded already, it's served as is", &transaction);
+    return ContentEncoding::IDENTITY;
+  }
+
+  string etag = transaction.getServerResponse().getHeaders().getJoinedValues("ETag");
+  string key;
+  if (!etag.empty()) {
+    key = createKey(transaction.getClientRequest().getUrl().getUrlString(), codec, etag);
+    shared_ptr<const string> body = get(key);
+    if (body.get()) {
+      transaction.addPlugin(createServeTransformation(transaction, body));
+      transaction.addPlugin(new EncodingHeadersPlugin(transaction));
+      return codec;
+    }
+  }
+
+  TransformationPlugin *compressor = ContentEncoding::createCompressor(transaction, codec);
+  if (!compressor) {
+    return ContentEncoding::IDENTITY;
+  }
+  transaction.addPlugin(compressor);
+
+  // Without a validator we can't know when the body changes, so it's compressed but never stored.
+  if (!key.empty()) {
+    transaction.addPlugin(createStoreTransformation(transaction, key));
+  }
+  transaction.addPlugin(new EncodingHeadersPlugin(transaction));
+  return codec;
+}
+
+TransformationPlugin *CompressedVariantCache::createStoreTransformation(Transaction &transaction, const string &key,
+                                                                        TransformationPlugin::Type type) {
+  return new StoreTransformation(transaction, *this, key, state_->max_entry_bytes_, type);
+}
+
+TransformationPlugin *CompressedVariantCache::createServeTransformation(Transaction &transaction, shared_ptr<const string> body,
+                                                                        TransformationPlugin::Type type) {
+  return new ServeTransformation(transaction, body, type);
+}
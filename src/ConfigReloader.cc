@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ConfigReloader.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/ConfigReloader.h"
+#include <ts/ts.h>
+#include "atscppapi/Mutex.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+/**
+ * @private
+ */
+struct atscppapi::ConfigReloaderState : noncopyable {
+  ConfigReloader &reloader_;
+  AsyncTimer *timer_;
+  TSCont update_cont_;
+  Mutex reload_mutex_; // reloads from the timer, a config update and reloadNow() don't overlap
+  volatile int reload_count_;
+  ConfigReloaderState(ConfigReloader &reloader)
+    : reloader_(reloader), timer_(NULL), update_cont_(NULL), reload_count_(0) { }
+
+  bool reload(const char *trigger) {
+    ScopedMutexLock lock(reload_mutex_);
+    if (!reloader_.reload()) {
+      LOG_ERROR("Reload on %s failed, keeping the current configuration", trigger);
+      return false;
+    }
+    __sync_add_and_fetch(&reload_count_, 1);
+    LOG_DEBUG("Reloaded on %s", trigger);
+    return true;
+  }
+};
+
+namespace {
+
+int handleConfigUpdate(TSCont cont, TSEvent event, void *edata) {
+  ConfigReloaderState *state = static_cast<ConfigReloaderState *>(TSContDataGet(cont));
+  if (state) {
+    state->reload("configuration update");
+  }
+  return 0;
+}
+
+}
+
+ConfigReloader::ConfigReloader() : state_(new ConfigReloaderState(*this)) {
+}
+
+ConfigReloader::~ConfigReloader() {
+  delete state_->timer_; // cancels it
+  if (state_->update_cont_) {
+    // Traffic Server offers no way to unregister, keep the continuation around without a reloader
+    TSContDataSet(state_->update_cont_, NULL);
+    LOG_ERROR("Reloader destroyed while registered for configuration updates");
+  }
+  delete state_;
+}
+
+void ConfigReloader::reloadEvery(int period_ms) {
+  if (state_->timer_) {
+    LOG_ERROR("Already reloading every %d ms", period_ms);
+    return;
+  }
+  state_->timer_ = new AsyncTimer(AsyncTimer::TYPE_PERIODIC, period_ms, 0, ASYNC_THREAD_POOL_TASK);
+  Async::execute<AsyncTimer>(this, state_->timer_, shared_ptr<Mutex>());
+  LOG_DEBUG("Reloading every %d ms", period_ms);
+}
+
+void ConfigReloader::reloadOnConfigUpdate(const string &plugin_name) {
+  if (state_->update_cont_) {
+    LOG_ERROR("Already reloading on configuration updates");
+    return;
+  }
+  state_->update_cont_ = TSContCreate(handleConfigUpdate, TSMutexCreate());
+  TSContDataSet(state_->update_cont_, static_cast<void *>(state_));
+  TSMgmtUpdateRegister(state_->update_cont_, plugin_name.c_str());
+  LOG_DEBUG("Reloading [%s] on configuration updates", plugin_name.c_str());
+}
+
+bool ConfigReloader::reloadNow() {
+  return state_->reload("request");
+}
+
+int ConfigReloader::getReloadCount() const {
+  return state_->reload_count_;
+}
+
+void ConfigReloader::handleAsyncComplete(AsyncTimer &timer) {
+  state_->reload("timer");
+}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ContentEncoding.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/ContentEncoding.h"
+#include <cstdlib>
+#include <string>
+#include "atscppapi/Headers.h"
+#include "atscppapi/ClientRequest.h"
+#include "atscppapi/GzipDeflateTransformation.h"
+#ifdef ATSCPPAPI_HAVE_BROTLI
+#include "atscppapi/BrotliDeflateTransformation.h"
+#endif
+#ifdef ATSCPPAPI_HAVE_ZSTD
+#include "atscppapi/ZstdDeflateTransformation.h"
+#endif
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+
+namespace {
+
+const string CONTEXT_KEY("atscppapi.content_encoding");
+
+struct NegotiatedCodec : Transaction::ContextValue {
+  ContentEncoding::Codec codec_;
+  NegotiatedCodec(ContentEncoding::Codec codec) : codec_(codec) { }
+};
+
+string trim(const string &str) {
+  string::size_type start = str.find_first_not_of(" \t");
+  if (start == string::npos) {
+    return string();
+  }
+  string::size_type end = str.find_last_not_of(" \t");
+  return str.substr(start, end - start + 1);
+}
+
+string toLower(string str) {
+  for (string::size_type i = 0; i < str.length(); ++i) {
+    if (str[i] >= 'A' && str[i] <= 'Z') {
+      str[i] = str[i] - 'A' + 'a';
+    }
+  }
+  return str;
+}
+
+void varyOnAcceptEncoding(Headers &headers) {
+  string vary = toLower(headers.getJoinedValues("Vary"));
+  if (vary.find("accept-encoding") == string::npos && vary.find('*') == string::npos) {
+    headers.append("Vary", "Accept-Encoding");
+  }
+}
+
+/** A compressor caching its output, with the headers of the codec so hits are served as they were compressed. */
+template <typename Compressor>
+class CachedCompressor : public Compressor {
+public:
+  CachedCompressor(Transaction &transaction, ContentEncoding::Codec codec)
+    : Compressor(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION), codec_(codec) {
+    this->setCachedVariant(TransformationPlugin::CACHED_VARIANT_TRANSFORMED);
+  }
+
+  void handleTransformedResponseHeaders(Response &response) {
+    ContentEncoding::setResponseHeaders(response, codec_);
+  }
+private:
+  ContentEncoding::Codec codec_;
+};
+
+// q values are 0 to 1 with up to three decimals, we keep them as integers 0-1000.
+int parseQuality(const string &params) {
+  string::size_type pos = 0;
+  while (pos != string::npos) {
+    string::size_type next = params.find(';', pos);
+    string param = toLower(trim(params.substr(pos, next == string::npos ? string::npos : next - pos)));
+    if (param.length() > 2 && param[0] == 'q' && param[1] == '=') {
+      double q = atof(param.c_str() + 2);
+      if (q <= 0) {
+        return 0;
+      }
+      return (q >= 1) ? 1000 : static_cast<int>(q * 1000 + 0.5);
+    }
+    pos = (next == string::npos) ? next : next + 1;
+  }
+  return 1000;
+}
+
+const ContentEncoding::Codec PREFERENCE[] = { ContentEncoding::BROTLI, ContentEncoding::ZSTD, ContentEncoding::GZIP };
+const int NUM_CODECS = sizeof(PREFERENCE) / sizeof(PREFERENCE[0]);
+
+} /* anonymous namespace */
+
+ContentEncoding::Codec ContentEncoding::negotiate(const string &accept_encoding) {
+  // -1 means the coding was not mentioned, it's only acceptable if a wildcard says so.
+  int quality[NUM_CODECS];
+  int wildcard_quality = -1;
+  for (int i = 0; i < NUM_CODECS; ++i) {
+    quality[i] = -1;
+  }
+
+  string::size_type pos = 0;
+  while (pos < accept_encoding.length()) {
+    string::size_type next = accept_encoding.find(',', pos);
+    string element = accept_encoding.substr(pos, next == string::npos ? string::npos : next - pos);
+    pos = (next == string::npos) ? accept_encoding.length() : next + 1;
+
+    string::size_type params_start = element.find(';');
+    string coding = toLower(trim(element.substr(0, params_start)));
+    int q = (params_start == string::npos) ? 1000 : parseQuality(element.substr(params_start + 1));
+    if (coding == "*") {
+      wildcard_quality = q;
+    } else {
+      for (int i = 0; i < NUM_CODECS; ++i) {
+        if (coding == getName(PREFERENCE[i]) || (PREFERENCE[i] == GZIP && coding == "x-gzip")) {
+          quality[i] = q;
+        }
+      }
+    }
+  }
+
+  Codec chosen = IDENTITY;
+  int chosen_quality = 0;
+  for (int i = 0; i < NUM_CODECS; ++i) {
+    int q = (quality[i] >= 0) ? quality[i] : wildcard_quality;
+    if (q > chosen_quality && isAvailable(PREFERENCE[i])) {
+      chosen = PREFERENCE[i];
+      chosen_quality = q;
+    }
+  }
+  LOG_DEBUG("Negotiated content encoding '%s' from accept encoding '%s'", getName(chosen).c_str(), accept_encoding.c_str());
+  return chosen;
+}
+
+ContentEncoding::Codec ContentEncoding::negotiate(Transaction &transaction) {
+  shared_ptr<Transaction::ContextValue> value = transaction.getContextValue(CONTEXT_KEY);
+  if (value.get()) {
+    return static_cast<NegotiatedCodec *>(value.get())->codec_;
+  }
+
+  Codec codec = negotiate(transaction.getClientRequest().getHeaders().getJoinedValues("Accept-Encoding"));
+  transaction.setContextValue(CONTEXT_KEY, shared_ptr<Transaction::ContextValue>(new NegotiatedCodec(codec)));
+  return codec;
+}
+
+bool ContentEncoding::isAvailable(Codec codec) {
+  switch (codec) {
+  case IDENTITY:
+  case GZIP:
+    return true;
+  case BROTLI:
+#ifdef ATSCPPAPI_HAVE_BROTLI
+    return true;
+#else
+    return false;
+#endif
+  case ZSTD:
+#ifdef ATSCPPAPI_HAVE_ZSTD
+    return true;
+#else
+    return false;
+#endif
+  }
+  return false;
+}
+
+string ContentEncoding::getName(Codec codec) {
+  switch (codec) {
+  case GZIP:
+    return "gzip";
+  case BROTLI:
+    return "br";
+  case ZSTD:
+    return "zstd";
+  case IDENTITY:
+    break;
+  }
+  return "identity";
+}
+
+void ContentEncoding::setResponseHeaders(Response &response, Codec codec) {
+  if (codec == IDENTITY) {
+    return;
+  }
+
+  Headers &headers = response.getHeaders();
+  headers.set("Content-Encoding", getName(codec));
+  headers.erase("Content-Length");
+
+  varyOnAcceptEncoding(headers);
+}
+
+TransformationPlugin *ContentEncoding::createCompressor(Transaction &transaction, Codec codec, TransformationPlugin::Type type) {
+  switch (codec) {
+  case GZIP:
+    return new GzipDeflateTransformation(transaction, type);
+#ifdef ATSCPPAPI_HAVE_BROTLI
+  case BROTLI:
+    return new BrotliDeflateTransformation(transaction, type);
+#endif
+#ifdef ATSCPPAPI_HAVE_ZSTD
+  case ZSTD:
+    return new ZstdDeflateTransformation(transaction, type);
+#endif
+  default:
+    break;
+  }
+  LOG_DEBUG("No compressor available for content encoding '%s'", getName(codec).c_str());
+  return NULL;
+}
+
+TransformationPlugin *ContentEncoding::createCachedCompressor(Transaction &transaction, Codec codec) {
+  // the origin's response is cached as the identity variant, it must not be served to clients accepting more
+  varyOnAcceptEncoding(transaction.getServerResponse().getHeaders());
+  switch (codec) {
+  case GZIP:
+    return new CachedCompressor<GzipDeflateTransformation>(transaction, codec);
+#ifdef ATSCPPAPI_HAVE_BROTLI
+  case BROTLI:
+    return new CachedCompressor<BrotliDeflateTransformation>(transaction, codec);
+#endif
+#ifdef ATSCPPAPI_HAVE_ZSTD
+  case ZSTD:
+    return new CachedCompressor<ZstdDeflateTransformation>(transaction, codec);
+#endif
+  default:
+    break;
+  }
+  LOG_DEBUG("No compressor available for content encoding '%s', the identity variant is cached", getName(codec).c_str());
+  return NULL;
+}
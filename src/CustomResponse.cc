@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file CustomResponse.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/CustomResponse.h"
+#include <utility>
+#include <vector>
+#include <ts/ts.h>
+#include "atscppapi/Transaction.h"
+#include "atscppapi/TransactionPlugin.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+/**
+ * @private
+ */
+struct atscppapi::CustomResponseState : noncopyable {
+  HttpStatus status_;
+  string body_;
+  string content_type_;
+  string reason_phrase_;
+  vector<std::pair<string, string> > headers_;
+  CustomResponseState(HttpStatus status, const string &body, const string &content_type)
+    : status_(status), body_(body), content_type_(content_type) { }
+};
+
+namespace {
+
+/** Puts the reason phrase and the headers onto the error response, which Traffic Server builds itself. */
+class CustomResponseHeadersPlugin : public TransactionPlugin {
+public:
+  CustomResponseHeadersPlugin(Transaction &transaction, const CustomResponseState &state)
+    : TransactionPlugin(transaction, MUTEX_NONE), state_(state) {
+    registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  }
+
+  void handleSendResponseHeaders(Transaction &transaction) {
+    Response &response = transaction.getClientResponse();
+    response.setStatusCode(state_.status_);
+    if (!state_.reason_phrase_.empty()) {
+      response.setReasonPhrase(state_.reason_phrase_);
+    }
+    Headers &headers = response.getHeaders();
+    for (vector<std::pair<string, string> >::const_iterator iter = state_.headers_.begin(),
+           end = state_.headers_.end(); iter != end; ++iter) {
+      headers.set(iter->first, iter->second);
+    }
+    transaction.resume();
+  }
+private:
+  const CustomResponseState &state_;
+};
+
+}
+
+CustomResponse::CustomResponse(HttpStatus status, const string &body, const string &content_type)
+  : state_(new CustomResponseState(status, body, content_type)) {
+}
+
+CustomResponse *CustomResponse::createRedirect(const string &location, HttpStatus status) {
+  CustomResponse *response = new CustomResponse(status, string());
+  response->addHeader("Location", location);
+  return response;
+}
+
+CustomResponse &CustomResponse::setReasonPhrase(const string &reason_phrase) {
+  state_->reason_phrase_ = reason_phrase;
+  return *this;
+}
+
+CustomResponse &CustomResponse::addHeader(const string &name, const string &value) {
+  state_->headers_.push_back(std::make_pair(name, value));
+  return *this;
+}
+
+void CustomResponse::send(Transaction &transaction) const {
+  LOG_DEBUG("Sending custom response %p with status %d to tshttptxn=%p", this, state_->status_,
+            transaction.getAtsHandle());
+  TSHttpTxnSetHttpRetStatus(static_cast<TSHttpTxn>(transaction.getAtsHandle()),
+                            static_cast<TSHttpStatus>(state_->status_));
+  transaction.setResponseBody(state_->body_.data(), state_->body_.length(), state_->content_type_.c_str());
+  if (!state_->reason_phrase_.empty() || !state_->headers_.empty()) {
+    transaction.addPlugin(new CustomResponseHeadersPlugin(transaction, *state_));
+  }
+  transaction.error();
+}
+
+CustomResponse::~CustomResponse() {
+  delete state_;
+}
@@ -19,8 +19,10 @@
 #include <ts/ts.h>
 #include <cstddef>
 #include <cassert>
+#include <vector>
 #include "atscppapi/noncopyable.h"
 #include "utils_internal.h"
+#include "HookFilterRequest.h"
 #include "logging_internal.h"
 
 using namespace atscppapi;
@@ -29,26 +31,119 @@ using namespace atscppapi;
  * @private
  */
 struct atscppapi::GlobalPluginState : noncopyable {
-  TSCont cont_;
   bool ignore_internal_transactions_;
   GlobalPlugin *global_plugin_;
   GlobalPluginState(GlobalPlugin *global_plugin, bool ignore_internal_transactions)
-    : global_plugin_(global_plugin), ignore_internal_transactions_(ignore_internal_transactions) { }
+    : ignore_internal_transactions_(ignore_internal_transactions), global_plugin_(global_plugin) { }
 };
 
 namespace {
 
-static int handleGlobalPluginEvents(TSCont cont, TSEvent event, void *edata) {
+const int HOOK_TYPE_COUNT = Plugin::HOOK_CACHE_LOOKUP_COMPLETE + 1;
+
+/**
+ * All GlobalPlugins registered for a hook, called in order of registration by the single continuation
+ * of the hook.
+ */
+struct GlobalHookTarget {
+  GlobalPluginState *plugin_state_;
+  HookFilter filter_;
+  bool filtered_; // false for an empty filter, which needn't be evaluated
+  GlobalHookTarget(GlobalPluginState *plugin_state, const HookFilter &filter)
+    : plugin_state_(plugin_state), filter_(filter), filtered_(!filter.empty()) { }
+};
+
+struct GlobalHookTable {
+  TSCont cont_;
+  std::vector<GlobalHookTarget> targets_;
+  GlobalHookTable() : cont_(NULL) { }
+};
+
+GlobalHookTable global_hook_tables[HOOK_TYPE_COUNT];
+
+/**
+ * @return true if the target is to be invoked for the transaction, its filter is evaluated on request.
+ */
+bool hookTargetApplies(const GlobalHookTarget &target, HookFilterRequest &request) {
+  if (target.plugin_state_->ignore_internal_transactions_ && request.isInternal()) {
+    return false;
+  }
+  return !target.filtered_ || utils::internal::hookFilterMatches(target.filter_, request);
+}
+
+/**
+ * @return The index of the first target from first_index on that applies, the number of targets if none does.
+ */
+size_t findApplyingTarget(const GlobalHookTable &table, size_t first_index, HookFilterRequest &request) {
+  size_t i = first_index;
+  while ((i < table.targets_.size()) && !hookTargetApplies(table.targets_[i], request)) {
+    LOG_DEBUG("Skipping global plugin %p for transaction %p", table.targets_[i].plugin_state_->global_plugin_,
+              request.txn_);
+    ++i;
+  }
+  return i;
+}
+
+void dispatchGlobalPluginHooks(Transaction &transaction, const GlobalHookTable &table, int event, size_t index,
+                               HookFilterRequest &request);
+
+void continueGlobalPluginHooks(Transaction &transaction, int event, size_t first_index) {
+  int hook_type = utils::internal::convertTsEventToInternalHook(static_cast<TSEvent>(event));
+  HookFilterRequest request(static_cast<TSHttpTxn>(transaction.getAtsHandle()));
+  const GlobalHookTable &table = global_hook_tables[hook_type];
+  dispatchGlobalPluginHooks(transaction, table, event, findApplyingTarget(table, first_index, request), request);
+}
+
+/**
+ * Invokes the target at index, which applies, and those after it that apply, until one doesn't resume right away.
+ */
+void dispatchGlobalPluginHooks(Transaction &transaction, const GlobalHookTable &table, int event, size_t index,
+                               HookFilterRequest &request) {
+  for (size_t count = table.targets_.size(); index < count; index = findApplyingTarget(table, index + 1, request)) {
+    GlobalPlugin *plugin = table.targets_[index].plugin_state_->global_plugin_;
+    LOG_DEBUG("Invoking global plugin %p for event %d on transaction %p", plugin, event, request.txn_);
+    utils::internal::beginPluginCallback(transaction, event, index, continueGlobalPluginHooks);
+    // the hook timing, trace spans and memory accounting of the plugin are all done there
+    utils::internal::invokePluginForEvent(plugin, request.txn_, static_cast<TSEvent>(event));
+    if (!utils::internal::endPluginCallback(transaction)) {
+      return;
+    }
+  }
+  utils::internal::endPluginDispatch(transaction);
+}
+
+int handleGlobalHookEvents(TSCont cont, TSEvent event, void *edata) {
   TSHttpTxn txn = static_cast<TSHttpTxn>(edata);
-  GlobalPluginState *state = static_cast<GlobalPluginState *>(TSContDataGet(cont));
-  if (state->ignore_internal_transactions_ && (TSHttpIsInternalRequest(txn) == TS_SUCCESS)) {
-    LOG_DEBUG("Ignoring event %d on internal transaction %p for global plugin %p", event, txn,
-              state->global_plugin_);
+  const GlobalHookTable *table = static_cast<const GlobalHookTable *>(TSContDataGet(cont));
+  // the filters run on the Traffic Server request, a Transaction is only built for a plugin to invoke
+  HookFilterRequest request(txn);
+  if (request.isPassthrough()) {
+    LOG_DEBUG("Passing through the transaction %p of a fetch for event %d", txn, event);
     TSHttpTxnReenable(txn, TS_EVENT_HTTP_CONTINUE);
-  } else {
-    LOG_DEBUG("Invoking global plugin %p for event %d on transaction %p", state->global_plugin_, event, txn);
-    utils::internal::invokePluginForEvent(state->global_plugin_, txn, event);
+    return 0;
+  }
+  size_t index = findApplyingTarget(*table, 0, request);
+  if (index == table->targets_.size()) {
+    LOG_DEBUG("No global plugin to invoke for event %d on transaction %p", event, txn);
+    TSHttpTxnReenable(txn, TS_EVENT_HTTP_CONTINUE);
+    return 0;
+  }
+  dispatchGlobalPluginHooks(utils::internal::getTransaction(txn), *table, event, index, request);
+  return 0;
+}
+
+// the plugins of registerSessionStartHook(), called in order of registration
+std::vector<GlobalPlugin *> session_start_plugins;
+TSCont session_start_cont = NULL;
+
+int handleSessionStartEvents(TSCont cont, TSEvent event, void *edata) {
+  TSHttpSsn ssn = static_cast<TSHttpSsn>(edata);
+  Session &session = utils::internal::getSession(ssn);
+  for (size_t i = 0; i < session_start_plugins.size(); ++i) {
+    LOG_DEBUG("Invoking global plugin %p for the start of session %p", session_start_plugins[i], ssn);
+    session_start_plugins[i]->handleSessionStart(session);
   }
+  TSHttpSsnReenable(ssn, TS_EVENT_HTTP_CONTINUE);
   return 0;
 }
 
@@ -57,18 +152,52 @@ static int handleGlobalPluginEvents(TSCont cont, TSEvent event, void *edata) {
 GlobalPlugin::GlobalPlugin(bool ignore_internal_transactions) {
   utils::internal::initTransactionManagement();
   state_ = new GlobalPluginState(this, ignore_internal_transactions);
-  TSMutex mutex = NULL;
-  state_->cont_ = TSContCreate(handleGlobalPluginEvents, mutex);
-  TSContDataSet(state_->cont_, static_cast<void *>(state_));
 }
 
 GlobalPlugin::~GlobalPlugin() {
-  TSContDestroy(state_->cont_);
+  for (int hook_type = 0; hook_type < HOOK_TYPE_COUNT; ++hook_type) {
+    GlobalHookTable &table = global_hook_tables[hook_type];
+    for (std::vector<GlobalHookTarget>::iterator iter = table.targets_.begin(); iter != table.targets_.end();) {
+      if (iter->plugin_state_ == state_) {
+        iter = table.targets_.erase(iter);
+      } else {
+        ++iter;
+      }
+    }
+  }
+  for (std::vector<GlobalPlugin *>::iterator iter = session_start_plugins.begin(); iter != session_start_plugins.end();) {
+    iter = (*iter == this) ? session_start_plugins.erase(iter) : iter + 1;
+  }
   delete state_;
 }
 
+void GlobalPlugin::registerSessionStartHook() {
+  if (!session_start_cont) {
+    TSMutex mutex = NULL;
+    session_start_cont = TSContCreate(handleSessionStartEvents, mutex);
+    TSHttpHookAdd(TS_HTTP_SSN_START_HOOK, session_start_cont);
+  }
+  session_start_plugins.push_back(this);
+  LOG_DEBUG("Registered global plugin %p for the start of sessions", this);
+}
+
+void GlobalPlugin::handleSessionStart(Session &session) {
+  // The default implementation does nothing, the session is resumed by the caller.
+}
+
 void GlobalPlugin::registerHook(Plugin::HookType hook_type) {
-  TSHttpHookID hook_id = utils::internal::convertInternalHookToTsHook(hook_type);
-  TSHttpHookAdd(hook_id, state_->cont_);
-  LOG_DEBUG("Registered global plugin %p for hook %s", this, HOOK_TYPE_STRINGS[hook_type].c_str());
+  registerHook(hook_type, HookFilter());
+}
+
+void GlobalPlugin::registerHook(Plugin::HookType hook_type, const HookFilter &filter) {
+  GlobalHookTable &table = global_hook_tables[hook_type];
+  if (!table.cont_) {
+    TSMutex mutex = NULL;
+    table.cont_ = TSContCreate(handleGlobalHookEvents, mutex);
+    TSContDataSet(table.cont_, static_cast<void *>(&table));
+    TSHttpHookAdd(utils::internal::convertInternalHookToTsHook(hook_type), table.cont_);
+  }
+  table.targets_.push_back(GlobalHookTarget(state_, filter));
+  LOG_DEBUG("Registered global plugin %p for hook %s%s", this, getHookTypeName(hook_type).data(),
+            filter.empty() ? "" : " with a filter");
 }
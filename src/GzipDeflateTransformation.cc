@@ -32,6 +32,10 @@ namespace {
 const int GZIP_MEM_LEVEL = 8;
 const int WINDOW_BITS = 31; // Always use 31 for gzip.
 const int ONE_KB = 1024;
+const size_t INPUT_LOW_WATERMARK = 8 * ONE_KB; // small chunks compress poorly and cost a deflate() call each.
+const size_t INPUT_HIGH_WATERMARK = 64 * ONE_KB;
+const size_t DEFAULT_FLUSH_WATERMARK = 64 * ONE_KB;
+const size_t DEFAULT_OUTPUT_BUFFER_SIZE = 16 * ONE_KB;
 }
 
 /**
@@ -40,15 +44,20 @@ const int ONE_KB = 1024;
 struct atscppapi::transformations::GzipDeflateTransformationState: noncopyable {
   z_stream z_stream_;
   bool z_stream_initialized_;
-  int64_t bytes_produced_;
   TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  GzipDeflateTransformation::Options options_;
+  vector<unsigned char> buffer_; // reused for every call to deflate().
+  size_t bytes_since_flush_;
 
-  GzipDeflateTransformationState(TransformationPlugin::Type type) :
-        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0) {
+  GzipDeflateTransformationState(TransformationPlugin::Type type, const GzipDeflateTransformation::Options &options) :
+        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0), options_(options),
+        buffer_(options.output_buffer_size_ ? options.output_buffer_size_ : DEFAULT_OUTPUT_BUFFER_SIZE),
+        bytes_since_flush_(0) {
 
     memset(&z_stream_, 0, sizeof(z_stream_));
     int err =
-        deflateInit2(&z_stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, WINDOW_BITS , GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        deflateInit2(&z_stream_, options_.level_, Z_DEFLATED, options_.window_bits_, options_.mem_level_, options_.strategy_);
 
     if (Z_OK != err) {
       LOG_ERROR("deflateInit2 failed with error code '%d'.", err);
@@ -64,9 +73,29 @@ struct atscppapi::transformations::GzipDeflateTransformationState: noncopyable {
   };
 };
 
+GzipDeflateTransformation::Options::Options()
+  : level_(Z_DEFAULT_COMPRESSION), mem_level_(GZIP_MEM_LEVEL), window_bits_(WINDOW_BITS), strategy_(Z_DEFAULT_STRATEGY),
+    flush_policy_(FLUSH_EVERY_CHUNK), flush_watermark_(DEFAULT_FLUSH_WATERMARK), output_buffer_size_(DEFAULT_OUTPUT_BUFFER_SIZE) {
+}
 
 GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
-  state_ = new GzipDeflateTransformationState(type);
+  state_ = new GzipDeflateTransformationState(type, Options());
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new GzipDeflateTransformationState(type, options);
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new GzipDeflateTransformationState(getType(), Options());
+}
+
+GzipDeflateTransformation::GzipDeflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                     const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new GzipDeflateTransformationState(getType(), options);
 }
 
 GzipDeflateTransformation::~GzipDeflateTransformation() {
@@ -74,80 +103,87 @@ GzipDeflateTransformation::~GzipDeflateTransformation() {
 }
 
 void GzipDeflateTransformation::consume(const string &data) {
-  if (data.size() == 0) {
-    return;
-  }
+  compressData(data.data(), data.length());
+}
 
-  if (!state_->z_stream_initialized_) {
-    LOG_ERROR("Unable to deflate output because the z_stream was not initialized.");
-    return;
+void GzipDeflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    compressData(data, length);
   }
+}
 
+bool GzipDeflateTransformation::runDeflate(int flush) {
   int iteration = 0;
-  state_->z_stream_.data_type = Z_ASCII;
-  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data.c_str()));
-  state_->z_stream_.avail_in = data.length();
-
-  // For small payloads the size can actually be greater than the original input
-  // so we'll use twice the original size to avoid needless repeated calls to deflate.
-  unsigned long buffer_size = data.length() < ONE_KB ? 2 * ONE_KB : data.length();
-  vector<unsigned char> buffer(buffer_size);
+  int status = Z_OK;
+  unsigned char *buffer = &state_->buffer_[0];
+  size_t buffer_size = state_->buffer_.size();
 
+  // Keep draining into the same buffer until zlib has room to spare, that means it has nothing left to give us.
   do {
-    LOG_DEBUG("Iteration %d: Deflate will compress %d bytes", ++iteration, data.size());
     state_->z_stream_.avail_out = buffer_size;
-    state_->z_stream_.next_out = &buffer[0];
+    state_->z_stream_.next_out = buffer;
 
-    int err = deflate(&state_->z_stream_, Z_SYNC_FLUSH);
-    if (Z_OK != err) {
-      LOG_ERROR("Iteration %d: Deflate failed to compress %d bytes with error code '%d'", iteration, data.size(), err);
-      return;
+    status = deflate(&state_->z_stream_, flush);
+    if (status != Z_OK && status != Z_STREAM_END && status != Z_BUF_ERROR) {
+      LOG_ERROR("Iteration %d: Deflate failed with flush=%d and error code '%d'", iteration, flush, status);
+      return false;
     }
 
-    int bytes_to_write = buffer_size - state_->z_stream_.avail_out;
-    state_->bytes_produced_ += bytes_to_write;
+    size_t bytes_to_write = buffer_size - state_->z_stream_.avail_out;
+    LOG_DEBUG("Iteration %d: Deflate with flush=%d status=%d has %d bytes of output", ++iteration, flush, status, bytes_to_write);
+    if (bytes_to_write) {
+      state_->bytes_produced_ += bytes_to_write;
+      produce(reinterpret_cast<char *>(buffer), bytes_to_write);
+    }
+  } while (state_->z_stream_.avail_out == 0 && status != Z_STREAM_END);
 
-    LOG_DEBUG("Iteration %d: Deflate compressed %d bytes to %d bytes, producing output...", iteration, data.size(), bytes_to_write);
-    produce(string(reinterpret_cast<char *>(&buffer[0]), static_cast<size_t>(bytes_to_write)));
-  } while (state_->z_stream_.avail_out == 0);
+  return true;
+}
 
-  if (state_->z_stream_.avail_in != 0) {
-    LOG_ERROR("Inflate finished with data still remaining in the buffer of size '%d'", state_->z_stream_.avail_in);
+void GzipDeflateTransformation::compressData(const char *data, size_t length) {
+  if (length == 0) {
+    return;
   }
-}
 
-void GzipDeflateTransformation::handleInputComplete() {
-  // We will flush out anything that's remaining in the gzip buffer
-  int status = Z_OK;
-  int iteration = 0;
-  const int buffer_size = 1024; // 1024 bytes is usually more than enough for the epilouge
-  unsigned char buffer[buffer_size];
+  if (!state_->z_stream_initialized_) {
+    LOG_ERROR("Unable to deflate output because the z_stream was not initialized.");
+    return;
+  }
 
-  /* Deflate remaining data */
-  do {
-    LOG_DEBUG("Iteration %d: Gzip deflate finalizing.", ++iteration);
-    state_->z_stream_.data_type = Z_ASCII;
-    state_->z_stream_.avail_out = buffer_size;
-    state_->z_stream_.next_out = buffer;
+  state_->z_stream_.data_type = Z_ASCII;
+  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data));
+  state_->z_stream_.avail_in = length;
+  state_->bytes_since_flush_ += length;
+
+  int flush = Z_NO_FLUSH;
+  if (state_->options_.flush_policy_ == FLUSH_EVERY_CHUNK ||
+      (state_->options_.flush_policy_ == FLUSH_AT_WATERMARK && state_->bytes_since_flush_ >= state_->options_.flush_watermark_)) {
+    flush = Z_SYNC_FLUSH;
+    state_->bytes_since_flush_ = 0;
+  }
 
-    status = deflate(&state_->z_stream_, Z_FINISH);
+  LOG_DEBUG("Deflate will compress %d bytes with flush=%d", length, flush);
+  if (!runDeflate(flush)) {
+    return;
+  }
 
-    int bytes_to_write = buffer_size - state_->z_stream_.avail_out;
-    state_->bytes_produced_ += bytes_to_write;
+  if (state_->z_stream_.avail_in != 0) {
+    LOG_ERROR("Deflate finished with data still remaining in the buffer of size '%d'", state_->z_stream_.avail_in);
+  }
+}
 
-    if (status == Z_OK || status == Z_STREAM_END) {
-      LOG_DEBUG("Iteration %d: Gzip deflate finalize had an extra %d bytes to process, status '%d'. Producing output...", iteration, bytes_to_write, status);
-      produce(string(reinterpret_cast<char *>(buffer), static_cast<size_t>(bytes_to_write)));
-    } else if (status != Z_STREAM_END) {
-      LOG_ERROR("Iteration %d: Gzip deflinate finalize produced an error '%d'", iteration, status);
-    }
-  } while (status == Z_OK);
+void GzipDeflateTransformation::handleInputComplete() {
+  // We will flush out anything that's remaining in the gzip buffer along with the epilouge
+  if (state_->z_stream_initialized_) {
+    LOG_DEBUG("Gzip deflate finalizing.");
+    state_->z_stream_.data_type = Z_ASCII;
+    runDeflate(Z_FINISH);
+  }
 
   int64_t bytes_written = setOutputComplete();
   if (state_->bytes_produced_ != bytes_written) {
     LOG_ERROR("Gzip bytes produced sanity check failed, deflated bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
   }
 }
-
-
-
@@ -30,7 +30,9 @@ using std::vector;
 
 namespace {
 const int WINDOW_BITS = 31; // Always use 31 for gzip.
-unsigned int INFLATE_SCALE_FACTOR = 6;
+const int ONE_KB = 1024;
+const size_t DEFAULT_OUTPUT_WINDOW_SIZE = 16 * ONE_KB;
+const int64_t MIN_BYTES_FOR_RATIO_CHECK = 64 * ONE_KB; // the first few bytes of a stream can legitimately inflate a lot.
 }
 
 /**
@@ -39,11 +41,18 @@ unsigned int INFLATE_SCALE_FACTOR = 6;
 struct atscppapi::transformations::GzipInflateTransformationState: noncopyable {
   z_stream z_stream_;
   bool z_stream_initialized_;
-  int64_t bytes_produced_;
   TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  int64_t bytes_consumed_;
+  GzipInflateTransformation::Options options_;
+  vector<char> window_; // decompressed output is drained through this buffer.
+  bool limit_exceeded_;
+  bool output_complete_;
 
-  GzipInflateTransformationState(TransformationPlugin::Type type) :
-        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0) {
+  GzipInflateTransformationState(TransformationPlugin::Type type, const GzipInflateTransformation::Options &options) :
+        z_stream_initialized_(false), transformation_type_(type), bytes_produced_(0), bytes_consumed_(0), options_(options),
+        window_(options.output_window_size_ ? options.output_window_size_ : DEFAULT_OUTPUT_WINDOW_SIZE),
+        limit_exceeded_(false), output_complete_(false) {
 
     memset(&z_stream_, 0, sizeof(z_stream_));
 
@@ -65,17 +74,71 @@ struct atscppapi::transformations::GzipInflateTransformationState: noncopyable {
   };
 };
 
+GzipInflateTransformation::Options::Options()
+  : output_window_size_(DEFAULT_OUTPUT_WINDOW_SIZE), max_output_bytes_(0), max_ratio_(0) {
+}
 
 GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
-  state_ = new GzipInflateTransformationState(type);
+  state_ = new GzipInflateTransformationState(type, Options());
+}
+
+GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new GzipInflateTransformationState(type, options);
+}
+
+GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new GzipInflateTransformationState(getType(), Options());
+}
+
+GzipInflateTransformation::GzipInflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                     const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new GzipInflateTransformationState(getType(), options);
 }
 
 GzipInflateTransformation::~GzipInflateTransformation() {
   delete state_;
 }
 
+bool GzipInflateTransformation::isLimitExceeded() const {
+  return state_->limit_exceeded_;
+}
+
 void GzipInflateTransformation::consume(const string &data) {
-  if (data.size() == 0) {
+  decompressData(data.data(), data.length());
+}
+
+void GzipInflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    decompressData(data, length);
+  }
+}
+
+bool GzipInflateTransformation::checkLimits() {
+  const GzipInflateTransformation::Options &options = state_->options_;
+  if (options.max_output_bytes_ && (state_->bytes_produced_ > options.max_output_bytes_)) {
+    LOG_ERROR("Gzip inflate aborting, inflated bytes = %d exceeds the limit of %d bytes", state_->bytes_produced_,
+        options.max_output_bytes_);
+    state_->limit_exceeded_ = true;
+  } else if (options.max_ratio_ && (state_->bytes_produced_ >= MIN_BYTES_FOR_RATIO_CHECK) &&
+             (state_->bytes_produced_ > static_cast<int64_t>(options.max_ratio_) * state_->bytes_consumed_)) {
+    LOG_ERROR("Gzip inflate aborting, inflated bytes = %d from %d compressed bytes exceeds the ratio limit of %d",
+        state_->bytes_produced_, state_->bytes_consumed_, options.max_ratio_);
+    state_->limit_exceeded_ = true;
+  }
+
+  if (state_->limit_exceeded_ && !state_->output_complete_) {
+    // a cut off body must not look complete to the client or the cache, so the transformation fails
+    state_->output_complete_ = true;
+    abort();
+  }
+  return !state_->limit_exceeded_;
+}
+
+void GzipInflateTransformation::decompressData(const char *data, size_t length) {
+  if (length == 0 || state_->limit_exceeded_) {
     return;
   }
 
@@ -86,41 +149,56 @@ void GzipInflateTransformation::consume(const string &data) {
 
   int err = Z_OK;
   int iteration = 0;
-  int inflate_block_size = INFLATE_SCALE_FACTOR * data.size();
-  vector<char> buffer(inflate_block_size);
+  size_t window_size = state_->window_.size();
+  const GzipInflateTransformation::Options &options = state_->options_;
 
   // Setup the compressed input
-  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data.c_str()));
-  state_->z_stream_.avail_in = data.length();
+  state_->z_stream_.next_in = reinterpret_cast<unsigned char *>(const_cast<char *>(data));
+  state_->z_stream_.avail_in = length;
 
-  // Loop while we have more data to inflate
-  while (state_->z_stream_.avail_in > 0 && err != Z_STREAM_END) {
+  // Loop while we have more data to inflate or the window was filled and there may be more output pending.
+  do {
     LOG_DEBUG("Iteration %d: Gzip has %d bytes to inflate", ++iteration, state_->z_stream_.avail_in);
 
-    // Setup where the decompressed output will go.
-    state_->z_stream_.next_out = reinterpret_cast<unsigned char *>(&buffer[0]);
-    state_->z_stream_.avail_out = inflate_block_size;
+    // Setup where the decompressed output will go, never more than the output limit allows.
+    size_t avail_out = window_size;
+    if (options.max_output_bytes_ && (options.max_output_bytes_ - state_->bytes_produced_ < static_cast<int64_t>(avail_out))) {
+      avail_out = static_cast<size_t>(options.max_output_bytes_ - state_->bytes_produced_ + 1);
+    }
+    state_->z_stream_.next_out = reinterpret_cast<unsigned char *>(&state_->window_[0]);
+    state_->z_stream_.avail_out = avail_out;
 
     /* Uncompress */
+    unsigned int avail_in = state_->z_stream_.avail_in;
     err = inflate(&state_->z_stream_, Z_SYNC_FLUSH);
 
-    if (err != Z_OK && err != Z_STREAM_END) {
+    if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
      LOG_ERROR("Iteration %d: Inflate failed with error '%d'", iteration, err);
      return;
     }
+    state_->bytes_consumed_ += (avail_in - state_->z_stream_.avail_in);
 
-    LOG_DEBUG("Iteration %d: Gzip inflated a total of %d bytes, producingOutput...", iteration, (inflate_block_size - state_->z_stream_.avail_out));
-    produce(string(&buffer[0], (inflate_block_size - state_->z_stream_.avail_out)));
-    state_->bytes_produced_ += (inflate_block_size - state_->z_stream_.avail_out);
-  }
+    size_t bytes_inflated = avail_out - state_->z_stream_.avail_out;
+    state_->bytes_produced_ += bytes_inflated;
+    if (!checkLimits()) {
+      return;
+    }
+
+    LOG_DEBUG("Iteration %d: Gzip inflated a total of %d bytes, producingOutput...", iteration, bytes_inflated);
+    if (bytes_inflated) {
+      produce(&state_->window_[0], bytes_inflated);
+    }
+  } while ((state_->z_stream_.avail_in > 0 || state_->z_stream_.avail_out == 0) && err == Z_OK);
 }
 
 void GzipInflateTransformation::handleInputComplete() {
+  if (state_->output_complete_) {
+    return;
+  }
+  state_->output_complete_ = true;
+
   int64_t bytes_written = setOutputComplete();
   if (state_->bytes_produced_ != bytes_written) {
     LOG_ERROR("Gzip bytes produced sanity check failed, inflated bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
   }
 }
-
-
-
@@ -17,10 +17,15 @@
  */
 #include "atscppapi/Headers.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "logging_internal.h"
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
+#include "atscppapi/WellKnownHeader.h"
 #include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <tr1/unordered_set>
 
 using atscppapi::Headers;
 using std::string;
@@ -29,6 +34,9 @@ using std::pair;
 using std::make_pair;
 using std::ostringstream;
 using std::map;
+using std::tr1::unordered_set;
+using std::vector;
+using atscppapi::StringView;
 
 namespace atscppapi {
 
@@ -41,15 +49,21 @@ namespace {
 /**
  * @private
  */
-struct HeadersState: noncopyable {
+struct HeadersState: noncopyable, ArenaAllocated {
   Headers::Type type_;
   TSMBuffer hdr_buf_;
   TSMLoc hdr_loc_;
-  InitializableValue<Headers::NameValuesMap> name_values_map_;
+  InitializableValue<Headers::NameValuesMap> name_values_map_; // initialized once every header has been read.
+  unordered_set<string, CaseInsensitiveStringHash, CaseInsensitiveStringEqual> looked_up_names_; // headers read individually before that.
   bool detached_;
   InitializableValue<Headers::RequestCookieMap> request_cookies_;
+  bool request_cookies_malformed_; // parsing request_cookies_ stopped at a malformed cookie.
   InitializableValue<list<Headers::ResponseCookie> > response_cookies_;
-  HeadersState(Headers::Type type) : type_(type), hdr_buf_(NULL), hdr_loc_(NULL), detached_(false) { }
+  bool cookie_edits_pending_; // cookie edits not written to the marshal buffer yet, see Headers::flushCookies()
+  list<Headers::ResponseCookie> added_response_cookies_; // pending, appended as Set-Cookie headers
+  vector<string> removed_response_cookies_; // pending, names whose Set-Cookie headers are erased
+  HeadersState(Headers::Type type) : type_(type), hdr_buf_(NULL), hdr_loc_(NULL), detached_(false),
+                                        request_cookies_malformed_(false), cookie_edits_pending_(false) { }
 };
 
 }
@@ -108,7 +122,50 @@ void extractHeaderFieldValues(TSMBuffer hdr_buf, TSMLoc hdr_loc, TSMLoc field_lo
 
 }
 
+bool Headers::checkHeaderHandles() const {
+  if (state_->detached_ || ((state_->hdr_buf_ != NULL) && (state_->hdr_loc_ != NULL))) {
+    return true;
+  }
+  LOG_ERROR("TS header handles not set; hdr_buf %p, hdr_loc %p", state_->hdr_buf_, state_->hdr_loc_);
+  return false;
+}
+
+Headers::NameValuesMap::iterator Headers::lookupHeader(const string &key) const {
+  flushPendingCookieEdits();
+  NameValuesMap &name_values_map = state_->name_values_map_.getValueRef();
+  if (state_->detached_ || state_->name_values_map_.isInitialized()) {
+    return name_values_map.find(key);
+  }
+  if (!checkHeaderHandles()) {
+    return name_values_map.end();
+  }
+  if (TransactionDataCachingPolicy::isEnabled() && state_->looked_up_names_.count(key)) {
+    return name_values_map.find(key);
+  }
+
+  // Only this one header is read from the marshal buffer, including any duplicate fields.
+  name_values_map.erase(key);
+  NameValuesMap::iterator iter = name_values_map.end();
+  TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, key.c_str(), key.length());
+  while (field_loc) {
+    if (iter == name_values_map.end()) {
+      int name_len;
+      const char *name = TSMimeHdrFieldNameGet(state_->hdr_buf_, state_->hdr_loc_, field_loc, &name_len);
+      string field_name = (name && (name_len > 0)) ? string(name, name_len) : key;
+      iter = name_values_map.insert(NameValuesMap::value_type(field_name, EMPTY_VALUE_LIST)).first;
+    }
+    extractHeaderFieldValues(state_->hdr_buf_, state_->hdr_loc_, field_loc, key, iter->second);
+    TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    field_loc = next_field_loc;
+  }
+  state_->looked_up_names_.insert(key);
+  LOG_DEBUG("Looked up header [%s], %s", key.c_str(), (iter == name_values_map.end()) ? "not present" : "present");
+  return iter;
+}
+
 bool Headers::checkAndInitHeaders() const {
+  flushPendingCookieEdits();
   if (state_->name_values_map_.isInitialized()) {
     return true;
   } else if ((state_->hdr_buf_ == NULL) || (state_->hdr_loc_ == NULL)) {
@@ -117,6 +174,7 @@ bool Headers::checkAndInitHeaders() const {
     return false;
   }
   state_->name_values_map_.getValueRef().clear();
+  state_->looked_up_names_.clear();
   string key;
   const char *name, *value;
   int name_len, num_values, value_len;
@@ -148,16 +206,10 @@ Headers::~Headers() {
 }
 
 Headers::size_type Headers::erase(const string &k) {
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return 0;
   }
-  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator()(k, "Cookie") == 0)) {
-    state_->request_cookies_.getValueRef().clear();
-    state_->request_cookies_.setInitialized(false);
-  } else if ((state_->type_ == TYPE_RESPONSE) && (CaseInsensitiveStringComparator()(k, "Set-Cookie") == 0)) {
-    state_->response_cookies_.getValueRef().clear();
-    state_->response_cookies_.setInitialized(false);
-  }
+  prepareCookieUpdate(k, true);
   LOG_DEBUG("Erasing header [%s]", k.c_str());
   return doBasicErase(k);
 }
@@ -171,6 +223,7 @@ Headers::size_type Headers::doBasicErase(const string &k) {
       TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
       field_loc = next_field_loc;
     }
+    state_->looked_up_names_.insert(k);
   }
   return state_->name_values_map_.getValueRef().erase(k);
 }
@@ -192,18 +245,13 @@ Headers::const_iterator Headers::set(const string &key, const string &val) {
 }
 
 Headers::const_iterator Headers::append(const pair<string, list<string> > &pair) {
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return state_->name_values_map_.getValueRef().end();
   }
-  if ((state_->type_ == TYPE_REQUEST) && (CaseInsensitiveStringComparator()(pair.first, "Cookie") == 0)) {
-    state_->request_cookies_.getValueRef().clear();
-    state_->request_cookies_.setInitialized(false);
-  } else if ((state_->type_ == TYPE_RESPONSE) &&
-             (CaseInsensitiveStringComparator()(pair.first, "Set-Cookie") == 0)) {
-    state_->response_cookies_.getValueRef().clear();
-    state_->response_cookies_.setInitialized(false);
-  }
-  return doBasicAppend(pair);
+  int first_new_cookie_value = prepareCookieUpdate(pair.first, false);
+  const_iterator iter = doBasicAppend(pair);
+  finishCookieUpdate(first_new_cookie_value);
+  return iter;
 }
 
 Headers::const_iterator Headers::doBasicAppend(const pair<string, list<string> > &pair) {
@@ -248,17 +296,294 @@ Headers::const_iterator Headers::doBasicAppend(const pair<string, list<string> >
       value_list.clear();
     }
     extractHeaderFieldValues(state_->hdr_buf_, state_->hdr_loc_, field_loc, header_name, value_list);
+    state_->looked_up_names_.insert(header_name);
     TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
     LOG_DEBUG("Header [%s] has value(s) [%s]", header_name.c_str(), getJoinedValues(value_list).c_str());
   }
   return insert_result.first;
 }
 
-string Headers::getJoinedValues(const string &key, char value_delimiter) {
-  checkAndInitHeaders();
+Headers::Batch &Headers::Batch::add(OperationType type, const string &key, const list<string> *val) {
+  operations_.push_back(Operation());
+  Operation &operation = operations_.back();
+  operation.type_ = type;
+  operation.name_ = key;
+  if (val) {
+    operation.values_ = *val;
+  }
+  return *this;
+}
+
+Headers::Batch &Headers::Batch::set(const string &key, const string &val) {
+  return set(key, list<string>(1, val));
+}
+
+Headers::Batch &Headers::Batch::set(const string &key, const list<string> &val) {
+  return add(OPERATION_SET, key, &val);
+}
+
+Headers::Batch &Headers::Batch::append(const string &key, const string &val) {
+  return append(key, list<string>(1, val));
+}
+
+Headers::Batch &Headers::Batch::append(const string &key, const list<string> &val) {
+  return add(OPERATION_APPEND, key, &val);
+}
+
+Headers::Batch &Headers::Batch::erase(const string &key) {
+  return add(OPERATION_ERASE, key, NULL);
+}
+
+Headers::Batch &Headers::Batch::set(WellKnownHeader header, const string &val) {
+  return set(getWellKnownHeaderName(header).str(), val);
+}
+
+Headers::Batch &Headers::Batch::append(WellKnownHeader header, const string &val) {
+  return append(getWellKnownHeaderName(header).str(), val);
+}
+
+Headers::Batch &Headers::Batch::erase(WellKnownHeader header) {
+  return erase(getWellKnownHeaderName(header).str());
+}
 
+namespace {
+
+/**
+ * The combined effect of every edit of a batch to one header: whether the existing values survive,
+ * and which values are added after them.
+ */
+struct HeaderEdit {
+  const string *name_;
+  bool keep_existing_;
+  list<string> values_;
+  HeaderEdit(const string &name) : name_(&name), keep_existing_(true) { }
+};
+
+}
+
+bool Headers::apply(const Batch &batch) {
+  if (!checkHeaderHandles()) {
+    return false;
+  }
+  // batches are expected to be small, so grouping edits by header is a linear search
+  CaseInsensitiveStringComparator comparator;
+  list<HeaderEdit> edits;
+  for (vector<Batch::Operation>::const_iterator iter = batch.operations_.begin(); iter != batch.operations_.end();
+       ++iter) {
+    list<HeaderEdit>::iterator edit = edits.begin();
+    while ((edit != edits.end()) && !comparator.equals(*edit->name_, iter->name_)) {
+      ++edit;
+    }
+    if (edit == edits.end()) {
+      edit = edits.insert(edits.end(), HeaderEdit(iter->name_));
+    }
+    if (iter->type_ != Batch::OPERATION_APPEND) {
+      edit->keep_existing_ = false;
+      edit->values_.clear();
+    }
+    edit->values_.insert(edit->values_.end(), iter->values_.begin(), iter->values_.end());
+  }
+
+  NameValuesMap &name_values_map = state_->name_values_map_.getValueRef();
+  for (list<HeaderEdit>::iterator edit = edits.begin(); edit != edits.end(); ++edit) {
+    const string &header_name = *edit->name_;
+    int first_new_cookie_value = prepareCookieUpdate(header_name, !edit->keep_existing_);
+    if (state_->detached_) {
+      if (!edit->keep_existing_) {
+        name_values_map.erase(header_name);
+      }
+      if (!edit->values_.empty()) {
+        list<string> &value_list = name_values_map.insert(make_pair(header_name, EMPTY_VALUE_LIST)).first->second;
+        value_list.splice(value_list.end(), edit->values_);
+      }
+      finishCookieUpdate(first_new_cookie_value);
+      continue;
+    }
+
+    TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, header_name.c_str(),
+                                          header_name.length());
+    if (!edit->keep_existing_) {
+      while (field_loc) {
+        TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        TSMimeHdrFieldDestroy(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        field_loc = next_field_loc;
+      }
+    }
+    name_values_map.erase(header_name);
+    state_->looked_up_names_.insert(header_name);
+    if (!edit->values_.empty()) {
+      if (!field_loc) {
+        TSMimeHdrFieldCreate(state_->hdr_buf_, state_->hdr_loc_, &field_loc);
+        TSMimeHdrFieldNameSet(state_->hdr_buf_, state_->hdr_loc_, field_loc, header_name.c_str(),
+                              header_name.length());
+        TSMimeHdrFieldAppend(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+      }
+      for (list<string>::const_iterator iter = edit->values_.begin(); iter != edit->values_.end(); ++iter) {
+        TSMimeHdrFieldValueStringInsert(state_->hdr_buf_, state_->hdr_loc_, field_loc, APPEND_INDEX, iter->c_str(),
+                                        iter->length());
+      }
+    }
+    // the cache is refreshed once per header from the marshal buffer, see doBasicAppend() for why
+    if (field_loc) {
+      list<string> &value_list = name_values_map.insert(make_pair(header_name, EMPTY_VALUE_LIST)).first->second;
+      while (field_loc) {
+        extractHeaderFieldValues(state_->hdr_buf_, state_->hdr_loc_, field_loc, header_name, value_list);
+        TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        field_loc = next_field_loc;
+      }
+    }
+    finishCookieUpdate(first_new_cookie_value);
+    LOG_DEBUG("Applied batched edits to header [%s]", header_name.c_str());
+  }
+  return true;
+}
+
+namespace {
+
+/** Views of fields without values point here, just as extractHeaderFieldValues() adds an empty string for them. */
+const char EMPTY_VALUE[] = "";
+
+/**
+ * Adds views of the values of a field to values, or if values is NULL, finds the view at index.
+ *
+ * @return Number of values in the field.
+ */
+int getHeaderFieldValueViews(TSMBuffer hdr_buf, TSMLoc hdr_loc, TSMLoc field_loc, vector<StringView> *values,
+                             int index, StringView *value_at_index) {
+  int num_values = TSMimeHdrFieldValuesCount(hdr_buf, hdr_loc, field_loc);
+  if (num_values <= 0) {
+    if (values) {
+      values->push_back(StringView(EMPTY_VALUE, 0));
+    } else if (index == 0) {
+      *value_at_index = StringView(EMPTY_VALUE, 0);
+    }
+    return 1;
+  }
+  const char *value;
+  int value_len;
+  for (int i = 0; i < num_values; ++i) {
+    if (!values && (i != index)) {
+      continue;
+    }
+    value = TSMimeHdrFieldValueStringGet(hdr_buf, hdr_loc, field_loc, i, &value_len);
+    StringView view((value && (value_len > 0)) ? value : EMPTY_VALUE, (value && (value_len > 0)) ? value_len : 0);
+    if (values) {
+      values->push_back(view);
+    } else {
+      *value_at_index = view;
+    }
+  }
+  return num_values;
+}
+
+}
+
+StringView Headers::getValueView(const string &key, int index) const {
+  return findValueView(key.data(), key.length(), index);
+}
+
+StringView Headers::getValueView(WellKnownHeader header, int index) const {
+  StringView name = getWellKnownHeaderName(header);
+  return findValueView(name.data(), name.length(), index);
+}
+
+size_t Headers::getValueViews(const string &key, vector<StringView> &values) const {
+  return findValueViews(key.data(), key.length(), values);
+}
+
+size_t Headers::getValueViews(WellKnownHeader header, vector<StringView> &values) const {
+  StringView name = getWellKnownHeaderName(header);
+  return findValueViews(name.data(), name.length(), values);
+}
+
+StringView Headers::findValueView(const char *name, size_t name_length, int index) const {
+  StringView value;
+  if (!name || (index < 0) || !checkHeaderHandles()) {
+    return value;
+  }
+  flushPendingCookieEdits();
+  if (state_->detached_) {
+    NameValuesMap::iterator iter = state_->name_values_map_.getValueRef().find(string(name, name_length));
+    if (iter != state_->name_values_map_.getValueRef().end()) {
+      for (list<string>::const_iterator value_iter = iter->second.begin(); value_iter != iter->second.end();
+           ++value_iter, --index) {
+        if (index == 0) {
+          return StringView(*value_iter);
+        }
+      }
+    }
+    return value;
+  }
+  TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, name, name_length);
+  while (field_loc) {
+    index -= getHeaderFieldValueViews(state_->hdr_buf_, state_->hdr_loc_, field_loc, NULL, index, &value);
+    TSMLoc next_field_loc = (value.isNull() && (index >= 0)) ?
+      TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc) : NULL;
+    TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    field_loc = next_field_loc;
+  }
+  return value;
+}
+
+size_t Headers::findValueViews(const char *name, size_t name_length, vector<StringView> &values) const {
+  size_t initial_size = values.size();
+  if (!name || !checkHeaderHandles()) {
+    return 0;
+  }
+  flushPendingCookieEdits();
+  if (state_->detached_) {
+    NameValuesMap::iterator iter = state_->name_values_map_.getValueRef().find(string(name, name_length));
+    if (iter != state_->name_values_map_.getValueRef().end()) {
+      for (list<string>::const_iterator value_iter = iter->second.begin(); value_iter != iter->second.end();
+           ++value_iter) {
+        values.push_back(StringView(*value_iter));
+      }
+    }
+    return values.size() - initial_size;
+  }
+  TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, name, name_length);
+  while (field_loc) {
+    getHeaderFieldValueViews(state_->hdr_buf_, state_->hdr_loc_, field_loc, &values, 0, NULL);
+    TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    field_loc = next_field_loc;
+  }
+  return values.size() - initial_size;
+}
+
+size_t Headers::getNameViews(vector<StringView> &names) const {
+  size_t initial_size = names.size();
+  if (!checkHeaderHandles()) {
+    return 0;
+  }
+  flushPendingCookieEdits();
+  if (state_->detached_) {
+    NameValuesMap &name_values_map = state_->name_values_map_.getValueRef();
+    for (NameValuesMap::iterator iter = name_values_map.begin(); iter != name_values_map.end(); ++iter) {
+      names.push_back(StringView(iter->first));
+    }
+    return names.size() - initial_size;
+  }
+  const char *name;
+  int name_len;
+  TSMLoc field_loc = TSMimeHdrFieldGet(state_->hdr_buf_, state_->hdr_loc_, FIRST_INDEX);
+  while (field_loc) {
+    name = TSMimeHdrFieldNameGet(state_->hdr_buf_, state_->hdr_loc_, field_loc, &name_len);
+    if (name && (name_len > 0)) {
+      names.push_back(StringView(name, name_len));
+    }
+    TSMLoc next_field_loc = TSMimeHdrFieldNext(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    field_loc = next_field_loc;
+  }
+  return names.size() - initial_size;
+}
+
+string Headers::getJoinedValues(const string &key, char value_delimiter) {
   string ret;
-  Headers::NameValuesMap::iterator key_iter = state_->name_values_map_.getValueRef().find(key);
+  Headers::NameValuesMap::iterator key_iter = lookupHeader(key);
   if (key_iter == state_->name_values_map_.getValueRef().end()) {
     LOG_DEBUG("Header [%s] not present", key.c_str());
     return ret;
@@ -266,6 +591,19 @@ string Headers::getJoinedValues(const string &key, char value_delimiter) {
   return getJoinedValues(key_iter->second);
 }
 
+string Headers::getJoinedValues(WellKnownHeader header, char value_delimiter) {
+  string ret;
+  vector<StringView> values;
+  getValueViews(header, values);
+  for (vector<StringView>::const_iterator iter = values.begin(); iter != values.end(); ++iter) {
+    if (iter != values.begin()) {
+      ret += value_delimiter;
+    }
+    ret.append(iter->data(), iter->length());
+  }
+  return ret;
+}
+
 string Headers::getJoinedValues(const list<string> &values, char delimiter) {
   string ret;
   ret.reserve(128);
@@ -289,6 +627,18 @@ Headers::const_iterator Headers::append(const string &key, const string &val) {
   return append(make_pair(key,values));
 }
 
+Headers::const_iterator Headers::append(WellKnownHeader header, const string &val) {
+  return append(getWellKnownHeaderName(header).str(), val);
+}
+
+Headers::const_iterator Headers::set(WellKnownHeader header, const string &val) {
+  return set(getWellKnownHeaderName(header).str(), val);
+}
+
+Headers::size_type Headers::erase(WellKnownHeader header) {
+  return erase(getWellKnownHeaderName(header).str());
+}
+
 Headers::const_iterator Headers::begin() const {
   checkAndInitHeaders();
   return state_->name_values_map_.getValueRef().begin();
@@ -308,13 +658,190 @@ Headers::const_reverse_iterator Headers::rend() const {
 }
 
 Headers::const_iterator Headers::find(const string &k) const {
-  checkAndInitHeaders();
-  return state_->name_values_map_.getValueRef().find(k);
+  return lookupHeader(k);
 }
 
 Headers::size_type Headers::count(const string &key) const {
-  checkAndInitHeaders();
-  return state_->name_values_map_.getValueRef().count(key);
+  return (lookupHeader(key) == state_->name_values_map_.getValueRef().end()) ? 0 : 1;
+}
+
+Headers::const_iterator Headers::find(WellKnownHeader header) const {
+  return lookupHeader(getWellKnownHeaderName(header).str());
+}
+
+Headers::size_type Headers::count(WellKnownHeader header) const {
+  return getValueView(header).isNull() ? 0 : 1;
+}
+
+void Headers::resetCaches() {
+  state_->name_values_map_.getValueRef().clear();
+  state_->name_values_map_.setInitialized(false);
+  state_->looked_up_names_.clear();
+  state_->request_cookies_.getValueRef().clear();
+  state_->request_cookies_.setInitialized(false);
+  state_->response_cookies_.getValueRef().clear();
+  state_->response_cookies_.setInitialized(false);
+  state_->cookie_edits_pending_ = false; // they were made to the headers read before
+  state_->added_response_cookies_.clear();
+  state_->removed_response_cookies_.clear();
+}
+
+size_t Headers::copyFrom(const Headers &other, HeaderFilter filter, void *filter_data) {
+  if (&other == this) {
+    return 0;
+  }
+  flushPendingCookieEdits();
+  other.flushPendingCookieEdits();
+  if (!state_->detached_ && (!state_->hdr_buf_ || !state_->hdr_loc_)) {
+    LOG_DEBUG("Copying headers into a detached object");
+    initDetached();
+  }
+  if (!other.checkHeaderHandles()) {
+    return 0;
+  }
+
+  if (state_->detached_ || other.state_->detached_) {
+    // at least one side has no marshal buffer, so copy through the cached values
+    size_t num_copied = 0;
+    for (const_iterator iter = other.begin(), iter_end = other.end(); iter != iter_end; ++iter) {
+      if (!filter || filter(StringView(iter->first), filter_data)) {
+        set(iter->first, iter->second);
+        ++num_copied;
+      }
+    }
+    return num_copied;
+  }
+
+  TSMBuffer src_buf = other.state_->hdr_buf_;
+  TSMLoc src_loc = other.state_->hdr_loc_;
+  if (!filter && (TSMimeHdrFieldsCount(state_->hdr_buf_, state_->hdr_loc_) == 0)) {
+    if (TSMimeHdrCopy(state_->hdr_buf_, state_->hdr_loc_, src_buf, src_loc) != TS_SUCCESS) {
+      LOG_ERROR("Failed to copy headers; hdr_buf %p, hdr_loc %p, src hdr_buf %p, src hdr_loc %p", state_->hdr_buf_,
+                state_->hdr_loc_, src_buf, src_loc);
+      return 0;
+    }
+    resetCaches();
+    return TSMimeHdrFieldsCount(state_->hdr_buf_, state_->hdr_loc_);
+  }
+
+  // duplicate fields are all copied, so a name's existing fields must only be dropped the first time
+  vector<StringView> copied_names;
+  const char *name;
+  int name_len;
+  TSMLoc field_loc = TSMimeHdrFieldGet(src_buf, src_loc, FIRST_INDEX);
+  while (field_loc) {
+    name = TSMimeHdrFieldNameGet(src_buf, src_loc, field_loc, &name_len);
+    StringView field_name(name, (name && (name_len > 0)) ? name_len : 0);
+    if (!field_name.empty() && (!filter || filter(field_name, filter_data))) {
+      vector<StringView>::const_iterator copied_iter = copied_names.begin();
+      while ((copied_iter != copied_names.end()) && !copied_iter->caseEquals(field_name)) {
+        ++copied_iter;
+      }
+      if (copied_iter == copied_names.end()) {
+        TSMLoc dest_field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, name, name_len);
+        while (dest_field_loc) {
+          TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, dest_field_loc);
+          TSMimeHdrFieldDestroy(state_->hdr_buf_, state_->hdr_loc_, dest_field_loc);
+          TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, dest_field_loc);
+          dest_field_loc = next_field_loc;
+        }
+        copied_names.push_back(field_name);
+      }
+      TSMLoc new_field_loc;
+      if (TSMimeHdrFieldCreate(state_->hdr_buf_, state_->hdr_loc_, &new_field_loc) == TS_SUCCESS) {
+        TSMimeHdrFieldCopy(state_->hdr_buf_, state_->hdr_loc_, new_field_loc, src_buf, src_loc, field_loc);
+        TSMimeHdrFieldAppend(state_->hdr_buf_, state_->hdr_loc_, new_field_loc);
+        TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, new_field_loc);
+      } else {
+        LOG_ERROR("Failed to create field for header [%.*s]", name_len, name);
+      }
+    }
+    TSMLoc next_field_loc = TSMimeHdrFieldNext(src_buf, src_loc, field_loc);
+    TSHandleMLocRelease(src_buf, src_loc, field_loc);
+    field_loc = next_field_loc;
+  }
+  if (!copied_names.empty()) {
+    resetCaches(); // the fields changed behind the cache's back, so it's simply read again when needed
+  }
+  LOG_DEBUG("Copied %d headers", static_cast<int>(copied_names.size()));
+  return copied_names.size();
+}
+
+size_t Headers::diff(const Headers &before, const Headers &after, vector<HeaderChange> &changes) {
+  size_t initial_size = changes.size();
+  const_iterator after_end = after.end();
+  for (const_iterator iter = before.begin(), iter_end = before.end(); iter != iter_end; ++iter) {
+    const_iterator after_iter = after.find(iter->first);
+    if (after_iter == after_end) {
+      changes.push_back(HeaderChange(HeaderChange::HEADER_REMOVED, iter->first));
+    } else if (after_iter->second != iter->second) {
+      changes.push_back(HeaderChange(HeaderChange::HEADER_MODIFIED, iter->first));
+    }
+  }
+  for (const_iterator iter = after.begin(); iter != after_end; ++iter) {
+    if (before.find(iter->first) == before.end()) {
+      changes.push_back(HeaderChange(HeaderChange::HEADER_ADDED, iter->first));
+    }
+  }
+  return changes.size() - initial_size;
+}
+
+namespace {
+
+const char HEADER_NAME_VALUE_SEPARATOR[] = ": ";
+const size_t HEADER_NAME_VALUE_SEPARATOR_LENGTH = sizeof(HEADER_NAME_VALUE_SEPARATOR) - 1;
+const char HEADER_LINE_END[] = "\r\n";
+const size_t HEADER_LINE_END_LENGTH = sizeof(HEADER_LINE_END) - 1;
+
+inline char *copyBytes(char *dest, const char *src, size_t length) {
+  memcpy(dest, src, length);
+  return dest + length;
+}
+
+}
+
+size_t Headers::getSerializedSize() const {
+  size_t size = 0;
+  for (const_iterator iter = begin(), iter_end = end(); iter != iter_end; ++iter) {
+    size += iter->first.length() + HEADER_NAME_VALUE_SEPARATOR_LENGTH + HEADER_LINE_END_LENGTH;
+    for (list<string>::const_iterator value_iter = iter->second.begin(); value_iter != iter->second.end();
+         ++value_iter) {
+      if (value_iter != iter->second.begin()) {
+        ++size; // delimiter
+      }
+      size += value_iter->length();
+    }
+  }
+  return size;
+}
+
+size_t Headers::serialize(char *buffer, size_t buffer_length) const {
+  if (!buffer || (buffer_length < getSerializedSize())) {
+    LOG_ERROR("Buffer %p of length %zu too small for headers", buffer, buffer_length);
+    return 0;
+  }
+  char *pos = buffer;
+  for (const_iterator iter = begin(), iter_end = end(); iter != iter_end; ++iter) {
+    pos = copyBytes(pos, iter->first.data(), iter->first.length());
+    pos = copyBytes(pos, HEADER_NAME_VALUE_SEPARATOR, HEADER_NAME_VALUE_SEPARATOR_LENGTH);
+    for (list<string>::const_iterator value_iter = iter->second.begin(); value_iter != iter->second.end();
+         ++value_iter) {
+      if (value_iter != iter->second.begin()) {
+        *pos++ = ',';
+      }
+      pos = copyBytes(pos, value_iter->data(), value_iter->length());
+    }
+    pos = copyBytes(pos, HEADER_LINE_END, HEADER_LINE_END_LENGTH);
+  }
+  return pos - buffer;
+}
+
+void Headers::serialize(string &output) const {
+  size_t initial_length = output.length();
+  output.resize(initial_length + getSerializedSize());
+  size_t written = (output.length() > initial_length) ?
+    serialize(&output[initial_length], output.length() - initial_length) : 0;
+  output.resize(initial_length + written);
 }
 
 bool Headers::empty() const {
@@ -335,18 +862,11 @@ namespace {
 
 const list<string> EMPTY_REQUEST_COOKIE_VALUE_LIST;
 
-void stripEnclosingWhitespace(string &token) {
-  size_t token_size = token.size(), i;
-  for (i = 0; (i < token_size) && std::isspace(token[i]); ++i);
-  if (i) {
-    token.erase(0, i);
-    token_size -= i;
-  }
-  // can't use >= 0 here as we size_t will never go negative
-  for (i = token_size; (i > 0) && std::isspace(token[i - 1]); --i);
-  if (token_size - i) {
-    token.resize(i);
-  }
+StringView stripEnclosingWhitespace(const StringView &token) {
+  size_t start = 0, end = token.length();
+  for (; (start < end) && std::isspace(static_cast<unsigned char>(token[start])); ++start);
+  for (; (end > start) && std::isspace(static_cast<unsigned char>(token[end - 1])); --end);
+  return token.substr(start, end - start);
 }
 
 void addCookieToMap(Headers::RequestCookieMap &cookie_map, const string &name, const string &value) {
@@ -361,61 +881,155 @@ void addCookieToMap(Headers::RequestCookieMap &cookie_map, const string &name, c
 
 }
 
+int Headers::prepareCookieUpdate(const string &key, bool erase_existing) {
+  flushPendingCookieEdits(); // the header is edited on top of what the cookie edits made of it
+  if ((state_->type_ == TYPE_RESPONSE) && isWellKnownHeader(key, HEADER_SET_COOKIE)) {
+    state_->response_cookies_.getValueRef().clear();
+    state_->response_cookies_.setInitialized(false);
+  } else if ((state_->type_ == TYPE_REQUEST) && isWellKnownHeader(key, HEADER_COOKIE) &&
+             state_->request_cookies_.isInitialized()) {
+    int num_fields = 0;
+    int num_values = erase_existing ? 0 : countValues(key, num_fields);
+    // appends go into the first field, so with several fields the new values are not last and all are reparsed
+    if (erase_existing || (num_fields > 1)) {
+      state_->request_cookies_.getValueRef().clear();
+      state_->request_cookies_malformed_ = false;
+      return 0;
+    }
+    // a full parse stops at a malformed cookie too, so nothing appended after one is ever parsed
+    return state_->request_cookies_malformed_ ? -1 : num_values;
+  }
+  return -1;
+}
+
+void Headers::finishCookieUpdate(int first_new_value) {
+  if (first_new_value < 0) {
+    return;
+  }
+  RequestCookieIterator iter(*this, first_new_value);
+  RequestCookieView cookie;
+  while (iter.next(cookie)) {
+    addCookieToMap(state_->request_cookies_, cookie.name_.str(), cookie.value_.str());
+  }
+  state_->request_cookies_malformed_ = iter.isMalformed();
+}
+
+int Headers::countValues(const string &key, int &num_fields) const {
+  if (state_->detached_) {
+    NameValuesMap::iterator iter = state_->name_values_map_.getValueRef().find(key);
+    if (iter == state_->name_values_map_.getValueRef().end()) {
+      num_fields = 0;
+      return 0;
+    }
+    num_fields = 1; // a detached header keeps one value list, so appends always come last
+    return static_cast<int>(iter->second.size());
+  }
+  int count = 0;
+  num_fields = 0;
+  TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, key.c_str(), key.length());
+  while (field_loc) {
+    ++num_fields;
+    int num_values = TSMimeHdrFieldValuesCount(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    count += (num_values > 0) ? num_values : 1; // see extractHeaderFieldValues()
+    TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    field_loc = next_field_loc;
+  }
+  return count;
+}
+
+Headers::RequestCookieIterator::RequestCookieIterator(const Headers &headers)
+  : headers_(&headers), value_index_(0), pos_(0), done_(false), malformed_(false) {
+  init();
+}
+
+Headers::RequestCookieIterator::RequestCookieIterator(const Headers &headers, int first_value_index)
+  : headers_(&headers), value_index_(first_value_index), pos_(0), done_(false), malformed_(false) {
+  init();
+}
+
+void Headers::RequestCookieIterator::init() {
+  if (headers_->getType() != Headers::TYPE_REQUEST) {
+    LOG_ERROR("Object is not of type request. No cookies to iterate");
+    done_ = true;
+    return;
+  }
+  headers_->flushPendingCookieEdits();
+}
+
+bool Headers::RequestCookieIterator::next(RequestCookieView &cookie) {
+  while (!done_) {
+    if (value_.isNull() || (pos_ >= value_.length())) {
+      value_ = headers_->getValueView(HEADER_COOKIE, value_index_++);
+      pos_ = 0;
+      done_ = value_.isNull();
+      continue;
+    }
+    const char *cookie_kv = value_.data(); // cookie key-value pairs
+    size_t cookie_kv_size = value_.length();
+    size_t start_pos = pos_, end_pos;
+    for (end_pos = start_pos;
+         (end_pos < cookie_kv_size) && (cookie_kv[end_pos] != '=') && (cookie_kv[end_pos] != ';'); ++end_pos);
+    if ((end_pos == cookie_kv_size) || (cookie_kv[end_pos] == ';')) {
+      LOG_DEBUG("Unexpected end in cookie key value string [%.*s]", static_cast<int>(cookie_kv_size), cookie_kv);
+      done_ = malformed_ = true;
+      break;
+    }
+    StringView name = stripEnclosingWhitespace(value_.substr(start_pos, end_pos - start_pos));
+    if (name.empty()) {
+      LOG_DEBUG("Empty cookie name in key value string [%.*s]", static_cast<int>(cookie_kv_size), cookie_kv);
+      done_ = malformed_ = true;
+      break;
+    }
+    start_pos = ++end_pos; // value should start here
+    if (start_pos == cookie_kv_size) {
+      LOG_DEBUG("Cookie [%.*s] has no value in key value string [%.*s]", static_cast<int>(name.length()),
+                name.data(), static_cast<int>(cookie_kv_size), cookie_kv);
+      done_ = malformed_ = true;
+      break;
+    }
+    bool within_quotes = false;
+    for (end_pos = start_pos; end_pos < cookie_kv_size; ++end_pos) {
+      if (cookie_kv[end_pos] == '"') {
+        within_quotes = !within_quotes;
+      } else if ((cookie_kv[end_pos] == ';') && !within_quotes) {
+        break;
+      }
+    }
+    cookie.name_ = name;
+    cookie.value_ = stripEnclosingWhitespace(value_.substr(start_pos, end_pos - start_pos));
+    pos_ = end_pos + 1; // next name should start here
+    return true;
+  }
+  return false;
+}
+
+StringView Headers::findRequestCookie(const string &name) const {
+  RequestCookieIterator iter(*this);
+  RequestCookieView cookie;
+  while (iter.next(cookie)) {
+    if (cookie.name_ == StringView(name)) {
+      return cookie.value_;
+    }
+  }
+  return StringView();
+}
+
 const Headers::RequestCookieMap &Headers::getRequestCookies() const {
   if (state_->type_ != Headers::TYPE_REQUEST) {
     LOG_ERROR("Object is not of type request. Returning empty map");
     return state_->request_cookies_;
   }
-  if (state_->request_cookies_.isInitialized() || !checkAndInitHeaders()) {
+  if (state_->request_cookies_.isInitialized() || !checkHeaderHandles()) {
     return state_->request_cookies_;
   }
   state_->request_cookies_.setInitialized();
-  const_iterator iter = find("Cookie");
-  if (iter != end()) {
-    const list<string> &cookie_kvs = iter->second; // cookie key-value pairs
-    string name, value;
-    for (list<string>::const_iterator cookie_kv_iter = cookie_kvs.begin(), cookie_kv_end = cookie_kvs.end();
-         cookie_kv_iter != cookie_kv_end; ++cookie_kv_iter) {
-      const string &cookie_kv = *cookie_kv_iter;
-      size_t cookie_kv_size = cookie_kv.size();
-      size_t start_pos, end_pos, length;
-        
-      for (size_t i = 0; i < cookie_kv_size; ) {
-        start_pos = i;
-        for (end_pos = start_pos;
-             (end_pos < cookie_kv_size) && (cookie_kv[end_pos] != '=') && (cookie_kv[end_pos] != ';'); ++end_pos);
-        if ((end_pos == cookie_kv_size) || (cookie_kv[end_pos] == ';')) {
-          LOG_DEBUG("Unexpected end in cookie key value string [%s]", cookie_kv.c_str());
-          return state_->request_cookies_;
-        }
-        length = end_pos - start_pos;
-        name.assign(cookie_kv, start_pos, length);
-        stripEnclosingWhitespace(name);
-        if (name.empty()) {
-          LOG_DEBUG("Empty cookie name in key value string [%s]", cookie_kv.c_str());
-          return state_->request_cookies_;
-        }
-        start_pos = ++end_pos; // value should start here
-        if (start_pos == cookie_kv_size)  {
-          LOG_DEBUG("Cookie [%s] has no value in key value string [%s]", name.c_str(), cookie_kv.c_str());
-          return state_->request_cookies_;
-        }
-        bool within_quotes = false;
-        for (end_pos = start_pos; end_pos < cookie_kv_size; ++end_pos) {
-          if (cookie_kv[end_pos] == '"') {
-            within_quotes = !within_quotes;
-          } else if ((cookie_kv[end_pos] == ';') && !within_quotes) {
-            break;
-          }
-        }
-        length = end_pos - start_pos;
-        value.assign(cookie_kv, start_pos, length);
-        stripEnclosingWhitespace(value);
-        addCookieToMap(state_->request_cookies_, name ,value);
-        i = ++end_pos; // next name should start here
-      }
-    }
+  RequestCookieIterator iter(*this);
+  RequestCookieView cookie;
+  while (iter.next(cookie)) {
+    addCookieToMap(state_->request_cookies_, cookie.name_.str(), cookie.value_.str());
   }
+  state_->request_cookies_malformed_ = iter.isMalformed();
   return state_->request_cookies_;
 }
 
@@ -424,7 +1038,7 @@ const list<Headers::ResponseCookie> &Headers::getResponseCookies() const {
     LOG_ERROR("Object is not of type response. Returning empty list");
     return state_->response_cookies_;
   }
-  if (state_->response_cookies_.isInitialized() || !checkAndInitHeaders()) {
+  if (state_->response_cookies_.isInitialized() || !checkHeaderHandles()) {
     return state_->response_cookies_;
   }
   state_->response_cookies_.setInitialized();
@@ -437,11 +1051,12 @@ bool Headers::addCookie(const string &name, const string &value) {
     LOG_ERROR("Cannot add request cookie to response headers");
     return false;
   }
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return false;
   }
+  getRequestCookies(); // the header is rewritten from the map, so it must hold the cookies already sent
   addCookieToMap(state_->request_cookies_, name, value);
-  updateRequestCookieHeaderFromMap();
+  state_->cookie_edits_pending_ = true;
   return true;
 }
 
@@ -450,10 +1065,12 @@ bool Headers::addCookie(const ResponseCookie &response_cookie) {
     LOG_ERROR("Cannot add response cookie to object not of type response");
     return false;
   }
-  if (!checkAndInitHeaders()) {
-    false;
+  if (!checkHeaderHandles()) {
+    return false;
   }
-  // @TODO Do logic here
+  state_->added_response_cookies_.push_back(response_cookie);
+  state_->cookie_edits_pending_ = true;
+  LOG_DEBUG("Added response cookie [%s]", response_cookie.name_.c_str());
   return true;
 }
   
@@ -462,7 +1079,7 @@ bool Headers::setCookie(const string &name, const string &value) {
     LOG_ERROR("Cannot set request cookie to response headers");
     return false;
   }
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return false;
   }
   getRequestCookies();
@@ -475,15 +1092,15 @@ bool Headers::setCookie(const ResponseCookie &response_cookie) {
     LOG_ERROR("Cannot set response cookie to request headers");
     return false;
   }
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return false;
   }
-  // @TODO Do logic here
-  return true;
+  removeResponseCookie(response_cookie.name_);
+  return addCookie(response_cookie);
 }
 
 bool Headers::deleteCookie(const string &name) {
-  if (!checkAndInitHeaders()) {
+  if (!checkHeaderHandles()) {
     return false;
   }
   if (state_->type_ == TYPE_REQUEST) {
@@ -494,14 +1111,161 @@ bool Headers::deleteCookie(const string &name) {
       return true;
     }
     state_->request_cookies_.getValueRef().erase(iter);
-    updateRequestCookieHeaderFromMap();
+    state_->cookie_edits_pending_ = true;
     return true;
   }
-  getResponseCookies();
-  // @TODO Do logic here
+  removeResponseCookie(name);
   return true;
 }
 
+void Headers::removeResponseCookie(const string &name) {
+  list<ResponseCookie> &added = state_->added_response_cookies_;
+  for (list<ResponseCookie>::iterator iter = added.begin(); iter != added.end();) {
+    iter = (iter->name_ == name) ? added.erase(iter) : ++iter;
+  }
+  state_->removed_response_cookies_.push_back(name);
+  state_->cookie_edits_pending_ = true;
+}
+
+void Headers::flushCookies() {
+  flushPendingCookieEdits();
+}
+
+void Headers::flushPendingCookieEdits() const {
+  if (state_->cookie_edits_pending_) {
+    state_->cookie_edits_pending_ = false; // first, the writes below read the headers too
+    if (state_->type_ == TYPE_REQUEST) {
+      const_cast<Headers *>(this)->updateRequestCookieHeaderFromMap();
+    } else {
+      const_cast<Headers *>(this)->updateResponseCookieHeaders();
+    }
+  }
+}
+
+namespace {
+
+const char SET_COOKIE_HEADER[] = "Set-Cookie";
+const size_t SET_COOKIE_HEADER_LENGTH = sizeof(SET_COOKIE_HEADER) - 1;
+
+string serializeResponseCookie(const Headers::ResponseCookie &cookie) {
+  string value = cookie.name_;
+  value += '=';
+  value += cookie.value_;
+  if (!cookie.domain_.empty()) {
+    value += "; Domain=";
+    value += cookie.domain_;
+  }
+  if (!cookie.path_.empty()) {
+    value += "; Path=";
+    value += cookie.path_;
+  }
+  char number[16];
+  if (cookie.max_age_) {
+    snprintf(number, sizeof(number), "%d", cookie.max_age_);
+    value += "; Max-Age=";
+    value += number;
+  }
+  if (!cookie.comment_.empty()) {
+    value += "; Comment=";
+    value += cookie.comment_;
+  }
+  if (cookie.version_) {
+    snprintf(number, sizeof(number), "%d", cookie.version_);
+    value += "; Version=";
+    value += number;
+  }
+  if (cookie.secure_) {
+    value += "; Secure";
+  }
+  return value;
+}
+
+/** @return true if the Set-Cookie value is of a cookie whose name is in names. */
+bool isResponseCookieOf(const StringView &set_cookie, const vector<string> &names) {
+  size_t name_end = 0;
+  while ((name_end < set_cookie.length()) && (set_cookie[name_end] != '=') && (set_cookie[name_end] != ';')) {
+    ++name_end;
+  }
+  StringView name = stripEnclosingWhitespace(set_cookie.substr(0, name_end));
+  for (vector<string>::const_iterator iter = names.begin(); iter != names.end(); ++iter) {
+    if (name == StringView(*iter)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
+
+void Headers::updateResponseCookieHeaders() {
+  vector<string> &removed = state_->removed_response_cookies_;
+  list<ResponseCookie> &added = state_->added_response_cookies_;
+  NameValuesMap &name_values_map = state_->name_values_map_.getValueRef();
+  const string header_name(SET_COOKIE_HEADER);
+  state_->response_cookies_.getValueRef().clear();
+  state_->response_cookies_.setInitialized(false);
+
+  if (state_->detached_) {
+    list<string> &values = name_values_map.insert(make_pair(header_name, EMPTY_VALUE_LIST)).first->second;
+    for (list<string>::iterator iter = values.begin(); !removed.empty() && (iter != values.end());) {
+      iter = isResponseCookieOf(StringView(*iter), removed) ? values.erase(iter) : ++iter;
+    }
+    for (list<ResponseCookie>::const_iterator iter = added.begin(); iter != added.end(); ++iter) {
+      values.push_back(serializeResponseCookie(*iter));
+    }
+    if (values.empty()) {
+      name_values_map.erase(header_name);
+    }
+  } else {
+    // every cookie has a field of its own, Set-Cookie values can't be joined with commas
+    TSMLoc field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, SET_COOKIE_HEADER,
+                                          SET_COOKIE_HEADER_LENGTH);
+    while (field_loc && !removed.empty()) {
+      TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+      int value_len = 0;
+      const char *value = TSMimeHdrFieldValueStringGet(state_->hdr_buf_, state_->hdr_loc_, field_loc, -1, &value_len);
+      if (isResponseCookieOf(StringView(value, (value && (value_len > 0)) ? value_len : 0), removed)) {
+        TSMimeHdrFieldDestroy(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+      }
+      TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+      field_loc = next_field_loc;
+    }
+    if (field_loc) {
+      TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    }
+    for (list<ResponseCookie>::const_iterator iter = added.begin(); iter != added.end(); ++iter) {
+      string value = serializeResponseCookie(*iter);
+      if (TSMimeHdrFieldCreate(state_->hdr_buf_, state_->hdr_loc_, &field_loc) != TS_SUCCESS) {
+        LOG_ERROR("Failed to create Set-Cookie field for cookie [%s]", iter->name_.c_str());
+        continue;
+      }
+      TSMimeHdrFieldNameSet(state_->hdr_buf_, state_->hdr_loc_, field_loc, SET_COOKIE_HEADER,
+                            SET_COOKIE_HEADER_LENGTH);
+      TSMimeHdrFieldValueStringInsert(state_->hdr_buf_, state_->hdr_loc_, field_loc, APPEND_INDEX, value.c_str(),
+                                      value.length());
+      TSMimeHdrFieldAppend(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+      TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+    }
+
+    // the cached values of the header are read again from the fields left
+    name_values_map.erase(header_name);
+    field_loc = TSMimeHdrFieldFind(state_->hdr_buf_, state_->hdr_loc_, SET_COOKIE_HEADER, SET_COOKIE_HEADER_LENGTH);
+    if (field_loc) {
+      list<string> &values = name_values_map.insert(make_pair(header_name, EMPTY_VALUE_LIST)).first->second;
+      while (field_loc) {
+        extractHeaderFieldValues(state_->hdr_buf_, state_->hdr_loc_, field_loc, header_name, values);
+        TSMLoc next_field_loc = TSMimeHdrFieldNextDup(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        TSHandleMLocRelease(state_->hdr_buf_, state_->hdr_loc_, field_loc);
+        field_loc = next_field_loc;
+      }
+    }
+    state_->looked_up_names_.insert(header_name);
+  }
+  LOG_DEBUG("Wrote %zu added and %zu removed response cookies", added.size(), removed.size());
+  removed.clear();
+  added.clear();
+}
+
 void Headers::updateRequestCookieHeaderFromMap() {
   string cookie_header;
   for (RequestCookieMap::iterator cookie_iter = state_->request_cookies_.getValueRef().begin(), 
@@ -514,14 +1278,15 @@ void Headers::updateRequestCookieHeaderFromMap() {
       cookie_header += "; ";
     }
   }
-  if (!cookie_header.empty()) {
-    cookie_header.erase(cookie_header.size() - 2, 2); // erase trailing '; '
-  }
-
   // we could have called set(), but set() invalidates the cookie map
   // indirectly by calling append(). But our map is up to date. So we
   // do put the set() logic here explicitly.
   doBasicErase("Cookie");
+  if (cookie_header.empty()) {
+    LOG_DEBUG("No cookies left, the Cookie header stays erased");
+    return;
+  }
+  cookie_header.erase(cookie_header.size() - 2, 2); // erase trailing '; '
   list<string> values;
   values.push_back(cookie_header);
   doBasicAppend(pair<string, list<string> >("Cookie", values));
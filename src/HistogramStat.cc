@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HistogramStat.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/HistogramStat.h"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <ts/ts.h>
+#include "atscppapi/Async.h"
+#include "atscppapi/AsyncTimer.h"
+#include "atscppapi/Mutex.h"
+#include "StatShards.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int SUB_BUCKET_BITS = 4;
+const int64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+const int VALUE_BITS = 40;
+const int64_t MAX_VALUE = (1LL << VALUE_BITS) - 1;
+const int BUCKET_COUNT = (VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+/**
+ * Values below SUB_BUCKET_COUNT have a bucket each, above that every power of two is split in SUB_BUCKET_COUNT.
+ */
+inline int getBucket(int64_t value) {
+  if (value < SUB_BUCKET_COUNT) {
+    return static_cast<int>(value);
+  }
+  int msb = 63 - __builtin_clzll(static_cast<unsigned long long>(value));
+  int shift = msb - SUB_BUCKET_BITS;
+  return ((shift + 1) << SUB_BUCKET_BITS) + static_cast<int>((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+/** @return The middle of the values that fall into bucket. */
+int64_t getBucketValue(int bucket) {
+  if (bucket < SUB_BUCKET_COUNT) {
+    return bucket;
+  }
+  int shift = (bucket >> SUB_BUCKET_BITS) - 1;
+  int64_t lowest = (SUB_BUCKET_COUNT + (bucket & (SUB_BUCKET_COUNT - 1))) << shift;
+  return lowest + ((1LL << shift) >> 1);
+}
+
+struct HistogramShard {
+  volatile int64_t count_;
+  volatile int64_t sum_;
+  volatile int64_t buckets_[BUCKET_COUNT];
+};
+
+enum ExportedStat { STAT_P50 = 0, STAT_P99, STAT_P999, STAT_COUNT, STAT_SUM, EXPORTED_STAT_COUNT };
+
+const char *EXPORTED_STAT_SUFFIXES[EXPORTED_STAT_COUNT] = { ".p50", ".p99", ".p999", ".count", ".sum" };
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::HistogramStatState : AsyncReceiver<AsyncTimer> {
+  int stat_ids_[EXPORTED_STAT_COUNT];
+  HistogramShard *volatile shards_[MAX_STAT_SHARDS]; // allocated by the first thread recording into them
+  vector<int64_t> interval_buckets_; // of the last complete interval
+  int64_t interval_count_;
+  mutable Mutex mutex_; // protects the interval
+  AsyncTimer *aggregation_timer_;
+
+  HistogramStatState() : interval_buckets_(BUCKET_COUNT), interval_count_(0), aggregation_timer_(NULL) {
+    memset(const_cast<HistogramShard **>(shards_), 0, sizeof(shards_));
+    for (int i = 0; i < EXPORTED_STAT_COUNT; ++i) {
+      stat_ids_[i] = TS_ERROR;
+    }
+  }
+
+  HistogramShard &getShard() {
+    int index = getStatShard();
+    HistogramShard *shard = shards_[index];
+    if (!shard) {
+      HistogramShard *new_shard = static_cast<HistogramShard *>(calloc(1, sizeof(HistogramShard)));
+      shard = __sync_val_compare_and_swap(&shards_[index], static_cast<HistogramShard *>(NULL), new_shard);
+      if (shard) {
+        free(new_shard); // another thread sharing the shard was first
+      } else {
+        shard = new_shard;
+      }
+    }
+    return *shard;
+  }
+
+  int64_t getIntervalPercentile(double percentile) const {
+    if (!interval_count_) {
+      return 0;
+    }
+    int64_t rank = static_cast<int64_t>(percentile / 100.0 * interval_count_ + 0.5);
+    if (rank < 1) {
+      rank = 1;
+    }
+    int64_t seen = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+      seen += interval_buckets_[bucket];
+      if (seen >= rank) {
+        return getBucketValue(bucket);
+      }
+    }
+    return MAX_VALUE;
+  }
+
+  void handleAsyncComplete(AsyncTimer &) {
+    int64_t count = 0;
+    int64_t sum = 0;
+    ScopedMutexLock lock(mutex_);
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+      interval_buckets_[bucket] = 0;
+    }
+    for (int i = 0; i < MAX_STAT_SHARDS; ++i) {
+      HistogramShard *shard = shards_[i];
+      if (shard) {
+        for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+          if (shard->buckets_[bucket]) {
+            interval_buckets_[bucket] += __sync_lock_test_and_set(&shard->buckets_[bucket], 0);
+          }
+        }
+        count += __sync_lock_test_and_set(&shard->count_, 0);
+        sum += __sync_lock_test_and_set(&shard->sum_, 0);
+      }
+    }
+    interval_count_ = 0;
+    for (int bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+      interval_count_ += interval_buckets_[bucket]; // count_ might be ahead of the buckets of a concurrent record()
+    }
+    TSStatIntSet(stat_ids_[STAT_P50], getIntervalPercentile(50));
+    TSStatIntSet(stat_ids_[STAT_P99], getIntervalPercentile(99));
+    TSStatIntSet(stat_ids_[STAT_P999], getIntervalPercentile(99.9));
+    TSStatIntIncrement(stat_ids_[STAT_COUNT], count);
+    TSStatIntIncrement(stat_ids_[STAT_SUM], sum);
+  }
+
+  ~HistogramStatState() {
+    delete aggregation_timer_;
+    for (int i = 0; i < MAX_STAT_SHARDS; ++i) {
+      free(shards_[i]);
+    }
+  }
+};
+
+HistogramStat::HistogramStat() : state_(new HistogramStatState()) {
+}
+
+HistogramStat::~HistogramStat() {
+  delete state_;
+}
+
+bool HistogramStat::init(const string &name, int aggregation_interval_ms) {
+  for (int i = 0; i < EXPORTED_STAT_COUNT; ++i) {
+    string stat_name = name + EXPORTED_STAT_SUFFIXES[i];
+    state_->stat_ids_[i] = TSStatCreate(stat_name.c_str(), TS_RECORDDATATYPE_INT, TS_STAT_NON_PERSISTENT,
+                                        TS_STAT_SYNC_SUM);
+    if (state_->stat_ids_[i] == TS_ERROR) {
+      LOG_ERROR("Unable to create stat named '%s'.", stat_name.c_str());
+      return false;
+    }
+    TSStatIntSet(state_->stat_ids_[i], 0);
+  }
+  LOG_DEBUG("Created histogram stats named '%s.*', aggregated every %d ms", name.c_str(), aggregation_interval_ms);
+  state_->aggregation_timer_ = new AsyncTimer(AsyncTimer::TYPE_PERIODIC, aggregation_interval_ms, 0,
+                                              ASYNC_THREAD_POOL_TASK);
+  Async::execute<AsyncTimer>(state_, state_->aggregation_timer_, shared_ptr<Mutex>());
+  return true;
+}
+
+void HistogramStat::record(int64_t value) {
+  if (value < 0) {
+    value = 0;
+  } else if (value > MAX_VALUE) {
+    value = MAX_VALUE;
+  }
+  HistogramShard &shard = state_->getShard();
+  __sync_fetch_and_add(&shard.buckets_[getBucket(value)], 1);
+  __sync_fetch_and_add(&shard.count_, 1);
+  __sync_fetch_and_add(&shard.sum_, value);
+}
+
+int64_t HistogramStat::getPercentile(double percentile) const {
+  ScopedMutexLock lock(state_->mutex_);
+  return state_->getIntervalPercentile(percentile);
+}
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HookFilter.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/HookFilter.h"
+#include <cstring>
+#include <stdint.h>
+#include <vector>
+#include <utility>
+#include <ts/ts.h>
+#include "atscppapi/CaseInsensitiveStringComparator.h"
+#include "atscppapi/noncopyable.h"
+#include "HookFilterRequest.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+/**
+ * A byte-wise trie of path prefixes, small enough that the children of a node are simply searched in order.
+ */
+class PathPrefixTrie {
+public:
+  PathPrefixTrie() : nodes_(1) { }
+
+  void add(const char *prefix, size_t length) {
+    size_t node = 0;
+    for (size_t i = 0; i < length; ++i) {
+      size_t child = findChild(node, prefix[i]);
+      if (!child) {
+        child = nodes_.size();
+        nodes_.push_back(Node());
+        nodes_[node].children_.push_back(std::make_pair(prefix[i], child));
+      }
+      node = child;
+    }
+    nodes_[node].terminal_ = true;
+  }
+
+  /** @return true if one of the prefixes is a prefix of path */
+  bool matchesPrefixOf(const char *path, size_t length) const {
+    size_t node = 0;
+    for (size_t i = 0; !nodes_[node].terminal_; ++i) {
+      if (i == length) {
+        return false;
+      }
+      node = findChild(node, path[i]);
+      if (!node) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool empty() const { return nodes_.size() == 1 && !nodes_[0].terminal_; }
+
+private:
+  struct Node {
+    vector<std::pair<char, size_t> > children_;
+    bool terminal_;
+    Node() : terminal_(false) { }
+  };
+  vector<Node> nodes_; // the root is node 0, which is why 0 can mean no child
+
+  size_t findChild(size_t node, char c) const {
+    const vector<std::pair<char, size_t> > &children = nodes_[node].children_;
+    for (size_t i = 0; i < children.size(); ++i) {
+      if (children[i].first == c) {
+        return children[i].second;
+      }
+    }
+    return 0;
+  }
+};
+
+/** @return The bit of method in HookFilterState::method_mask_. */
+inline uint64_t getMethodBit(HttpMethod method) {
+  return static_cast<uint64_t>(1) << method;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::HookFilterState: noncopyable {
+  vector<string> hosts_;
+  PathPrefixTrie path_prefixes_;
+  uint64_t method_mask_; // getMethodBit() of the methods, 0 matches every method
+  HookFilter::TransactionOrigin origin_;
+  HookFilterState() : method_mask_(0), origin_(HookFilter::ORIGIN_ANY) { }
+};
+
+HookFilter::HookFilter() : state_(new HookFilterState()) {
+}
+
+HookFilter::~HookFilter() {
+}
+
+HookFilter &HookFilter::addHost(const string &host) {
+  state_->hosts_.push_back(host);
+  return *this;
+}
+
+HookFilter &HookFilter::addPathPrefix(const string &prefix) {
+  // Traffic Server's paths don't start with a slash
+  size_t skip = (!prefix.empty() && (prefix[0] == '/')) ? 1 : 0;
+  state_->path_prefixes_.add(prefix.data() + skip, prefix.length() - skip);
+  return *this;
+}
+
+HookFilter &HookFilter::addMethod(HttpMethod method) {
+  state_->method_mask_ |= getMethodBit(method);
+  return *this;
+}
+
+HookFilter &HookFilter::setTransactionOrigin(TransactionOrigin origin) {
+  state_->origin_ = origin;
+  return *this;
+}
+
+bool HookFilter::empty() const {
+  return state_->hosts_.empty() && state_->path_prefixes_.empty() && !state_->method_mask_ &&
+    (state_->origin_ == ORIGIN_ANY);
+}
+
+bool HookFilter::matches(HookFilterRequest &request) const {
+  const HookFilterState &state = *state_;
+  if (state.origin_ != ORIGIN_ANY) {
+    if (request.isInternal() != (state.origin_ == ORIGIN_INTERNAL)) {
+      return false;
+    }
+  }
+  if (state.hosts_.empty() && state.path_prefixes_.empty() && !state.method_mask_) {
+    return true;
+  }
+  if (!request.fetchRequest()) {
+    return false;
+  }
+  if (state.method_mask_ &&
+      !(state.method_mask_ & getMethodBit(parseHttpMethod(request.method_, static_cast<size_t>(request.method_length_))))) {
+    return false;
+  }
+  if (!state.hosts_.empty()) {
+    CaseInsensitiveStringComparator comparator;
+    bool host_matched = false;
+    for (vector<string>::const_iterator iter = state.hosts_.begin(); !host_matched && (iter != state.hosts_.end());
+         ++iter) {
+      host_matched = comparator.equals(iter->data(), iter->length(), request.host_, request.host_length_);
+    }
+    if (!host_matched) {
+      return false;
+    }
+  }
+  return state.path_prefixes_.empty() || state.path_prefixes_.matchesPrefixOf(request.path_, request.path_length_);
+}
+
+volatile bool HookFilterRequest::passthrough_fetches_made_ = false;
+
+HookFilterRequest::HookFilterRequest(TSHttpTxn txn)
+  : txn_(txn), hdr_buf_(NULL), hdr_loc_(NULL), url_loc_(NULL), host_(NULL), host_length_(0), path_(NULL),
+    path_length_(0), method_(NULL), method_length_(0), request_fetched_(false), internal_(-1),
+    passthrough_(-1) {
+}
+
+HookFilterRequest::~HookFilterRequest() {
+  if (url_loc_) {
+    TSHandleMLocRelease(hdr_buf_, hdr_loc_, url_loc_);
+  }
+  if (hdr_loc_) {
+    static const TSMLoc NULL_PARENT_LOC = NULL;
+    TSHandleMLocRelease(hdr_buf_, NULL_PARENT_LOC, hdr_loc_);
+  }
+}
+
+bool HookFilterRequest::fetchRequest() {
+  if (request_fetched_) {
+    return hdr_loc_ != NULL;
+  }
+  request_fetched_ = true;
+  if (TSHttpTxnClientReqGet(txn_, &hdr_buf_, &hdr_loc_) != TS_SUCCESS) {
+    LOG_ERROR("Could not get client request of tshttptxn=%p for hook filters", txn_);
+    hdr_buf_ = NULL;
+    hdr_loc_ = NULL;
+    return false;
+  }
+  method_ = TSHttpHdrMethodGet(hdr_buf_, hdr_loc_, &method_length_);
+  if (TSHttpHdrUrlGet(hdr_buf_, hdr_loc_, &url_loc_) == TS_SUCCESS) {
+    path_ = TSUrlPathGet(hdr_buf_, url_loc_, &path_length_);
+    host_ = TSUrlHostGet(hdr_buf_, url_loc_, &host_length_);
+  } else {
+    url_loc_ = NULL;
+  }
+  if (!host_ || (host_length_ <= 0)) {
+    TSMLoc field_loc = TSMimeHdrFieldFind(hdr_buf_, hdr_loc_, TS_MIME_FIELD_HOST, TS_MIME_LEN_HOST);
+    if (field_loc) {
+      host_ = TSMimeHdrFieldValueStringGet(hdr_buf_, hdr_loc_, field_loc, 0, &host_length_);
+      TSHandleMLocRelease(hdr_buf_, hdr_loc_, field_loc); // the value stays in the marshal buffer
+      const char *port = host_ ? static_cast<const char *>(memchr(host_, ':', host_length_)) : NULL;
+      if (port) {
+        host_length_ = port - host_;
+      }
+    }
+  }
+  if (!host_ || (host_length_ < 0)) {
+    host_length_ = 0;
+  }
+  if (!path_ || (path_length_ < 0)) {
+    path_length_ = 0;
+  }
+  return true;
+}
+
+bool HookFilterRequest::isInternal() {
+  if (internal_ < 0) {
+    internal_ = (TSHttpIsInternalRequest(txn_) == TS_SUCCESS) ? 1 : 0;
+  }
+  return internal_ == 1;
+}
+
+bool HookFilterRequest::isPassthrough() {
+  if (passthrough_ < 0) {
+    passthrough_ = 0;
+    if (passthrough_fetches_made_ && isInternal() && fetchRequest()) {
+      TSMLoc field_loc = TSMimeHdrFieldFind(hdr_buf_, hdr_loc_, PASSTHROUGH_HEADER, PASSTHROUGH_HEADER_LENGTH);
+      if (field_loc) {
+        TSHandleMLocRelease(hdr_buf_, hdr_loc_, field_loc);
+        passthrough_ = 1;
+      }
+    }
+  }
+  return passthrough_ == 1;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HookTiming.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/HookTiming.h"
+#include <cctype>
+#include "atscppapi/HistogramStat.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+const int HOOK_TYPE_COUNT = Plugin::HOOK_CACHE_LOOKUP_COMPLETE + 1;
+
+const int64_t NANOSECONDS_PER_MICROSECOND = 1000;
+
+/** @return e.g. read_request_headers_pre_remap for HOOK_READ_REQUEST_HEADERS_PRE_REMAP */
+string getHookStatName(int hook_type) {
+  StringView hook_name = getHookTypeName(static_cast<Plugin::HookType>(hook_type));
+  string name(hook_name.data() + sizeof("HOOK_") - 1, hook_name.length() - (sizeof("HOOK_") - 1));
+  for (size_t i = 0; i < name.length(); ++i) {
+    name[i] = tolower(name[i]);
+  }
+  return name;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::HookTimingState : noncopyable {
+  HistogramStat handler_times_[HOOK_TYPE_COUNT];
+  HistogramStat resume_times_[HOOK_TYPE_COUNT];
+};
+
+HookTiming::HookTiming(const string &name, int aggregation_interval_ms) : state_(new HookTimingState()) {
+  for (int i = 0; i < HOOK_TYPE_COUNT; ++i) {
+    string prefix = name + "." + getHookStatName(i);
+    state_->handler_times_[i].init(prefix + ".handler_us", aggregation_interval_ms);
+    state_->resume_times_[i].init(prefix + ".resume_us", aggregation_interval_ms);
+  }
+  LOG_DEBUG("Created hook timing stats for '%s'", name.c_str());
+}
+
+HookTiming::~HookTiming() {
+  delete state_;
+}
+
+void HookTiming::recordHandlerTime(int hook_type, int64_t nanoseconds) {
+  state_->handler_times_[hook_type].record(nanoseconds / NANOSECONDS_PER_MICROSECOND);
+}
+
+void HookTiming::recordResumeTime(int hook_type, int64_t nanoseconds) {
+  state_->resume_times_[hook_type].record(nanoseconds / NANOSECONDS_PER_MICROSECOND);
+}
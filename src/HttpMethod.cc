@@ -17,16 +17,77 @@
  */
 
 #include "atscppapi/HttpMethod.h"
+#include <cstring>
 
-const std::string atscppapi::HTTP_METHOD_STRINGS[] = { std::string("UNKNOWN"),
-                                                       std::string("GET"),
-                                                       std::string("POST"),
-                                                       std::string("HEAD"),
-                                                       std::string("CONNECT"),
-                                                       std::string("DELETE"),
-                                                       std::string("ICP_QUERY"),
-                                                       std::string("OPTIONS"),
-                                                       std::string("PURGE"),
-                                                       std::string("PUT"),
-                                                       std::string("TRACE") };
+using atscppapi::HttpMethod;
+using atscppapi::StringView;
 
+namespace {
+
+// every HttpMethod in order with its name, it keeps the tables below in line with the enum
+#define HTTP_METHODS(X) \
+  X("UNKNOWN") X("GET") X("POST") X("HEAD") X("CONNECT") X("DELETE") X("ICP_QUERY") X("OPTIONS") X("PURGE") \
+  X("PUT") X("TRACE") X("PATCH") X("ACL") X("BASELINE-CONTROL") X("BIND") X("CHECKIN") X("CHECKOUT") X("COPY") \
+  X("LABEL") X("LINK") X("LOCK") X("MERGE") X("MKACTIVITY") X("MKCALENDAR") X("MKCOL") X("MKREDIRECTREF") \
+  X("MKWORKSPACE") X("MOVE") X("ORDERPATCH") X("PRI") X("PROPFIND") X("PROPPATCH") X("REBIND") X("REPORT") \
+  X("SEARCH") X("UNBIND") X("UNCHECKOUT") X("UNLINK") X("UNLOCK") X("UPDATE") X("UPDATEREDIRECTREF") \
+  X("VERSION-CONTROL")
+
+/** A POD, so the table is built by the compiler rather than by a static constructor. */
+struct MethodName {
+  const char *name_;
+  size_t length_;
+};
+
+#define METHOD_NAME(name) { name, sizeof(name) - 1 },
+const MethodName METHOD_NAMES[] = { HTTP_METHODS(METHOD_NAME) };
+#undef METHOD_NAME
+
+const size_t METHOD_COUNT = sizeof(METHOD_NAMES) / sizeof(METHOD_NAMES[0]);
+
+const size_t MIN_METHOD_LENGTH = 3;
+const size_t MAX_METHOD_LENGTH = 17;
+
+/*
+ * A perfect hash of the methods above: their lengths and their first and last two characters tell them apart,
+ * and with these factors no two of them share a slot. Adding a method means finding new factors.
+ */
+inline unsigned int hashMethod(const char *name, size_t length) {
+  const unsigned char *chars = reinterpret_cast<const unsigned char *>(name);
+  return (static_cast<unsigned int>(length) + 3 * chars[0] + 14 * chars[length - 2] + 13 * chars[length - 1]) & 127;
+}
+
+/** HttpMethod by hashMethod(), HTTP_METHOD_UNKNOWN for the empty slots. */
+const unsigned char METHODS_BY_HASH[128] = {
+   0,  0, 14,  0, 13,  0,  0,  0,  0,  0,  0, 18,  0,  0, 22,  0,
+   0,  0,  0,  0,  0,  0,  0,  0, 37,  0, 24,  0,  0, 26, 39,  0,
+  27,  0,  0,  0, 29,  0,  0,  0,  0, 23,  0,  0, 10,  0,  0,  0,
+  30,  0, 17,  0, 32,  0,  0,  0,  0,  0,  0, 16, 33, 35,  4, 41,
+   0,  0,  2,  0, 15,  0,  0, 11, 25, 28,  0, 31, 12,  0,  0, 21,
+   0, 34,  0,  0,  0,  0,  0,  0,  8,  0,  0,  0,  0,  9,  3,  0,
+   0, 20,  1,  0, 40,  6,  0,  0,  0,  0,  0,  5,  0,  0,  0,  7,
+   0,  0,  0, 36,  0,  0,  0,  0,  0,  0,  0, 19,  0,  0, 38,  0,
+};
+
+}
+
+#define METHOD_STRING(name) std::string(name),
+const std::string atscppapi::HTTP_METHOD_STRINGS[] = { HTTP_METHODS(METHOD_STRING) };
+#undef METHOD_STRING
+
+StringView atscppapi::getHttpMethodName(HttpMethod method) {
+  size_t index = (static_cast<size_t>(method) < METHOD_COUNT) ? static_cast<size_t>(method) : 0;
+  return StringView(METHOD_NAMES[index].name_, METHOD_NAMES[index].length_);
+}
+
+HttpMethod atscppapi::parseHttpMethod(const char *name, size_t length) {
+  if (!name || (length < MIN_METHOD_LENGTH) || (length > MAX_METHOD_LENGTH)) {
+    return HTTP_METHOD_UNKNOWN;
+  }
+  unsigned char method = METHODS_BY_HASH[hashMethod(name, length)];
+  const MethodName &candidate = METHOD_NAMES[method];
+  if (method && (candidate.length_ == length) && (memcmp(candidate.name_, name, length) == 0)) {
+    return static_cast<HttpMethod>(method);
+  }
+  return HTTP_METHOD_UNKNOWN;
+}
@@ -18,8 +18,31 @@
 
 #include "atscppapi/HttpVersion.h"
 
-const std::string atscppapi::HTTP_VERSION_STRINGS[] = { std::string("UNKNOWN"),
-                                                        std::string("HTTP/0.9"),
-                                                        std::string("HTTP/1.0"),
-                                                        std::string("HTTP/1.1") };
+using atscppapi::StringView;
 
+namespace {
+
+#define HTTP_VERSIONS(X) X("UNKNOWN") X("HTTP/0.9") X("HTTP/1.0") X("HTTP/1.1")
+
+/** A POD, so the table is built by the compiler rather than by a static constructor. */
+struct VersionName {
+  const char *name_;
+  size_t length_;
+};
+
+#define VERSION_NAME(name) { name, sizeof(name) - 1 },
+const VersionName VERSION_NAMES[] = { HTTP_VERSIONS(VERSION_NAME) };
+#undef VERSION_NAME
+
+const size_t VERSION_COUNT = sizeof(VERSION_NAMES) / sizeof(VERSION_NAMES[0]);
+
+}
+
+#define VERSION_STRING(name) std::string(name),
+const std::string atscppapi::HTTP_VERSION_STRINGS[] = { HTTP_VERSIONS(VERSION_STRING) };
+#undef VERSION_STRING
+
+StringView atscppapi::getHttpVersionName(HttpVersion version) {
+  size_t index = (static_cast<size_t>(version) < VERSION_COUNT) ? static_cast<size_t>(version) : 0;
+  return StringView(VERSION_NAMES[index].name_, VERSION_NAMES[index].length_);
+}
@@ -18,8 +18,8 @@
 
 #include "InitializableValue.h"
 
-#ifdef DISABLE_TRANSACTION_DATA_CACHING
+#if defined(DISABLE_TRANSACTION_DATA_CACHING)
 bool atscppapi::transaction_data_caching_enabled = false;
-#else
+#else // also with ATSCPPAPI_ALWAYS_CACHE_TRANSACTION_DATA, which doesn't read it but keeps it truthful
 bool atscppapi::transaction_data_caching_enabled = true;
 #endif
@@ -0,0 +1,476 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file InterceptPlugin.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/InterceptPlugin.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <ts/ts.h>
+#include "atscppapi/noncopyable.h"
+#include "atscppapi/CaseInsensitiveStringComparator.h"
+#include "utils_internal.h"
+#include "logging_internal.h"
+
+#ifndef INT64_MAX
+#define INT64_MAX (9223372036854775807LL)
+#endif
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+const TSMLoc NULL_PARENT_LOC = NULL;
+const char HEADER_END[] = "\r\n\r\n";
+const int HEADER_END_LENGTH = sizeof(HEADER_END) - 1;
+const int64_t UNKNOWN_BODY_LENGTH = -1;
+const int64_t CHUNKED_BODY_LENGTH = -2; // the body ends with its last chunk, see scanChunkedBody()
+
+/** Where a chunked request body is at, its framing is followed to find its end but it isn't decoded. */
+enum ChunkState {
+  CHUNK_SIZE,
+  CHUNK_EXTENSION,
+  CHUNK_SIZE_LF,
+  CHUNK_DATA,
+  CHUNK_DATA_CR,
+  CHUNK_DATA_LF,
+  CHUNK_TRAILER_LINE_START,
+  CHUNK_TRAILER_LINE,
+  CHUNK_TRAILER_END_LF,
+  CHUNK_BODY_DONE
+};
+
+int hexDigitValue(char c) {
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+  if ((c >= 'a') && (c <= 'f')) {
+    return c - 'a' + 10;
+  }
+  if ((c >= 'A') && (c <= 'F')) {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+/** @return true if chunked is the last of the transfer codings, the body is framed in chunks then. */
+bool isChunked(const string &transfer_encoding) {
+  string::size_type end = transfer_encoding.find_last_not_of(" \t");
+  if (end == string::npos) {
+    return false;
+  }
+  string::size_type start = transfer_encoding.find_last_of(", \t", end);
+  start = (start == string::npos) ? 0 : start + 1;
+  return CaseInsensitiveStringComparator().equals(transfer_encoding.data() + start, end - start + 1, "chunked",
+                                                  sizeof("chunked") - 1);
+}
+
+int handleInterceptEvents(TSCont cont, TSEvent event, void *edata);
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::InterceptPluginState : noncopyable {
+  InterceptPlugin &plugin_;
+  TSHttpTxn txn_;
+  TSMutex mutex_;
+  TSCont cont_;
+  TSVConn net_vc_; // once Traffic Server connected to us
+  TSIOBuffer input_buffer_;
+  TSIOBufferReader input_reader_;
+  TSVIO input_vio_;
+  TSIOBuffer output_buffer_;
+  TSIOBufferReader output_reader_;
+  TSVIO output_vio_;
+  int64_t bytes_written_; // to output_buffer_
+  TSIOBuffer body_buffer_; // the body produced before the headers are sent
+  TSIOBufferReader body_reader_;
+  TSMBuffer response_hdr_buf_;
+  TSMLoc response_hdr_loc_;
+  Response response_;
+  int header_end_matched_; // how much of the end of the request headers the input ended with
+  bool request_headers_read_;
+  int64_t request_body_length_; // UNKNOWN_BODY_LENGTH to read the body until the end of the input
+  int64_t request_body_read_;
+  ChunkState chunk_state_; // of a CHUNKED_BODY_LENGTH body
+  int64_t chunk_remaining_; // the size of the chunk being read, then what's left of its data
+  bool input_complete_;
+  bool headers_sent_;
+  bool output_complete_;
+
+  InterceptPluginState(InterceptPlugin &plugin, TSHttpTxn txn)
+    : plugin_(plugin), txn_(txn), mutex_(TSMutexCreate()), cont_(NULL), net_vc_(NULL), input_buffer_(NULL),
+      input_reader_(NULL), input_vio_(NULL), output_buffer_(TSIOBufferCreate()), output_reader_(NULL),
+      output_vio_(NULL), bytes_written_(0), body_buffer_(TSIOBufferCreate()), body_reader_(NULL),
+      response_hdr_buf_(TSMBufferCreate()), response_hdr_loc_(TSHttpHdrCreate(response_hdr_buf_)),
+      header_end_matched_(0), request_headers_read_(false), request_body_length_(0), request_body_read_(0),
+      chunk_state_(CHUNK_SIZE), chunk_remaining_(0), input_complete_(false), headers_sent_(false), output_complete_(false) {
+    output_reader_ = TSIOBufferReaderAlloc(output_buffer_);
+    body_reader_ = TSIOBufferReaderAlloc(body_buffer_);
+    TSHttpHdrTypeSet(response_hdr_buf_, response_hdr_loc_, TS_HTTP_TYPE_RESPONSE);
+    TSHttpHdrVersionSet(response_hdr_buf_, response_hdr_loc_, TS_HTTP_VERSION(1, 1));
+    TSHttpHdrStatusSet(response_hdr_buf_, response_hdr_loc_, static_cast<TSHttpStatus>(HTTP_STATUS_OK));
+    utils::internal::initResponse(response_, response_hdr_buf_, response_hdr_loc_);
+  }
+
+  ~InterceptPluginState() {
+    if (input_buffer_) {
+      TSIOBufferReaderFree(input_reader_);
+      TSIOBufferDestroy(input_buffer_);
+    }
+    TSIOBufferReaderFree(output_reader_);
+    TSIOBufferDestroy(output_buffer_);
+    TSIOBufferReaderFree(body_reader_);
+    TSIOBufferDestroy(body_buffer_);
+    TSHandleMLocRelease(response_hdr_buf_, NULL_PARENT_LOC, response_hdr_loc_);
+    TSMBufferDestroy(response_hdr_buf_);
+  }
+
+  void accept(TSVConn net_vc) {
+    net_vc_ = net_vc;
+    input_buffer_ = TSIOBufferCreate();
+    input_reader_ = TSIOBufferReaderAlloc(input_buffer_);
+    input_vio_ = TSVConnRead(net_vc_, cont_, input_buffer_, INT64_MAX);
+    startOutput(); // the plugin may have answered already
+  }
+
+  void closeConnection() {
+    if (net_vc_) {
+      LOG_DEBUG("Closing intercepted connection %p of tshttptxn=%p", net_vc_, txn_);
+      TSVConnClose(net_vc_);
+      net_vc_ = NULL;
+      input_vio_ = NULL;
+      output_vio_ = NULL;
+    }
+  }
+
+  void readInput();
+  int64_t scanChunkedBody(const char *data, int64_t length);
+  void dispatchInputComplete();
+  void sendHeaders();
+  void startOutput();
+  size_t writeBody(const char *data, size_t length);
+  bool completeOutput();
+};
+
+void InterceptPluginState::readInput() {
+  int64_t avail = TSIOBufferReaderAvail(input_reader_);
+  for (TSIOBufferBlock block = TSIOBufferReaderStart(input_reader_); block && !input_complete_;
+       block = TSIOBufferBlockNext(block)) {
+    int64_t block_length;
+    const char *data = TSIOBufferBlockReadStart(block, input_reader_, &block_length);
+    int64_t pos = 0;
+    // the request headers come first, they are already in the transaction's client request
+    while (!request_headers_read_ && (pos < block_length)) {
+      char c = data[pos++];
+      if (c == HEADER_END[header_end_matched_]) {
+        request_headers_read_ = (++header_end_matched_ == HEADER_END_LENGTH);
+      } else {
+        header_end_matched_ = (c == HEADER_END[0]) ? 1 : 0;
+      }
+    }
+    int64_t body_length = block_length - pos;
+    if (request_body_length_ == CHUNKED_BODY_LENGTH) {
+      body_length = scanChunkedBody(data + pos, body_length);
+    } else if (request_body_length_ != UNKNOWN_BODY_LENGTH) {
+      body_length = std::min(body_length, request_body_length_ - request_body_read_);
+    }
+    if (body_length > 0) {
+      request_body_read_ += body_length;
+      plugin_.consume(StringView(data + pos, static_cast<size_t>(body_length)));
+    }
+    bool body_done = (request_body_length_ == CHUNKED_BODY_LENGTH) ? (chunk_state_ == CHUNK_BODY_DONE) :
+      ((request_body_length_ != UNKNOWN_BODY_LENGTH) && (request_body_read_ >= request_body_length_));
+    if (request_headers_read_ && body_done) {
+      TSIOBufferReaderConsume(input_reader_, avail);
+      dispatchInputComplete();
+      return;
+    }
+  }
+  TSIOBufferReaderConsume(input_reader_, avail);
+  if (input_vio_ && !input_complete_) {
+    TSVIOReenable(input_vio_);
+  }
+}
+
+/**
+ * Follows the chunk framing of data, the next bytes of a chunked body, without copying or decoding it. A keep-alive
+ * client doesn't close its connection after the body, so its last chunk is what ends the request.
+ *
+ * @return how many bytes of data belong to the body, less than length once its end was found.
+ */
+int64_t InterceptPluginState::scanChunkedBody(const char *data, int64_t length) {
+  int64_t pos = 0;
+  while ((pos < length) && (chunk_state_ != CHUNK_BODY_DONE)) {
+    if (chunk_state_ == CHUNK_DATA) { // the bulk of the body, skipped over in one go
+      int64_t skipped = std::min(chunk_remaining_, length - pos);
+      pos += skipped;
+      chunk_remaining_ -= skipped;
+      if (!chunk_remaining_) {
+        chunk_state_ = CHUNK_DATA_CR;
+      }
+      continue;
+    }
+    char c = data[pos++];
+    bool malformed = false;
+    switch (chunk_state_) {
+    case CHUNK_SIZE:
+      if (hexDigitValue(c) >= 0) {
+        malformed = (chunk_remaining_ > (INT64_MAX >> 4));
+        chunk_remaining_ = (chunk_remaining_ << 4) + hexDigitValue(c);
+      } else if (c == '\r') {
+        chunk_state_ = CHUNK_SIZE_LF;
+      } else if ((c == ';') || (c == ' ') || (c == '\t')) {
+        chunk_state_ = CHUNK_EXTENSION;
+      } else {
+        malformed = true;
+      }
+      break;
+    case CHUNK_EXTENSION:
+      if (c == '\r') {
+        chunk_state_ = CHUNK_SIZE_LF;
+      }
+      break;
+    case CHUNK_SIZE_LF:
+      malformed = (c != '\n');
+      chunk_state_ = chunk_remaining_ ? CHUNK_DATA : CHUNK_TRAILER_LINE_START;
+      break;
+    case CHUNK_DATA_CR:
+      malformed = (c != '\r');
+      chunk_state_ = CHUNK_DATA_LF;
+      break;
+    case CHUNK_DATA_LF:
+      malformed = (c != '\n');
+      chunk_state_ = CHUNK_SIZE;
+      break;
+    case CHUNK_TRAILER_LINE_START:
+      chunk_state_ = (c == '\r') ? CHUNK_TRAILER_END_LF : CHUNK_TRAILER_LINE;
+      break;
+    case CHUNK_TRAILER_LINE:
+      if (c == '\n') {
+        chunk_state_ = CHUNK_TRAILER_LINE_START;
+      }
+      break;
+    case CHUNK_TRAILER_END_LF:
+      malformed = (c != '\n');
+      chunk_state_ = CHUNK_BODY_DONE;
+      break;
+    case CHUNK_DATA:
+    case CHUNK_BODY_DONE:
+      break;
+    }
+    if (malformed) {
+      // waiting for more would only wait for the connection to time out, the request ends here instead
+      LOG_ERROR("Malformed chunked request body of intercepted tshttptxn=%p after %lld bytes", txn_,
+                static_cast<long long>(request_body_read_ + pos));
+      chunk_state_ = CHUNK_BODY_DONE;
+    }
+  }
+  return pos;
+}
+
+void InterceptPluginState::dispatchInputComplete() {
+  if (!input_complete_) {
+    input_complete_ = true;
+    LOG_DEBUG("Request of intercepted tshttptxn=%p complete after %lld body bytes", txn_,
+              static_cast<long long>(request_body_read_));
+    plugin_.handleInputComplete();
+  }
+}
+
+void InterceptPluginState::sendHeaders() {
+  Headers &headers = response_.getHeaders();
+  if (!headers.count(HEADER_CONTENT_LENGTH) && !headers.count(HEADER_TRANSFER_ENCODING)) {
+    if (output_complete_) {
+      char length[24];
+      snprintf(length, sizeof(length), "%lld", static_cast<long long>(TSIOBufferReaderAvail(body_reader_)));
+      headers.set(HEADER_CONTENT_LENGTH, length);
+    } else {
+      headers.set(HEADER_CONNECTION, "close"); // the end of the connection ends the body
+    }
+  }
+  int reason_length = 0;
+  TSHttpHdrReasonGet(response_hdr_buf_, response_hdr_loc_, &reason_length);
+  if (!reason_length) {
+    const char *reason = TSHttpHdrReasonLookup(TSHttpHdrStatusGet(response_hdr_buf_, response_hdr_loc_));
+    if (reason) {
+      TSHttpHdrReasonSet(response_hdr_buf_, response_hdr_loc_, reason, strlen(reason));
+    }
+  }
+  TSHttpHdrPrint(response_hdr_buf_, response_hdr_loc_, output_buffer_);
+  bytes_written_ += TSHttpHdrLengthGet(response_hdr_buf_, response_hdr_loc_);
+  // the body blocks are shared with the output buffer, not copied
+  int64_t body_length = TSIOBufferReaderAvail(body_reader_);
+  if (body_length) {
+    TSIOBufferCopy(output_buffer_, body_reader_, body_length, 0);
+    TSIOBufferReaderConsume(body_reader_, body_length);
+    bytes_written_ += body_length;
+  }
+  headers_sent_ = true;
+  LOG_DEBUG("Sent response headers of intercepted tshttptxn=%p with %lld body bytes", txn_,
+            static_cast<long long>(body_length));
+}
+
+void InterceptPluginState::startOutput() {
+  if (!net_vc_ || !headers_sent_) {
+    return;
+  }
+  if (!output_vio_) {
+    output_vio_ = TSVConnWrite(net_vc_, cont_, output_reader_, output_complete_ ? bytes_written_ : INT64_MAX);
+    return;
+  }
+  if (output_complete_) {
+    TSVIONBytesSet(output_vio_, bytes_written_);
+  }
+  TSVIOReenable(output_vio_);
+}
+
+size_t InterceptPluginState::writeBody(const char *data, size_t length) {
+  if (output_complete_) {
+    LOG_ERROR("Response of intercepted tshttptxn=%p is already complete", txn_);
+    return 0;
+  }
+  if (!length) {
+    return 0;
+  }
+  if (!headers_sent_) {
+    TSIOBufferWrite(body_buffer_, data, length);
+    if (TSIOBufferReaderAvail(body_reader_) > static_cast<int64_t>(InterceptPlugin::BUFFERED_BODY_LIMIT)) {
+      sendHeaders();
+      startOutput();
+    }
+    return length;
+  }
+  int64_t written = TSIOBufferWrite(output_buffer_, data, length);
+  bytes_written_ += written;
+  startOutput();
+  return static_cast<size_t>(written);
+}
+
+bool InterceptPluginState::completeOutput() {
+  if (output_complete_) {
+    LOG_ERROR("Response of intercepted tshttptxn=%p is already complete", txn_);
+    return false;
+  }
+  output_complete_ = true;
+  if (!headers_sent_) {
+    sendHeaders();
+  }
+  startOutput();
+  LOG_DEBUG("Response of intercepted tshttptxn=%p complete with %lld bytes", txn_,
+            static_cast<long long>(bytes_written_));
+  return true;
+}
+
+namespace {
+
+int handleInterceptEvents(TSCont cont, TSEvent event, void *edata) {
+  InterceptPluginState *state = static_cast<InterceptPluginState *>(TSContDataGet(cont));
+  LOG_DEBUG("Intercept contp=%p event=%d edata=%p tshttptxn=%p", cont, event, edata, state->txn_);
+  switch (event) {
+  case TS_EVENT_NET_ACCEPT:
+    state->accept(static_cast<TSVConn>(edata));
+    break;
+  case TS_EVENT_NET_ACCEPT_FAILED:
+    LOG_ERROR("Intercepted connection of tshttptxn=%p couldn't be accepted", state->txn_);
+    break;
+  case TS_EVENT_VCONN_READ_READY:
+    state->readInput();
+    break;
+  case TS_EVENT_VCONN_READ_COMPLETE:
+  case TS_EVENT_VCONN_EOS:
+    if (state->input_vio_) {
+      state->readInput();
+      state->input_vio_ = NULL; // nothing more will be read
+      state->dispatchInputComplete();
+    }
+    break;
+  case TS_EVENT_VCONN_WRITE_READY:
+    break;
+  case TS_EVENT_VCONN_WRITE_COMPLETE:
+    state->closeConnection();
+    break;
+  case TS_EVENT_ERROR:
+  case TS_EVENT_VCONN_INACTIVITY_TIMEOUT:
+  case TS_EVENT_VCONN_ACTIVE_TIMEOUT:
+    LOG_ERROR("Intercepted connection of tshttptxn=%p failed with event %d", state->txn_, event);
+    state->closeConnection();
+    break;
+  default:
+    LOG_ERROR("Unexpected event %d on intercept contp=%p", event, cont);
+    break;
+  }
+  return 0;
+}
+
+}
+
+InterceptPlugin::InterceptPlugin(Transaction &transaction, Type type) : TransactionPlugin(transaction) {
+  state_ = new InterceptPluginState(*this, static_cast<TSHttpTxn>(transaction.getAtsHandle()));
+  StringView content_length = transaction.getClientRequest().getHeaders().getValueView(HEADER_CONTENT_LENGTH);
+  if (!content_length.isNull()) {
+    state_->request_body_length_ = strtoll(content_length.str().c_str(), NULL, 10);
+  } else if (!transaction.getClientRequest().getHeaders().getValueView(HEADER_TRANSFER_ENCODING).isNull()) {
+    string transfer_encoding = transaction.getClientRequest().getHeaders().getJoinedValues(HEADER_TRANSFER_ENCODING);
+    state_->request_body_length_ = isChunked(transfer_encoding) ? CHUNKED_BODY_LENGTH : UNKNOWN_BODY_LENGTH;
+  }
+  state_->cont_ = TSContCreate(handleInterceptEvents, state_->mutex_);
+  TSContDataSet(state_->cont_, static_cast<void *>(state_));
+  if (type == TRANSACTION_INTERCEPT) {
+    TSHttpTxnIntercept(state_->cont_, state_->txn_);
+  } else {
+    TSHttpTxnServerIntercept(state_->cont_, state_->txn_);
+  }
+  LOG_DEBUG("Created InterceptPlugin=%p contp=%p tshttptxn=%p type=%d", this, state_->cont_, state_->txn_, type);
+}
+
+InterceptPlugin::~InterceptPlugin() {
+  TSMutexLock(state_->mutex_);
+  state_->closeConnection();
+  TSContDestroy(state_->cont_);
+  TSMutexUnlock(state_->mutex_);
+  delete state_;
+}
+
+void InterceptPlugin::consume(const StringView &data) {
+}
+
+Response &InterceptPlugin::getResponse() {
+  return state_->response_;
+}
+
+size_t InterceptPlugin::produce(const char *data, size_t length) {
+  TSMutexLock(state_->mutex_);
+  size_t written = state_->writeBody(data, length);
+  TSMutexUnlock(state_->mutex_);
+  return written;
+}
+
+size_t InterceptPlugin::produce(const string &data) {
+  return produce(data.data(), data.length());
+}
+
+bool InterceptPlugin::setOutputComplete() {
+  TSMutexLock(state_->mutex_);
+  bool completed = state_->completeOutput();
+  TSMutexUnlock(state_->mutex_);
+  return completed;
+}
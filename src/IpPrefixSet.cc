@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file IpPrefixSet.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/IpPrefixSet.h"
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <netinet/in.h>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using namespace atscppapi::utils;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int NO_NODE = -1;
+const int IPV4_BITS = 32;
+const int IPV6_BITS = 128;
+
+/**
+ * A node of the trie holds the whole prefix leading to it, bits past length_ are zero; the bits
+ * between its parent's length and its own are the compressed path.
+ */
+struct PrefixNode {
+  unsigned char key_[16];
+  int length_;
+  int children_[2];
+  bool terminal_;
+  int value_;
+  PrefixNode(const unsigned char *key, int length) : length_(length), terminal_(false), value_(0) {
+    memset(key_, 0, sizeof(key_));
+    int full_bytes = length / 8;
+    memcpy(key_, key, full_bytes);
+    if (length % 8) {
+      key_[full_bytes] = key[full_bytes] & static_cast<unsigned char>(0xFF << (8 - length % 8));
+    }
+    children_[0] = children_[1] = NO_NODE;
+  }
+};
+
+inline int getBit(const unsigned char *key, int bit) {
+  return (key[bit / 8] >> (7 - bit % 8)) & 1;
+}
+
+/** @return Number of leading bits a and b have in common, at most max_bits. */
+int commonPrefixLength(const unsigned char *a, const unsigned char *b, int max_bits) {
+  int bits = 0;
+  for (int i = 0; bits < max_bits; ++i, bits += 8) {
+    unsigned char diff = a[i] ^ b[i];
+    if (diff) {
+      bits += __builtin_clz(diff) - 24; // diff is promoted to a 32 bit int
+      break;
+    }
+  }
+  return (bits < max_bits) ? bits : max_bits;
+}
+
+/**
+ * @return Pointer to the address bytes and their number of bits, with IPv4-mapped IPv6 addresses as IPv4;
+ *         NULL for other families.
+ */
+const unsigned char *getAddressBytes(const sockaddr *address, int &bits) {
+  static const unsigned char V4_MAPPED_PREFIX[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+  if (!address) {
+    return NULL;
+  }
+  if (address->sa_family == AF_INET) {
+    bits = IPV4_BITS;
+    return reinterpret_cast<const unsigned char *>(&reinterpret_cast<const sockaddr_in *>(address)->sin_addr);
+  }
+  if (address->sa_family == AF_INET6) {
+    const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(&reinterpret_cast<const sockaddr_in6 *>(address)->sin6_addr);
+    if (memcmp(bytes, V4_MAPPED_PREFIX, sizeof(V4_MAPPED_PREFIX)) == 0) {
+      bits = IPV4_BITS;
+      return bytes + sizeof(V4_MAPPED_PREFIX);
+    }
+    bits = IPV6_BITS;
+    return bytes;
+  }
+  return NULL;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::utils::IpPrefixSetState : noncopyable {
+  vector<PrefixNode> nodes_; // children refer to their index, nodes_[0] and [1] are the IPv4 and IPv6 roots
+  size_t prefix_count_;
+  IpPrefixSetState() : prefix_count_(0) {
+    init();
+  }
+  void init() {
+    static const unsigned char EMPTY_KEY[16] = { 0 };
+    nodes_.clear();
+    nodes_.push_back(PrefixNode(EMPTY_KEY, 0));
+    nodes_.push_back(PrefixNode(EMPTY_KEY, 0));
+    prefix_count_ = 0;
+  }
+  int addNode(const unsigned char *key, int length) {
+    nodes_.push_back(PrefixNode(key, length));
+    return static_cast<int>(nodes_.size() - 1);
+  }
+  void setTerminal(int node, int value) {
+    if (!nodes_[node].terminal_) {
+      nodes_[node].terminal_ = true;
+      ++prefix_count_;
+    }
+    nodes_[node].value_ = value;
+  }
+  void insert(int root, const unsigned char *key, int length, int value);
+  const PrefixNode *findLongest(int root, const unsigned char *key, int bits) const;
+};
+
+void IpPrefixSetState::insert(int root, const unsigned char *key, int length, int value) {
+  int node = root;
+  while (true) {
+    if (nodes_[node].length_ == length) {
+      setTerminal(node, value);
+      return;
+    }
+    int bit = getBit(key, nodes_[node].length_);
+    int child = nodes_[node].children_[bit];
+    if (child == NO_NODE) {
+      int leaf = addNode(key, length);
+      nodes_[node].children_[bit] = leaf;
+      setTerminal(leaf, value);
+      return;
+    }
+    int child_length = nodes_[child].length_;
+    int common = commonPrefixLength(key, nodes_[child].key_, (length < child_length) ? length : child_length);
+    if (common == child_length) {
+      node = child;
+      continue;
+    }
+    // the child's path diverges from the key within its compressed bits, split it where it does
+    int split = addNode(key, common);
+    nodes_[split].children_[getBit(nodes_[child].key_, common)] = child;
+    nodes_[node].children_[bit] = split;
+    if (common == length) {
+      setTerminal(split, value);
+    } else {
+      int leaf = addNode(key, length);
+      nodes_[split].children_[getBit(key, common)] = leaf;
+      setTerminal(leaf, value);
+    }
+    return;
+  }
+}
+
+const PrefixNode *IpPrefixSetState::findLongest(int root, const unsigned char *key, int bits) const {
+  const PrefixNode *best = NULL;
+  int node = root;
+  while (node != NO_NODE) {
+    const PrefixNode &current = nodes_[node];
+    if (commonPrefixLength(key, current.key_, current.length_) < current.length_) {
+      break;
+    }
+    if (current.terminal_) {
+      best = &current;
+    }
+    if (current.length_ == bits) {
+      break;
+    }
+    node = current.children_[getBit(key, current.length_)];
+  }
+  return best;
+}
+
+IpPrefixSet::IpPrefixSet() : state_(new IpPrefixSetState()) {
+}
+
+IpPrefixSet::~IpPrefixSet() {
+  delete state_;
+}
+
+bool IpPrefixSet::add(const sockaddr *address, int prefix_length, int value) {
+  int bits = 0;
+  const unsigned char *key = getAddressBytes(address, bits);
+  if (!key) {
+    LOG_ERROR("Unsupported address family for prefix");
+    return false;
+  }
+  if ((address->sa_family == AF_INET6) && (bits == IPV4_BITS)) {
+    prefix_length -= IPV6_BITS - IPV4_BITS; // a mapped prefix is counted over the whole IPv6 address
+  }
+  if ((prefix_length < 0) || (prefix_length > bits)) {
+    LOG_ERROR("Invalid prefix length %d", prefix_length);
+    return false;
+  }
+  state_->insert((bits == IPV4_BITS) ? 0 : 1, key, prefix_length, value);
+  return true;
+}
+
+bool IpPrefixSet::add(const string &cidr, int value) {
+  string address = cidr;
+  int prefix_length = -1;
+  size_t slash = cidr.find('/');
+  if (slash != string::npos) {
+    address = cidr.substr(0, slash);
+    const char *length_str = cidr.c_str() + slash + 1;
+    char *end;
+    long parsed = strtol(length_str, &end, 10);
+    if (!*length_str || *end || (parsed < 0) || (parsed > IPV6_BITS)) {
+      LOG_ERROR("Invalid prefix length in [%s]", cidr.c_str());
+      return false;
+    }
+    prefix_length = static_cast<int>(parsed);
+  }
+
+  sockaddr_in6 storage; // large enough for either family
+  memset(&storage, 0, sizeof(storage));
+  sockaddr *sa = reinterpret_cast<sockaddr *>(&storage);
+  if (inet_pton(AF_INET, address.c_str(), &reinterpret_cast<sockaddr_in *>(sa)->sin_addr) == 1) {
+    sa->sa_family = AF_INET;
+    if (prefix_length < 0) {
+      prefix_length = IPV4_BITS;
+    }
+  } else if (inet_pton(AF_INET6, address.c_str(), &storage.sin6_addr) == 1) {
+    sa->sa_family = AF_INET6;
+    if (prefix_length < 0) {
+      prefix_length = IPV6_BITS;
+    }
+  } else {
+    LOG_ERROR("Invalid address in prefix [%s]", cidr.c_str());
+    return false;
+  }
+  if (!add(sa, prefix_length, value)) {
+    return false;
+  }
+  LOG_DEBUG("Added prefix [%s] with value %d", cidr.c_str(), value);
+  return true;
+}
+
+bool IpPrefixSet::find(const sockaddr *address, int &value) const {
+  int bits = 0;
+  const unsigned char *key = getAddressBytes(address, bits);
+  if (!key) {
+    return false;
+  }
+  const PrefixNode *node = state_->findLongest((bits == IPV4_BITS) ? 0 : 1, key, bits);
+  if (!node) {
+    return false;
+  }
+  value = node->value_;
+  return true;
+}
+
+bool IpPrefixSet::contains(const sockaddr *address) const {
+  int value;
+  return find(address, value);
+}
+
+size_t IpPrefixSet::size() const {
+  return state_->prefix_count_;
+}
+
+void IpPrefixSet::clear() {
+  state_->init();
+}
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file LogRecord.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * This file doesn't depend on Traffic Server, atscppapi_logdecode is built from it as well.
+ */
+
+#include "atscppapi/LogRecord.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+using atscppapi::LogRecord;
+using std::string;
+
+namespace {
+
+const unsigned char RECORD_MARKER = 0x1E;
+const unsigned char ESCAPE = 0x1B;
+const unsigned char VERSION = 1;
+
+const char TYPE_STRING = 's';
+const char TYPE_INT = 'i';
+const char TYPE_DOUBLE = 'd';
+const char TYPE_BOOL = 'b';
+
+void appendVarint(string &out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>((value & 0x7F) | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+void appendKey(string &out, char type, const string &key) {
+  out += type;
+  appendVarint(out, key.length());
+  out += key;
+}
+
+/** Reads the fields of a record back. */
+class Reader {
+public:
+  Reader(const string &data) : data_(data), position_(0) { }
+
+  bool atEnd() const { return position_ == data_.length(); }
+
+  bool readByte(unsigned char &byte) {
+    if (position_ >= data_.length()) {
+      return false;
+    }
+    byte = static_cast<unsigned char>(data_[position_++]);
+    return true;
+  }
+
+  bool readVarint(uint64_t &value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      unsigned char byte;
+      if (!readByte(byte)) {
+        return false;
+      }
+      value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readBytes(uint64_t length, const char *&bytes) {
+    if (length > data_.length() - position_) {
+      return false;
+    }
+    bytes = data_.data() + position_;
+    position_ += static_cast<size_t>(length);
+    return true;
+  }
+
+private:
+  const string &data_;
+  size_t position_;
+};
+
+void appendJsonString(string &json, const char *value, size_t length) {
+  json += '"';
+  for (size_t i = 0; i < length; ++i) {
+    unsigned char c = static_cast<unsigned char>(value[i]);
+    switch (c) {
+    case '"':
+      json += "\\\"";
+      break;
+    case '\\':
+      json += "\\\\";
+      break;
+    case '\n':
+      json += "\\n";
+      break;
+    case '\r':
+      json += "\\r";
+      break;
+    case '\t':
+      json += "\\t";
+      break;
+    default:
+      if (c < 0x20) {
+        char escaped[8];
+        snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+        json += escaped;
+      } else {
+        json += static_cast<char>(c);
+      }
+      break;
+    }
+  }
+  json += '"';
+}
+
+void appendJsonDouble(string &json, double value) {
+  if (value != value || value == HUGE_VAL || value == -HUGE_VAL) {
+    json += "null"; // JSON has no NaN or infinities
+    return;
+  }
+  char formatted[32];
+  snprintf(formatted, sizeof(formatted), "%.17g", value);
+  json += formatted;
+}
+
+/* Converts the fields of an unescaped record, everything after the length, to a JSON object. */
+bool fieldsToJson(const string &record, string &json) {
+  Reader reader(record);
+  unsigned char version;
+  uint64_t field_count;
+  if (!reader.readByte(version) || (version != VERSION) || !reader.readVarint(field_count)) {
+    return false;
+  }
+
+  json += '{';
+  for (uint64_t i = 0; i < field_count; ++i) {
+    unsigned char type;
+    uint64_t key_length;
+    const char *key;
+    if (!reader.readByte(type) || !reader.readVarint(key_length) || !reader.readBytes(key_length, key)) {
+      return false;
+    }
+    if (i) {
+      json += ',';
+    }
+    appendJsonString(json, key, static_cast<size_t>(key_length));
+    json += ':';
+
+    switch (type) {
+    case TYPE_STRING: {
+      uint64_t length;
+      const char *value;
+      if (!reader.readVarint(length) || !reader.readBytes(length, value)) {
+        return false;
+      }
+      appendJsonString(json, value, static_cast<size_t>(length));
+      break;
+    }
+    case TYPE_INT: {
+      uint64_t zigzag;
+      if (!reader.readVarint(zigzag)) {
+        return false;
+      }
+      int64_t value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+      char formatted[24];
+      snprintf(formatted, sizeof(formatted), "%lld", static_cast<long long>(value));
+      json += formatted;
+      break;
+    }
+    case TYPE_DOUBLE: {
+      const char *bytes;
+      if (!reader.readBytes(sizeof(uint64_t), bytes)) {
+        return false;
+      }
+      uint64_t bits = 0;
+      for (size_t b = 0; b < sizeof(bits); ++b) {
+        bits |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[b])) << (8 * b);
+      }
+      double value;
+      memcpy(&value, &bits, sizeof(value));
+      appendJsonDouble(json, value);
+      break;
+    }
+    case TYPE_BOOL: {
+      unsigned char value;
+      if (!reader.readByte(value)) {
+        return false;
+      }
+      json += value ? "true" : "false";
+      break;
+    }
+    default:
+      return false;
+    }
+  }
+  json += '}';
+  return reader.atEnd();
+}
+
+}
+
+LogRecord::LogRecord() : field_count_(0) {
+}
+
+LogRecord &LogRecord::addString(const string &key, const string &value) {
+  return addString(key, value.data(), value.length());
+}
+
+LogRecord &LogRecord::addString(const string &key, const char *value, size_t length) {
+  appendKey(fields_, TYPE_STRING, key);
+  appendVarint(fields_, length);
+  fields_.append(value, length);
+  ++field_count_;
+  return *this;
+}
+
+LogRecord &LogRecord::addInt(const string &key, int64_t value) {
+  appendKey(fields_, TYPE_INT, key);
+  appendVarint(fields_, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+  ++field_count_;
+  return *this;
+}
+
+LogRecord &LogRecord::addDouble(const string &key, double value) {
+  appendKey(fields_, TYPE_DOUBLE, key);
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  for (size_t b = 0; b < sizeof(bits); ++b) {
+    fields_ += static_cast<char>((bits >> (8 * b)) & 0xFF);
+  }
+  ++field_count_;
+  return *this;
+}
+
+LogRecord &LogRecord::addBool(const string &key, bool value) {
+  appendKey(fields_, TYPE_BOOL, key);
+  fields_ += static_cast<char>(value ? 1 : 0);
+  ++field_count_;
+  return *this;
+}
+
+void LogRecord::clear() {
+  fields_.clear();
+  field_count_ = 0;
+}
+
+void LogRecord::serialize(Format format, string &out) const {
+  string record;
+  record.reserve(fields_.length() + 16);
+  record += static_cast<char>(VERSION);
+  appendVarint(record, field_count_);
+  record += fields_;
+
+  if (format == FORMAT_JSON) {
+    fieldsToJson(record, out);
+    return;
+  }
+
+  string framed;
+  framed.reserve(record.length() + 10);
+  appendVarint(framed, record.length());
+  framed += record;
+
+  out.reserve(out.length() + framed.length() + framed.length() / 16 + 1);
+  out += static_cast<char>(RECORD_MARKER);
+  for (size_t i = 0; i < framed.length(); ++i) {
+    unsigned char c = static_cast<unsigned char>(framed[i]);
+    if (c == 0x00) {
+      out += static_cast<char>(ESCAPE);
+      out += '0';
+    } else if (c == '\n') {
+      out += static_cast<char>(ESCAPE);
+      out += '1';
+    } else if (c == ESCAPE) {
+      out += static_cast<char>(ESCAPE);
+      out += static_cast<char>(ESCAPE);
+    } else {
+      out += static_cast<char>(c);
+    }
+  }
+}
+
+bool LogRecord::decodeToJson(const char *line, size_t length, string &json) {
+  const char *marker = static_cast<const char *>(memchr(line, RECORD_MARKER, length));
+  if (!marker) {
+    return false;
+  }
+
+  string framed;
+  for (const char *p = marker + 1; p < line + length; ++p) {
+    unsigned char c = static_cast<unsigned char>(*p);
+    if (c == '\n') {
+      break;
+    }
+    if (c == ESCAPE) {
+      if (++p == line + length) {
+        return false;
+      }
+      if (*p == '0') {
+        framed += '\0';
+      } else if (*p == '1') {
+        framed += '\n';
+      } else if (static_cast<unsigned char>(*p) == ESCAPE) {
+        framed += static_cast<char>(ESCAPE);
+      } else {
+        return false;
+      }
+    } else {
+      framed += static_cast<char>(c);
+    }
+  }
+
+  Reader reader(framed);
+  uint64_t record_length;
+  const char *record;
+  if (!reader.readVarint(record_length) || !reader.readBytes(record_length, record) || !reader.atEnd()) {
+    return false;
+  }
+  string json_object;
+  if (!fieldsToJson(string(record, static_cast<size_t>(record_length)), json_object)) {
+    return false;
+  }
+  json += json_object;
+  return true;
+}
@@ -20,24 +20,85 @@
  */
 
 #include "atscppapi/Logger.h"
+#include "atscppapi/LogRecord.h"
 #include <cstdarg>
 #include <vector>
 #include <cstdio>
 #include <string>
 #include <cstring>
+#include <cstdlib>
+#include <sched.h>
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
+#include "atscppapi/Async.h"
+#include "atscppapi/AsyncTimer.h"
+#include "StatShards.h"
 #include "logging_internal.h"
 
 using std::vector;
 using std::string;
 
 using atscppapi::Logger;
+using namespace atscppapi;
+
+namespace {
+
+const int DEFAULT_BUFFER_SIZE_FOR_VARARGS = 8*1024;
+
+// Traffic Server formats a TSTextLogObjectWrite() into an entry buffer of 16KB and cuts off what doesn't fit, a
+// batch of several records stays well below that.
+const size_t MAX_BATCH_SIZE = 8*1024;
+
+/**
+ * A ring of length prefixed records, written by the threads of one shard and read by the flusher. Threads
+ * only share a ring beyond MAX_STAT_SHARDS threads, writing_ keeps them apart when they do.
+ */
+struct LogRing {
+  char *data_;
+  size_t mask_;
+  volatile uint64_t head_; // the next byte the flusher reads, only the flusher moves it.
+  volatile uint64_t tail_; // the next byte a writer writes, only writers move it.
+  volatile int writing_;
+
+  LogRing(size_t capacity) : data_(static_cast<char *>(malloc(capacity))), mask_(capacity - 1), head_(0), tail_(0),
+                             writing_(0) { }
+  ~LogRing() { free(data_); }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  void copyIn(uint64_t position, const void *from, size_t length) {
+    size_t offset = static_cast<size_t>(position & mask_);
+    size_t first = (length < capacity() - offset) ? length : (capacity() - offset);
+    memcpy(data_ + offset, from, first);
+    memcpy(data_, static_cast<const char *>(from) + first, length - first);
+  }
+
+  void copyOut(uint64_t position, void *to, size_t length) const {
+    size_t offset = static_cast<size_t>(position & mask_);
+    size_t first = (length < capacity() - offset) ? length : (capacity() - offset);
+    memcpy(to, data_ + offset, first);
+    memcpy(static_cast<char *>(to) + first, data_, length - first);
+  }
+};
+
+const int64_t NANOSECONDS_PER_SECOND = 1000000000LL;
+
+__thread uint32_t sample_state = 0; // xorshift state of the calling thread, seeded on first use.
+
+size_t roundUpToPowerOfTwo(size_t size) {
+  size_t rounded = 1;
+  while (rounded < size) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
+
+}
 
 /**
  * @private
  */
-struct atscppapi::LoggerState: noncopyable  {
+struct atscppapi::LoggerState: AsyncReceiver<AsyncTimer>  {
   std::string filename_;
   bool add_timestamp_;
   bool rename_file_;
@@ -46,10 +107,170 @@ struct atscppapi::LoggerState: noncopyable  {
   int rolling_interval_seconds_;
   TSTextLogObject text_log_obj_;
   bool initialized_;
+  LogRecord::Format record_format_;
+
+  // Only used once enableAsyncWrites() was called.
+  bool async_;
+  size_t ring_capacity_;
+  Logger::OverflowPolicy overflow_policy_;
+  LogRing *volatile rings_[MAX_STAT_SHARDS]; // allocated by the first thread logging into them
+  volatile int64_t dropped_records_;
+  volatile int draining_;
+  AsyncTimer *flush_timer_;
 
   LoggerState() : add_timestamp_(false), rename_file_(false), level_(Logger::LOG_LEVEL_NO_LOG), rolling_enabled_(false),
-                  rolling_interval_seconds_(-1), text_log_obj_(NULL), initialized_(false) { };
-  ~LoggerState() { };
+                  rolling_interval_seconds_(-1), text_log_obj_(NULL), initialized_(false),
+                  record_format_(LogRecord::FORMAT_BINARY), async_(false),
+                  ring_capacity_(0), overflow_policy_(Logger::OVERFLOW_DROP), dropped_records_(0), draining_(0),
+                  flush_timer_(NULL) {
+    memset(const_cast<LogRing **>(rings_), 0, sizeof(rings_));
+  };
+
+  ~LoggerState() {
+    delete flush_timer_;
+    for (int i = 0; i < MAX_STAT_SHARDS; ++i) {
+      delete rings_[i];
+    }
+  };
+
+  LogRing *getRing() {
+    int index = getStatShard();
+    LogRing *ring = rings_[index];
+    if (!ring) {
+      LogRing *new_ring = new LogRing(ring_capacity_);
+      ring = __sync_val_compare_and_swap(&rings_[index], static_cast<LogRing *>(NULL), new_ring);
+      if (ring) {
+        delete new_ring; // another thread of this shard was first
+      } else {
+        ring = new_ring;
+      }
+    }
+    return ring;
+  }
+
+  /* Appends a record to the ring of the calling thread, it is written to the log by the next drain(). */
+  void append(const char *record, uint32_t length) {
+    LogRing *ring = getRing();
+    size_t needed = sizeof(length) + length;
+    if (needed > ring->capacity()) {
+      __sync_fetch_and_add(&dropped_records_, 1);
+      LOG_ERROR("Unable to log a message of %d bytes to '%s', it's larger than the buffer of %d bytes.", length,
+                filename_.c_str(), ring->capacity());
+      return;
+    }
+
+    while (__sync_lock_test_and_set(&ring->writing_, 1)) {
+      sched_yield();
+    }
+    uint64_t tail = ring->tail_;
+    while (ring->capacity() - (tail - ring->head_) < needed) {
+      if (overflow_policy_ == Logger::OVERFLOW_DROP) {
+        __sync_lock_release(&ring->writing_);
+        __sync_fetch_and_add(&dropped_records_, 1);
+        return;
+      }
+      sched_yield(); // OVERFLOW_BLOCK, wait for the flusher to make room.
+    }
+    ring->copyIn(tail, &length, sizeof(length));
+    ring->copyIn(tail + sizeof(length), record, length);
+    __sync_synchronize(); // the record must be complete before the flusher can see it.
+    ring->tail_ = tail + needed;
+    __sync_lock_release(&ring->writing_);
+  }
+
+  /* Writes out everything buffered so far, several records per write unless each needs its own timestamp. */
+  void drain() {
+    if (__sync_lock_test_and_set(&draining_, 1)) {
+      return; // someone else is already at it.
+    }
+    string batch;
+    string record;
+    for (int i = 0; i < MAX_STAT_SHARDS; ++i) {
+      LogRing *ring = rings_[i];
+      if (!ring) {
+        continue;
+      }
+      uint64_t head = ring->head_;
+      uint64_t tail = ring->tail_;
+      __sync_synchronize();
+      while (head < tail) {
+        uint32_t length;
+        ring->copyOut(head, &length, sizeof(length));
+        record.resize(length);
+        if (length) {
+          ring->copyOut(head + sizeof(length), &record[0], length);
+        }
+        head += sizeof(length) + length;
+
+        if (add_timestamp_) {
+          TSTextLogObjectWrite(text_log_obj_, const_cast<char*>("%s"), record.c_str());
+        } else {
+          if (!batch.empty() && (batch.length() + 1 + record.length() > MAX_BATCH_SIZE)) {
+            TSTextLogObjectWrite(text_log_obj_, const_cast<char*>("%s"), batch.c_str());
+            batch.clear();
+          }
+          if (!batch.empty()) {
+            batch += '\n';
+          }
+          batch += record; // a record longer than a batch is written by itself
+        }
+      }
+      __sync_synchronize(); // we're done reading before writers may reuse the space.
+      ring->head_ = head;
+    }
+    if (!batch.empty()) {
+      TSTextLogObjectWrite(text_log_obj_, const_cast<char*>("%s"), batch.c_str());
+    }
+    __sync_lock_release(&draining_);
+  }
+
+  void handleAsyncComplete(AsyncTimer &) {
+    drain();
+  }
+
+  /* Formats a message prefixed with its level and writes or buffers it, messages of any length are kept. */
+  void write(const char *level, const char *fmt, va_list ap) {
+    char stack_buffer[DEFAULT_BUFFER_SIZE_FOR_VARARGS];
+    char *buffer = stack_buffer;
+    size_t size = sizeof(stack_buffer);
+    int prefix_length = snprintf(buffer, size, "[%s] ", level);
+    va_list ap_copy;
+    va_copy(ap_copy, ap);
+    int n = vsnprintf(buffer + prefix_length, size - prefix_length, fmt, ap_copy);
+    va_end(ap_copy);
+    if (n < 0) {
+      LOG_ERROR("Unable to format %s message to '%s'.", level, filename_.c_str());
+      return;
+    }
+
+    vector<char> heap_buffer;
+    if (static_cast<size_t>(prefix_length + n) >= size) {
+      size = prefix_length + n + 1;
+      heap_buffer.resize(size);
+      buffer = &heap_buffer[0];
+      memcpy(buffer, stack_buffer, prefix_length);
+      vsnprintf(buffer + prefix_length, size - prefix_length, fmt, ap);
+    }
+
+    LOG_DEBUG("logging a %s to '%s' with length %d", level, filename_.c_str(), n);
+    emit(buffer, prefix_length + n);
+  }
+
+  void writeFormatted(const char *level, const char *fmt, ...) ATSCPPAPI_PRINTFLIKE(3,4) {
+    va_list ap;
+    va_start(ap, fmt);
+    write(level, fmt, ap);
+    va_end(ap);
+  }
+
+  /* Writes or buffers a NUL terminated line. */
+  void emit(const char *line, size_t length) {
+    if (async_) {
+      append(line, static_cast<uint32_t>(length));
+    } else {
+      TSTextLogObjectWrite(text_log_obj_, const_cast<char*>("%s"), line);
+    }
+  }
 };
 
 namespace {
@@ -68,6 +289,9 @@ Logger::Logger() {
 
 Logger::~Logger() {
   if (state_->initialized_ && state_->text_log_obj_) {
+    if (state_->async_) {
+      state_->drain();
+    }
     TSTextLogObjectDestroy(state_->text_log_obj_);
   }
 
@@ -161,8 +385,86 @@ bool Logger::isRollingEnabled() const {
   return state_->rolling_enabled_;
 }
 
+bool Logger::enableAsyncWrites(size_t buffer_size, OverflowPolicy overflow_policy, int flush_interval_ms) {
+  if (!state_->initialized_ || !state_->text_log_obj_) {
+    LOG_ERROR("Not initialized!");
+    return false;
+  }
+  if (state_->async_) {
+    LOG_ERROR("Asynchronous writes are already enabled for log [%s]", state_->filename_.c_str());
+    return false;
+  }
+  state_->ring_capacity_ = roundUpToPowerOfTwo(buffer_size);
+  state_->overflow_policy_ = overflow_policy;
+  state_->flush_timer_ = new AsyncTimer(AsyncTimer::TYPE_PERIODIC, flush_interval_ms, 0, ASYNC_THREAD_POOL_TASK);
+  Async::execute<AsyncTimer>(state_, state_->flush_timer_, shared_ptr<Mutex>());
+  state_->async_ = true;
+  LOG_DEBUG("Enabled asynchronous writes for log [%s] with %d byte buffers flushed every %d ms",
+            state_->filename_.c_str(), state_->ring_capacity_, flush_interval_ms);
+  return true;
+}
+
+void Logger::setRecordFormat(LogRecord::Format format) {
+  state_->record_format_ = format;
+}
+
+void Logger::logRecord(const LogRecord &record, LogLevel level) {
+  if (state_->level_ <= level) {
+    string line;
+    record.serialize(state_->record_format_, line);
+    state_->emit(line.c_str(), line.length());
+  }
+}
+
+int64_t Logger::getDroppedRecordCount() const {
+  return state_->dropped_records_;
+}
+
+bool Logger::isLevelEnabled(LogLevel level) const {
+  return state_->level_ <= level;
+}
+
+bool Logger::checkRateLimit(LogRateLimit &limit, const char *file, int line) {
+  int64_t now = TShrtime() / NANOSECONDS_PER_SECOND;
+  int64_t window = limit.window_;
+  if ((now != window) && __sync_bool_compare_and_swap(&limit.window_, window, now)) {
+    // We're the first in a new second, start counting again and report what the last one suppressed.
+    __sync_lock_test_and_set(&limit.count_, 0);
+    int64_t suppressed = __sync_lock_test_and_set(&limit.suppressed_, 0);
+    if (suppressed) {
+      state_->writeFormatted("INFO", "[%s:%d] suppressed %lld messages over the limit of %d per second.", file, line,
+                             static_cast<long long>(suppressed), limit.per_second_);
+    }
+  }
+
+  if (__sync_add_and_fetch(&limit.count_, 1) <= limit.per_second_) {
+    return true;
+  }
+  __sync_fetch_and_add(&limit.suppressed_, 1);
+  return false;
+}
+
+bool Logger::sample(unsigned int one_in) {
+  if (one_in <= 1) {
+    return true;
+  }
+  uint32_t x = sample_state;
+  if (!x) {
+    // seed every thread differently, xorshift must never start at 0.
+    x = static_cast<uint32_t>(TShrtime() ^ reinterpret_cast<uintptr_t>(&sample_state)) | 1;
+  }
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  sample_state = x;
+  return (x % one_in) == 0;
+}
+
 void Logger::flush() {
   if (state_->initialized_) {
+    if (state_->async_) {
+      state_->drain();
+    }
     TSTextLogObjectFlush(state_->text_log_obj_);
   } else {
     LOG_ERROR("Not initialized!");
@@ -170,24 +472,12 @@ void Logger::flush() {
 }
 
 namespace {
-const int DEFAULT_BUFFER_SIZE_FOR_VARARGS = 8*1024;
 
 #define TS_TEXT_LOG_OBJECT_WRITE(level) \
-    char buffer[DEFAULT_BUFFER_SIZE_FOR_VARARGS]; \
-    int n; \
     va_list ap; \
-    while (true) { \
-     va_start(ap, fmt); \
-     n = vsnprintf (&buffer[0], sizeof(buffer), fmt, ap); \
-     va_end(ap); \
-     if (n > -1 && n < sizeof(buffer)) { \
-       LOG_DEBUG("logging a " level " to '%s' with length %d", state_->filename_.c_str(), n); \
-       TSTextLogObjectWrite(state_->text_log_obj_, const_cast<char*>("[" level "] %s"), buffer); \
-     } else { \
-       LOG_ERROR("Unable to log " level " message to '%s' due to size exceeding %d bytes.", state_->filename_.c_str(), sizeof(buffer)); \
-     } \
-     return; \
-    }
+    va_start(ap, fmt); \
+    state_->write(level, fmt, ap); \
+    va_end(ap);
 
 } /* end anonymous namespace */
 
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file MemoryAccounting.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/MemoryAccounting.h"
+#include <ts/ts.h>
+#include "atscppapi/Arena.h"
+#include "atscppapi/HistogramStat.h"
+#include "atscppapi/Transaction.h"
+#include "utils_internal.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+const char MEMORY_DEBUG_TAG[] = "atscppapi.memory";
+
+/** What the hooks of one plugin allocated during a transaction. */
+struct PluginMemory {
+  MemoryAccounting *accounting_;
+  const Plugin *plugin_;
+  size_t arena_bytes_;
+  size_t arena_allocations_;
+  PluginMemory *next_;
+};
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::MemoryAccountingState : noncopyable {
+  HistogramStat transaction_arena_bytes_;
+  HistogramStat transaction_arena_allocations_;
+  HistogramStat transaction_heap_bytes_;
+  HistogramStat transaction_peak_buffered_bytes_;
+  HistogramStat plugin_arena_bytes_;
+  HistogramStat plugin_arena_allocations_;
+};
+
+/**
+ * @private
+ *
+ * Lives in the transaction's Arena, created when the transaction is first accounted.
+ */
+struct atscppapi::TransactionMemoryState {
+  MemoryAccounting *accounting_; // whose stats get the totals, NULL unless startAccounting() was called.
+  PluginMemory *plugins_;
+  int64_t peak_buffered_bytes_;
+};
+
+MemoryAccounting::MemoryAccounting(const string &name, int aggregation_interval_ms)
+    : state_(new MemoryAccountingState()) {
+  state_->transaction_arena_bytes_.init(name + ".transaction.arena_bytes", aggregation_interval_ms);
+  state_->transaction_arena_allocations_.init(name + ".transaction.arena_allocations", aggregation_interval_ms);
+  state_->transaction_heap_bytes_.init(name + ".transaction.heap_bytes", aggregation_interval_ms);
+  state_->transaction_peak_buffered_bytes_.init(name + ".transaction.peak_buffered_bytes", aggregation_interval_ms);
+  state_->plugin_arena_bytes_.init(name + ".plugin.arena_bytes", aggregation_interval_ms);
+  state_->plugin_arena_allocations_.init(name + ".plugin.arena_allocations", aggregation_interval_ms);
+  LOG_DEBUG("Created memory accounting stats for '%s'", name.c_str());
+}
+
+MemoryAccounting::~MemoryAccounting() {
+  delete state_;
+}
+
+void MemoryAccounting::startAccounting(Transaction &transaction) {
+  TransactionMemoryState *memory = getTransactionMemory(transaction);
+  if (!memory->accounting_) {
+    memory->accounting_ = this;
+    LOG_DEBUG("Accounting memory of tshttptxn=%p", transaction.getAtsHandle());
+  }
+}
+
+TransactionMemoryState *MemoryAccounting::getTransactionMemory(Transaction &transaction) {
+  TransactionMemoryState *memory = utils::internal::getTransactionMemory(transaction);
+  if (!memory) {
+    memory = static_cast<TransactionMemoryState *>(transaction.getArena().allocate(sizeof(TransactionMemoryState)));
+    memory->accounting_ = NULL;
+    memory->plugins_ = NULL;
+    memory->peak_buffered_bytes_ = 0;
+    utils::internal::setTransactionMemory(transaction, memory);
+  }
+  return memory;
+}
+
+void MemoryAccounting::recordPluginMemory(Transaction &transaction, MemoryAccounting *accounting, const Plugin *plugin,
+                                          size_t arena_bytes, size_t arena_allocations) {
+  TransactionMemoryState *memory = getTransactionMemory(transaction);
+  PluginMemory *plugin_memory = memory->plugins_;
+  while (plugin_memory && (plugin_memory->plugin_ != plugin)) {
+    plugin_memory = plugin_memory->next_;
+  }
+  if (!plugin_memory) {
+    plugin_memory = static_cast<PluginMemory *>(transaction.getArena().allocate(sizeof(PluginMemory)));
+    plugin_memory->accounting_ = accounting;
+    plugin_memory->plugin_ = plugin;
+    plugin_memory->arena_bytes_ = 0;
+    plugin_memory->arena_allocations_ = 0;
+    plugin_memory->next_ = memory->plugins_;
+    memory->plugins_ = plugin_memory;
+  }
+  plugin_memory->arena_bytes_ += arena_bytes;
+  plugin_memory->arena_allocations_ += arena_allocations;
+}
+
+bool MemoryAccounting::isAccounted(Transaction &transaction) {
+  TransactionMemoryState *memory = utils::internal::getTransactionMemory(transaction);
+  return memory && memory->accounting_;
+}
+
+void MemoryAccounting::recordBufferedBytes(Transaction &transaction, int64_t peak_buffered_bytes) {
+  TransactionMemoryState *memory = getTransactionMemory(transaction);
+  if (peak_buffered_bytes > memory->peak_buffered_bytes_) {
+    memory->peak_buffered_bytes_ = peak_buffered_bytes;
+  }
+}
+
+void MemoryAccounting::finishTransaction(Transaction &transaction) {
+  TransactionMemoryState *memory = utils::internal::getTransactionMemory(transaction);
+  if (!memory) {
+    return;
+  }
+  const Arena &arena = transaction.getArena();
+  bool dump = TSIsDebugTagSet(MEMORY_DEBUG_TAG);
+  if (memory->accounting_) {
+    MemoryAccountingState *state = memory->accounting_->state_;
+    state->transaction_arena_bytes_.record(static_cast<int64_t>(arena.getBytesAllocated()));
+    state->transaction_arena_allocations_.record(static_cast<int64_t>(arena.getAllocationCount()));
+    state->transaction_heap_bytes_.record(static_cast<int64_t>(arena.getBytesReserved()));
+    state->transaction_peak_buffered_bytes_.record(memory->peak_buffered_bytes_);
+    if (dump) {
+      TSDebug(MEMORY_DEBUG_TAG, "tshttptxn=%p closing: arena_bytes=%zu arena_allocations=%zu heap_bytes=%zu "
+              "peak_buffered_bytes=%lld", transaction.getAtsHandle(), arena.getBytesAllocated(),
+              arena.getAllocationCount(), arena.getBytesReserved(),
+              static_cast<long long>(memory->peak_buffered_bytes_));
+    }
+  }
+  for (PluginMemory *plugin_memory = memory->plugins_; plugin_memory; plugin_memory = plugin_memory->next_) {
+    MemoryAccountingState *state = plugin_memory->accounting_->state_;
+    state->plugin_arena_bytes_.record(static_cast<int64_t>(plugin_memory->arena_bytes_));
+    state->plugin_arena_allocations_.record(static_cast<int64_t>(plugin_memory->arena_allocations_));
+    if (dump) {
+      TSDebug(MEMORY_DEBUG_TAG, "tshttptxn=%p plugin=%p arena_bytes=%zu arena_allocations=%zu",
+              transaction.getAtsHandle(), plugin_memory->plugin_, plugin_memory->arena_bytes_,
+              plugin_memory->arena_allocations_);
+    }
+  }
+}
@@ -17,11 +17,38 @@
  */
 #include "atscppapi/Plugin.h"
 
-const std::string atscppapi::HOOK_TYPE_STRINGS[] = { std::string("HOOK_READ_REQUEST_HEADERS_PRE_REMAP"),
-                                                     std::string("HOOK_READ_REQUEST_HEADERS_POST_REMAP"),
-                                                     std::string("HOOK_SEND_REQUEST_HEADERS"),
-                                                     std::string("HOOK_READ_RESPONSE_HEADERS"),
-                                                     std::string("HOOK_SEND_RESPONSE_HEADERS"),
-                                                     std::string("HOOK_OS_DNS")
-                                                      };
+using atscppapi::Plugin;
+using atscppapi::StringView;
 
+namespace {
+
+#define HOOK_TYPES(X) \
+  X("HOOK_READ_REQUEST_HEADERS_PRE_REMAP") X("HOOK_READ_REQUEST_HEADERS_POST_REMAP") X("HOOK_SEND_REQUEST_HEADERS") \
+  X("HOOK_READ_RESPONSE_HEADERS") X("HOOK_SEND_RESPONSE_HEADERS") X("HOOK_OS_DNS") X("HOOK_CACHE_LOOKUP_COMPLETE")
+
+/** A POD, so the table is built by the compiler rather than by a static constructor. */
+struct HookTypeName {
+  const char *name_;
+  size_t length_;
+};
+
+#define HOOK_TYPE_NAME(name) { name, sizeof(name) - 1 },
+const HookTypeName HOOK_TYPE_NAMES[] = { HOOK_TYPES(HOOK_TYPE_NAME) };
+#undef HOOK_TYPE_NAME
+
+const size_t HOOK_TYPE_COUNT = sizeof(HOOK_TYPE_NAMES) / sizeof(HOOK_TYPE_NAMES[0]);
+
+const char UNKNOWN_HOOK_TYPE[] = "UNKNOWN";
+
+}
+
+#define HOOK_TYPE_STRING(name) std::string(name),
+const std::string atscppapi::HOOK_TYPE_STRINGS[] = { HOOK_TYPES(HOOK_TYPE_STRING) };
+#undef HOOK_TYPE_STRING
+
+StringView atscppapi::getHookTypeName(Plugin::HookType hook_type) {
+  if (static_cast<size_t>(hook_type) >= HOOK_TYPE_COUNT) {
+    return StringView(UNKNOWN_HOOK_TYPE, sizeof(UNKNOWN_HOOK_TYPE) - 1);
+  }
+  return StringView(HOOK_TYPE_NAMES[hook_type].name_, HOOK_TYPE_NAMES[hook_type].length_);
+}
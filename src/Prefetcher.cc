@@ -0,0 +1,356 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Prefetcher.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/Prefetcher.h"
+#include <ts/ts.h>
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <set>
+#include <vector>
+#include "atscppapi/Mutex.h"
+#include "atscppapi/ShardedLruCache.h"
+#include "atscppapi/StringView.h"
+#include "atscppapi/Transaction.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::map;
+using std::set;
+using std::vector;
+
+namespace {
+
+const size_t ORIGIN_SWEEP_THRESHOLD = 1024; // idle origins are only dropped once there are this many
+const size_t RECENT_ENTRY_OVERHEAD = 64; // what a recent url costs besides its characters
+const int DEFAULT_PREFETCH_TIMEOUT_MS = 10000;
+
+const int64_t NANOSECONDS_PER_SECOND = 1000000000;
+
+const char *FORWARDED_HEADERS[] = { "User-Agent", "Accept", "Accept-Encoding", "Accept-Language" };
+
+bool startsWithIgnoreCase(const string &str, const char *prefix) {
+  size_t length = strlen(prefix);
+  return (str.length() >= length) && (strncasecmp(str.data(), prefix, length) == 0);
+}
+
+/**
+ * @return The position after the scheme and authority of an absolute url, npos if it isn't one with a host.
+ */
+size_t findOriginEnd(const string &url) {
+  size_t authority = url.find("://");
+  if ((authority == string::npos) || (authority == 0)) {
+    return string::npos;
+  }
+  authority += 3;
+  size_t end = std::min(url.find_first_of("/?#", authority), url.length());
+  return (end > authority) ? end : string::npos;
+}
+
+bool isSpace(char c) {
+  return (c == ' ') || (c == '\t');
+}
+
+StringView trim(const StringView &value) {
+  size_t begin = 0;
+  size_t end = value.length();
+  while ((begin < end) && isSpace(value[begin])) {
+    ++begin;
+  }
+  while ((end > begin) && isSpace(value[end - 1])) {
+    --end;
+  }
+  return value.substr(begin, end - begin);
+}
+
+/**
+ * @return true if the parameters of a link, e.g. <tt>; rel="prefetch next"</tt>, ask for it to be prefetched.
+ */
+bool isPrefetchLink(const StringView &params) {
+  for (size_t begin = 0; begin < params.length();) {
+    size_t end = std::min(params.find(';', begin), params.length());
+    StringView param = trim(params.substr(begin, end - begin));
+    begin = end + 1;
+    size_t equals = param.find('=');
+    if ((equals == StringView::npos) || !trim(param.substr(0, equals)).caseEquals("rel")) {
+      continue;
+    }
+    StringView rel = trim(param.substr(equals + 1));
+    if ((rel.length() >= 2) && (rel[0] == '"') && (rel[rel.length() - 1] == '"')) {
+      rel = rel.substr(1, rel.length() - 2);
+    }
+    for (size_t token_begin = 0; token_begin < rel.length();) {
+      size_t token_end = std::min(rel.find(' ', token_begin), rel.length());
+      StringView token = rel.substr(token_begin, token_end - token_begin);
+      if (token.caseEquals("prefetch") || token.caseEquals("preload")) {
+        return true;
+      }
+      token_begin = token_end + 1;
+    }
+  }
+  return false;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::PrefetcherState : noncopyable {
+  /** A token bucket, refilled at origin_rate_ per second up to origin_burst_. */
+  struct OriginBucket {
+    double tokens_;
+    int64_t refill_time_;
+  };
+
+  Prefetcher::Options options_;
+  vector<string> forwarded_headers_;
+  Stat *issued_;
+  Stat *duplicates_;
+  Stat *rate_limited_;
+  ShardedLruCache<string, char> recent_;
+  set<string> in_flight_;
+  map<string, OriginBucket> origins_;
+  mutable Mutex mutex_;
+
+  PrefetcherState(const Prefetcher::Options &options)
+    : options_(options), forwarded_headers_(FORWARDED_HEADERS, FORWARDED_HEADERS + sizeof(FORWARDED_HEADERS) /
+                                                                                   sizeof(FORWARDED_HEADERS[0])),
+      issued_(NULL), duplicates_(NULL), rate_limited_(NULL),
+      recent_(options.recent_max_bytes_, ShardedLruCacheBase::DEFAULT_SHARD_COUNT, options.recent_ttl_ms_) {
+    options_.fetch_options_.streaming_flag_ = AsyncHttpFetch::STREAMING_DISABLED;
+    if (options_.fetch_options_.timeout_ms_ <= 0) {
+      options_.fetch_options_.timeout_ms_ = DEFAULT_PREFETCH_TIMEOUT_MS; // an in flight url is never fetched again
+    }
+  }
+
+  void recordHint(Stat *stat) {
+    if (stat) {
+      stat->increment();
+    }
+  }
+
+  /**
+   * Refills the bucket of origin and takes a token from it, must be called with mutex_ held.
+   *
+   * @return false if the bucket is empty.
+   */
+  bool takeOriginToken(const string &origin, int64_t now) {
+    double burst = options_.origin_burst_;
+    if (origins_.size() >= ORIGIN_SWEEP_THRESHOLD) {
+      for (map<string, OriginBucket>::iterator iter = origins_.begin(); iter != origins_.end();) {
+        if (refill(iter->second, now) >= burst) {
+          origins_.erase(iter++);
+        } else {
+          ++iter;
+        }
+      }
+    }
+    map<string, OriginBucket>::iterator iter = origins_.find(origin);
+    if (iter == origins_.end()) {
+      OriginBucket bucket = { burst, now };
+      iter = origins_.insert(std::make_pair(origin, bucket)).first;
+    }
+    if (refill(iter->second, now) < 1.0) {
+      return false;
+    }
+    iter->second.tokens_ -= 1.0;
+    return true;
+  }
+
+  double refill(OriginBucket &bucket, int64_t now) {
+    if (now > bucket.refill_time_) {
+      double elapsed_seconds = static_cast<double>(now - bucket.refill_time_) / NANOSECONDS_PER_SECOND;
+      bucket.tokens_ = std::min(bucket.tokens_ + elapsed_seconds * options_.origin_rate_,
+                                static_cast<double>(options_.origin_burst_));
+      bucket.refill_time_ = now;
+    }
+    return bucket.tokens_;
+  }
+
+  /**
+   * Makes url absolute against the client request of transaction and drops its fragment.
+   *
+   * @return false if url can't be prefetched.
+   */
+  bool resolveUrl(Transaction &transaction, const string &url, string &resolved) {
+    resolved = url.substr(0, url.find('#'));
+    if (resolved.empty() || (findOriginEnd(resolved) != string::npos)) {
+      return !resolved.empty();
+    }
+    const Url &base_url = transaction.getClientRequest().getUrl();
+    string base = base_url.getUrlString();
+    size_t origin_end = findOriginEnd(base);
+    if (origin_end == string::npos) { // the host of a client request without one in its url is in the Host header
+      base = base_url.getScheme().empty() ? "http" : base_url.getScheme();
+      base += "://";
+      base += transaction.getClientRequest().getHeaders().getJoinedValues(HEADER_HOST);
+      origin_end = base.length();
+      base += '/';
+      base += base_url.getPath();
+    }
+    if ((resolved.length() > 1) && (resolved[0] == '/') && (resolved[1] == '/')) {
+      resolved.insert(0, base, 0, base.find("://") + 1);
+    } else if (resolved[0] == '/') {
+      resolved.insert(0, base, 0, origin_end);
+    } else {
+      size_t query = std::min(base.find_first_of("?#", origin_end), base.length());
+      size_t directory_end = base.rfind('/', query);
+      if ((directory_end == string::npos) || (directory_end < origin_end)) {
+        resolved.insert(0, "/");
+        resolved.insert(0, base, 0, origin_end);
+      } else {
+        resolved.insert(0, base, 0, directory_end + 1);
+      }
+    }
+    return findOriginEnd(resolved) != string::npos;
+  }
+
+  void completeFetch(const string &url, AsyncHttpFetch::Result result) {
+    LOG_DEBUG("Prefetch of [%s] completed with result %d", url.c_str(), result);
+    if (options_.recent_ttl_ms_ > 0) { // before the url leaves in_flight_, so there's no window a hint is fetched in
+      recent_.put(url, 1, url.size() + RECENT_ENTRY_OVERHEAD);
+    }
+    ScopedMutexLock lock(mutex_);
+    in_flight_.erase(url);
+  }
+};
+
+namespace {
+
+/**
+ * Takes the dispatch of a prefetch, nobody is waiting for its response.
+ */
+class PrefetchController : public AsyncDispatchControllerBase {
+public:
+  PrefetchController(PrefetcherState &prefetcher, const string &url, AsyncHttpFetch *fetch)
+    : prefetcher_(prefetcher), url_(url), fetch_(fetch) { }
+
+  bool dispatch() {
+    prefetcher_.completeFetch(url_, fetch_->getResult());
+    return true; // the fetch deletes itself right after
+  }
+
+private:
+  PrefetcherState &prefetcher_;
+  string url_;
+  AsyncHttpFetch *fetch_;
+};
+
+}
+
+Prefetcher::Prefetcher(const Options &options) {
+  state_ = new PrefetcherState(options);
+}
+
+void Prefetcher::addForwardedHeader(const string &name) {
+  state_->forwarded_headers_.push_back(name);
+}
+
+void Prefetcher::setStats(Stat *issued, Stat *duplicates, Stat *rate_limited) {
+  state_->issued_ = issued;
+  state_->duplicates_ = duplicates;
+  state_->rate_limited_ = rate_limited;
+}
+
+Prefetcher::HintResult Prefetcher::addHint(Transaction &transaction, const string &url) {
+  string resolved;
+  if (transaction.isInternalRequest() || !state_->resolveUrl(transaction, url, resolved) ||
+      !(startsWithIgnoreCase(resolved, "http://") || startsWithIgnoreCase(resolved, "https://"))) {
+    LOG_DEBUG("Rejecting prefetch hint [%s]", url.c_str());
+    return HINT_REJECTED;
+  }
+  string origin = resolved.substr(0, findOriginEnd(resolved));
+  std::transform(origin.begin(), origin.end(), origin.begin(), ::tolower);
+
+  HintResult result = HINT_ISSUED;
+  char recent;
+  state_->mutex_.lock();
+  if ((state_->in_flight_.find(resolved) != state_->in_flight_.end()) ||
+      ((state_->options_.recent_ttl_ms_ > 0) && state_->recent_.get(resolved, recent))) {
+    result = HINT_DUPLICATE;
+  } else if ((state_->in_flight_.size() >= state_->options_.max_in_flight_) ||
+             !state_->takeOriginToken(origin, TShrtime())) {
+    result = HINT_RATE_LIMITED;
+  } else {
+    state_->in_flight_.insert(resolved);
+  }
+  state_->mutex_.unlock();
+
+  if (result == HINT_DUPLICATE) {
+    LOG_DEBUG("Prefetch of [%s] is a duplicate", resolved.c_str());
+    state_->recordHint(state_->duplicates_);
+    return result;
+  }
+  if (result == HINT_RATE_LIMITED) {
+    LOG_DEBUG("Prefetch of [%s] is rate limited", resolved.c_str());
+    state_->recordHint(state_->rate_limited_);
+    return result;
+  }
+
+  LOG_DEBUG("Prefetching [%s]", resolved.c_str());
+  state_->recordHint(state_->issued_);
+  AsyncHttpFetch *fetch = new AsyncHttpFetch(resolved, state_->options_.fetch_options_);
+  Headers &client_headers = transaction.getClientRequest().getHeaders();
+  Headers &fetch_headers = fetch->getRequestHeaders();
+  for (vector<string>::const_iterator iter = state_->forwarded_headers_.begin(),
+         end = state_->forwarded_headers_.end(); iter != end; ++iter) {
+    if (client_headers.count(*iter)) {
+      fetch_headers.set(*iter, client_headers.getJoinedValues(*iter));
+    }
+  }
+  fetch->run(shared_ptr<AsyncDispatchControllerBase>(new PrefetchController(*state_, resolved, fetch)));
+  return result;
+}
+
+size_t Prefetcher::addLinkHints(Transaction &transaction, Headers &headers) {
+  if (!headers.count("Link")) {
+    return 0;
+  }
+  string links = headers.getJoinedValues("Link");
+  StringView view(links);
+  size_t issued = 0;
+  for (size_t begin = view.find('<'); begin != StringView::npos; begin = view.find('<', begin)) {
+    size_t url_end = view.find('>', begin);
+    if (url_end == StringView::npos) {
+      break;
+    }
+    size_t params_end = url_end + 1;
+    for (bool quoted = false; (params_end < view.length()) && (quoted || (view[params_end] != ',')); ++params_end) {
+      if (view[params_end] == '"') {
+        quoted = !quoted;
+      }
+    }
+    if (isPrefetchLink(view.substr(url_end + 1, params_end - url_end - 1)) &&
+        (addHint(transaction, links.substr(begin + 1, url_end - begin - 1)) == HINT_ISSUED)) {
+      ++issued;
+    }
+    begin = params_end;
+  }
+  return issued;
+}
+
+size_t Prefetcher::getInFlightCount() const {
+  ScopedMutexLock lock(state_->mutex_);
+  return state_->in_flight_.size();
+}
+
+Prefetcher::~Prefetcher() {
+  delete state_;
+}
@@ -17,20 +17,77 @@
  */
 
 #include "atscppapi/RemapPlugin.h"
+#include "atscppapi/RemapRuleSet.h"
 #include "logging_internal.h"
 #include "utils_internal.h"
 #include <assert.h>
+#include <string>
+#include <cstring>
 #include <ts/remap.h>
 
 using namespace atscppapi;
 
+namespace {
+
+const size_t REMAP_PATH_BUFFER_SIZE = 2048;
+
+/**
+ * Remaps the request with the rule it matches, working on the Traffic Server URL in place.
+ *
+ * @return false if no rule matched.
+ */
+bool applyRemapRules(const RemapRuleSet &rules, RemapRequest &request, TSRemapStatus &status) {
+  StringView host = request.getHost();
+  if (host.empty()) {
+    host = request.getMapFromHost();
+  }
+  StringView path = request.getPath();
+  StringView query = request.getQuery();
+  const RemapRuleSet::Rule *rule = rules.match(host.data() ? host.data() : "", host.length(),
+                                               path.data() ? path.data() : "", path.length(),
+                                               query.data() ? query.data() : "", query.length());
+  if (!rule) {
+    return false;
+  }
+
+  // The rest of the path has to be copied before the path is set since it points into the URL.
+  size_t rest_length = path.length() - rule->prefix_length_;
+  size_t new_path_length = rule->target_path_.length() + rest_length;
+  char path_buffer[REMAP_PATH_BUFFER_SIZE];
+  std::string long_path;
+  char *new_path = path_buffer;
+  if (new_path_length > sizeof(path_buffer)) {
+    long_path.resize(new_path_length);
+    new_path = &long_path[0];
+  }
+  memcpy(new_path, rule->target_path_.data(), rule->target_path_.length());
+  if (rest_length) {
+    memcpy(new_path + rule->target_path_.length(), path.data() + rule->prefix_length_, rest_length);
+  }
+
+  request.setScheme(rule->target_scheme_);
+  request.setHost(rule->target_host_);
+  if (rule->target_port_) {
+    request.setPort(rule->target_port_);
+  }
+  request.setPath(StringView(new_path, new_path_length));
+  request.setRedirect((rule->flags_ & RemapRuleSet::FLAG_REDIRECT) != 0);
+  status = (rule->flags_ & RemapRuleSet::FLAG_STOP) ? TSREMAP_DID_REMAP_STOP : TSREMAP_DID_REMAP;
+  LOG_DEBUG("Remapped with rule %d to host [%s]", rule->id_, rule->target_host_.c_str());
+  return true;
+}
+
+}
+
 TSRemapStatus TSRemapDoRemap(void* ih, TSHttpTxn rh, TSRemapRequestInfo* rri) {
   RemapPlugin *remap_plugin = static_cast<RemapPlugin *>(ih);
-  Url map_from_url(rri->requestBufp, rri->mapFromUrl), map_to_url(rri->requestBufp, rri->mapToUrl);
-  Transaction &transaction = utils::internal::getTransaction(rh);
-  bool redirect = false;
-  RemapPlugin::Result result = remap_plugin->doRemap(map_from_url, map_to_url, transaction, redirect);
-  rri->redirect = redirect ? 1 : 0;
+  const RemapRuleSet *rules = remap_plugin->getRemapRules();
+  RemapRequest request(rri, rh);
+  TSRemapStatus status;
+  if (rules && applyRemapRules(*rules, request, status)) {
+    return status;
+  }
+  RemapPlugin::Result result = remap_plugin->doRemapRequest(request);
   switch (result) {
   case RemapPlugin::RESULT_ERROR:
     return TSREMAP_ERROR;
@@ -57,7 +114,16 @@ TSReturnCode TSRemapInit(TSRemapInterface *api_info, char *errbuf, int errbuf_si
   return TS_SUCCESS;
 }
 
-RemapPlugin::RemapPlugin(void **instance_handle) {
+RemapPlugin::RemapPlugin(void **instance_handle) : remap_rules_(NULL) {
   *instance_handle = static_cast<void *>(this);
 }
 
+RemapPlugin::Result RemapPlugin::doRemapRequest(RemapRequest &request) {
+  TSRemapRequestInfo *rri = static_cast<TSRemapRequestInfo *>(request.getRemapRequestInfo());
+  Url map_from_url(rri->requestBufp, rri->mapFromUrl), map_to_url(rri->requestBufp, rri->mapToUrl);
+  bool redirect = false;
+  Result result = doRemap(map_from_url, map_to_url, request.getTransaction(), redirect);
+  request.setRedirect(redirect);
+  return result;
+}
+
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RemapRequest.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/RemapRequest.h"
+#include <ts/ts.h>
+#include <ts/remap.h>
+#include "utils_internal.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+namespace {
+
+typedef const char *(*UrlComponentGetter)(TSMBuffer, TSMLoc, int *);
+typedef TSReturnCode (*UrlComponentSetter)(TSMBuffer, TSMLoc, const char *, int);
+
+inline TSRemapRequestInfo *getInfo(void *rri) {
+  return static_cast<TSRemapRequestInfo *>(rri);
+}
+
+StringView getComponent(void *rri, TSMLoc url_loc, UrlComponentGetter getter) {
+  int length = 0;
+  const char *data = getter(getInfo(rri)->requestBufp, url_loc, &length);
+  return data ? StringView(data, static_cast<size_t>(length)) : StringView();
+}
+
+void setComponent(void *rri, UrlComponentSetter setter, const StringView &value) {
+  TSRemapRequestInfo *info = getInfo(rri);
+  if (setter(info->requestBufp, info->requestUrl, value.data() ? value.data() : "",
+             static_cast<int>(value.length())) != TS_SUCCESS) {
+    LOG_ERROR("Unable to set a component of the request URL");
+  }
+}
+
+}
+
+RemapRequest::RemapRequest(void *remap_request_info, void *txn) : rri_(remap_request_info), txn_(txn) {
+}
+
+StringView RemapRequest::getScheme() const {
+  return getComponent(rri_, getInfo(rri_)->requestUrl, TSUrlSchemeGet);
+}
+
+StringView RemapRequest::getHost() const {
+  return getComponent(rri_, getInfo(rri_)->requestUrl, TSUrlHostGet);
+}
+
+int RemapRequest::getPort() const {
+  return TSUrlPortGet(getInfo(rri_)->requestBufp, getInfo(rri_)->requestUrl);
+}
+
+StringView RemapRequest::getPath() const {
+  return getComponent(rri_, getInfo(rri_)->requestUrl, TSUrlPathGet);
+}
+
+StringView RemapRequest::getQuery() const {
+  return getComponent(rri_, getInfo(rri_)->requestUrl, TSUrlHttpQueryGet);
+}
+
+void RemapRequest::setScheme(const StringView &scheme) {
+  setComponent(rri_, TSUrlSchemeSet, scheme);
+}
+
+void RemapRequest::setHost(const StringView &host) {
+  setComponent(rri_, TSUrlHostSet, host);
+}
+
+void RemapRequest::setPort(int port) {
+  TSUrlPortSet(getInfo(rri_)->requestBufp, getInfo(rri_)->requestUrl, port);
+}
+
+void RemapRequest::setPath(const StringView &path) {
+  setComponent(rri_, TSUrlPathSet, path);
+}
+
+void RemapRequest::setQuery(const StringView &query) {
+  setComponent(rri_, TSUrlHttpQuerySet, query);
+}
+
+StringView RemapRequest::getMapFromHost() const {
+  return getComponent(rri_, getInfo(rri_)->mapFromUrl, TSUrlHostGet);
+}
+
+StringView RemapRequest::getMapFromPath() const {
+  return getComponent(rri_, getInfo(rri_)->mapFromUrl, TSUrlPathGet);
+}
+
+StringView RemapRequest::getMapToScheme() const {
+  return getComponent(rri_, getInfo(rri_)->mapToUrl, TSUrlSchemeGet);
+}
+
+StringView RemapRequest::getMapToHost() const {
+  return getComponent(rri_, getInfo(rri_)->mapToUrl, TSUrlHostGet);
+}
+
+int RemapRequest::getMapToPort() const {
+  return TSUrlPortGet(getInfo(rri_)->requestBufp, getInfo(rri_)->mapToUrl);
+}
+
+StringView RemapRequest::getMapToPath() const {
+  return getComponent(rri_, getInfo(rri_)->mapToUrl, TSUrlPathGet);
+}
+
+void RemapRequest::setRedirect(bool redirect) {
+  getInfo(rri_)->redirect = redirect ? 1 : 0;
+}
+
+bool RemapRequest::isRedirect() const {
+  return getInfo(rri_)->redirect != 0;
+}
+
+Transaction &RemapRequest::getTransaction() {
+  return utils::internal::getTransaction(static_cast<TSHttpTxn>(txn_));
+}
@@ -0,0 +1,450 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RemapRuleSet.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/RemapRuleSet.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+#include <stdint.h>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+using std::vector;
+
+namespace {
+
+enum PathType {
+  PATH_EXACT = 0,
+  PATH_PREFIX,
+  PATH_GLOB
+};
+
+struct CompiledRule {
+  RemapRuleSet::Rule rule_;
+  PathType path_type_;
+  string glob_; // the path pattern from its first *, for PATH_GLOB
+  bool has_query_;
+  string query_name_;
+  bool has_query_value_;
+  string query_value_;
+};
+
+/** A node of a path trie, its children are kept sorted by byte so they can be binary searched. */
+struct PathNode {
+  vector<std::pair<char, uint32_t> > children_;
+  vector<uint32_t> rules_; // the rules whose literal prefix ends here, in the order they were added
+};
+
+struct ChildLess {
+  bool operator()(const std::pair<char, uint32_t> &child, char c) const { return child.first < c; }
+};
+
+struct PathTrie {
+  vector<PathNode> nodes_;
+
+  PathTrie() : nodes_(1) { }
+
+  void insert(const string &prefix, uint32_t rule) {
+    uint32_t node = 0;
+    for (size_t i = 0; i < prefix.length(); ++i) {
+      vector<std::pair<char, uint32_t> > &children = nodes_[node].children_;
+      vector<std::pair<char, uint32_t> >::iterator child = std::lower_bound(children.begin(), children.end(),
+                                                                            prefix[i], ChildLess());
+      if ((child != children.end()) && (child->first == prefix[i])) {
+        node = child->second;
+      } else {
+        uint32_t new_node = static_cast<uint32_t>(nodes_.size());
+        children.insert(child, std::make_pair(prefix[i], new_node));
+        nodes_.push_back(PathNode()); // invalidates children, we're done with it
+        node = new_node;
+      }
+    }
+    nodes_[node].rules_.push_back(rule);
+  }
+
+  /** @return the child of node for c, 0 if there is none. */
+  uint32_t findChild(uint32_t node, char c) const {
+    const vector<std::pair<char, uint32_t> > &children = nodes_[node].children_;
+    vector<std::pair<char, uint32_t> >::const_iterator child = std::lower_bound(children.begin(), children.end(), c,
+                                                                                ChildLess());
+    return ((child != children.end()) && (child->first == c)) ? child->second : 0;
+  }
+};
+
+/** A host pattern and its trie, lowercased so lookups only need to lowercase the request's host. */
+struct HostEntry {
+  string host_;
+  size_t trie_;
+};
+
+/* Compares a lowercase host to length bytes of any case, like strcmp. */
+int compareHost(const string &host, const char *other, size_t length) {
+  size_t common = std::min(host.length(), length);
+  for (size_t i = 0; i < common; ++i) {
+    unsigned char a = static_cast<unsigned char>(host[i]);
+    unsigned char b = static_cast<unsigned char>(tolower(static_cast<unsigned char>(other[i])));
+    if (a != b) {
+      return (a < b) ? -1 : 1;
+    }
+  }
+  return (host.length() == length) ? 0 : ((host.length() < length) ? -1 : 1);
+}
+
+const HostEntry *findHost(const vector<HostEntry> &hosts, const char *host, size_t length) {
+  size_t low = 0;
+  size_t high = hosts.size();
+  while (low < high) {
+    size_t middle = (low + high) / 2;
+    int comparison = compareHost(hosts[middle].host_, host, length);
+    if (comparison == 0) {
+      return &hosts[middle];
+    }
+    if (comparison < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return NULL;
+}
+
+/* Matches a glob with * as its only wildcard, backtracking to the last * only. */
+bool globMatch(const string &glob, const char *text, size_t length) {
+  size_t g = 0;
+  size_t t = 0;
+  size_t star = string::npos;
+  size_t star_text = 0;
+  while (t < length) {
+    if ((g < glob.length()) && (glob[g] == '*')) {
+      star = g++;
+      star_text = t;
+    } else if ((g < glob.length()) && (glob[g] == text[t])) {
+      ++g;
+      ++t;
+    } else if (star != string::npos) {
+      g = star + 1;
+      t = ++star_text;
+    } else {
+      return false;
+    }
+  }
+  while ((g < glob.length()) && (glob[g] == '*')) {
+    ++g;
+  }
+  return g == glob.length();
+}
+
+bool queryMatch(const CompiledRule &rule, const char *query, size_t length) {
+  const char *end = query + length;
+  const char *param = query;
+  while (param < end) {
+    const char *param_end = static_cast<const char *>(memchr(param, '&', end - param));
+    if (!param_end) {
+      param_end = end;
+    }
+    const char *equals = static_cast<const char *>(memchr(param, '=', param_end - param));
+    const char *name_end = equals ? equals : param_end;
+    if ((static_cast<size_t>(name_end - param) == rule.query_name_.length()) &&
+        !memcmp(param, rule.query_name_.data(), rule.query_name_.length())) {
+      if (!rule.has_query_value_) {
+        return true;
+      }
+      const char *value = equals ? (equals + 1) : param_end;
+      if ((static_cast<size_t>(param_end - value) == rule.query_value_.length()) &&
+          !memcmp(value, rule.query_value_.data(), rule.query_value_.length())) {
+        return true;
+      }
+    }
+    param = param_end + 1;
+  }
+  return false;
+}
+
+bool ruleMatches(const CompiledRule &rule, const char *rest, size_t rest_length, const char *query,
+                 size_t query_length) {
+  switch (rule.path_type_) {
+  case PATH_EXACT:
+    if (rest_length) {
+      return false;
+    }
+    break;
+  case PATH_GLOB:
+    if (!globMatch(rule.glob_, rest, rest_length)) {
+      return false;
+    }
+    break;
+  default:
+    break;
+  }
+  return !rule.has_query_ || queryMatch(rule, query, query_length);
+}
+
+string toLower(const string &str) {
+  string lower(str);
+  for (size_t i = 0; i < lower.length(); ++i) {
+    lower[i] = tolower(static_cast<unsigned char>(lower[i]));
+  }
+  return lower;
+}
+
+/* Splits scheme://host[:port][/path] into the target of rule. */
+bool parseTarget(const string &to, RemapRuleSet::Rule &rule) {
+  size_t scheme_end = to.find("://");
+  if ((scheme_end == string::npos) || !scheme_end) {
+    return false;
+  }
+  rule.target_scheme_ = toLower(to.substr(0, scheme_end));
+  size_t host_start = scheme_end + 3;
+  size_t path_start = to.find('/', host_start);
+  string authority = to.substr(host_start, (path_start == string::npos) ? string::npos : path_start - host_start);
+  size_t colon = authority.rfind(':');
+  rule.target_port_ = 0;
+  if ((colon != string::npos) && (authority.find(']', colon) == string::npos)) {
+    rule.target_port_ = atoi(authority.c_str() + colon + 1);
+    if ((rule.target_port_ <= 0) || (rule.target_port_ > 65535)) {
+      return false;
+    }
+    authority.resize(colon);
+  }
+  if (authority.empty()) {
+    return false;
+  }
+  rule.target_host_ = authority;
+  rule.target_path_ = (path_start == string::npos) ? string() : to.substr(path_start + 1);
+  return true;
+}
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::RemapRuleSetState : noncopyable {
+  vector<CompiledRule> rules_;
+  vector<PathTrie> tries_;
+  std::map<string, size_t> exact_host_tries_; // only while adding rules
+  std::map<string, size_t> suffix_host_tries_; // keyed by the suffix with its leading dot
+  vector<HostEntry> exact_hosts_;
+  vector<HostEntry> suffix_hosts_;
+  size_t any_host_trie_;
+  bool compiled_;
+
+  RemapRuleSetState() : any_host_trie_(string::npos), compiled_(false) { }
+
+  size_t getTrie(std::map<string, size_t> &tries, const string &host) {
+    std::map<string, size_t>::iterator iter = tries.find(host);
+    if (iter != tries.end()) {
+      return iter->second;
+    }
+    tries_.push_back(PathTrie());
+    tries[host] = tries_.size() - 1;
+    return tries_.size() - 1;
+  }
+
+  const CompiledRule *matchPath(size_t trie_index, const char *path, size_t path_length, const char *query,
+                                size_t query_length) const {
+    const PathTrie &trie = tries_[trie_index];
+    const CompiledRule *best = NULL;
+    uint32_t node = 0;
+    size_t depth = 0;
+    while (true) {
+      // a deeper match has a longer literal prefix, so it replaces what we found so far.
+      const vector<uint32_t> &rules = trie.nodes_[node].rules_;
+      for (size_t i = 0; i < rules.size(); ++i) {
+        const CompiledRule &rule = rules_[rules[i]];
+        if (ruleMatches(rule, path + depth, path_length - depth, query, query_length)) {
+          best = &rule;
+          break;
+        }
+      }
+      if (depth == path_length) {
+        break;
+      }
+      node = trie.findChild(node, path[depth]);
+      if (!node) {
+        break;
+      }
+      ++depth;
+    }
+    return best;
+  }
+};
+
+RemapRuleSet::RemapRuleSet() : state_(new RemapRuleSetState()) {
+}
+
+RemapRuleSet::~RemapRuleSet() {
+  delete state_;
+}
+
+int RemapRuleSet::addRule(const string &from, const string &to, unsigned int flags) {
+  if (state_->compiled_) {
+    LOG_ERROR("Cannot add rule [%s] after the rule set was compiled", from.c_str());
+    return -1;
+  }
+
+  CompiledRule compiled;
+  compiled.rule_.id_ = static_cast<int>(state_->rules_.size());
+  compiled.rule_.flags_ = flags;
+  if (!parseTarget(to, compiled.rule_)) {
+    LOG_ERROR("Invalid target [%s] of rule [%s]", to.c_str(), from.c_str());
+    return -1;
+  }
+
+  size_t query_start = from.find('?');
+  string location = from.substr(0, query_start);
+  compiled.has_query_ = (query_start != string::npos);
+  compiled.has_query_value_ = false;
+  if (compiled.has_query_) {
+    string query = from.substr(query_start + 1);
+    size_t equals = query.find('=');
+    compiled.query_name_ = query.substr(0, equals);
+    if (equals != string::npos) {
+      compiled.has_query_value_ = true;
+      compiled.query_value_ = query.substr(equals + 1);
+    }
+    if (compiled.query_name_.empty()) {
+      LOG_ERROR("Invalid query in rule [%s]", from.c_str());
+      return -1;
+    }
+  }
+
+  size_t path_start = location.find('/');
+  string host = toLower(location.substr(0, path_start));
+  string path = (path_start == string::npos) ? string() : location.substr(path_start + 1);
+  if (host.empty() || ((host.find('*') != string::npos) && (host != "*") &&
+                       ((host.compare(0, 2, "*.") != 0) || (host.find('*', 1) != string::npos)))) {
+    LOG_ERROR("Invalid host in rule [%s], it must be exact, *.suffix or *", from.c_str());
+    return -1;
+  }
+
+  size_t star = path.find('*');
+  string literal = path.substr(0, star);
+  if (star == string::npos) {
+    compiled.path_type_ = PATH_EXACT;
+  } else if (star == path.length() - 1) {
+    compiled.path_type_ = PATH_PREFIX;
+  } else {
+    compiled.path_type_ = PATH_GLOB;
+    compiled.glob_ = path.substr(star);
+  }
+  compiled.rule_.prefix_length_ = literal.length();
+
+  size_t trie;
+  if (host == "*") {
+    if (state_->any_host_trie_ == string::npos) {
+      state_->tries_.push_back(PathTrie());
+      state_->any_host_trie_ = state_->tries_.size() - 1;
+    }
+    trie = state_->any_host_trie_;
+  } else if (host[0] == '*') {
+    trie = state_->getTrie(state_->suffix_host_tries_, host.substr(1));
+  } else {
+    trie = state_->getTrie(state_->exact_host_tries_, host);
+  }
+  state_->rules_.push_back(compiled);
+  state_->tries_[trie].insert(literal, static_cast<uint32_t>(compiled.rule_.id_));
+  LOG_DEBUG("Added remap rule %d [%s] => [%s]", compiled.rule_.id_, from.c_str(), to.c_str());
+  return compiled.rule_.id_;
+}
+
+bool RemapRuleSet::addRules(int argc, char *argv[], string &error) {
+  for (int i = 0; i < argc; ++i) {
+    string arg(argv[i]);
+    size_t arrow = arg.find("=>");
+    if (arrow == string::npos) {
+      error = "Expected from=>to in remap rule [" + arg + "]";
+      return false;
+    }
+    string from = arg.substr(0, arrow);
+    string to = arg.substr(arrow + 2);
+    unsigned int flags = FLAG_NONE;
+    size_t option;
+    while ((option = to.rfind(';')) != string::npos) {
+      string name = to.substr(option + 1);
+      if (name == "redirect") {
+        flags |= FLAG_REDIRECT;
+      } else if (name == "stop") {
+        flags |= FLAG_STOP;
+      } else {
+        error = "Unknown option [" + name + "] in remap rule [" + arg + "]";
+        return false;
+      }
+      to.resize(option);
+    }
+    if (addRule(from, to, flags) < 0) {
+      error = "Invalid remap rule [" + arg + "]";
+      return false;
+    }
+  }
+  return true;
+}
+
+void RemapRuleSet::compile() {
+  for (std::map<string, size_t>::const_iterator iter = state_->exact_host_tries_.begin();
+       iter != state_->exact_host_tries_.end(); ++iter) {
+    HostEntry entry = { iter->first, iter->second };
+    state_->exact_hosts_.push_back(entry);
+  }
+  for (std::map<string, size_t>::const_iterator iter = state_->suffix_host_tries_.begin();
+       iter != state_->suffix_host_tries_.end(); ++iter) {
+    HostEntry entry = { iter->first, iter->second };
+    state_->suffix_hosts_.push_back(entry);
+  }
+  // maps iterate in order, so both are sorted already
+  state_->exact_host_tries_.clear();
+  state_->suffix_host_tries_.clear();
+  state_->compiled_ = true;
+  LOG_DEBUG("Compiled %d remap rules for %d exact and %d wildcard hosts", static_cast<int>(state_->rules_.size()),
+            static_cast<int>(state_->exact_hosts_.size()), static_cast<int>(state_->suffix_hosts_.size()));
+}
+
+const RemapRuleSet::Rule *RemapRuleSet::match(const char *host, size_t host_length, const char *path,
+                                              size_t path_length, const char *query, size_t query_length) const {
+  if (!state_->compiled_) {
+    LOG_ERROR("Remap rule set wasn't compiled");
+    return NULL;
+  }
+
+  const CompiledRule *rule = NULL;
+  const HostEntry *entry = findHost(state_->exact_hosts_, host, host_length);
+  if (entry) {
+    rule = state_->matchPath(entry->trie_, path, path_length, query, query_length);
+  }
+  // the longest suffix first, it starts at the leftmost dot
+  for (size_t i = 0; !rule && (i < host_length); ++i) {
+    if (host[i] == '.') {
+      entry = findHost(state_->suffix_hosts_, host + i, host_length - i);
+      if (entry) {
+        rule = state_->matchPath(entry->trie_, path, path_length, query, query_length);
+      }
+    }
+  }
+  if (!rule && (state_->any_host_trie_ != string::npos)) {
+    rule = state_->matchPath(state_->any_host_trie_, path, path_length, query, query_length);
+  }
+  return rule ? &rule->rule_ : NULL;
+}
+
+size_t RemapRuleSet::getRuleCount() const {
+  return state_->rules_.size();
+}
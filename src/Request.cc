@@ -20,8 +20,10 @@
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "utils_internal.h"
 #include "logging_internal.h"
+#include <cstring>
 
 using namespace atscppapi;
 using std::string;
@@ -29,7 +31,7 @@ using std::string;
 /**
  * @private
  */
-struct atscppapi::RequestState: noncopyable  {
+struct atscppapi::RequestState: noncopyable, ArenaAllocated {
   TSMBuffer hdr_buf_;
   TSMLoc hdr_loc_;
   TSMLoc url_loc_;
@@ -100,27 +102,7 @@ HttpMethod Request::getMethod() const {
     int method_len;
     const char *method_str = TSHttpHdrMethodGet(state_->hdr_buf_, state_->hdr_loc_, &method_len);
     if (method_str && method_len) {
-      if (method_str == TS_HTTP_METHOD_GET) {
-        state_->method_ = HTTP_METHOD_GET;
-      } else if (method_str == TS_HTTP_METHOD_POST) {
-        state_->method_ = HTTP_METHOD_POST;
-      } else if (method_str == TS_HTTP_METHOD_HEAD) {
-        state_->method_ = HTTP_METHOD_HEAD;
-      } else if (method_str == TS_HTTP_METHOD_CONNECT) {
-        state_->method_ = HTTP_METHOD_CONNECT;
-      } else if (method_str == TS_HTTP_METHOD_DELETE) {
-        state_->method_ = HTTP_METHOD_DELETE;
-      } else if (method_str == TS_HTTP_METHOD_ICP_QUERY) {
-        state_->method_ = HTTP_METHOD_ICP_QUERY;
-      } else if (method_str == TS_HTTP_METHOD_OPTIONS) {
-        state_->method_ = HTTP_METHOD_OPTIONS;
-      } else if (method_str == TS_HTTP_METHOD_PURGE) {
-        state_->method_ = HTTP_METHOD_PURGE;
-      } else if (method_str == TS_HTTP_METHOD_PUT) {
-        state_->method_ = HTTP_METHOD_PUT;
-      } else if (method_str == TS_HTTP_METHOD_TRACE) {
-        state_->method_ = HTTP_METHOD_TRACE;
-      }
+      state_->method_ = parseHttpMethod(method_str, static_cast<size_t>(method_len));
     } else {
       LOG_ERROR("TSHttpHdrMethodGet returned null string or it was zero length, hdr_buf=%p, hdr_loc=%p, method str=%p, method_len=%d",
           state_->hdr_buf_, state_->hdr_loc_, method_str, method_len);
@@ -137,7 +119,7 @@ atscppapi::HttpVersion Request::getVersion() const {
   if (!state_->version_.isInitialized() && state_->hdr_buf_ && state_->hdr_loc_) {
     state_->version_ = utils::internal::getHttpVersion(state_->hdr_buf_, state_->hdr_loc_);
     LOG_DEBUG("Initializing request version=%d [%s] on hdr_buf=%p, hdr_loc=%p",
-        state_->version_.getValue(), HTTP_VERSION_STRINGS[state_->version_.getValue()].c_str(), state_->hdr_buf_, state_->hdr_loc_);
+        state_->version_.getValue(), getHttpVersionName(state_->version_.getValue()).data(), state_->hdr_buf_, state_->hdr_loc_);
   }
   return state_->version_;
 }
@@ -146,6 +128,50 @@ atscppapi::Headers &Request::getHeaders() const {
   return state_->headers_;
 }
 
+namespace {
+
+const char REQUEST_HEAD_END[] = "\r\n";
+const size_t REQUEST_HEAD_END_LENGTH = sizeof(REQUEST_HEAD_END) - 1;
+
+}
+
+size_t Request::getSerializedHeadSize() {
+  // "METHOD URL VERSION\r\n" + headers + "\r\n"
+  return getHttpMethodName(getMethod()).length() + 1 + getUrl().getUrlStringLength() + 1 +
+    getHttpVersionName(getVersion()).length() + REQUEST_HEAD_END_LENGTH + state_->headers_.getSerializedSize() +
+    REQUEST_HEAD_END_LENGTH;
+}
+
+size_t Request::serializeHead(char *buffer, size_t buffer_length) {
+  if (!buffer || (buffer_length < getSerializedHeadSize())) {
+    LOG_ERROR("Buffer %p of length %zu too small for request head", buffer, buffer_length);
+    return 0;
+  }
+  StringView method = getHttpMethodName(getMethod());
+  StringView version = getHttpVersionName(getVersion());
+  char *pos = buffer;
+  memcpy(pos, method.data(), method.length());
+  pos += method.length();
+  *pos++ = ' ';
+  pos += getUrl().getUrlString(pos, buffer_length - (pos - buffer));
+  *pos++ = ' ';
+  memcpy(pos, version.data(), version.length());
+  pos += version.length();
+  memcpy(pos, REQUEST_HEAD_END, REQUEST_HEAD_END_LENGTH);
+  pos += REQUEST_HEAD_END_LENGTH;
+  pos += state_->headers_.serialize(pos, buffer_length - (pos - buffer));
+  memcpy(pos, REQUEST_HEAD_END, REQUEST_HEAD_END_LENGTH);
+  pos += REQUEST_HEAD_END_LENGTH;
+  return pos - buffer;
+}
+
+void Request::serializeHead(string &output) {
+  size_t initial_length = output.length();
+  output.resize(initial_length + getSerializedHeadSize());
+  size_t written = serializeHead(&output[initial_length], output.length() - initial_length);
+  output.resize(initial_length + written);
+}
+
 Request::~Request() {
   if (state_->url_loc_) {
     if (state_->destroy_buf_) {
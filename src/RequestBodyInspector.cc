@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RequestBodyInspector.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/RequestBodyInspector.h"
+#include <ts/ts.h>
+#include "atscppapi/noncopyable.h"
+#include "atscppapi/Transaction.h"
+#include "atscppapi/Response.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+/**
+ * @private
+ */
+struct atscppapi::RequestBodyInspectorState : noncopyable {
+  Transaction &transaction_;
+  size_t inspection_limit_;
+  size_t inspected_length_;
+  bool inspecting_;
+  bool completed_;
+  bool rejected_;
+  HttpStatus reject_status_;
+
+  RequestBodyInspectorState(Transaction &transaction, size_t inspection_limit)
+    : transaction_(transaction), inspection_limit_(inspection_limit), inspected_length_(0), inspecting_(true),
+      completed_(false), rejected_(false), reject_status_(HTTP_STATUS_UNKNOWN) { }
+};
+
+RequestBodyInspector::RequestBodyInspector(Transaction &transaction, size_t inspection_limit)
+    : TransformationPlugin(transaction, REQUEST_TRANSFORMATION) {
+  state_ = new RequestBodyInspectorState(transaction, inspection_limit);
+  LOG_DEBUG("Created RequestBodyInspector=%p tshttptxn=%p inspection_limit=%zu", this,
+            transaction.getAtsHandle(), inspection_limit);
+}
+
+RequestBodyInspector::~RequestBodyInspector() {
+  LOG_DEBUG("Destroying RequestBodyInspector=%p after inspecting %zu bytes", this, state_->inspected_length_);
+  delete state_;
+}
+
+size_t RequestBodyInspector::getInspectedLength() const {
+  return state_->inspected_length_;
+}
+
+bool RequestBodyInspector::isRejected() const {
+  return state_->rejected_;
+}
+
+void RequestBodyInspector::handleInspectionComplete() {
+}
+
+void RequestBodyInspector::stopInspecting() {
+  state_->inspecting_ = false;
+}
+
+void RequestBodyInspector::reject(HttpStatus status, const string &body) {
+  if (state_->rejected_) {
+    return;
+  }
+  LOG_DEBUG("RequestBodyInspector=%p rejecting request with status %d after %zu bytes", this, status,
+            state_->inspected_length_);
+  state_->rejected_ = true;
+  state_->inspecting_ = false;
+  state_->reject_status_ = status;
+  TSHttpTxn txn = static_cast<TSHttpTxn>(state_->transaction_.getAtsHandle());
+  if (!body.empty()) {
+    state_->transaction_.setErrorBody(body);
+  }
+  TSHttpTxnSetHttpRetStatus(txn, static_cast<TSHttpStatus>(status));
+  // the error response would otherwise go out with the status of the failed transformation
+  registerHook(HOOK_SEND_RESPONSE_HEADERS);
+  abort();
+}
+
+void RequestBodyInspector::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (state_->inspecting_ && input.nextBlock(data, length)) {
+    if (state_->inspection_limit_ && (state_->inspected_length_ + length > state_->inspection_limit_)) {
+      length = state_->inspection_limit_ - state_->inspected_length_;
+      state_->inspecting_ = false;
+    }
+    state_->inspected_length_ += length;
+    inspect(StringView(data, length));
+    if (state_->inspection_limit_ && (state_->inspected_length_ == state_->inspection_limit_)) {
+      state_->inspecting_ = false;
+    }
+  }
+  if (state_->rejected_) {
+    return;
+  }
+  produce(input); // by reference, the body isn't copied
+  if (!state_->inspecting_) {
+    completeInspection();
+    bypass();
+  }
+}
+
+void RequestBodyInspector::handleInputComplete() {
+  if (state_->rejected_) {
+    return;
+  }
+  state_->inspecting_ = false;
+  completeInspection();
+  if (!state_->rejected_) {
+    setOutputComplete();
+  }
+}
+
+void RequestBodyInspector::handleSendResponseHeaders(Transaction &transaction) {
+  Response &response = transaction.getClientResponse();
+  if (response.getStatusCode() != state_->reject_status_) {
+    response.setStatusCode(state_->reject_status_);
+    const char *reason = TSHttpHdrReasonLookup(static_cast<TSHttpStatus>(state_->reject_status_));
+    response.setReasonPhrase(reason ? reason : "");
+  }
+  transaction.resume();
+}
+
+void RequestBodyInspector::completeInspection() {
+  if (!state_->completed_) {
+    state_->completed_ = true;
+    LOG_DEBUG("RequestBodyInspector=%p inspection complete after %zu bytes", this, state_->inspected_length_);
+    handleInspectionComplete();
+  }
+}
@@ -17,6 +17,7 @@
  */
 #include "atscppapi/Response.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "atscppapi/noncopyable.h"
 #include "utils_internal.h"
 #include "logging_internal.h"
@@ -29,7 +30,7 @@ namespace atscppapi {
 /**
  * @private
  */
-struct ResponseState: noncopyable {
+struct ResponseState: noncopyable, ArenaAllocated {
   TSMBuffer hdr_buf_;
   TSMLoc hdr_loc_;
   InitializableValue<HttpVersion> version_;
@@ -60,7 +61,7 @@ HttpVersion Response::getVersion() const {
   if (state_->hdr_buf_ && state_->hdr_loc_) {
     state_->version_ = utils::internal::getHttpVersion(state_->hdr_buf_, state_->hdr_loc_);
     LOG_DEBUG("Initializing response version to %d [%s] with hdr_buf=%p and hdr_loc=%p",
-        state_->version_.getValue(), HTTP_VERSION_STRINGS[state_->version_.getValue()].c_str(), state_->hdr_buf_, state_->hdr_loc_);
+        state_->version_.getValue(), getHttpVersionName(state_->version_.getValue()).data(), state_->hdr_buf_, state_->hdr_loc_);
     return state_->version_;
   }
   return HTTP_VERSION_UNKNOWN;
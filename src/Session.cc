@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file Session.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/Session.h"
+#include <vector>
+#include <ts/ts.h>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+/**
+ * @private
+ */
+struct atscppapi::SessionState : noncopyable {
+  TSHttpSsn ssn_;
+  std::vector<SessionPlugin *> plugins_;
+  unsigned int transaction_count_;
+
+  SessionState(TSHttpSsn ssn) : ssn_(ssn), transaction_count_(0) { }
+};
+
+Session::Session(void *ats_session) {
+  state_ = new SessionState(static_cast<TSHttpSsn>(ats_session));
+  LOG_DEBUG("Created Session=%p for tshttpssn=%p", this, ats_session);
+}
+
+Session::~Session() {
+  LOG_DEBUG("Destroying Session=%p tshttpssn=%p with %zu plugins after %u transactions", this, state_->ssn_,
+            state_->plugins_.size(), state_->transaction_count_);
+  for (size_t i = state_->plugins_.size(); i > 0; --i) {
+    delete state_->plugins_[i - 1];
+  }
+  delete state_;
+}
+
+void *Session::getAtsHandle() const {
+  return static_cast<void *>(state_->ssn_);
+}
+
+void Session::addPlugin(SessionPlugin *plugin) {
+  LOG_DEBUG("Session=%p tshttpssn=%p adding SessionPlugin=%p", this, state_->ssn_, plugin);
+  state_->plugins_.push_back(plugin);
+}
+
+size_t Session::getPluginCount() const {
+  return state_->plugins_.size();
+}
+
+SessionPlugin *Session::getPlugin(size_t index) const {
+  return (index < state_->plugins_.size()) ? state_->plugins_[index] : NULL;
+}
+
+unsigned int Session::getTransactionCount() const {
+  return state_->transaction_count_;
+}
+
+void Session::countTransaction() {
+  ++state_->transaction_count_;
+}
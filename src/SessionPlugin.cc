@@ -0,0 +1,34 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file SessionPlugin.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/SessionPlugin.h"
+#include "atscppapi/Session.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+SessionPlugin::SessionPlugin(Session &session) : session_(session) {
+  LOG_DEBUG("Creating SessionPlugin=%p for Session=%p", this, &session);
+}
+
+SessionPlugin::~SessionPlugin() {
+  LOG_DEBUG("Destroying SessionPlugin=%p", this);
+}
+
+Session &SessionPlugin::getSession() const {
+  return session_;
+}
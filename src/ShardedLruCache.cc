@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file ShardedLruCache.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/ShardedLruCache.h"
+#include <cstring>
+#include <ts/ts.h>
+
+using namespace atscppapi;
+
+namespace {
+
+const uint64_t MULTIPLIER = 0x9fb21c651e98df25ULL;
+const int64_t NANOSECONDS_PER_MILLISECOND = 1000000;
+
+inline uint64_t rotate(uint64_t value, int bits) {
+  return (value >> bits) | (value << (64 - bits));
+}
+
+}
+
+size_t ShardedLruCacheHash::operator()(const StringView &key) const {
+  // eight bytes at a time, keys are mostly short so there's no point in more lanes
+  const char *data = key.data();
+  size_t length = key.length();
+  uint64_t hash = length * MULTIPLIER;
+  for (; length >= sizeof(uint64_t); data += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+    uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    hash = rotate(hash ^ (word * MULTIPLIER), 29) * MULTIPLIER;
+  }
+  if (length) {
+    uint64_t word = 0;
+    memcpy(&word, data, length);
+    hash = rotate(hash ^ (word * MULTIPLIER), 29) * MULTIPLIER;
+  }
+  return mix(hash);
+}
+
+void ShardedLruCacheBase::setStats(Stat *hits, Stat *misses, Stat *evictions) {
+  hits_ = hits;
+  misses_ = misses;
+  evictions_ = evictions;
+}
+
+int64_t ShardedLruCacheBase::getNowMs() {
+  return TShrtime() / NANOSECONDS_PER_MILLISECOND;
+}
+
+size_t ShardedLruCacheBase::roundShardCount(size_t count) {
+  size_t rounded = 1;
+  while (rounded < count) {
+    rounded <<= 1;
+  }
+  return rounded;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ShardedStat.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/ShardedStat.h"
+#include <cstdlib>
+#include <cstring>
+#include <ts/ts.h>
+#include "atscppapi/Async.h"
+#include "atscppapi/AsyncTimer.h"
+#include "StatShards.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+__thread int atscppapi::current_stat_shard = -1;
+
+namespace {
+
+volatile int next_stat_shard = 0;
+
+}
+
+int atscppapi::assignStatShard() {
+  current_stat_shard = __sync_fetch_and_add(&next_stat_shard, 1) % MAX_STAT_SHARDS;
+  return current_stat_shard;
+}
+
+StatShardCounter *atscppapi::allocateStatShardCounters(size_t count) {
+  void *counters = NULL;
+  if (posix_memalign(&counters, StatShardCounter::CACHE_LINE_SIZE, count * sizeof(StatShardCounter))) {
+    return NULL;
+  }
+  memset(counters, 0, count * sizeof(StatShardCounter));
+  return static_cast<StatShardCounter *>(counters);
+}
+
+void atscppapi::freeStatShardCounters(StatShardCounter *counters) {
+  free(counters);
+}
+
+/**
+ * @private
+ */
+struct atscppapi::ShardedStatState : AsyncReceiver<AsyncTimer> {
+  int stat_id_;
+  StatShardCounter *counters_;
+  AsyncTimer *fold_timer_;
+
+  ShardedStatState() : stat_id_(TS_ERROR), counters_(allocateStatShardCounters(MAX_STAT_SHARDS)), fold_timer_(NULL) { }
+
+  /** @return What was incremented since the last call. */
+  int64_t collect() {
+    int64_t sum = 0;
+    for (int i = 0; i < MAX_STAT_SHARDS; ++i) {
+      sum += __sync_lock_test_and_set(&counters_[i].value_, 0);
+    }
+    return sum;
+  }
+
+  void fold() {
+    int64_t sum = collect();
+    if (sum) {
+      TSStatIntIncrement(stat_id_, sum);
+    }
+  }
+
+  void handleAsyncComplete(AsyncTimer &) {
+    fold();
+  }
+
+  ~ShardedStatState() {
+    delete fold_timer_;
+    freeStatShardCounters(counters_);
+  }
+};
+
+ShardedStat::ShardedStat() : state_(new ShardedStatState()) {
+}
+
+ShardedStat::~ShardedStat() {
+  delete state_;
+}
+
+bool ShardedStat::init(const string &name, int fold_interval_ms, bool persistent) {
+  state_->stat_id_ = TSStatCreate(name.c_str(), TS_RECORDDATATYPE_INT,
+                                  persistent ? TS_STAT_PERSISTENT : TS_STAT_NON_PERSISTENT, TS_STAT_SYNC_SUM);
+  if (state_->stat_id_ == TS_ERROR) {
+    LOG_ERROR("Unable to create sharded stat named '%s'.", name.c_str());
+    return false;
+  }
+  LOG_DEBUG("Created new sharded stat named '%s' with stat_id = %d, folded every %d ms", name.c_str(),
+            state_->stat_id_, fold_interval_ms);
+  if (!persistent) {
+    TSStatIntSet(state_->stat_id_, 0);
+  }
+  state_->fold_timer_ = new AsyncTimer(AsyncTimer::TYPE_PERIODIC, fold_interval_ms, 0, ASYNC_THREAD_POOL_TASK);
+  Async::execute<AsyncTimer>(state_, state_->fold_timer_, shared_ptr<Mutex>());
+  return true;
+}
+
+void ShardedStat::increment(int64_t amount) {
+  __sync_fetch_and_add(&state_->counters_[getStatShard()].value_, amount);
+}
+
+void ShardedStat::fold() {
+  if (state_->stat_id_ != TS_ERROR) {
+    state_->fold();
+  }
+}
+
+int64_t ShardedStat::get() {
+  if (state_->stat_id_ == TS_ERROR) {
+    return 0;
+  }
+  fold();
+  return TSStatIntGet(state_->stat_id_);
+}
+
+void ShardedStat::set(int64_t value) {
+  if (state_->stat_id_ == TS_ERROR) {
+    return;
+  }
+  state_->collect();
+  TSStatIntSet(state_->stat_id_, value);
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatFamily.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/StatFamily.h"
+#include "atscppapi/Mutex.h"
+#include <cstring>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+/** A label and its stat, never changed once published into a slot. */
+struct LabelledStat {
+  uint64_t hash_;
+  string label_;
+  Stat stat_;
+};
+
+uint64_t hashLabel(const char *label, size_t length) {
+  // FNV-1a
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(label[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+}
+
+/**
+ * @private
+ *
+ * An open addressing table sized for twice max_labels_, so probes stay short and it never fills up. Readers
+ * probe without locking, a slot only ever goes from NULL to a complete LabelledStat. Writers serialize on
+ * the mutex to insert.
+ */
+struct atscppapi::StatFamilyState : noncopyable {
+  string name_;
+  size_t max_labels_;
+  Stat::SyncType type_;
+  bool persistent_;
+  LabelledStat *volatile *slots_;
+  size_t mask_;
+  volatile size_t label_count_;
+  Stat overflow_;
+  Mutex mutex_;
+
+  StatFamilyState() : max_labels_(0), type_(Stat::SYNC_SUM), persistent_(false), slots_(NULL), mask_(0),
+                      label_count_(0) { }
+
+  ~StatFamilyState() {
+    if (slots_) {
+      for (size_t i = 0; i <= mask_; ++i) {
+        delete slots_[i];
+      }
+      delete[] slots_;
+    }
+  }
+
+  /* @return the stat of label, or the empty slot it would go in when stat is NULL. */
+  LabelledStat *find(uint64_t hash, const char *label, size_t length, size_t &slot) const {
+    for (slot = hash & mask_; ; slot = (slot + 1) & mask_) {
+      LabelledStat *entry = slots_[slot];
+      if (!entry) {
+        return NULL;
+      }
+      __sync_synchronize(); // pairs with the barrier before the slot is published.
+      if ((entry->hash_ == hash) && (entry->label_.length() == length) &&
+          !memcmp(entry->label_.data(), label, length)) {
+        return entry;
+      }
+    }
+  }
+
+  Stat &insert(uint64_t hash, const char *label, size_t length) {
+    ScopedMutexLock lock(mutex_);
+    size_t slot;
+    LabelledStat *entry = find(hash, label, length, slot); // someone may have beaten us to it.
+    if (entry) {
+      return entry->stat_;
+    }
+    if (label_count_ >= max_labels_) {
+      return overflow_;
+    }
+
+    entry = new LabelledStat();
+    entry->hash_ = hash;
+    entry->label_.assign(label, length);
+    if (!entry->stat_.init(name_ + "." + entry->label_, type_, persistent_)) {
+      delete entry;
+      return overflow_;
+    }
+    __sync_synchronize(); // the entry must be complete before readers can find it.
+    slots_[slot] = entry;
+    ++label_count_;
+    LOG_DEBUG("Stat family '%s' now has %d labels", name_.c_str(), label_count_);
+    return entry->stat_;
+  }
+};
+
+StatFamily::StatFamily() : state_(new StatFamilyState()) {
+}
+
+StatFamily::~StatFamily() {
+  delete state_;
+}
+
+bool StatFamily::init(const string &name, size_t max_labels, Stat::SyncType type, bool persistent) {
+  if (state_->slots_) {
+    LOG_ERROR("Attempt to reinitialize the stat family '%s' as '%s'", state_->name_.c_str(), name.c_str());
+    return false;
+  }
+  size_t capacity = 2;
+  while (capacity < 2 * max_labels) {
+    capacity <<= 1;
+  }
+
+  state_->name_ = name;
+  state_->max_labels_ = max_labels;
+  state_->type_ = type;
+  state_->persistent_ = persistent;
+  state_->mask_ = capacity - 1;
+  state_->slots_ = new LabelledStat *volatile[capacity];
+  memset(const_cast<LabelledStat **>(state_->slots_), 0, capacity * sizeof(LabelledStat *));
+  LOG_DEBUG("Created stat family '%s' for up to %d labels", name.c_str(), max_labels);
+  return state_->overflow_.init(name + ".other", type, persistent);
+}
+
+Stat &StatFamily::get(const string &label) {
+  return get(label.data(), label.length());
+}
+
+Stat &StatFamily::get(const char *label, size_t length) {
+  if (!state_->slots_) {
+    LOG_ERROR("Stat family was not initialized");
+    return state_->overflow_;
+  }
+  uint64_t hash = hashLabel(label, length);
+  size_t slot;
+  LabelledStat *entry = state_->find(hash, label, length, slot);
+  return entry ? entry->stat_ : state_->insert(hash, label, length);
+}
+
+size_t StatFamily::getLabelCount() const {
+  return state_->label_count_;
+}
@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file TextRewriteTransformation.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TextRewriteTransformation.h"
+#include <stdint.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int ROOT_STATE = 0;
+const int NO_STATE = -1;
+const int NO_RULE = -1;
+
+/** At most this many distinct first bytes are searched for a word at a time, more are looked up byte by byte. */
+const size_t MAX_WORD_SEARCH_BYTES = 3;
+
+const uint64_t LOW_BITS = 0x0101010101010101ULL;
+const uint64_t HIGH_BITS = 0x8080808080808080ULL;
+
+inline unsigned char foldCase(unsigned char c) {
+  return ((c >= 'A') && (c <= 'Z')) ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+struct Rule {
+  string pattern_;
+  string replacement_;
+  bool first_only_;
+  bool keep_match_; // the replacement goes in front of the matched bytes instead of replacing them.
+};
+
+}
+
+/**
+ * @private
+ *
+ * The rules compiled into a deterministic Aho-Corasick automaton. Bytes are mapped to classes first, one for every
+ * distinct byte of the patterns and class 0 for all the others, which keeps the transition table small.
+ */
+struct atscppapi::transformations::TextRewriteRulesState : noncopyable {
+  bool ignore_case_;
+  vector<Rule> rules_;
+  size_t max_pattern_length_;
+  unsigned char byte_classes_[256];
+  int class_count_;
+  vector<int> transitions_; // state * class_count_ + class, complete so matching never follows failure links.
+  vector<int> depths_; // how many bytes of input a state stands for.
+  vector<int> matches_; // the rule whose pattern ends at a state, NO_RULE if none.
+  vector<int> dictionary_links_; // the nearest state on the failure chain with a match, NO_STATE if none.
+  bool first_bytes_[256]; // bytes that start a pattern.
+  vector<unsigned char> first_byte_list_;
+
+  TextRewriteRulesState(bool ignore_case) : ignore_case_(ignore_case), max_pattern_length_(0), class_count_(1) {
+    memset(byte_classes_, 0, sizeof(byte_classes_));
+    memset(first_bytes_, 0, sizeof(first_bytes_));
+    build();
+  }
+
+  unsigned char normalize(unsigned char c) const {
+    return ignore_case_ ? foldCase(c) : c;
+  }
+
+  void build() {
+    // classes
+    memset(byte_classes_, 0, sizeof(byte_classes_));
+    class_count_ = 1;
+    for (vector<Rule>::const_iterator iter = rules_.begin(), end = rules_.end(); iter != end; ++iter) {
+      for (size_t i = 0; i < iter->pattern_.length(); ++i) {
+        unsigned char c = normalize(static_cast<unsigned char>(iter->pattern_[i]));
+        if (!byte_classes_[c]) {
+          byte_classes_[c] = static_cast<unsigned char>(class_count_++);
+        }
+      }
+    }
+    if (ignore_case_) {
+      for (int c = 'A'; c <= 'Z'; ++c) {
+        byte_classes_[c] = byte_classes_[foldCase(static_cast<unsigned char>(c))];
+      }
+    }
+
+    // the trie
+    const int classes = class_count_;
+    transitions_.assign(classes, NO_STATE);
+    depths_.assign(1, 0);
+    matches_.assign(1, NO_RULE);
+    for (size_t rule = 0; rule < rules_.size(); ++rule) {
+      const string &pattern = rules_[rule].pattern_;
+      int state = ROOT_STATE;
+      for (size_t i = 0; i < pattern.length(); ++i) {
+        int byte_class = byte_classes_[static_cast<unsigned char>(pattern[i])];
+        int next = transitions_[state * classes + byte_class];
+        if (next == NO_STATE) {
+          next = static_cast<int>(depths_.size());
+          transitions_[state * classes + byte_class] = next;
+          transitions_.resize(transitions_.size() + classes, NO_STATE);
+          depths_.push_back(depths_[state] + 1);
+          matches_.push_back(NO_RULE);
+        }
+        state = next;
+      }
+      if (matches_[state] == NO_RULE) { // of identical patterns the first one added is used
+        matches_[state] = static_cast<int>(rule);
+      }
+    }
+
+    // failure links, turning the trie into a complete automaton breadth first
+    const size_t state_count = depths_.size();
+    vector<int> failures(state_count, ROOT_STATE);
+    dictionary_links_.assign(state_count, NO_STATE);
+    vector<int> queue;
+    queue.reserve(state_count);
+    for (int byte_class = 0; byte_class < classes; ++byte_class) {
+      int next = transitions_[byte_class];
+      if (next == NO_STATE) {
+        transitions_[byte_class] = ROOT_STATE;
+      } else {
+        queue.push_back(next);
+      }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+      int state = queue[head];
+      int failure = failures[state];
+      dictionary_links_[state] = (matches_[failure] != NO_RULE) ? failure : dictionary_links_[failure];
+      for (int byte_class = 0; byte_class < classes; ++byte_class) {
+        int next = transitions_[state * classes + byte_class];
+        if (next == NO_STATE) {
+          transitions_[state * classes + byte_class] = transitions_[failure * classes + byte_class];
+        } else {
+          failures[next] = transitions_[failure * classes + byte_class];
+          queue.push_back(next);
+        }
+      }
+    }
+
+    // the bytes that can start a match
+    memset(first_bytes_, 0, sizeof(first_bytes_));
+    first_byte_list_.clear();
+    for (int c = 0; c < 256; ++c) {
+      if (byte_classes_[c] && (transitions_[byte_classes_[c]] != ROOT_STATE)) {
+        first_bytes_[c] = true;
+        first_byte_list_.push_back(static_cast<unsigned char>(c));
+      }
+    }
+  }
+
+  bool addRule(const string &pattern, const string &replacement, bool first_only, bool keep_match) {
+    if (pattern.empty()) {
+      LOG_ERROR("Ignoring the empty pattern of replacement '%s'", replacement.c_str());
+      return false;
+    }
+    Rule rule;
+    rule.pattern_ = pattern;
+    for (size_t i = 0; i < rule.pattern_.length(); ++i) {
+      rule.pattern_[i] = static_cast<char>(normalize(static_cast<unsigned char>(rule.pattern_[i])));
+    }
+    rule.replacement_ = replacement;
+    rule.first_only_ = first_only;
+    rule.keep_match_ = keep_match;
+    rules_.push_back(rule);
+    if (pattern.length() > max_pattern_length_) {
+      max_pattern_length_ = pattern.length();
+    }
+    build();
+    LOG_DEBUG("Added text rewrite rule %zu for pattern '%s', the automaton has %zu states", rules_.size() - 1,
+              pattern.c_str(), depths_.size());
+    return true;
+  }
+
+  bool hasMatch(int state) const {
+    return (matches_[state] != NO_RULE) || (dictionary_links_[state] != NO_STATE);
+  }
+
+  /** @return The longest rule ending at state which may still be applied, NO_RULE if none. */
+  int findRule(int state, const vector<bool> &applied) const {
+    for (int match = (matches_[state] != NO_RULE) ? state : dictionary_links_[state]; match != NO_STATE;
+         match = dictionary_links_[match]) {
+      int rule = matches_[match];
+      if (!rules_[rule].first_only_ || !applied[rule]) {
+        return rule;
+      }
+    }
+    return NO_RULE;
+  }
+
+  /** @return The offset of the first byte at data that starts a pattern, length if there is none. */
+  size_t findStart(const unsigned char *data, size_t length) const {
+    size_t count = first_byte_list_.size();
+    if (count == 1) {
+      const void *found = memchr(data, first_byte_list_[0], length);
+      return found ? static_cast<size_t>(static_cast<const unsigned char *>(found) - data) : length;
+    }
+    size_t i = 0;
+    if (count && (count <= MAX_WORD_SEARCH_BYTES)) {
+      // a word has one of the bytes when xoring it in leaves a zero byte
+      for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        uint64_t zeros = 0;
+        for (size_t k = 0; k < count; ++k) {
+          uint64_t x = word ^ (LOW_BITS * first_byte_list_[k]);
+          zeros |= (x - LOW_BITS) & ~x & HIGH_BITS;
+        }
+        if (zeros) {
+          break;
+        }
+      }
+    }
+    for (; i < length; ++i) {
+      if (first_bytes_[data[i]]) {
+        return i;
+      }
+    }
+    return length;
+  }
+};
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::TextRewriteTransformationState : noncopyable {
+  const TextRewriteRulesState &rules_;
+  int state_; // the automaton state after the input so far.
+  string held_back_; // the input of a possible match not produced yet, it's the last depth of state_ bytes.
+  vector<bool> applied_; // the rules applied at least once, for the first_only ones.
+  size_t replacement_count_;
+
+  TextRewriteTransformationState(const TextRewriteRulesState &rules)
+    : rules_(rules), state_(ROOT_STATE), applied_(rules.rules_.size(), false), replacement_count_(0) { }
+};
+
+TextRewriteRules::TextRewriteRules(bool ignore_case) : state_(new TextRewriteRulesState(ignore_case)) {
+}
+
+bool TextRewriteRules::addReplacement(const string &pattern, const string &replacement, bool first_only) {
+  return state_->addRule(pattern, replacement, first_only, false);
+}
+
+bool TextRewriteRules::addInsertBefore(const string &pattern, const string &snippet, bool first_only) {
+  return state_->addRule(pattern, snippet, first_only, true);
+}
+
+size_t TextRewriteRules::getMaxPatternLength() const {
+  return state_->max_pattern_length_;
+}
+
+TextRewriteRules::~TextRewriteRules() {
+  delete state_;
+}
+
+TextRewriteTransformation::TextRewriteTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const TextRewriteRules &rules)
+  : TransformationPlugin(transaction, type), state_(new TextRewriteTransformationState(*rules.state_)) {
+}
+
+TextRewriteTransformation::TextRewriteTransformation(Transaction &transaction, TransformationChain &chain,
+                                                     const TextRewriteRules &rules)
+  : TransformationPlugin(transaction, chain), state_(new TextRewriteTransformationState(*rules.state_)) {
+}
+
+TextRewriteTransformation::~TextRewriteTransformation() {
+  delete state_;
+}
+
+void TextRewriteTransformation::consume(const string &data) {
+  InputBuffer input(data.data(), data.length());
+  consume(input);
+}
+
+/*
+ * Positions are relative to the start of input, the held back bytes come before it at negative positions, so
+ * [begin, end) can start in held_back_ and continue into input. The input part is produced without a copy.
+ */
+void TextRewriteTransformation::produceRange(InputBuffer &input, int64_t begin, int64_t end) {
+  const string &held_back = state_->held_back_;
+  if (begin < 0) {
+    int64_t held_back_end = (end < 0) ? end : 0;
+    produce(held_back.data() + held_back.length() + begin, static_cast<size_t>(held_back_end - begin));
+    begin = held_back_end;
+  }
+  if (end > begin) {
+    produce(input, static_cast<size_t>(begin), static_cast<size_t>(end - begin));
+  }
+}
+
+void TextRewriteTransformation::consume(InputBuffer &input) {
+  const TextRewriteRulesState &rules = state_->rules_;
+  const int classes = rules.class_count_;
+  const int *transitions = &rules.transitions_[0];
+  const size_t input_length = input.length();
+  int state = state_->state_;
+  int64_t produced = -static_cast<int64_t>(state_->held_back_.length()); // everything before this was produced
+  int64_t block_start = 0;
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+    for (size_t i = 0; i < length; ++i) {
+      if (state == ROOT_STATE) {
+        i += rules.findStart(bytes + i, length - i);
+        if (i == length) {
+          break;
+        }
+      }
+      state = transitions[state * classes + rules.byte_classes_[bytes[i]]];
+      if (!rules.hasMatch(state)) {
+        continue;
+      }
+      int rule = rules.findRule(state, state_->applied_);
+      if (rule == NO_RULE) {
+        continue;
+      }
+      const Rule &matched = rules.rules_[rule];
+      int64_t match_end = block_start + static_cast<int64_t>(i) + 1;
+      int64_t match_start = match_end - static_cast<int64_t>(matched.pattern_.length());
+      produceRange(input, produced, match_start);
+      if (!matched.replacement_.empty()) {
+        produce(matched.replacement_.data(), matched.replacement_.length());
+      }
+      produced = matched.keep_match_ ? match_start : match_end; // kept bytes go out unchanged with the next range
+      state = ROOT_STATE;
+      state_->applied_[rule] = true;
+      ++state_->replacement_count_;
+    }
+    block_start += static_cast<int64_t>(length);
+  }
+
+  // the bytes of a possible match are held back, the rest goes downstream
+  int64_t hold_from = static_cast<int64_t>(input_length) - rules.depths_[state];
+  produceRange(input, produced, hold_from);
+  string held_back;
+  if (hold_from < 0) {
+    held_back.assign(state_->held_back_, state_->held_back_.length() + hold_from, static_cast<size_t>(-hold_from));
+  }
+  if (static_cast<int64_t>(input_length) > hold_from) {
+    size_t from = (hold_from > 0) ? static_cast<size_t>(hold_from) : 0;
+    size_t offset = 0;
+    input.rewind();
+    while (input.nextBlock(data, length)) {
+      if (offset + length > from) {
+        size_t skip = (from > offset) ? from - offset : 0;
+        held_back.append(data + skip, length - skip);
+      }
+      offset += length;
+    }
+  }
+  state_->held_back_.swap(held_back);
+  state_->state_ = state;
+}
+
+void TextRewriteTransformation::handleInputComplete() {
+  if (!state_->held_back_.empty()) {
+    produce(state_->held_back_);
+    state_->held_back_.clear();
+  }
+  state_->state_ = ROOT_STATE;
+  LOG_DEBUG("TextRewriteTransformation=%p made %zu replacements", this, state_->replacement_count_);
+  setOutputComplete();
+}
+
+size_t TextRewriteTransformation::getReplacementCount() const {
+  return state_->replacement_count_;
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TimerWheel.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "TimerWheel.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+namespace {
+
+__thread TimerWheel *current_wheels[TimerWheel::THREAD_POOL_COUNT];
+
+const int64_t NANOSECONDS_PER_TICK = TimerWheel::TICK_MS * 1000000LL;
+
+}
+
+TimerWheel &TimerWheel::getForCurrentThread(AsyncThreadPool thread_pool) {
+  TimerWheel *&wheel = current_wheels[thread_pool];
+  if (!wheel) {
+    wheel = new TimerWheel(thread_pool);
+    LOG_DEBUG("Created timer wheel %p for thread pool %d of this thread", wheel, thread_pool);
+  }
+  return *wheel;
+}
+
+TimerWheel::TimerWheel(AsyncThreadPool thread_pool) : mutex_(Mutex::TYPE_RECURSIVE), thread_pool_(thread_pool),
+#ifdef ATSCPPAPI_HAVE_SCHEDULE_ON_THREAD
+                                                      thread_(TSEventThreadSelf()),
+#endif
+                                                      tick_action_(NULL), start_time_(TShrtime()),
+                                                      current_tick_(0), entry_count_(0) {
+  for (size_t i = 0; i < LEVEL_0_SIZE; ++i) {
+    level_0_[i].prev_ = level_0_[i].next_ = &level_0_[i];
+  }
+  for (int level = 0; level < LEVEL_COUNT - 1; ++level) {
+    for (size_t i = 0; i < LEVEL_SIZE; ++i) {
+      levels_[level][i].prev_ = levels_[level][i].next_ = &levels_[level][i];
+    }
+  }
+  TSMutex null_mutex = NULL; // the wheel's own mutex is taken, it's released while entries fire
+  tick_cont_ = TSContCreate(handleTick, null_mutex);
+  TSContDataSet(tick_cont_, static_cast<void *>(this));
+}
+
+uint64_t TimerWheel::getCurrentTimeTick() const {
+  return static_cast<uint64_t>((TShrtime() - start_time_) / NANOSECONDS_PER_TICK);
+}
+
+void TimerWheel::schedule(TimerWheelEntry &entry, int delay_ms) {
+  TimerWheel *wheel = entry.wheel_ ? entry.wheel_ : &getForCurrentThread(entry.thread_pool_);
+  ScopedMutexLock lock(wheel->mutex_);
+  if (entry.release_pending_) {
+    return;
+  }
+  entry.wheel_ = wheel;
+  if (entry.prev_) {
+    wheel->unlink(entry);
+  }
+  if (!wheel->entry_count_) {
+    wheel->current_tick_ = wheel->getCurrentTimeTick(); // nothing was due while the wheel was idle
+    if (!wheel->tick_action_) {
+      wheel->startTick();
+    }
+  }
+  uint64_t ticks = (delay_ms > 0) ? (delay_ms + TICK_MS - 1) / TICK_MS : 0;
+  // from the time rather than current_tick_, which lags while a tick is late, and one more for the part of
+  // the current tick gone already, so an entry never fires early
+  entry.expiry_tick_ = wheel->getCurrentTimeTick() + ticks + 1;
+  wheel->link(entry);
+}
+
+void TimerWheel::startTick() {
+  switch (thread_pool_) {
+  case ASYNC_THREAD_POOL_TASK:
+    tick_action_ = TSContScheduleEvery(tick_cont_, TICK_MS, TS_THREAD_POOL_TASK);
+    return;
+  case ASYNC_THREAD_POOL_CURRENT_THREAD:
+#ifdef ATSCPPAPI_HAVE_SCHEDULE_ON_THREAD
+    if (thread_) {
+      tick_action_ = TSContScheduleEveryOnThread(tick_cont_, TICK_MS, thread_);
+      return;
+    }
+#endif
+    break;
+  case ASYNC_THREAD_POOL_DEFAULT:
+    break;
+  }
+  tick_action_ = TSContScheduleEvery(tick_cont_, TICK_MS, TS_THREAD_POOL_DEFAULT);
+}
+
+void TimerWheel::cancelAndRelease(TimerWheelEntry &entry) {
+  TimerWheel *wheel = entry.wheel_;
+  if (!wheel) {
+    entry.release();
+    return;
+  }
+  ScopedMutexLock lock(wheel->mutex_);
+  if (entry.prev_) {
+    wheel->unlink(entry);
+  }
+  entry.release_pending_ = true;
+  if (!entry.firing_) {
+    entry.release();
+  } // otherwise advance() releases it once fire() returned
+}
+
+void TimerWheel::link(TimerWheelEntry &entry) {
+  uint64_t delta = entry.expiry_tick_ - current_tick_;
+  TimerWheelLink *head;
+  if (delta < LEVEL_0_SIZE) {
+    head = &level_0_[entry.expiry_tick_ & (LEVEL_0_SIZE - 1)];
+  } else {
+    int level = 1;
+    int shift = LEVEL_0_BITS;
+    while ((level < LEVEL_COUNT - 1) && (delta >= (1ULL << (shift + LEVEL_BITS)))) {
+      ++level;
+      shift += LEVEL_BITS;
+    }
+    uint64_t tick = entry.expiry_tick_;
+    if (delta >= (1ULL << (shift + LEVEL_BITS))) { // beyond the last level, it's cascaded again until it's due
+      tick = current_tick_ + (1ULL << (shift + LEVEL_BITS)) - 1;
+    }
+    head = &getSlot(level, (tick >> shift) & (LEVEL_SIZE - 1));
+  }
+  entry.prev_ = head->prev_;
+  entry.next_ = head;
+  head->prev_->next_ = &entry;
+  head->prev_ = &entry;
+  ++entry_count_;
+}
+
+void TimerWheel::unlink(TimerWheelEntry &entry) {
+  entry.prev_->next_ = entry.next_;
+  entry.next_->prev_ = entry.prev_;
+  entry.prev_ = entry.next_ = NULL;
+  --entry_count_;
+}
+
+void TimerWheel::cascade(int level) {
+  int shift = LEVEL_0_BITS + (level - 1) * LEVEL_BITS;
+  TimerWheelLink &head = getSlot(level, (current_tick_ >> shift) & (LEVEL_SIZE - 1));
+  while (head.next_ != &head) {
+    TimerWheelEntry &entry = *static_cast<TimerWheelEntry *>(head.next_);
+    unlink(entry);
+    link(entry);
+  }
+}
+
+void TimerWheel::advance(uint64_t target_tick) {
+  while (current_tick_ < target_tick) {
+    ++current_tick_;
+    if (!(current_tick_ & (LEVEL_0_SIZE - 1))) {
+      int top_level = 1; // the lower levels' slots wrapped, cascade the upper levels first
+      int shift = LEVEL_0_BITS;
+      while ((top_level < LEVEL_COUNT - 1) && !((current_tick_ >> shift) & (LEVEL_SIZE - 1))) {
+        ++top_level;
+        shift += LEVEL_BITS;
+      }
+      for (int level = top_level; level > 0; --level) {
+        cascade(level);
+      }
+    }
+    TimerWheelLink &head = level_0_[current_tick_ & (LEVEL_0_SIZE - 1)];
+    while (head.next_ != &head) {
+      TimerWheelEntry &entry = *static_cast<TimerWheelEntry *>(head.next_);
+      unlink(entry);
+      if (entry.expiry_tick_ > current_tick_) { // clamped to the last level when it was linked
+        link(entry);
+        continue;
+      }
+      entry.firing_ = true;
+      mutex_.unlock(); // fire() dispatches to receivers, which may be canceling timers under their own mutex
+      entry.fire();
+      mutex_.lock();
+      entry.firing_ = false;
+      if (entry.release_pending_) {
+        entry.release();
+      }
+    }
+  }
+}
+
+int TimerWheel::handleTick(TSCont cont, TSEvent, void *) {
+  TimerWheel *wheel = static_cast<TimerWheel *>(TSContDataGet(cont));
+  wheel->mutex_.lock();
+  wheel->advance(wheel->getCurrentTimeTick());
+  if (!wheel->entry_count_ && wheel->tick_action_) {
+    LOG_DEBUG("Timer wheel %p is idle, stopping its tick", wheel);
+    TSActionCancel(wheel->tick_action_);
+    wheel->tick_action_ = NULL;
+  }
+  wheel->mutex_.unlock();
+  return 0;
+}
@@ -17,68 +17,177 @@
  */
 
 #include "atscppapi/Transaction.h"
+#include "atscppapi/TransactionHandle.h"
+#include "atscppapi/TransactionContextKey.h"
+#include "atscppapi/TransactionPlugin.h"
 #include <cstdlib>
 #include <cstring>
 #include <map>
 #include <string>
+#include <vector>
 #include <ts/ts.h>
 #include "atscppapi/shared_ptr.h"
+#include "atscppapi/Arena.h"
+#include "atscppapi/Mutex.h"
 #include "logging_internal.h"
 #include "utils_internal.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "atscppapi/noncopyable.h"
 
 using std::map;
 using std::string;
 using namespace atscppapi;
 
+namespace {
+
+typedef map<string, shared_ptr<Transaction::ContextValue>, std::less<string>,
+            ArenaAllocator<std::pair<const string, shared_ptr<Transaction::ContextValue> > > > ContextValueMap;
+
+/**
+ * The internal hooks keeping a Transaction's requests and responses current. They are only added to
+ * a transaction once the object they maintain has been asked for.
+ */
+enum ManagementHook {
+  MANAGEMENT_HOOK_POST_REMAP = 1 << 0, // client request url reset
+  MANAGEMENT_HOOK_SEND_REQUEST_HDR = 1 << 1, // server request
+  MANAGEMENT_HOOK_READ_RESPONSE_HDR = 1 << 2, // server response
+  MANAGEMENT_HOOK_SEND_RESPONSE_HDR = 1 << 3 // client response
+};
+
+const int HOOK_TYPE_COUNT = Plugin::HOOK_CACHE_LOOKUP_COMPLETE + 1;
+
+typedef std::vector<TransactionPlugin *, ArenaAllocator<TransactionPlugin *> > HookPluginList;
+
+/**
+ * Where the plugin-hook dispatch of a Transaction is; the plugin being called may resume from another
+ * thread while it is still being called, so the transitions are atomic.
+ */
+enum DispatchState {
+  DISPATCH_IDLE = 0, // no plugins being called, resume() reenables the transaction right away
+  DISPATCH_IN_CALLBACK, // a plugin hook is running
+  DISPATCH_RESUMED_IN_CALLBACK, // ... and resumed before returning, the next plugin is called
+  DISPATCH_WAITING // the plugin went async, its resume() continues with the next plugin
+};
+
+int handleDispatchEvents(TSCont cont, TSEvent event, void *edata);
+
+void continueTransactionPluginHooks(Transaction &transaction, int event, size_t first_index) {
+  utils::internal::dispatchTransactionPluginHooks(transaction, event, first_index);
+}
+
+
+}
+
 /**
  * @private
  */
-struct atscppapi::TransactionState: noncopyable {
+struct atscppapi::TransactionState: noncopyable, ArenaAllocated {
   TSHttpTxn txn_;
   std::list<TransactionPlugin *> plugins_;
+  // The requests and responses are only built once they are asked for, see the Transaction accessors.
   TSMBuffer client_request_hdr_buf_;
   TSMLoc client_request_hdr_loc_;
-  ClientRequest client_request_;
+  ClientRequest *client_request_;
   TSMBuffer server_request_hdr_buf_;
   TSMLoc server_request_hdr_loc_;
-  Request server_request_;
+  Request *server_request_;
   TSMBuffer server_response_hdr_buf_;
   TSMLoc server_response_hdr_loc_;
-  Response server_response_;
+  Response *server_response_;
   TSMBuffer client_response_hdr_buf_;
   TSMLoc client_response_hdr_loc_;
-  Response client_response_;
-  map<string, shared_ptr<Transaction::ContextValue> > context_values_;
-
-  TransactionState(TSHttpTxn txn, TSMBuffer client_request_hdr_buf, TSMLoc client_request_hdr_loc)
-    : txn_(txn), client_request_hdr_buf_(client_request_hdr_buf), client_request_hdr_loc_(client_request_hdr_loc),
-      client_request_(txn, client_request_hdr_buf, client_request_hdr_loc),
-      server_request_hdr_buf_(NULL), server_request_hdr_loc_(NULL),
-      server_response_hdr_buf_(NULL), server_response_hdr_loc_(NULL),
-      client_response_hdr_buf_(NULL), client_response_hdr_loc_(NULL)
-  { };
-};
+  Response *client_response_;
+  TSMBuffer cached_response_hdr_buf_;
+  TSMLoc cached_response_hdr_loc_;
+  Response *cached_response_;
+  TSMBuffer transformed_response_hdr_buf_;
+  TSMLoc transformed_response_hdr_loc_;
+  Response *transformed_response_;
+  Arena &arena_;
+  ContextValueMap context_values_;
+  void *context_slots_[TransactionContextKeyBase::MAX_CONTEXT_SLOTS];
+  shared_ptr<Mutex> plugin_mutex_;
+  // All TransactionPlugin hooks of the transaction go through one continuation, see dispatchPluginHooks()
+  TSCont dispatch_cont_;
+  HookPluginList *hook_plugins_[HOOK_TYPE_COUNT];
+  TSEvent dispatch_event_;
+  size_t dispatch_index_;
+  void (*dispatch_continuation_)(Transaction &, int, size_t); // what continues a dispatch after a plugin went async
+  volatile int dispatch_state_;
+  HookTiming *hook_timing_; // of the plugin being waited for, see beginHookTiming()
+  int hook_timing_type_;
+  int64_t hook_timing_start_;
+  TransactionTrace *trace_; // lives in the arena, see Tracer::startTrace()
+  TransactionMemoryState *memory_; // lives in the arena, see MemoryAccounting
+  unsigned int management_hooks_; // the internal hooks already added to this transaction, see ManagementHook.
+  bool client_url_remapped_; // the client request url was reset after remap, see beginPluginCallback()
+  Session *session_; // NULL until getSession() is first called
+
+  TransactionState(TSHttpTxn txn, Arena &arena)
+    : txn_(txn), client_request_hdr_buf_(NULL), client_request_hdr_loc_(NULL), client_request_(NULL),
+      server_request_hdr_buf_(NULL), server_request_hdr_loc_(NULL), server_request_(NULL),
+      server_response_hdr_buf_(NULL), server_response_hdr_loc_(NULL), server_response_(NULL),
+      client_response_hdr_buf_(NULL), client_response_hdr_loc_(NULL), client_response_(NULL),
+      cached_response_hdr_buf_(NULL), cached_response_hdr_loc_(NULL), cached_response_(NULL),
+      transformed_response_hdr_buf_(NULL), transformed_response_hdr_loc_(NULL), transformed_response_(NULL),
+      arena_(arena),
+      context_values_(std::less<string>(), ContextValueMap::allocator_type(&arena)), dispatch_cont_(NULL),
+      dispatch_event_(TS_EVENT_NONE), dispatch_index_(0), dispatch_continuation_(NULL),
+      dispatch_state_(DISPATCH_IDLE), hook_timing_(NULL), hook_timing_type_(0), hook_timing_start_(0), trace_(NULL),
+      memory_(NULL), management_hooks_(0), client_url_remapped_(false), session_(NULL) {
+    memset(context_slots_, 0, sizeof(context_slots_));
+    memset(hook_plugins_, 0, sizeof(hook_plugins_));
+  };
+
+  /** Writes the cookie edits of the requests and responses built so far, before Traffic Server reads them. */
+  void flushCookies() {
+    if (client_request_) {
+      client_request_->getHeaders().flushCookies();
+    }
+    if (server_request_) {
+      server_request_->getHeaders().flushCookies();
+    }
+    if (server_response_) {
+      server_response_->getHeaders().flushCookies();
+    }
+    if (client_response_) {
+      client_response_->getHeaders().flushCookies();
+    }
+    if (transformed_response_) {
+      transformed_response_->getHeaders().flushCookies();
+    }
+  }
 
-Transaction::Transaction(void *raw_txn) {
-  TSHttpTxn txn = static_cast<TSHttpTxn>(raw_txn);
-  TSMBuffer hdr_buf;
-  TSMLoc hdr_loc;
-  TSHttpTxnClientReqGet(txn, &hdr_buf, &hdr_loc);
-  if (!hdr_buf || !hdr_loc) {
-    LOG_ERROR("TSHttpTxnClientReqGet tshttptxn=%p returned a null hdr_buf=%p or hdr_loc=%p.", txn, hdr_buf, hdr_loc);
+  /** @return The dispatcher continuation, created on first use. */
+  TSCont getDispatchCont(Transaction *transaction) {
+    if (!dispatch_cont_) {
+      dispatch_cont_ = TSContCreate(handleDispatchEvents, TSMutexCreate());
+      TSContDataSet(dispatch_cont_, static_cast<void *>(transaction));
+    }
+    return dispatch_cont_;
+  }
+
+  /** The requests and responses are created in the arena and destroyed with it. */
+  template <typename T> T *create() {
+    Arena::Scope arena_scope(&arena_);
+    return arena_.create<T>();
   }
+};
 
-  state_ = new TransactionState(txn, hdr_buf, hdr_loc);
-  LOG_DEBUG("Transaction tshttptxn=%p constructing Transaction object %p, client req hdr_buf=%p, client req hdr_loc=%p",
-      txn, this, hdr_buf, hdr_loc);
+Transaction::Transaction(void *raw_txn, Arena &arena) {
+  TSHttpTxn txn = static_cast<TSHttpTxn>(raw_txn);
+  Arena::Scope arena_scope(&arena); // the state and everything it holds is allocated from the arena
+  state_ = new TransactionState(txn, arena);
+  LOG_DEBUG("Transaction tshttptxn=%p constructing Transaction object %p", txn, this);
 }
 
 Transaction::~Transaction() {
   LOG_DEBUG("Transaction tshttptxn=%p destroying Transaction object %p", state_->txn_, this);
   static const TSMLoc NULL_PARENT_LOC = NULL;
-  TSHandleMLocRelease(state_->client_request_hdr_buf_, NULL_PARENT_LOC, state_->client_request_hdr_loc_);
+  if (state_->client_request_hdr_buf_ && state_->client_request_hdr_loc_) {
+    TSHandleMLocRelease(state_->client_request_hdr_buf_, NULL_PARENT_LOC, state_->client_request_hdr_loc_);
+  }
   if (state_->server_request_hdr_buf_ && state_->server_request_hdr_loc_) {
     LOG_DEBUG("Releasing server request");
     TSHandleMLocRelease(state_->server_request_hdr_buf_, NULL_PARENT_LOC, state_->server_request_hdr_loc_);
@@ -91,39 +200,185 @@ Transaction::~Transaction() {
     LOG_DEBUG("Releasing client response");
     TSHandleMLocRelease(state_->client_response_hdr_buf_, NULL_PARENT_LOC, state_->client_response_hdr_loc_);
   }
+  if (state_->cached_response_hdr_buf_ && state_->cached_response_hdr_loc_) {
+    LOG_DEBUG("Releasing cached response");
+    TSHandleMLocRelease(state_->cached_response_hdr_buf_, NULL_PARENT_LOC, state_->cached_response_hdr_loc_);
+  }
+  if (state_->transformed_response_hdr_buf_ && state_->transformed_response_hdr_loc_) {
+    LOG_DEBUG("Releasing transformed response");
+    TSHandleMLocRelease(state_->transformed_response_hdr_buf_, NULL_PARENT_LOC, state_->transformed_response_hdr_loc_);
+  }
+  if (state_->dispatch_cont_) {
+    TSContDestroy(state_->dispatch_cont_);
+  }
   delete state_;
 }
 
+Arena &Transaction::getArena() {
+  return state_->arena_;
+}
+
 void Transaction::resume() {
+  if (state_->hook_timing_) {
+    endHookTiming();
+  }
+  volatile int &dispatch_state = state_->dispatch_state_;
+  if (__sync_bool_compare_and_swap(&dispatch_state, DISPATCH_IN_CALLBACK, DISPATCH_RESUMED_IN_CALLBACK)) {
+    return; // whoever is dispatching carries on with the next plugin
+  }
+  if (__sync_bool_compare_and_swap(&dispatch_state, DISPATCH_WAITING, DISPATCH_IDLE)) {
+    // don't call the remaining plugins from whichever thread completed the async operation
+    LOG_DEBUG("Transaction tshttptxn=%p rescheduling plugin dispatch", state_->txn_);
+    TSContSchedule(state_->getDispatchCont(this), 0, TS_THREAD_POOL_DEFAULT);
+    return;
+  }
+  state_->flushCookies();
   TSHttpTxnReenable(state_->txn_, static_cast<TSEvent>(TS_EVENT_HTTP_CONTINUE));
 }
 
 void Transaction::error() {
+  if (state_->hook_timing_) {
+    endHookTiming();
+  }
+  // the remaining plugins of a dispatch are skipped, as they would be by Traffic Server
+  __sync_lock_test_and_set(&state_->dispatch_state_, DISPATCH_IDLE);
   LOG_DEBUG("Transaction tshttptxn=%p reenabling to error state", state_->txn_);
+  state_->flushCookies();
   TSHttpTxnReenable(state_->txn_, static_cast<TSEvent>(TS_EVENT_HTTP_ERROR));
 }
 
+TransactionTrace *Transaction::getTrace() const {
+  return state_->trace_;
+}
+
+void Transaction::setTrace(TransactionTrace *trace) {
+  state_->trace_ = trace;
+}
+
+TransactionMemoryState *Transaction::getMemory() const {
+  return state_->memory_;
+}
+
+void Transaction::setMemory(TransactionMemoryState *memory) {
+  state_->memory_ = memory;
+}
+
+void Transaction::beginHookTiming(HookTiming *timing, int hook_type, int64_t start_time) {
+  state_->hook_timing_ = timing;
+  state_->hook_timing_type_ = hook_type;
+  state_->hook_timing_start_ = start_time;
+}
+
+void Transaction::endHookTiming() {
+  HookTiming *timing = state_->hook_timing_;
+  state_->hook_timing_ = NULL;
+  utils::internal::recordHookResumeTime(timing, state_->hook_timing_type_, TShrtime() - state_->hook_timing_start_);
+}
+
+void Transaction::addPluginHook(TransactionPlugin *plugin, int hook_type) {
+  if ((hook_type < 0) || (hook_type >= HOOK_TYPE_COUNT)) {
+    LOG_ERROR("Transaction tshttptxn=%p got invalid hook type %d", state_->txn_, hook_type);
+    return;
+  }
+  HookPluginList *&plugins = state_->hook_plugins_[hook_type];
+  if (!plugins) {
+    plugins = state_->arena_.create<HookPluginList>(HookPluginList::allocator_type(&state_->arena_));
+    TSHttpTxnHookAdd(state_->txn_, utils::internal::convertInternalHookToTsHook(static_cast<Plugin::HookType>(hook_type)),
+                     state_->getDispatchCont(this));
+  }
+  plugins->push_back(plugin);
+}
+
+void Transaction::continuePluginDispatch() {
+  state_->dispatch_continuation_(*this, state_->dispatch_event_, state_->dispatch_index_ + 1);
+}
+
+
+void Transaction::beginPluginCallback(int event, size_t index, DispatchFunction continuation) {
+  // global hooks run before the management hook, so the first plugin after remap resets the url already
+  if ((event == TS_EVENT_HTTP_POST_REMAP) && !state_->client_url_remapped_ && state_->client_request_) {
+    state_->client_request_->getUrl().reset();
+    state_->client_url_remapped_ = true;
+  }
+  state_->dispatch_event_ = static_cast<TSEvent>(event);
+  state_->dispatch_index_ = index;
+  state_->dispatch_continuation_ = continuation;
+  state_->dispatch_state_ = DISPATCH_IN_CALLBACK;
+}
+
+bool Transaction::endPluginCallback() {
+  volatile int &dispatch_state = state_->dispatch_state_;
+  if (__sync_bool_compare_and_swap(&dispatch_state, DISPATCH_IN_CALLBACK, DISPATCH_WAITING)) {
+    LOG_DEBUG("Transaction tshttptxn=%p plugin %zu went async on event %d", state_->txn_, state_->dispatch_index_,
+              state_->dispatch_event_);
+    return false;
+  }
+  return (dispatch_state == DISPATCH_RESUMED_IN_CALLBACK); // or error()
+}
+
+void Transaction::endPluginDispatch() {
+  state_->dispatch_state_ = DISPATCH_IDLE;
+  state_->flushCookies();
+  TSHttpTxnReenable(state_->txn_, static_cast<TSEvent>(TS_EVENT_HTTP_CONTINUE));
+}
+
+void Transaction::dispatchPluginHooks(int event, size_t first_index) {
+  int hook_type = utils::internal::convertTsEventToInternalHook(static_cast<TSEvent>(event));
+  HookPluginList *plugins = (hook_type >= 0) ? state_->hook_plugins_[hook_type] : NULL;
+  // plugins may register for this same hook while being called, so the size is read every time
+  for (size_t i = first_index; plugins && (i < plugins->size()); ++i) {
+    beginPluginCallback(event, i, continueTransactionPluginHooks);
+    utils::internal::invokePluginForEvent((*plugins)[i], state_->txn_, static_cast<TSEvent>(event));
+    if (!endPluginCallback()) {
+      return;
+    }
+  }
+  endPluginDispatch();
+}
+
+namespace {
+
+int handleDispatchEvents(TSCont cont, TSEvent event, void *edata) {
+  Transaction *transaction = static_cast<Transaction *>(TSContDataGet(cont));
+  if (utils::internal::convertTsEventToInternalHook(event) >= 0) {
+    utils::internal::dispatchTransactionPluginHooks(*transaction, event, 0);
+  } else { // scheduled by resume(), continue after the plugin that went async
+    utils::internal::continuePluginDispatch(*transaction);
+  }
+  return 0;
+}
+
+}
+
 void Transaction::error(const std::string &page) {
   setErrorBody(page);
   error(); // finally, reenable with HTTP_ERROR
 }
 
 void Transaction::setErrorBody(const std::string &page) {
-  LOG_DEBUG("Transaction tshttptxn=%p setting error body page: %s", state_->txn_, page.c_str());
-  char *res_bdy = static_cast<char*>(TSmalloc(page.length() + 1));
-  strncpy(res_bdy, page.c_str(), page.length());
-  res_bdy[page.length()] = '\0';
+  setResponseBody(page.data(), page.length());
+}
 
-  std::string str_content_type = "text/html";
-  char *content_type = static_cast<char*>(TSmalloc(str_content_type.length() + 1));
-  strncpy(content_type, str_content_type.c_str(), str_content_type.length());
-  content_type[str_content_type.length()] = '\0';
+void Transaction::setResponseBody(const char *body, size_t length, const char *content_type) {
+  char *body_copy = static_cast<char *>(TSmalloc(length + 1));
+  if (length) {
+    memcpy(body_copy, body, length);
+  }
+  body_copy[length] = '\0';
+  size_t content_type_length = strlen(content_type);
+  char *content_type_copy = static_cast<char *>(TSmalloc(content_type_length + 1));
+  memcpy(content_type_copy, content_type, content_type_length + 1);
+  adoptResponseBody(body_copy, length, content_type_copy);
+}
 
-  TSHttpTxnErrorBodySet(state_->txn_, res_bdy, page.length(), content_type);
+void Transaction::adoptResponseBody(char *body, size_t length, char *content_type) {
+  LOG_DEBUG("Transaction tshttptxn=%p setting response body of %zu bytes with content type %s", state_->txn_,
+            length, content_type);
+  TSHttpTxnErrorBodySet(state_->txn_, body, length, content_type);
 }
 
 bool Transaction::isInternalRequest() const {
-  return TSHttpIsInternalRequest(state_->txn_) == TS_SUCCESS;
+  return getHandle().isInternalRequest();
 }
 
 void *Transaction::getAtsHandle() const {
@@ -141,7 +396,7 @@ void Transaction::addPlugin(TransactionPlugin *plugin) {
 
 shared_ptr<Transaction::ContextValue> Transaction::getContextValue(const std::string &key) {
   shared_ptr<Transaction::ContextValue> return_context_value;
-  map<string, shared_ptr<Transaction::ContextValue> >::iterator iter = state_->context_values_.find(key);
+  ContextValueMap::iterator iter = state_->context_values_.find(key);
   if (iter != state_->context_values_.end()) {
     return_context_value = iter->second;
   }
@@ -153,64 +408,163 @@ void Transaction::setContextValue(const std::string &key, shared_ptr<Transaction
   state_->context_values_[key] = value;
 }
 
+void **Transaction::getContextSlots() {
+  return state_->context_slots_;
+}
+
+shared_ptr<Mutex> &Transaction::getPluginMutex() {
+  return state_->plugin_mutex_;
+}
+
+void Transaction::addManagementHook(unsigned int hook, int ts_hook_id) {
+  if (!(state_->management_hooks_ & hook)) {
+    state_->management_hooks_ |= hook;
+    utils::internal::addTransactionManagementHook(state_->txn_, static_cast<TSHttpHookID>(ts_hook_id));
+  }
+}
+
 ClientRequest &Transaction::getClientRequest() {
-  return state_->client_request_;
+  if (!state_->client_request_) {
+    TSHttpTxnClientReqGet(state_->txn_, &state_->client_request_hdr_buf_, &state_->client_request_hdr_loc_);
+    if (!state_->client_request_hdr_buf_ || !state_->client_request_hdr_loc_) {
+      LOG_ERROR("TSHttpTxnClientReqGet tshttptxn=%p returned a null hdr_buf=%p or hdr_loc=%p.", state_->txn_,
+                state_->client_request_hdr_buf_, state_->client_request_hdr_loc_);
+    }
+    Arena::Scope arena_scope(&state_->arena_);
+    state_->client_request_ = state_->arena_.create<ClientRequest>(static_cast<void *>(state_->txn_),
+                                                                   static_cast<void *>(state_->client_request_hdr_buf_),
+                                                                   static_cast<void *>(state_->client_request_hdr_loc_));
+    LOG_DEBUG("Transaction tshttptxn=%p initialized client request with hdr_buf=%p, hdr_loc=%p", state_->txn_,
+              state_->client_request_hdr_buf_, state_->client_request_hdr_loc_);
+  }
+  addManagementHook(MANAGEMENT_HOOK_POST_REMAP, TS_HTTP_POST_REMAP_HOOK);
+  return *state_->client_request_;
 }
 
 Request &Transaction::getServerRequest() {
-  return state_->server_request_;
+  // the hook picks the request up once it exists, if it doesn't yet
+  if (!state_->server_request_hdr_buf_ && !initServerRequest()) {
+    addManagementHook(MANAGEMENT_HOOK_SEND_REQUEST_HDR, TS_HTTP_SEND_REQUEST_HDR_HOOK);
+  }
+  return *state_->server_request_;
 }
 
 Response &Transaction::getServerResponse() {
-  return state_->server_response_;
+  if (!state_->server_response_hdr_buf_ && !initServerResponse()) {
+    addManagementHook(MANAGEMENT_HOOK_READ_RESPONSE_HDR, TS_HTTP_READ_RESPONSE_HDR_HOOK);
+  }
+  return *state_->server_response_;
 }
 
 Response &Transaction::getClientResponse() {
-  return state_->client_response_;
+  if (!state_->client_response_hdr_buf_ && !initClientResponse()) {
+    addManagementHook(MANAGEMENT_HOOK_SEND_RESPONSE_HDR, TS_HTTP_SEND_RESPONSE_HDR_HOOK);
+  }
+  return *state_->client_response_;
+}
+
+Response &Transaction::getCachedResponse() {
+  // there's no later hook to pick it up from, a hit is there from HOOK_CACHE_LOOKUP_COMPLETE on
+  if (!state_->cached_response_hdr_buf_) {
+    initCachedResponse();
+  }
+  return *state_->cached_response_;
+}
+
+Response &Transaction::getTransformedResponse() {
+  // it's created once a response transformation is set up, before the transformation gets any input
+  if (!state_->transformed_response_hdr_buf_) {
+    initTransformedResponse();
+  }
+  return *state_->transformed_response_;
+}
+
+Transaction::CacheStatus Transaction::getCacheStatus() const {
+  int lookup_status;
+  if (TSHttpTxnCacheLookupStatusGet(state_->txn_, &lookup_status) != TS_SUCCESS) {
+    LOG_DEBUG("Cache lookup status of transaction tshttptxn=%p not available", state_->txn_);
+    return CACHE_STATUS_UNKNOWN;
+  }
+  switch (lookup_status) {
+  case TS_CACHE_LOOKUP_MISS:
+    return CACHE_STATUS_MISS;
+  case TS_CACHE_LOOKUP_HIT_STALE:
+    return CACHE_STATUS_HIT_STALE;
+  case TS_CACHE_LOOKUP_HIT_FRESH:
+    return CACHE_STATUS_HIT_FRESH;
+  case TS_CACHE_LOOKUP_SKIPPED:
+    return CACHE_STATUS_SKIPPED;
+  default:
+    LOG_ERROR("Unknown cache lookup status %d of transaction tshttptxn=%p", lookup_status, state_->txn_);
+    return CACHE_STATUS_UNKNOWN;
+  }
+}
+
+bool Transaction::setCacheStatus(CacheStatus status) {
+  int lookup_status;
+  switch (status) {
+  case CACHE_STATUS_MISS:
+    lookup_status = TS_CACHE_LOOKUP_MISS;
+    break;
+  case CACHE_STATUS_HIT_STALE:
+    lookup_status = TS_CACHE_LOOKUP_HIT_STALE;
+    break;
+  case CACHE_STATUS_HIT_FRESH:
+    lookup_status = TS_CACHE_LOOKUP_HIT_FRESH;
+    break;
+  case CACHE_STATUS_SKIPPED:
+    lookup_status = TS_CACHE_LOOKUP_SKIPPED;
+    break;
+  default:
+    LOG_ERROR("Cannot set cache lookup status %d", status);
+    return false;
+  }
+  if (TSHttpTxnCacheLookupStatusSet(state_->txn_, lookup_status) != TS_SUCCESS) {
+    LOG_ERROR("Could not set cache lookup status of transaction tshttptxn=%p to %d", state_->txn_, lookup_status);
+    return false;
+  }
+  LOG_DEBUG("Set cache lookup status of transaction tshttptxn=%p to %d", state_->txn_, lookup_status);
+  return true;
+}
+
+TransactionHandle Transaction::getHandle() const {
+  return TransactionHandle(state_->txn_);
+}
+
+Session &Transaction::getSession() {
+  if (!state_->session_) {
+    state_->session_ = &utils::internal::getSession(TSHttpTxnSsnGet(state_->txn_));
+    utils::internal::countSessionTransaction(*state_->session_);
+  }
+  return *state_->session_;
 }
 
 const sockaddr *Transaction::getIncomingAddress() const {
-  return TSHttpTxnIncomingAddrGet(state_->txn_);
+  return getHandle().getIncomingAddress();
 }
 
 const sockaddr *Transaction::getClientAddress() const {
-  return TSHttpTxnClientAddrGet(state_->txn_);
+  return getHandle().getClientAddress();
 }
 
 const sockaddr *Transaction::getNextHopAddress() const {
-  return TSHttpTxnNextHopAddrGet(state_->txn_);
+  return getHandle().getNextHopAddress();
 }
 
 const sockaddr *Transaction::getServerAddress() const {
-  return TSHttpTxnServerAddrGet(state_->txn_);
+  return getHandle().getServerAddress();
 }
 
 bool Transaction::setServerAddress(const sockaddr *sockaddress) {
-  return TSHttpTxnServerAddrSet(state_->txn_,sockaddress) == TS_SUCCESS;
+  return getHandle().setServerAddress(sockaddress);
 }
 
 bool Transaction::setIncomingPort(uint16_t port) {
-  TSHttpTxnClientIncomingPortSet(state_->txn_, port);
-  return true; // In reality TSHttpTxnClientIncomingPortSet should return SUCCESS or ERROR.
+  return getHandle().setIncomingPort(port);
 }
 
 void Transaction::setTimeout(Transaction::TimeoutType type, int time_ms) {
-  switch (type) {
-    case TIMEOUT_DNS:
-      TSHttpTxnDNSTimeoutSet(state_->txn_, time_ms);
-      break;
-    case TIMEOUT_CONNECT:
-      TSHttpTxnConnectTimeoutSet(state_->txn_, time_ms);
-      break;
-    case TIMEOUT_NO_ACTIVITY:
-      TSHttpTxnNoActivityTimeoutSet(state_->txn_, time_ms);
-      break;
-    case TIMEOUT_ACTIVE:
-      TSHttpTxnActiveTimeoutSet(state_->txn_, time_ms);
-      break;
-    default:
-      break;
-  }
+  getHandle().setTimeout(type, time_ms);
 }
 
 namespace {
@@ -230,17 +584,17 @@ public:
   typedef TSReturnCode (*GetterFunction)(TSHttpTxn, TSMBuffer *, TSMLoc *);
   initializeHandles(GetterFunction getter) : getter_(getter) { }
   bool operator()(TSHttpTxn txn, TSMBuffer &hdr_buf, TSMLoc &hdr_loc, const char *handles_name) {
-    if (!hdr_buf && !hdr_loc) {
-      if (getter_(txn, &hdr_buf, &hdr_loc) == TS_SUCCESS) {
-        return true;
-      }
-      else {
-        LOG_ERROR("Could not get %s", handles_name);
-      }
+    if (hdr_buf || hdr_loc) {
+      LOG_DEBUG("%s already initialized", handles_name);
+      return false;
     }
-    else {
-      LOG_ERROR("%s already initialized", handles_name);
+    if (getter_(txn, &hdr_buf, &hdr_loc) == TS_SUCCESS) {
+      return true;
     }
+    // expected when asked for before Traffic Server has it, the management hook retries then
+    LOG_DEBUG("Could not get %s yet", handles_name);
+    hdr_buf = NULL;
+    hdr_loc = NULL;
     return false;
   }
 private:
@@ -249,29 +603,72 @@ private:
 
 } // anonymous namespace
 
-void Transaction::initServerRequest() {
+bool Transaction::initServerRequest() {
+  if (!state_->server_request_) {
+    state_->server_request_ = state_->create<Request>();
+  }
   static initializeHandles initializeServerRequestHandles(TSHttpTxnServerReqGet);
   if (initializeServerRequestHandles(state_->txn_, state_->server_request_hdr_buf_,
                                      state_->server_request_hdr_loc_, "server request")) {
     LOG_DEBUG("Initializing server request");
-    state_->server_request_.init(state_->server_request_hdr_buf_, state_->server_request_hdr_loc_);
+    state_->server_request_->init(state_->server_request_hdr_buf_, state_->server_request_hdr_loc_);
+    return true;
   }
+  return false;
 }
 
-void Transaction::initServerResponse() {
+bool Transaction::initServerResponse() {
+  if (!state_->server_response_) {
+    state_->server_response_ = state_->create<Response>();
+  }
   static initializeHandles initializeServerResponseHandles(TSHttpTxnServerRespGet);
   if (initializeServerResponseHandles(state_->txn_, state_->server_response_hdr_buf_,
                                       state_->server_response_hdr_loc_, "server response")) {
     LOG_DEBUG("Initializing server response");
-    state_->server_response_.init(state_->server_response_hdr_buf_, state_->server_response_hdr_loc_);
+    state_->server_response_->init(state_->server_response_hdr_buf_, state_->server_response_hdr_loc_);
+    return true;
   }
+  return false;
 }
 
-void Transaction::initClientResponse() {
+bool Transaction::initClientResponse() {
+  if (!state_->client_response_) {
+    state_->client_response_ = state_->create<Response>();
+  }
   static initializeHandles initializeClientResponseHandles(TSHttpTxnClientRespGet);
   if (initializeClientResponseHandles(state_->txn_, state_->client_response_hdr_buf_,
                                       state_->client_response_hdr_loc_, "client response")) {
     LOG_DEBUG("Initializing client response");
-    state_->client_response_.init(state_->client_response_hdr_buf_, state_->client_response_hdr_loc_);
+    state_->client_response_->init(state_->client_response_hdr_buf_, state_->client_response_hdr_loc_);
+    return true;
+  }
+  return false;
+}
+
+bool Transaction::initCachedResponse() {
+  if (!state_->cached_response_) {
+    state_->cached_response_ = state_->create<Response>();
+  }
+  static initializeHandles initializeCachedResponseHandles(TSHttpTxnCachedRespGet);
+  if (initializeCachedResponseHandles(state_->txn_, state_->cached_response_hdr_buf_,
+                                      state_->cached_response_hdr_loc_, "cached response")) {
+    LOG_DEBUG("Initializing cached response");
+    state_->cached_response_->init(state_->cached_response_hdr_buf_, state_->cached_response_hdr_loc_);
+    return true;
+  }
+  return false;
+}
+
+bool Transaction::initTransformedResponse() {
+  if (!state_->transformed_response_) {
+    state_->transformed_response_ = state_->create<Response>();
+  }
+  static initializeHandles initializeTransformedResponseHandles(TSHttpTxnTransformRespGet);
+  if (initializeTransformedResponseHandles(state_->txn_, state_->transformed_response_hdr_buf_,
+                                           state_->transformed_response_hdr_loc_, "transformed response")) {
+    LOG_DEBUG("Initializing transformed response");
+    state_->transformed_response_->init(state_->transformed_response_hdr_buf_, state_->transformed_response_hdr_loc_);
+    return true;
   }
+  return false;
 }
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionContextKey.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TransactionContextKey.h"
+#include <ts/ts.h>
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+namespace {
+
+int next_slot_index = 0;
+
+}
+
+TransactionContextKeyBase::TransactionContextKeyBase(const std::string &name) : ts_arg_index_(-1), slot_index_(-1) {
+  int arg_index;
+  if (TSHttpArgIndexReserve(name.c_str(), "atscppapi transaction context key", &arg_index) == TS_SUCCESS) {
+    ts_arg_index_ = arg_index;
+    LOG_DEBUG("Context key '%s' reserved transaction argument %d", name.c_str(), ts_arg_index_);
+    return;
+  }
+
+  int slot_index = __sync_fetch_and_add(&next_slot_index, 1);
+  if (slot_index < MAX_CONTEXT_SLOTS) {
+    slot_index_ = slot_index;
+    LOG_DEBUG("Context key '%s' uses transaction slot %d", name.c_str(), slot_index_);
+  } else {
+    LOG_ERROR("No transaction argument or slot left for context key '%s', values set with it are dropped",
+              name.c_str());
+  }
+}
+
+void *TransactionContextKeyBase::getValue(Transaction &transaction) const {
+  if (ts_arg_index_ >= 0) {
+    return TSHttpTxnArgGet(static_cast<TSHttpTxn>(transaction.getAtsHandle()), ts_arg_index_);
+  }
+  if (slot_index_ >= 0) {
+    return transaction.getContextSlots()[slot_index_];
+  }
+  return NULL;
+}
+
+void TransactionContextKeyBase::setValue(Transaction &transaction, void *value) const {
+  if (ts_arg_index_ >= 0) {
+    TSHttpTxnArgSet(static_cast<TSHttpTxn>(transaction.getAtsHandle()), ts_arg_index_, value);
+  } else if (slot_index_ >= 0) {
+    transaction.getContextSlots()[slot_index_] = value;
+  }
+}
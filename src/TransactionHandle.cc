@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionHandle.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TransactionHandle.h"
+#include <ts/ts.h>
+#include "logging_internal.h"
+#include "utils_internal.h"
+
+using namespace atscppapi;
+
+const sockaddr *TransactionHandle::getClientAddress() const {
+  return TSHttpTxnClientAddrGet(static_cast<TSHttpTxn>(txn_));
+}
+
+const sockaddr *TransactionHandle::getIncomingAddress() const {
+  return TSHttpTxnIncomingAddrGet(static_cast<TSHttpTxn>(txn_));
+}
+
+const sockaddr *TransactionHandle::getServerAddress() const {
+  return TSHttpTxnServerAddrGet(static_cast<TSHttpTxn>(txn_));
+}
+
+const sockaddr *TransactionHandle::getNextHopAddress() const {
+  return TSHttpTxnNextHopAddrGet(static_cast<TSHttpTxn>(txn_));
+}
+
+bool TransactionHandle::setServerAddress(const sockaddr *sockaddress) {
+  return TSHttpTxnServerAddrSet(static_cast<TSHttpTxn>(txn_), sockaddress) == TS_SUCCESS;
+}
+
+bool TransactionHandle::setIncomingPort(uint16_t port) {
+  TSHttpTxnClientIncomingPortSet(static_cast<TSHttpTxn>(txn_), port);
+  return true; // In reality TSHttpTxnClientIncomingPortSet should return SUCCESS or ERROR.
+}
+
+void TransactionHandle::setTimeout(Transaction::TimeoutType type, int time_ms) {
+  TSHttpTxn txn = static_cast<TSHttpTxn>(txn_);
+  switch (type) {
+    case Transaction::TIMEOUT_DNS:
+      TSHttpTxnDNSTimeoutSet(txn, time_ms);
+      break;
+    case Transaction::TIMEOUT_CONNECT:
+      TSHttpTxnConnectTimeoutSet(txn, time_ms);
+      break;
+    case Transaction::TIMEOUT_NO_ACTIVITY:
+      TSHttpTxnNoActivityTimeoutSet(txn, time_ms);
+      break;
+    case Transaction::TIMEOUT_ACTIVE:
+      TSHttpTxnActiveTimeoutSet(txn, time_ms);
+      break;
+    default:
+      break;
+  }
+}
+
+bool TransactionHandle::isInternalRequest() const {
+  return TSHttpIsInternalRequest(static_cast<TSHttpTxn>(txn_)) == TS_SUCCESS;
+}
+
+void TransactionHandle::resume() {
+  // a Transaction may be in the middle of calling its plugins, it decides when
+  Transaction *transaction = utils::internal::findTransaction(static_cast<TSHttpTxn>(txn_));
+  if (transaction) {
+    transaction->resume();
+  } else {
+    TSHttpTxnReenable(static_cast<TSHttpTxn>(txn_), static_cast<TSEvent>(TS_EVENT_HTTP_CONTINUE));
+  }
+}
+
+void TransactionHandle::error() {
+  Transaction *transaction = utils::internal::findTransaction(static_cast<TSHttpTxn>(txn_));
+  if (transaction) {
+    transaction->error();
+  } else {
+    LOG_DEBUG("Transaction tshttptxn=%p reenabling to error state", txn_);
+    TSHttpTxnReenable(static_cast<TSHttpTxn>(txn_), static_cast<TSEvent>(TS_EVENT_HTTP_ERROR));
+  }
+}
+
+Transaction &TransactionHandle::getTransaction() const {
+  return utils::internal::getTransaction(static_cast<TSHttpTxn>(txn_));
+}
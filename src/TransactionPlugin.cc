@@ -23,6 +23,7 @@
 #include "atscppapi/Mutex.h"
 #include "atscppapi/shared_ptr.h"
 #include "utils_internal.h"
+#include "ThreadLocalPool.h"
 #include "atscppapi/noncopyable.h"
 #include "logging_internal.h"
 
@@ -33,32 +34,51 @@ using atscppapi::TransactionPlugin;
  * @private
  */
 struct atscppapi::TransactionPluginState: noncopyable {
-  TSCont cont_;
+  Transaction &transaction_;
   TSHttpTxn ats_txn_handle_;
-  shared_ptr<Mutex> mutex_;
-  TransactionPluginState(TSHttpTxn ats_txn_handle) : ats_txn_handle_(ats_txn_handle),
-                                                     mutex_(new Mutex(Mutex::TYPE_RECURSIVE)) { }
+  shared_ptr<Mutex> mutex_; // empty for MUTEX_NONE
+  TransactionPluginState(Transaction &transaction)
+    : transaction_(transaction), ats_txn_handle_(static_cast<TSHttpTxn>(transaction.getAtsHandle())) { }
+  static shared_ptr<Mutex> createMutex();
 };
 
 namespace {
 
-static int handleTransactionPluginEvents(TSCont cont, TSEvent event, void *edata) {
-  TSHttpTxn txn = static_cast<TSHttpTxn>(edata);
-  TransactionPlugin *plugin = static_cast<TransactionPlugin *>(TSContDataGet(cont));
-  LOG_DEBUG("cont=%p, event=%d, tshttptxn=%p, plugin=%p", cont, event, edata, plugin);
-  atscppapi::utils::internal::invokePluginForEvent(plugin, txn, event);
-  return 0;
+/** Pooled mutexes go back to the pool once the plugin and whoever else got it from getMutex() let go. */
+void releaseMutex(Mutex *mutex) {
+  if (!ThreadLocalPool<Mutex>::push(mutex)) {
+    delete mutex;
+  }
 }
 
-} /* anonymous namespace */
+}
+
+shared_ptr<Mutex> TransactionPluginState::createMutex() {
+  Mutex *mutex = ThreadLocalPool<Mutex>::pop();
+  return shared_ptr<Mutex>(mutex ? mutex : new Mutex(Mutex::TYPE_RECURSIVE), releaseMutex);
+}
 
-TransactionPlugin::TransactionPlugin(Transaction &transaction) {
-  state_ = new TransactionPluginState(static_cast<TSHttpTxn>(transaction.getAtsHandle()));
-  TSMutex mutex = NULL;
-  state_->cont_ = TSContCreate(handleTransactionPluginEvents, mutex);
-  TSContDataSet(state_->cont_, static_cast<void *>(this));
-  LOG_DEBUG("Creating new TransactionPlugin=%p tshttptxn=%p, cont=%p", this, state_->ats_txn_handle_,
-            state_->cont_);
+TransactionPlugin::TransactionPlugin(Transaction &transaction, MutexPolicy mutex_policy) {
+  state_ = new TransactionPluginState(transaction);
+  switch (mutex_policy) {
+    case MUTEX_PER_PLUGIN:
+      state_->mutex_ = TransactionPluginState::createMutex();
+      break;
+    case MUTEX_PER_TRANSACTION:
+      {
+        shared_ptr<Mutex> &transaction_mutex = transaction.getPluginMutex();
+        if (!transaction_mutex) {
+          transaction_mutex = TransactionPluginState::createMutex();
+        }
+        state_->mutex_ = transaction_mutex;
+      }
+      break;
+    case MUTEX_NONE:
+    default:
+      break;
+  }
+  LOG_DEBUG("Creating new TransactionPlugin=%p tshttptxn=%p, mutex=%p", this, state_->ats_txn_handle_,
+            state_->mutex_.get());
 }
 
 shared_ptr<Mutex> TransactionPlugin::getMutex() {
@@ -67,13 +87,12 @@ shared_ptr<Mutex> TransactionPlugin::getMutex() {
 
 TransactionPlugin::~TransactionPlugin() {
   LOG_DEBUG("Destroying TransactionPlugin=%p", this);
-  TSContDestroy(state_->cont_);
   delete state_;
 }
 
 void TransactionPlugin::registerHook(Plugin::HookType hook_type) {
   LOG_DEBUG("TransactionPlugin=%p tshttptxn=%p registering hook_type=%d [%s]", this, state_->ats_txn_handle_,
-            hook_type, HOOK_TYPE_STRINGS[hook_type].c_str());
-  TSHttpHookID hook_id = atscppapi::utils::internal::convertInternalHookToTsHook(hook_type);
-  TSHttpTxnHookAdd(state_->ats_txn_handle_, hook_id, state_->cont_);
+            hook_type, getHookTypeName(hook_type).data());
+  // one continuation of the transaction calls all of its plugins for a hook, in the order they registered
+  state_->transaction_.addPluginHook(this, hook_type);
 }
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionTrace.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TransactionTrace.h"
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <ts/ts.h>
+#include "atscppapi/Arena.h"
+#include "atscppapi/AsyncHttpFetch.h"
+#include "atscppapi/ClientRequest.h"
+#include "atscppapi/Logger.h"
+#include "atscppapi/LogRecord.h"
+#include "atscppapi/Transaction.h"
+#include "TraceFetchSpan.h"
+#include "utils_internal.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+const char TRACEPARENT[] = "traceparent";
+const size_t TRACEPARENT_LENGTH = 55; // 00-<32 hex trace id>-<16 hex span id>-<2 hex flags>
+const int64_t NANOSECONDS_PER_MICROSECOND = 1000;
+
+const char *SPAN_KIND_STRINGS[] = { "hook", "fetch", "transformation", "custom" };
+
+__thread uint64_t random_state = 0; // xorshift state of the calling thread, seeded on first use.
+
+uint64_t nextRandom() {
+  uint64_t x = random_state;
+  if (!x) {
+    x = (static_cast<uint64_t>(TShrtime()) ^ reinterpret_cast<uintptr_t>(&random_state)) | 1;
+  }
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  random_state = x;
+  return x * 2685821657736338717ULL;
+}
+
+void formatId(char *id, uint64_t value) {
+  snprintf(id, 17, "%016llx", static_cast<unsigned long long>(value));
+}
+
+bool isHex(const char *data, size_t length) {
+  for (size_t i = 0; i < length; ++i) {
+    char c = data[i];
+    if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/** @return true if traceparent is valid, in which case its ids are copied and sampled is set from its flags. */
+bool parseTraceparent(const StringView &traceparent, char *trace_id, char *parent_span_id, bool &sampled) {
+  const char *data = traceparent.data();
+  if ((traceparent.length() < TRACEPARENT_LENGTH) || (data[2] != '-') || (data[35] != '-') || (data[52] != '-') ||
+      !isHex(data, 2) || !isHex(data + 3, 32) || !isHex(data + 36, 16) || !isHex(data + 53, 2)) {
+    return false;
+  }
+  memcpy(trace_id, data + 3, 32);
+  trace_id[32] = '\0';
+  memcpy(parent_span_id, data + 36, 16);
+  parent_span_id[16] = '\0';
+  int flags = 0;
+  sscanf(data + 53, "%2x", &flags);
+  sampled = (flags & 1);
+  return true;
+}
+
+void destroyTrace(void *trace) {
+  static_cast<TransactionTrace *>(trace)->~TransactionTrace();
+}
+
+}
+
+TransactionTrace::TransactionTrace(Transaction &transaction, Tracer &tracer)
+    : transaction_(transaction), tracer_(tracer), start_time_(TShrtime()), end_time_(0), span_count_(0),
+      dropped_spans_(0) {
+  formatId(trace_id_, nextRandom());
+  formatId(trace_id_ + 16, nextRandom());
+  formatId(root_span_id_, nextRandom());
+  parent_span_id_[0] = '\0';
+}
+
+TransactionTrace::~TransactionTrace() {
+}
+
+TransactionTrace *TransactionTrace::get(Transaction &transaction) {
+  return utils::internal::getTransactionTrace(transaction);
+}
+
+size_t TransactionTrace::beginSpan(SpanKind kind, const char *name) {
+  if (span_count_ == MAX_SPANS) {
+    ++dropped_spans_;
+    return NO_SPAN;
+  }
+  Span &span = spans_[span_count_];
+  span.kind_ = kind;
+  span.name_ = name;
+  span.span_id_ = nextRandom();
+  span.start_time_ = TShrtime();
+  span.end_time_ = 0;
+  span.ended_ = false;
+  return span_count_++;
+}
+
+void TransactionTrace::endSpan(size_t index) {
+  if ((index < span_count_) && !spans_[index].ended_) {
+    spans_[index].end_time_ = TShrtime();
+    spans_[index].ended_ = true;
+  }
+}
+
+void TransactionTrace::traceFetch(AsyncHttpFetch &fetch, const char *name) {
+  size_t index = beginSpan(SPAN_FETCH, name);
+  char span_id[17];
+  if (index == NO_SPAN) {
+    memcpy(span_id, root_span_id_, sizeof(span_id));
+  } else {
+    shared_ptr<TraceFetchSpan> fetch_span(new TraceFetchSpan());
+    fetch_spans_.push_back(std::make_pair(index, fetch_span));
+    utils::internal::setAsyncHttpFetchTraceSpan(fetch, fetch_span);
+    formatId(span_id, spans_[index].span_id_);
+  }
+
+  string traceparent;
+  traceparent.reserve(TRACEPARENT_LENGTH);
+  traceparent.append("00-").append(trace_id_).append("-").append(span_id).append("-01");
+  fetch.getRequestHeaders().set(TRACEPARENT, traceparent);
+}
+
+void TransactionTrace::finish() {
+  end_time_ = TShrtime();
+  for (size_t i = 0; i < fetch_spans_.size(); ++i) {
+    int64_t fetch_end_time = fetch_spans_[i].second->end_time_;
+    if (fetch_end_time) {
+      spans_[fetch_spans_[i].first].end_time_ = fetch_end_time;
+      spans_[fetch_spans_[i].first].ended_ = true;
+    }
+  }
+  for (size_t i = 0; i < span_count_; ++i) {
+    if (!spans_[i].ended_) {
+      spans_[i].end_time_ = end_time_;
+    }
+  }
+  LOG_DEBUG("Exporting trace %s with %d spans, %d dropped", trace_id_, span_count_, dropped_spans_);
+  tracer_.exporter_.exportTrace(*this);
+}
+
+void LoggerTraceExporter::exportTrace(TransactionTrace &trace) {
+  LogRecord record;
+  record.addString("trace_id", trace.getTraceId()).addString("span_id", trace.getRootSpanId())
+      .addString("parent_span_id", trace.getParentSpanId()).addString("kind", "transaction")
+      .addString("name", "transaction").addInt("start_us", 0)
+      .addInt("duration_us", (trace.getEndTime() - trace.getStartTime()) / NANOSECONDS_PER_MICROSECOND)
+      .addBool("ended", true);
+  logger_.logRecord(record);
+
+  char span_id[17];
+  for (size_t i = 0; i < trace.getSpanCount(); ++i) {
+    const TransactionTrace::Span &span = trace.getSpan(i);
+    formatId(span_id, span.span_id_);
+    record.clear();
+    record.addString("trace_id", trace.getTraceId()).addString("span_id", span_id)
+        .addString("parent_span_id", trace.getRootSpanId()).addString("kind", SPAN_KIND_STRINGS[span.kind_])
+        .addString("name", span.name_ ? span.name_ : "")
+        .addInt("start_us", (span.start_time_ - trace.getStartTime()) / NANOSECONDS_PER_MICROSECOND)
+        .addInt("duration_us", (span.end_time_ - span.start_time_) / NANOSECONDS_PER_MICROSECOND)
+        .addBool("ended", span.ended_);
+    logger_.logRecord(record);
+  }
+}
+
+Tracer::Tracer(TraceExporter &exporter, unsigned int sample_one_in)
+    : exporter_(exporter), sample_one_in_(sample_one_in) {
+}
+
+TransactionTrace *Tracer::startTrace(Transaction &transaction) {
+  TransactionTrace *trace = utils::internal::getTransactionTrace(transaction);
+  if (trace) {
+    return trace;
+  }
+
+  char trace_id[33];
+  char parent_span_id[17];
+  bool sampled = false;
+  StringView traceparent = transaction.getClientRequest().getHeaders().getValueView(TRACEPARENT);
+  bool has_parent = parseTraceparent(traceparent, trace_id, parent_span_id, sampled);
+  if (!sampled && !Logger::sample(sample_one_in_)) {
+    return NULL;
+  }
+
+  Arena &arena = transaction.getArena();
+  trace = new (arena.allocate(sizeof(TransactionTrace))) TransactionTrace(transaction, *this);
+  arena.addCleanup(&destroyTrace, trace);
+  if (has_parent) {
+    memcpy(trace->trace_id_, trace_id, sizeof(trace_id));
+    memcpy(trace->parent_span_id_, parent_span_id, sizeof(parent_span_id));
+  }
+  utils::internal::setTransactionTrace(transaction, trace);
+  LOG_DEBUG("Tracing transaction %p as trace %s", &transaction, trace->trace_id_);
+  return trace;
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationChain.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TransformationChain.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+
+TransformationChain::TransformationChain(Transaction &transaction, Type type)
+  : TransformationPlugin(transaction, type) {
+  LOG_DEBUG("Creating TransformationChain=%p", this);
+}
+
+void TransformationChain::consume(InputBuffer &input) {
+  // The chain's output is the first stage, so producing our input hands it to that stage.
+  produce(input);
+}
+
+void TransformationChain::handleInputComplete() {
+  setOutputComplete();
+}
+
+TransformationChain::~TransformationChain() {
+  LOG_DEBUG("Destroying TransformationChain=%p", this);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationMetrics.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/TransformationMetrics.h"
+#include "atscppapi/ShardedStat.h"
+#include "atscppapi/HistogramStat.h"
+#include "logging_internal.h"
+
+using namespace atscppapi;
+using std::string;
+
+namespace {
+
+const int64_t NANOSECONDS_PER_MICROSECOND = 1000;
+
+}
+
+/**
+ * @private
+ */
+struct atscppapi::TransformationMetricsState : noncopyable {
+  ShardedStat input_bytes_;
+  ShardedStat output_bytes_;
+  ShardedStat consume_calls_;
+  HistogramStat chunk_bytes_;
+  HistogramStat peak_buffered_bytes_;
+  HistogramStat first_byte_to_complete_;
+};
+
+TransformationMetrics::TransformationMetrics(const string &name, int aggregation_interval_ms)
+    : state_(new TransformationMetricsState()) {
+  state_->input_bytes_.init(name + ".input_bytes");
+  state_->output_bytes_.init(name + ".output_bytes");
+  state_->consume_calls_.init(name + ".consume_calls");
+  state_->chunk_bytes_.init(name + ".chunk_bytes", aggregation_interval_ms);
+  state_->peak_buffered_bytes_.init(name + ".peak_buffered_bytes", aggregation_interval_ms);
+  state_->first_byte_to_complete_.init(name + ".first_byte_to_complete_us", aggregation_interval_ms);
+  LOG_DEBUG("Created transformation metrics for '%s'", name.c_str());
+}
+
+TransformationMetrics::~TransformationMetrics() {
+  delete state_;
+}
+
+void TransformationMetrics::recordConsume(size_t length) {
+  state_->input_bytes_.increment(static_cast<int64_t>(length));
+  state_->consume_calls_.increment();
+  state_->chunk_bytes_.record(static_cast<int64_t>(length));
+}
+
+void TransformationMetrics::recordOutput(int64_t length) {
+  state_->output_bytes_.increment(length);
+}
+
+void TransformationMetrics::recordComplete(int64_t peak_buffered_bytes, int64_t first_byte_to_complete_ns) {
+  state_->peak_buffered_bytes_.record(peak_buffered_bytes);
+  state_->first_byte_to_complete_.record(first_byte_to_complete_ns / NANOSECONDS_PER_MICROSECOND);
+}
@@ -17,10 +17,14 @@
  */
 
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
+#include "atscppapi/TransformationMetrics.h"
+#include "atscppapi/TransactionTrace.h"
 
 #include <ts/ts.h>
 #include <cstddef>
 #include "utils_internal.h"
+#include "ThreadLocalPool.h"
 #include "logging_internal.h"
 #include "atscppapi/noncopyable.h"
 
@@ -31,6 +35,17 @@
 using namespace atscppapi;
 using atscppapi::TransformationPlugin;
 
+namespace {
+
+/** An output buffer with its reader, recycled between transformations on the same thread. */
+struct OutputBuffer {
+  TSIOBuffer buffer_;
+  TSIOBufferReader reader_;
+  OutputBuffer(TSIOBuffer buffer, TSIOBufferReader reader) : buffer_(buffer), reader_(reader) { }
+};
+
+}
+
 /**
  * @private
  */
@@ -44,6 +59,22 @@ struct atscppapi::TransformationPluginState: noncopyable {
   TSIOBuffer output_buffer_;
   TSIOBufferReader output_buffer_reader_;
   int64_t bytes_written_;
+  TransformationPlugin *chain_; // the chain this stage runs in, NULL if this isn't a stage of a TransformationChain.
+  TransformationPlugin *next_stage_; // the stage that consumes our output, NULL if the output goes downstream.
+  size_t low_watermark_; // input is held back until at least this much is available or the input ends.
+  size_t high_watermark_; // the most input handed to a single consume(), 0 means unbounded.
+  int64_t output_buffer_limit_; // input isn't read while this much output is waiting downstream, 0 means no limit.
+  int64_t output_length_; // the total output declared with setOutputLength(), INT64_MAX when it isn't known.
+  TransformationPlugin::CachedVariant cached_variant_;
+  bool bypassed_; // once set the input is copied straight to the output without calling the plugin.
+  bool aborted_; // once set no more events are handled, Traffic Server was told the transformation failed.
+  OutputBuffer *pooled_output_buffer_; // holds output_buffer_ and its reader while they are in the pool.
+  TransformationMetrics *metrics_; // NULL unless setMetrics() was called.
+  int64_t first_input_time_; // when the first input was consumed, only tracked with metrics_.
+  int64_t peak_buffered_output_; // the most output that was waiting downstream, tracked with metrics_ or memory_accounted_.
+  bool memory_accounted_; // the transaction's MemoryAccounting gets peak_buffered_output_ when the output is complete.
+  bool active_; // the first input was consumed.
+  size_t trace_span_; // from the first input until the output is complete, for traced transactions.
 
   // We can only send a single WRITE_COMPLETE even though
   // we may receive an immediate event after we've sent a
@@ -55,12 +86,36 @@ struct atscppapi::TransformationPluginState: noncopyable {
       TransformationPlugin::Type type, TSHttpTxn txn)
     : vconn_(NULL), transaction_(transaction), transformation_plugin_(transformation_plugin), type_(type),
       output_vio_(NULL), txn_(txn), output_buffer_(NULL), output_buffer_reader_(NULL), bytes_written_(0),
-      input_complete_dispatched_(false) {
-    output_buffer_ = TSIOBufferCreate();
-    output_buffer_reader_ = TSIOBufferReaderAlloc(output_buffer_);
+      chain_(NULL), next_stage_(NULL), low_watermark_(0), high_watermark_(0), output_buffer_limit_(0),
+      output_length_(INT64_MAX),
+      cached_variant_(TransformationPlugin::CACHED_VARIANT_DEFAULT), bypassed_(false), aborted_(false), pooled_output_buffer_(NULL), metrics_(NULL),
+      first_input_time_(0), peak_buffered_output_(0),
+      memory_accounted_(false), active_(false), trace_span_(TransactionTrace::NO_SPAN), input_complete_dispatched_(false) {
+    pooled_output_buffer_ = ThreadLocalPool<OutputBuffer>::pop();
+    if (pooled_output_buffer_) {
+      output_buffer_ = pooled_output_buffer_->buffer_;
+      output_buffer_reader_ = pooled_output_buffer_->reader_;
+    } else {
+      output_buffer_ = TSIOBufferCreate();
+      output_buffer_reader_ = TSIOBufferReaderAlloc(output_buffer_);
+    }
   };
 
   ~TransformationPluginState() {
+    if (output_buffer_ && output_buffer_reader_) {
+      // drop whatever is left so the next transformation starts with an empty buffer
+      TSIOBufferReaderConsume(output_buffer_reader_, TSIOBufferReaderAvail(output_buffer_reader_));
+      if (!pooled_output_buffer_) {
+        pooled_output_buffer_ = new OutputBuffer(output_buffer_, output_buffer_reader_);
+      }
+      if (ThreadLocalPool<OutputBuffer>::push(pooled_output_buffer_)) {
+        output_buffer_ = NULL;
+        output_buffer_reader_ = NULL;
+        pooled_output_buffer_ = NULL;
+      }
+    }
+    delete pooled_output_buffer_;
+
     if (output_buffer_reader_) {
       TSIOBufferReaderFree(output_buffer_reader_);
       output_buffer_reader_ = NULL;
@@ -71,6 +126,73 @@ struct atscppapi::TransformationPluginState: noncopyable {
       output_buffer_ = NULL;
     }
   }
+
+  /* Passes length bytes of input straight through to our output once the plugin has bypassed itself. */
+  void writeBypassedInput(TSIOBufferReader reader, int64_t length) {
+    TransformationPlugin::InputBuffer input(reader, static_cast<size_t>(length));
+    transformation_plugin_.writeOutput(input, 0, static_cast<size_t>(length));
+  }
+
+  /* Called with the first input, starts the span of a traced transaction. */
+  void activate() {
+    active_ = true;
+    memory_accounted_ = utils::internal::isMemoryAccounted(transaction_);
+    TransactionTrace *trace = TransactionTrace::get(transaction_);
+    if (trace) {
+      trace_span_ = trace->beginSpan(TransactionTrace::SPAN_TRANSFORMATION,
+          (type_ == TransformationPlugin::REQUEST_TRANSFORMATION) ? "request_transformation" : "response_transformation");
+    }
+  }
+
+  void deactivate() {
+    if (memory_accounted_) {
+      utils::internal::recordTransformationBufferedBytes(transaction_, peak_buffered_output_);
+      memory_accounted_ = false;
+    }
+    if (trace_span_ != TransactionTrace::NO_SPAN) {
+      TransactionTrace::get(transaction_)->endSpan(trace_span_);
+      trace_span_ = TransactionTrace::NO_SPAN;
+    }
+  }
+
+  void recordConsume(size_t length) {
+    if (!first_input_time_) {
+      first_input_time_ = TShrtime();
+    }
+    metrics_->recordConsume(length);
+  }
+
+  void recordOutput(int64_t length) {
+    if (metrics_) {
+      metrics_->recordOutput(length);
+    }
+    if (output_vio_) {
+      int64_t buffered = TSIOBufferReaderAvail(output_buffer_reader_);
+      if (buffered > peak_buffered_output_) {
+        peak_buffered_output_ = buffered;
+      }
+    }
+  }
+
+  /* Records the stats of a whole transformation, once, when its output is complete. */
+  void recordComplete() {
+    if (first_input_time_) {
+      metrics_->recordComplete(peak_buffered_output_, TShrtime() - first_input_time_);
+      first_input_time_ = 0;
+    }
+  }
+
+  void dispatchInputComplete() {
+    if (bypassed_) {
+      if (metrics_) {
+        recordComplete();
+      }
+      deactivate();
+      transformation_plugin_.completeOutput();
+    } else {
+      transformation_plugin_.handleInputComplete();
+    }
+  }
 };
 
 namespace {
@@ -81,10 +203,21 @@ void cleanupTransformation(TSCont contp) {
   TSContDestroy(contp);
 }
 
+bool isOutputBackedUp(TransformationPluginState *state) {
+  return state->output_buffer_limit_ && (TSIOBufferReaderAvail(state->output_buffer_reader_) >= state->output_buffer_limit_);
+}
+
 int handleTransformationPluginRead(TSCont contp, TransformationPluginState *state) {
   // Traffic Server naming is quite confusing, in this context the write_vio
   // is actually the vio we read from.
   TSVIO write_vio = TSVConnWriteVIOGet(contp);
+  if (write_vio && isOutputBackedUp(state)) {
+    // We'll neither read nor reenable the input, the downstream WRITE_READY will bring us back here.
+    LOG_DEBUG("Transformation contp=%p write_vio=%p, output has %d bytes waiting which is above the limit=%d, not reading input.",
+        contp, write_vio, TSIOBufferReaderAvail(state->output_buffer_reader_), state->output_buffer_limit_);
+    return 0;
+  }
+
   if (write_vio) {
     int64_t to_read = TSVIONTodoGet(write_vio);
     LOG_DEBUG("Transformation contp=%p write_vio=%p, to_read=%d", contp, write_vio, to_read);
@@ -102,31 +235,55 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
         LOG_DEBUG("Transformation contp=%p write_vio=%p, to read > avail, fixing to_read to be equal to avail. to_read=%d, buffer reader avail=%d", contp, write_vio, to_read, avail);
       }
 
-      if (to_read > 0) {
-        /* Create a buffer and a buffer reader */
-        TSIOBuffer input_buffer = TSIOBufferCreate();
-        TSIOBufferReader input_reader = TSIOBufferReaderAlloc(input_buffer);
-
-        /* Copy the data from the read buffer to the input buffer. */
-        TSIOBufferCopy(input_buffer, TSVIOReaderGet(write_vio), to_read, 0);
+      /*
+       * Small reads are left in the upstream buffer until the low watermark is reached,
+       * unless this is the last of the input, so consume() isn't fired for every few bytes.
+       **/
+      bool waiting_for_input = false;
+      if ((to_read > 0) && !state->bypassed_ && (static_cast<size_t>(to_read) < state->low_watermark_) &&
+          (TSVIONTodoGet(write_vio) > to_read)) {
+        LOG_DEBUG("Transformation contp=%p write_vio=%p, to_read=%d is below the low watermark=%d, waiting for more input.",
+            contp, write_vio, to_read, state->low_watermark_);
+        waiting_for_input = true;
+      }
 
-        /* Tell the read buffer that we have read the data and are no
-         longer interested in it. */
-        TSIOBufferReaderConsume(TSVIOReaderGet(write_vio), to_read);
+      if ((to_read > 0) && !waiting_for_input) {
+        TSIOBufferReader input_reader = TSVIOReaderGet(write_vio);
 
         /* Modify the read VIO to reflect how much data we've completed. */
         TSVIONDoneSet(write_vio, TSVIONDoneGet(write_vio) + to_read);
 
-        std::string in_data = utils::internal::consumeFromTSIOBufferReader(input_reader);
-        LOG_DEBUG("Transformation contp=%p write_vio=%p consumed %d bytes from bufferreader", contp, write_vio, in_data.length());
+        /* Hand the client a view of the upstream blocks, no more than high watermark bytes at a time, the
+         data is only consumed once they are done with it. */
+        int64_t remaining = to_read;
+        while (remaining > 0) {
+          int64_t chunk = remaining;
+          if (state->bypassed_) {
+            // The plugin has detached itself, everything left goes straight to the output without a copy.
+            LOG_DEBUG("Transformation contp=%p write_vio=%p is bypassed, passing %d bytes through", contp, write_vio, chunk);
+            state->writeBypassedInput(input_reader, chunk);
+            TSIOBufferReaderConsume(input_reader, chunk);
+            break;
+          }
+
+          if (state->high_watermark_ && (chunk > static_cast<int64_t>(state->high_watermark_))) {
+            chunk = static_cast<int64_t>(state->high_watermark_);
+          }
 
-        /* Clean up the buffer and reader */
-        TSIOBufferReaderFree(input_reader);
-        TSIOBufferDestroy(input_buffer);
+          TransformationPlugin::InputBuffer input(input_reader, static_cast<size_t>(chunk));
+          LOG_DEBUG("Transformation contp=%p write_vio=%p passing a view of %d bytes to consume", contp, write_vio, chunk);
+          if (!state->active_) {
+            state->activate();
+          }
+          if (state->metrics_) {
+            state->recordConsume(static_cast<size_t>(chunk));
+          }
+          state->transformation_plugin_.consume(input);
 
-        /* Now call the client to tell them about data */
-        if (in_data.length() > 0) {
-           state->transformation_plugin_.consume(in_data);
+          /* Tell the read buffer that we have read the data and are no
+           longer interested in it. */
+          TSIOBufferReaderConsume(input_reader, chunk);
+          remaining -= chunk;
         }
       }
 
@@ -136,7 +293,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
       if (TSVIONTodoGet(write_vio) > 0) {
         LOG_DEBUG("Transformation contp=%p write_vio=%p, vio_cont=%p still has bytes left to process, todo > 0.", contp, write_vio, vio_cont);
 
-        if (to_read > 0) {
+        if (to_read > 0 || waiting_for_input) {
           TSVIOReenable(write_vio);
 
           /* Call back the read VIO continuation to let it know that we are ready for more data. */
@@ -149,7 +306,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
 
         /* Call back the write VIO continuation to let it know that we have completed the write operation. */
         if (!state->input_complete_dispatched_) {
-         state->transformation_plugin_.handleInputComplete();
+         state->dispatchInputComplete();
          state->input_complete_dispatched_ = true;
          if (vio_cont) {
            TSContCall(vio_cont, static_cast<TSEvent>(TS_EVENT_VCONN_WRITE_COMPLETE), write_vio);
@@ -162,7 +319,7 @@ int handleTransformationPluginRead(TSCont contp, TransformationPluginState *stat
 
       /* Call back the write VIO continuation to let it know that we have completed the write operation. */
       if (!state->input_complete_dispatched_) {
-       state->transformation_plugin_.handleInputComplete();
+       state->dispatchInputComplete();
        state->input_complete_dispatched_ = true;
        if (vio_cont) {
          TSContCall(vio_cont, static_cast<TSEvent>(TS_EVENT_VCONN_WRITE_COMPLETE), write_vio);
@@ -187,6 +344,11 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
     return 0;
   }
 
+  if (state->aborted_) {
+    LOG_DEBUG("Transformation contp=%p tshttptxn=%p is aborted, ignoring event=%d", contp, state->txn_, event);
+    return 0;
+  }
+
   if (event == TS_EVENT_VCONN_WRITE_COMPLETE) {
     TSVConn output_vconn = TSTransformOutputVConnGet(state->vconn_);
     LOG_DEBUG("Transformation contp=%p tshttptxn=%p received WRITE_COMPLETE, shutting down outputvconn=%p ", contp, state->txn_, output_vconn);
@@ -206,12 +368,102 @@ int handleTransformationPluginEvents(TSCont contp, TSEvent event, void *edata) {
     return 0;
   }
 
+  if (event == TS_EVENT_VCONN_WRITE_READY && state->output_vio_ && edata == state->output_vio_ && state->output_buffer_limit_) {
+    // The downstream has consumed some of our output, let the plugin know it may produce more.
+    LOG_DEBUG("Transformation contp=%p tshttptxn=%p downstream is ready for more output", contp, state->txn_);
+    if (!isOutputBackedUp(state)) {
+      state->transformation_plugin_.handleOutputReady();
+    }
+  }
+
   // All other events includign WRITE_READY will just attempt to transform more data.
   return handleTransformationPluginRead(state->vconn_, state);
 }
 
 } /* anonymous namespace */
 
+TransformationPlugin::InputBuffer::InputBuffer(void *reader, size_t length)
+  : reader_(reader), data_(NULL), block_(NULL), length_(length), offset_(0), started_(false) {
+}
+
+TransformationPlugin::InputBuffer::InputBuffer(const char *data, size_t length)
+  : reader_(NULL), data_(data), block_(NULL), length_(length), offset_(0), started_(false) {
+}
+
+size_t TransformationPlugin::InputBuffer::length() const {
+  return length_;
+}
+
+bool TransformationPlugin::InputBuffer::nextBlock(const char *&data, size_t &length) {
+  if (data_) {
+    if (started_ || !length_) {
+      return false;
+    }
+    started_ = true;
+    data = data_;
+    length = length_;
+    offset_ = length_;
+    return true;
+  }
+
+  TSIOBufferReader reader = static_cast<TSIOBufferReader>(reader_);
+  while (offset_ < length_) {
+    TSIOBufferBlock block;
+    if (!started_) {
+      block = TSIOBufferReaderStart(reader);
+      started_ = true;
+    } else {
+      block = block_ ? TSIOBufferBlockNext(static_cast<TSIOBufferBlock>(block_)) : NULL;
+    }
+    block_ = block;
+    if (!block) {
+      LOG_ERROR("Ran out of buffer blocks with %d of %d bytes visited, reader=%p", offset_, length_, reader);
+      return false;
+    }
+
+    int64_t block_avail = 0;
+    const char *block_data = TSIOBufferBlockReadStart(block, reader, &block_avail);
+    if (block_avail <= 0) {
+      continue; // empty blocks can show up in a chain, just skip them.
+    }
+
+    size_t remaining = length_ - offset_;
+    data = block_data;
+    length = (static_cast<size_t>(block_avail) < remaining) ? static_cast<size_t>(block_avail) : remaining;
+    offset_ += length;
+    return true;
+  }
+  return false;
+}
+
+void TransformationPlugin::InputBuffer::rewind() {
+  block_ = NULL;
+  offset_ = 0;
+  started_ = false;
+}
+
+void TransformationPlugin::InputBuffer::appendTo(std::string &str) const {
+  if (data_) {
+    str.append(data_, length_);
+    return;
+  }
+
+  TSIOBufferReader reader = static_cast<TSIOBufferReader>(reader_);
+  str.reserve(str.size() + length_);
+  size_t appended = 0;
+  for (TSIOBufferBlock block = TSIOBufferReaderStart(reader); block && (appended < length_);
+       block = TSIOBufferBlockNext(block)) {
+    int64_t block_avail = 0;
+    const char *block_data = TSIOBufferBlockReadStart(block, reader, &block_avail);
+    if (block_avail > 0) {
+      size_t remaining = length_ - appended;
+      size_t to_append = (static_cast<size_t>(block_avail) < remaining) ? static_cast<size_t>(block_avail) : remaining;
+      str.append(block_data, to_append);
+      appended += to_append;
+    }
+  }
+}
+
 TransformationPlugin::TransformationPlugin(Transaction &transaction, TransformationPlugin::Type type)
   : TransactionPlugin(transaction) {
   state_ = new TransformationPluginState(transaction, *this, type, static_cast<TSHttpTxn>(transaction.getAtsHandle()));
@@ -221,48 +473,210 @@ TransformationPlugin::TransformationPlugin(Transaction &transaction, Transformat
   TSHttpTxnHookAdd(state_->txn_, utils::internal::convertInternalTransformationTypeToTsHook(type), state_->vconn_);
 }
 
+TransformationPlugin::TransformationPlugin(Transaction &transaction, TransformationChain &chain)
+  : TransactionPlugin(transaction) {
+  TransformationPlugin &chain_plugin = chain;
+  state_ = new TransformationPluginState(transaction, *this, chain_plugin.state_->type_,
+      static_cast<TSHttpTxn>(transaction.getAtsHandle()));
+  state_->chain_ = &chain_plugin;
+
+  // Stages are appended, so find the last stage in the chain and hand its output to this stage.
+  TransformationPlugin *tail = &chain_plugin;
+  while (tail->state_->next_stage_) {
+    tail = tail->state_->next_stage_;
+  }
+  tail->state_->next_stage_ = this;
+  LOG_DEBUG("Creating TransformationPlugin=%p as a stage of chain=%p after=%p tshttptxn=%p", this, &chain_plugin, tail, state_->txn_);
+}
+
 TransformationPlugin::~TransformationPlugin() {
   LOG_DEBUG("Destroying TransformationPlugin=%p", this);
-  cleanupTransformation(state_->vconn_);
+  if (state_->vconn_) {
+    cleanupTransformation(state_->vconn_);
+  }
   delete state_;
 }
 
-size_t TransformationPlugin::produce(const std::string &data) {
-  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p producing output with length=%d", this, state_->txn_, data.length());
-  int64_t write_length = static_cast<int64_t>(data.length());
-  if (!write_length) {
-    return 0;
+TransformationPlugin::Type TransformationPlugin::getType() const {
+  return state_->type_;
+}
+
+void TransformationPlugin::consume(InputBuffer &input) {
+  // Compatibility path for transformations that only implement consume(const std::string &)
+  std::string data;
+  input.appendTo(data);
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p copied %d bytes of input into a string", this, state_->txn_, data.length());
+  if (!data.empty()) {
+    consume(data);
+  }
+}
+
+void TransformationPlugin::consume(const std::string &data) {
+  // a transformation implementing neither consume() passes its input through rather than losing it
+  produce(data);
+}
+
+void TransformationPlugin::setInputWatermarks(size_t low_watermark, size_t high_watermark) {
+  if (high_watermark && (high_watermark < low_watermark)) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p ignoring watermarks, high_watermark=%d is below low_watermark=%d",
+        this, state_->txn_, high_watermark, low_watermark);
+    return;
+  }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p setting input watermarks low=%d high=%d", this, state_->txn_, low_watermark, high_watermark);
+  state_->low_watermark_ = low_watermark;
+  state_->high_watermark_ = high_watermark;
+}
+
+void TransformationPlugin::bypass() {
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p bypassing itself, the rest of the input will be passed through", this, state_->txn_);
+  state_->bypassed_ = true;
+}
+
+bool TransformationPlugin::isBypassed() const {
+  return state_->bypassed_;
+}
+
+void TransformationPlugin::abort() {
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  state_->deactivate();
+  if (output->state_->aborted_) {
+    return;
+  }
+  output->state_->aborted_ = true;
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p aborting", this, state_->txn_);
+  if (TSVConnClosedGet(output->state_->vconn_)) {
+    return;
+  }
+  // the same as an error on our input, see handleTransformationPluginEvents()
+  TSVIO write_vio = TSVConnWriteVIOGet(output->state_->vconn_);
+  TSCont vio_cont = write_vio ? TSVIOContGet(write_vio) : NULL;
+  if (vio_cont) {
+    TSContCall(vio_cont, TS_EVENT_ERROR, write_vio);
+  }
+}
+
+bool TransformationPlugin::isAborted() const {
+  const TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  return output->state_->aborted_;
+}
+
+TransformationPlugin *TransformationPlugin::getNextStage() const {
+  // A bypassed stage is skipped, its input goes to whatever follows it.
+  TransformationPlugin *stage = state_->next_stage_;
+  while (stage && stage->state_->bypassed_) {
+    stage = stage->state_->next_stage_;
+  }
+  return stage;
+}
+
+void TransformationPlugin::setMetrics(TransformationMetrics *metrics) {
+  state_->metrics_ = metrics;
+}
+
+bool TransformationPlugin::setOutputLength(size_t length) {
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  if (output->state_->output_vio_) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p cannot declare an output length of %zu after producing output",
+              this, state_->txn_, length);
+    return false;
+  }
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p declaring output length=%zu", this, state_->txn_, length);
+  output->state_->output_length_ = static_cast<int64_t>(length);
+  return true;
+}
+
+bool TransformationPlugin::setCachedVariant(CachedVariant variant) {
+  if (state_->type_ != RESPONSE_TRANSFORMATION) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p cannot cache the variants of a request transformation", this,
+              state_->txn_);
+    return false;
+  }
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p setting cached variant=%d", this, state_->txn_, variant);
+  output->state_->cached_variant_ = variant;
+  if (variant != CACHED_VARIANT_DEFAULT) {
+    TSHttpTxnTransformedRespCache(state_->txn_, (variant == CACHED_VARIANT_TRANSFORMED) || (variant == CACHED_VARIANT_BOTH));
+    TSHttpTxnUntransformedRespCache(state_->txn_, (variant == CACHED_VARIANT_UNTRANSFORMED) ||
+                                                  (variant == CACHED_VARIANT_BOTH));
+  }
+  return true;
+}
+
+void TransformationPlugin::handleTransformedResponseHeaders(Response &response) {
+  // The default implementation leaves the headers as they came from the origin.
+}
+
+void TransformationPlugin::setOutputBufferLimit(size_t limit) {
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p setting output buffer limit=%d", this, state_->txn_, limit);
+  state_->output_buffer_limit_ = static_cast<int64_t>(limit);
+}
+
+size_t TransformationPlugin::getOutputCapacity() const {
+  const TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  TransformationPluginState *output_state = output->state_;
+  if (!output_state->output_buffer_limit_) {
+    return static_cast<size_t>(INT64_MAX);
   }
 
+  int64_t pending = TSIOBufferReaderAvail(output_state->output_buffer_reader_);
+  return (pending >= output_state->output_buffer_limit_) ? 0 : static_cast<size_t>(output_state->output_buffer_limit_ - pending);
+}
+
+void TransformationPlugin::handleOutputReady() {
+  // The default implementation has nothing to do, input reading resumes on its own.
+}
+
+bool TransformationPlugin::prepareOutput() {
   if (!state_->output_vio_) {
     TSVConn output_vconn = TSTransformOutputVConnGet(state_->vconn_);
     LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p will issue a TSVConnWrite, output_vconn=%p.", this, state_->txn_, output_vconn);
     if (output_vconn) {
+      // the headers of a cached transformed response are written to cache with the first output
+      if ((state_->cached_variant_ == CACHED_VARIANT_TRANSFORMED) || (state_->cached_variant_ == CACHED_VARIANT_BOTH)) {
+        Response &response = state_->transaction_.getTransformedResponse();
+        for (TransformationPlugin *stage = this; stage; stage = stage->getNextStage()) {
+          stage->handleTransformedResponseHeaders(response);
+        }
+      }
       // If you're confused about the following reference the traffic server transformation docs.
-      // You always write INT64_MAX, this basically says you're not sure how much data you're going to write
-      state_->output_vio_ = TSVConnWrite(output_vconn, state_->vconn_, state_->output_buffer_reader_, INT64_MAX);
+      // Unless setOutputLength() was called we write INT64_MAX, this basically says you're not sure how much
+      // data you're going to write. With a real length Traffic Server sends a Content-Length instead of chunking.
+      state_->output_vio_ = TSVConnWrite(output_vconn, state_->vconn_, state_->output_buffer_reader_,
+                                         state_->output_length_);
     } else {
       LOG_ERROR("TransformationPlugin=%p tshttptxn=%p output_vconn=%p cannot issue TSVConnWrite due to null output vconn.",
           this, state_->txn_, output_vconn);
-      return 0;
+      return false;
     }
 
     if (!state_->output_vio_) {
       LOG_ERROR("TransformationPlugin=%p tshttptxn=%p state_->output_vio=%p, TSVConnWrite failed.",
           this, state_->txn_, state_->output_vio_);
-      return 0;
+      return false;
     }
   }
+  return true;
+}
 
-  // Finally we can copy this data into the output_buffer
-  int64_t bytes_written = TSIOBufferWrite(state_->output_buffer_, data.c_str(), write_length);
+size_t TransformationPlugin::reenableOutput(int64_t bytes_written, int64_t write_length) {
   state_->bytes_written_ += bytes_written; // So we can set BytesDone on outputComplete().
+  if (state_->metrics_ || state_->memory_accounted_) {
+    state_->recordOutput(bytes_written);
+  }
   LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p write to TSIOBuffer %d bytes total bytes written %d", this, state_->txn_, bytes_written, state_->bytes_written_);
 
   // Sanity Checks
   if (bytes_written != write_length) {
     LOG_ERROR("TransformationPlugin=%p tshttptxn=%p bytes written < expected. bytes_written=%d write_length=%d", this, state_->txn_, bytes_written, write_length);
   }
+  if (state_->bytes_written_ > state_->output_length_) {
+    // the client was promised fewer bytes, whatever we sent on would corrupt the connection
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p produced %lld bytes, more than its declared output length %lld",
+              this, state_->txn_, static_cast<long long>(state_->bytes_written_),
+              static_cast<long long>(state_->output_length_));
+    abort();
+    return 0;
+  }
 
   int connection_closed = TSVConnClosedGet(state_->vconn_);
   LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d", this, state_->txn_, state_->vconn_, connection_closed);
@@ -276,7 +690,128 @@ size_t TransformationPlugin::produce(const std::string &data) {
   return static_cast<size_t>(bytes_written);
 }
 
+size_t TransformationPlugin::produce(const std::string &data) {
+  return produce(data.data(), data.length());
+}
+
+size_t TransformationPlugin::produce(const char *data, size_t length) {
+  TransformationPlugin *next_stage = getNextStage();
+  if (next_stage) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p handing %d bytes to stage=%p", this, state_->txn_, length, next_stage);
+    if (length) {
+      InputBuffer input(data, length);
+      if (!next_stage->state_->active_) {
+        next_stage->state_->activate();
+      }
+      if (next_stage->state_->metrics_) {
+        next_stage->state_->recordConsume(length);
+      }
+      next_stage->consume(input);
+      state_->bytes_written_ += length;
+      if (state_->metrics_) {
+        state_->recordOutput(static_cast<int64_t>(length));
+      }
+    }
+    return length;
+  }
+
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  return output->writeOutput(data, length);
+}
+
+size_t TransformationPlugin::writeOutput(const char *data, size_t length) {
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p producing output with length=%d", this, state_->txn_, length);
+  int64_t write_length = static_cast<int64_t>(length);
+  if (!write_length || !prepareOutput()) {
+    return 0;
+  }
+
+  // Finally we can copy this data into the output_buffer
+  int64_t bytes_written = TSIOBufferWrite(state_->output_buffer_, data, write_length);
+  return reenableOutput(bytes_written, write_length);
+}
+
+size_t TransformationPlugin::produce(const InputBuffer &input) {
+  return produce(input, 0, input.length());
+}
+
+size_t TransformationPlugin::produce(const InputBuffer &input, size_t offset, size_t length) {
+  LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p passing through input offset=%d length=%d", this, state_->txn_, offset, length);
+  if ((offset > input.length()) || (length > input.length() - offset)) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p cannot produce offset=%d length=%d from an input of length=%d",
+        this, state_->txn_, offset, length, input.length());
+    return 0;
+  }
+
+  if (input.data_) {
+    return produce(input.data_ + offset, length);
+  }
+
+  if (getNextStage()) {
+    // Hand each upstream block in the requested range to the next stage as it is, nothing is copied.
+    InputBuffer blocks(input.reader_, offset + length);
+    const char *block_data;
+    size_t block_length;
+    size_t position = 0;
+    while (blocks.nextBlock(block_data, block_length)) {
+      size_t skip = (position < offset) ? (offset - position) : 0;
+      position += block_length;
+      if (skip < block_length) {
+        produce(block_data + skip, block_length - skip);
+      }
+    }
+    return length;
+  }
+
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  return output->writeOutput(input, offset, length);
+}
+
+size_t TransformationPlugin::writeOutput(const InputBuffer &input, size_t offset, size_t length) {
+  int64_t write_length = static_cast<int64_t>(length);
+  if (!write_length || !prepareOutput()) {
+    return 0;
+  }
+
+  // TSIOBufferCopy shares the upstream blocks with the output buffer rather than copying the bytes.
+  int64_t bytes_written = TSIOBufferCopy(state_->output_buffer_, static_cast<TSIOBufferReader>(input.reader_), write_length,
+                                         static_cast<int64_t>(offset));
+  return reenableOutput(bytes_written, write_length);
+}
+
+size_t TransformationPlugin::produce(const char *data, size_t length, FreeFunction free_func, void *free_data) {
+  size_t bytes_written = produce(data, length);
+  if (free_func) {
+    free_func(data, length, free_data);
+  }
+  return bytes_written;
+}
+
 size_t TransformationPlugin::setOutputComplete() {
+  if (state_->metrics_) {
+    state_->recordComplete();
+  }
+  state_->deactivate();
+  TransformationPlugin *next_stage = getNextStage();
+  if (next_stage) {
+    LOG_DEBUG("TransformationPlugin=%p tshttptxn=%p output complete, signaling input complete to stage=%p", this, state_->txn_, next_stage);
+    next_stage->handleInputComplete();
+    return static_cast<size_t>(state_->bytes_written_);
+  }
+
+  TransformationPlugin *output = state_->chain_ ? state_->chain_ : this;
+  return output->completeOutput();
+}
+
+size_t TransformationPlugin::completeOutput() {
+  if ((state_->output_length_ != INT64_MAX) && (state_->bytes_written_ != state_->output_length_) &&
+      !state_->aborted_) {
+    LOG_ERROR("TransformationPlugin=%p tshttptxn=%p completed after %lld bytes, its declared output length is %lld",
+              this, state_->txn_, static_cast<long long>(state_->bytes_written_),
+              static_cast<long long>(state_->output_length_));
+    abort();
+    return static_cast<size_t>(state_->bytes_written_);
+  }
   int connection_closed = TSVConnClosedGet(state_->vconn_);
   LOG_DEBUG("OutputComplete TransformationPlugin=%p tshttptxn=%p vconn=%p connection_closed=%d, total bytes written=%d", this, state_->txn_, state_->vconn_, connection_closed,state_->bytes_written_);
 
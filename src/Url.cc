@@ -16,9 +16,13 @@
  * @author Manjesh Nilange
  */
 #include "atscppapi/Url.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
 #include <ts/ts.h>
 #include "atscppapi/noncopyable.h"
 #include "InitializableValue.h"
+#include "ArenaAllocated.h"
 #include "logging_internal.h"
 
 using namespace atscppapi;
@@ -27,7 +31,7 @@ using std::string;
 /**
  * @private
  */
-struct atscppapi::UrlState: noncopyable {
+struct atscppapi::UrlState: noncopyable, ArenaAllocated {
   TSMBuffer hdr_buf_;
   TSMLoc url_loc_;
   InitializableValue<string> url_string_;
@@ -36,11 +40,55 @@ struct atscppapi::UrlState: noncopyable {
   InitializableValue<string> host_;
   InitializableValue<string> scheme_;
   InitializableValue<uint16_t> port_;
+  unsigned int stale_components_; // cached components that need to be checked against the marshal buffer
+  std::vector<QueryParamView> query_params_; // the parameters of indexed_query_, for findQueryParam()
+  StringView indexed_query_;
+  bool query_params_indexed_;
   UrlState(TSMBuffer hdr_buf, TSMLoc url_loc) :
-      hdr_buf_(hdr_buf), url_loc_(url_loc) {
+      hdr_buf_(hdr_buf), url_loc_(url_loc), stale_components_(0), query_params_indexed_(false) {
   }
 };
 
+namespace {
+
+enum UrlComponent {
+  URL_COMPONENT_PATH = 1 << 0,
+  URL_COMPONENT_QUERY = 1 << 1,
+  URL_COMPONENT_HOST = 1 << 2,
+  URL_COMPONENT_SCHEME = 1 << 3,
+  URL_COMPONENT_PORT = 1 << 4,
+  URL_COMPONENT_ALL = (1 << 5) - 1
+};
+
+/**
+ * Brings a cached component up to date with the marshal buffer. The common case after a reset() is
+ * that the component didn't change, then the cached string and its memory are kept.
+ */
+void refreshComponent(InitializableValue<string> &component, const char *memptr, int length) {
+  string &value = component.getValueRef();
+  size_t new_length = (memptr && (length > 0)) ? static_cast<size_t>(length) : 0;
+  if (!component.isInitialized() || (value.length() != new_length) ||
+      (new_length && (value.compare(0, new_length, memptr, new_length) != 0))) {
+    value.assign(new_length ? memptr : "", new_length);
+  }
+  component.setInitialized();
+}
+
+StringView makeView(const char *memptr, int length) {
+  return (memptr && (length > 0)) ? StringView(memptr, static_cast<size_t>(length)) : StringView();
+}
+
+StringView makeView(const InitializableValue<string> &component) {
+  const string &value = component.getValueRef();
+  return value.empty() ? StringView() : StringView(value);
+}
+
+// TSUrlPrint() only prints to an IOBuffer, each thread keeps one around for getUrlString(char *, size_t)
+__thread TSIOBuffer print_buffer = NULL;
+__thread TSIOBufferReader print_reader = NULL;
+
+}
+
 Url::Url() {
   state_ = new UrlState(static_cast<TSMBuffer>(NULL), static_cast<TSMLoc>(NULL));
 }
@@ -64,6 +112,12 @@ bool inline Url::isInitialized() const {
 
 void Url::reset() {
   state_->url_string_.setInitialized(false);
+  state_->query_params_indexed_ = false;
+  if (isInitialized()) {
+    // the components are kept and only compared to the marshal buffer when next read
+    state_->stale_components_ = URL_COMPONENT_ALL;
+    return;
+  }
   state_->path_.setInitialized(false);
   state_->query_.setInitialized(false);
   state_->host_.setInitialized(false);
@@ -87,57 +141,223 @@ const std::string &Url::getUrlString() const {
   return state_->url_string_;
 }
 
+size_t Url::getUrlStringLength() const {
+  if (state_->url_string_.isInitialized() || !isInitialized()) {
+    return state_->url_string_.getValueRef().length();
+  }
+  int length = TSUrlLengthGet(state_->hdr_buf_, state_->url_loc_);
+  return (length > 0) ? static_cast<size_t>(length) : 0;
+}
+
+size_t Url::getUrlString(char *buffer, size_t buffer_length) const {
+  if (state_->url_string_.isInitialized() || !isInitialized()) {
+    const string &url_string = state_->url_string_.getValueRef();
+    if (!buffer || (buffer_length < url_string.length())) {
+      LOG_ERROR("Buffer %p of length %zu too small for url", buffer, buffer_length);
+      return 0;
+    }
+    memcpy(buffer, url_string.data(), url_string.length());
+    return url_string.length();
+  }
+
+  size_t url_length = getUrlStringLength();
+  if (!buffer || (buffer_length < url_length)) {
+    LOG_ERROR("Buffer %p of length %zu too small for url", buffer, buffer_length);
+    return 0;
+  }
+  if (!print_buffer) {
+    print_buffer = TSIOBufferCreate();
+    print_reader = TSIOBufferReaderAlloc(print_buffer);
+  }
+  TSUrlPrint(state_->hdr_buf_, state_->url_loc_, print_buffer);
+  int64_t avail = TSIOBufferReaderAvail(print_reader);
+  size_t written = 0;
+  for (TSIOBufferBlock block = TSIOBufferReaderStart(print_reader); block && (written < buffer_length);
+       block = TSIOBufferBlockNext(block)) {
+    int64_t data_length;
+    const char *data = TSIOBufferBlockReadStart(block, print_reader, &data_length);
+    size_t copy_length = std::min(static_cast<size_t>(data_length), buffer_length - written);
+    memcpy(buffer + written, data, copy_length);
+    written += copy_length;
+  }
+  TSIOBufferReaderConsume(print_reader, avail);
+  return written;
+}
+
+void Url::getView(UrlView &view) const {
+  if (!isInitialized()) {
+    view.scheme_ = makeView(state_->scheme_);
+    view.host_ = makeView(state_->host_);
+    view.path_ = makeView(state_->path_);
+    view.query_ = makeView(state_->query_);
+    view.port_ = state_->port_.isInitialized() ? state_->port_.getValueRef() : 0;
+    return;
+  }
+  int length;
+  const char *memptr = TSUrlSchemeGet(state_->hdr_buf_, state_->url_loc_, &length);
+  view.scheme_ = makeView(memptr, length);
+  memptr = TSUrlHostGet(state_->hdr_buf_, state_->url_loc_, &length);
+  view.host_ = makeView(memptr, length);
+  memptr = TSUrlPathGet(state_->hdr_buf_, state_->url_loc_, &length);
+  view.path_ = makeView(memptr, length);
+  memptr = TSUrlHttpQueryGet(state_->hdr_buf_, state_->url_loc_, &length);
+  view.query_ = makeView(memptr, length);
+  view.port_ = TSUrlPortGet(state_->hdr_buf_, state_->url_loc_);
+}
+
 const std::string &Url::getPath() const {
-  if (isInitialized() && !state_->path_.isInitialized()) {
+  if (isInitialized() && (!state_->path_.isInitialized() || (state_->stale_components_ & URL_COMPONENT_PATH))) {
     int length;
     const char *memptr = TSUrlPathGet(state_->hdr_buf_, state_->url_loc_, &length);
-    if (memptr && length) {
-      state_->path_ = std::string(memptr, length);
-    }
+    refreshComponent(state_->path_, memptr, length);
+    state_->stale_components_ &= ~URL_COMPONENT_PATH;
     LOG_DEBUG("Using path [%s]", state_->path_.getValue().c_str());
   }
   return state_->path_;
 }
 
 const std::string &Url::getQuery() const {
-  if (isInitialized() && !state_->query_.isInitialized()) {
+  if (isInitialized() && (!state_->query_.isInitialized() || (state_->stale_components_ & URL_COMPONENT_QUERY))) {
     int length;
     const char *memptr = TSUrlHttpQueryGet(state_->hdr_buf_, state_->url_loc_, &length);
-    if (memptr && length) {
-      state_->query_ = std::string(memptr, length);
-    }
+    refreshComponent(state_->query_, memptr, length);
+    state_->stale_components_ &= ~URL_COMPONENT_QUERY;
     LOG_DEBUG("Using query [%s]", state_->query_.getValue().c_str());
   }
   return state_->query_;
 }
 
+bool QueryParamIterator::next(QueryParamView &param) {
+  while (pos_ < query_.length()) {
+    size_t end = query_.find('&', pos_);
+    if (end == StringView::npos) {
+      end = query_.length();
+    }
+    StringView current = query_.substr(pos_, end - pos_);
+    pos_ = end + 1;
+    if (current.empty()) {
+      continue;
+    }
+    size_t equals = current.find('=');
+    if (equals == StringView::npos) {
+      param.name_ = current;
+      param.value_ = StringView(current.end(), 0);
+    } else {
+      param.name_ = current.substr(0, equals);
+      param.value_ = current.substr(equals + 1);
+    }
+    return true;
+  }
+  return false;
+}
+
+StringView Url::getQueryView() const {
+  if (!isInitialized()) {
+    return makeView(state_->query_);
+  }
+  int length;
+  const char *memptr = TSUrlHttpQueryGet(state_->hdr_buf_, state_->url_loc_, &length);
+  return makeView(memptr, length);
+}
+
+QueryParamIterator Url::getQueryParams() const {
+  return QueryParamIterator(getQueryView());
+}
+
+StringView Url::findQueryParam(const StringView &name, int index) const {
+  StringView query = getQueryView();
+  // the index is kept as long as the query is the same string in the marshal buffer
+  if (!state_->query_params_indexed_ || (query.data() != state_->indexed_query_.data()) ||
+      (query.length() != state_->indexed_query_.length())) {
+    state_->query_params_.clear();
+    QueryParamIterator iter(query);
+    QueryParamView param;
+    while (iter.next(param)) {
+      state_->query_params_.push_back(param);
+    }
+    state_->indexed_query_ = query;
+    state_->query_params_indexed_ = true;
+    LOG_DEBUG("Indexed %d query parameters", static_cast<int>(state_->query_params_.size()));
+  }
+  for (std::vector<QueryParamView>::const_iterator iter = state_->query_params_.begin(),
+         end = state_->query_params_.end(); iter != end; ++iter) {
+    if ((iter->name_ == name) && (index-- == 0)) {
+      return iter->value_;
+    }
+  }
+  return StringView();
+}
+
+namespace {
+
+inline int hexValue(char c) {
+  if ((c >= '0') && (c <= '9')) {
+    return c - '0';
+  }
+  if ((c >= 'a') && (c <= 'f')) {
+    return c - 'a' + 10;
+  }
+  if ((c >= 'A') && (c <= 'F')) {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+}
+
+StringView Url::decodeQueryComponent(const StringView &encoded, char *buffer, size_t buffer_length) {
+  const char *first = encoded.begin();
+  for (; (first != encoded.end()) && (*first != '%') && (*first != '+'); ++first);
+  if (first == encoded.end()) {
+    return encoded;
+  }
+  size_t written = first - encoded.begin();
+  if (!buffer || (buffer_length < written)) {
+    return StringView();
+  }
+  memcpy(buffer, encoded.data(), written);
+  for (const char *p = first; p != encoded.end(); ++p) {
+    char c = *p;
+    if (c == '+') {
+      c = ' ';
+    } else if ((c == '%') && (encoded.end() - p > 2) && (hexValue(p[1]) >= 0) && (hexValue(p[2]) >= 0)) {
+      c = static_cast<char>((hexValue(p[1]) << 4) | hexValue(p[2]));
+      p += 2;
+    } // a malformed escape is kept as is
+    if (written == buffer_length) {
+      return StringView();
+    }
+    buffer[written++] = c;
+  }
+  return StringView(buffer, written);
+}
+
 const std::string &Url::getScheme() const {
-  if (isInitialized() && !state_->scheme_.isInitialized()) {
+  if (isInitialized() && (!state_->scheme_.isInitialized() || (state_->stale_components_ & URL_COMPONENT_SCHEME))) {
     int length;
     const char *memptr = TSUrlSchemeGet(state_->hdr_buf_, state_->url_loc_, &length);
-    if (memptr && length) {
-      state_->scheme_ = std::string(memptr, length);
-    }
+    refreshComponent(state_->scheme_, memptr, length);
+    state_->stale_components_ &= ~URL_COMPONENT_SCHEME;
     LOG_DEBUG("Using scheme [%s]", state_->scheme_.getValue().c_str());
   }
   return state_->scheme_;
 }
 
 const std::string &Url::getHost() const {
-  if (isInitialized() && !state_->host_.isInitialized()) {
+  if (isInitialized() && (!state_->host_.isInitialized() || (state_->stale_components_ & URL_COMPONENT_HOST))) {
     int length;
     const char *memptr = TSUrlHostGet(state_->hdr_buf_, state_->url_loc_, &length);
-    if (memptr && length) {
-      state_->host_ = std::string(memptr, length);
-    }
+    refreshComponent(state_->host_, memptr, length);
+    state_->stale_components_ &= ~URL_COMPONENT_HOST;
     LOG_DEBUG("Using host [%s]", state_->host_.getValue().c_str());
   }
   return state_->host_;
 }
 
 uint16_t Url::getPort() const {
-  if (isInitialized() && !state_->port_.isInitialized()) {
+  if (isInitialized() && (!state_->port_.isInitialized() || (state_->stale_components_ & URL_COMPONENT_PORT))) {
     state_->port_ = TSUrlPortGet(state_->hdr_buf_, state_->url_loc_);
+    state_->stale_components_ &= ~URL_COMPONENT_PORT;
     LOG_DEBUG("Got port %d", state_->port_.getValue());
   }
   return state_->port_;
@@ -151,6 +371,7 @@ void Url::setPath(const std::string &path) {
   state_->url_string_.setInitialized(false);
   if (TSUrlPathSet(state_->hdr_buf_, state_->url_loc_, path.c_str(), path.length()) == TS_SUCCESS) {
     state_->path_ = path;
+    state_->stale_components_ &= ~URL_COMPONENT_PATH;
     LOG_DEBUG("Set path to [%s]", path.c_str());
   } else {
     LOG_ERROR("Could not set path; hdr_buf %p, url_loc %p", state_->hdr_buf_, state_->url_loc_);
@@ -163,8 +384,10 @@ void Url::setQuery(const std::string &query) {
     return;
   }
   state_->url_string_.setInitialized(false);
+  state_->query_params_indexed_ = false;
   if (TSUrlHttpQuerySet(state_->hdr_buf_, state_->url_loc_, query.c_str(), query.length()) == TS_SUCCESS) {
     state_->query_ = query;
+    state_->stale_components_ &= ~URL_COMPONENT_QUERY;
     LOG_DEBUG("Set query to [%s]", query.c_str());
   } else {
     LOG_ERROR("Could not set query; hdr_buf %p, url_loc %p", state_->hdr_buf_, state_->url_loc_);
@@ -179,6 +402,7 @@ void Url::setScheme(const std::string &scheme) {
   state_->url_string_.setInitialized(false);
   if (TSUrlSchemeSet(state_->hdr_buf_, state_->url_loc_, scheme.c_str(), scheme.length()) == TS_SUCCESS) {
     state_->scheme_ = scheme;
+    state_->stale_components_ &= ~URL_COMPONENT_SCHEME;
     LOG_DEBUG("Set scheme to [%s]", scheme.c_str());
   } else {
     LOG_ERROR("Could not set scheme; hdr_buf %p, url_loc %p", state_->hdr_buf_, state_->url_loc_);
@@ -193,6 +417,7 @@ void Url::setHost(const std::string &host) {
   state_->url_string_.setInitialized(false);
   if (TSUrlHostSet(state_->hdr_buf_, state_->url_loc_, host.c_str(), host.length()) == TS_SUCCESS) {
     state_->host_ = host;
+    state_->stale_components_ &= ~URL_COMPONENT_HOST;
     LOG_DEBUG("Set host to [%s]", host.c_str());
   } else {
     LOG_ERROR("Could not set host; hdr_buf %p, url_loc %p", state_->hdr_buf_, state_->url_loc_);
@@ -207,6 +432,7 @@ void Url::setPort(const uint16_t port) {
   state_->url_string_.setInitialized(false);
   if (TSUrlPortSet(state_->hdr_buf_, state_->url_loc_, port) == TS_SUCCESS) {
     state_->port_ = port;
+    state_->stale_components_ &= ~URL_COMPONENT_PORT;
     LOG_DEBUG("Set port to %d", port);
   } else {
     LOG_ERROR("Could not set port; hdr_buf %p, url_loc %p", state_->hdr_buf_, state_->url_loc_);
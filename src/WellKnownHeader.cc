@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file WellKnownHeader.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include "atscppapi/WellKnownHeader.h"
+#include <ts/ts.h>
+#include <strings.h>
+
+namespace {
+
+/**
+ * The TS_MIME_FIELD_* strings are only set up once Traffic Server has started, so the table keeps
+ * their addresses rather than their values.
+ */
+struct WellKnownHeaderEntry {
+  const char * const *name_;
+  const int *length_;
+};
+
+#define WELL_KNOWN_HEADER_ENTRY(NAME) { &TS_MIME_FIELD_##NAME, &TS_MIME_LEN_##NAME }
+
+const WellKnownHeaderEntry WELL_KNOWN_HEADERS[atscppapi::WELL_KNOWN_HEADER_COUNT] = {
+  WELL_KNOWN_HEADER_ENTRY(ACCEPT),
+  WELL_KNOWN_HEADER_ENTRY(ACCEPT_ENCODING),
+  WELL_KNOWN_HEADER_ENTRY(AUTHORIZATION),
+  WELL_KNOWN_HEADER_ENTRY(CACHE_CONTROL),
+  WELL_KNOWN_HEADER_ENTRY(CONNECTION),
+  WELL_KNOWN_HEADER_ENTRY(CONTENT_ENCODING),
+  WELL_KNOWN_HEADER_ENTRY(CONTENT_LENGTH),
+  WELL_KNOWN_HEADER_ENTRY(CONTENT_TYPE),
+  WELL_KNOWN_HEADER_ENTRY(COOKIE),
+  WELL_KNOWN_HEADER_ENTRY(DATE),
+  WELL_KNOWN_HEADER_ENTRY(ETAG),
+  WELL_KNOWN_HEADER_ENTRY(EXPIRES),
+  WELL_KNOWN_HEADER_ENTRY(HOST),
+  WELL_KNOWN_HEADER_ENTRY(IF_MODIFIED_SINCE),
+  WELL_KNOWN_HEADER_ENTRY(IF_NONE_MATCH),
+  WELL_KNOWN_HEADER_ENTRY(LAST_MODIFIED),
+  WELL_KNOWN_HEADER_ENTRY(LOCATION),
+  WELL_KNOWN_HEADER_ENTRY(RANGE),
+  WELL_KNOWN_HEADER_ENTRY(REFERER),
+  WELL_KNOWN_HEADER_ENTRY(SET_COOKIE),
+  WELL_KNOWN_HEADER_ENTRY(TRANSFER_ENCODING),
+  WELL_KNOWN_HEADER_ENTRY(USER_AGENT),
+  WELL_KNOWN_HEADER_ENTRY(VARY),
+  WELL_KNOWN_HEADER_ENTRY(VIA),
+  WELL_KNOWN_HEADER_ENTRY(X_FORWARDED_FOR)
+};
+
+#undef WELL_KNOWN_HEADER_ENTRY
+
+}
+
+atscppapi::StringView atscppapi::getWellKnownHeaderName(WellKnownHeader header) {
+  if ((header < 0) || (header >= WELL_KNOWN_HEADER_COUNT)) {
+    return StringView();
+  }
+  const WellKnownHeaderEntry &entry = WELL_KNOWN_HEADERS[header];
+  return StringView(*entry.name_, *entry.length_);
+}
+
+bool atscppapi::isWellKnownHeader(const char *name, size_t name_length, WellKnownHeader header) {
+  if ((header < 0) || (header >= WELL_KNOWN_HEADER_COUNT) || !name) {
+    return false;
+  }
+  const WellKnownHeaderEntry &entry = WELL_KNOWN_HEADERS[header];
+  if (name_length != static_cast<size_t>(*entry.length_)) {
+    return false;
+  }
+  return (name == *entry.name_) || (strncasecmp(name, *entry.name_, name_length) == 0);
+}
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdDeflateTransformation.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include <string>
+#include <vector>
+#include <zstd.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/ZstdDeflateTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const int ONE_KB = 1024;
+const size_t INPUT_LOW_WATERMARK = 8 * ONE_KB;
+const size_t INPUT_HIGH_WATERMARK = 64 * ONE_KB;
+const size_t DEFAULT_OUTPUT_BUFFER_SIZE = 16 * ONE_KB;
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::ZstdDeflateTransformationState: noncopyable {
+  ZSTD_CCtx *cctx_;
+  TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  ZstdDeflateTransformation::Options options_;
+  vector<char> buffer_; // reused for every call to ZSTD_compressStream2().
+
+  ZstdDeflateTransformationState(TransformationPlugin::Type type, const ZstdDeflateTransformation::Options &options) :
+        cctx_(NULL), transformation_type_(type), bytes_produced_(0), options_(options),
+        buffer_(options.output_buffer_size_ ? options.output_buffer_size_ : DEFAULT_OUTPUT_BUFFER_SIZE) {
+    cctx_ = ZSTD_createCCtx();
+    if (!cctx_) {
+      LOG_ERROR("ZSTD_createCCtx failed.");
+      return;
+    }
+
+    size_t err = ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, options_.level_);
+    if (!ZSTD_isError(err) && options_.window_log_) {
+      err = ZSTD_CCtx_setParameter(cctx_, ZSTD_c_windowLog, options_.window_log_);
+    }
+    if (ZSTD_isError(err)) {
+      LOG_ERROR("Unable to set zstd level=%d window_log=%d, error '%s'.", options_.level_, options_.window_log_,
+          ZSTD_getErrorName(err));
+    }
+  };
+
+  ~ZstdDeflateTransformationState() {
+    if (cctx_) {
+      ZSTD_freeCCtx(cctx_);
+    }
+  };
+};
+
+ZstdDeflateTransformation::Options::Options()
+  : level_(ZSTD_CLEVEL_DEFAULT), window_log_(0), flush_every_chunk_(true), output_buffer_size_(DEFAULT_OUTPUT_BUFFER_SIZE) {
+}
+
+ZstdDeflateTransformation::ZstdDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdDeflateTransformationState(type, Options());
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+ZstdDeflateTransformation::ZstdDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdDeflateTransformationState(type, options);
+  setInputWatermarks(INPUT_LOW_WATERMARK, INPUT_HIGH_WATERMARK);
+}
+
+ZstdDeflateTransformation::ZstdDeflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new ZstdDeflateTransformationState(getType(), Options());
+}
+
+ZstdDeflateTransformation::ZstdDeflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                     const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new ZstdDeflateTransformationState(getType(), options);
+}
+
+ZstdDeflateTransformation::~ZstdDeflateTransformation() {
+  delete state_;
+}
+
+void ZstdDeflateTransformation::consume(const string &data) {
+  compressData(data.data(), data.length(), state_->options_.flush_every_chunk_ ? ZSTD_e_flush : ZSTD_e_continue);
+}
+
+void ZstdDeflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    compressData(data, length, ZSTD_e_continue);
+  }
+  if (state_->options_.flush_every_chunk_) {
+    compressData(NULL, 0, ZSTD_e_flush);
+  }
+}
+
+void ZstdDeflateTransformation::compressData(const char *data, size_t length, int operation) {
+  if (!state_->cctx_) {
+    LOG_ERROR("Unable to zstd compress output because the context was not created.");
+    return;
+  }
+
+  int iteration = 0;
+  ZSTD_EndDirective directive = static_cast<ZSTD_EndDirective>(operation);
+  ZSTD_inBuffer input = { data, length, 0 };
+  size_t remaining = 0;
+
+  // With ZSTD_e_continue we're done once the input is taken, a flush or end is done once nothing remains to be written.
+  do {
+    ZSTD_outBuffer output = { &state_->buffer_[0], state_->buffer_.size(), 0 };
+    remaining = ZSTD_compressStream2(state_->cctx_, &output, &input, directive);
+    if (ZSTD_isError(remaining)) {
+      LOG_ERROR("Iteration %d: Zstd failed to compress %d bytes with directive %d, error '%s'", iteration, length, operation,
+          ZSTD_getErrorName(remaining));
+      return;
+    }
+
+    LOG_DEBUG("Iteration %d: Zstd directive %d has %d bytes of output", ++iteration, operation, output.pos);
+    if (output.pos) {
+      state_->bytes_produced_ += output.pos;
+      produce(&state_->buffer_[0], output.pos);
+    }
+  } while ((directive == ZSTD_e_continue) ? (input.pos < input.size) : (remaining != 0));
+}
+
+void ZstdDeflateTransformation::handleInputComplete() {
+  LOG_DEBUG("Zstd compression finalizing.");
+  compressData(NULL, 0, ZSTD_e_end);
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Zstd bytes produced sanity check failed, compressed bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
+  }
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdInflateTransformation.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#include <string>
+#include <vector>
+#include <zstd.h>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/ZstdInflateTransformation.h"
+#include "logging_internal.h"
+
+using namespace atscppapi::transformations;
+using std::string;
+using std::vector;
+
+namespace {
+const int ONE_KB = 1024;
+const size_t DEFAULT_OUTPUT_WINDOW_SIZE = 16 * ONE_KB;
+const int64_t MIN_BYTES_FOR_RATIO_CHECK = 64 * ONE_KB; // the first few bytes of a stream can legitimately inflate a lot.
+}
+
+/**
+ * @private
+ */
+struct atscppapi::transformations::ZstdInflateTransformationState: noncopyable {
+  ZSTD_DCtx *dctx_;
+  TransformationPlugin::Type transformation_type_;
+  int64_t bytes_produced_;
+  int64_t bytes_consumed_;
+  ZstdInflateTransformation::Options options_;
+  vector<char> window_; // decompressed output is drained through this buffer.
+  bool limit_exceeded_;
+  bool output_complete_;
+
+  ZstdInflateTransformationState(TransformationPlugin::Type type, const ZstdInflateTransformation::Options &options) :
+        dctx_(NULL), transformation_type_(type), bytes_produced_(0), bytes_consumed_(0), options_(options),
+        window_(options.output_window_size_ ? options.output_window_size_ : DEFAULT_OUTPUT_WINDOW_SIZE),
+        limit_exceeded_(false), output_complete_(false) {
+    dctx_ = ZSTD_createDCtx();
+    if (!dctx_) {
+      LOG_ERROR("ZSTD_createDCtx failed.");
+    }
+  };
+
+  ~ZstdInflateTransformationState() {
+    if (dctx_) {
+      ZSTD_freeDCtx(dctx_);
+    }
+  };
+};
+
+ZstdInflateTransformation::Options::Options()
+  : output_window_size_(DEFAULT_OUTPUT_WINDOW_SIZE), max_output_bytes_(0), max_ratio_(0) {
+}
+
+ZstdInflateTransformation::ZstdInflateTransformation(Transaction &transaction, TransformationPlugin::Type type) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdInflateTransformationState(type, Options());
+}
+
+ZstdInflateTransformation::ZstdInflateTransformation(Transaction &transaction, TransformationPlugin::Type type,
+                                                     const Options &options) : TransformationPlugin(transaction, type) {
+  state_ = new ZstdInflateTransformationState(type, options);
+}
+
+ZstdInflateTransformation::ZstdInflateTransformation(Transaction &transaction, TransformationChain &chain) : TransformationPlugin(transaction, chain) {
+  state_ = new ZstdInflateTransformationState(getType(), Options());
+}
+
+ZstdInflateTransformation::ZstdInflateTransformation(Transaction &transaction, TransformationChain &chain,
+                                                     const Options &options) : TransformationPlugin(transaction, chain) {
+  state_ = new ZstdInflateTransformationState(getType(), options);
+}
+
+ZstdInflateTransformation::~ZstdInflateTransformation() {
+  delete state_;
+}
+
+bool ZstdInflateTransformation::isLimitExceeded() const {
+  return state_->limit_exceeded_;
+}
+
+void ZstdInflateTransformation::consume(const string &data) {
+  decompressData(data.data(), data.length());
+}
+
+void ZstdInflateTransformation::consume(InputBuffer &input) {
+  const char *data;
+  size_t length;
+  while (input.nextBlock(data, length)) {
+    decompressData(data, length);
+  }
+}
+
+bool ZstdInflateTransformation::checkLimits() {
+  const ZstdInflateTransformation::Options &options = state_->options_;
+  if (options.max_output_bytes_ && (state_->bytes_produced_ > options.max_output_bytes_)) {
+    LOG_ERROR("Zstd inflate aborting, inflated bytes = %d exceeds the limit of %d bytes", state_->bytes_produced_,
+        options.max_output_bytes_);
+    state_->limit_exceeded_ = true;
+  } else if (options.max_ratio_ && (state_->bytes_produced_ >= MIN_BYTES_FOR_RATIO_CHECK) &&
+             (state_->bytes_produced_ > static_cast<int64_t>(options.max_ratio_) * state_->bytes_consumed_)) {
+    LOG_ERROR("Zstd inflate aborting, inflated bytes = %d from %d compressed bytes exceeds the ratio limit of %d",
+        state_->bytes_produced_, state_->bytes_consumed_, options.max_ratio_);
+    state_->limit_exceeded_ = true;
+  }
+
+  if (state_->limit_exceeded_ && !state_->output_complete_) {
+    // a cut off body must not look complete to the client or the cache, so the transformation fails
+    state_->output_complete_ = true;
+    abort();
+  }
+  return !state_->limit_exceeded_;
+}
+
+void ZstdInflateTransformation::decompressData(const char *data, size_t length) {
+  if (length == 0 || state_->limit_exceeded_) {
+    return;
+  }
+
+  if (!state_->dctx_) {
+    LOG_ERROR("Unable to zstd decompress output because the context was not created.");
+    return;
+  }
+
+  int iteration = 0;
+  const ZstdInflateTransformation::Options &options = state_->options_;
+  ZSTD_inBuffer input = { data, length, 0 };
+  bool window_full = false;
+
+  // Loop while there is input left or the window was filled and there may be more output pending.
+  do {
+    LOG_DEBUG("Iteration %d: Zstd has %d bytes to inflate", ++iteration, input.size - input.pos);
+
+    // Never decompress more than the output limit allows.
+    size_t window_size = state_->window_.size();
+    if (options.max_output_bytes_ && (options.max_output_bytes_ - state_->bytes_produced_ < static_cast<int64_t>(window_size))) {
+      window_size = static_cast<size_t>(options.max_output_bytes_ - state_->bytes_produced_ + 1);
+    }
+    ZSTD_outBuffer output = { &state_->window_[0], window_size, 0 };
+    size_t start_pos = input.pos;
+
+    size_t ret = ZSTD_decompressStream(state_->dctx_, &output, &input);
+    if (ZSTD_isError(ret)) {
+      LOG_ERROR("Iteration %d: Zstd inflate failed with error '%s'", iteration, ZSTD_getErrorName(ret));
+      return;
+    }
+    state_->bytes_consumed_ += (input.pos - start_pos);
+
+    state_->bytes_produced_ += output.pos;
+    if (!checkLimits()) {
+      return;
+    }
+
+    LOG_DEBUG("Iteration %d: Zstd inflated a total of %d bytes, producingOutput...", iteration, output.pos);
+    if (output.pos) {
+      produce(&state_->window_[0], output.pos);
+    }
+    window_full = (output.pos == output.size);
+  } while (input.pos < input.size || window_full);
+}
+
+void ZstdInflateTransformation::handleInputComplete() {
+  if (state_->output_complete_) {
+    return;
+  }
+  state_->output_complete_ = true;
+
+  int64_t bytes_written = setOutputComplete();
+  if (state_->bytes_produced_ != bytes_written) {
+    LOG_ERROR("Zstd bytes produced sanity check failed, inflated bytes = %d != written bytes = %d", state_->bytes_produced_, bytes_written);
+  }
+}
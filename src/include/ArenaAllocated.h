@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ArenaAllocated.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ARENAALLOCATED_H_
+#define ATSCPPAPI_ARENAALLOCATED_H_
+
+#include <cstddef>
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * Base for internal state objects: when created inside an Arena::Scope they are allocated from
+ * that Arena and their delete only runs the destructor, otherwise they are ordinary heap objects.
+ * Such objects must be deleted before their Arena is.
+ */
+struct ArenaAllocated {
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+};
+
+}
+
+#endif /* ATSCPPAPI_ARENAALLOCATED_H_ */
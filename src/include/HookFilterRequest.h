@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HookFilterRequest.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_HOOKFILTERREQUEST_H_
+#define ATSCPPAPI_HOOKFILTERREQUEST_H_
+
+#include <ts/ts.h>
+#include "atscppapi/noncopyable.h"
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * Marks the request of an AsyncHttpFetch made with Options::passthrough_, Traffic Server doesn't forward
+ * headers whose name starts with @ to the origin.
+ */
+const char PASSTHROUGH_HEADER[] = "@atscppapi-Passthrough";
+const int PASSTHROUGH_HEADER_LENGTH = sizeof(PASSTHROUGH_HEADER) - 1;
+
+/**
+ * @private
+ *
+ * The parts of a client request HookFilters look at, read from Traffic Server only once they are
+ * first needed and then shared by all filters of a hook.
+ */
+struct HookFilterRequest: noncopyable {
+  TSHttpTxn txn_;
+  TSMBuffer hdr_buf_;
+  TSMLoc hdr_loc_;
+  TSMLoc url_loc_;
+  const char *host_;
+  int host_length_;
+  const char *path_;
+  int path_length_;
+  const char *method_;
+  int method_length_;
+  bool request_fetched_;
+  int internal_; // -1 until known
+  int passthrough_; // -1 until known
+
+  /** Set once a passthrough fetch was made, until then no transaction is checked for the header. */
+  static volatile bool passthrough_fetches_made_;
+
+  HookFilterRequest(TSHttpTxn txn);
+  ~HookFilterRequest();
+
+  /** @return false if the client request isn't available. */
+  bool fetchRequest();
+
+  bool isInternal();
+
+  /** @return true for the internal transaction of a passthrough fetch, which no plugin hook is invoked for. */
+  bool isPassthrough();
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_HOOKFILTERREQUEST_H_ */
@@ -29,8 +29,43 @@ extern bool transaction_data_caching_enabled;
 
 /**
  * @private
+ *
+ * Caching policies of InitializableValue, isEnabled() says whether values once read from Traffic Server are
+ * reused. With a constant policy isInitialized() inlines to a test of the value's own flag.
  */
-template <typename Type> class InitializableValue {
+struct AlwaysCacheTransactionData {
+  static inline bool isEnabled() { return true; }
+};
+
+/** @private */
+struct NeverCacheTransactionData {
+  static inline bool isEnabled() { return false; }
+};
+
+/** @private Decided at startup, see utils::DISABLE_DATA_CACHING_ENV_FLAG. */
+struct RuntimeCacheTransactionData {
+  static inline bool isEnabled() { return transaction_data_caching_enabled; }
+};
+
+/**
+ * @private
+ *
+ * The policy the library is built with: DISABLE_TRANSACTION_DATA_CACHING never caches,
+ * ATSCPPAPI_ALWAYS_CACHE_TRANSACTION_DATA (configure --enable-always-cache) always does and ignores
+ * the environment variable.
+ */
+#if defined(DISABLE_TRANSACTION_DATA_CACHING)
+typedef NeverCacheTransactionData TransactionDataCachingPolicy;
+#elif defined(ATSCPPAPI_ALWAYS_CACHE_TRANSACTION_DATA)
+typedef AlwaysCacheTransactionData TransactionDataCachingPolicy;
+#else
+typedef RuntimeCacheTransactionData TransactionDataCachingPolicy;
+#endif
+
+/**
+ * @private
+ */
+template <typename Type, typename CachingPolicy = TransactionDataCachingPolicy> class InitializableValue {
 public:
   InitializableValue() : initialized_(false) { }
   explicit InitializableValue(Type value, bool initialized = true) : value_(value), initialized_(initialized) { }
@@ -41,10 +76,7 @@ public:
   }
 
   inline bool isInitialized() const {
-#ifdef DISABLE_TRANSACTION_DATA_CACHING
-    return false;
-#endif
-    return transaction_data_caching_enabled && initialized_;
+    return CachingPolicy::isEnabled() && initialized_;
   }
 
   inline Type &getValueRef() {
@@ -71,7 +103,7 @@ public:
     return value_;
   }
 
-  inline InitializableValue<Type> &operator=(const Type& value) {
+  inline InitializableValue<Type, CachingPolicy> &operator=(const Type& value) {
     setValue(value);
     return *this;
   }
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatShards.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STATSHARDS_H_
+#define ATSCPPAPI_STATSHARDS_H_
+
+#include <stdint.h>
+#include <cstddef>
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * The shard of the calling thread, in [0, MAX_STAT_SHARDS). Threads are assigned shards round robin on
+ * first use, so with up to MAX_STAT_SHARDS threads every thread has a shard of its own.
+ */
+static const int MAX_STAT_SHARDS = 64;
+
+extern __thread int current_stat_shard;
+
+int assignStatShard();
+
+inline int getStatShard() {
+  return (current_stat_shard >= 0) ? current_stat_shard : assignStatShard();
+}
+
+/**
+ * @private
+ *
+ * A counter on a cache line of its own, threads sharing a shard still update it atomically.
+ */
+struct StatShardCounter {
+  static const size_t CACHE_LINE_SIZE = 64;
+  volatile int64_t value_;
+  char padding_[CACHE_LINE_SIZE - sizeof(int64_t)];
+} __attribute__((aligned(64)));
+
+/**
+ * @private
+ *
+ * @return count zeroed counters aligned to cache lines, release with freeStatShardCounters().
+ */
+StatShardCounter *allocateStatShardCounters(size_t count);
+
+void freeStatShardCounters(StatShardCounter *counters);
+
+}
+
+#endif /* ATSCPPAPI_STATSHARDS_H_ */
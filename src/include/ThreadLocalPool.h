@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ThreadLocalPool.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_THREADLOCALPOOL_H_
+#define ATSCPPAPI_THREADLOCALPOOL_H_
+
+#include <cstddef>
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * A per thread free list of objects that are expensive to create and cheap to reset, e.g. the
+ * Arena of every Transaction. Objects are pushed back by whichever thread releases them, so with
+ * Traffic Server's event threads each thread ends up recycling its own transactions' objects.
+ * Every thread keeps at most CAPACITY objects; they live as long as the thread, which for the event
+ * threads is the life of the process.
+ */
+template <typename T> class ThreadLocalPool {
+public:
+  static const size_t CAPACITY = 64;
+
+  /**
+   * @return A pooled object, NULL if this thread has none.
+   */
+  static T *pop() {
+    return size_ ? objects_[--size_] : NULL;
+  }
+
+  /**
+   * @return false if this thread's pool is full, the caller must destroy object then.
+   */
+  static bool push(T *object) {
+    if (size_ == CAPACITY) {
+      return false;
+    }
+    objects_[size_++] = object;
+    return true;
+  }
+private:
+  static __thread T *objects_[CAPACITY];
+  static __thread size_t size_;
+};
+
+template <typename T> __thread T *ThreadLocalPool<T>::objects_[ThreadLocalPool<T>::CAPACITY];
+template <typename T> __thread size_t ThreadLocalPool<T>::size_ = 0;
+
+}
+
+#endif /* ATSCPPAPI_THREADLOCALPOOL_H_ */
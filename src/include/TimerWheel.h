@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TimerWheel.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TIMERWHEEL_H_
+#define ATSCPPAPI_TIMERWHEEL_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <ts/ts.h>
+#include "atscppapi/Async.h"
+#include "atscppapi/Mutex.h"
+#include "atscppapi/noncopyable.h"
+
+namespace atscppapi {
+
+class TimerWheel;
+
+/**
+ * @private
+ *
+ * The links of a doubly linked slot list, the heads of the lists point to themselves when empty.
+ */
+struct TimerWheelLink {
+  TimerWheelLink *prev_;
+  TimerWheelLink *next_;
+  TimerWheelLink() : prev_(NULL), next_(NULL) { }
+};
+
+/**
+ * @private
+ *
+ * Something that expires on a TimerWheel. Entries are linked into the wheel intrusively, scheduling
+ * and canceling them doesn't allocate.
+ */
+class TimerWheelEntry : private TimerWheelLink, noncopyable {
+public:
+  /**
+   * @param thread_pool The threads the entry fires on.
+   */
+  TimerWheelEntry(AsyncThreadPool thread_pool = ASYNC_THREAD_POOL_DEFAULT)
+    : expiry_tick_(0), thread_pool_(thread_pool), wheel_(NULL), firing_(false), release_pending_(false) { }
+
+  /** Invoked once the entry expired, without the wheel's lock held; it may schedule the entry again. */
+  virtual void fire() = 0;
+
+  /** Invoked by TimerWheel::cancelAndRelease(), once the entry isn't firing anymore. */
+  virtual void release() = 0;
+
+  /** @return true once the entry is to be released, fire() must not touch its owner then. */
+  bool isReleasePending() const { return release_pending_; }
+
+  virtual ~TimerWheelEntry() { }
+
+private:
+  uint64_t expiry_tick_;
+  AsyncThreadPool thread_pool_;
+  TimerWheel *wheel_; // the wheel the entry was last scheduled on, NULL if never
+  bool firing_;
+  volatile bool release_pending_;
+  friend class TimerWheel;
+};
+
+/**
+ * @private
+ *
+ * A hierarchical timer wheel, there's one per thread and thread pool and it drives every timer scheduled
+ * from that thread off a single periodic continuation that only runs while the wheel has entries, on
+ * the threads of its pool. Scheduling
+ * and canceling are O(1); the resolution is TICK_MS, an entry fires no earlier than its delay and up to two
+ * ticks after it.
+ *
+ * The wheels are never destroyed, they live as long as their thread, which for Traffic Server's
+ * event threads is the life of the process.
+ */
+class TimerWheel : noncopyable {
+public:
+  static const int TICK_MS = 10;
+  static const int THREAD_POOL_COUNT = ASYNC_THREAD_POOL_CURRENT_THREAD + 1;
+
+  /**
+   * Schedules entry to fire after delay_ms, rescheduling it if it's scheduled already. An entry is scheduled
+   * on the wheel of the thread that scheduled it first, and stays there.
+   */
+  static void schedule(TimerWheelEntry &entry, int delay_ms);
+
+  /**
+   * Unschedules entry, wherever it was scheduled, and releases it, right away or once it's done firing
+   * on another thread.
+   */
+  static void cancelAndRelease(TimerWheelEntry &entry);
+
+private:
+  static const int LEVEL_0_BITS = 8;
+  static const int LEVEL_BITS = 6;
+  static const int LEVEL_COUNT = 4;
+  static const size_t LEVEL_0_SIZE = 1 << LEVEL_0_BITS;
+  static const size_t LEVEL_SIZE = 1 << LEVEL_BITS;
+
+  TimerWheel(AsyncThreadPool thread_pool);
+  static TimerWheel &getForCurrentThread(AsyncThreadPool thread_pool);
+  void startTick();
+  void link(TimerWheelEntry &entry);
+  void unlink(TimerWheelEntry &entry);
+  TimerWheelLink &getSlot(int level, size_t index) {
+    return level ? levels_[level - 1][index] : level_0_[index];
+  }
+  void cascade(int level);
+  void advance(uint64_t target_tick);
+  uint64_t getCurrentTimeTick() const;
+  static int handleTick(TSCont cont, TSEvent event, void *edata);
+
+  Mutex mutex_;
+  AsyncThreadPool thread_pool_;
+#ifdef ATSCPPAPI_HAVE_SCHEDULE_ON_THREAD
+  TSEventThread thread_; // of ASYNC_THREAD_POOL_CURRENT_THREAD, NULL if created outside an event thread
+#endif
+  TSCont tick_cont_;
+  TSAction tick_action_;
+  int64_t start_time_;
+  uint64_t current_tick_;
+  size_t entry_count_;
+  TimerWheelLink level_0_[LEVEL_0_SIZE];
+  TimerWheelLink levels_[LEVEL_COUNT - 1][LEVEL_SIZE];
+};
+
+}
+
+#endif /* ATSCPPAPI_TIMERWHEEL_H_ */
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TraceFetchSpan.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRACEFETCHSPAN_H_
+#define ATSCPPAPI_TRACEFETCHSPAN_H_
+
+#include <stdint.h>
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * The end of the span of a traced AsyncHttpFetch, shared between the fetch and the trace since either may
+ * go away first.
+ */
+struct TraceFetchSpan {
+  volatile int64_t end_time_; // 0 until the fetch completed.
+  TraceFetchSpan() : end_time_(0) { }
+};
+
+}
+
+#endif /* ATSCPPAPI_TRACEFETCHSPAN_H_ */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Arena.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief A bump allocator whose memory is released all at once.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ARENA_H_
+#define ATSCPPAPI_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+/**
+ * @brief Hands out memory by bumping a pointer through large blocks, and frees everything at once
+ * when it is destroyed.
+ *
+ * Every Transaction has an Arena, see Transaction::getArena(), which the library allocates the
+ * Transaction's own state from and which is released in one step when the transaction closes.
+ * Plugins can use it for their own per transaction data:
+ *
+ * @code
+ * MyData *data = transaction.getArena().create<MyData>(); // destroyed when the transaction closes
+ * char *copy = transaction.getArena().copy(value.data(), value.length());
+ * @endcode
+ *
+ * Objects made with create() are destroyed in the reverse order they were created in, memory from
+ * allocate() is simply released. An Arena is not thread safe.
+ */
+class Arena: noncopyable {
+public:
+  /** Alignment of every allocation. */
+  static const size_t ALIGNMENT = 16;
+
+  /** Size of the blocks memory is bumped through, the first one is part of the Arena itself. */
+  static const size_t BLOCK_SIZE = 4096;
+
+  Arena();
+
+  /**
+   * @return size bytes aligned to ALIGNMENT, valid until the Arena is destroyed.
+   */
+  void *allocate(size_t size);
+
+  /**
+   * @return A null terminated copy of the length bytes at data.
+   */
+  char *copy(const char *data, size_t length);
+
+  typedef void (*CleanupFunction)(void *data);
+
+  /**
+   * Calls function with data when the Arena is destroyed, in the reverse order of registration.
+   */
+  void addCleanup(CleanupFunction function, void *data);
+
+  /**
+   * Constructs an object in the Arena; its destructor runs when the Arena is destroyed.
+   */
+  template <typename T> T *create() {
+    T *object = new (allocate(sizeof(T))) T();
+    addCleanup(&destroy<T>, object);
+    return object;
+  }
+
+  /** @see create() */
+  template <typename T, typename A1> T *create(const A1 &a1) {
+    T *object = new (allocate(sizeof(T))) T(a1);
+    addCleanup(&destroy<T>, object);
+    return object;
+  }
+
+  /** @see create() */
+  template <typename T, typename A1, typename A2> T *create(const A1 &a1, const A2 &a2) {
+    T *object = new (allocate(sizeof(T))) T(a1, a2);
+    addCleanup(&destroy<T>, object);
+    return object;
+  }
+
+  /** @see create() */
+  template <typename T, typename A1, typename A2, typename A3> T *create(const A1 &a1, const A2 &a2, const A3 &a3) {
+    T *object = new (allocate(sizeof(T))) T(a1, a2, a3);
+    addCleanup(&destroy<T>, object);
+    return object;
+  }
+
+  /**
+   * Runs the cleanups and releases the memory, except the first block, so the Arena can be reused
+   * as if it were new.
+   */
+  void reset();
+
+  /**
+   * @return Number of bytes handed out so far.
+   */
+  size_t getBytesAllocated() const { return bytes_allocated_; }
+
+  /**
+   * @return Number of allocations made so far, including those of create(), copy() and addCleanup().
+   */
+  size_t getAllocationCount() const { return allocation_count_; }
+
+  /**
+   * @return Number of bytes taken from the heap for blocks beyond the first one.
+   */
+  size_t getBytesReserved() const { return bytes_reserved_; }
+
+  /**
+   * @brief Makes an Arena the current one of this thread while in scope, see getCurrent().
+   */
+  class Scope: noncopyable {
+  public:
+    Scope(Arena *arena);
+    ~Scope();
+  private:
+    Arena *previous_;
+  };
+
+  /**
+   * @return The Arena of the innermost Scope on this thread, NULL if there is none.
+   */
+  static Arena *getCurrent();
+
+  ~Arena();
+private:
+  struct Block {
+    Block *next_;
+  };
+  struct Cleanup {
+    CleanupFunction function_;
+    void *data_;
+    Cleanup *next_;
+  };
+  char *pos_;
+  char *end_;
+  Block *blocks_;
+  Cleanup *cleanups_;
+  size_t bytes_allocated_;
+  size_t allocation_count_;
+  size_t bytes_reserved_;
+  union {
+    char initial_block_[BLOCK_SIZE];
+    long double align_initial_block_; // keeps the first block aligned for ALIGNMENT
+  };
+  template <typename T> static void destroy(void *object) { static_cast<T *>(object)->~T(); }
+};
+
+/**
+ * @brief A standard library allocator drawing from an Arena, for containers with the
+ * lifetime of the Arena. Deallocation does nothing, the memory is reclaimed with the Arena.
+ */
+template <typename T> class ArenaAllocator {
+public:
+  typedef T value_type;
+  typedef T *pointer;
+  typedef const T *const_pointer;
+  typedef T &reference;
+  typedef const T &const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  template <typename U> struct rebind {
+    typedef ArenaAllocator<U> other;
+  };
+
+  explicit ArenaAllocator(Arena *arena) : arena_(arena) { }
+  template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.getArena()) { }
+
+  pointer address(reference value) const { return &value; }
+  const_pointer address(const_reference value) const { return &value; }
+  pointer allocate(size_type n, const void * = 0) { return static_cast<pointer>(arena_->allocate(n * sizeof(T))); }
+  void deallocate(pointer, size_type) { }
+  size_type max_size() const { return static_cast<size_type>(-1) / sizeof(T); }
+  void construct(pointer ptr, const T &value) { new (ptr) T(value); }
+  void destroy(pointer ptr) { ptr->~T(); }
+
+  Arena *getArena() const { return arena_; }
+private:
+  Arena *arena_;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.getArena() == rhs.getArena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) {
+  return lhs.getArena() != rhs.getArena();
+}
+
+}
+
+#endif /* ATSCPPAPI_ARENA_H_ */
@@ -20,7 +20,8 @@
 #pragma once
 #ifndef ATSCPPAPI_ASYNC_H_
 #define ATSCPPAPI_ASYNC_H_
-#include <list>
+#include <pthread.h>
+#include <sched.h>
 #include <atscppapi/Mutex.h>
 #include <atscppapi/noncopyable.h>
 #include <atscppapi/shared_ptr.h>
@@ -42,9 +43,26 @@ public:
    * @return True if the receiver was still alive.
    */
   virtual bool dispatch() = 0;
+
+  /**
+   * @return false if the receiver is known to be gone, providers can skip work nobody will receive then.
+   */
+  virtual bool isReceiverAlive() const { return true; }
+
   virtual ~AsyncDispatchControllerBase() { }
 };
 
+/**
+ * @brief The threads an async provider runs its events on, and so invokes its receiver on. Keeping
+ * periodic maintenance work off the threads that do network I/O avoids adding jitter to requests.
+ */
+enum AsyncThreadPool {
+  ASYNC_THREAD_POOL_DEFAULT = 0, /**< Traffic Server's default pool, the event threads doing network I/O. */
+  ASYNC_THREAD_POOL_TASK, /**< The task threads, meant for blocking or long running work. */
+  ASYNC_THREAD_POOL_CURRENT_THREAD /**< The calling event thread, e.g. that of the current transaction; the
+                                        default pool where Traffic Server can't schedule on a given thread. */
+};
+
 /**
  * @brief AsyncProvider is the interface that providers of async operations must implement. 
  * The system allows decoupling of the lifetime/scope of provider and receiver objects. The 
@@ -65,6 +83,124 @@ public:
   virtual ~AsyncProvider() { }
 };
 
+/**
+ * @private
+ *
+ * @brief The part of a dispatch controller that doesn't depend on the types of receiver and provider.
+ *
+ * A controller is allocated once per async operation and reference counted intrusively: the receiver
+ * holds one reference while it's alive and all copies of the shared_ptr the provider got hold one more.
+ * Once the receiver is gone the controller is canceled, which dispatch() checks without taking a lock.
+ * Without a mutex, dispatches and the cancellation are serialized with an atomic state instead.
+ */
+class AsyncDispatchControllerLink : public AsyncDispatchControllerBase {
+public:
+  void unref() {
+    if (__sync_sub_and_fetch(&ref_count_, 1) == 0) {
+      delete this;
+    }
+  }
+
+  /** @return true if the provider has dropped it, only the receiver's reference is left then. */
+  bool isProviderDone() const {
+    return __sync_fetch_and_add(const_cast<volatile int *>(&ref_count_), 0) == 1;
+  }
+
+  /** Invoked as the receiver dies, no dispatch is in progress on another thread once this returns. */
+  void cancel() {
+    if (dispatch_mutex_.get()) {
+      ScopedSharedMutexLock scopedLock(dispatch_mutex_);
+      __sync_lock_test_and_set(&state_, STATE_CANCELED);
+      return;
+    }
+    while (true) {
+      int state = __sync_val_compare_and_swap(&state_, STATE_IDLE, STATE_CANCELED);
+      if (state != STATE_DISPATCHING) {
+        return;
+      }
+      if (pthread_equal(dispatching_thread_, pthread_self())) { // the receiver is deleted from its callback
+        __sync_lock_test_and_set(&state_, STATE_CANCELED);
+        return;
+      }
+      sched_yield();
+    }
+  }
+
+  bool isReceiverAlive() const { return !isCanceled(); }
+
+  /**
+   * Links a controller into the list of a receiver, controllers of completed operations are unlinked on the way.
+   */
+  static void link(AsyncDispatchControllerLink *&head, AsyncDispatchControllerLink *controller) {
+    for (AsyncDispatchControllerLink **iter = &head; *iter;) {
+      AsyncDispatchControllerLink *current = *iter;
+      if (current->isProviderDone()) {
+        *iter = current->next_;
+        current->unref();
+      } else {
+        iter = &current->next_;
+      }
+    }
+    controller->next_ = head;
+    head = controller;
+  }
+
+  /** Cancels and drops all controllers of a dying receiver. */
+  static void unlinkAll(AsyncDispatchControllerLink *&head) {
+    while (head) {
+      AsyncDispatchControllerLink *current = head;
+      head = current->next_;
+      current->cancel();
+      current->unref();
+    }
+  }
+
+  /** Used as the deleter of the shared_ptr handed to the provider. */
+  struct Release {
+    void operator()(AsyncDispatchControllerBase *controller) const {
+      static_cast<AsyncDispatchControllerLink *>(controller)->unref();
+    }
+  };
+
+protected:
+  AsyncDispatchControllerLink(shared_ptr<Mutex> mutex)
+    : dispatch_mutex_(mutex), ref_count_(2), state_(STATE_IDLE), next_(NULL) { }
+
+  bool isCanceled() const {
+    return __sync_fetch_and_add(const_cast<volatile int *>(&state_), 0) == STATE_CANCELED;
+  }
+
+  /** Without a mutex: @return false if canceled, otherwise the receiver stays alive until endDispatch(). */
+  bool beginDispatch() {
+    while (true) {
+      int state = __sync_val_compare_and_swap(&state_, STATE_IDLE, STATE_DISPATCHING);
+      if (state == STATE_IDLE) {
+        dispatching_thread_ = pthread_self();
+        return true;
+      }
+      if (state == STATE_CANCELED) {
+        return false;
+      }
+      sched_yield(); // another thread dispatches the same operation
+    }
+  }
+
+  void endDispatch() {
+    __sync_val_compare_and_swap(&state_, STATE_DISPATCHING, STATE_IDLE); // stays canceled if that happened meanwhile
+  }
+
+  virtual ~AsyncDispatchControllerLink() { }
+
+  shared_ptr<Mutex> dispatch_mutex_;
+
+private:
+  enum { STATE_IDLE = 0, STATE_DISPATCHING, STATE_CANCELED };
+  volatile int ref_count_;
+  volatile int state_;
+  pthread_t dispatching_thread_;
+  AsyncDispatchControllerLink *next_;
+};
+
 /**
  * @private
  *
@@ -72,16 +208,26 @@ public:
  * receiver is still alive, locks the mutex and then invokes handleAsyncComplete().
  */
 template<typename AsyncEventReceiverType, typename AsyncProviderType>
-class AsyncDispatchController : public AsyncDispatchControllerBase {
+class AsyncDispatchController : public AsyncDispatchControllerLink {
 public:
   bool dispatch() {
-    bool ret = false;
-    ScopedSharedMutexLock scopedLock(dispatch_mutex_);
-    if (event_receiver_) {
+    if (isCanceled()) {
+      return false;
+    }
+    if (dispatch_mutex_.get()) {
+      ScopedSharedMutexLock scopedLock(dispatch_mutex_);
+      if (isCanceled()) {
+        return false;
+      }
       event_receiver_->handleAsyncComplete(static_cast<AsyncProviderType &>(*provider_));
-      ret = true;
+      return true;
+    }
+    if (!beginDispatch()) {
+      return false;
     }
-    return ret;
+    event_receiver_->handleAsyncComplete(static_cast<AsyncProviderType &>(*provider_));
+    endDispatch();
+    return true;
   }
 
   /**
@@ -89,41 +235,17 @@ public:
    *
    * @param event_receiver The async complete event will be dispatched to this receiver.
    * @param provider Async operation provider that is passed to the receiver on dispatch.
-   * @param mutex Mutex of the receiver that is locked during the dispatch
+   * @param mutex Mutex of the receiver that is locked during the dispatch, may be NULL.
    */
   AsyncDispatchController(AsyncEventReceiverType *event_receiver, AsyncProviderType *provider, shared_ptr<Mutex> mutex) :
-    event_receiver_(event_receiver), dispatch_mutex_(mutex), provider_(provider) {
+    AsyncDispatchControllerLink(mutex), event_receiver_(event_receiver), provider_(provider) {
   }
 
-  virtual ~AsyncDispatchController() { }
-public:
-  AsyncEventReceiverType *event_receiver_;
-  shared_ptr<Mutex> dispatch_mutex_;
 private:
+  AsyncEventReceiverType *event_receiver_;
   AsyncProviderType *provider_;
 };
 
-/**
- * @private
- * 
- * @brief A promise is used to let the dispatch controller know if the receiver is still
- * alive to receive the async complete dispatch. When the receiver dies, this promise is
- * broken and it automatically updates the dispatch controller.
- */
-template<typename AsyncEventReceiverType, typename AsyncProviderType>
-class AsyncReceiverPromise : noncopyable {
-public:
-  AsyncReceiverPromise(shared_ptr<AsyncDispatchController<AsyncEventReceiverType, AsyncProviderType> > dispatch_controller) :
-    dispatch_controller_(dispatch_controller) { }
-
-  ~AsyncReceiverPromise() {
-    ScopedSharedMutexLock scopedLock(dispatch_controller_->dispatch_mutex_);
-    dispatch_controller_->event_receiver_ = NULL;
-  }
-protected:
-  shared_ptr<AsyncDispatchController<AsyncEventReceiverType, AsyncProviderType> > dispatch_controller_;
-};
-
 /**
  * @brief AsyncReceiver is the interface that receivers of async operations must implement. It is
  * templated on the type of the async operation provider.
@@ -139,12 +261,14 @@ public:
    * @param provider A reference to the provider which completed the async operation.
    */
   virtual void handleAsyncComplete(AsyncProviderType &provider) = 0;
-  virtual ~AsyncReceiver() { }
+  virtual ~AsyncReceiver() {
+    AsyncDispatchControllerLink::unlinkAll(dispatch_controllers_); // now if the event receiver dies, we're safe.
+  }
 protected:
-  AsyncReceiver() { }
+  AsyncReceiver() : dispatch_controllers_(NULL) { }
   friend class Async;
 private:
-  mutable std::list<shared_ptr<AsyncReceiverPromise<AsyncReceiver<AsyncProviderType>, AsyncProviderType> > > receiver_promises_;
+  mutable AsyncDispatchControllerLink *dispatch_controllers_;
 };
 
 /**
@@ -159,21 +283,16 @@ public:
    * @param event_receiver The receiver of the async complete dispatch.
    * @param provider The provider of the async operation.
    * @param mutex The mutex that is locked during the dispatch of the async event complete.
-   *              One will be created if nothing is passed in. Transaction plugins should use 
-   *              TransactionPlugin::getMutex() here and global plugins can pass an appropriate
-   *              or NULL mutex.
+   *              Transaction plugins should use TransactionPlugin::getMutex() here and global
+   *              plugins can pass an appropriate or NULL mutex. Without one, dispatches of the
+   *              operation still never overlap each other or the destruction of the receiver.
    */
   template<typename AsyncProviderType>
   static void execute(AsyncReceiver<AsyncProviderType> *event_receiver, AsyncProviderType *provider, shared_ptr<Mutex> mutex) {
-    if (!mutex.get()) {
-      mutex.reset(new Mutex(Mutex::TYPE_RECURSIVE));
-    }
-    shared_ptr<AsyncDispatchController<AsyncReceiver<AsyncProviderType>, AsyncProviderType > > dispatcher(
-      new AsyncDispatchController<AsyncReceiver<AsyncProviderType>, AsyncProviderType >(event_receiver, provider, mutex));
-    shared_ptr<AsyncReceiverPromise<AsyncReceiver<AsyncProviderType>, AsyncProviderType > > receiver_promise(
-      new AsyncReceiverPromise<AsyncReceiver<AsyncProviderType>, AsyncProviderType >(dispatcher));
-    event_receiver->receiver_promises_.push_back(receiver_promise); // now if the event receiver dies, we're safe.
-    provider->run(dispatcher);
+    AsyncDispatchController<AsyncReceiver<AsyncProviderType>, AsyncProviderType> *dispatcher =
+      new AsyncDispatchController<AsyncReceiver<AsyncProviderType>, AsyncProviderType>(event_receiver, provider, mutex);
+    AsyncDispatchControllerLink::link(event_receiver->dispatch_controllers_, dispatcher);
+    provider->run(shared_ptr<AsyncDispatchControllerBase>(dispatcher, AsyncDispatchControllerLink::Release()));
   }
 };
 
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncCoroutine.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief C++20 coroutine support for async operations, only available when compiling as C++20.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ASYNCCOROUTINE_H_
+#define ATSCPPAPI_ASYNCCOROUTINE_H_
+
+#if __cplusplus >= 202002L
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <atscppapi/Arena.h>
+#include <atscppapi/Async.h>
+#include <atscppapi/AsyncTimer.h>
+#include <atscppapi/Transaction.h>
+
+namespace atscppapi {
+
+/**
+ * @brief The return type of a coroutine that handles a transaction, e.g. a TransactionPlugin hook that
+ * has to make a fetch before it can resume the transaction:
+ *
+ * @code
+ * TransactionTask lookupUser(Transaction &transaction) {
+ *   AsyncHttpFetch &fetch = co_await awaitAsync(new AsyncHttpFetch("http://users/lookup"), getMutex());
+ *   if (fetch.getResult() == AsyncHttpFetch::RESULT_SUCCESS) {
+ *     transaction.getClientRequest().getHeaders().set("X-User", fetch.getResponse().getHeaders().getJoinedValues("X-User"));
+ *   }
+ *   transaction.resume();
+ * }
+ *
+ * void handleReadRequestHeadersPostRemap(Transaction &transaction) {
+ *   lookupUser(transaction);
+ * }
+ * @endcode
+ *
+ * The coroutine starts right away and nobody waits for it. Its frame is allocated from the Arena of the first
+ * Transaction among its arguments, or the heap if there's none; it must finish before that transaction closes,
+ * which it does as long as it resumes the transaction last.
+ */
+class TransactionTask {
+public:
+  struct promise_type {
+    TransactionTask get_return_object() noexcept { return TransactionTask(); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept { }
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    template <typename... Args> static void *operator new(size_t size, Args &... args) {
+      Transaction *transaction = findTransaction(args...);
+      FrameHeader *header = static_cast<FrameHeader *>(
+        transaction ? transaction->getArena().allocate(sizeof(FrameHeader) + size) :
+                      ::operator new(sizeof(FrameHeader) + size));
+      header->from_arena_ = (transaction != NULL);
+      return header + 1;
+    }
+
+    static void operator delete(void *frame) noexcept {
+      FrameHeader *header = static_cast<FrameHeader *>(frame) - 1;
+      if (!header->from_arena_) {
+        ::operator delete(header);
+      } // the arena releases it with the transaction
+    }
+
+  private:
+    struct alignas(Arena::ALIGNMENT) FrameHeader {
+      bool from_arena_;
+    };
+
+    static Transaction *findTransaction() { return NULL; }
+
+    template <typename... Args> static Transaction *findTransaction(Transaction &transaction, Args &...) {
+      return &transaction;
+    }
+
+    template <typename T, typename... Args> static Transaction *findTransaction(T &, Args &... args) {
+      return findTransaction(args...);
+    }
+  };
+};
+
+/**
+ * @brief Makes an async operation awaitable: the coroutine is suspended until the provider dispatches
+ * and then resumed with a reference to the provider, which is valid until the next suspension. It takes
+ * the place of the AsyncReceiver, see awaitAsync().
+ *
+ * The awaitable itself is the dispatch controller, it lives in the coroutine frame and no promise is made,
+ * so providers that dispatch more than once, e.g. streaming fetches and periodic timers, can't be awaited.
+ */
+template <typename AsyncProviderType> class AsyncAwaitable : private AsyncDispatchControllerBase {
+public:
+  AsyncAwaitable(AsyncProviderType *provider, shared_ptr<Mutex> mutex) : provider_(provider), mutex_(mutex) { }
+
+  bool await_ready() const noexcept { return false; }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    handle_ = handle;
+    // we may be resumed, and gone, before run() returns
+    provider_->run(shared_ptr<AsyncDispatchControllerBase>(static_cast<AsyncDispatchControllerBase *>(this),
+                                                           KeepAlive()));
+  }
+
+  AsyncProviderType &await_resume() noexcept { return *provider_; }
+
+private:
+  struct KeepAlive {
+    void operator()(AsyncDispatchControllerBase *) const { } // owned by the coroutine frame
+  };
+
+  bool dispatch() {
+    if (mutex_.get()) {
+      ScopedSharedMutexLock scopedLock(mutex_);
+      handle_.resume();
+    } else {
+      handle_.resume();
+    }
+    return true;
+  }
+
+  AsyncProviderType *provider_;
+  shared_ptr<Mutex> mutex_;
+  std::coroutine_handle<> handle_;
+};
+
+/**
+ * @return An awaitable for an async operation whose provider self-destructs, like AsyncHttpFetch; the
+ *         coroutine is resumed with mutex locked, see Async::execute().
+ */
+template <typename AsyncProviderType>
+AsyncAwaitable<AsyncProviderType> awaitAsync(AsyncProviderType *provider, shared_ptr<Mutex> mutex) {
+  return AsyncAwaitable<AsyncProviderType>(provider, mutex);
+}
+
+/**
+ * @brief Suspends a coroutine for a while with a one-off AsyncTimer, which lives in the coroutine frame.
+ */
+class AsyncTimerAwaitable {
+public:
+  AsyncTimerAwaitable(int period_in_ms, shared_ptr<Mutex> mutex, AsyncThreadPool thread_pool)
+    : timer_(AsyncTimer::TYPE_ONE_OFF, period_in_ms, 0, thread_pool), awaitable_(&timer_, mutex) { }
+
+  bool await_ready() const noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> handle) { awaitable_.await_suspend(handle); }
+  void await_resume() noexcept { }
+
+private:
+  AsyncTimer timer_;
+  AsyncAwaitable<AsyncTimer> awaitable_;
+};
+
+/**
+ * @return An awaitable that resumes the coroutine after period_in_ms, with mutex locked.
+ */
+inline AsyncTimerAwaitable awaitTimer(int period_in_ms, shared_ptr<Mutex> mutex,
+                                      AsyncThreadPool thread_pool = ASYNC_THREAD_POOL_DEFAULT) {
+  return AsyncTimerAwaitable(period_in_ms, mutex, thread_pool);
+}
+
+} /* atscppapi */
+
+#endif /* __cplusplus >= 202002L */
+
+#endif /* ATSCPPAPI_ASYNCCOROUTINE_H_ */
@@ -21,6 +21,7 @@
 #define ATSCPPAPI_ASYNCHTTPFETCH_H_
 
 #include <string>
+#include <sys/socket.h>
 #include <atscppapi/shared_ptr.h>
 #include <atscppapi/Async.h>
 #include <atscppapi/Request.h>
@@ -30,6 +31,7 @@ namespace atscppapi {
 
 // forward declarations
 class AsyncHttpFetchState;
+struct TraceFetchSpan;
 namespace utils { class internal; }
 
 /**
@@ -37,12 +39,54 @@ namespace utils { class internal; }
  * makes HTTP requests asynchronously. This provider automatically
  * self-destructs after the completion of the request.
  *
+ * In streaming mode the receiver is invoked several times: once the response headers are parsed
+ * (RESULT_HEADER_COMPLETE), for every chunk of the body as it arrives (RESULT_PARTIAL_BODY) and once
+ * the body is complete (RESULT_BODY_COMPLETE), or with RESULT_TIMEOUT/RESULT_FAILURE. A receiver that
+ * can't take more of the body right now, e.g. as the client connection is backed up, can pauseBody() and
+ * resumeBody() later.
+ *
  * See example async_http_fetch for sample usage.
  */
 class AsyncHttpFetch : public AsyncProvider {
 public:
   AsyncHttpFetch(const std::string &url_str, HttpMethod http_method = HTTP_METHOD_GET);
 
+  enum StreamingFlag {
+    STREAMING_DISABLED = 0, /**< The receiver is invoked once, with the complete response. */
+    STREAMING_ENABLED /**< The receiver is invoked for the headers and every body chunk. */
+  };
+
+  /**
+   * @param streaming_flag STREAMING_ENABLED to receive the response as it arrives, see StreamingFlag.
+   */
+  AsyncHttpFetch(const std::string &url_str, StreamingFlag streaming_flag, HttpMethod http_method = HTTP_METHOD_GET);
+
+  /**
+   * @brief How a fetch is made, the defaults are those of the other constructors.
+   */
+  struct Options {
+    StreamingFlag streaming_flag_; /**< STREAMING_DISABLED by default */
+    HttpVersion http_version_; /**< HTTP_VERSION_1_0 by default, HTTP_VERSION_1_1 allows the connection to the origin
+                                    to be kept alive; streaming fetches always use HTTP_VERSION_1_1 */
+    /**
+     * The address the fetch comes from, i.e. the client address of the internal transaction Traffic Server
+     * makes for it, 127.0.0.1:8080 if NULL. The address is copied when the fetch is constructed. Which server
+     * is fetched from follows from the url, an ip address as host saves the DNS lookup.
+     */
+    const sockaddr *client_address_;
+    int timeout_ms_; /**< Milliseconds until the fetch completes with RESULT_TIMEOUT, 0 (the default) for none */
+    /**
+     * false by default. A passthrough fetch skips the hooks of every GlobalPlugin, including those that don't
+     * ignore internal transactions, so no Transaction is created for its internal transaction. Remap plugins
+     * still run as they decide where the fetch goes.
+     */
+    bool passthrough_;
+    Options() : streaming_flag_(STREAMING_DISABLED), http_version_(HTTP_VERSION_1_0), client_address_(NULL),
+                timeout_ms_(0), passthrough_(false) { }
+  };
+
+  AsyncHttpFetch(const std::string &url_str, const Options &options, HttpMethod http_method = HTTP_METHOD_GET);
+
   /**
    * Used to manipulate the headers of the request to be made.
    *
@@ -50,7 +94,24 @@ public:
    */
   Headers &getRequestHeaders();
 
-  enum Result { RESULT_SUCCESS = 10000, RESULT_TIMEOUT, RESULT_FAILURE };
+  /**
+   * Sets the body of the request to be made, a Content-Length header is added unless one was set.
+   *
+   * @param body The body, which isn't copied; it has to stay valid until the fetch is started by Async::execute().
+   * @param body_size Number of bytes of body.
+   */
+  void setRequestBody(const void *body, size_t body_size);
+
+  /**
+   * Sets the body of the request to be made to everything available on reader when the fetch is started, that
+   * is then consumed. A Content-Length header is added unless one was set.
+   *
+   * @param reader a TSIOBufferReader, e.g. of a buffered client request body.
+   */
+  void setRequestBodyReader(void *reader);
+
+  enum Result { RESULT_SUCCESS = 10000, RESULT_TIMEOUT, RESULT_FAILURE, RESULT_HEADER_COMPLETE,
+                RESULT_PARTIAL_BODY, RESULT_BODY_COMPLETE };
 
   /**
    * Used to extract the response after request completion. 
@@ -75,12 +136,28 @@ public:
    * Used to extract the body of the response after request completion. On
    * unsuccessful completion, values (NULL, 0) are set.
    *
+   * In streaming mode this is the chunk of the body that arrived since the previous invocation of the
+   * receiver, it is only valid until the receiver returns.
+   *
    * @param body Output argument; will point to the body
    * @param body_size Output argument; will contain the size of the body 
    * 
    */
   void getResponseBody(const void *&body, size_t &body_size) const;
 
+  /**
+   * Streaming mode only: stops reading the body, the receiver isn't invoked with RESULT_PARTIAL_BODY until
+   * resumeBody(). What keeps arriving is buffered by Traffic Server's fetch.
+   *
+   * \note The fetch doesn't complete while paused, a paused fetch must always be resumed.
+   */
+  void pauseBody();
+
+  /**
+   * Streaming mode only: reads the body again, may be called from any thread.
+   */
+  void resumeBody();
+
   virtual ~AsyncHttpFetch();
 
   /**
@@ -89,6 +166,11 @@ public:
   virtual void run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller);
 
 private:
+  void runStreaming();
+  /** Hands the parsed response headers over to the caller, which has to release them, see AsyncHttpFetchGroup. */
+  void releaseResponseHeaders(void *&hdr_buf, void *&hdr_loc);
+  /** The span ends when the fetch completes, see TransactionTrace::traceFetch(). */
+  void setTraceSpan(const shared_ptr<TraceFetchSpan> &span);
   AsyncHttpFetchState *state_;
   friend class utils::internal;
 };
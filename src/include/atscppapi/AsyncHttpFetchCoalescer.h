@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncHttpFetchCoalescer.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ASYNCHTTPFETCHCOALESCER_H_
+#define ATSCPPAPI_ASYNCHTTPFETCHCOALESCER_H_
+
+#include <string>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/shared_ptr.h>
+#include <atscppapi/AsyncHttpFetch.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct AsyncHttpFetchCoalescerState;
+struct CoalescedHttpFetchState;
+struct CoalescedFetchResult;
+class CoalescedHttpFetch;
+
+/**
+ * @brief Shares identical fetches: while a fetch is in flight, further fetches with the same method, URL
+ * and key headers wait for its result instead of making their own request. Optionally the result of a
+ * successful fetch is kept for a few seconds and served to the fetches issued meanwhile.
+ *
+ * A coalescer is meant to be shared by every Transaction, it is thread safe and it must outlive all of
+ * its fetches, usually it's created in TSPluginInit() and never destroyed. Only fetches that can be
+ * shared, i.e. idempotent requests whose response doesn't depend on other request headers than the key
+ * headers, should go through it.
+ *
+ * \code
+ * AsyncHttpFetchCoalescer *coalescer = new AsyncHttpFetchCoalescer(2000);
+ * coalescer->addKeyHeader("Accept-Language");
+ *
+ * CoalescedHttpFetch *fetch = new CoalescedHttpFetch(*coalescer, "http://backend/config");
+ * fetch->getRequestHeaders().set("Accept-Language", language);
+ * Async::execute<CoalescedHttpFetch>(this, fetch, getMutex());
+ * \endcode
+ */
+class AsyncHttpFetchCoalescer : noncopyable {
+public:
+  /**
+   * @param cache_ttl_ms Milliseconds a successful result is served for, 0 (the default) only shares
+   *                     fetches that are in flight.
+   * @param fetch_options How the shared fetches are made, they can't stream.
+   */
+  AsyncHttpFetchCoalescer(int cache_ttl_ms = 0, const AsyncHttpFetch::Options &fetch_options = AsyncHttpFetch::Options());
+
+  /**
+   * Adds a request header whose values are part of the key, fetches that differ in it aren't shared.
+   * Must be called before any fetch is made.
+   */
+  void addKeyHeader(const std::string &name);
+
+  /** Drops all cached results, fetches in flight aren't affected. */
+  void clearCache();
+
+  ~AsyncHttpFetchCoalescer();
+private:
+  AsyncHttpFetchCoalescerState *state_;
+  friend class CoalescedHttpFetch;
+  friend struct CoalescedHttpFetchState;
+};
+
+/**
+ * @brief An AsyncProvider like AsyncHttpFetch, for fetches that go through an AsyncHttpFetchCoalescer.
+ * This provider automatically self-destructs after the completion of the request.
+ *
+ * The response, and its body, are shared by all receivers of a fetch and must not be modified.
+ */
+class CoalescedHttpFetch : public AsyncProvider {
+public:
+  CoalescedHttpFetch(AsyncHttpFetchCoalescer &coalescer, const std::string &url_str,
+                     HttpMethod http_method = HTTP_METHOD_GET);
+
+  /**
+   * Used to manipulate the headers of the request to be made, only those of the fetch that ends up
+   * making the request are sent.
+   */
+  Headers &getRequestHeaders();
+
+  /** @return Result of the operation, see AsyncHttpFetch::getResult(). */
+  AsyncHttpFetch::Result getResult() const;
+
+  /** @return Non-mutable reference to the request URL. */
+  const Url &getRequestUrl() const;
+
+  /** @return Non-mutable reference to the response, shared with the other receivers. */
+  const Response &getResponse() const;
+
+  /**
+   * The body of the response, (NULL, 0) on an unsuccessful completion. It's valid until the receiver returns.
+   */
+  void getResponseBody(const void *&body, size_t &body_size) const;
+
+  /** @return true if the result came from another fetch in flight or the cache, rather than our own request. */
+  bool isShared() const;
+
+  virtual ~CoalescedHttpFetch();
+
+  /**
+   * Serves the fetch from the cache, joins an identical one in flight or makes the request.
+   */
+  virtual void run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller);
+
+private:
+  void complete(shared_ptr<CoalescedFetchResult> result, bool shared);
+  CoalescedHttpFetchState *state_;
+  friend struct AsyncHttpFetchCoalescerState;
+  friend struct CoalescedHttpFetchState;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_ASYNCHTTPFETCHCOALESCER_H_ */
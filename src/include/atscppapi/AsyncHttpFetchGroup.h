@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncHttpFetchGroup.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ASYNCHTTPFETCHGROUP_H_
+#define ATSCPPAPI_ASYNCHTTPFETCHGROUP_H_
+
+#include <atscppapi/AsyncHttpFetch.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct AsyncHttpFetchGroupState;
+
+/**
+ * @brief An AsyncProvider that makes several HTTP requests in parallel and invokes the receiver once,
+ * when as many of them have completed as its CompletionMode asks for. The results of all members are
+ * available to the receiver, members that haven't completed by then have RESULT_TIMEOUT if the deadline
+ * expired and RESULT_FAILURE otherwise; their late results are dropped.
+ *
+ * The members don't go through Async::execute() each, there is one dispatch to the receiver and one lock
+ * of its mutex for the whole group. Like AsyncHttpFetch, the group self-destructs once it has dispatched
+ * and all members have completed.
+ *
+ * @code
+ * AsyncHttpFetchGroup *group = new AsyncHttpFetchGroup(AsyncHttpFetchGroup::COMPLETION_QUORUM, 2, 50);
+ * group->addFetch(new AsyncHttpFetch("http://backend-a/item"));
+ * group->addFetch(new AsyncHttpFetch("http://backend-b/item"));
+ * group->addFetch(new AsyncHttpFetch("http://backend-c/item"));
+ * Async::execute<AsyncHttpFetchGroup>(this, group, getMutex());
+ * @endcode
+ */
+class AsyncHttpFetchGroup : public AsyncProvider {
+public:
+  enum CompletionMode {
+    COMPLETION_ALL = 0, /**< Completes once every member has, successful if all of them succeeded. */
+    COMPLETION_ANY, /**< Completes with the first member that succeeds, or once all of them have failed. */
+    COMPLETION_QUORUM, /**< Completes once quorum members succeeded, or once that can't happen anymore. */
+    COMPLETION_DEADLINE /**< Completes once every member has or when the deadline expires, whichever comes first;
+                             the result is successful if at least one member succeeded. */
+  };
+
+  /**
+   * @param mode When the receiver is invoked, see CompletionMode.
+   * @param quorum Number of members that have to succeed, COMPLETION_QUORUM only.
+   * @param deadline_ms Milliseconds after run() at which the group completes with what it has, in any mode.
+   *                    0 (the default) means no deadline; the members' own timeouts still apply, see
+   *                    AsyncHttpFetch::Options.
+   */
+  AsyncHttpFetchGroup(CompletionMode mode = COMPLETION_ALL, size_t quorum = 0, int deadline_ms = 0);
+
+  /**
+   * Adds a member to the group, all members are started by run().
+   *
+   * @param fetch A non-streaming fetch, the group takes ownership of it.
+   * @return Index of the member, used with the accessors below.
+   */
+  size_t addFetch(AsyncHttpFetch *fetch);
+
+  /** @return Number of members. */
+  size_t getMemberCount() const;
+
+  /**
+   * @return RESULT_SUCCESS if the condition of the CompletionMode was met, RESULT_TIMEOUT if the deadline
+   *         expired before and RESULT_FAILURE otherwise.
+   */
+  AsyncHttpFetch::Result getResult() const;
+
+  /** @return Number of members that succeeded before the group completed. */
+  size_t getSuccessCount() const;
+
+  /** @return Result of the member with index member, see AsyncHttpFetch::getResult(). */
+  AsyncHttpFetch::Result getMemberResult(size_t member) const;
+
+  /** @return The request URL of the member with index member. */
+  const std::string &getMemberRequestUrl(size_t member) const;
+
+  /** @return The response of the member with index member, only meaningful if it succeeded. */
+  const Response &getMemberResponse(size_t member) const;
+
+  /**
+   * The body of the response of the member with index member, (NULL, 0) unless it succeeded. It stays
+   * valid for the lifetime of the group, i.e. until the receiver returns.
+   */
+  void getMemberResponseBody(size_t member, const void *&body, size_t &body_size) const;
+
+  virtual ~AsyncHttpFetchGroup();
+
+  /**
+   * Starts all members.
+   */
+  virtual void run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller);
+
+private:
+  AsyncHttpFetchGroupState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_ASYNCHTTPFETCHGROUP_H_ */
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file AsyncTask.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ASYNCTASK_H_
+#define ATSCPPAPI_ASYNCTASK_H_
+
+#include <atscppapi/shared_ptr.h>
+#include <atscppapi/Async.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct AsyncTaskState;
+namespace utils { class internal; }
+
+/**
+ * @brief An AsyncProvider that runs blocking or CPU heavy work, e.g. verifying a signature or resizing an
+ * image, off the event threads that do network I/O. Subclasses implement execute(), which runs on a task
+ * thread, and keep its result in members for the receiver. This provider automatically self-destructs after
+ * the receiver was invoked; the work is skipped if the receiver is gone by the time a thread is free for it.
+ *
+ * The task threads are Traffic Server's, see proxy.config.task_threads; their number bounds how much work
+ * runs at once, the rest is queued.
+ *
+ * @code
+ * class VerifyToken : public AsyncTask {
+ * public:
+ *   VerifyToken(const std::string &token) : token_(token), valid_(false) { }
+ *   void execute() { valid_ = verifySignature(token_); }
+ *   std::string token_;
+ *   bool valid_;
+ * };
+ *
+ * Async::execute<VerifyToken>(this, new VerifyToken(token), getMutex());
+ * ...
+ * void handleAsyncComplete(VerifyToken &task) {
+ *   if (task.valid_) ...
+ * }
+ * @endcode
+ */
+class AsyncTask : public AsyncProvider {
+public:
+  /**
+   * @param thread_pool The threads execute() runs on, ASYNC_THREAD_POOL_TASK unless the work is short.
+   */
+  AsyncTask(AsyncThreadPool thread_pool = ASYNC_THREAD_POOL_TASK);
+
+  /**
+   * The work, the receiver is invoked once it returned. It runs without any mutex held, it must not touch
+   * the Transaction.
+   */
+  virtual void execute() = 0;
+
+  virtual ~AsyncTask();
+
+  /**
+   * Queues the task on its thread pool.
+   */
+  virtual void run(shared_ptr<AsyncDispatchControllerBase> dispatch_controller);
+
+private:
+  AsyncTaskState *state_;
+  friend class utils::internal;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_ASYNCTASK_H_ */
@@ -39,6 +39,9 @@ class AsyncTimerState;
  * 
  * For either type, user must delete the timer.
  *
+ * All timers started on a thread for the same thread pool are driven by one periodic tick, with a
+ * resolution of 10ms; starting and canceling a timer doesn't schedule or cancel a Traffic Server event.
+ *
  * See example async_timer for sample usage.
  */
 class AsyncTimer : public AsyncProvider {
@@ -55,8 +58,10 @@ public:
    *                             events will have "regular" cadence. This is useful if the timer is
    *                             set for a long period of time (1hr etc.), but an initial event is
    *                             required. Value of 0 (default) indicates no initial event is desired.
+   * @param thread_pool The threads the receiver is invoked on, see AsyncThreadPool.
    */
-  AsyncTimer(Type type, int period_in_ms, int initial_period_in_ms = 0);
+  AsyncTimer(Type type, int period_in_ms, int initial_period_in_ms = 0,
+             AsyncThreadPool thread_pool = ASYNC_THREAD_POOL_DEFAULT);
 
   ~AsyncTimer();
 
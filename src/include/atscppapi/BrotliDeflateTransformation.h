@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliDeflateTransformation.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Brotli Deflate Transformation can be used to brotli compress content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BROTLIDEFLATETRANSFORMATION_H_
+#define ATSCPPAPI_BROTLIDEFLATETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Brotli Deflate Transformations
+ * @private
+ */
+class BrotliDeflateTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add brotli compression to your TransformationPlugin chain.
+ *
+ * BrotliDeflateTransformation has the same interface as GzipDeflateTransformation, it is only built
+ * when brotli is found by configure.
+ *
+ * @note BrotliDeflateTransformation DOES NOT set Content-Encoding headers, it is the
+ * users responsibility to set any applicable headers.
+ *
+ * @see BrotliInflateTransformation
+ * @see GzipDeflateTransformation
+ */
+class BrotliDeflateTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief Tunable parameters for a BrotliDeflateTransformation.
+   *
+   * See BrotliEncoderSetParameter() in brotli/encode.h for the valid range of quality_ and window_bits_.
+   */
+  struct Options {
+    int quality_; /**< Compression quality 0-11, defaults to 5 which is a good tradeoff for dynamic content */
+    int window_bits_; /**< Base 2 logarithm of the sliding window size 10-24, defaults to 22 */
+    bool flush_every_chunk_; /**< Flush output downstream after every chunk of input, defaults to true */
+    size_t output_buffer_size_; /**< Size of the reusable output buffer, defaults to 16KB */
+
+    Options();
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type because the BrotliDeflateTransformation can be used with both requests and responses
+   *  you must specify the Type.
+   *
+   * @see TransformationPlugin::Type
+   */
+  BrotliDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of transformation.
+   * @param options the compression parameters to use.
+   */
+  BrotliDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
+  /**
+   * Constructs a BrotliDeflateTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @see TransformationChain
+   */
+  BrotliDeflateTransformation(Transaction &transaction, TransformationChain &chain);
+
+  /**
+   * Constructs a BrotliDeflateTransformation stage of chain with the specified compression parameters.
+   *
+   * @see TransformationChain
+   */
+  BrotliDeflateTransformation(Transaction &transaction, TransformationChain &chain, const Options &options);
+
+  /**
+   * Compresses data and produces the compressed output.
+   *
+   * @param data the input data to compress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * The zero copy variant of consume(), each block of data in the InputBuffer is
+   * handed to brotli directly.
+   *
+   * @param input the input data to compress
+   */
+  void consume(InputBuffer &input);
+
+  /**
+   * Finishes the compressed stream and flushes any remaining output.
+   */
+  void handleInputComplete();
+
+  virtual ~BrotliDeflateTransformation();
+private:
+  void compressData(const char *data, size_t length, int operation);
+  BrotliDeflateTransformationState *state_; /** Internal state for Brotli Deflate Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_BROTLIDEFLATETRANSFORMATION_H_ */
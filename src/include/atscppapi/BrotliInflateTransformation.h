@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file BrotliInflateTransformation.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Brotli Inflate Transformation can be used to decompress brotli compressed content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_BROTLIINFLATETRANSFORMATION_H_
+#define ATSCPPAPI_BROTLIINFLATETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Brotli Inflate Transformations
+ * @private
+ */
+class BrotliInflateTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add brotli decompression to your TransformationPlugin chain.
+ *
+ * BrotliInflateTransformation has the same interface as GzipInflateTransformation, it is only built
+ * when brotli is found by configure.
+ *
+ * @note BrotliInflateTransformation DOES NOT set or check Content-Encoding headers, it is the
+ * users responsibility to check the content is actually brotli compressed before
+ * creating a BrotliInflateTransformation.
+ *
+ * @see BrotliDeflateTransformation
+ * @see GzipInflateTransformation
+ */
+class BrotliInflateTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief Memory and safety limits for a BrotliInflateTransformation.
+   *
+   * These have the same meaning as GzipInflateTransformation::Options.
+   */
+  struct Options {
+    size_t output_window_size_; /**< Size of the reusable output window, defaults to 16KB */
+    int64_t max_output_bytes_; /**< Maximum number of decompressed bytes, 0 (the default) means no limit */
+    unsigned int max_ratio_; /**< Maximum ratio of decompressed to compressed bytes, 0 (the default) means no limit.
+                                  The ratio is only enforced once 64KB has been decompressed. */
+
+    Options();
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type because the BrotliInflateTransformation can be used with both requests and responses
+   *  you must specify the Type.
+   *
+   * @see TransformationPlugin::Type
+   */
+  BrotliInflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of transformation.
+   * @param options the output window size and decompression limits to use.
+   */
+  BrotliInflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
+  /**
+   * Constructs a BrotliInflateTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @see TransformationChain
+   */
+  BrotliInflateTransformation(Transaction &transaction, TransformationChain &chain);
+
+  /**
+   * Constructs a BrotliInflateTransformation stage of chain with the specified limits.
+   *
+   * @see TransformationChain
+   */
+  BrotliInflateTransformation(Transaction &transaction, TransformationChain &chain, const Options &options);
+
+  /**
+   * @return true if decompression was aborted because a limit in Options was exceeded.
+   */
+  bool isLimitExceeded() const;
+
+  /**
+   * Decompresses data and produces the decompressed output.
+   *
+   * @param data the input data to decompress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * The zero copy variant of consume(), each block of data in the InputBuffer is
+   * handed to brotli directly.
+   *
+   * @param input the input data to decompress
+   */
+  void consume(InputBuffer &input);
+
+  /**
+   * Finalizes the decompression.
+   */
+  void handleInputComplete();
+
+  virtual ~BrotliInflateTransformation();
+private:
+  void decompressData(const char *data, size_t length);
+  bool checkLimits();
+  BrotliInflateTransformationState *state_; /** Internal state for Brotli Inflate Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_BROTLIINFLATETRANSFORMATION_H_ */
@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CacheKeyBuilder.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_CACHEKEYBUILDER_H_
+#define ATSCPPAPI_CACHEKEYBUILDER_H_
+
+#include <string>
+#include <stdint.h>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/StringView.h>
+#include <atscppapi/WellKnownHeader.h>
+
+namespace atscppapi {
+
+// forward declarations
+class Url;
+class Headers;
+class Transaction;
+
+/**
+ * @brief Builds a cache key from URL components and header values in one pass.
+ *
+ * Each component is streamed into a 64-bit xxHash and, unless only the hash is wanted, appended to a key
+ * buffer held in the builder itself, so a key of up to INLINE_KEY_SIZE bytes needs no allocation at all.
+ * Components are separated by a / so that moving bytes from one component to the next changes the key.
+ *
+ * The builder is meant to live on the stack for the duration of a hook:
+ * \code
+ * CacheKeyBuilder key;
+ * key.addUrl(transaction.getClientRequest().getUrl(), CacheKeyBuilder::URL_HOST | CacheKeyBuilder::URL_PATH)
+ *    .addQuery(query, CacheKeyBuilder::QUERY_SORTED, ignoreTrackingParams)
+ *    .addHeader(transaction.getClientRequest().getHeaders(), HEADER_ACCEPT_ENCODING);
+ * key.apply(transaction);
+ * \endcode
+ */
+class CacheKeyBuilder : noncopyable {
+public:
+  enum Output {
+    OUTPUT_KEY = 1, /**< Keep the key bytes, getKey() */
+    OUTPUT_HASH = 2 /**< Hash the key bytes, getHash() */
+  };
+
+  enum UrlComponent {
+    URL_SCHEME = 1,
+    URL_HOST = 2,
+    URL_PORT = 4,
+    URL_PATH = 8,
+    URL_QUERY = 16,
+    URL_ALL = URL_SCHEME | URL_HOST | URL_PORT | URL_PATH | URL_QUERY
+  };
+
+  enum QueryOrder {
+    QUERY_AS_IS = 0, /**< the parameters stay in the order the client sent them */
+    QUERY_SORTED     /**< the parameters are sorted so that their order doesn't matter */
+  };
+
+  /**
+   * Decides if a query parameter is part of the key.
+   *
+   * @param name The name of the parameter, without the =.
+   * @param data The data given to addQuery().
+   * @return true to keep the parameter.
+   */
+  typedef bool (*QueryParamFilter)(const StringView &name, void *data);
+
+  /** Keys up to this size are built without allocating. */
+  static const size_t INLINE_KEY_SIZE = 512;
+
+  /** Queries with more parameters than this are sorted in a temporary vector instead of on the stack. */
+  static const size_t MAX_INLINE_QUERY_PARAMS = 32;
+
+  /**
+   * @param outputs A mask of Output values.
+   * @param seed Seed of the hash.
+   */
+  CacheKeyBuilder(int outputs = OUTPUT_KEY | OUTPUT_HASH, uint64_t seed = 0);
+  ~CacheKeyBuilder() { }
+
+  /**
+   * Adds a component as is.
+   */
+  CacheKeyBuilder &add(const StringView &component);
+
+  /**
+   * Adds a number, formatted in decimal.
+   */
+  CacheKeyBuilder &add(int64_t number);
+
+  /**
+   * Adds the selected components of a url, read through Url::getView() so nothing is copied.
+   *
+   * @param components A mask of UrlComponent values; a query added here is added as is.
+   */
+  CacheKeyBuilder &addUrl(const Url &url, int components = URL_ALL);
+
+  /**
+   * Adds the parameters of a query, filtered and ordered, joined with &. Nothing is added if no
+   * parameter is kept.
+   *
+   * @param query The query, without its ?.
+   * @param order How to order the parameters kept.
+   * @param filter Decides which parameters are kept, NULL to keep them all.
+   * @param filter_data Passed to filter.
+   */
+  CacheKeyBuilder &addQuery(const StringView &query, QueryOrder order = QUERY_AS_IS, QueryParamFilter filter = NULL,
+                            void *filter_data = NULL);
+
+  /**
+   * Adds the values of a header, joined with a comma. A missing header adds an empty component.
+   */
+  CacheKeyBuilder &addHeader(const Headers &headers, const std::string &name);
+
+  /**
+   * @see addHeader(const Headers &headers, const std::string &name)
+   */
+  CacheKeyBuilder &addHeader(const Headers &headers, WellKnownHeader header);
+
+  /**
+   * @return The key built so far, an empty view if OUTPUT_KEY wasn't asked for. Valid until the builder is
+   * changed.
+   */
+  StringView getKey() const;
+
+  /**
+   * @return The hash of the key built so far, 0 if OUTPUT_HASH wasn't asked for.
+   */
+  uint64_t getHash() const;
+
+  /**
+   * Writes getHash() as 16 lower case hex digits followed by a null.
+   */
+  void getHashString(char buffer[17]) const;
+
+  /**
+   * Sets the transaction's cache key with TSCacheUrlSet(): the key if OUTPUT_KEY was asked for, else the
+   * hash as a hex string.
+   *
+   * @return true if the cache key was set.
+   */
+  bool apply(Transaction &transaction) const;
+
+  /**
+   * Empties the builder so it can be used for another key; the key buffer is kept.
+   */
+  void clear();
+
+private:
+  void beginComponent(char separator);
+  void append(const char *data, size_t length);
+  void appendQueryParam(const StringView &param, bool &first);
+  void updateHash(const char *data, size_t length);
+
+  int outputs_;
+  uint64_t seed_;
+  uint64_t acc_[4];
+  uint64_t total_length_;
+  unsigned char stripe_[32];
+  size_t stripe_length_;
+  bool empty_;
+  char inline_key_[INLINE_KEY_SIZE];
+  size_t inline_key_length_;
+  std::string long_key_;
+  bool using_long_key_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_CACHEKEYBUILDER_H_ */
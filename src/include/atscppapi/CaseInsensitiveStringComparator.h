@@ -22,13 +22,15 @@
 #define ATSCPPAPI_CASE_INSENSITIVE_STRING_COMPARATOR_H_
 
 #include <string>
+#include <cstddef>
 
 namespace atscppapi {
 
 /**
  * @brief A case insensitive comparator that can be used with standard library containers.
  *
- * The primary use for this class is to make all Headers case insensitive.
+ * The primary use for this class is to make all Headers case insensitive. Only ASCII letters are
+ * folded; where available (SSE2 or NEON) sixteen bytes are folded and compared per step.
  */
 class CaseInsensitiveStringComparator {
 public:
@@ -41,6 +43,49 @@ public:
    * @return numerical value of lexicographical comparison a la strcmp
    */
   int compare(const std::string &lhs, const std::string &rhs) const;
+
+  /**
+   * @see compare(const std::string &lhs, const std::string &rhs)
+   */
+  int compare(const char *lhs, size_t lhs_length, const char *rhs, size_t rhs_length) const;
+
+  /**
+   * @return true if both strings are equal ignoring case; cheaper than compare() as differing
+   *         lengths are rejected without looking at the characters.
+   */
+  bool equals(const std::string &lhs, const std::string &rhs) const;
+
+  /**
+   * @see equals(const std::string &lhs, const std::string &rhs)
+   */
+  bool equals(const char *lhs, size_t lhs_length, const char *rhs, size_t rhs_length) const;
+};
+
+/**
+ * @brief A hash consistent with CaseInsensitiveStringComparator, strings differing only in
+ * case hash alike.
+ *
+ * Together with CaseInsensitiveStringEqual this allows case insensitive unordered containers, e.g.
+ * std::tr1::unordered_map<std::string, T, CaseInsensitiveStringHash, CaseInsensitiveStringEqual>.
+ */
+class CaseInsensitiveStringHash {
+public:
+  size_t operator()(const std::string &str) const;
+
+  /**
+   * @see operator()(const std::string &str)
+   */
+  size_t operator()(const char *str, size_t length) const;
+};
+
+/**
+ * @brief Case insensitive equality predicate for unordered containers, see CaseInsensitiveStringHash.
+ */
+class CaseInsensitiveStringEqual {
+public:
+  bool operator()(const std::string &lhs, const std::string &rhs) const {
+    return CaseInsensitiveStringComparator().equals(lhs, rhs);
+  }
 };
 
 }
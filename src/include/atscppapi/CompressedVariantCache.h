@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file CompressedVariantCache.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief An in-memory cache of compressed response bodies.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_COMPRESSEDVARIANTCACHE_H_
+#define ATSCPPAPI_COMPRESSEDVARIANTCACHE_H_
+
+#include <string>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/shared_ptr.h>
+#include <atscppapi/Transaction.h>
+#include <atscppapi/TransformationPlugin.h>
+#include <atscppapi/ContentEncoding.h>
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for a CompressedVariantCache
+ * @private
+ */
+struct CompressedVariantCacheState;
+
+/**
+ * @brief A size bounded, least recently used, in-memory cache of compressed response bodies.
+ *
+ * Compressing the same hot object for every request is wasted work, the cache keeps the compressed
+ * body keyed by URL, codec and ETag so it can be served directly the next time the same variant
+ * is requested. Responses without an ETag are never cached since there's no way to tell when they change.
+ *
+ * A single cache is meant to be shared by every Transaction, it is thread safe and it must outlive
+ * the Transactions that use it, usually it's created in TSPluginInit() and never destroyed.
+ *
+ * \code
+ * CompressedVariantCache *cache = new CompressedVariantCache(64 * 1024 * 1024, 1024 * 1024);
+ *
+ * void handleReadResponseHeaders(Transaction &transaction) {
+ *   cache->setupTransaction(transaction); // picks a codec, then serves or fills the cache.
+ *   transaction.resume();
+ * }
+ * \endcode
+ *
+ * @see ContentEncoding
+ */
+class CompressedVariantCache : noncopyable {
+public:
+  /**
+   * @param max_bytes the maximum total size of all cached bodies.
+   * @param max_entry_bytes bodies larger than this are never cached.
+   */
+  CompressedVariantCache(size_t max_bytes, size_t max_entry_bytes);
+
+  /**
+   * @return The cache key for a variant of url compressed with codec.
+   */
+  static std::string createKey(const std::string &url, ContentEncoding::Codec codec, const std::string &etag);
+
+  /**
+   * @return The cached body for key, the shared_ptr is NULL on a miss.
+   */
+  shared_ptr<const std::string> get(const std::string &key);
+
+  /**
+   * Stores body under key, evicting the least recently used entries if the cache would be too large.
+   * Bodies larger than max_entry_bytes are ignored.
+   */
+  void put(const std::string &key, shared_ptr<const std::string> body);
+
+  /**
+   * Removes every entry from the cache.
+   */
+  void clear();
+
+  /**
+   * @return The total size in bytes of the cached bodies.
+   */
+  size_t getSize() const;
+
+  /**
+   * @return The number of cached bodies.
+   */
+  size_t getEntryCount() const;
+
+  /**
+   * Negotiates a codec for the response of transaction (see ContentEncoding::negotiate()) and adds
+   * the TransformationPlugins to serve it, this should be called from HOOK_READ_RESPONSE_HEADERS.
+   * On a hit the cached body replaces the response body, on a miss the response is compressed and
+   * the result is stored. The client response headers are updated for the codec in either case, if
+   * you use the create*Transformation() methods directly you must call ContentEncoding::setResponseHeaders()
+   * yourself.
+   *
+   * Only 200 responses to GET requests without a Range are compressed and cached, others and origin
+   * responses with a Content-Encoding other than identity are served as they are.
+   *
+   * @return The negotiated Codec, nothing is done for ContentEncoding::IDENTITY.
+   */
+  ContentEncoding::Codec setupTransaction(Transaction &transaction);
+
+  /**
+   * Creates a TransformationPlugin which passes its input through unchanged and stores it under
+   * key once the input is complete, put it after the compressing transformation.
+   */
+  TransformationPlugin *createStoreTransformation(Transaction &transaction, const std::string &key,
+                                                  TransformationPlugin::Type type = TransformationPlugin::RESPONSE_TRANSFORMATION);
+
+  /**
+   * Creates a TransformationPlugin which discards its input and produces body instead.
+   */
+  static TransformationPlugin *createServeTransformation(Transaction &transaction, shared_ptr<const std::string> body,
+                                                         TransformationPlugin::Type type = TransformationPlugin::RESPONSE_TRANSFORMATION);
+
+  ~CompressedVariantCache();
+private:
+  CompressedVariantCacheState *state_;
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_COMPRESSEDVARIANTCACHE_H_ */
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ConfigReloader.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_CONFIGRELOADER_H_
+#define ATSCPPAPI_CONFIGRELOADER_H_
+
+#include <string>
+#include <atscppapi/Async.h>
+#include <atscppapi/AsyncTimer.h>
+#include <atscppapi/Versioned.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct ConfigReloaderState;
+
+/**
+ * @brief Reloads a plugin's configuration periodically and/or when Traffic Server's configuration is reloaded.
+ *
+ * A subclass implements reload(), which runs on a thread pool thread so it can read files without stalling
+ * an event thread; reloads never overlap. See VersionedReloader for reloading into a Versioned.
+ */
+class ConfigReloader : public AsyncReceiver<AsyncTimer> {
+public:
+  ConfigReloader();
+  virtual ~ConfigReloader();
+
+  /**
+   * Reloads every period_ms milliseconds from now on, the first time period_ms from now.
+   */
+  void reloadEvery(int period_ms);
+
+  /**
+   * Reloads when Traffic Server reloads its configuration (traffic_line -x), see TSMgmtUpdateRegister().
+   * Only one reloader per plugin can be registered.
+   *
+   * @param plugin_name The name the plugin was registered with.
+   */
+  void reloadOnConfigUpdate(const std::string &plugin_name);
+
+  /**
+   * Reloads right away on the calling thread, e.g. for the first load from TSPluginInit().
+   *
+   * @return The result of reload().
+   */
+  bool reloadNow();
+
+  /**
+   * @return Number of reloads that succeeded.
+   */
+  int getReloadCount() const;
+
+protected:
+  /**
+   * Loads the configuration and publishes it.
+   *
+   * @return false if the configuration couldn't be loaded and the current one is kept.
+   */
+  virtual bool reload() = 0;
+
+private:
+  void handleAsyncComplete(AsyncTimer &timer);
+  ConfigReloaderState *state_;
+  friend struct ConfigReloaderState;
+};
+
+/**
+ * @brief A ConfigReloader publishing what a load function returns into a Versioned.
+ *
+ * \code
+ * RuleSet *loadRules(void *path) { ... return NULL on error ... }
+ *
+ * Versioned<RuleSet> rules;
+ * VersionedReloader<RuleSet> reloader(rules, loadRules, const_cast<char *>("/etc/trafficserver/rules.txt"));
+ * reloader.reloadNow();
+ * reloader.reloadEvery(60000);
+ * reloader.reloadOnConfigUpdate("rules_plugin");
+ * \endcode
+ */
+template <typename T> class VersionedReloader : public ConfigReloader {
+public:
+  /**
+   * @return A new version, NULL to keep the current one.
+   */
+  typedef T *(*LoadFunction)(void *data);
+
+  /**
+   * @param versioned Where loaded versions are published, it must outlive the reloader.
+   * @param load Loads a version.
+   * @param data Passed to load.
+   */
+  VersionedReloader(Versioned<T> &versioned, LoadFunction load, void *data = NULL)
+    : versioned_(versioned), load_(load), data_(data) { }
+
+protected:
+  bool reload() {
+    T *value = load_(data_);
+    if (!value) {
+      return false;
+    }
+    versioned_.publish(value);
+    return true;
+  }
+
+private:
+  Versioned<T> &versioned_;
+  LoadFunction load_;
+  void *data_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_CONFIGRELOADER_H_ */
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ContentEncoding.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Accept-Encoding negotiation for the compression transformations.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_CONTENTENCODING_H_
+#define ATSCPPAPI_CONTENTENCODING_H_
+
+#include <string>
+#include <atscppapi/Transaction.h>
+#include <atscppapi/Response.h>
+#include <atscppapi/TransformationPlugin.h>
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * @brief Picks a content encoding for the client and sets up the matching compression.
+ *
+ * ContentEncoding replaces the Accept-Encoding / Content-Encoding / Vary handling every compressing
+ * plugin used to write for itself. The client's Accept-Encoding header is parsed once per Transaction,
+ * the best codec that was built into the library is chosen and the result is remembered for the rest
+ * of the Transaction.
+ *
+ * \code
+ * void handleReadResponseHeaders(Transaction &transaction) {
+ *   TransformationPlugin *compressor = ContentEncoding::createCompressor(transaction, ContentEncoding::negotiate(transaction));
+ *   if (compressor) {
+ *     transaction.addPlugin(compressor);
+ *   }
+ *   transaction.resume();
+ * }
+ *
+ * void handleSendResponseHeaders(Transaction &transaction) {
+ *   ContentEncoding::setResponseHeaders(transaction.getClientResponse(), ContentEncoding::negotiate(transaction));
+ *   transaction.resume();
+ * }
+ * \endcode
+ *
+ * @see CompressedVariantCache
+ */
+class ContentEncoding {
+public:
+  /**
+   * The codecs that can be negotiated.
+   */
+  enum Codec {
+    IDENTITY = 0, /**< No compression */
+    GZIP, /**< gzip, always available */
+    BROTLI, /**< br, only available if the library was built with brotli */
+    ZSTD /**< zstd, only available if the library was built with zstd */
+  };
+
+  /**
+   * Chooses a codec from an Accept-Encoding header value. Codings with the highest q value win and
+   * ties are broken in the order br, zstd, gzip. Codecs that were not built into the library and codings
+   * with q=0 are never chosen.
+   *
+   * @param accept_encoding the value of an Accept-Encoding header.
+   * @return The chosen Codec, IDENTITY if none of the available codecs is acceptable.
+   */
+  static Codec negotiate(const std::string &accept_encoding);
+
+  /**
+   * Chooses a codec from the client request's Accept-Encoding header, the result is stored on the
+   * Transaction so the header is only parsed once no matter how many times this is called.
+   */
+  static Codec negotiate(Transaction &transaction);
+
+  /**
+   * @return true if codec was built into the library.
+   */
+  static bool isAvailable(Codec codec);
+
+  /**
+   * @return The Content-Encoding token for codec, for example "gzip" or "br".
+   */
+  static std::string getName(Codec codec);
+
+  /**
+   * Sets Content-Encoding for codec and adds Accept-Encoding to Vary on response, the Content-Length is
+   * removed since it no longer applies once the body is compressed. Nothing is changed for IDENTITY.
+   */
+  static void setResponseHeaders(Response &response, Codec codec);
+
+  /**
+   * Creates a compressing TransformationPlugin for codec with its default options, the caller must add it
+   * to the Transaction with Transaction::addPlugin().
+   *
+   * @return The transformation, NULL for IDENTITY or if the codec is not available.
+   */
+  static TransformationPlugin *createCompressor(Transaction &transaction, Codec codec,
+                                                TransformationPlugin::Type type = TransformationPlugin::RESPONSE_TRANSFORMATION);
+
+  /**
+   * Creates a compressing response transformation like createCompressor() whose output Traffic Server caches
+   * instead of the origin's response, so a hit is served compressed without compressing it again. It must be
+   * called from HOOK_READ_RESPONSE_HEADERS, for IDENTITY too: Accept-Encoding is added to the Vary of the server
+   * response, and the cached compressed variant gets the headers of setResponseHeaders(), so the cache keeps one
+   * variant per Accept-Encoding and a client is only served one it accepts. The client response of the
+   * transaction gets the same headers, setResponseHeaders() doesn't need to be called.
+   *
+   * \code
+   * void handleReadResponseHeaders(Transaction &transaction) {
+   *   TransformationPlugin *compressor = ContentEncoding::createCachedCompressor(transaction, ContentEncoding::negotiate(transaction));
+   *   if (compressor) {
+   *     transaction.addPlugin(compressor);
+   *   }
+   *   transaction.resume();
+   * }
+   * \endcode
+   *
+   * @return The transformation, NULL for IDENTITY or if the codec is not available.
+   * @see TransformationPlugin::setCachedVariant()
+   */
+  static TransformationPlugin *createCachedCompressor(Transaction &transaction, Codec codec);
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_CONTENTENCODING_H_ */
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file CustomResponse.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_CUSTOMRESPONSE_H_
+#define ATSCPPAPI_CUSTOMRESPONSE_H_
+
+#include <string>
+#include <atscppapi/HttpStatus.h>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+// forward declarations
+class Transaction;
+struct CustomResponseState;
+
+/**
+ * @brief A response built once and sent by any number of transactions instead of going to the origin.
+ *
+ * send() sets the status, the body and the headers and takes the transaction to the error state, the body is
+ * copied once per transaction, straight into the buffer Traffic Server sends it from. A CustomResponse is usually
+ * created in TSPluginInit() and must outlive the transactions it is sent on.
+ *
+ * \code
+ * CustomResponse *too_many_requests = new CustomResponse(HTTP_STATUS_TOO_MANY_REQUESTS,
+ *     "<html><body>Slow down</body></html>");
+ * too_many_requests->addHeader("Retry-After", "1");
+ * ...
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   if (isOverLimit(transaction)) {
+ *     too_many_requests->send(transaction); // instead of transaction.resume()
+ *     return;
+ *   }
+ *   transaction.resume();
+ * }
+ * \endcode
+ */
+class CustomResponse : noncopyable {
+public:
+  /**
+   * @param status the status of the response.
+   * @param body the body of the response.
+   * @param content_type the Content-Type of the response.
+   */
+  CustomResponse(HttpStatus status, const std::string &body, const std::string &content_type = "text/html");
+
+  /**
+   * @return A redirect of the client to location, a 302 unless status says otherwise. The body is empty.
+   */
+  static CustomResponse *createRedirect(const std::string &location, HttpStatus status = HTTP_STATUS_MOVED_TEMPORARILY);
+
+  /**
+   * Sets the reason phrase, Traffic Server's default for the status is used without one.
+   */
+  CustomResponse &setReasonPhrase(const std::string &reason_phrase);
+
+  /**
+   * Adds a header to the response, e.g. Location or Retry-After.
+   */
+  CustomResponse &addHeader(const std::string &name, const std::string &value);
+
+  /**
+   * Ends transaction with this response. Call it from a hook handler before HOOK_SEND_RESPONSE_HEADERS instead of
+   * Transaction::resume(), it calls Transaction::error().
+   */
+  void send(Transaction &transaction) const;
+
+  ~CustomResponse();
+private:
+  CustomResponseState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_CUSTOMRESPONSE_H_ */
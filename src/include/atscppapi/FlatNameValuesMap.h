@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file FlatNameValuesMap.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief A compact, vector backed alternative to the std::map used by Headers.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_FLATNAMEVALUESMAP_H_
+#define ATSCPPAPI_FLATNAMEVALUESMAP_H_
+
+#include <string>
+#include <list>
+#include <vector>
+#include <utility>
+#include <strings.h>
+
+namespace atscppapi {
+
+/**
+ * @brief A map of header names to values stored in a single contiguous vector.
+ *
+ * FlatNameValuesMap provides the subset of the std::map interface that Headers uses, so it can
+ * be swapped in as Headers::NameValuesMap by building the library and your plugins with
+ * ATSCPPAPI_FLAT_HEADERS defined (configure --enable-flat-headers). Header sets are small, so
+ * a linear case insensitive search over a vector is cheaper than a tree and it needs a single
+ * allocation for all of the names rather than one node per header.
+ *
+ * There are two differences from std::map: headers are kept in the order they were added
+ * instead of being sorted by name, and as with any vector inserting or erasing invalidates
+ * existing iterators.
+ */
+class FlatNameValuesMap {
+public:
+  typedef std::string key_type;
+  typedef std::list<std::string> mapped_type;
+  typedef std::pair<std::string, std::list<std::string> > value_type;
+  typedef std::vector<value_type> container_type;
+  typedef container_type::size_type size_type;
+  typedef container_type::iterator iterator;
+  typedef container_type::const_iterator const_iterator;
+  typedef container_type::reverse_iterator reverse_iterator;
+  typedef container_type::const_reverse_iterator const_reverse_iterator;
+
+  FlatNameValuesMap() {
+    elements_.reserve(INITIAL_CAPACITY);
+  }
+
+  iterator begin() { return elements_.begin(); }
+  const_iterator begin() const { return elements_.begin(); }
+  iterator end() { return elements_.end(); }
+  const_iterator end() const { return elements_.end(); }
+  reverse_iterator rbegin() { return elements_.rbegin(); }
+  const_reverse_iterator rbegin() const { return elements_.rbegin(); }
+  reverse_iterator rend() { return elements_.rend(); }
+  const_reverse_iterator rend() const { return elements_.rend(); }
+
+  bool empty() const { return elements_.empty(); }
+  size_type size() const { return elements_.size(); }
+  size_type max_size() const { return elements_.max_size(); }
+
+  iterator find(const std::string &key) {
+    for (iterator iter = elements_.begin(), end = elements_.end(); iter != end; ++iter) {
+      if (matches(iter->first, key)) {
+        return iter;
+      }
+    }
+    return elements_.end();
+  }
+
+  const_iterator find(const std::string &key) const {
+    for (const_iterator iter = elements_.begin(), end = elements_.end(); iter != end; ++iter) {
+      if (matches(iter->first, key)) {
+        return iter;
+      }
+    }
+    return elements_.end();
+  }
+
+  size_type count(const std::string &key) const {
+    return (find(key) == elements_.end()) ? 0 : 1;
+  }
+
+  /**
+   * Inserts value if there is no header with the same name, just like std::map::insert().
+   *
+   * @return The new or existing element and true if value was inserted.
+   */
+  std::pair<iterator, bool> insert(const value_type &value) {
+    iterator iter = find(value.first);
+    if (iter != elements_.end()) {
+      return std::make_pair(iter, false);
+    }
+    elements_.push_back(value);
+    return std::make_pair(elements_.end() - 1, true);
+  }
+
+  mapped_type &operator[](const std::string &key) {
+    return insert(value_type(key, mapped_type())).first->second;
+  }
+
+  size_type erase(const std::string &key) {
+    iterator iter = find(key);
+    if (iter == elements_.end()) {
+      return 0;
+    }
+    elements_.erase(iter);
+    return 1;
+  }
+
+  void erase(iterator position) {
+    elements_.erase(position);
+  }
+
+  void clear() {
+    elements_.clear();
+  }
+
+private:
+  static const size_type INITIAL_CAPACITY = 16; // enough for most requests without reallocating.
+
+  static bool matches(const std::string &lhs, const std::string &rhs) {
+    return (lhs.length() == rhs.length()) && (strncasecmp(lhs.data(), rhs.data(), lhs.length()) == 0);
+  }
+
+  container_type elements_;
+};
+
+}
+
+#endif /* ATSCPPAPI_FLATNAMEVALUESMAP_H_ */
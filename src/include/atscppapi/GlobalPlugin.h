@@ -22,6 +22,8 @@
 #define ATSCPPAPI_GLOBALPLUGIN_H_
 
 #include <atscppapi/Plugin.h>
+#include <atscppapi/HookFilter.h>
+#include <atscppapi/Session.h>
 
 namespace atscppapi {
 
@@ -61,11 +63,37 @@ public:
    *  see HookType and Plugin for the correspond HookTypes and callback methods. If you fail to implement the
    *  callback, a default implmentation will be used that will only resume the Transaction.
    *
+   * \note All GlobalPlugins share one continuation per hook, which calls them in the order they registered.
+   *  Hooks should be registered while the plugin is initialized, before any transaction is processed.
+   *
    * @param HookType the type of hook you wish to register
    * @see HookType
    * @see Plugin
    */
   void registerHook(Plugin::HookType);
+
+  /**
+   * Attaches a global hook that is only invoked for transactions matching filter. The filter is evaluated
+   * before a Transaction is built, transactions that don't match are resumed without invoking the plugin.
+   *
+   * @param HookType the type of hook you wish to register
+   * @param filter the condition the client request has to meet, see HookFilter.
+   */
+  void registerHook(Plugin::HookType, const HookFilter &filter);
+
+  /**
+   * Attaches a hook invoked with handleSessionStart() whenever a client session starts, before any of its
+   * transactions. Like the other hooks it should be registered while the plugin is initialized.
+   */
+  void registerSessionStartHook();
+
+  /**
+   * This method must be implemented when you call registerSessionStartHook(), it's typically used to add
+   * SessionPlugins. The session is resumed when it returns, so it must not wait for anything.
+   *
+   * @param session the Session that started.
+   */
+  virtual void handleSessionStart(Session &session);
   virtual ~GlobalPlugin();
 protected:
   /**
@@ -74,6 +102,8 @@ protected:
    * @param ignore_internal_transactions When true, all hooks registered by this plugin are ignored
    *                                     for internal transactions (internal transactions are created
    *                                     when other plugins create requests). Defaults to false.
+   *                                     Fetches made with AsyncHttpFetch::Options::passthrough_ skip the hooks
+   *                                     of all plugins either way.
    */
   GlobalPlugin(bool ignore_internal_transactions = false);
 private:
@@ -23,6 +23,7 @@
 
 #include <string>
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
 
 namespace atscppapi {
 
@@ -48,6 +49,33 @@ class GzipDeflateTransformationState;
  */
 class GzipDeflateTransformation : public TransformationPlugin {
 public:
+  /**
+   * The available policies for flushing compressed output downstream.
+   */
+  enum FlushPolicy {
+    FLUSH_EVERY_CHUNK = 0, /**< Sync flush after every chunk of input, this gives the lowest latency */
+    FLUSH_AT_WATERMARK, /**< Sync flush once Options::flush_watermark_ bytes of input have been compressed */
+    FLUSH_ON_FINISH /**< Never flush until the input is complete, this gives the best compression ratio */
+  };
+
+  /**
+   * @brief Tunable parameters for a GzipDeflateTransformation.
+   *
+   * The defaults match zlib's defaults and sync flush every chunk, see deflateInit2() in zlib.h
+   * for the meaning and valid range of level_, mem_level_, window_bits_ and strategy_.
+   */
+  struct Options {
+    int level_; /**< Compression level 0-9, defaults to Z_DEFAULT_COMPRESSION */
+    int mem_level_; /**< Memory used for the internal compression state 1-9, defaults to 8 */
+    int window_bits_; /**< Must be 16 + (9-15) to produce gzip output, defaults to 31 */
+    int strategy_; /**< Compression strategy, defaults to Z_DEFAULT_STRATEGY */
+    FlushPolicy flush_policy_; /**< When to flush output downstream, defaults to FLUSH_EVERY_CHUNK */
+    size_t flush_watermark_; /**< Bytes of input between flushes for FLUSH_AT_WATERMARK, defaults to 64KB */
+    size_t output_buffer_size_; /**< Size of the reusable output buffer, defaults to 16KB */
+
+    Options();
+  };
+
   /**
    * A full example of how to use GzipDeflateTransformation and GzipInflateTransformation is available
    * in examples/gzip_tranformation/
@@ -60,6 +88,32 @@ public:
    */
   GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
 
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of transformation.
+   * @param options the compression parameters to use.
+   *
+   * @see Options
+   */
+  GzipDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
+  /**
+   * Constructs a GzipDeflateTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param chain the TransformationChain to append this stage to.
+   *
+   * @see TransformationChain
+   */
+  GzipDeflateTransformation(Transaction &transaction, TransformationChain &chain);
+
+  /**
+   * Constructs a GzipDeflateTransformation stage of chain with the specified compression parameters.
+   *
+   * @see Options
+   */
+  GzipDeflateTransformation(Transaction &transaction, TransformationChain &chain, const Options &options);
+
   /**
    * Any TransformationPlugin must implement consume(), this method will take content
    * from the transformation chain and gzip compress it.
@@ -68,6 +122,14 @@ public:
    */
   void consume(const std::string &data);
 
+  /**
+   * The zero copy variant of consume(), each block of data in the InputBuffer is
+   * handed to zlib directly.
+   *
+   * @param input the input data to compress
+   */
+  void consume(InputBuffer &input);
+
   /**
    * Any TransformationPlugin must implement handleInputComplete(), this method will
    * finalize the gzip compression and flush any remaining data and the epilouge.
@@ -76,6 +138,8 @@ public:
 
   virtual ~GzipDeflateTransformation();
 private:
+  void compressData(const char *data, size_t length);
+  bool runDeflate(int flush);
   GzipDeflateTransformationState *state_; /** Internal state for Gzip Deflate Transformations */
 };
 
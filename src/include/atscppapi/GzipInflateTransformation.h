@@ -23,6 +23,7 @@
 
 #include <string>
 #include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
 
 namespace atscppapi {
 
@@ -50,6 +51,22 @@ class GzipInflateTransformationState;
  */
 class GzipInflateTransformation : public TransformationPlugin {
 public:
+  /**
+   * @brief Memory and safety limits for a GzipInflateTransformation.
+   *
+   * Decompressed output is drained through a fixed size window so memory use doesn't depend on the
+   * size of the input. If either limit is exceeded the transformation stops decompressing, logs an
+   * error and aborts the transformation, see TransformationPlugin::abort(), rather than serve a cut off body.
+   */
+  struct Options {
+    size_t output_window_size_; /**< Size of the reusable output window, defaults to 16KB */
+    int64_t max_output_bytes_; /**< Maximum number of decompressed bytes, 0 (the default) means no limit */
+    unsigned int max_ratio_; /**< Maximum ratio of decompressed to compressed bytes, 0 (the default) means no limit.
+                                  The ratio is only enforced once 64KB has been decompressed. */
+
+    Options();
+  };
+
   /**
    * A full example of how to use GzipInflateTransformation and GzipDeflateTransformation is available
    * in examples/gzip_tranformation/
@@ -62,6 +79,37 @@ public:
    */
   GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
 
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of transformation.
+   * @param options the output window size and decompression limits to use.
+   *
+   * @see Options
+   */
+  GzipInflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
+  /**
+   * Constructs a GzipInflateTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param chain the TransformationChain to append this stage to.
+   *
+   * @see TransformationChain
+   */
+  GzipInflateTransformation(Transaction &transaction, TransformationChain &chain);
+
+  /**
+   * Constructs a GzipInflateTransformation stage of chain with the specified limits.
+   *
+   * @see Options
+   */
+  GzipInflateTransformation(Transaction &transaction, TransformationChain &chain, const Options &options);
+
+  /**
+   * @return true if decompression was aborted because a limit in Options was exceeded.
+   */
+  bool isLimitExceeded() const;
+
   /**
    * Any TransformationPlugin must implement consume(), this method will take content
    * from the transformation chain and gzip decompress it.
@@ -70,6 +118,14 @@ public:
    */
   void consume(const std::string &);
 
+  /**
+   * The zero copy variant of consume(), each block of data in the InputBuffer is
+   * handed to zlib directly.
+   *
+   * @param input the input data to decompress
+   */
+  void consume(InputBuffer &input);
+
   /**
    * Any TransformationPlugin must implement handleInputComplete(), this method will
    * finalize the gzip decompression.
@@ -78,6 +134,8 @@ public:
 
   virtual ~GzipInflateTransformation();
 private:
+  void decompressData(const char *data, size_t length);
+  bool checkLimits();
   GzipInflateTransformationState *state_; /** Internal state for Gzip Deflate Transformations */
 };
 
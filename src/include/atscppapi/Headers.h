@@ -24,6 +24,12 @@
 #include <list>
 #include <atscppapi/CaseInsensitiveStringComparator.h>
 #include <atscppapi/noncopyable.h>
+#include <atscppapi/StringView.h>
+#include <atscppapi/WellKnownHeader.h>
+#include <vector>
+#ifdef ATSCPPAPI_FLAT_HEADERS
+#include <atscppapi/FlatNameValuesMap.h>
+#endif
 
 namespace atscppapi {
 
@@ -34,6 +40,17 @@ class Response;
 
 /**
  * @brief Encapsulates the headers portion of a request or response.
+ *
+ * Headers are read from Traffic Server lazily, find(), count() and getJoinedValues() only read
+ * the requested header; every header is only read once the headers are iterated or when
+ * size() or empty() is called.
+ *
+ * The view accessors, getValueView(), getValueViews() and getNameViews(), don't copy anything;
+ * they return StringViews pointing straight into Traffic Server's header buffer. Those views are
+ * only valid until the headers are modified or the hook they were obtained in returns.
+ *
+ * Most methods also take a WellKnownHeader token in place of a name; prefer them for the common
+ * headers since Traffic Server can match its interned names without case folding.
  */
 class Headers: noncopyable {
 public:
@@ -44,7 +61,15 @@ public:
 
   Type getType() const;
 
+#ifdef ATSCPPAPI_FLAT_HEADERS
+  /**
+   * Headers are stored in a vector in the order they were added, see FlatNameValuesMap. The library
+   * and every plugin using it must agree on ATSCPPAPI_FLAT_HEADERS.
+   */
+  typedef FlatNameValuesMap NameValuesMap;
+#else
   typedef std::map<std::string, std::list<std::string>, CaseInsensitiveStringComparator> NameValuesMap;
+#endif
 
   typedef NameValuesMap::size_type size_type;
   typedef NameValuesMap::const_iterator const_iterator;
@@ -82,6 +107,18 @@ public:
    */
   size_type count(const std::string &key) const;
 
+  /**
+   * @see find(const std::string &key)
+   */
+  const_iterator find(WellKnownHeader header) const;
+
+  /**
+   * Checks for the header using its interned name, without reading or copying its values.
+   *
+   * @return 1 if header exists, 0 if not.
+   */
+  size_type count(WellKnownHeader header) const;
+
   /**
    * Erases header with given name.
    *
@@ -90,6 +127,11 @@ public:
    */
   size_type erase(const std::string &key);
 
+  /**
+   * @see erase(const std::string &key)
+   */
+  size_type erase(WellKnownHeader header);
+
   /**
    * Sets the given header and values. If a header of same name existed, that is
    * deleted. Else header is appended.
@@ -122,6 +164,11 @@ public:
    */
   const_iterator set(const std::string &key, const std::string &val);
 
+  /**
+   * @see set(const std::string &key, const std::string &val)
+   */
+  const_iterator set(WellKnownHeader header, const std::string &val);
+
   /**
    * Appends a new header. If a header of the same name exists, value(s) is tacked
    * on that the end of current value(s). 
@@ -154,6 +201,66 @@ public:
    */
   const_iterator append(const std::string &key, const std::string &val);
 
+  /**
+   * @see append(const std::string &key, const std::string &val)
+   */
+  const_iterator append(WellKnownHeader header, const std::string &val);
+
+  /**
+   * @brief A set of header edits applied together by Headers::apply().
+   *
+   * Each set(), append() or erase() on the headers looks the header up in Traffic Server and
+   * re-reads its values to keep the cached copy current. A Batch queues the edits instead, and
+   * apply() looks every header up once, writes the combined result and refreshes the cache once.
+   *
+   * @code
+   * Headers::Batch batch;
+   * batch.set("X-Foo", "1").append("Via", "me").erase("X-Debug");
+   * headers.apply(batch);
+   * @endcode
+   */
+  class Batch {
+  public:
+    /** @see Headers::set(const std::string &key, const std::string &val) */
+    Batch &set(const std::string &key, const std::string &val);
+    /** @see Headers::set(const std::string &key, const std::list<std::string> &val) */
+    Batch &set(const std::string &key, const std::list<std::string> &val);
+    /** @see Headers::append(const std::string &key, const std::string &val) */
+    Batch &append(const std::string &key, const std::string &val);
+    /** @see Headers::append(const std::string &key, const std::list<std::string> &val) */
+    Batch &append(const std::string &key, const std::list<std::string> &val);
+    /** @see Headers::erase(const std::string &key) */
+    Batch &erase(const std::string &key);
+
+    Batch &set(WellKnownHeader header, const std::string &val);
+    Batch &append(WellKnownHeader header, const std::string &val);
+    Batch &erase(WellKnownHeader header);
+
+    /** @return Number of queued edits. */
+    size_t size() const { return operations_.size(); }
+    bool empty() const { return operations_.empty(); }
+    /** Discards the queued edits so the Batch can be reused. */
+    void clear() { operations_.clear(); }
+  private:
+    enum OperationType { OPERATION_SET, OPERATION_APPEND, OPERATION_ERASE };
+    struct Operation {
+      OperationType type_;
+      std::string name_;
+      std::list<std::string> values_;
+    };
+    std::vector<Operation> operations_;
+    Batch &add(OperationType type, const std::string &key, const std::list<std::string> *val);
+    friend class Headers;
+  };
+
+  /**
+   * Applies the edits of the batch in the order they were queued; the result is the same as making
+   * the calls one by one. The batch is left untouched so it can be applied to other headers.
+   *
+   * @return false if the headers could not be modified.
+   */
+  bool apply(const Batch &batch);
+
   /**
    * Joins provided list of values with delimiter (defaulting to ',').
    *
@@ -168,6 +275,117 @@ public:
    */
   std::string getJoinedValues(const std::string &key, char value_delimiter = ',');
 
+  /**
+   * Joins the values of a well known header, reading them straight from Traffic Server's buffer.
+   *
+   * @return Composite string if header exists, else empty strings.
+   */
+  std::string getJoinedValues(WellKnownHeader header, char value_delimiter = ',');
+
+  /**
+   * Returns a value of the header without copying it, see StringView.
+   *
+   * @param key Name of the header, compared case insensitively.
+   * @param index Index of the value across every field with this name.
+   * @return A view of the value, or a null view (StringView::isNull()) if there is no such value. The
+   *         view is valid until the headers are modified or the current hook returns.
+   */
+  StringView getValueView(const std::string &key, int index = 0) const;
+
+  /**
+   * @see getValueView(const std::string &key, int index)
+   */
+  StringView getValueView(WellKnownHeader header, int index = 0) const;
+
+  /**
+   * Appends views of every value of the header to values without copying them. Reusing the
+   * same vector across calls avoids allocating at all.
+   *
+   * @return Number of views appended, zero if the header isn't present.
+   */
+  size_t getValueViews(const std::string &key, std::vector<StringView> &values) const;
+
+  /**
+   * @see getValueViews(const std::string &key, std::vector<StringView> &values)
+   */
+  size_t getValueViews(WellKnownHeader header, std::vector<StringView> &values) const;
+
+  /**
+   * Appends a view of the name of every header field, in order, to names. A name appears once for
+   * each field carrying it.
+   *
+   * @return Number of views appended.
+   */
+  size_t getNameViews(std::vector<StringView> &names) const;
+
+  /**
+   * Decides which headers copyFrom() copies.
+   *
+   * @param name Name of the header, only valid during the call.
+   * @param data The filter_data passed to copyFrom().
+   * @return true to copy the header.
+   */
+  typedef bool (*HeaderFilter)(const StringView &name, void *data);
+
+  /**
+   * Copies headers from other. Each copied header replaces any header of the same name, the rest
+   * are left alone. When both objects are backed by Traffic Server the fields are copied within the
+   * marshal buffers, and all at once with TSMimeHdrCopy() when these headers are empty and there is no filter.
+   *
+   * Headers that were never initialized become detached copies, which is how to take a snapshot for diff():
+   * @code
+   * Headers snapshot;
+   * snapshot.copyFrom(transaction.getClientRequest().getHeaders());
+   * @endcode
+   *
+   * @param other Headers to copy, of either type.
+   * @param filter If set, only headers it returns true for are copied.
+   * @param filter_data Passed to the filter.
+   * @return Number of headers copied.
+   */
+  size_t copyFrom(const Headers &other, HeaderFilter filter = NULL, void *filter_data = NULL);
+
+  /**
+   * @brief A difference found by diff().
+   */
+  struct HeaderChange {
+    enum ChangeType { HEADER_ADDED, HEADER_REMOVED, HEADER_MODIFIED };
+    ChangeType type_;
+    std::string name_;
+    HeaderChange(ChangeType type, const std::string &name) : type_(type), name_(name) { }
+  };
+
+  /**
+   * Finds the headers that differ between two snapshots, e.g. to log only what a plugin changed.
+   * A header is modified if its values or their order differ; the values are read from before and after.
+   *
+   * @param changes The differences are appended here, removals and modifications in the order of before,
+   *        followed by additions in the order of after.
+   * @return Number of differences appended.
+   */
+  static size_t diff(const Headers &before, const Headers &after, std::vector<HeaderChange> &changes);
+
+  /**
+   * @return Exact number of bytes serialize() writes, each header as a "Name: value1,value2\r\n" line.
+   */
+  size_t getSerializedSize() const;
+
+  /**
+   * Writes every header, one "Name: value1,value2\r\n" line each, to buffer in a single pass.
+   *
+   * @param buffer Where to write; nothing is null terminated.
+   * @param buffer_length Size of buffer, at least getSerializedSize() for anything to be written.
+   * @return Number of bytes written, 0 if the headers don't fit.
+   */
+  size_t serialize(char *buffer, size_t buffer_length) const;
+
+  /**
+   * Appends every header to output, allocating at most once.
+   *
+   * @see serialize(char *buffer, size_t buffer_length)
+   */
+  void serialize(std::string &output) const;
+
   /**
    * @return True if there are no headers.
    */
@@ -190,6 +408,63 @@ public:
    */
   const RequestCookieMap &getRequestCookies() const;
 
+  /**
+   * @brief A request cookie whose name and value point into the Cookie header, see getValueView().
+   */
+  struct RequestCookieView {
+    StringView name_;
+    StringView value_;
+  };
+
+  /**
+   * @brief Walks the cookies of a request object straight from the Cookie headers, allocating nothing.
+   *
+   * Cookies are returned in the order they were sent and parsed just as getRequestCookies() parses
+   * them, including stopping at the first malformed cookie. The views are only valid as long as
+   * those from getValueView().
+   *
+   * @code
+   * Headers::RequestCookieIterator iter(headers);
+   * Headers::RequestCookieView cookie;
+   * while (iter.next(cookie)) { ... }
+   * @endcode
+   */
+  class RequestCookieIterator {
+  public:
+    RequestCookieIterator(const Headers &headers);
+
+    /**
+     * Moves to the next cookie.
+     *
+     * @return false once there are no more cookies, cookie is left untouched then.
+     */
+    bool next(RequestCookieView &cookie);
+
+    /**
+     * @return true if iteration ended at a malformed cookie rather than after the last one.
+     */
+    bool isMalformed() const { return malformed_; }
+  private:
+    const Headers *headers_;
+    int value_index_;
+    StringView value_;
+    size_t pos_;
+    bool done_;
+    bool malformed_;
+    RequestCookieIterator(const Headers &headers, int first_value_index);
+    void init();
+    friend class Headers;
+  };
+
+  /**
+   * Finds a request cookie without parsing the rest of the cookies into getRequestCookies(): the
+   * Cookie headers are scanned until the first cookie with this name.
+   *
+   * @param name Name of the cookie, compared case sensitively as in getRequestCookies().
+   * @return A view of the value, or a null view (StringView::isNull()) if there is no such cookie.
+   */
+  StringView findRequestCookie(const std::string &name) const;
+
   struct ResponseCookie {
     std::string name_;
     std::string value_;
@@ -207,10 +482,10 @@ public:
    */
   const std::list<ResponseCookie> &getResponseCookies() const;
 
-  /** Adds a request cookie */
+  /** Adds a request cookie, see flushCookies() for when the Cookie header is written */
   bool addCookie(const std::string &name, const std::string &value);
 
-  /** Adds a response cookie */
+  /** Adds a response cookie, as a Set-Cookie header of its own */
   bool addCookie(const ResponseCookie &response_cookie);
   
   /** Sets, i.e., clears current value and adds new value, of a request cookie */
@@ -219,17 +494,36 @@ public:
   /** Sets, i.e., clears current value and adds new value, of a response cookie */
   bool setCookie(const ResponseCookie &response_cookie);
 
-  /** Deletes a cookie */
+  /** Deletes a cookie, of a response the Set-Cookie headers of that name */
   bool deleteCookie(const std::string &name);
 
+  /**
+   * Writes the pending cookie edits to the Cookie or Set-Cookie headers, all edits since the last flush are
+   * written at once rather than each rewriting the whole header. Reading or editing the headers
+   * through this object does so first, and a Transaction does so for its requests and responses before it
+   * hands control back to Traffic Server, so this is only needed before the marshal buffer is used directly.
+   */
+  void flushCookies();
+
   ~Headers();
 private:
   HeadersState *state_;
   bool checkAndInitHeaders() const;
+  bool checkHeaderHandles() const;
+  NameValuesMap::iterator lookupHeader(const std::string &key) const;
+  StringView findValueView(const char *name, size_t name_length, int index) const;
+  size_t findValueViews(const char *name, size_t name_length, std::vector<StringView> &values) const;
   void init(void *hdr_buf, void *hdr_loc);
   void initDetached();
   void setType(Type type);
   void updateRequestCookieHeaderFromMap();
+  void updateResponseCookieHeaders();
+  void removeResponseCookie(const std::string &name);
+  void flushPendingCookieEdits() const;
+  int prepareCookieUpdate(const std::string &key, bool erase_existing);
+  void finishCookieUpdate(int first_new_value);
+  int countValues(const std::string &key, int &num_fields) const;
+  void resetCaches();
   const_iterator doBasicAppend(const std::pair<std::string, std::list<std::string> > &pair);
   size_type doBasicErase(const std::string &key);
   friend class Request;
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HistogramStat.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_HISTOGRAMSTAT_H_
+#define ATSCPPAPI_HISTOGRAMSTAT_H_
+
+#include <atscppapi/noncopyable.h>
+#include <stdint.h>
+#include <string>
+
+namespace atscppapi {
+
+// forward declarations
+struct HistogramStatState;
+
+/**
+ * @brief A histogram of values such as latencies, exported as percentiles through Traffic Server stats.
+ *
+ * Values are recorded into log-linear buckets, 16 per power of two, so a percentile is off by at most 1/16
+ * of its value; values from 0 to 2^40 - 1 are distinguished, larger ones count as the largest. Every thread
+ * records into buckets of its own without locking. Every aggregation interval the buckets are folded and
+ * these stats are updated:
+ *  - name.p50, name.p99 and name.p999, the percentiles of the values recorded during the interval
+ *  - name.count and name.sum, the number and total of all values recorded so far
+ *
+ * \code
+ *  HistogramStat fetch_latency;
+ *  fetch_latency.init("plugin.fetch_latency_us");
+ *  fetch_latency.record(elapsed_us);
+ * \endcode
+ */
+class HistogramStat : noncopyable {
+public:
+  HistogramStat();
+  ~HistogramStat();
+
+  /**
+   * You must initialize your HistogramStat with a call to this init() method.
+   *
+   * @param name The prefix of the names of the stats, see above.
+   * @param aggregation_interval_ms How often the percentiles are computed, 10s by default.
+   * @return True if the stats were successfully created and false otherwise.
+   */
+  bool init(const std::string &name, int aggregation_interval_ms = 10000);
+
+  /**
+   * Records a value, negative values count as 0.
+   */
+  void record(int64_t value);
+
+  /**
+   * @return The percentile of the values recorded in the last complete interval, 0 if there were none.
+   * @param percentile between 0 and 100, e.g. 99.9
+   */
+  int64_t getPercentile(double percentile) const;
+
+private:
+  HistogramStatState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_HISTOGRAMSTAT_H_ */
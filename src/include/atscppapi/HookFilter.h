@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HookFilter.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_HOOKFILTER_H_
+#define ATSCPPAPI_HOOKFILTER_H_
+
+#include <string>
+#include <atscppapi/HttpMethod.h>
+#include <atscppapi/shared_ptr.h>
+
+namespace atscppapi {
+
+namespace utils {
+ class internal;
+} /* utils */
+
+class HookFilterState;
+struct HookFilterRequest;
+
+/**
+ * @brief A condition on the client request, evaluated before a GlobalPlugin hook is invoked.
+ *
+ * A GlobalPlugin registering a hook with a HookFilter is only invoked for transactions whose client request
+ * matches it. The filter is evaluated directly on the Traffic Server request, before any Transaction is built,
+ * and if no plugin of a hook matches the transaction is reenabled right away.
+ *
+ * A filter matches when every condition that was set matches:
+ *  - addHost(): the host is one of the hosts added, compared ignoring case.
+ *  - addPathPrefix(): the path starts with one of the prefixes added.
+ *  - addMethod(): the method is one of the methods added.
+ *  - setTransactionOrigin(): the transaction is internal or external.
+ *
+ * \code
+ * MyPlugin() {
+ *   registerHook(HOOK_READ_REQUEST_HEADERS_PRE_REMAP,
+ *                HookFilter().addHost("www.linkedin.com").addPathPrefix("/api/").addMethod(HTTP_METHOD_GET));
+ * }
+ * \endcode
+ *
+ * @see GlobalPlugin::registerHook()
+ */
+class HookFilter {
+public:
+  /**
+   * Which transactions a filter matches, based on whether they were created by a plugin.
+   */
+  enum TransactionOrigin {
+    ORIGIN_ANY = 0, /**< Both internal and external transactions, the default */
+    ORIGIN_EXTERNAL, /**< Only transactions of client requests */
+    ORIGIN_INTERNAL /**< Only transactions created by plugins */
+  };
+
+  /**
+   * Creates a filter matching every transaction.
+   */
+  HookFilter();
+
+  /**
+   * @param host a host the request may be for, from the url or else the Host header, without a port.
+   */
+  HookFilter &addHost(const std::string &host);
+
+  /**
+   * @param prefix a prefix the path of the request may start with, such as /api/. The leading slash is optional.
+   */
+  HookFilter &addPathPrefix(const std::string &prefix);
+
+  /**
+   * @param method a method the request may have.
+   */
+  HookFilter &addMethod(HttpMethod method);
+
+  /**
+   * @param origin which transactions match.
+   */
+  HookFilter &setTransactionOrigin(TransactionOrigin origin);
+
+  /**
+   * @return true if no condition was set.
+   */
+  bool empty() const;
+
+  ~HookFilter();
+private:
+  bool matches(HookFilterRequest &request) const;
+  shared_ptr<HookFilterState> state_; /**< shared by copies, a filter is only modified while being built */
+  friend class utils::internal;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_HOOKFILTER_H_ */
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file HookTiming.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_HOOKTIMING_H_
+#define ATSCPPAPI_HOOKTIMING_H_
+
+#include <stdint.h>
+#include <string>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Plugin.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct HookTimingState;
+namespace utils { class internal; }
+
+/**
+ * @brief Measures how long the hooks of a plugin take, into HistogramStats named after the plugin.
+ *
+ * For every HookType two histograms of microseconds are kept, see HistogramStat for the stats they export:
+ *  - name.read_request_headers_pre_remap.handler_us etc., the time spent in the handler itself
+ *  - name.read_request_headers_pre_remap.resume_us etc., the time until the handler's Transaction::resume()
+ *    or Transaction::error(), including whatever async work the plugin waited for
+ *
+ * A HookTiming is created once, in TSPluginInit(), and attached to every instance of the plugin it measures;
+ * without one nothing is measured.
+ *
+ * \code
+ * HookTiming *timing = new HookTiming("auth_plugin");
+ * ...
+ * AuthTransactionPlugin(Transaction &transaction) : TransactionPlugin(transaction) {
+ *   setHookTiming(timing);
+ *   registerHook(HOOK_READ_REQUEST_HEADERS_POST_REMAP);
+ * }
+ * \endcode
+ */
+class HookTiming : noncopyable {
+public:
+  /**
+   * @param name The prefix of the names of the stats, usually the plugin's name.
+   * @param aggregation_interval_ms How often the percentiles are computed, see HistogramStat::init().
+   */
+  HookTiming(const std::string &name, int aggregation_interval_ms = 10000);
+  ~HookTiming();
+private:
+  void recordHandlerTime(int hook_type, int64_t nanoseconds);
+  void recordResumeTime(int hook_type, int64_t nanoseconds);
+  HookTimingState *state_;
+  friend class utils::internal;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_HOOKTIMING_H_ */
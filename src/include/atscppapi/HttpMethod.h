@@ -20,7 +20,9 @@
 #ifndef ATSCPPAPI_HTTP_METHOD_H_
 #define ATSCPPAPI_HTTP_METHOD_H_
 
+#include <cstddef>
 #include <string>
+#include <atscppapi/StringView.h>
 
 namespace atscppapi {
 
@@ -38,7 +40,39 @@ enum HttpMethod {
   HTTP_METHOD_OPTIONS,
   HTTP_METHOD_PURGE,
   HTTP_METHOD_PUT,
-  HTTP_METHOD_TRACE
+  HTTP_METHOD_TRACE,
+  HTTP_METHOD_PATCH,
+  // WebDAV and the other methods of the IANA method registry
+  HTTP_METHOD_ACL,
+  HTTP_METHOD_BASELINE_CONTROL,
+  HTTP_METHOD_BIND,
+  HTTP_METHOD_CHECKIN,
+  HTTP_METHOD_CHECKOUT,
+  HTTP_METHOD_COPY,
+  HTTP_METHOD_LABEL,
+  HTTP_METHOD_LINK,
+  HTTP_METHOD_LOCK,
+  HTTP_METHOD_MERGE,
+  HTTP_METHOD_MKACTIVITY,
+  HTTP_METHOD_MKCALENDAR,
+  HTTP_METHOD_MKCOL,
+  HTTP_METHOD_MKREDIRECTREF,
+  HTTP_METHOD_MKWORKSPACE,
+  HTTP_METHOD_MOVE,
+  HTTP_METHOD_ORDERPATCH,
+  HTTP_METHOD_PRI,
+  HTTP_METHOD_PROPFIND,
+  HTTP_METHOD_PROPPATCH,
+  HTTP_METHOD_REBIND,
+  HTTP_METHOD_REPORT,
+  HTTP_METHOD_SEARCH,
+  HTTP_METHOD_UNBIND,
+  HTTP_METHOD_UNCHECKOUT,
+  HTTP_METHOD_UNLINK,
+  HTTP_METHOD_UNLOCK,
+  HTTP_METHOD_UPDATE,
+  HTTP_METHOD_UPDATEREDIRECTREF,
+  HTTP_METHOD_VERSION_CONTROL
 };
 
 /**
@@ -49,6 +83,18 @@ enum HttpMethod {
  */
 extern const std::string HTTP_METHOD_STRINGS[];
 
+/**
+ * @return The name of method as it appears on the request line, e.g. "GET". The view is of a null terminated
+ * string literal, so unlike HTTP_METHOD_STRINGS it can be used during static initialization.
+ */
+StringView getHttpMethodName(HttpMethod method);
+
+/**
+ * @return The method named by the length bytes at name, HTTP_METHOD_UNKNOWN for extension methods.
+ * Method names are case sensitive.
+ */
+HttpMethod parseHttpMethod(const char *name, size_t length);
+
 }
 
 #endif
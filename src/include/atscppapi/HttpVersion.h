@@ -22,6 +22,7 @@
 #define ATSCPPAPI_HTTP_VERSION_H_
 
 #include <string>
+#include <atscppapi/StringView.h>
 
 namespace atscppapi {
 
@@ -43,6 +44,12 @@ enum HttpVersion {
  */
 extern const std::string HTTP_VERSION_STRINGS[];
 
+/**
+ * @return The name of version, e.g. "HTTP/1.1", a view of a null terminated string literal.
+ * @see getHttpMethodName()
+ */
+StringView getHttpVersionName(HttpVersion version);
+
 }
 
 #endif
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file InterceptPlugin.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_INTERCEPTPLUGIN_H_
+#define ATSCPPAPI_INTERCEPTPLUGIN_H_
+
+#include <string>
+#include <atscppapi/Transaction.h>
+#include <atscppapi/TransactionPlugin.h>
+#include <atscppapi/Response.h>
+#include <atscppapi/StringView.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct InterceptPluginState;
+
+/**
+ * @brief The interface used when a plugin serves the response itself instead of an origin server.
+ *
+ * Traffic Server hands the request to the plugin as if the plugin were the origin: the request body is
+ * streamed to consume() and the plugin writes the response with produce(), its status and headers set through
+ * getResponse(). This is much cheaper than Transaction::error() for endpoints such as health checks and
+ * beacons, nothing goes through the error path and the body isn't copied into a new allocation.
+ *
+ * An InterceptPlugin must be created from HOOK_READ_REQUEST_HEADERS_PRE_REMAP or
+ * HOOK_READ_REQUEST_HEADERS_POST_REMAP, before Traffic Server connects to the origin.
+ *
+ * \code
+ * class HealthCheck : public InterceptPlugin {
+ * public:
+ *   HealthCheck(Transaction &transaction) : InterceptPlugin(transaction, TRANSACTION_INTERCEPT) { }
+ *   void handleInputComplete() {
+ *     getResponse().getHeaders().set("Content-Type", "text/plain");
+ *     produce("OK\n", 3);
+ *     setOutputComplete();
+ *   }
+ * };
+ * \endcode
+ *
+ * The response headers are sent once the response is complete, with a Content-Length unless the plugin
+ * set a Content-Length or Transfer-Encoding itself, so a small response goes out in a single write. A plugin
+ * producing more than BUFFERED_BODY_LIMIT bytes streams the rest instead: the headers are sent then, and
+ * without a length the response ends by closing the connection.
+ *
+ * The request body is passed as it is received, a chunked body isn't decoded but it ends with its last
+ * chunk and trailers, or where its framing turns out malformed. produce() and setOutputComplete() may be called from any thread, e.g. from the completion of an
+ * AsyncHttpFetch.
+ */
+class InterceptPlugin : public TransactionPlugin {
+public:
+  /**
+   * The available types of interception.
+   */
+  enum Type {
+    SERVER_INTERCEPT = 0, /**< The plugin replaces the origin only, the response can be cached */
+    TRANSACTION_INTERCEPT /**< The plugin answers the client directly, the cache isn't involved */
+  };
+
+  /** The most response body bytes held until the response headers are sent. */
+  static const size_t BUFFERED_BODY_LIMIT = 64 * 1024;
+
+  virtual ~InterceptPlugin();
+
+protected:
+  /** an InterceptPlugin must implement this interface, it cannot be constructed directly */
+  InterceptPlugin(Transaction &transaction, Type type = SERVER_INTERCEPT);
+
+  /**
+   * Fired as the request body arrives, with views of the received data in the order it was sent. The view is
+   * only valid until this method returns. The default implementation ignores the body.
+   */
+  virtual void consume(const StringView &data);
+
+  /**
+   * A method that you must implement, fired once the whole request has been received.
+   */
+  virtual void handleInputComplete() = 0;
+
+  /**
+   * @return The response that is sent, a 200 OK of HTTP/1.1 until changed. It can be changed until the
+   *         headers are sent, see the class description. A reason phrase that is left empty is filled
+   *         in from the status.
+   */
+  Response &getResponse();
+
+  /**
+   * Appends to the response body, the bytes are written to the connection's buffer directly.
+   *
+   * @return The number of bytes written, 0 once the output is complete.
+   */
+  size_t produce(const char *data, size_t length);
+
+  /**
+   * @see produce(const char *data, size_t length)
+   */
+  size_t produce(const std::string &data);
+
+  /**
+   * Completes the response, sending the headers first if they haven't been.
+   *
+   * @return false if the response was already complete.
+   */
+  bool setOutputComplete();
+
+private:
+  InterceptPluginState *state_;
+  friend struct InterceptPluginState;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_INTERCEPTPLUGIN_H_ */
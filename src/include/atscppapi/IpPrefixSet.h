@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file IpPrefixSet.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_IPPREFIXSET_H_
+#define ATSCPPAPI_IPPREFIXSET_H_
+
+#include <cstddef>
+#include <string>
+#include <arpa/inet.h>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+namespace utils {
+
+// forward declarations
+struct IpPrefixSetState;
+
+/**
+ * @brief A set of IPv4 and IPv6 prefixes (CIDR blocks) that addresses are matched against.
+ *
+ * The prefixes are kept in a path compressed binary trie (a Patricia tree) per address family, so finding
+ * the longest prefix containing an address takes time proportional to that prefix's length whatever the
+ * size of the set, and works straight on a sockaddr such as Transaction::getClientAddress(); nothing is
+ * formatted or allocated. IPv4-mapped IPv6 addresses (::ffff:10.1.2.3) are matched as IPv4 addresses.
+ *
+ * Each prefix carries an int value, e.g. an allow/deny decision or a region id, the value of the longest
+ * matching prefix is returned. A set is meant to be built when the plugin is initialized; lookups don't
+ * modify it, so any number of threads can match concurrently as long as nothing is being added.
+ */
+class IpPrefixSet : noncopyable {
+public:
+  IpPrefixSet();
+  ~IpPrefixSet();
+
+  /**
+   * Adds a prefix in CIDR notation such as 10.0.0.0/8 or 2001:db8::/32, a bare address is a prefix of the
+   * whole address. Bits after the prefix length are ignored. Adding a prefix again replaces its value.
+   *
+   * @return false if the prefix couldn't be parsed, it's not added then.
+   */
+  bool add(const std::string &cidr, int value = 0);
+
+  /**
+   * Adds the first prefix_length bits of an address.
+   *
+   * @return false if the address family isn't AF_INET or AF_INET6, or prefix_length is too long for it.
+   */
+  bool add(const sockaddr *address, int prefix_length, int value = 0);
+
+  /**
+   * @return true if some prefix contains the address.
+   */
+  bool contains(const sockaddr *address) const;
+
+  /**
+   * Finds the longest prefix containing an address.
+   *
+   * @param value Receives the value of that prefix, left untouched if there's none.
+   * @return true if some prefix contains the address.
+   */
+  bool find(const sockaddr *address, int &value) const;
+
+  /**
+   * @return Number of distinct prefixes added.
+   */
+  size_t size() const;
+
+  void clear();
+private:
+  IpPrefixSetState *state_;
+};
+
+}
+}
+
+#endif /* ATSCPPAPI_IPPREFIXSET_H_ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file LogRecord.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_LOGRECORD_H_
+#define ATSCPPAPI_LOGRECORD_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+namespace atscppapi {
+
+/**
+ * @brief A structured log record made of typed key/value fields, written with Logger::logRecord().
+ *
+ * Building a record doesn't involve any printf formatting, the fields are encoded as they are added.
+ * Depending on Logger::setRecordFormat() a record is written as a line of JSON or in a compact binary form,
+ * the atscppapi_logdecode tool shipped with the library turns a binary log back into JSON lines.
+ *
+ * A binary record is a line made of a 0x1E marker followed by the escaped encoding of the record, so that it
+ * passes through the text log: 0x00, 0x0A and 0x1B are written as 0x1B followed by 0x30, 0x31 and 0x1B.
+ * Unescaped, a record is a varint length of the rest, a version byte, the varint number of fields and then
+ * per field a type byte ('s', 'i', 'd' or 'b'), the varint length of the key, the key and the value: a varint
+ * length and the bytes of a string, a zigzag varint integer, a little endian IEEE double or a byte of 0 or 1.
+ * Anything before the marker, such as the timestamp added by the log, is ignored when decoding.
+ *
+ * \code
+ * LogRecord record;
+ * record.addString("url", url).addInt("status", 200).addDouble("ttfb_ms", 1.25);
+ * access_log.logRecord(record);
+ * \endcode
+ */
+class LogRecord {
+public:
+  /**
+   * The forms a record can be written in.
+   */
+  enum Format {
+    FORMAT_BINARY = 0, /**< The compact binary form described above */
+    FORMAT_JSON /**< A JSON object per line */
+  };
+
+  LogRecord();
+
+  LogRecord &addString(const std::string &key, const std::string &value);
+  LogRecord &addString(const std::string &key, const char *value, size_t length);
+  LogRecord &addInt(const std::string &key, int64_t value);
+  LogRecord &addDouble(const std::string &key, double value);
+  LogRecord &addBool(const std::string &key, bool value);
+
+  /**
+   * @return The number of fields added.
+   */
+  size_t getFieldCount() const { return field_count_; }
+
+  /**
+   * Removes all fields so the record can be reused without reallocating.
+   */
+  void clear();
+
+  /**
+   * Appends the record in the given format to out, without a trailing newline.
+   */
+  void serialize(Format format, std::string &out) const;
+
+  /**
+   * Decodes a line holding a binary record into a JSON object.
+   *
+   * @param line the line, with or without its trailing newline.
+   * @param json the JSON object is appended to this.
+   * @return false if the line doesn't hold a valid binary record.
+   */
+  static bool decodeToJson(const char *line, size_t length, std::string &json);
+
+private:
+  std::string fields_;
+  size_t field_count_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_LOGRECORD_H_ */
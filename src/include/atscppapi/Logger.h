@@ -26,8 +26,11 @@
 #ifndef ATSCPPAPI_LOGGER_H_
 #define ATSCPPAPI_LOGGER_H_
 
+#include <stdint.h>
+#include <cstddef>
 #include <string>
 #include <atscppapi/noncopyable.h>
+#include <atscppapi/LogRecord.h>
 
 #if !defined(ATSCPPAPI_PRINTFLIKE)
 #if defined(__GNUC__) || defined(__clang__)
@@ -52,10 +55,13 @@
  *  LOG_DEBUG(logger, "This is a test DEBUG message: %s", "hello");
  *  // Outputs [file.cc:125, function()] [DEBUG] This is a test DEBUG message: hello.
  * \endcode
+ * The arguments are only evaluated when the level is enabled, as with all the macros below.
  */
 #define LOG_DEBUG(log, fmt, ...) \
   do { \
-    (log).logDebug("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    if ((log).isLevelEnabled(atscppapi::Logger::LOG_LEVEL_DEBUG)) { \
+      (log).logDebug("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
   } while (false)
 
 /**
@@ -64,7 +70,9 @@
  */
 #define LOG_INFO(log, fmt, ...) \
   do { \
-    (log).logInfo("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    if ((log).isLevelEnabled(atscppapi::Logger::LOG_LEVEL_INFO)) { \
+      (log).logInfo("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
   } while (false)
 
 /**
@@ -73,7 +81,76 @@
  */
 #define LOG_ERROR(log, fmt, ...) \
   do { \
-    (log).logError("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    if ((log).isLevelEnabled(atscppapi::Logger::LOG_LEVEL_ERROR)) { \
+      (log).logError("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
+  } while (false)
+
+/**
+ * Like LOG_ERROR() but writes at most per_second messages a second from this call site, the rest are
+ * counted and the count is written once the next second starts. This bounds the cost of logging when
+ * something fails for every request.
+ * \code
+ *  LOG_ERROR_RATE_LIMITED(logger, 10, "Origin %s failed: %d", host.c_str(), status);
+ *  // Outputs [file.cc:125] [INFO] suppressed 4212 messages over the limit of 10 per second.
+ * \endcode
+ */
+#define LOG_ERROR_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_RATE_LIMITED(log, LOG_LEVEL_ERROR, logError, per_second, fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_INFO() but rate limited per call site, see LOG_ERROR_RATE_LIMITED().
+ */
+#define LOG_INFO_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_RATE_LIMITED(log, LOG_LEVEL_INFO, logInfo, per_second, fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_DEBUG() but rate limited per call site, see LOG_ERROR_RATE_LIMITED().
+ */
+#define LOG_DEBUG_RATE_LIMITED(log, per_second, fmt, ...) \
+  ATSCPPAPI_LOG_RATE_LIMITED(log, LOG_LEVEL_DEBUG, logDebug, per_second, fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_ERROR() but only writes about one in one_in messages, picked at random.
+ * \code
+ *  LOG_ERROR_SAMPLED(logger, 100, "Slow origin %s took %d ms", host.c_str(), elapsed_ms);
+ * \endcode
+ */
+#define LOG_ERROR_SAMPLED(log, one_in, fmt, ...) \
+  ATSCPPAPI_LOG_SAMPLED(log, LOG_LEVEL_ERROR, logError, one_in, fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_INFO() but sampled, see LOG_ERROR_SAMPLED().
+ */
+#define LOG_INFO_SAMPLED(log, one_in, fmt, ...) \
+  ATSCPPAPI_LOG_SAMPLED(log, LOG_LEVEL_INFO, logInfo, one_in, fmt, ## __VA_ARGS__)
+
+/**
+ * Like LOG_DEBUG() but sampled, see LOG_ERROR_SAMPLED().
+ */
+#define LOG_DEBUG_SAMPLED(log, one_in, fmt, ...) \
+  ATSCPPAPI_LOG_SAMPLED(log, LOG_LEVEL_DEBUG, logDebug, one_in, fmt, ## __VA_ARGS__)
+
+/**
+ * @private
+ */
+#define ATSCPPAPI_LOG_RATE_LIMITED(log, level, method, per_second, fmt, ...) \
+  do { \
+    static atscppapi::LogRateLimit atscppapi_log_rate_limit = { (per_second), 0, 0, 0 }; \
+    if ((log).isLevelEnabled(atscppapi::Logger::level) && \
+        (log).checkRateLimit(atscppapi_log_rate_limit, __FILE__, __LINE__)) { \
+      (log).method("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
+  } while (false)
+
+/**
+ * @private
+ */
+#define ATSCPPAPI_LOG_SAMPLED(log, level, method, one_in, fmt, ...) \
+  do { \
+    if ((log).isLevelEnabled(atscppapi::Logger::level) && atscppapi::Logger::sample(one_in)) { \
+      (log).method("[%s:%d, %s()] " fmt, __FILE__, __LINE__, __FUNCTION__, ## __VA_ARGS__); \
+    } \
   } while (false)
 
 /**
@@ -125,6 +202,18 @@ namespace atscppapi {
 
 class LoggerState;
 
+/**
+ * @private
+ *
+ * The state of a call site of the rate limited logging macros, a POD so it's initialized statically.
+ */
+struct LogRateLimit {
+  int per_second_;
+  volatile int64_t window_; // the second which count_ is for.
+  volatile int count_;
+  volatile int64_t suppressed_;
+};
+
 /**
  * @brief Create log files that are automatically rolled and cleaned up as space is required.
  *
@@ -164,6 +253,15 @@ public:
     LOG_LEVEL_ERROR = 4 /**< This log level is used for ERROR level logging (ERROR ONLY) */
   };
 
+  /**
+   * What happens to a message when the buffer of an asynchronous Logger is full.
+   * @see enableAsyncWrites()
+   */
+  enum OverflowPolicy {
+    OVERFLOW_DROP = 0, /**< The message is dropped and counted, see getDroppedRecordCount() */
+    OVERFLOW_BLOCK /**< The logging thread waits until the flusher has made room */
+  };
+
   Logger();
   ~Logger();
 
@@ -220,6 +318,45 @@ public:
    */
   Logger::LogLevel getLogLevel() const;
 
+  /**
+   * Moves writing to the log off the logging threads. Each thread formats its messages into a
+   * buffer of its own without taking a lock and a single flusher on a task thread writes out the buffered
+   * messages every flush interval, several per write when no timestamps are added. Messages therefore show
+   * up in the log up to the flush interval late and are only ordered per thread.
+   *
+   * @param buffer_size the size of the buffer of each thread in bytes, rounded up to a power of two.
+   * @param overflow_policy what to do with a message that doesn't fit in the buffer, see OverflowPolicy.
+   * @param flush_interval_ms how often the buffers are written out.
+   * @return true if asynchronous writes were enabled, the logger must have been initialized first.
+   */
+  bool enableAsyncWrites(size_t buffer_size = 256*1024, OverflowPolicy overflow_policy = OVERFLOW_DROP,
+                         int flush_interval_ms = 100);
+
+  /**
+   * @return The number of messages dropped because a buffer was full, see enableAsyncWrites().
+   */
+  int64_t getDroppedRecordCount() const;
+
+  /**
+   * @return true if messages of the given level are written, this is cheap enough to check before each message.
+   */
+  bool isLevelEnabled(LogLevel level) const;
+
+  /**
+   * Counts a message against a rate limit, the rate limited macros such as LOG_ERROR_RATE_LIMITED() are
+   * meant to be used instead. When a new second starts the number of messages suppressed in the previous
+   * one is written to this log.
+   *
+   * @return true if the message is within the limit and should be written.
+   */
+  bool checkRateLimit(LogRateLimit &limit, const char *file, int line);
+
+  /**
+   * @return true for about one in one_in calls, picked at random per thread. This is what the sampled
+   *         macros such as LOG_ERROR_SAMPLED() use.
+   */
+  static bool sample(unsigned int one_in);
+
   /**
    * This method allows you to flush any log lines that might have been buffered.
    * @warning This method can cause serious performance degredation so you should only
@@ -252,6 +389,21 @@ public:
    * will produce a much more rich error message.
    */
   void logError(const char *fmt, ...) ATSCPPAPI_PRINTFLIKE(2,3);
+
+  /**
+   * Chooses how logRecord() writes records, the binary form by default.
+   * @see LogRecord
+   */
+  void setRecordFormat(LogRecord::Format format);
+
+  /**
+   * Writes a structured record as a line of its own, without any printf formatting and without a level prefix.
+   *
+   * @param record the fields to write.
+   * @param level the record is only written when the log level is at or below this.
+   * @see setRecordFormat()
+   */
+  void logRecord(const LogRecord &record, LogLevel level = LOG_LEVEL_INFO);
 private:
   LoggerState *state_; /**< Internal state for the Logger */
 };
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file MemoryAccounting.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_MEMORYACCOUNTING_H_
+#define ATSCPPAPI_MEMORYACCOUNTING_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+// forward declarations
+class Transaction;
+class Plugin;
+struct MemoryAccountingState;
+struct TransactionMemoryState;
+namespace utils { class internal; }
+
+/**
+ * @brief Records how much memory transactions and plugins take from the transaction's Arena, into HistogramStats.
+ *
+ * Transactions picked with startAccounting() record, when they close:
+ *  - name.transaction.arena_bytes, the bytes allocated from the transaction's Arena, see Arena::getBytesAllocated()
+ *  - name.transaction.arena_allocations, the number of those allocations
+ *  - name.transaction.heap_bytes, the bytes the Arena took from the heap beyond its first block
+ *  - name.transaction.peak_buffered_bytes, the most output any of its transformations had waiting downstream
+ *
+ * Plugins attached with Plugin::setMemoryAccounting() record, for every transaction their hooks ran in:
+ *  - name.plugin.arena_bytes and name.plugin.arena_allocations, what their hook handlers allocated from the
+ *    transaction's Arena: the requests, responses and context values they created and their own Arena::create()
+ *
+ * Memory a plugin allocates with new or malloc isn't seen. A plugin whose share keeps growing is likely keeping
+ * something per transaction it shouldn't. With the debug tag atscppapi.memory set every accounted transaction
+ * logs its totals and the share of each plugin when it closes.
+ *
+ * Like HookTiming a MemoryAccounting is created once, in TSPluginInit(), and must outlive the transactions
+ * and plugins it accounts.
+ *
+ * \code
+ * MemoryAccounting *accounting = new MemoryAccounting("my_plugin");
+ * ...
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   accounting->startAccounting(transaction);
+ *   transaction.addPlugin(new MyTransactionPlugin(transaction)); // which calls setMemoryAccounting(accounting)
+ *   transaction.resume();
+ * }
+ * \endcode
+ */
+class MemoryAccounting : noncopyable {
+public:
+  /**
+   * @param name The prefix of the names of the stats, usually the plugin's name.
+   * @param aggregation_interval_ms How often the percentiles are computed, see HistogramStat::init().
+   */
+  MemoryAccounting(const std::string &name, int aggregation_interval_ms = 10000);
+
+  /**
+   * Records the totals of transaction when it closes, into the stats of this MemoryAccounting.
+   * A transaction is accounted once, later calls for it are ignored.
+   */
+  void startAccounting(Transaction &transaction);
+
+  ~MemoryAccounting();
+private:
+  static TransactionMemoryState *getTransactionMemory(Transaction &transaction);
+  static void recordPluginMemory(Transaction &transaction, MemoryAccounting *accounting, const Plugin *plugin,
+                                 size_t arena_bytes, size_t arena_allocations);
+  static bool isAccounted(Transaction &transaction);
+  static void recordBufferedBytes(Transaction &transaction, int64_t peak_buffered_bytes);
+  static void finishTransaction(Transaction &transaction);
+  MemoryAccountingState *state_;
+  friend class utils::internal;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_MEMORYACCOUNTING_H_ */
@@ -25,10 +25,16 @@
 #define ATSCPPAPI_PLUGIN_H_
 
 #include <atscppapi/Transaction.h>
+#include <atscppapi/StringView.h>
 #include <atscppapi/noncopyable.h>
 
 namespace atscppapi {
 
+// forward declarations
+class HookTiming;
+class MemoryAccounting;
+namespace utils { class internal; }
+
 /**
  * @brief The base interface used when creating a Plugin.
  *
@@ -51,7 +57,8 @@ public:
     HOOK_SEND_REQUEST_HEADERS, /**< This hook will be fired right before request headers are sent to the origin */
     HOOK_READ_RESPONSE_HEADERS, /**< This hook will be fired right after response headers have been read from the origin */
     HOOK_SEND_RESPONSE_HEADERS, /**< This hook will be fired right before the response headers are sent to the client */
-    HOOK_OS_DNS /**< This hook will be fired right after the OS DNS lookup */
+    HOOK_OS_DNS, /**< This hook will be fired right after the OS DNS lookup */
+    HOOK_CACHE_LOOKUP_COMPLETE /**< This hook will be fired right after the cache lookup, see Transaction::getCacheStatus() */
   };
 
   /**
@@ -84,6 +91,27 @@ public:
    */
   virtual void handleOsDns(Transaction &transaction) { transaction.resume(); };
 
+  /**
+   * This method must be implemented when you hook HOOK_CACHE_LOOKUP_COMPLETE
+   */
+  virtual void handleCacheLookupComplete(Transaction &transaction) { transaction.resume(); };
+
+  /**
+   * Measures the hooks of this plugin into timing, NULL (the default) to stop. The HookTiming must outlive
+   * the plugin.
+   *
+   * @see HookTiming
+   */
+  void setHookTiming(HookTiming *timing) { hook_timing_ = timing; }
+
+  /**
+   * Accounts what the hooks of this plugin allocate from the transaction's Arena into accounting, NULL (the
+   * default) to stop. The MemoryAccounting must outlive the plugin.
+   *
+   * @see MemoryAccounting
+   */
+  void setMemoryAccounting(MemoryAccounting *accounting) { memory_accounting_ = accounting; }
+
   virtual ~Plugin() { };
 protected:
   /**
@@ -92,12 +120,22 @@ protected:
   *
   * @private
   */
-  Plugin() { };
+  Plugin() : hook_timing_(NULL), memory_accounting_(NULL) { };
+private:
+  HookTiming *hook_timing_;
+  MemoryAccounting *memory_accounting_;
+  friend class utils::internal;
 };
 
 /**< Human readable strings for each HookType, you can access them as HOOK_TYPE_STRINGS[HOOK_OS_DNS] for example. */
 extern const std::string HOOK_TYPE_STRINGS[];
 
+/**
+ * @return The name of hook_type, e.g. "HOOK_OS_DNS", a view of a null terminated string literal.
+ * @see getHttpMethodName()
+ */
+StringView getHookTypeName(Plugin::HookType hook_type);
+
 } /* atscppapi */
 
 #endif /* ATSCPPAPI_GLOBALPLUGIN_H_ */
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Prefetcher.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_PREFETCHER_H_
+#define ATSCPPAPI_PREFETCHER_H_
+
+#include <cstddef>
+#include <string>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/AsyncHttpFetch.h>
+#include <atscppapi/Stat.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct PrefetcherState;
+class Transaction;
+class Headers;
+
+/**
+ * @brief Warms the cache with objects a plugin predicts are requested next, such as the next segment of
+ * a HLS or DASH playlist or the assets linked from a HTML page, so the client's next request is a hit.
+ *
+ * Hints are typically given from a response hook. Each hint is fetched through Traffic Server with an
+ * AsyncHttpFetch, unless the same url is already being prefetched or was prefetched within the last
+ * few seconds, its origin is over its rate limit or too many prefetches are in flight. The prefetch
+ * carries the headers of the client request that select the variant cached, User-Agent, Accept,
+ * Accept-Encoding and Accept-Language by default; anything else, like Cookie, only if it's added with
+ * addForwardedHeader().
+ *
+ * Prefetches are internal requests, hints given for the transactions of prefetches are ignored so a
+ * prefetch never triggers more of them. A prefetcher is meant to be shared by every Transaction, it is
+ * thread safe and it must outlive all of its fetches, usually it's created in TSPluginInit() and never
+ * destroyed.
+ *
+ * \code
+ * Prefetcher *prefetcher = new Prefetcher();
+ *
+ * void handleReadResponseHeaders(Transaction &transaction) {
+ *   prefetcher->addLinkHints(transaction, transaction.getServerResponse().getHeaders());
+ *   transaction.resume();
+ * }
+ * \endcode
+ */
+class Prefetcher : noncopyable {
+public:
+  /**
+   * @brief The limits of a prefetcher.
+   */
+  struct Options {
+    double origin_rate_; /**< Prefetches each origin gets per second in the long run, 10 by default */
+    int origin_burst_; /**< Prefetches an idle origin can get at once, 20 by default */
+    size_t max_in_flight_; /**< Prefetches in flight at most, 256 by default, further hints are dropped */
+    int recent_ttl_ms_; /**< Milliseconds a prefetched url isn't fetched again for, 30000 by default */
+    size_t recent_max_bytes_; /**< Memory used at most to remember the recently prefetched urls, 1MB by default */
+    AsyncHttpFetch::Options fetch_options_; /**< How the prefetches are made, they can't stream */
+    Options() : origin_rate_(10.0), origin_burst_(20), max_in_flight_(256), recent_ttl_ms_(30000),
+                recent_max_bytes_(1024 * 1024) { }
+  };
+
+  Prefetcher(const Options &options = Options());
+
+  enum HintResult {
+    HINT_ISSUED = 0, /**< A prefetch was started */
+    HINT_DUPLICATE, /**< The url is being prefetched or was prefetched recently */
+    HINT_RATE_LIMITED, /**< The origin is over its rate or too many prefetches are in flight */
+    HINT_REJECTED /**< The url isn't a http(s) url or the transaction is a prefetch itself */
+  };
+
+  /**
+   * Adds a request header that is copied from the client request to the prefetches, if present there.
+   * Must be called before any hint is given.
+   */
+  void addForwardedHeader(const std::string &name);
+
+  /**
+   * Counts the hints into stats, each of them may be NULL. The stats must outlive the prefetcher.
+   */
+  void setStats(Stat *issued, Stat *duplicates, Stat *rate_limited);
+
+  /**
+   * Prefetches url, unless it's a duplicate or over the limits.
+   *
+   * @param transaction The transaction the hint is from, its client request gives the forwarded headers and
+   *                    the base a relative url is resolved against.
+   * @param url An absolute url, or one relative to the client request's url like a playlist's segment.
+   */
+  HintResult addHint(Transaction &transaction, const std::string &url);
+
+  /**
+   * Gives a hint for each url in the Link headers of headers whose rel is prefetch or preload, e.g.
+   * <tt>Link: </seg/42.ts>; rel=prefetch</tt>.
+   *
+   * @return The number of prefetches started.
+   */
+  size_t addLinkHints(Transaction &transaction, Headers &headers);
+
+  /** @return The number of prefetches in flight. */
+  size_t getInFlightCount() const;
+
+  ~Prefetcher();
+private:
+  PrefetcherState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_PREFETCHER_H_ */
@@ -22,9 +22,13 @@
 
 #include "atscppapi/Transaction.h"
 #include "atscppapi/Url.h"
+#include "atscppapi/RemapRequest.h"
 
 namespace atscppapi {
 
+// forward declarations
+class RemapRuleSet;
+
 /** 
  * @brief Base class that remap plugins should extend.
  */
@@ -37,6 +41,19 @@ public:
    */
   RemapPlugin(void **instance_handle);
 
+  /**
+   * Delegates remapping to a compiled RemapRuleSet: a request matching one of its rules is remapped by the
+   * library without building a Url or Transaction, doRemap() is only called for requests no rule matches.
+   *
+   * @param rules the rules, which must outlive the plugin, NULL to stop delegating.
+   */
+  void setRemapRules(const RemapRuleSet *rules) { remap_rules_ = rules; }
+
+  /**
+   * @return The rules set with setRemapRules(), NULL if there are none.
+   */
+  const RemapRuleSet *getRemapRules() const { return remap_rules_; }
+
   enum Result { RESULT_ERROR = 0, RESULT_NO_REMAP, RESULT_DID_REMAP, RESULT_NO_REMAP_STOP,
                 RESULT_DID_REMAP_STOP };
 
@@ -57,7 +74,22 @@ public:
     return RESULT_NO_REMAP;
   }
 
+  /**
+   * Invoked when a request matches the remap.config line, before doRemap(). Overriding this instead
+   * of doRemap() lets a plugin read and rewrite the request URL in place without the library building
+   * Url objects and the Transaction for every request, see RemapRequest.
+   *
+   * The default implementation builds them and calls doRemap().
+   *
+   * @param request The request being remapped, only valid for the duration of the call.
+   *
+   * @return Result of the remap - will dictate futher processing by the system.
+   */
+  virtual Result doRemapRequest(RemapRequest &request);
+
   virtual ~RemapPlugin() { }
+private:
+  const RemapRuleSet *remap_rules_;
 };
 
 }
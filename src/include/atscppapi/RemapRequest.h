@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RemapRequest.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_REMAPREQUEST_H_
+#define ATSCPPAPI_REMAPREQUEST_H_
+
+#include <cstddef>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/StringView.h>
+
+namespace atscppapi {
+
+// forward declarations
+class Transaction;
+
+/**
+ * @brief A lightweight view of a request being remapped, see RemapPlugin::doRemapRequest().
+ *
+ * The getters return views straight into the Traffic Server URLs, nothing is copied, and the setters change
+ * the request URL in place. A view is only valid until the URL component it came from is set. The
+ * Transaction, with its Url and header objects, is only built if getTransaction() is called, so a plugin
+ * that only rewrites URLs never pays for it.
+ *
+ * Paths and queries are without their leading / and ?, as Traffic Server URLs hold them.
+ */
+class RemapRequest : noncopyable {
+public:
+  /**
+   * @private
+   */
+  RemapRequest(void *remap_request_info, void *txn);
+
+  StringView getScheme() const;
+  StringView getHost() const;
+  /** @return the port of the request URL, the scheme's default when it has none. */
+  int getPort() const;
+  StringView getPath() const;
+  StringView getQuery() const;
+
+  void setScheme(const StringView &scheme);
+  void setHost(const StringView &host);
+  void setPort(int port);
+  void setPath(const StringView &path);
+  void setQuery(const StringView &query);
+
+  /** The URLs of the remap.config line. */
+  StringView getMapFromHost() const;
+  StringView getMapFromPath() const;
+  StringView getMapToScheme() const;
+  StringView getMapToHost() const;
+  int getMapToPort() const;
+  StringView getMapToPath() const;
+
+  /**
+   * Makes Traffic Server send the remapped URL to the client as a redirect.
+   */
+  void setRedirect(bool redirect);
+
+  bool isRedirect() const;
+
+  /**
+   * @return The Transaction, built on the first call.
+   */
+  Transaction &getTransaction();
+
+  /**
+   * @private
+   */
+  void *getRemapRequestInfo() const { return rri_; }
+
+private:
+  void *rri_;
+  void *txn_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_REMAPREQUEST_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RemapRuleSet.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_REMAPRULESET_H_
+#define ATSCPPAPI_REMAPRULESET_H_
+
+#include <cstddef>
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct RemapRuleSetState;
+
+/**
+ * @brief A compiled set of remap rules, matched in time proportional to the length of the path.
+ *
+ * A rule maps requests for a host and path pattern, optionally requiring a query parameter, to a target URL:
+ *  - the host is exact (origin.example.com), a suffix wildcard (*.example.com) or any host (*), matched
+ *    without regard to case; exact hosts win over the longest wildcard, which wins over *.
+ *  - the path is exact (/index.html), a prefix ending in * or a glob with * anywhere else. Everything up to
+ *    the first * is a literal prefix kept in a trie per host, the rest is matched as a glob; the rule with the
+ *    longest literal prefix wins and among those the one added first.
+ *  - the query, e.g. ?debug or ?version=2, requires a parameter with that name and optionally that value.
+ *
+ * When a rule matches the scheme, host and port of the request become those of the target and the literal
+ * prefix of the path is replaced by the target's path, so mapping the prefix /images/ to
+ * http://cdn.example.com/img/ maps /images/a.png to http://cdn.example.com/img/a.png.
+ *
+ * Rules are added once, in TSRemapNewInstance(), and then compile()d; matching allocates nothing and doesn't
+ * lock, so a RemapRuleSet can hold thousands of rules. See RemapPlugin::setRemapRules().
+ *
+ * \code
+ * TSReturnCode TSRemapNewInstance(int argc, char *argv[], void **instance_handle, char *errbuf, int errbuf_size) {
+ *   MyRemapPlugin *plugin = new MyRemapPlugin(instance_handle);
+ *   std::string error;
+ *   if (!plugin->rules_.addRules(argc - 2, argv + 2, error)) { // the @pparams, see addRules()
+ *     snprintf(errbuf, errbuf_size, "%s", error.c_str());
+ *     return TS_ERROR;
+ *   }
+ *   plugin->rules_.compile();
+ *   plugin->setRemapRules(&plugin->rules_);
+ *   return TS_SUCCESS;
+ * }
+ * \endcode
+ */
+class RemapRuleSet : noncopyable {
+public:
+  /**
+   * Options of a rule.
+   */
+  enum Flags {
+    FLAG_NONE = 0,
+    FLAG_REDIRECT = 1, /**< The target is sent to the client as a redirect */
+    FLAG_STOP = 2 /**< No further remap plugins run after this one */
+  };
+
+  /**
+   * @brief A rule as it was added, with its target split up.
+   */
+  struct Rule {
+    int id_; /**< The index of the rule in the order rules were added */
+    unsigned int flags_;
+    std::string target_scheme_;
+    std::string target_host_;
+    int target_port_; /**< 0 when the target has no port */
+    std::string target_path_; /**< without the leading / */
+    size_t prefix_length_; /**< the length of the literal prefix of the path pattern, which is replaced */
+  };
+
+  RemapRuleSet();
+  ~RemapRuleSet();
+
+  /**
+   * Adds a rule, rules can only be added before compile().
+   *
+   * @param from host, path pattern and optional query, e.g. *.example.com/index.html?v=2
+   * @param to the target URL, e.g. http://static.example.com:8080/
+   * @param flags a combination of Flags.
+   * @return the id of the rule, -1 if the rule is invalid.
+   */
+  int addRule(const std::string &from, const std::string &to, unsigned int flags = FLAG_NONE);
+
+  /**
+   * Adds a rule per argument, of the form from=>to with optional ;redirect and ;stop suffixes, as they are
+   * passed to TSRemapNewInstance() as @pparam arguments.
+   *
+   * @param error set to a description of the first invalid argument.
+   * @return false if an argument is invalid.
+   */
+  bool addRules(int argc, char *argv[], std::string &error);
+
+  /**
+   * Builds the tries, after which rules can be matched.
+   */
+  void compile();
+
+  /**
+   * @return The rule matching a request, NULL if none does. The path and query are without their leading
+   *         / and ?, as Traffic Server URLs hold them.
+   */
+  const Rule *match(const char *host, size_t host_length, const char *path, size_t path_length,
+                    const char *query, size_t query_length) const;
+
+  size_t getRuleCount() const;
+
+private:
+  RemapRuleSetState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_REMAPRULESET_H_ */
@@ -55,6 +55,26 @@ public:
   /** @return Headers of the request */
   Headers &getHeaders() const;
 
+  /**
+   * @return Exact number of bytes serializeHead() writes.
+   */
+  size_t getSerializedHeadSize();
+
+  /**
+   * Writes the request line, the headers and the blank line ending them to buffer in one pass,
+   * e.g. to issue a fetch or to log the request.
+   *
+   * @param buffer Where to write; nothing is null terminated.
+   * @param buffer_length Size of buffer, at least getSerializedHeadSize() for anything to be written.
+   * @return Number of bytes written, 0 if the head doesn't fit.
+   */
+  size_t serializeHead(char *buffer, size_t buffer_length);
+
+  /**
+   * Appends the request line, headers and blank line to output, allocating at most once.
+   */
+  void serializeHead(std::string &output);
+
   ~Request();
 private:
   Request(void *hdr_buf, void *hdr_loc);
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file RequestBodyInspector.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_REQUESTBODYINSPECTOR_H_
+#define ATSCPPAPI_REQUESTBODYINSPECTOR_H_
+
+#include <string>
+#include <atscppapi/TransformationPlugin.h>
+#include <atscppapi/HttpStatus.h>
+#include <atscppapi/StringView.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct RequestBodyInspectorState;
+
+/**
+ * @brief A request transformation that looks at the request body as it streams to the origin.
+ *
+ * The body is forwarded unchanged and by reference, inspect() only gets views of the data blocks so
+ * nothing is buffered or copied however large the body is. Once the plugin has seen enough it calls
+ * stopInspecting() (or sets an inspection limit) and the rest of the body is passed through without
+ * calling the plugin again. If the body must not reach the origin, reject() fails the transformation and
+ * the client gets an error response with the given status instead.
+ *
+ * \code
+ * class UploadScanner : public RequestBodyInspector {
+ * public:
+ *   UploadScanner(Transaction &transaction) : RequestBodyInspector(transaction, 64 * 1024) { }
+ *   void inspect(const StringView &data) {
+ *     if (data.find('\0') != StringView::npos) { // only text uploads are allowed
+ *       reject(HTTP_STATUS_FORBIDDEN);
+ *     }
+ *   }
+ * };
+ * \endcode
+ *
+ * \note Data already forwarded stays forwarded, a rejection aborts the request the origin is receiving.
+ */
+class RequestBodyInspector : public TransformationPlugin {
+public:
+  virtual ~RequestBodyInspector();
+
+  /**
+   * @return The number of body bytes handed to inspect() so far.
+   */
+  size_t getInspectedLength() const;
+
+  /**
+   * @return true if reject() has been called.
+   */
+  bool isRejected() const;
+
+protected:
+  /**
+   * @param transaction the transaction whose request body is inspected.
+   * @param inspection_limit the most body bytes handed to inspect(), 0 for the whole body.
+   */
+  RequestBodyInspector(Transaction &transaction, size_t inspection_limit = 0);
+
+  /**
+   * A method that you must implement, fired with views of the request body in order. The view is only
+   * valid until this method returns.
+   */
+  virtual void inspect(const StringView &data) = 0;
+
+  /**
+   * Fired once inspection is done: the body ended, the inspection limit was reached or stopInspecting()
+   * was called. It isn't fired after reject(). The default implementation does nothing.
+   */
+  virtual void handleInspectionComplete();
+
+  /**
+   * Stops calling inspect(), the rest of the body is forwarded without the plugin seeing it.
+   */
+  void stopInspecting();
+
+  /**
+   * Refuses the request, e.g. with HTTP_STATUS_REQUEST_ENTITY_TOO_LARGE or HTTP_STATUS_FORBIDDEN, nothing
+   * more of the body is forwarded.
+   *
+   * @param status the status of the response sent to the client.
+   * @param body the body of that response, the default error body of Traffic Server when empty.
+   */
+  void reject(HttpStatus status, const std::string &body = "");
+
+private:
+  void consume(InputBuffer &input);
+  void handleInputComplete();
+  void handleSendResponseHeaders(Transaction &transaction);
+  void completeInspection();
+  RequestBodyInspectorState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_REQUESTBODYINSPECTOR_H_ */
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file Session.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_SESSION_H_
+#define ATSCPPAPI_SESSION_H_
+
+#include <cstddef>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/SessionPlugin.h>
+
+namespace atscppapi {
+
+namespace utils {
+ class internal;
+} /* utils */
+
+/**
+ * @private
+ */
+struct SessionState;
+
+/**
+ * @brief A client session, the connection that one or more transactions arrive on.
+ *
+ * The Session of a transaction is reached with Transaction::getSession(), or is handed to
+ * GlobalPlugin::handleSessionStart(). It is created the first time it is asked for and lives until the
+ * session closes, when its SessionPlugins are destroyed in the reverse order they were added.
+ *
+ * @see SessionPlugin
+ */
+class Session : noncopyable {
+public:
+  /**
+   * Returns the TSHttpSsn of this Session
+   *
+   * @return a void * which can be cast back to a TSHttpSsn.
+   */
+  void *getAtsHandle() const;
+
+  /**
+   * Adds a SessionPlugin, which the Session owns from now on and destroys when the session closes.
+   */
+  void addPlugin(SessionPlugin *plugin);
+
+  /**
+   * @return The number of SessionPlugins added.
+   */
+  size_t getPluginCount() const;
+
+  /**
+   * @return The SessionPlugin added index-th, in the order they were added.
+   */
+  SessionPlugin *getPlugin(size_t index) const;
+
+  /**
+   * @return The first SessionPlugin added that is a T, NULL if there is none.
+   */
+  template <typename T> T *findPlugin() const {
+    for (size_t i = 0, count = getPluginCount(); i < count; ++i) {
+      T *plugin = dynamic_cast<T *>(getPlugin(i));
+      if (plugin) {
+        return plugin;
+      }
+    }
+    return NULL;
+  }
+
+  /**
+   * @return How many transactions asked for this Session so far, including the current one.
+   */
+  unsigned int getTransactionCount() const;
+
+private:
+  Session(void *ats_session);
+  ~Session();
+  void countTransaction();
+  SessionState *state_; /**< The internal state for a Session */
+  friend class utils::internal;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_SESSION_H_ */
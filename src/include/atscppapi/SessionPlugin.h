@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file SessionPlugin.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_SESSIONPLUGIN_H_
+#define ATSCPPAPI_SESSIONPLUGIN_H_
+
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+class Session;
+
+/**
+ * @brief The base of state kept for a client session, across the transactions of a keep-alive or HTTP/2 connection.
+ *
+ * Work that depends only on the client connection, such as parsing a client certificate, a geo lookup of the
+ * client address or decoding a session token, can be done once per session instead of once per transaction
+ * by keeping its result in a SessionPlugin. A SessionPlugin is added with Session::addPlugin(), usually from
+ * GlobalPlugin::handleSessionStart() or by the first transaction needing it, and is destroyed when the session
+ * closes.
+ *
+ * \code
+ * class ClientGeo : public SessionPlugin {
+ * public:
+ *   ClientGeo(Session &session, const std::string &country) : SessionPlugin(session), country_(country) { }
+ *   const std::string &getCountry() const { return country_; }
+ * private:
+ *   std::string country_;
+ * };
+ *
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   Session &session = transaction.getSession();
+ *   ClientGeo *geo = session.findPlugin<ClientGeo>();
+ *   if (!geo) {
+ *     geo = new ClientGeo(session, lookUpCountry(transaction.getClientAddress()));
+ *     session.addPlugin(geo);
+ *   }
+ *   transaction.getClientRequest().getHeaders().set("X-Country", geo->getCountry());
+ *   transaction.resume();
+ * }
+ * \endcode
+ *
+ * The transactions of a session are handled one at a time, HTTP/2 streams included, so a SessionPlugin needs no
+ * locking as long as it's only used from their hooks.
+ *
+ * @see Session
+ */
+class SessionPlugin : noncopyable {
+public:
+  /**
+   * @return The session the plugin was created for.
+   */
+  Session &getSession() const;
+
+  virtual ~SessionPlugin();
+protected:
+  /**
+   * @param session the session the plugin keeps state for, it must still be added with Session::addPlugin().
+   */
+  explicit SessionPlugin(Session &session);
+private:
+  Session &session_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_SESSIONPLUGIN_H_ */
@@ -0,0 +1,448 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file ShardedLruCache.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_SHARDEDLRUCACHE_H_
+#define ATSCPPAPI_SHARDEDLRUCACHE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Mutex.h>
+#include <atscppapi/Stat.h>
+#include <atscppapi/StringView.h>
+
+namespace atscppapi {
+
+/**
+ * @brief The default hash of ShardedLruCache, for strings and integers.
+ *
+ * A std::string, a StringView and a null terminated string with the same characters hash alike, so a
+ * cache keyed by std::string can be looked up with any of them.
+ */
+struct ShardedLruCacheHash {
+  size_t operator()(const StringView &key) const;
+  size_t operator()(const std::string &key) const { return (*this)(StringView(key)); }
+  size_t operator()(const char *key) const { return (*this)(StringView(key)); }
+  size_t operator()(int key) const { return mix(static_cast<uint64_t>(key)); }
+  size_t operator()(unsigned int key) const { return mix(key); }
+  size_t operator()(long key) const { return mix(static_cast<uint64_t>(key)); }
+  size_t operator()(unsigned long key) const { return mix(key); }
+  size_t operator()(long long key) const { return mix(static_cast<uint64_t>(key)); }
+  size_t operator()(unsigned long long key) const { return mix(key); }
+
+  /** @return key with its bits spread over the whole word, the murmur3 finalizer. */
+  static size_t mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return static_cast<size_t>(key);
+  }
+};
+
+/**
+ * @brief The default key comparison of ShardedLruCache, a std::string key also compares with a StringView.
+ */
+struct ShardedLruCacheEqual {
+  template <typename Key, typename Lookup> bool operator()(const Key &key, const Lookup &lookup) const {
+    return key == lookup;
+  }
+  bool operator()(const std::string &key, const StringView &lookup) const { return StringView(key).equals(lookup); }
+};
+
+/**
+ * @brief What every ShardedLruCache has, whatever its key and value types.
+ */
+class ShardedLruCacheBase : noncopyable {
+public:
+  static const size_t DEFAULT_SHARD_COUNT = 16; /**< The shard count unless the constructor is given one */
+  static const int DEFAULT_TTL = -1; /**< For put(), use the cache's default time to live */
+
+  /**
+   * Counts lookups and evictions into stats, each of them may be NULL. Expired entries count as missed and evicted.
+   * The stats must outlive the cache, sharing them between caches adds their counts.
+   */
+  void setStats(Stat *hits, Stat *misses, Stat *evictions);
+
+protected:
+  ShardedLruCacheBase() : hits_(NULL), misses_(NULL), evictions_(NULL) { }
+  ~ShardedLruCacheBase() { }
+
+  /** @return The monotonic time in milliseconds that the entries expire by. */
+  static int64_t getNowMs();
+
+  /** @return count rounded up to a power of two, at least 1. */
+  static size_t roundShardCount(size_t count);
+
+  void recordLookup(bool hit) {
+    Stat *stat = hit ? hits_ : misses_;
+    if (stat) {
+      stat->increment();
+    }
+  }
+
+  void recordEvictions(size_t count) {
+    if (evictions_ && count) {
+      evictions_->increment(static_cast<int64_t>(count));
+    }
+  }
+
+private:
+  Stat *hits_;
+  Stat *misses_;
+  Stat *evictions_;
+};
+
+/**
+ * @brief A bounded in-process cache shared by all threads, with least recently used eviction and time to live.
+ *
+ * The cache is split into shards, each with its own lock, hash table and LRU list, and a key always goes to the
+ * same shard, so threads only contend when they use keys of the same shard at once. The capacity is in bytes, as
+ * charged by put(), and split evenly between the shards; a shard evicts its least recently used entries once
+ * it's over its share. Entries can expire, get() doesn't return an expired entry and drops it.
+ *
+ * Lookups are templates taking anything Hash and Equal accept, with the defaults a cache keyed by std::string is
+ * looked up with a StringView without building a string; lookups never allocate. get() copies the value out
+ * under the shard's lock, so large values are best held by shared_ptr. Evicted entries are destroyed after the lock
+ * is released.
+ *
+ * \code
+ * ShardedLruCache<std::string, shared_ptr<const Token> > tokens(64 * 1024 * 1024, 32, 60 * 1000);
+ *
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   StringView token = ...;
+ *   shared_ptr<const Token> cached;
+ *   if (!tokens.get(token, cached)) {
+ *     cached.reset(validate(token));
+ *     tokens.put(token.str(), cached, token.length() + sizeof(Token));
+ *   }
+ *   ...
+ * }
+ * \endcode
+ *
+ * @tparam K The key type, it must be copy constructible and Hash and Equal must accept it.
+ * @tparam V The value type, it must be copy constructible and assignable.
+ */
+template <typename K, typename V, typename Hash = ShardedLruCacheHash, typename Equal = ShardedLruCacheEqual>
+class ShardedLruCache : public ShardedLruCacheBase {
+public:
+  /**
+   * @param max_bytes the capacity of the cache, split evenly between the shards.
+   * @param shard_count the number of shards, rounded up to a power of two. A few times the number of threads
+   *                    using the cache keeps contention low.
+   * @param default_ttl_ms milliseconds an entry lives for unless put() says otherwise, 0 means until evicted.
+   */
+  explicit ShardedLruCache(size_t max_bytes, size_t shard_count = DEFAULT_SHARD_COUNT, int default_ttl_ms = 0)
+    : default_ttl_ms_(default_ttl_ms) {
+    shard_count = roundShardCount(shard_count);
+    shard_mask_ = shard_count - 1;
+    shard_max_bytes_ = max_bytes / shard_count;
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+      shards_.push_back(new Shard()); // separately, so the locks of different shards don't share a cache line
+    }
+  }
+
+  ~ShardedLruCache() {
+    clear();
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      delete shards_[i];
+    }
+  }
+
+  /**
+   * Looks key up and marks it as the most recently used of its shard.
+   *
+   * @param key the key, or anything Hash and Equal accept along with the key type.
+   * @param value Output argument; set to a copy of the cached value on a hit, unchanged on a miss.
+   * @return true on a hit.
+   */
+  template <typename Lookup> bool get(const Lookup &key, V &value) {
+    size_t hash = hash_(key);
+    Shard &shard = getShard(hash);
+    Entry *expired = NULL;
+    bool hit = false;
+    {
+      ScopedMutexLock lock(shard.mutex_);
+      Entry *entry = shard.find(hash, key, equal_);
+      if (entry && entry->expires_ms_ && (entry->expires_ms_ <= getNowMs())) {
+        shard.remove(entry);
+        expired = entry;
+      } else if (entry) {
+        shard.touch(entry);
+        value = entry->value_;
+        hit = true;
+      }
+    }
+    recordLookup(hit);
+    if (expired) {
+      delete expired;
+      recordEvictions(1);
+    }
+    return hit;
+  }
+
+  /**
+   * Adds an entry, replacing the one for the same key, and evicts the least recently used entries of the shard
+   * as long as it's over its share of the capacity.
+   *
+   * @param key the key.
+   * @param value the value.
+   * @param bytes what the entry counts against the capacity, typically about the memory it holds.
+   * @param ttl_ms milliseconds the entry lives for, 0 means until evicted and DEFAULT_TTL the cache's default.
+   * @return false if bytes is more than a shard can hold, the entry isn't added then.
+   */
+  bool put(const K &key, const V &value, size_t bytes, int ttl_ms = DEFAULT_TTL) {
+    if (bytes > shard_max_bytes_) {
+      return false;
+    }
+    if (ttl_ms == DEFAULT_TTL) {
+      ttl_ms = default_ttl_ms_;
+    }
+    size_t hash = hash_(key);
+    Shard &shard = getShard(hash);
+    Entry *added = new Entry(key, value, hash, bytes, (ttl_ms > 0) ? getNowMs() + ttl_ms : 0);
+    Entry *removed = NULL; // chained through bucket_next_
+    size_t eviction_count = 0;
+    {
+      ScopedMutexLock lock(shard.mutex_);
+      Entry *existing = shard.find(hash, key, equal_);
+      if (existing) {
+        shard.remove(existing);
+        existing->bucket_next_ = removed;
+        removed = existing;
+      }
+      shard.insert(added);
+      while (shard.bytes_ > shard_max_bytes_) {
+        Entry *evicted = shard.lru_tail_;
+        shard.remove(evicted);
+        evicted->bucket_next_ = removed;
+        removed = evicted;
+        ++eviction_count;
+      }
+    }
+    deleteEntries(removed);
+    recordEvictions(eviction_count);
+    return true;
+  }
+
+  /**
+   * @return true if there was an entry for key, it's removed.
+   */
+  template <typename Lookup> bool erase(const Lookup &key) {
+    size_t hash = hash_(key);
+    Shard &shard = getShard(hash);
+    Entry *entry;
+    {
+      ScopedMutexLock lock(shard.mutex_);
+      entry = shard.find(hash, key, equal_);
+      if (entry) {
+        shard.remove(entry);
+      }
+    }
+    delete entry;
+    return entry != NULL;
+  }
+
+  /**
+   * Removes every entry.
+   */
+  void clear() {
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      Shard &shard = *shards_[i];
+      Entry *removed = NULL;
+      {
+        ScopedMutexLock lock(shard.mutex_);
+        while (shard.lru_tail_) {
+          Entry *entry = shard.lru_tail_;
+          shard.remove(entry);
+          entry->bucket_next_ = removed;
+          removed = entry;
+        }
+      }
+      deleteEntries(removed);
+    }
+  }
+
+  /**
+   * @return The bytes charged by the entries in the cache, the shards are added up one after the other.
+   */
+  size_t getSize() const {
+    size_t size = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      ScopedMutexLock lock(shards_[i]->mutex_);
+      size += shards_[i]->bytes_;
+    }
+    return size;
+  }
+
+  /**
+   * @return The number of entries in the cache, expired ones that weren't looked up since included.
+   */
+  size_t getEntryCount() const {
+    size_t count = 0;
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      ScopedMutexLock lock(shards_[i]->mutex_);
+      count += shards_[i]->count_;
+    }
+    return count;
+  }
+
+  /**
+   * @return The number of shards.
+   */
+  size_t getShardCount() const {
+    return shards_.size();
+  }
+
+private:
+  struct Entry {
+    K key_;
+    V value_;
+    size_t hash_;
+    size_t bytes_;
+    int64_t expires_ms_; // 0 if it doesn't expire
+    Entry *bucket_next_;
+    Entry *lru_prev_;
+    Entry *lru_next_;
+
+    Entry(const K &key, const V &value, size_t hash, size_t bytes, int64_t expires_ms)
+      : key_(key), value_(value), hash_(hash), bytes_(bytes), expires_ms_(expires_ms), bucket_next_(NULL),
+        lru_prev_(NULL), lru_next_(NULL) { }
+  };
+
+  /** A chained hash table with a power of two size and an LRU list through the same entries. */
+  struct Shard : atscppapi::noncopyable {
+    mutable Mutex mutex_;
+    std::vector<Entry *> buckets_;
+    Entry *lru_head_; // the most recently used
+    Entry *lru_tail_;
+    size_t bytes_;
+    size_t count_;
+
+    Shard() : buckets_(INITIAL_BUCKET_COUNT, static_cast<Entry *>(NULL)), lru_head_(NULL), lru_tail_(NULL),
+              bytes_(0), count_(0) { }
+
+    Entry *&getBucket(size_t hash) {
+      return buckets_[hash & (buckets_.size() - 1)];
+    }
+
+    template <typename Lookup> Entry *find(size_t hash, const Lookup &key, const Equal &equal) {
+      for (Entry *entry = getBucket(hash); entry; entry = entry->bucket_next_) {
+        if ((entry->hash_ == hash) && equal(entry->key_, key)) {
+          return entry;
+        }
+      }
+      return NULL;
+    }
+
+    void insert(Entry *entry) {
+      if (count_ >= buckets_.size()) {
+        grow();
+      }
+      Entry *&bucket = getBucket(entry->hash_);
+      entry->bucket_next_ = bucket;
+      bucket = entry;
+      linkFront(entry);
+      bytes_ += entry->bytes_;
+      ++count_;
+    }
+
+    void remove(Entry *entry) {
+      Entry **link = &getBucket(entry->hash_);
+      while (*link != entry) {
+        link = &(*link)->bucket_next_;
+      }
+      *link = entry->bucket_next_;
+      entry->bucket_next_ = NULL;
+      unlink(entry);
+      bytes_ -= entry->bytes_;
+      --count_;
+    }
+
+    void touch(Entry *entry) {
+      if (entry != lru_head_) {
+        unlink(entry);
+        linkFront(entry);
+      }
+    }
+
+    void linkFront(Entry *entry) {
+      entry->lru_prev_ = NULL;
+      entry->lru_next_ = lru_head_;
+      if (lru_head_) {
+        lru_head_->lru_prev_ = entry;
+      } else {
+        lru_tail_ = entry;
+      }
+      lru_head_ = entry;
+    }
+
+    void unlink(Entry *entry) {
+      if (entry->lru_prev_) {
+        entry->lru_prev_->lru_next_ = entry->lru_next_;
+      } else {
+        lru_head_ = entry->lru_next_;
+      }
+      if (entry->lru_next_) {
+        entry->lru_next_->lru_prev_ = entry->lru_prev_;
+      } else {
+        lru_tail_ = entry->lru_prev_;
+      }
+    }
+
+    void grow() {
+      std::vector<Entry *> buckets(buckets_.size() * 2, static_cast<Entry *>(NULL));
+      for (Entry *entry = lru_head_; entry; entry = entry->lru_next_) {
+        Entry *&bucket = buckets[entry->hash_ & (buckets.size() - 1)];
+        entry->bucket_next_ = bucket;
+        bucket = entry;
+      }
+      buckets_.swap(buckets);
+    }
+  };
+
+  static const size_t INITIAL_BUCKET_COUNT = 16;
+
+  Shard &getShard(size_t hash) const {
+    // the low bits pick the bucket within the shard
+    return *shards_[(hash >> 24) & shard_mask_];
+  }
+
+  static void deleteEntries(Entry *entry) {
+    while (entry) {
+      Entry *next = entry->bucket_next_;
+      delete entry;
+      entry = next;
+    }
+  }
+
+  std::vector<Shard *> shards_;
+  size_t shard_mask_;
+  size_t shard_max_bytes_;
+  int default_ttl_ms_;
+  Hash hash_;
+  Equal equal_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_SHARDEDLRUCACHE_H_ */
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ShardedStat.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_SHARDEDSTAT_H_
+#define ATSCPPAPI_SHARDEDSTAT_H_
+
+#include <atscppapi/noncopyable.h>
+#include <stdint.h>
+#include <string>
+
+namespace atscppapi {
+
+// forward declarations
+struct ShardedStatState;
+
+/**
+ * @brief A summing Stat for hot counters, which many threads increment many times per request.
+ *
+ * A Stat increments the Traffic Server stat on every call, so all threads bounce the same cache line. A
+ * ShardedStat keeps a counter per thread on its own cache line instead and folds them into the Traffic
+ * Server stat every fold interval, from an AsyncTimer. What traffic_line shows therefore lags by up to the
+ * interval; get() folds first and is always current. Beyond 64 threads, threads share counters.
+ *
+ * \code
+ *  ShardedStat requests;
+ *  requests.init("plugin.requests");
+ *  requests.increment();
+ * \endcode
+ */
+class ShardedStat : noncopyable {
+public:
+  ShardedStat();
+  ~ShardedStat();
+
+  /**
+   * You must initialize your ShardedStat with a call to this init() method.
+   *
+   * @param name The string name of the stat, this will be visible via traffic_line -r.
+   * @param fold_interval_ms How often the per thread counters are folded into the stat, 1s by default.
+   * @param persistent This determines if your Stats will persist, the default value is false.
+   * @return True if the stat was successfully created and false otherwise.
+   */
+  bool init(const std::string &name, int fold_interval_ms = 1000, bool persistent = false);
+
+  /**
+   * Increments the counter of the calling thread.
+   * @param amount the amount to increment the stat by the default value is 1.
+   */
+  void increment(int64_t amount = 1);
+
+  /**
+   * Decrements the counter of the calling thread.
+   * @param amount the amount to decrement the stat by the default value is 1.
+   */
+  void decrement(int64_t amount = 1) { increment(-amount); }
+
+  /**
+   * Folds the per thread counters into the stat right away.
+   */
+  void fold();
+
+  /**
+   * @return The value of the stat, after a fold().
+   */
+  int64_t get();
+
+  /**
+   * Sets the value of the stat, what was incremented but not folded yet is dropped.
+   * @param value the value to set the stat to.
+   */
+  void set(int64_t value);
+
+private:
+  ShardedStatState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_SHARDEDSTAT_H_ */
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StatFamily.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STATFAMILY_H_
+#define ATSCPPAPI_STATFAMILY_H_
+
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Stat.h>
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+
+namespace atscppapi {
+
+// forward declarations
+struct StatFamilyState;
+
+/**
+ * @brief A family of Stats told apart by a label, such as an origin host, created as labels show up.
+ *
+ * The Stat for a label is named name.label and is created with TSStatCreate() the first time the label is
+ * looked up. Looking up a label that has a Stat already doesn't take any lock, so a family can be used on
+ * every request. Since Traffic Server stats can never be destroyed a family holds at most max_labels Stats,
+ * once it is full every new label counts into name.other instead.
+ *
+ * \code
+ *  StatFamily origin_errors;
+ *  origin_errors.init("plugin.origin_errors", 512);
+ *  origin_errors.get(transaction.getServerRequest().getUrl().getHost()).increment();
+ * \endcode
+ */
+class StatFamily : noncopyable {
+public:
+  StatFamily();
+  ~StatFamily();
+
+  /**
+   * You must initialize your StatFamily with a call to this init() method.
+   *
+   * @param name The prefix of the names of the stats.
+   * @param max_labels The most labels that get a Stat of their own.
+   * @param type The SyncType of the Stats, see Stat::init().
+   * @param persistent This determines if the Stats will persist, the default value is false.
+   * @return True if the overflow stat name.other was successfully created and false otherwise.
+   */
+  bool init(const std::string &name, size_t max_labels = 256, Stat::SyncType type = Stat::SYNC_SUM,
+            bool persistent = false);
+
+  /**
+   * @return The Stat for label, created if needed, or the overflow stat name.other if the family is full.
+   */
+  Stat &get(const std::string &label);
+
+  /**
+   * @return The Stat for a label of length bytes, see get(const std::string &).
+   */
+  Stat &get(const char *label, size_t length);
+
+  /**
+   * @return The number of labels that have a Stat of their own.
+   */
+  size_t getLabelCount() const;
+
+private:
+  StatFamilyState *state_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_STATFAMILY_H_ */
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file StringView.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief A non-owning, read-only reference to a sequence of characters.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_STRINGVIEW_H_
+#define ATSCPPAPI_STRINGVIEW_H_
+
+#include <string>
+#include <cstring>
+#include <strings.h>
+
+namespace atscppapi {
+
+/**
+ * @brief A pointer and a length referring to characters owned by someone else.
+ *
+ * StringViews hand out data that already lives in Traffic Server's buffers without copying it
+ * into a std::string. A StringView is only valid for as long as the memory it refers to, the
+ * methods returning them document how long that is; call str() if you need to keep a copy.
+ *
+ * A default constructed StringView has a NULL data() and is used to signal "not present",
+ * which is different from an empty value.
+ */
+class StringView {
+public:
+  typedef size_t size_type;
+  static const size_type npos = static_cast<size_type>(-1);
+
+  StringView() : data_(NULL), length_(0) { }
+  StringView(const char *data, size_type length) : data_(data), length_(length) { }
+  StringView(const char *str) : data_(str), length_(str ? strlen(str) : 0) { }
+  StringView(const std::string &str) : data_(str.data()), length_(str.length()) { }
+
+  const char *data() const { return data_; }
+  size_type length() const { return length_; }
+  size_type size() const { return length_; }
+  bool empty() const { return length_ == 0; }
+
+  /**
+   * @return true if this view doesn't refer to anything, as opposed to referring to an empty string.
+   */
+  bool isNull() const { return data_ == NULL; }
+
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + length_; }
+  char operator[](size_type pos) const { return data_[pos]; }
+
+  /**
+   * @return A copy of the viewed characters.
+   */
+  std::string str() const { return data_ ? std::string(data_, length_) : std::string(); }
+
+  /**
+   * @return A view of at most count characters starting at pos.
+   */
+  StringView substr(size_type pos, size_type count = npos) const {
+    if (pos > length_) {
+      pos = length_;
+    }
+    if (count > length_ - pos) {
+      count = length_ - pos;
+    }
+    return StringView(data_ + pos, count);
+  }
+
+  /**
+   * @return The position of the first c at or after pos, npos if there isn't one.
+   */
+  size_type find(char c, size_type pos = 0) const {
+    if (pos >= length_) {
+      return npos;
+    }
+    const void *found = memchr(data_ + pos, c, length_ - pos);
+    return found ? static_cast<size_type>(static_cast<const char *>(found) - data_) : npos;
+  }
+
+  bool equals(const StringView &other) const {
+    return (length_ == other.length_) && (length_ == 0 || memcmp(data_, other.data_, length_) == 0);
+  }
+
+  /**
+   * @return true if other has the same characters ignoring ASCII case, as header names are compared.
+   */
+  bool caseEquals(const StringView &other) const {
+    return (length_ == other.length_) && (length_ == 0 || strncasecmp(data_, other.data_, length_) == 0);
+  }
+
+  bool operator==(const StringView &other) const { return equals(other); }
+  bool operator!=(const StringView &other) const { return !equals(other); }
+
+private:
+  const char *data_;
+  size_type length_;
+};
+
+}
+
+#endif /* ATSCPPAPI_STRINGVIEW_H_ */
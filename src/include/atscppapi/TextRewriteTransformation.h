@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+/**
+ * @file TextRewriteTransformation.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Replaces literal strings in a body as it streams through, without buffering it.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TEXTREWRITETRANSFORMATION_H_
+#define ATSCPPAPI_TEXTREWRITETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
+#include "atscppapi/noncopyable.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for TextRewriteRules and TextRewriteTransformation
+ * @private
+ */
+struct TextRewriteRulesState;
+struct TextRewriteTransformationState;
+
+/**
+ * @brief The replacements of a TextRewriteTransformation, compiled into one matcher for all of them.
+ *
+ * The rules are usually built once, in TSPluginInit(), and shared by every TextRewriteTransformation, they must
+ * outlive the transformations using them and must not be changed while any are running.
+ *
+ * Matches don't overlap. Where matches of several patterns are possible the one that ends first wins, and of
+ * those ending at the same byte the longest. A pattern that ends inside a longer one is thus found instead of it,
+ * e.g. with both "b" and "abc" the "b" of "abc" is replaced.
+ *
+ * \code
+ * TextRewriteRules *rules = new TextRewriteRules(true); // html tags aren't case sensitive
+ * rules->addReplacement("http://static.example.com/", "https://cdn.example.com/");
+ * rules->addInsertBefore("</head>", "<script src=\"/rum.js\"></script>");
+ * \endcode
+ */
+class TextRewriteRules : noncopyable {
+public:
+  /**
+   * @param ignore_case match the patterns regardless of ASCII case, the replacements are inserted as given.
+   */
+  TextRewriteRules(bool ignore_case = false);
+
+  /**
+   * Replaces occurrences of pattern with replacement.
+   *
+   * @param first_only only replace the first occurrence in a body.
+   * @return false if pattern is empty, it's ignored then.
+   */
+  bool addReplacement(const std::string &pattern, const std::string &replacement, bool first_only = false);
+
+  /**
+   * Inserts snippet before pattern, e.g. before "</head>". The matched text itself is passed on as it was.
+   *
+   * @param first_only only insert it before the first occurrence in a body.
+   * @return false if pattern is empty, it's ignored then.
+   */
+  bool addInsertBefore(const std::string &pattern, const std::string &snippet, bool first_only = true);
+
+  /**
+   * @return The length of the longest pattern, that is the most input a transformation holds back at a time.
+   */
+  size_t getMaxPatternLength() const;
+
+  ~TextRewriteRules();
+private:
+  TextRewriteRulesState *state_;
+  friend class TextRewriteTransformation;
+};
+
+/**
+ * @brief A TransformationPlugin applying TextRewriteRules to a request or response body as it streams through.
+ *
+ * The input is scanned block by block with an Aho-Corasick automaton whose state carries over from one consume()
+ * to the next, so patterns are found across block boundaries. The unchanged stretches between matches are
+ * produced by reference to the input blocks, without a copy; only the bytes of a possible match at the end of a
+ * block, fewer than the longest pattern, are held back until the next block shows whether they match. While no
+ * pattern is under way the search skips to the next byte that starts one, a word at a time.
+ *
+ * @note The length of the body changes, so remove its Content-Length when adding the transformation.
+ */
+class TextRewriteTransformation : public TransformationPlugin {
+public:
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type whether to rewrite the request or the response body.
+   * @param rules the replacements to apply, they must outlive the transformation.
+   */
+  TextRewriteTransformation(Transaction &transaction, TransformationPlugin::Type type, const TextRewriteRules &rules);
+
+  /**
+   * Constructs a TextRewriteTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @see TransformationChain
+   */
+  TextRewriteTransformation(Transaction &transaction, TransformationChain &chain, const TextRewriteRules &rules);
+
+  void consume(const std::string &data);
+
+  /**
+   * Scans input, producing everything but a possible partial match at its end.
+   */
+  void consume(InputBuffer &input);
+
+  /**
+   * Produces the input held back for a partial match and completes the output.
+   */
+  void handleInputComplete();
+
+  /**
+   * @return The number of replacements made so far.
+   */
+  size_t getReplacementCount() const;
+
+  virtual ~TextRewriteTransformation();
+private:
+  void produceRange(InputBuffer &input, int64_t begin, int64_t end);
+  TextRewriteTransformationState *state_;
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_TEXTREWRITETRANSFORMATION_H_ */
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ThreadLocal.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Contains ThreadLocal, which keeps a separate value for every thread.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_THREADLOCAL_H_
+#define ATSCPPAPI_THREADLOCAL_H_
+
+#include <cstddef>
+#include <pthread.h>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Mutex.h>
+
+namespace atscppapi {
+
+/**
+ * @brief Keeps one T per thread, constructed the first time a thread asks for it.
+ *
+ * Each event thread works on its own value without taking any lock, which suits state that is shared
+ * across transactions but doesn't need to be shared across threads: scratch buffers, pools of compression
+ * streams, counters that are only summed up now and then. A thread's value is destroyed when the thread
+ * exits, and all remaining values when the ThreadLocal is destroyed.
+ *
+ * \code
+ * ThreadLocal<uint64_t> request_count(0);
+ * ...
+ * ++request_count.get(); // in a hook, on any thread
+ * ...
+ * struct Sum {
+ *   uint64_t total_;
+ *   Sum() : total_(0) { }
+ *   void operator()(uint64_t &count) { total_ += count; }
+ * };
+ * uint64_t total = request_count.forEach(Sum()).total_;
+ * \endcode
+ */
+template <typename T> class ThreadLocal : noncopyable {
+public:
+  /**
+   * Every thread's value is default constructed.
+   */
+  ThreadLocal() : prototype_(NULL), slots_(NULL), size_(0) {
+    pthread_key_create(&key_, &ThreadLocal::destroySlot);
+  }
+
+  /**
+   * Every thread's value is copy constructed from prototype.
+   */
+  explicit ThreadLocal(const T &prototype) : prototype_(new T(prototype)), slots_(NULL), size_(0) {
+    pthread_key_create(&key_, &ThreadLocal::destroySlot);
+  }
+
+  ~ThreadLocal() {
+    pthread_key_delete(key_); // the threads still running won't destroy their slot anymore
+    while (slots_) {
+      Slot *slot = slots_;
+      slots_ = slot->next_;
+      delete slot;
+    }
+    delete prototype_;
+  }
+
+  /**
+   * @return This thread's value, constructed by this call if the thread had none.
+   */
+  T &get() {
+    Slot *slot = static_cast<Slot *>(pthread_getspecific(key_));
+    if (!slot) {
+      slot = createSlot();
+    }
+    return slot->value_;
+  }
+
+  /**
+   * @return This thread's value, NULL if it has none yet.
+   */
+  T *peek() const {
+    Slot *slot = static_cast<Slot *>(pthread_getspecific(key_));
+    return slot ? &slot->value_ : NULL;
+  }
+
+  /**
+   * Calls function with the value of every thread that has one. Threads can't create or destroy their
+   * value meanwhile, but they keep using it: function must read it in a way that is safe against that,
+   * e.g. with atomic operations.
+   *
+   * @return function, as std::for_each does, so it can be used to collect a result.
+   */
+  template <typename Function> Function forEach(Function function) {
+    ScopedMutexLock lock(mutex_);
+    for (Slot *slot = slots_; slot; slot = slot->next_) {
+      function(slot->value_);
+    }
+    return function;
+  }
+
+  /**
+   * @return Number of threads that have a value.
+   */
+  size_t size() const {
+    return size_;
+  }
+
+private:
+  struct Slot : noncopyable {
+    ThreadLocal *owner_;
+    T value_;
+    Slot *prev_;
+    Slot *next_;
+    explicit Slot(ThreadLocal *owner) : owner_(owner), value_(), prev_(NULL), next_(NULL) { }
+    Slot(ThreadLocal *owner, const T &prototype) : owner_(owner), value_(prototype), prev_(NULL), next_(NULL) { }
+  };
+
+  Slot *createSlot() {
+    Slot *slot = prototype_ ? new Slot(this, *prototype_) : new Slot(this);
+    {
+      ScopedMutexLock lock(mutex_);
+      slot->next_ = slots_;
+      if (slots_) {
+        slots_->prev_ = slot;
+      }
+      slots_ = slot;
+      ++size_;
+    }
+    pthread_setspecific(key_, slot);
+    return slot;
+  }
+
+  static void destroySlot(void *data) {
+    Slot *slot = static_cast<Slot *>(data);
+    ThreadLocal *owner = slot->owner_;
+    {
+      ScopedMutexLock lock(owner->mutex_);
+      if (slot->prev_) {
+        slot->prev_->next_ = slot->next_;
+      } else {
+        owner->slots_ = slot->next_;
+      }
+      if (slot->next_) {
+        slot->next_->prev_ = slot->prev_;
+      }
+      --owner->size_;
+    }
+    delete slot;
+  }
+
+  pthread_key_t key_;
+  const T *prototype_;
+  Mutex mutex_;
+  Slot *slots_; // of all threads, linked so a thread's slot can be unlinked when it exits
+  size_t size_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_THREADLOCAL_H_ */
@@ -32,7 +32,15 @@ namespace atscppapi {
 
 // forward declarations
 class TransactionPlugin;
+class HookTiming;
+class TransactionTrace;
+struct TransactionMemoryState;
 class TransactionState;
+class TransactionHandle;
+class TransactionContextKeyBase;
+class Session;
+class Mutex;
+class Arena;
 namespace utils { class internal; }
 
 /**
@@ -67,6 +75,9 @@ public:
    * Because getContextValue() and setContextValue()
    * take shared pointers you dont have to worry about the cleanup as that will happen automatically so long
    * as you dont have shared_ptrs that cannot go out of scope.
+   *
+   * Values passed on every request are better kept with a TransactionContextKey, it avoids the string
+   * lookup and the reference counting.
    */
   class ContextValue {
   public:
@@ -126,6 +137,28 @@ public:
    */
   void setErrorBody(const std::string &content);
 
+  /**
+   * Sets the body of the response sent when the transaction goes to the error state, like setErrorBody() but
+   * with a content type of your choice. The length bytes at body are copied once, straight into the buffer
+   * Traffic Server takes over, so body can be a static page or one built once for the plugin's lifetime.
+   *
+   * @param body the response body, it needn't be null terminated.
+   * @param length the length of body.
+   * @param content_type the Content-Type of the response.
+   * @see CustomResponse
+   */
+  void setResponseBody(const char *body, size_t length, const char *content_type = "text/html");
+
+  /**
+   * Like setResponseBody() but without any copy, Traffic Server takes ownership of body and content_type.
+   * Both must come from TSmalloc() or TSstrdup(), Traffic Server releases them with TSfree().
+   *
+   * @param body the response body.
+   * @param length the length of body.
+   * @param content_type the null terminated Content-Type of the response.
+   */
+  void adoptResponseBody(char *body, size_t length, char *content_type);
+
   /**
    * Get the clients address
    * @return The sockaddr structure representing the client's address
@@ -216,6 +249,54 @@ public:
    */
   Response &getClientResponse();
 
+  /**
+   * The outcome of the cache lookup of a Transaction.
+   */
+  enum CacheStatus {
+    CACHE_STATUS_UNKNOWN = -1, /**< The lookup didn't complete yet, or the status couldn't be read */
+    CACHE_STATUS_MISS = 0, /**< Nothing was found in cache */
+    CACHE_STATUS_HIT_STALE, /**< A stale document was found, it will be revalidated with the origin */
+    CACHE_STATUS_HIT_FRESH, /**< A fresh document was found, it will be served from cache */
+    CACHE_STATUS_SKIPPED /**< The cache wasn't looked up, e.g. the request isn't cacheable */
+  };
+
+  /**
+   * Returns the result of the cache lookup, typically read in HOOK_CACHE_LOOKUP_COMPLETE to skip work,
+   * such as side fetches or transformations, that a document served from cache doesn't need.
+   *
+   * @return The status, CACHE_STATUS_UNKNOWN before the lookup completes.
+   */
+  CacheStatus getCacheStatus() const;
+
+  /**
+   * Overrides the result of the cache lookup, only from HOOK_CACHE_LOOKUP_COMPLETE. Setting
+   * CACHE_STATUS_HIT_STALE on a fresh hit revalidates it with the origin early; CACHE_STATUS_MISS fetches
+   * the document again.
+   *
+   * @return true if the status was set.
+   */
+  bool setCacheStatus(CacheStatus status);
+
+  /**
+   * Returns a Response object which is the response found in cache. It is read from Traffic Server the first
+   * time it is asked for once the cache lookup found a document, so a plugin that doesn't look at it pays
+   * nothing.
+   *
+   * @return Response object of the cached response; it should not be modified, and has no headers if there
+   *         was no hit.
+   */
+  Response &getCachedResponse();
+
+  /**
+   * Returns a Response object which is the response of a response transformation, the headers Traffic Server
+   * caches with the transformed body. It exists once a response transformation was set up, i.e. from the
+   * first input of a TransformationPlugin on.
+   *
+   * @return Response object of the transformed response, it has no headers if there's no response transformation.
+   * @see TransformationPlugin::setCachedVariant()
+   */
+  Response &getTransformedResponse();
+
   /**
    * The available types of timeouts you can set on a Transaction.
    */
@@ -242,6 +323,32 @@ public:
    */
   void *getAtsHandle() const;
 
+  /**
+   * Returns a lightweight handle to this transaction, it can be kept for the lifetime of the
+   * transaction and passed around by value.
+   *
+   * @see TransactionHandle
+   */
+  TransactionHandle getHandle() const;
+
+  /**
+   * Returns the client session this transaction arrived on, which outlives the transaction and is shared
+   * with the other transactions of a keep-alive or HTTP/2 connection. Keep per-connection state in a
+   * SessionPlugin of the session so it's computed once per connection.
+   *
+   * @return The Session, created the first time a transaction of the session asks for it.
+   * @see SessionPlugin
+   */
+  Session &getSession();
+
+  /**
+   * Returns the arena of this transaction. Memory from it, and objects created in it, stay valid
+   * until the transaction closes and are released together with the transaction's own state.
+   *
+   * @see Arena
+   */
+  Arena &getArena();
+
   /**
    * Adds a TransactionPlugin to the current Transaction. This effectively transfers ownership and the
    * Transaction is now responsible for cleaning it up.
@@ -254,34 +361,66 @@ private:
   TransactionState *state_; //!< The internal TransactionState object tied to the current Transaction
   friend class TransactionPlugin; //!< TransactionPlugin is a friend so it can call addPlugin()
   friend class TransformationPlugin; //!< TransformationPlugin is a friend so it can call addPlugin()
+  friend class TransactionContextKeyBase; //!< TransactionContextKeyBase is a friend so it can call getContextSlots()
 
   /**
    * @private
    *
    * @param raw_txn a void pointer that represents a TSHttpTxn
    */
-  Transaction(void *);
+  Transaction(void *, Arena &);
 
   /**
    * Used to initialize the Request object for the Server.
    *
    * @private
+   *
+   * @return true if it was initialized by this call.
    */
-  void initServerRequest();
+  bool initServerRequest();
 
   /**
    * Used to initialize the Response object for the Server.
    *
    * @private
+   *
+   * @return true if it was initialized by this call.
    */
-  void initServerResponse();
+  bool initServerResponse();
 
   /**
    * Used to initialize the Response object for the Client.
    *
    * @private
+   *
+   * @return true if it was initialized by this call.
+   */
+  bool initClientResponse();
+
+  /**
+   * Used to initialize the Response object for the cached response.
+   *
+   * @private
+   *
+   * @return true if it was initialized by this call.
+   */
+  bool initCachedResponse();
+
+  /**
+   * Used to initialize the Response object for the transformed response.
+   *
+   * @private
+   *
+   * @return true if it was initialized by this call.
    */
-  void initClientResponse();
+  bool initTransformedResponse();
+
+  /**
+   * Adds one of the internal hooks maintaining this Transaction, unless it already was.
+   *
+   * @private
+   */
+  void addManagementHook(unsigned int hook, int ts_hook_id);
 
   /**
    * Returns a list of TransactionPlugin pointers bound to the current Transaction
@@ -292,6 +431,112 @@ private:
    */
   const std::list<TransactionPlugin *> &getPlugins() const;
 
+  /**
+   * Starts measuring the time until the plugin handling hook_type resumes, see HookTiming.
+   *
+   * @private
+   */
+  void beginHookTiming(HookTiming *timing, int hook_type, int64_t start_time);
+
+  /**
+   * Records the time since beginHookTiming(), if it was called.
+   *
+   * @private
+   */
+  void endHookTiming();
+
+  /**
+   * @private
+   *
+   * The trace of this transaction, NULL unless a Tracer picked it, see TransactionTrace::get().
+   */
+  TransactionTrace *getTrace() const;
+
+  /**
+   * @private
+   */
+  void setTrace(TransactionTrace *trace);
+
+  /**
+   * @private
+   *
+   * What MemoryAccounting recorded about this transaction, NULL if nothing.
+   */
+  TransactionMemoryState *getMemory() const;
+
+  /**
+   * @private
+   */
+  void setMemory(TransactionMemoryState *memory);
+
+  /**
+   * Returns the slots of the context keys which did not get a Traffic Server transaction argument.
+   *
+   * @private
+   */
+  void **getContextSlots();
+
+  /**
+   * Returns the mutex shared by the TransactionPlugins created with MUTEX_PER_TRANSACTION, empty until the first one is.
+   *
+   * @private
+   */
+  shared_ptr<Mutex> &getPluginMutex();
+
+  /**
+   * Has the transaction's dispatcher continuation call plugin on the hook, after the plugins that
+   * registered for it before.
+   *
+   * @private
+   */
+  void addPluginHook(TransactionPlugin *plugin, int hook_type);
+
+  /**
+   * Calls the plugins registered for the hook of event, in order and starting with first_index, until
+   * one doesn't resume right away. The transaction is reenabled once all of them resumed.
+   *
+   * @private
+   */
+  void dispatchPluginHooks(int event, size_t first_index);
+
+  /**
+   * Continues a dispatch of plugins for event, with the plugin at first_index.
+   *
+   * @private
+   */
+  typedef void (*DispatchFunction)(Transaction &transaction, int event, size_t first_index);
+
+  /**
+   * Starts calling a plugin of a dispatch, a resume() from it now continues the dispatch instead of
+   * reenabling the transaction.
+   *
+   * @private
+   *
+   * @param continuation called with index + 1 if the plugin doesn't resume until after it returned.
+   */
+  void beginPluginCallback(int event, size_t index, DispatchFunction continuation);
+
+  /**
+   * @private
+   *
+   * @return true if the plugin resumed and the next one is to be called, false if it went async or errored.
+   */
+  bool endPluginCallback();
+
+  /**
+   * Reenables the transaction after the last plugin of a dispatch resumed.
+   *
+   * @private
+   */
+  void endPluginDispatch();
+
+  /**
+   * Calls the continuation of a dispatch whose plugin resumed after going async.
+   *
+   * @private
+   */
+  void continuePluginDispatch();
+
   friend class utils::internal;
 };
 
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionContextKey.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSACTIONCONTEXTKEY_H_
+#define ATSCPPAPI_TRANSACTIONCONTEXTKEY_H_
+
+#include <string>
+#include "atscppapi/Transaction.h"
+#include "atscppapi/Arena.h"
+#include "atscppapi/noncopyable.h"
+
+namespace atscppapi {
+
+/**
+ * @private
+ *
+ * The untyped part of TransactionContextKey, it owns the slot the key was given.
+ */
+class TransactionContextKeyBase: noncopyable {
+public:
+  /**
+   * The number of keys that can be stored in the Transaction itself when Traffic Server has no
+   * transaction argument slots left.
+   */
+  static const int MAX_CONTEXT_SLOTS = 32;
+
+  /**
+   * @return false if neither a Traffic Server argument slot nor a Transaction slot was left for this key,
+   *         values stored with it are then silently dropped.
+   */
+  bool isValid() const { return (ts_arg_index_ >= 0) || (slot_index_ >= 0); }
+
+protected:
+  TransactionContextKeyBase(const std::string &name);
+  void *getValue(Transaction &transaction) const;
+  void setValue(Transaction &transaction, void *value) const;
+
+private:
+  int ts_arg_index_;
+  int slot_index_;
+};
+
+/**
+ * @brief A typed, index based alternative to Transaction::getContextValue() and Transaction::setContextValue().
+ *
+ * Keys are created once, when the plugin is initialized, and receive a fixed slot: one of Traffic Server's
+ * transaction arguments if any are left, otherwise one of the Transaction's own MAX_CONTEXT_SLOTS. Getting and
+ * setting a value is then an index into that slot, there is no string lookup and no reference counting.
+ *
+ * Values are copied into the transaction's Arena and destroyed when the transaction closes.
+ *
+ * \code
+ *     struct RequestInfo {
+ *       int id_;
+ *       RequestInfo(int id) : id_(id) { }
+ *     };
+ *
+ *     static TransactionContextKey<RequestInfo> request_info_key("myplugin.request_info");
+ *
+ *     // in one hook
+ *     request_info_key.set(transaction, RequestInfo(12));
+ *
+ *     // and in a later one
+ *     RequestInfo *info = request_info_key.get(transaction);
+ * \endcode
+ *
+ * @warning Keys must be created before any transaction is processed and must outlive all transactions,
+ * a key that is a static or a member of a GlobalPlugin is fine.
+ */
+template <typename T> class TransactionContextKey: public TransactionContextKeyBase {
+public:
+  /**
+   * @param name a name for the key, Traffic Server lists it along with the argument slot it reserved.
+   */
+  TransactionContextKey(const std::string &name) : TransactionContextKeyBase(name) { }
+
+  /**
+   * @return The value stored in transaction with this key, or NULL if it was never set or was cleared.
+   */
+  T *get(Transaction &transaction) const {
+    return static_cast<T *>(getValue(transaction));
+  }
+
+  /**
+   * Stores a copy of value in transaction. Setting a key again assigns to the value stored before.
+   *
+   * @return The stored value, or NULL if the key is not valid.
+   */
+  T *set(Transaction &transaction, const T &value) const {
+    if (!isValid()) {
+      return NULL;
+    }
+    T *stored_value = get(transaction);
+    if (stored_value) {
+      *stored_value = value;
+    } else {
+      Arena &arena = transaction.getArena();
+      Arena::Scope arena_scope(&arena);
+      stored_value = arena.create<T>(value);
+      setValue(transaction, stored_value);
+    }
+    return stored_value;
+  }
+
+  /**
+   * Removes the value stored with this key, it is still destroyed when the transaction closes.
+   */
+  void clear(Transaction &transaction) const {
+    setValue(transaction, NULL);
+  }
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSACTIONCONTEXTKEY_H_ */
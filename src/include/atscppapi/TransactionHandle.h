@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionHandle.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSACTIONHANDLE_H_
+#define ATSCPPAPI_TRANSACTIONHANDLE_H_
+
+#include <sys/socket.h>
+#include <stdint.h>
+#include "atscppapi/Transaction.h"
+
+namespace atscppapi {
+
+/**
+ * @brief A lightweight, copyable handle to a HTTP transaction.
+ *
+ * Building a Transaction means looking up the transaction's state, a TransactionHandle on the other hand is
+ * nothing more than the TSHttpTxn. Hooks that only need the addresses, timeouts or to resume the transaction
+ * should use it, the full Transaction remains available through getTransaction().
+ *
+ * @warning A handle must not be used after the transaction it refers to has closed.
+ */
+class TransactionHandle {
+public:
+  /**
+   * @param raw_txn the TSHttpTxn this handle refers to.
+   */
+  explicit TransactionHandle(void *raw_txn) : txn_(raw_txn) { }
+
+  /**
+   * @return a void * which can be cast back to a TSHttpTxn.
+   */
+  void *getAtsHandle() const { return txn_; }
+
+  /** @see Transaction::getClientAddress() */
+  const sockaddr *getClientAddress() const;
+
+  /** @see Transaction::getIncomingAddress() */
+  const sockaddr *getIncomingAddress() const;
+
+  /** @see Transaction::getServerAddress() */
+  const sockaddr *getServerAddress() const;
+
+  /** @see Transaction::getNextHopAddress() */
+  const sockaddr *getNextHopAddress() const;
+
+  /** @see Transaction::setServerAddress() */
+  bool setServerAddress(const sockaddr *);
+
+  /** @see Transaction::setIncomingPort() */
+  bool setIncomingPort(uint16_t port);
+
+  /** @see Transaction::setTimeout() */
+  void setTimeout(Transaction::TimeoutType type, int time_ms);
+
+  /** @see Transaction::isInternalRequest() */
+  bool isInternalRequest() const;
+
+  /** @see Transaction::resume() */
+  void resume();
+
+  /** @see Transaction::error() */
+  void error();
+
+  /**
+   * Returns the full Transaction, creating it if this is the first time it is asked for.
+   */
+  Transaction &getTransaction() const;
+
+private:
+  void *txn_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSACTIONHANDLE_H_ */
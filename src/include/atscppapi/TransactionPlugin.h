@@ -89,8 +89,22 @@ public:
    */
   void registerHook(Plugin::HookType hook_type);
   virtual ~TransactionPlugin();
+
+  /**
+   * The mutex that is held while a hook of the plugin runs and while the plugin is deleted, it
+   * serializes the hooks with completions of the Async operations started with getMutex().
+   */
+  enum MutexPolicy {
+    MUTEX_PER_PLUGIN = 0, /**< Every plugin has a mutex of its own, the default. */
+    MUTEX_PER_TRANSACTION, /**< The plugins of a transaction with this policy share one mutex. */
+    MUTEX_NONE /**< No mutex, for plugins never using Async, hooks then run without any locking. */
+  };
 protected:
-  TransactionPlugin(Transaction &transaction);
+  /**
+   * @param transaction the Transaction the plugin is bound to.
+   * @param mutex_policy which mutex guards the plugin, see MutexPolicy.
+   */
+  TransactionPlugin(Transaction &transaction, MutexPolicy mutex_policy = MUTEX_PER_PLUGIN);
 
   /**
    * This method will return a shared_ptr to a Mutex that can be used for AsyncProvider and AsyncReceiver operations.
@@ -98,6 +112,8 @@ protected:
    * If another thread wanted to stop this transaction from dispatching an event it could be passed
    * this mutex and it would be able to lock it and prevent another thread from dispatching back into this
    * TransactionPlugin.
+   *
+   * @return The mutex, which is empty for plugins created with MUTEX_NONE.
    */
   shared_ptr<Mutex> getMutex();
 private:
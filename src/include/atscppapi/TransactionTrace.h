@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransactionTrace.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSACTIONTRACE_H_
+#define ATSCPPAPI_TRANSACTIONTRACE_H_
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/shared_ptr.h>
+
+namespace atscppapi {
+
+// forward declarations
+class Transaction;
+class AsyncHttpFetch;
+class Logger;
+class Tracer;
+struct TraceFetchSpan;
+namespace utils { class internal; }
+
+/**
+ * @brief The timestamped spans of a traced transaction: its hooks, async fetches and transformations.
+ *
+ * A transaction is only traced when a Tracer picked it, see Tracer::startTrace(). From then on the library
+ * records a span for every plugin hook handler, for every transformation from its first input until its output
+ * is complete, and for every AsyncHttpFetch passed to traceFetch(). Plugins can add spans of their own with
+ * beginSpan() and endSpan(). The spans live in a fixed buffer in the transaction's Arena, once it has MAX_SPANS
+ * spans further spans are only counted. When the transaction closes the trace is handed to the TraceExporter
+ * of the Tracer.
+ *
+ * Trace and span ids follow W3C trace context, an incoming traceparent header is continued and traceFetch()
+ * sends one along with the fetch.
+ */
+class TransactionTrace : noncopyable {
+public:
+  /**
+   * What a span measures.
+   */
+  enum SpanKind {
+    SPAN_HOOK = 0, /**< The handler of a plugin hook, named after the HookType */
+    SPAN_FETCH, /**< An AsyncHttpFetch from traceFetch() until it completed */
+    SPAN_TRANSFORMATION, /**< A transformation from its first input until its output was complete */
+    SPAN_CUSTOM /**< A span added by a plugin */
+  };
+
+  /**
+   * A span, times are from TShrtime() in nanoseconds.
+   */
+  struct Span {
+    SpanKind kind_;
+    const char *name_; /**< Must stay valid until the transaction closes, string literals are best. */
+    uint64_t span_id_;
+    int64_t start_time_;
+    int64_t end_time_; /**< When the span hadn't ended when the transaction closed, the time it closed. */
+    bool ended_;
+  };
+
+  static const size_t MAX_SPANS = 64;
+
+  /**
+   * The index beginSpan() returns when the buffer is full, endSpan() ignores it.
+   */
+  static const size_t NO_SPAN = MAX_SPANS;
+
+  /**
+   * @return The trace of transaction, NULL if it isn't traced.
+   */
+  static TransactionTrace *get(Transaction &transaction);
+
+  /**
+   * Starts a span.
+   *
+   * @return The index of the span to pass to endSpan().
+   */
+  size_t beginSpan(SpanKind kind, const char *name);
+
+  /**
+   * Ends a span started with beginSpan().
+   */
+  void endSpan(size_t index);
+
+  /**
+   * Adds a span for fetch, which ends when the fetch completes, and a traceparent header to its request.
+   * This must be called before the fetch is executed.
+   */
+  void traceFetch(AsyncHttpFetch &fetch, const char *name = "fetch");
+
+  /**
+   * @return The 32 hex digit trace id.
+   */
+  const char *getTraceId() const { return trace_id_; }
+
+  /**
+   * @return The 16 hex digit id of the span of the whole transaction.
+   */
+  const char *getRootSpanId() const { return root_span_id_; }
+
+  /**
+   * @return The span id of the incoming traceparent header, an empty string if there was none.
+   */
+  const char *getParentSpanId() const { return parent_span_id_; }
+
+  /**
+   * @return When the transaction started being traced.
+   */
+  int64_t getStartTime() const { return start_time_; }
+
+  /**
+   * @return When the transaction closed, 0 until then.
+   */
+  int64_t getEndTime() const { return end_time_; }
+
+  size_t getSpanCount() const { return span_count_; }
+
+  const Span &getSpan(size_t index) const { return spans_[index]; }
+
+  /**
+   * @return How many spans didn't fit in the buffer.
+   */
+  size_t getDroppedSpanCount() const { return dropped_spans_; }
+
+  Transaction &getTransaction() { return transaction_; }
+
+  ~TransactionTrace();
+private:
+  TransactionTrace(Transaction &transaction, Tracer &tracer);
+  void finish();
+
+  Transaction &transaction_;
+  Tracer &tracer_;
+  char trace_id_[33];
+  char root_span_id_[17];
+  char parent_span_id_[17];
+  int64_t start_time_;
+  int64_t end_time_;
+  Span spans_[MAX_SPANS];
+  size_t span_count_;
+  size_t dropped_spans_;
+  std::vector<std::pair<size_t, shared_ptr<TraceFetchSpan> > > fetch_spans_;
+  friend class Tracer;
+  friend class utils::internal;
+};
+
+/**
+ * @brief Receives the traces of closed transactions.
+ */
+class TraceExporter {
+public:
+  /**
+   * Called on the transaction's thread when it closes, the transaction is still usable.
+   */
+  virtual void exportTrace(TransactionTrace &trace) = 0;
+  virtual ~TraceExporter() { }
+};
+
+/**
+ * @brief A TraceExporter that writes every span as a LogRecord, all spans of a transaction at once.
+ *
+ * The records have the fields trace_id, span_id, parent_span_id, kind, name, start_us (since the trace started),
+ * duration_us and ended; the span of the whole transaction has kind "transaction".
+ */
+class LoggerTraceExporter : public TraceExporter {
+public:
+  LoggerTraceExporter(Logger &logger) : logger_(logger) { }
+  virtual void exportTrace(TransactionTrace &trace);
+private:
+  Logger &logger_;
+};
+
+/**
+ * @brief Decides which transactions are traced and where their traces go.
+ *
+ * \code
+ * LoggerTraceExporter exporter(trace_log);
+ * Tracer tracer(exporter, 1000); // trace one in a thousand requests
+ * ...
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   tracer.startTrace(transaction);
+ *   transaction.resume();
+ * }
+ * \endcode
+ */
+class Tracer : noncopyable {
+public:
+  /**
+   * @param exporter receives the traces, it must outlive the Tracer.
+   * @param sample_one_in about one in this many transactions are traced, except those whose traceparent
+   *        header says they are sampled, which are always traced.
+   */
+  Tracer(TraceExporter &exporter, unsigned int sample_one_in = 1);
+
+  /**
+   * Starts tracing transaction if it is sampled, the earlier this is called the more of it the trace covers.
+   *
+   * @return The trace, NULL if the transaction wasn't sampled.
+   */
+  TransactionTrace *startTrace(Transaction &transaction);
+private:
+  TraceExporter &exporter_;
+  unsigned int sample_one_in_;
+  friend class TransactionTrace;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSACTIONTRACE_H_ */
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationChain.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSFORMATIONCHAIN_H_
+#define ATSCPPAPI_TRANSFORMATIONCHAIN_H_
+
+#include <atscppapi/TransformationPlugin.h>
+
+namespace atscppapi {
+
+/**
+ * @brief Runs several TransformationPlugins inside a single Traffic Server transformation.
+ *
+ * Every TransformationPlugin normally creates its own transformation, so stacking several of them
+ * costs a transformation, a buffer and a round of event scheduling per plugin. A TransformationChain
+ * is the only transformation Traffic Server sees, its stages are TransformationPlugins constructed
+ * with the chain and they hand their output to the next stage directly in memory.
+ *
+ * Stages run in the order they were constructed. A stage is written just like any other
+ * TransformationPlugin, it implements consume() and handleInputComplete() and calls produce()
+ * and setOutputComplete(). Stages must still be added to the Transaction with addPlugin() so
+ * their lifetime is managed as usual.
+ *
+ * \code
+ * TransformationChain *chain = new TransformationChain(transaction, TransformationPlugin::RESPONSE_TRANSFORMATION);
+ * transaction.addPlugin(chain);
+ * transaction.addPlugin(new GzipInflateTransformation(transaction, *chain));
+ * transaction.addPlugin(new MyRewriteTransformation(transaction, *chain));
+ * transaction.addPlugin(new GzipDeflateTransformation(transaction, *chain));
+ * \endcode
+ *
+ * @see TransformationPlugin
+ */
+class TransformationChain : public TransformationPlugin {
+public:
+  /**
+   * @param transaction the Transaction to transform.
+   * @param type whether the chain transforms the request or the response body.
+   */
+  TransformationChain(Transaction &transaction, Type type);
+
+  /**
+   * Hands the input of the chain to the first stage, if the chain has no stages the
+   * input is passed through unchanged.
+   */
+  void consume(InputBuffer &input);
+
+  /**
+   * Signals input complete to the first stage.
+   */
+  void handleInputComplete();
+
+  virtual ~TransformationChain();
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSFORMATIONCHAIN_H_ */
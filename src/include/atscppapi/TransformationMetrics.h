@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file TransformationMetrics.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_TRANSFORMATIONMETRICS_H_
+#define ATSCPPAPI_TRANSFORMATIONMETRICS_H_
+
+#include <stdint.h>
+#include <string>
+#include <atscppapi/noncopyable.h>
+
+namespace atscppapi {
+
+// forward declarations
+struct TransformationMetricsState;
+class TransformationPluginState;
+
+/**
+ * @brief Throughput and buffering stats shared by all instances of a transformation class.
+ *
+ * These stats are kept, name being the prefix given to the constructor:
+ *  - name.input_bytes and name.output_bytes, the bytes consumed and produced by all instances
+ *  - name.consume_calls, the number of calls to consume()
+ *  - name.chunk_bytes, a HistogramStat of the size of the input of every consume(), its sum divided by
+ *    its count is the average chunk size
+ *  - name.peak_buffered_bytes, a HistogramStat of the most output each instance had waiting for the downstream
+ *  - name.first_byte_to_complete_us, a HistogramStat of the time from the first input until setOutputComplete()
+ *
+ * A transformation that buffers whole objects shows up as a peak_buffered_bytes close to its output size
+ * and a first_byte_to_complete_us that grows with the object. Like a Stat, a TransformationMetrics is created
+ * once, in TSPluginInit(), and attached to each instance with TransformationPlugin::setMetrics().
+ *
+ * \code
+ * TransformationMetrics *gzip_metrics = new TransformationMetrics("plugin.gzip");
+ * ...
+ * GzipTransformationPlugin(Transaction &transaction) : TransformationPlugin(transaction, RESPONSE_TRANSFORMATION) {
+ *   setMetrics(gzip_metrics);
+ * }
+ * \endcode
+ */
+class TransformationMetrics : noncopyable {
+public:
+  /**
+   * @param name The prefix of the names of the stats, see above.
+   * @param aggregation_interval_ms How often the percentiles are computed, see HistogramStat::init().
+   */
+  TransformationMetrics(const std::string &name, int aggregation_interval_ms = 10000);
+  ~TransformationMetrics();
+private:
+  void recordConsume(size_t length);
+  void recordOutput(int64_t length);
+  void recordComplete(int64_t peak_buffered_bytes, int64_t first_byte_to_complete_ns);
+  TransformationMetricsState *state_;
+  friend class TransformationPluginState;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_TRANSFORMATIONMETRICS_H_ */
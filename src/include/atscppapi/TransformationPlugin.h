@@ -21,12 +21,15 @@
 #define ATSCPPAPI_TRANSFORMATIONPLUGIN_H_
 
 #include <string>
+#include <atscppapi/noncopyable.h>
 #include <atscppapi/Transaction.h>
 #include <atscppapi/TransactionPlugin.h>
 
 namespace atscppapi {
 
 class TransformationPluginState;
+class TransformationChain;
+class TransformationMetrics;
 
 /**
  * @brief The interface used when you wish to transform Request or Response body content.
@@ -47,7 +50,8 @@ class TransformationPluginState;
  * which are defined in Type.
  *
  * This example is a Null Transformation, meaning it will just spit out the content it receives without
- * actually doing any work on it.
+ * actually doing any work on it. Transformations that want to avoid copying the input can implement
+ * consume(InputBuffer &) instead of consume(const std::string &), see InputBuffer.
  *
  * \code
  * class NullTransformationPlugin : public TransformationPlugin {
@@ -85,10 +89,103 @@ public:
   };
 
   /**
-   * A method that you must implement when writing a TransformationPlugin, this method will be
-   * fired whenever an upstream TransformationPlugin has produced output.
+   * Which variants of a transformed response Traffic Server writes to its cache, see setCachedVariant().
    */
-  virtual void consume(const std::string &data) = 0;
+  enum CachedVariant {
+    CACHED_VARIANT_DEFAULT = 0, /**< Whatever Traffic Server does without being told */
+    CACHED_VARIANT_UNTRANSFORMED, /**< The response as the origin sent it, hits are transformed again */
+    CACHED_VARIANT_TRANSFORMED, /**< The transformed response, hits are served without transforming */
+    CACHED_VARIANT_BOTH /**< Both, as alternates of the same object */
+  };
+
+  /**
+   * @brief A read-only view of the data currently available from the upstream TransformationPlugin.
+   *
+   * An InputBuffer points directly into the blocks of the upstream buffer, so no data is copied
+   * when it is handed to consume(InputBuffer &). The view is only valid for the duration of the
+   * consume() call it was passed to; the data is released once consume() returns.
+   *
+   * \code
+   * void consume(InputBuffer &input) {
+   *   const char *data;
+   *   size_t length;
+   *   while (input.nextBlock(data, length)) {
+   *     // inspect length bytes starting at data
+   *   }
+   * }
+   * \endcode
+   */
+  class InputBuffer : atscppapi::noncopyable {
+  public:
+    /**
+     * @private
+     *
+     * @param reader a TSIOBufferReader positioned at the start of the available data.
+     * @param length the number of bytes from reader that belong to this view.
+     */
+    InputBuffer(void *reader, size_t length);
+
+    /**
+     * @private
+     *
+     * Creates a view of a single contiguous piece of memory, this is used when handing data
+     * between the stages of a TransformationChain.
+     *
+     * @param data the start of the data.
+     * @param length the number of bytes starting at data that belong to this view.
+     */
+    InputBuffer(const char *data, size_t length);
+
+    /**
+     * @return The total number of bytes in this view.
+     */
+    size_t length() const;
+
+    /**
+     * Advances to the next contiguous block of data in the view.
+     *
+     * @param data Output argument; will point to the start of the block.
+     * @param length Output argument; will contain the length of the block.
+     * @return true if a block was returned, false once every block has been visited.
+     */
+    bool nextBlock(const char *&data, size_t &length);
+
+    /**
+     * Restarts iteration so the next call to nextBlock() returns the first block again.
+     */
+    void rewind();
+
+    /**
+     * Appends the contents of this view to str, this copies the data and does not
+     * affect iteration.
+     */
+    void appendTo(std::string &str) const;
+  private:
+    friend class TransformationPlugin;
+    void *reader_;
+    const char *data_;
+    void *block_;
+    size_t length_;
+    size_t offset_;
+    bool started_;
+  };
+
+  /**
+   * This method will be fired whenever an upstream TransformationPlugin has produced output, it is
+   * handed a view of the upstream data blocks so no copies are made. If you do not implement this
+   * method the default implementation will copy the data into a string and call consume(const std::string &).
+   *
+   * @param input a view of the available input, it's only valid until this method returns.
+   * @see InputBuffer
+   */
+  virtual void consume(InputBuffer &input);
+
+  /**
+   * A method that you must implement when writing a TransformationPlugin (unless you implement
+   * consume(InputBuffer &)), this method will be fired whenever an upstream TransformationPlugin
+   * has produced output. The default implementation passes data on with produce() unchanged.
+   */
+  virtual void consume(const std::string &data);
 
   /**
    * A method that you must implement when writing a TransformationPlugin, this method
@@ -96,6 +193,57 @@ public:
    */
   virtual void handleInputComplete() = 0;
 
+  /**
+   * This method is fired when an output buffer limit is set and the downstream has drained the
+   * waiting output below it, a transformation that holds back its own output can produce more now.
+   * Reading of the input resumes automatically, so the default implementation does nothing.
+   *
+   * @see setOutputBufferLimit()
+   */
+  virtual void handleOutputReady();
+
+  /**
+   * This method is fired just before the first output is written when the transformed response is cached, see
+   * setCachedVariant(). response holds the headers Traffic Server caches with the transformed body, since hits
+   * are served with these headers and without the transformation they must describe the transformed body, e.g.
+   * with Content-Encoding and a Vary on the request headers the transformation depends on. The default
+   * implementation does nothing. Every stage of a TransformationChain is given the headers in turn.
+   *
+   * @param response the headers of the transformed response.
+   * @see Transaction::getTransformedResponse()
+   */
+  virtual void handleTransformedResponseHeaders(Response &response);
+
+  /**
+   * @return The Type of this transformation, a stage of a TransformationChain has the Type of its chain.
+   */
+  Type getType() const;
+
+  /**
+   * Chooses whether Traffic Server caches the transformed response or the one from the origin. Caching the
+   * transformed variant turns the cost of transforming into a per object rather than a per request one: a hit
+   * is served as it was transformed and the plugin simply doesn't add the transformation, which it won't when
+   * that happens from HOOK_READ_RESPONSE_HEADERS since a fresh hit never reads a response from the origin.
+   * The transformed variant must then not depend on anything of the request missing from its Vary,
+   * see handleTransformedResponseHeaders(). Only response transformations can be cached, it must be called before
+   * the response is written to cache, in practice from the constructor or HOOK_READ_RESPONSE_HEADERS. On a
+   * stage of a TransformationChain it applies to the whole chain.
+   *
+   * \code
+   * void handleReadResponseHeaders(Transaction &transaction) {
+   *   TransformationPlugin *plugin = new SomeTransformationPlugin(transaction);
+   *   plugin->setCachedVariant(TransformationPlugin::CACHED_VARIANT_TRANSFORMED);
+   *   transaction.addPlugin(plugin);
+   *   transaction.resume();
+   * }
+   * \endcode
+   *
+   * @param variant the variants to cache.
+   * @return false for a request transformation, nothing is changed then.
+   * @see ContentEncoding::createCachedCompressor()
+   */
+  bool setCachedVariant(CachedVariant variant);
+
   virtual ~TransformationPlugin(); /**< Destructor for a TransformationPlugin */
 protected:
 
@@ -107,15 +255,175 @@ protected:
    */
   size_t produce(const std::string &);
 
+  /**
+   * Produces length bytes starting at data, the bytes are written to the downstream buffer
+   * directly so there is no need to build a std::string first.
+   *
+   * @return The number of bytes written.
+   */
+  size_t produce(const char *data, size_t length);
+
+  /**
+   * Passes an entire InputBuffer through to the downstream transformation. The upstream
+   * blocks are shared by reference with the downstream buffer, no data is copied.
+   *
+   * @param input the InputBuffer handed to consume(InputBuffer &).
+   * @return The number of bytes written.
+   */
+  size_t produce(const InputBuffer &input);
+
+  /**
+   * Passes length bytes of an InputBuffer starting at offset through to the downstream
+   * transformation without copying. This is useful for transformations that only change
+   * small parts of their input, the unchanged spans can be produced by reference.
+   *
+   * @param input the InputBuffer handed to consume(InputBuffer &).
+   * @param offset the offset into input of the first byte to produce.
+   * @param length the number of bytes to produce.
+   * @return The number of bytes written.
+   */
+  size_t produce(const InputBuffer &input, size_t offset, size_t length);
+
+  /**
+   * A callback used to release memory handed to produce(const char *, size_t, FreeFunction, void *).
+   */
+  typedef void (*FreeFunction)(const char *data, size_t length, void *free_data);
+
+  /**
+   * Produces memory owned by the caller, ownership is transferred to the TransformationPlugin
+   * which will call free_func once the memory is no longer needed. This allows output that was
+   * built in a caller owned buffer to be handed off without building a std::string.
+   *
+   * \note The Traffic Server API cannot wrap foreign memory in an IOBuffer block, so the data
+   * is written into the downstream buffer with a single copy and free_func is called before
+   * this method returns.
+   *
+   * @param data the data to produce.
+   * @param length the number of bytes to produce.
+   * @param free_func called once with data, length and free_data when the memory can be released.
+   * @param free_data opaque pointer passed to free_func.
+   * @return The number of bytes written.
+   */
+  size_t produce(const char *data, size_t length, FreeFunction free_func, void *free_data);
+
   /**
    * This is the method that you must call when you're done producing output for
    * the downstream TranformationPlugin.
    */
   size_t setOutputComplete();
 
+  /**
+   * Controls how much input is gathered before consume() is called. Input is held back until at least
+   * low_watermark bytes are available or the input has ended, and no more than high_watermark bytes are
+   * passed to a single consume() call, larger reads are split into several calls. Gathering input cuts
+   * the per call overhead of transformations such as compression, while the high watermark bounds the
+   * latency to first byte. By default there is no low watermark and no high watermark.
+   *
+   * @param low_watermark the minimum number of bytes to pass to consume(), except for the final chunk.
+   * @param high_watermark the maximum number of bytes to pass to consume(), 0 means there is no limit.
+   */
+  void setInputWatermarks(size_t low_watermark, size_t high_watermark = 0);
+
+  /**
+   * Bounds how much produced output can be waiting for a slow downstream. While at least limit bytes
+   * are waiting no more input is read and the upstream is not reenabled, so a fast producer
+   * doesn't buffer the entire object; reading resumes once the downstream catches up. The limit
+   * is checked between calls to consume(), so a single call can still go over it, combine it with a
+   * high watermark to bound that. By default there is no limit.
+   *
+   * @param limit the number of waiting output bytes at which input stops being read, 0 means no limit.
+   * @see getOutputCapacity()
+   * @see handleOutputReady()
+   */
+  void setOutputBufferLimit(size_t limit);
+
+  /**
+   * Declares how many bytes the output will have in total, for transformations that know it before producing
+   * anything, e.g. ones that only change headers or substitute fixed size strings. Traffic Server then sends the
+   * client a Content-Length rather than a chunked or connection close delimited body. It must be called before
+   * the first produce(), in practice from the constructor or the first consume(). On a stage of a
+   * TransformationChain it declares the output of the whole chain.
+   *
+   * The output must then have exactly length bytes: producing more or completing with fewer aborts the
+   * transformation, see abort(), since the client would otherwise get a corrupt response.
+   *
+   * \code
+   * // a transformation passing the body through unchanged keeps the origin's length
+   * string content_length = transaction.getServerResponse().getHeaders().getJoinedValues("Content-Length");
+   * if (!content_length.empty()) {
+   *   setOutputLength(strtoul(content_length.c_str(), NULL, 10));
+   * }
+   * \endcode
+   *
+   * @param length the total number of bytes this transformation will produce.
+   * @return false if output was already produced, the length then stays unknown.
+   */
+  bool setOutputLength(size_t length);
+
+  /**
+   * @return How many more bytes can be produced before reaching the output buffer limit, this is only
+   *         meaningful when a limit was set with setOutputBufferLimit().
+   */
+  size_t getOutputCapacity() const;
+
+  /**
+   * Detaches this transformation from the rest of its input. Once called the remaining input is passed
+   * straight through to the output by reference, consume() and handleInputComplete() are no longer
+   * called and the output is completed automatically when the input ends. This is meant for
+   * transformations that only need to look at the start of the body to decide if they apply.
+   *
+   * Anything already produced is sent first, any input you held back must be produced before
+   * calling bypass() since it won't be sent otherwise. When called from consume() the input that
+   * was handed to that consume() is still yours, only later input is passed through. A bypassed stage
+   * of a TransformationChain is skipped, its input goes directly to the following stage.
+   */
+  void bypass();
+
+  /**
+   * @return true if bypass() has been called.
+   */
+  bool isBypassed() const;
+
+  /**
+   * Fails the transformation: nothing more is read or written and Traffic Server is told the
+   * transformation failed, which ends the transaction with an error instead of sending an incomplete
+   * body on. Aborting a stage of a TransformationChain aborts the chain.
+   */
+  void abort();
+
+  /**
+   * @return true if abort() has been called.
+   */
+  bool isAborted() const;
+
+  /**
+   * Records the throughput and buffering of this transformation into metrics, which must outlive it.
+   *
+   * @see TransformationMetrics
+   */
+  void setMetrics(TransformationMetrics *metrics);
+
   /** a TransformationPlugin must implement this interface, it cannot be constructed directly */
   TransformationPlugin(Transaction &transaction, Type type);
+
+  /**
+   * Constructs a TransformationPlugin that runs as the last stage of chain instead of in its own
+   * transformation. The stage receives the output of the previous stage (or the input of the chain)
+   * directly in memory and its produce() feeds the next stage (or the output of the chain).
+   *
+   * \note setInputWatermarks() has no effect on a stage, set the watermarks on the chain instead.
+   *
+   * @see TransformationChain
+   */
+  TransformationPlugin(Transaction &transaction, TransformationChain &chain);
 private:
+  friend class TransformationPluginState;
+  TransformationPlugin *getNextStage() const;
+  bool prepareOutput();
+  size_t reenableOutput(int64_t bytes_written, int64_t expected_length);
+  size_t writeOutput(const char *data, size_t length);
+  size_t writeOutput(const InputBuffer &input, size_t offset, size_t length);
+  size_t completeOutput();
   TransformationPluginState *state_; /** Internal state for a TransformationPlugin */
 };
 
@@ -23,11 +23,68 @@
 #include <string>
 #include <stdint.h>
 #include <atscppapi/noncopyable.h>
+#include <atscppapi/StringView.h>
 
 namespace atscppapi {
 
 class UrlState;
 
+/**
+ * @brief The components of a Url, all read in one pass by Url::getView().
+ *
+ * The views point into the Url's marshal buffer, or into the Url itself when it's detached; they are
+ * valid until the Url is modified or reset(), or the hook they were taken in returns.
+ */
+struct UrlView {
+  StringView scheme_;
+  StringView host_;
+  StringView path_;
+  StringView query_;
+  uint16_t port_;
+  UrlView() : port_(0) { }
+};
+
+/**
+ * @brief A parameter of a query, see Url::getQueryParams().
+ *
+ * The name and value are views of the query as it was sent, still percent-encoded; see
+ * Url::decodeQueryComponent(). A parameter without a = has an empty, non null, value.
+ */
+struct QueryParamView {
+  StringView name_;
+  StringView value_;
+};
+
+/**
+ * @brief Walks the parameters of a query in order, parsing each one only when next() reaches it.
+ *
+ * Nothing is allocated and empty parameters (as in a&&b) are skipped. The views are valid as long as
+ * those of Url::getView().
+ *
+ * @code
+ * QueryParamIterator iter = url.getQueryParams();
+ * QueryParamView param;
+ * while (iter.next(param)) { ... }
+ * @endcode
+ */
+class QueryParamIterator {
+public:
+  /**
+   * @param query The query to walk, without its ?.
+   */
+  explicit QueryParamIterator(const StringView &query) : query_(query), pos_(0) { }
+
+  /**
+   * Moves to the next parameter.
+   *
+   * @return false once there are no more parameters, param is left untouched then.
+   */
+  bool next(QueryParamView &param);
+private:
+  StringView query_;
+  size_t pos_;
+};
+
 /**
  * @brief This class contains all properties of a Url.
  *
@@ -69,6 +126,29 @@ public:
    */
   const std::string &getUrlString() const;
 
+  /**
+   * @return Exact number of bytes getUrlString(char *, size_t) writes.
+   */
+  size_t getUrlStringLength() const;
+
+  /**
+   * Prints the full url to buffer, without TSUrlStringGet() allocating a copy of it nor a std::string
+   * being built from that copy.
+   *
+   * @param buffer Where to write; nothing is null terminated.
+   * @param buffer_length Size of buffer, at least getUrlStringLength() for anything to be written.
+   * @return Number of bytes written, 0 if the url doesn't fit.
+   */
+  size_t getUrlString(char *buffer, size_t buffer_length) const;
+
+  /**
+   * Reads the scheme, host, path, query and port in one pass, without copying any of them.
+   * Nothing is cached, so the view is always current with the marshal buffer.
+   *
+   * @param view Receives the components, those of a detached Url are the values it was given.
+   */
+  void getView(UrlView &view) const;
+
   /**
    * @return The path only portion of the url, such as /profile/view
    */
@@ -79,6 +159,34 @@ public:
    */
   const std::string &getQuery() const;
 
+  /**
+   * @return An iterator over the parameters of the query, see QueryParamIterator.
+   */
+  QueryParamIterator getQueryParams() const;
+
+  /**
+   * Finds a query parameter by name, compared case sensitively and before decoding. The query is split into
+   * its parameters on the first lookup and that is kept with the Url, so further lookups on the same query,
+   * from this plugin or another one, only compare names.
+   *
+   * @param index Which of the parameters with this name to return, 0 for the first.
+   * @return A view of the still encoded value, or a null view (StringView::isNull()) if there is no such
+   *         parameter.
+   */
+  StringView findQueryParam(const StringView &name, int index = 0) const;
+
+  /**
+   * Percent-decodes a query parameter name or value, + decoding to a space as in forms.
+   *
+   * @param encoded The name or value.
+   * @param buffer Where to decode to. The decoded text is never longer than encoded, so a buffer of
+   *               encoded.length() bytes always suffices; nothing is null terminated.
+   * @param buffer_length Size of buffer.
+   * @return The decoded text: encoded itself when there's nothing to decode, else a view into buffer. A null
+   *         view if the decoded text doesn't fit buffer.
+   */
+  static StringView decodeQueryComponent(const StringView &encoded, char *buffer, size_t buffer_length);
+
   /**
    * @return The scheme of the url, this will be either http or https.
    */
@@ -126,7 +234,8 @@ public:
   void setPort(const uint16_t);
 
   /**
-   * This method allows you to reset the url, this will force the Url to fully re-read all cached values.
+   * This method allows you to reset the url, this will force the Url to re-read all cached values. Each
+   * component is re-read on its own the next time it is accessed and its cached copy kept if it is unchanged.
    * If this method is used on a Detached Requests' Url object it will completely destroy the values.
    *
    * \note This method should rarely be used.
@@ -134,6 +243,7 @@ public:
   void reset();
 private:
   bool isInitialized() const;
+  StringView getQueryView() const;
   void init(void *hdr_buf, void *url_loc);
   UrlState *state_;
   friend class Request;
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file Versioned.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Contains Versioned, a holder of shared data that is replaced while it's being read.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_VERSIONED_H_
+#define ATSCPPAPI_VERSIONED_H_
+
+#include <cstddef>
+#include <vector>
+#include <stdint.h>
+#include <atscppapi/noncopyable.h>
+#include <atscppapi/Mutex.h>
+#include <atscppapi/ThreadLocal.h>
+
+namespace atscppapi {
+
+/**
+ * @brief Holds the current version of data that all threads read and one reloader replaces, read-copy-update style.
+ *
+ * Readers take a Snapshot, which pins the version current at that moment until the Snapshot goes out of
+ * scope. Taking one locks nothing and touches no shared counter: the reader only records the epoch it reads
+ * in into its own thread's slot. publish() swaps in a new version at once and retires the old one, which is
+ * deleted as soon as no thread is reading in an epoch from before the swap, on this or a later publish() or
+ * reclaim().
+ *
+ * \code
+ * Versioned<RuleSet> rules(loadRules());
+ * ...
+ * void handleReadRequestHeadersPreRemap(Transaction &transaction) {
+ *   Versioned<RuleSet>::Snapshot current(rules);
+ *   current->apply(transaction);
+ *   transaction.resume();
+ * }
+ * \endcode
+ *
+ * A Snapshot is meant to be held for the duration of a hook, a held Snapshot keeps every version published
+ * meanwhile alive. See VersionedReloader to reload the data periodically or when Traffic Server's
+ * configuration is reloaded.
+ */
+template <typename T> class Versioned : noncopyable {
+public:
+  /**
+   * @param initial The first version, owned by the Versioned from now on; may be NULL.
+   */
+  explicit Versioned(T *initial = NULL) : current_(initial), epoch_(1) { }
+
+  /**
+   * Deletes the current version and every retired one, no Snapshot may be held anymore.
+   */
+  ~Versioned() {
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      delete retired_[i].value_;
+    }
+    delete current_;
+  }
+
+  /**
+   * @brief Pins the current version of a Versioned for as long as it is in scope.
+   *
+   * Snapshots taken on the same thread may nest, they all pin versions from the outermost one's epoch on.
+   */
+  class Snapshot : noncopyable {
+  public:
+    explicit Snapshot(Versioned &versioned) : slot_(versioned.readers_.get()) {
+      if (slot_.nesting_++ == 0) {
+        slot_.epoch_ = versioned.epoch_;
+        __sync_synchronize(); // publish our epoch before reading the version, see publish()
+      }
+      value_ = versioned.current_;
+    }
+
+    ~Snapshot() {
+      if (--slot_.nesting_ == 0) {
+        __sync_synchronize(); // done with the version before releasing the epoch
+        slot_.epoch_ = 0;
+      }
+    }
+
+    /** @return The pinned version, NULL if none was published. */
+    const T *get() const { return value_; }
+    const T *operator->() const { return value_; }
+    const T &operator*() const { return *value_; }
+
+  private:
+    typename Versioned::ReaderSlot &slot_;
+    const T *value_;
+  };
+
+  /**
+   * Makes value the current version. Snapshots taken from now on see it; the previous version is
+   * deleted once the Snapshots that may still see it are gone.
+   *
+   * @param value The new version, owned by the Versioned from now on; may be NULL.
+   */
+  void publish(T *value) {
+    ScopedMutexLock lock(writer_mutex_);
+    T *previous = const_cast<T *>(current_);
+    current_ = value;
+    __sync_synchronize(); // the swap is visible before the epoch moves on
+    uint64_t retire_epoch = __sync_add_and_fetch(&epoch_, 1);
+    if (previous) {
+      retired_.push_back(Retired(previous, retire_epoch));
+    }
+    reclaimRetired();
+  }
+
+  /**
+   * Deletes the retired versions no Snapshot can see anymore. publish() does this too, calling it
+   * separately only matters to release memory sooner when versions are published rarely.
+   *
+   * @return Number of retired versions still waiting for readers.
+   */
+  size_t reclaim() {
+    ScopedMutexLock lock(writer_mutex_);
+    reclaimRetired();
+    return retired_.size();
+  }
+
+private:
+  /** What a thread is reading, kept in its ThreadLocal slot. */
+  struct ReaderSlot {
+    volatile uint64_t epoch_; // 0 when not reading
+    int nesting_;
+    ReaderSlot() : epoch_(0), nesting_(0) { }
+  };
+
+  struct Retired {
+    T *value_;
+    uint64_t epoch_; // readers from this epoch on can't see value_
+    Retired(T *value, uint64_t epoch) : value_(value), epoch_(epoch) { }
+  };
+
+  /** Finds the oldest epoch a thread is reading in. */
+  struct OldestEpoch {
+    uint64_t epoch_;
+    OldestEpoch() : epoch_(static_cast<uint64_t>(-1)) { }
+    void operator()(ReaderSlot &slot) {
+      uint64_t epoch = slot.epoch_;
+      if (epoch && (epoch < epoch_)) {
+        epoch_ = epoch;
+      }
+    }
+  };
+
+  void reclaimRetired() {
+    if (retired_.empty()) {
+      return;
+    }
+    uint64_t oldest = readers_.forEach(OldestEpoch()).epoch_;
+    size_t kept = 0;
+    for (size_t i = 0; i < retired_.size(); ++i) {
+      if (retired_[i].epoch_ <= oldest) {
+        delete retired_[i].value_;
+      } else {
+        retired_[kept++] = retired_[i];
+      }
+    }
+    retired_.resize(kept, Retired(NULL, 0));
+  }
+
+  T *volatile current_;
+  volatile uint64_t epoch_;
+  ThreadLocal<ReaderSlot> readers_;
+  Mutex writer_mutex_;
+  std::vector<Retired> retired_;
+};
+
+} /* atscppapi */
+
+#endif /* ATSCPPAPI_VERSIONED_H_ */
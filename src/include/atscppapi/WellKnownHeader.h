@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file WellKnownHeader.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Tokens for header names Traffic Server already knows about.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_WELLKNOWNHEADER_H_
+#define ATSCPPAPI_WELLKNOWNHEADER_H_
+
+#include <string>
+#include <atscppapi/StringView.h>
+
+namespace atscppapi {
+
+/**
+ * @brief Names of commonly used headers.
+ *
+ * Each token maps to the Traffic Server interned string for that header (the TS_MIME_FIELD_*
+ * strings), so Headers methods taking a WellKnownHeader hand Traffic Server its own pointer to
+ * look up instead of a name it has to case fold byte by byte.
+ */
+enum WellKnownHeader {
+  HEADER_ACCEPT = 0,
+  HEADER_ACCEPT_ENCODING,
+  HEADER_AUTHORIZATION,
+  HEADER_CACHE_CONTROL,
+  HEADER_CONNECTION,
+  HEADER_CONTENT_ENCODING,
+  HEADER_CONTENT_LENGTH,
+  HEADER_CONTENT_TYPE,
+  HEADER_COOKIE,
+  HEADER_DATE,
+  HEADER_ETAG,
+  HEADER_EXPIRES,
+  HEADER_HOST,
+  HEADER_IF_MODIFIED_SINCE,
+  HEADER_IF_NONE_MATCH,
+  HEADER_LAST_MODIFIED,
+  HEADER_LOCATION,
+  HEADER_RANGE,
+  HEADER_REFERER,
+  HEADER_SET_COOKIE,
+  HEADER_TRANSFER_ENCODING,
+  HEADER_USER_AGENT,
+  HEADER_VARY,
+  HEADER_VIA,
+  HEADER_X_FORWARDED_FOR,
+  WELL_KNOWN_HEADER_COUNT /**< Not a header, the number of tokens. */
+};
+
+/**
+ * @return The Traffic Server interned name of the header; it stays valid for the life of the process.
+ */
+StringView getWellKnownHeaderName(WellKnownHeader header);
+
+/**
+ * Checks whether name is the given header. The interned pointer and the length are compared
+ * before any case folding, so most mismatches cost a single integer comparison.
+ */
+bool isWellKnownHeader(const char *name, size_t name_length, WellKnownHeader header);
+
+/**
+ * @see isWellKnownHeader(const char *name, size_t name_length, WellKnownHeader header)
+ */
+inline bool isWellKnownHeader(const std::string &name, WellKnownHeader header) {
+  return isWellKnownHeader(name.data(), name.length(), header);
+}
+
+}
+
+#endif /* ATSCPPAPI_WELLKNOWNHEADER_H_ */
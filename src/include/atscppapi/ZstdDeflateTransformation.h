@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file ZstdDeflateTransformation.h
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ * @brief Zstd Deflate Transformation can be used to zstd compress content.
+ */
+
+#pragma once
+#ifndef ATSCPPAPI_ZSTDDEFLATETRANSFORMATION_H_
+#define ATSCPPAPI_ZSTDDEFLATETRANSFORMATION_H_
+
+#include <string>
+#include "atscppapi/TransformationPlugin.h"
+#include "atscppapi/TransformationChain.h"
+
+namespace atscppapi {
+
+namespace transformations {
+
+/**
+ * Internal state for Zstd Deflate Transformations
+ * @private
+ */
+class ZstdDeflateTransformationState;
+
+/**
+ * @brief A TransformationPlugin to easily add zstd compression to your TransformationPlugin chain.
+ *
+ * ZstdDeflateTransformation has the same interface as GzipDeflateTransformation, it is only built
+ * when zstd is found by configure.
+ *
+ * @note ZstdDeflateTransformation DOES NOT set Content-Encoding headers, it is the
+ * users responsibility to set any applicable headers.
+ *
+ * @see ZstdInflateTransformation
+ * @see GzipDeflateTransformation
+ */
+class ZstdDeflateTransformation : public TransformationPlugin {
+public:
+  /**
+   * @brief Tunable parameters for a ZstdDeflateTransformation.
+   *
+   * See ZSTD_CCtx_setParameter() in zstd.h for the valid range of level_ and window_log_.
+   */
+  struct Options {
+    int level_; /**< Compression level, defaults to ZSTD_CLEVEL_DEFAULT (3) */
+    int window_log_; /**< Base 2 logarithm of the window size, 0 (the default) lets zstd choose */
+    bool flush_every_chunk_; /**< Flush output downstream after every chunk of input, defaults to true */
+    size_t output_buffer_size_; /**< Size of the reusable output buffer, defaults to 16KB */
+
+    Options();
+  };
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type because the ZstdDeflateTransformation can be used with both requests and responses
+   *  you must specify the Type.
+   *
+   * @see TransformationPlugin::Type
+   */
+  ZstdDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type);
+
+  /**
+   * @param transaction As with any TransformationPlugin you must pass in the transaction
+   * @param type the Type of transformation.
+   * @param options the compression parameters to use.
+   */
+  ZstdDeflateTransformation(Transaction &transaction, TransformationPlugin::Type type, const Options &options);
+
+  /**
+   * Constructs a ZstdDeflateTransformation that runs as a stage of chain rather than in its own transformation.
+   *
+   * @see TransformationChain
+   */
+  ZstdDeflateTransformation(Transaction &transaction, TransformationChain &chain);
+
+  /**
+   * Constructs a ZstdDeflateTransformation stage of chain with the specified compression parameters.
+   *
+   * @see TransformationChain
+   */
+  ZstdDeflateTransformation(Transaction &transaction, TransformationChain &chain, const Options &options);
+
+  /**
+   * Compresses data and produces the compressed output.
+   *
+   * @param data the input data to compress
+   */
+  void consume(const std::string &data);
+
+  /**
+   * The zero copy variant of consume(), each block of data in the InputBuffer is
+   * handed to zstd directly.
+   *
+   * @param input the input data to compress
+   */
+  void consume(InputBuffer &input);
+
+  /**
+   * Finishes the compressed stream and flushes any remaining output.
+   */
+  void handleInputComplete();
+
+  virtual ~ZstdDeflateTransformation();
+private:
+  void compressData(const char *data, size_t length, int operation);
+  ZstdDeflateTransformationState *state_; /** Internal state for Zstd Deflate Transformations */
+};
+
+}
+
+}
+
+#endif /* ATSCPPAPI_ZSTDDEFLATETRANSFORMATION_H_ */
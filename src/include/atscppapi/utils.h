@@ -23,6 +23,7 @@
 #define ATSCPPAPI_UTILS_H_
 
 #include <string>
+#include <cstddef>
 #include <arpa/inet.h>
 #include <stdint.h>
 
@@ -53,9 +54,40 @@ uint16_t getPort(const sockaddr *);
  */
 std::string getIpPortString(const sockaddr *);
 
+/**
+ * @brief Size of a buffer that fits any address formatted by formatIp(), including the null.
+ */
+const size_t IP_STRING_BUFFER_SIZE = INET6_ADDRSTRLEN;
+
+/**
+ * @brief Size of a buffer that fits any address and port formatted by formatIpPort(), including the null.
+ */
+const size_t IP_PORT_STRING_BUFFER_SIZE = INET6_ADDRSTRLEN + 6;
+
+/**
+ * @brief Prints an address as getIpString() does, into a buffer instead of a new string.
+ *
+ * IPv4 addresses are formatted without going through inet_ntop().
+ *
+ * @param buffer Where to write, null terminated.
+ * @param buffer_length Size of buffer, IP_STRING_BUFFER_SIZE always suffices.
+ * @return Length of the address written, not counting the null; 0 if it couldn't be formatted or didn't fit.
+ */
+size_t formatIp(const sockaddr *, char *buffer, size_t buffer_length);
+
+/**
+ * @brief Prints an address and port as getIpPortString() does, into a buffer instead of a new string.
+ *
+ * @param buffer Where to write, null terminated.
+ * @param buffer_length Size of buffer, IP_PORT_STRING_BUFFER_SIZE always suffices.
+ * @return Length written, not counting the null; 0 if it couldn't be formatted or didn't fit.
+ */
+size_t formatIpPort(const sockaddr *, char *buffer, size_t buffer_length);
+
 /**
  * @brief This is the environment variable that disables caching in all
- * types including InitializableValue.
+ * types including InitializableValue. It has no effect when the library was
+ * configured with --enable-always-cache.
  */
 extern const std::string DISABLE_DATA_CACHING_ENV_FLAG;
 
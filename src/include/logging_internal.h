@@ -34,7 +34,35 @@
 #undef LOG_ERROR
 #endif
 
-#define LOG_DEBUG(fmt, ...) TS_DEBUG("atscppapi", fmt, ## __VA_ARGS__)
+/**
+ * @private
+ *
+ * Forward declared for the same reason as TSDebug() in Logger.h.
+ */
+extern "C" int TSIsDebugTagSet(const char *tag);
+
+/*
+ * LOG_DEBUG checks its tag before evaluating any of its arguments, many call sites build their arguments
+ * (url strings and the like) on hot paths. TSIsDebugTagSet() is only a flag test while debugging is off.
+ * Configuring with --disable-debug-logging compiles the messages out altogether, the if (false) keeps
+ * the format checked and the arguments used.
+ */
+#ifdef ATSCPPAPI_DISABLE_DEBUG_LOGGING
+#define LOG_DEBUG(fmt, ...) \
+  do { \
+    if (false) { \
+      TSDebug("atscppapi", fmt, ## __VA_ARGS__); \
+    } \
+  } while (false)
+#else
+#define LOG_DEBUG(fmt, ...) \
+  do { \
+    if (TSIsDebugTagSet("atscppapi." __FILE__ ":" LINE_NO)) { \
+      TS_DEBUG("atscppapi", fmt, ## __VA_ARGS__); \
+    } \
+  } while (false)
+#endif
+
 #define LOG_ERROR(fmt, ...) TS_ERROR("atscppapi", fmt, ## __VA_ARGS__)
 
 #endif /* ATSCPPAPI_LOGGING_INTERNAL_H_ */
@@ -32,7 +32,13 @@
 #include "atscppapi/HttpVersion.h"
 #include "atscppapi/utils.h"
 #include "atscppapi/AsyncHttpFetch.h"
+#include "atscppapi/AsyncTask.h"
 #include "atscppapi/Transaction.h"
+#include "atscppapi/HookFilter.h"
+#include "atscppapi/HookTiming.h"
+#include "atscppapi/MemoryAccounting.h"
+#include "atscppapi/TransactionTrace.h"
+#include "atscppapi/Session.h"
 
 namespace atscppapi {
 
@@ -44,19 +50,100 @@ namespace utils {
 class internal {
 public:
   static TSHttpHookID convertInternalHookToTsHook(Plugin::HookType);
+  static int convertTsEventToInternalHook(TSEvent); // a Plugin::HookType, -1 for events of no hook
   static TSHttpHookID convertInternalTransformationTypeToTsHook(TransformationPlugin::Type type);
   static void invokePluginForEvent(TransactionPlugin *, TSHttpTxn, TSEvent);
   static void invokePluginForEvent(GlobalPlugin *, TSHttpTxn, TSEvent);
   static HttpVersion getHttpVersion(TSMBuffer hdr_buf, TSMLoc hdr_loc);
   static void initTransactionManagement();
+  static void addTransactionManagementHook(TSHttpTxn, TSHttpHookID);
   static std::string consumeFromTSIOBufferReader(TSIOBufferReader);
   static shared_ptr<Mutex> getTransactionPluginMutex(TransactionPlugin &);
   static Transaction &getTransaction(TSHttpTxn);
+  static Transaction *findTransaction(TSHttpTxn); // NULL unless getTransaction() created one already
+  static Session &getSession(TSHttpSsn);
+  static void deleteSession(Session *session);
+  static void countSessionTransaction(Session &session) {
+    session.countTransaction();
+  }
 
   static AsyncHttpFetchState *getAsyncHttpFetchState(AsyncHttpFetch &async_http_fetch) {
     return async_http_fetch.state_;
   }
 
+  static TransactionTrace *getTransactionTrace(Transaction &transaction) {
+    return transaction.getTrace();
+  }
+
+  static void setTransactionTrace(Transaction &transaction, TransactionTrace *trace) {
+    transaction.setTrace(trace);
+  }
+
+  static void finishTransactionTrace(TransactionTrace &trace) {
+    trace.finish();
+  }
+
+  static void setAsyncHttpFetchTraceSpan(AsyncHttpFetch &async_http_fetch, const shared_ptr<TraceFetchSpan> &span) {
+    async_http_fetch.setTraceSpan(span);
+  }
+
+  static HookTiming *getPluginHookTiming(Plugin &plugin) {
+    return plugin.hook_timing_;
+  }
+
+  static void beginHookTiming(Transaction &transaction, HookTiming *timing, int hook_type, int64_t start_time) {
+    transaction.beginHookTiming(timing, hook_type, start_time);
+  }
+
+  static void recordHookHandlerTime(HookTiming *timing, int hook_type, int64_t nanoseconds) {
+    timing->recordHandlerTime(hook_type, nanoseconds);
+  }
+
+  static void recordHookResumeTime(HookTiming *timing, int hook_type, int64_t nanoseconds) {
+    timing->recordResumeTime(hook_type, nanoseconds);
+  }
+
+  static MemoryAccounting *getPluginMemoryAccounting(Plugin &plugin) {
+    return plugin.memory_accounting_;
+  }
+
+  static TransactionMemoryState *getTransactionMemory(Transaction &transaction) {
+    return transaction.getMemory();
+  }
+
+  static void setTransactionMemory(Transaction &transaction, TransactionMemoryState *memory) {
+    transaction.setMemory(memory);
+  }
+
+  static void recordPluginMemory(Transaction &transaction, MemoryAccounting *accounting, const Plugin *plugin,
+                                 size_t arena_bytes, size_t arena_allocations) {
+    MemoryAccounting::recordPluginMemory(transaction, accounting, plugin, arena_bytes, arena_allocations);
+  }
+
+  static bool isMemoryAccounted(Transaction &transaction) {
+    return MemoryAccounting::isAccounted(transaction);
+  }
+
+  static void recordTransformationBufferedBytes(Transaction &transaction, int64_t peak_buffered_bytes) {
+    MemoryAccounting::recordBufferedBytes(transaction, peak_buffered_bytes);
+  }
+
+  static void finishTransactionMemory(Transaction &transaction) {
+    MemoryAccounting::finishTransaction(transaction);
+  }
+
+  static AsyncTaskState *getAsyncTaskState(AsyncTask &async_task) {
+    return async_task.state_;
+  }
+
+  static void releaseAsyncHttpFetchResponseHeaders(AsyncHttpFetch &async_http_fetch, TSMBuffer &hdr_buf,
+                                                   TSMLoc &hdr_loc) {
+    void *buf, *loc;
+    async_http_fetch.releaseResponseHeaders(buf, loc);
+    hdr_buf = static_cast<TSMBuffer>(buf);
+    hdr_loc = static_cast<TSMLoc>(loc);
+  }
+
   static void initResponse(Response &response, TSMBuffer hdr_buf, TSMLoc hdr_loc) {
     response.init(hdr_buf, hdr_loc);
   }
@@ -73,6 +160,31 @@ public:
     transaction.initClientResponse();
   }
 
+  static void dispatchTransactionPluginHooks(Transaction &transaction, int event, size_t first_index) {
+    transaction.dispatchPluginHooks(event, first_index);
+  }
+
+  static void beginPluginCallback(Transaction &transaction, int event, size_t index,
+                                  Transaction::DispatchFunction continuation) {
+    transaction.beginPluginCallback(event, index, continuation);
+  }
+
+  static bool endPluginCallback(Transaction &transaction) {
+    return transaction.endPluginCallback();
+  }
+
+  static void endPluginDispatch(Transaction &transaction) {
+    transaction.endPluginDispatch();
+  }
+
+  static bool hookFilterMatches(const HookFilter &filter, HookFilterRequest &request) {
+    return filter.matches(request);
+  }
+
+  static void continuePluginDispatch(Transaction &transaction) {
+    transaction.continuePluginDispatch();
+  }
+
   static const std::list<TransactionPlugin *> &getTransactionPlugins(const Transaction &transaction) {
     return transaction.getPlugins();
   }
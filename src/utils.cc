@@ -17,32 +17,93 @@
  */
 
 #include "atscppapi/utils.h"
-#include <sstream>
+#include <cstring>
 #include <arpa/inet.h>
 #include <ts/ts.h>
 #include "logging_internal.h"
 
 const std::string atscppapi::utils::DISABLE_DATA_CACHING_ENV_FLAG("ATSCPPAPI_DISABLE_TRANSACTION_DATA_CACHING");
 
-std::string atscppapi::utils::getIpString(const sockaddr *sockaddress) {
+namespace {
+
+/** Writes a number of at most 5 digits, returning the position after it. */
+char *writeDecimal(char *buffer, unsigned int number) {
+  char digits[5];
+  int count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + number % 10);
+    number /= 10;
+  } while (number && (count < 5));
+  while (count) {
+    *buffer++ = digits[--count];
+  }
+  return buffer;
+}
+
+}
+
+size_t atscppapi::utils::formatIp(const sockaddr *sockaddress, char *buffer, size_t buffer_length) {
   if (sockaddress == NULL) {
     LOG_ERROR("Cannot work on NULL sockaddress");
-   return std::string();
+    return 0;
   }
 
-  char buf[INET6_ADDRSTRLEN];
-
   switch (sockaddress->sa_family) {
-  case AF_INET:
-    inet_ntop(AF_INET, &(((struct sockaddr_in *) sockaddress)->sin_addr), buf, INET_ADDRSTRLEN);
-    return std::string(buf);
+  case AF_INET: {
+    if (buffer_length < INET_ADDRSTRLEN) {
+      // write to a buffer that always fits and copy when it's known to
+      char ip[INET_ADDRSTRLEN];
+      size_t length = formatIp(sockaddress, ip, sizeof(ip));
+      if (length >= buffer_length) {
+        return 0;
+      }
+      memcpy(buffer, ip, length + 1);
+      return length;
+    }
+    const unsigned char *bytes =
+      reinterpret_cast<const unsigned char *>(&(((const struct sockaddr_in *) sockaddress)->sin_addr));
+    char *pos = buffer;
+    for (int i = 0; i < 4; ++i) {
+      if (i) {
+        *pos++ = '.';
+      }
+      pos = writeDecimal(pos, bytes[i]);
+    }
+    *pos = '\0';
+    return pos - buffer;
+  }
   case AF_INET6:
-    inet_ntop(AF_INET6, &(((struct sockaddr_in6 *) sockaddress)->sin6_addr), buf, INET6_ADDRSTRLEN);
-    return std::string(buf);
+    if (!inet_ntop(AF_INET6, &(((const struct sockaddr_in6 *) sockaddress)->sin6_addr), buffer, buffer_length)) {
+      return 0;
+    }
+    return strlen(buffer);
   default:
     LOG_ERROR("Unknown Address Family %d", static_cast<int>(sockaddress->sa_family));
-    return std::string();
+    return 0;
+  }
+}
+
+size_t atscppapi::utils::formatIpPort(const sockaddr *sockaddress, char *buffer, size_t buffer_length) {
+  size_t length = formatIp(sockaddress, buffer, buffer_length);
+  if (!length) {
+    return 0;
   }
+  char port[7];
+  port[0] = ':';
+  size_t port_length = writeDecimal(port + 1, getPort(sockaddress)) - port;
+  if (length + port_length >= buffer_length) {
+    return 0;
+  }
+  memcpy(buffer + length, port, port_length);
+  length += port_length;
+  buffer[length] = '\0';
+  return length;
+}
+
+std::string atscppapi::utils::getIpString(const sockaddr *sockaddress) {
+  char buf[IP_STRING_BUFFER_SIZE];
+  size_t length = formatIp(sockaddress, buf, sizeof(buf));
+  return std::string(buf, length);
 }
 
 uint16_t atscppapi::utils::getPort(const sockaddr *sockaddress) {
@@ -62,14 +123,7 @@ uint16_t atscppapi::utils::getPort(const sockaddr *sockaddress) {
 }
 
 std::string atscppapi::utils::getIpPortString(const sockaddr *sockaddress) {
-  if (sockaddress == NULL) {
-    LOG_ERROR("Cannot work on NULL sockaddress");
-    return std::string();
-  }
-
-  std::ostringstream oss;
-  oss << getIpString(sockaddress);
-  oss << ":";
-  oss << getPort(sockaddress);
-  return oss.str();
+  char buf[IP_PORT_STRING_BUFFER_SIZE];
+  size_t length = formatIpPort(sockaddress, buf, sizeof(buf));
+  return std::string(buf, length);
 }
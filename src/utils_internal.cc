@@ -25,9 +25,12 @@
 #include "atscppapi/Plugin.h"
 #include "atscppapi/GlobalPlugin.h"
 #include "atscppapi/Transaction.h"
+#include "atscppapi/Session.h"
+#include "atscppapi/Arena.h"
 #include "atscppapi/TransactionPlugin.h"
 #include "atscppapi/TransformationPlugin.h"
 #include "InitializableValue.h"
+#include "ThreadLocalPool.h"
 #include "utils.h"
 #include "logging_internal.h"
 
@@ -39,6 +42,8 @@ namespace {
 // value to minimize the likelihood of it causing any problems.
 const int MAX_TXN_ARG = 15;
 const int TRANSACTION_STORAGE_INDEX = MAX_TXN_ARG;
+const int MAX_SSN_ARG = 15;
+const int SESSION_STORAGE_INDEX = MAX_SSN_ARG;
 
 int handleTransactionEvents(TSCont cont, TSEvent event, void *edata) {
   // This function is only here to clean up Transaction objects
@@ -63,17 +68,32 @@ int handleTransactionEvents(TSCont cont, TSEvent event, void *edata) {
     break;
   case TS_EVENT_HTTP_TXN_CLOSE:
     { // opening scope to declare plugins variable below 
+      TransactionTrace *trace = utils::internal::getTransactionTrace(transaction);
+      if (trace) {
+        utils::internal::finishTransactionTrace(*trace); // the plugins may still be looked at by the exporter
+      }
+      utils::internal::finishTransactionMemory(transaction);
       const std::list<TransactionPlugin *> &plugins = utils::internal::getTransactionPlugins(transaction);
       for (std::list<TransactionPlugin *>::const_iterator iter = plugins.begin(), end = plugins.end();
            iter != end; ++iter) {
         shared_ptr<Mutex> trans_mutex = utils::internal::getTransactionPluginMutex(**iter);
+        if (!trans_mutex) {
+          LOG_DEBUG("Deleting transaction plugin at %p without a mutex", *iter);
+          delete *iter;
+          continue;
+        }
         LOG_DEBUG("Locking TransacitonPlugin mutex to delete transaction plugin at %p", *iter);
         trans_mutex->lock();
         LOG_DEBUG("Locked Mutex...Deleting transaction plugin at %p", *iter);
         delete *iter;
         trans_mutex->unlock();
       }
-      delete &transaction;
+      Arena &arena = transaction.getArena();
+      transaction.~Transaction(); // the Transaction itself lives in its arena
+      arena.reset();
+      if (!ThreadLocalPool<Arena>::push(&arena)) {
+        delete &arena;
+      }
     }
     break;
   default:
@@ -84,16 +104,36 @@ int handleTransactionEvents(TSCont cont, TSEvent event, void *edata) {
   return 0;
 }
 
+// Only transactions that have a Transaction object get the hooks of this continuation, see getTransaction()
+TSCont transaction_management_cont = NULL;
+
+int handleSessionEvents(TSCont cont, TSEvent event, void *edata) {
+  TSHttpSsn ats_ssn_handle = static_cast<TSHttpSsn>(edata);
+  Session *session = static_cast<Session *>(TSHttpSsnArgGet(ats_ssn_handle, SESSION_STORAGE_INDEX));
+  LOG_DEBUG("Got event %d on continuation %p for session (ats pointer %p, object %p)", event, cont,
+            ats_ssn_handle, session);
+  assert(event == TS_EVENT_HTTP_SSN_CLOSE);
+  if (session) {
+    TSHttpSsnArgSet(ats_ssn_handle, SESSION_STORAGE_INDEX, NULL);
+    utils::internal::deleteSession(session);
+  }
+  TSHttpSsnReenable(ats_ssn_handle, TS_EVENT_HTTP_CONTINUE);
+  return 0;
+}
+
+// Only sessions that have a Session object get the close hook of this continuation, see getSession()
+TSCont session_management_cont = NULL;
+
 void setupTransactionManagement() {
-  // We must always have a cleanup handler available
   TSMutex mutex = NULL;
-  TSCont cont = TSContCreate(handleTransactionEvents, mutex);
-  TSHttpHookAdd(TS_HTTP_POST_REMAP_HOOK, cont);
-  TSHttpHookAdd(TS_HTTP_SEND_REQUEST_HDR_HOOK, cont);
-  TSHttpHookAdd(TS_HTTP_READ_RESPONSE_HDR_HOOK, cont);
-  TSHttpHookAdd(TS_HTTP_SEND_RESPONSE_HDR_HOOK, cont);
-  TSHttpHookAdd(TS_HTTP_TXN_CLOSE_HOOK, cont);
-#ifndef DISABLE_TRANSACTION_DATA_CACHING
+  transaction_management_cont = TSContCreate(handleTransactionEvents, mutex);
+  session_management_cont = TSContCreate(handleSessionEvents, mutex);
+#if defined(ATSCPPAPI_ALWAYS_CACHE_TRANSACTION_DATA)
+  if (getenv(utils::DISABLE_DATA_CACHING_ENV_FLAG.c_str())) {
+    LOG_ERROR("%s is ignored, the library was built to always cache transaction data",
+              utils::DISABLE_DATA_CACHING_ENV_FLAG.c_str());
+  }
+#elif !defined(DISABLE_TRANSACTION_DATA_CACHING)
   transaction_data_caching_enabled = (getenv(utils::DISABLE_DATA_CACHING_ENV_FLAG.c_str()) == NULL);
 #endif
   LOG_DEBUG("Initialized transaction management with data caching %s",
@@ -103,6 +143,27 @@ void setupTransactionManagement() {
 
 void inline invokePluginForEvent(Plugin *plugin, TSHttpTxn ats_txn_handle, TSEvent event) {
   Transaction &transaction = utils::internal::getTransaction(ats_txn_handle);
+  HookTiming *timing = utils::internal::getPluginHookTiming(*plugin);
+  TransactionTrace *trace = utils::internal::getTransactionTrace(transaction);
+  MemoryAccounting *accounting = utils::internal::getPluginMemoryAccounting(*plugin);
+  size_t arena_bytes = 0;
+  size_t arena_allocations = 0;
+  if (accounting) {
+    arena_bytes = transaction.getArena().getBytesAllocated();
+    arena_allocations = transaction.getArena().getAllocationCount();
+  }
+  int hook_type = 0;
+  int64_t start_time = 0;
+  if (timing) {
+    hook_type = utils::internal::convertTsEventToInternalHook(event);
+    start_time = TShrtime();
+    utils::internal::beginHookTiming(transaction, timing, hook_type, start_time);
+  }
+  size_t span = TransactionTrace::NO_SPAN;
+  if (trace) {
+    span = trace->beginSpan(TransactionTrace::SPAN_HOOK,
+                            getHookTypeName(static_cast<Plugin::HookType>(utils::internal::convertTsEventToInternalHook(event))).data());
+  }
   switch (event) {
   case TS_EVENT_HTTP_PRE_REMAP:
     plugin->handleReadRequestHeadersPreRemap(transaction);
@@ -122,10 +183,24 @@ void inline invokePluginForEvent(Plugin *plugin, TSHttpTxn ats_txn_handle, TSEve
   case TS_EVENT_HTTP_OS_DNS:
     plugin->handleOsDns(transaction);
     break;
+  case TS_EVENT_HTTP_CACHE_LOOKUP_COMPLETE:
+    plugin->handleCacheLookupComplete(transaction);
+    break;
   default:
     assert(false); /* we should never get here */
     break;
   }
+  if (timing) {
+    utils::internal::recordHookHandlerTime(timing, hook_type, TShrtime() - start_time);
+  }
+  if (trace) {
+    trace->endSpan(span);
+  }
+  if (accounting) {
+    Arena &arena = transaction.getArena();
+    utils::internal::recordPluginMemory(transaction, accounting, plugin, arena.getBytesAllocated() - arena_bytes,
+                                        arena.getAllocationCount() - arena_allocations);
+  }
 }
 
 } /* anonymous namespace */
@@ -133,17 +208,68 @@ void inline invokePluginForEvent(Plugin *plugin, TSHttpTxn ats_txn_handle, TSEve
 Transaction &utils::internal::getTransaction(TSHttpTxn ats_txn_handle) {
   Transaction *transaction = static_cast<Transaction *>(TSHttpTxnArgGet(ats_txn_handle, TRANSACTION_STORAGE_INDEX));
   if (!transaction) {
-    transaction = new Transaction(static_cast<void *>(ats_txn_handle));
+    Arena *arena = ThreadLocalPool<Arena>::pop();
+    if (!arena) {
+      arena = new Arena();
+    }
+    transaction = new (arena->allocate(sizeof(Transaction))) Transaction(static_cast<void *>(ats_txn_handle), *arena);
     LOG_DEBUG("Created new transaction object at %p for ats pointer %p", transaction, ats_txn_handle);
     TSHttpTxnArgSet(ats_txn_handle, TRANSACTION_STORAGE_INDEX, transaction);
+    // We must always have a cleanup handler available, the other hooks are added as needed by Transaction
+    addTransactionManagementHook(ats_txn_handle, TS_HTTP_TXN_CLOSE_HOOK);
   }
   return *transaction;
 }
 
+Transaction *utils::internal::findTransaction(TSHttpTxn ats_txn_handle) {
+  return static_cast<Transaction *>(TSHttpTxnArgGet(ats_txn_handle, TRANSACTION_STORAGE_INDEX));
+}
+
+Session &utils::internal::getSession(TSHttpSsn ats_ssn_handle) {
+  Session *session = static_cast<Session *>(TSHttpSsnArgGet(ats_ssn_handle, SESSION_STORAGE_INDEX));
+  if (!session) {
+    session = new Session(static_cast<void *>(ats_ssn_handle));
+    LOG_DEBUG("Created new session object at %p for ats pointer %p", session, ats_ssn_handle);
+    TSHttpSsnArgSet(ats_ssn_handle, SESSION_STORAGE_INDEX, session);
+    TSHttpSsnHookAdd(ats_ssn_handle, TS_HTTP_SSN_CLOSE_HOOK, session_management_cont);
+  }
+  return *session;
+}
+
+void utils::internal::deleteSession(Session *session) {
+  delete session;
+}
+
+void utils::internal::addTransactionManagementHook(TSHttpTxn ats_txn_handle, TSHttpHookID hook_id) {
+  LOG_DEBUG("Adding transaction management hook %d to tshttptxn=%p", hook_id, ats_txn_handle);
+  TSHttpTxnHookAdd(ats_txn_handle, hook_id, transaction_management_cont);
+}
+
 shared_ptr<Mutex> utils::internal::getTransactionPluginMutex(TransactionPlugin &transaction_plugin) {
   return transaction_plugin.getMutex();
 }
 
+int utils::internal::convertTsEventToInternalHook(TSEvent event) {
+  switch (event) {
+  case TS_EVENT_HTTP_PRE_REMAP:
+    return Plugin::HOOK_READ_REQUEST_HEADERS_PRE_REMAP;
+  case TS_EVENT_HTTP_POST_REMAP:
+    return Plugin::HOOK_READ_REQUEST_HEADERS_POST_REMAP;
+  case TS_EVENT_HTTP_SEND_REQUEST_HDR:
+    return Plugin::HOOK_SEND_REQUEST_HEADERS;
+  case TS_EVENT_HTTP_READ_RESPONSE_HDR:
+    return Plugin::HOOK_READ_RESPONSE_HEADERS;
+  case TS_EVENT_HTTP_SEND_RESPONSE_HDR:
+    return Plugin::HOOK_SEND_RESPONSE_HEADERS;
+  case TS_EVENT_HTTP_OS_DNS:
+    return Plugin::HOOK_OS_DNS;
+  case TS_EVENT_HTTP_CACHE_LOOKUP_COMPLETE:
+    return Plugin::HOOK_CACHE_LOOKUP_COMPLETE;
+  default:
+    return -1;
+  }
+}
+
 TSHttpHookID utils::internal::convertInternalHookToTsHook(Plugin::HookType hooktype) {
   switch (hooktype) {
   case Plugin::HOOK_READ_REQUEST_HEADERS_POST_REMAP:
@@ -158,6 +284,8 @@ TSHttpHookID utils::internal::convertInternalHookToTsHook(Plugin::HookType hookt
     return TS_HTTP_SEND_RESPONSE_HDR_HOOK;
   case Plugin::HOOK_OS_DNS:
     return TS_HTTP_OS_DNS_HOOK;
+  case Plugin::HOOK_CACHE_LOOKUP_COMPLETE:
+    return TS_HTTP_CACHE_LOOKUP_COMPLETE_HOOK;
   default:
     assert(false); // shouldn't happen, let's catch it early
     break;
@@ -180,7 +308,12 @@ TSHttpHookID utils::internal::convertInternalTransformationTypeToTsHook(Transfor
 }
 
 void utils::internal::invokePluginForEvent(TransactionPlugin *plugin, TSHttpTxn ats_txn_handle, TSEvent event) {
-  ScopedSharedMutexLock scopedLock(plugin->getMutex());
+  shared_ptr<Mutex> mutex = plugin->getMutex();
+  if (!mutex) { // MUTEX_NONE
+    ::invokePluginForEvent(static_cast<Plugin *>(plugin), ats_txn_handle, event);
+    return;
+  }
+  ScopedSharedMutexLock scopedLock(mutex);
   ::invokePluginForEvent(static_cast<Plugin *>(plugin), ats_txn_handle, event);
 }
 
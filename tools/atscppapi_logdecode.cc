@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2013 LinkedIn Corp. All rights reserved.
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not use this file
+ * except in compliance with the License. You may obtain a copy of the license at
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software distributed under the
+ * License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND,
+ * either express or implied.
+ *
+ */
+
+/**
+ * @file atscppapi_logdecode.cc
+ * @author Brian Geffon
+ * @author Manjesh Nilange
+ *
+ * Prints the binary records of the logs given on the command line, or of stdin, as JSON lines.
+ * Lines that don't hold a binary record are skipped and counted on stderr.
+ */
+
+#include <atscppapi/LogRecord.h>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using atscppapi::LogRecord;
+using std::string;
+
+namespace {
+
+long skipped_lines = 0;
+
+void decode(std::istream &in) {
+  string line;
+  string json;
+  while (std::getline(in, line)) {
+    json.clear();
+    if (LogRecord::decodeToJson(line.data(), line.length(), json)) {
+      std::cout << json << '\n';
+    } else {
+      ++skipped_lines;
+    }
+  }
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    decode(std::cin);
+  }
+  for (int i = 1; i < argc; ++i) {
+    std::ifstream in(argv[i], std::ios::in | std::ios::binary);
+    if (!in) {
+      fprintf(stderr, "%s: unable to open %s\n", argv[0], argv[i]);
+      return 1;
+    }
+    decode(in);
+  }
+  if (skipped_lines) {
+    fprintf(stderr, "%s: skipped %ld lines without a binary record\n", argv[0], skipped_lines);
+  }
+  return 0;
+}